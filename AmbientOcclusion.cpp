@@ -0,0 +1,122 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <algorithm>
+#include <string>
+
+#include "AmbientOcclusion.h"
+#include "GLCheck.h"
+#include "GLState.h"
+#include "GpuMemory.h"
+
+namespace {
+
+// Threads per side of the work groups of the shaders
+const int GROUP_SIZE = 8;
+
+// Format of the occlusion and of the distance to the eye
+const int FORMAT = GL_RG16F;
+
+}  // namespace
+
+AmbientOcclusion::AmbientOcclusion()
+    : blurred_(0), size_(0, 0), allocated_bytes_(0) {}
+
+AmbientOcclusion::~AmbientOcclusion() {
+  if (blurred_)
+    GLState::DeleteTextures(1, &blurred_);
+  GpuMemory::Free(GpuMemory::RENDER_TARGETS, allocated_bytes_);
+}
+
+void AmbientOcclusion::Init(const std::string& gbuffer_code) {
+  auto group_size = std::to_string(GROUP_SIZE);
+  auto header = ShaderProgram::GenerateDefines(
+      {{"GROUP_SIZE", group_size}, {"OCCLUSION", ""}});
+  occlusion_shader_.LoadComputeShader("shaders/ssao_cs.glsl",
+                                      header + gbuffer_code);
+  occlusion_shader_.LinkShader();
+  header = ShaderProgram::GenerateDefines(
+      {{"GROUP_SIZE", group_size}, {"BLUR", ""}});
+  blur_shader_.LoadComputeShader("shaders/ssao_cs.glsl", header);
+  blur_shader_.LinkShader();
+}
+
+glm::ivec2 AmbientOcclusion::GetSize(FrameBuffer* gbuffer) {
+  return glm::max(glm::ivec2(gbuffer->GetWidth(), gbuffer->GetHeight()) / 2,
+                  glm::ivec2(1));
+}
+
+void AmbientOcclusion::Compute(FrameBuffer* gbuffer,
+                               const glm::mat4& projection,
+                               unsigned int output) {
+  auto size = GetSize(gbuffer);
+  if (size != size_)
+    Allocate(size);
+
+  occlusion_shader_.Enable();
+  gbuffer->BindTextures(0);
+  occlusion_shader_.SetUniform("inv_projection", glm::inverse(projection));
+  occlusion_shader_.SetUniform(
+      "gbuffer_size", glm::vec2(gbuffer->GetWidth(), gbuffer->GetHeight()));
+  occlusion_shader_.SetUniform("occlusion_size", glm::vec2(size_));
+  // G-buffer pixels covered vertically by a unit at a unit distance
+  occlusion_shader_.SetUniform("projection_scale",
+                               projection[1][1] * 0.5f * gbuffer->GetHeight());
+  glBindImageTexture(0, output, 0, GL_FALSE, 0, GL_WRITE_ONLY, FORMAT);
+  occlusion_shader_.SetUniform("target_image", 0);
+  Dispatch();
+  glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+  // Horizontally into the blur storage, then vertically back to the output
+  blur_shader_.Enable();
+  blur_shader_.SetUniform("occlusion_size", glm::vec2(size_));
+  blur_shader_.SetUniform("source_image", 0);
+  blur_shader_.SetUniform("target_image", 1);
+  unsigned int targets[] = {blurred_, output};
+  for (int i = 0; i < 2; ++i) {
+    glBindImageTexture(0, targets[1 - i], 0, GL_FALSE, 0, GL_READ_ONLY,
+                       FORMAT);
+    glBindImageTexture(1, targets[i], 0, GL_FALSE, 0, GL_WRITE_ONLY, FORMAT);
+    blur_shader_.SetUniform("direction", glm::ivec2(1 - i, i));
+    Dispatch();
+    glMemoryBarrier(i == 0 ? GL_SHADER_IMAGE_ACCESS_BARRIER_BIT
+                           : GL_TEXTURE_FETCH_BARRIER_BIT);
+  }
+}
+
+void AmbientOcclusion::Allocate(glm::ivec2 size) {
+  if (blurred_)
+    GLState::DeleteTextures(1, &blurred_);
+  GpuMemory::Free(GpuMemory::RENDER_TARGETS, allocated_bytes_);
+  size_ = size;
+  glCreateTextures(GL_TEXTURE_2D, 1, &blurred_);
+  glTextureStorage2D(blurred_, 1, FORMAT, size.x, size.y);
+  allocated_bytes_ = (long)size.x * size.y * GpuMemory::GetFormatSize(FORMAT);
+  GpuMemory::Allocate(GpuMemory::RENDER_TARGETS, allocated_bytes_);
+}
+
+void AmbientOcclusion::Dispatch() {
+  glDispatchCompute((size_.x + GROUP_SIZE - 1) / GROUP_SIZE,
+                    (size_.y + GROUP_SIZE - 1) / GROUP_SIZE, 1);
+}
@@ -0,0 +1,99 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef AMBIENTOCCLUSION_H
+#define AMBIENTOCCLUSION_H
+
+#include <string>
+
+#include <glm/glm.hpp>
+
+#include "FrameBuffer.h"
+#include "ShaderProgram.h"
+
+/**
+ * Occlusion of the ambient light, computed from the G-buffer at half its
+ * resolution
+ *
+ * Every texel takes the position and normal of one pixel of its 2x2 block and
+ * marches a few rotated directions over the depth, within a radius in world
+ * units, adding how far each sample rises over the tangent plane (the HBAO+
+ * estimator, see shaders/ssao_cs.glsl). The noisy result is then blurred by two
+ * separable passes that skip the texels at a different depth, so the edges
+ * don't bleed. Each texel keeps its distance to the eye next to the
+ * occlusion, which the lighting uses to upsample it (see
+ * shaders/ambient_occlusion.glsl).
+ */
+class AmbientOcclusion {
+public:
+  /**
+   * Default constructor
+   */
+  AmbientOcclusion();
+
+  /**
+   * Destructor
+   */
+  ~AmbientOcclusion();
+
+  /**
+   * Creates the shaders; the occlusion reads the G-buffer with the code
+   * generated by its layout (see GBufferLayout)
+   * Throws runtime_error if a shader doesn't compile
+   */
+  void Init(const std::string& gbuffer_code);
+
+  /**
+   * Obtains the size of the occlusion of a G-buffer, half of it rounded down
+   */
+  static glm::ivec2 GetSize(FrameBuffer* gbuffer);
+
+  /**
+   * Computes the occlusion of the G-buffer, whose position is rebuilt with
+   * the projection, into the lower left rectangle of the size above of a
+   * texture of the format GL_RG16F; binds its textures from the unit zero
+   * The blur storage is reallocated when the size of the frame buffer changes
+   */
+  void Compute(FrameBuffer* gbuffer, const glm::mat4& projection,
+               unsigned int output);
+
+private:
+  /**
+   * Creates the texture of the horizontal blur of a size
+   */
+  void Allocate(glm::ivec2 size);
+
+  /**
+   * Dispatches the bound shader over the occlusion
+   */
+  void Dispatch();
+
+  ShaderProgram occlusion_shader_;
+  ShaderProgram blur_shader_;
+  unsigned int blurred_;  // horizontal blur
+  glm::ivec2 size_;
+  long allocated_bytes_;
+};
+
+#endif
@@ -0,0 +1,159 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef BLOCKLAYOUT_H
+#define BLOCKLAYOUT_H
+
+#include <cstddef>
+
+#include <glm/glm.hpp>
+
+/**
+ * Compile-time offsets of the members of a GLSL block structure
+ *
+ * The template arguments are the GLSL member types, in order, and the
+ * offsets follow the std140/std430 rules for structure members. Together
+ * with CHECK_BLOCK_MEMBER and CHECK_BLOCK_STRIDE, a C++ structure that
+ * mirrors a GLSL structure fails to compile when one of them drifts from the
+ * other, so its arrays can be copied to a buffer as they are.
+ */
+template <typename... Members> struct BlockLayout;
+
+namespace block_layout {
+
+/**
+ * Alignment and size of a member type
+ */
+template <typename T> struct Type;
+
+template <> struct Type<float> {
+  static constexpr size_t alignment = 4, size = 4;
+};
+
+template <> struct Type<int> {
+  static constexpr size_t alignment = 4, size = 4;
+};
+
+template <> struct Type<unsigned int> {
+  static constexpr size_t alignment = 4, size = 4;
+};
+
+template <> struct Type<glm::vec2> {
+  static constexpr size_t alignment = 8, size = 8;
+};
+
+template <> struct Type<glm::vec3> {
+  static constexpr size_t alignment = 16, size = 12;
+};
+
+template <> struct Type<glm::vec4> {
+  static constexpr size_t alignment = 16, size = 16;
+};
+
+template <> struct Type<glm::ivec3> {
+  static constexpr size_t alignment = 16, size = 12;
+};
+
+template <> struct Type<glm::mat4> {
+  static constexpr size_t alignment = 16, size = 64;
+};
+
+/**
+ * Rounds an offset up to an alignment
+ */
+constexpr size_t AlignUp(size_t offset, size_t alignment) {
+  return (offset + alignment - 1) / alignment * alignment;
+}
+
+constexpr size_t Max(size_t a, size_t b) { return a > b ? a : b; }
+
+}  // namespace block_layout
+
+template <> struct BlockLayout<> {
+  static constexpr size_t Offset(size_t, size_t base = 0) { return base; }
+  static constexpr size_t End(size_t base = 0) { return base; }
+  static constexpr size_t Alignment() { return 1; }
+};
+
+template <typename First, typename... Rest>
+struct BlockLayout<First, Rest...> {
+  /**
+   * Obtains the offset of a member
+   * The base is where the previous members end
+   */
+  static constexpr size_t Offset(size_t index, size_t base = 0) {
+    return index == 0 ? Start(base)
+                      : BlockLayout<Rest...>::Offset(index - 1, Next(base));
+  }
+
+  /**
+   * Obtains where the last member ends
+   */
+  static constexpr size_t End(size_t base = 0) {
+    return BlockLayout<Rest...>::End(Next(base));
+  }
+
+  /**
+   * Obtains the alignment of the structure
+   */
+  static constexpr size_t Alignment() {
+    return block_layout::Max(block_layout::Type<First>::alignment,
+                             BlockLayout<Rest...>::Alignment());
+  }
+
+  /**
+   * Obtains the array stride of the structure in std430 and std140 blocks
+   * (std140 rounds the alignment of structures up to a vec4)
+   */
+  static constexpr size_t Std430Stride() {
+    return block_layout::AlignUp(End(), Alignment());
+  }
+  static constexpr size_t Std140Stride() {
+    return block_layout::AlignUp(End(), block_layout::Max(Alignment(), 16));
+  }
+
+private:
+  static constexpr size_t Start(size_t base) {
+    return block_layout::AlignUp(base, block_layout::Type<First>::alignment);
+  }
+  static constexpr size_t Next(size_t base) {
+    return Start(base) + block_layout::Type<First>::size;
+  }
+};
+
+/**
+ * Fails to compile if a member of a structure isn't at its GLSL offset
+ */
+#define CHECK_BLOCK_MEMBER(Struct, Layout, index, member)                      \
+  static_assert(offsetof(Struct, member) == Layout::Offset(index),             \
+                #Struct "::" #member " doesn't match the GLSL offset")
+
+/**
+ * Fails to compile if a structure isn't as large as its GLSL array stride
+ */
+#define CHECK_BLOCK_STRIDE(Struct, Layout, stride)                             \
+  static_assert(sizeof(Struct) == Layout::stride(),                            \
+                #Struct " doesn't match the GLSL array stride")
+
+#endif
@@ -0,0 +1,133 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <algorithm>
+#include <string>
+
+#include "Bloom.h"
+#include "GLCheck.h"
+#include "GLState.h"
+#include "GpuMemory.h"
+
+namespace {
+
+// Threads per side of the work groups of the shaders
+const int GROUP_SIZE = 8;
+
+// Format of the levels
+const int FORMAT = GL_R11F_G11F_B10F;
+
+}  // namespace
+
+Bloom::Bloom() : sampler_(0), n_levels_(0), allocated_bytes_(0) {}
+
+Bloom::~Bloom() {
+  if (!textures_.empty())
+    GLState::DeleteTextures(textures_.size(), textures_.data());
+  if (sampler_)
+    GLState::DeleteSampler(sampler_);
+  GpuMemory::Free(GpuMemory::RENDER_TARGETS, allocated_bytes_);
+}
+
+void Bloom::Init(int levels) {
+  n_levels_ = levels;
+  auto group_size = std::to_string(GROUP_SIZE);
+  ShaderProgram* shaders[] = {&karis_shader_, &downsample_shader_,
+                              &upsample_shader_};
+  const char* modes[] = {"KARIS", "DOWNSAMPLE", "UPSAMPLE"};
+  for (int i = 0; i < 3; ++i) {
+    auto header = ShaderProgram::GenerateDefines(
+        {{"GROUP_SIZE", group_size}, {modes[i], ""}});
+    shaders[i]->LoadComputeShader("shaders/bloom_cs.glsl", header);
+    shaders[i]->LinkShader();
+  }
+  glCreateSamplers(1, &sampler_);
+  glSamplerParameteri(sampler_, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glSamplerParameteri(sampler_, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glSamplerParameteri(sampler_, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glSamplerParameteri(sampler_, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+}
+
+int Bloom::GetLevels() { return n_levels_; }
+
+void Bloom::Build(unsigned int source, glm::ivec2 source_size,
+                  unsigned int output, glm::ivec2 output_size) {
+  if (sizes_.empty() || sizes_[0] != output_size)
+    Allocate(output_size);
+  std::vector<unsigned int> levels = {output};
+  levels.insert(levels.end(), textures_.begin(), textures_.end());
+
+  // Every step reads the previous level through the sampler and writes the
+  // next one as an image
+  GLState::BindSamplers(0, 1, &sampler_);
+  for (int i = 0; i < n_levels_; ++i) {
+    auto shader = i == 0 ? &karis_shader_ : &downsample_shader_;
+    shader->Enable();
+    GLState::BindTexture(0, i == 0 ? source : levels[i - 1]);
+    shader->SetUniform("source_texture", 0);
+    shader->SetUniform("source_size",
+                       glm::vec2(i == 0 ? source_size : sizes_[i - 1]));
+    shader->SetUniform("target_size", glm::vec2(sizes_[i]));
+    glBindImageTexture(0, levels[i], 0, GL_FALSE, 0, GL_WRITE_ONLY, FORMAT);
+    shader->SetUniform("target_image", 0);
+    Dispatch(sizes_[i]);
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+  }
+
+  upsample_shader_.Enable();
+  upsample_shader_.SetUniform("source_texture", 0);
+  upsample_shader_.SetUniform("target_image", 0);
+  for (int i = n_levels_ - 2; i >= 0; --i) {
+    GLState::BindTexture(0, levels[i + 1]);
+    upsample_shader_.SetUniform("source_size", glm::vec2(sizes_[i + 1]));
+    upsample_shader_.SetUniform("target_size", glm::vec2(sizes_[i]));
+    glBindImageTexture(0, levels[i], 0, GL_FALSE, 0, GL_READ_WRITE, FORMAT);
+    Dispatch(sizes_[i]);
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT |
+                    GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+  }
+}
+
+void Bloom::Allocate(glm::ivec2 size) {
+  if (!textures_.empty())
+    GLState::DeleteTextures(textures_.size(), textures_.data());
+  GpuMemory::Free(GpuMemory::RENDER_TARGETS, allocated_bytes_);
+  allocated_bytes_ = 0;
+  sizes_ = {size};
+  textures_.resize(n_levels_ - 1);
+  glCreateTextures(GL_TEXTURE_2D, textures_.size(), textures_.data());
+  for (auto texture : textures_) {
+    size = glm::max(size / 2, glm::ivec2(1));
+    sizes_.push_back(size);
+    glTextureStorage2D(texture, 1, FORMAT, size.x, size.y);
+    allocated_bytes_ +=
+        (long)size.x * size.y * GpuMemory::GetFormatSize(FORMAT);
+  }
+  GpuMemory::Allocate(GpuMemory::RENDER_TARGETS, allocated_bytes_);
+}
+
+void Bloom::Dispatch(glm::ivec2 size) {
+  glDispatchCompute((size.x + GROUP_SIZE - 1) / GROUP_SIZE,
+                    (size.y + GROUP_SIZE - 1) / GROUP_SIZE, 1);
+}
@@ -0,0 +1,99 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef BLOOM_H
+#define BLOOM_H
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "ShaderProgram.h"
+
+/**
+ * Glow of the bright parts of the HDR lit image, built in compute
+ *
+ * The lit image is downsampled into a chain of levels, each half the
+ * previous one; the first one, given by the caller, has half the size of
+ * the output. Each texel of a level takes 13 bilinear taps of the previous
+ * one, which weight 36 texels so the downsample doesn't alias, and the first
+ * step weights its taps by the inverse of their luma so isolated bright
+ * pixels don't flicker. The levels are then added back from the smallest,
+ * each upsampled with a 3x3 tent filter into the next larger one, so the
+ * first level ends with the glow at every radius (see shaders/bloom_cs.glsl).
+ * The cost only depends on the output size.
+ */
+class Bloom {
+public:
+  /**
+   * Default constructor
+   */
+  Bloom();
+
+  /**
+   * Destructor
+   */
+  ~Bloom();
+
+  /**
+   * Creates the shaders and the sampler, for a chain of levels
+   * Throws runtime_error if a shader doesn't compile
+   */
+  void Init(int levels);
+
+  /**
+   * Obtains the number of levels
+   */
+  int GetLevels();
+
+  /**
+   * Builds the glow of a texture, using its lower left rectangle of a size,
+   * into the first level, a texture of the format GL_R11F_G11F_B10F
+   * The levels after the first are reallocated when its size changes
+   */
+  void Build(unsigned int source, glm::ivec2 source_size, unsigned int output,
+             glm::ivec2 output_size);
+
+private:
+  /**
+   * Creates the levels after the first one of a size
+   */
+  void Allocate(glm::ivec2 size);
+
+  /**
+   * Dispatches the bound shader over a level of a size
+   */
+  void Dispatch(glm::ivec2 size);
+
+  ShaderProgram downsample_shader_;
+  ShaderProgram karis_shader_;  // the first downsample
+  ShaderProgram upsample_shader_;
+  unsigned int sampler_;
+  int n_levels_;
+  std::vector<unsigned int> textures_;  // from the second level
+  std::vector<glm::ivec2> sizes_;       // of every level
+  long allocated_bytes_;
+};
+
+#endif
@@ -0,0 +1,98 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef BUFFERBINDINGS_H
+#define BUFFERBINDINGS_H
+
+/**
+ * Binding points of the uniform and storage blocks shared by the programs
+ *
+ * Each module registers the names of its blocks with
+ * ShaderProgram::RegisterBlockBinding before linking, so the programs bind
+ * their blocks once and the frames only bind the buffers to these points.
+ * Uniform and storage blocks have separate binding points.
+ */
+namespace buffer_bindings {
+
+// Storage blocks
+const int CLUSTER_RANGES = 0;
+const int CLUSTER_LIGHTS = 1;
+const int LIGHTS = 2;
+const int MODELS = 3;
+const int SPOT_LIGHTS = 4;
+const int WORLD_SPOT_LIGHTS = 5;
+const int DRAWS = 6;
+const int INSTANCES = 7;
+const int COMMANDS = 8;
+const int CULL_DRAWS = 9;
+const int CANDIDATES = 10;
+const int DRAWN = 11;
+const int CULL_LODS = 12;
+const int CULL_MESHLETS = 13;
+const int PAGE_REQUESTS = 14;
+const int SPOT_SHADOWS = 15;
+const int WORLD_SPOT_SHADOWS = 16;
+const int LATE_INSTANCES = 17;
+const int VISIBILITY_VERTICES = 18;
+const int VISIBILITY_INDICES = 19;
+const int COMPACT_COMMANDS = 20;
+const int DRAW_COUNTS = 21;
+const int LIGHT_NODES = 22;
+const int TREE_LIGHTS = 23;
+const int MATERIALS = 24;
+const int BOX_VISIBILITY = 25;
+const int IMPOSTOR_COMMANDS = 26;
+const int IMPOSTOR_INSTANCES = 27;
+const int SPOT_LIGHT_SLOTS = 28;
+const int SWARM_LIGHTS = 29;
+const int DIFFUSE_HANDLES = 30;
+const int SCAN_TILES = 31;
+const int BVH_NODES = 32;
+const int BVH_BOUNDS = 33;
+const int BVH_PARENTS = 34;
+const int SORT_INPUT = 35;
+const int SORT_OUTPUT = 36;
+const int SORT_HISTOGRAM = 37;
+const int SKINNED_VERTICES = 38;
+const int SKIN_OFFSETS = 39;
+const int SKIN_BONES = 40;
+const int SKIN_SOURCE = 41;
+const int PULLED_VERTICES = 42;
+const int SHADOW_MESH_NODES = 43;
+const int SHADOW_TRIANGLES = 44;
+const int SHADOW_NODES = 45;
+const int SHADOW_INSTANCES = 46;
+const int SHADOW_PARENTS = 47;
+const int SHADOW_REFITS = 48;
+const int CLUSTER_AMBIENT = 49;
+
+// Uniform blocks
+const int CAMERA = 1;
+const int VIEWS = 2;
+const int SUN = 3;
+const int TRANSPARENT_INSTANCES = 4;
+
+}  // namespace buffer_bindings
+
+#endif
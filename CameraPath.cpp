@@ -0,0 +1,102 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#include "CameraPath.h"
+
+namespace {
+
+// Start of every path file, followed by the poses
+struct Header {
+  char magic[4];
+  uint32_t version;
+  uint32_t n_poses;
+};
+
+const char MAGIC[4] = {'C', 'A', 'M', 'P'};
+
+// Changes whenever the layout of the file does
+const uint32_t VERSION = 1;
+
+static_assert(sizeof(CameraPath::Pose) == 40, "unexpected pose padding");
+
+}  // namespace
+
+void CameraPath::Add(const Pose& pose) { poses_.push_back(pose); }
+
+CameraPath::Pose CameraPath::Sample(double time) const {
+  if (poses_.empty())
+    return {0.0f, glm::vec3(0), glm::vec3(0, 0, -1), glm::vec3(0, 1, 0)};
+  // First pose later than the time
+  auto next = std::upper_bound(
+      poses_.begin(), poses_.end(), time,
+      [](double t, const Pose& pose) { return t < pose.time; });
+  if (next == poses_.begin())
+    return poses_.front();
+  if (next == poses_.end())
+    return poses_.back();
+  auto& from = *(next - 1);
+  auto& to = *next;
+  float alpha = (time - from.time) / (to.time - from.time);
+  return {(float)time, glm::mix(from.eye, to.eye, alpha),
+          glm::mix(from.center, to.center, alpha),
+          glm::normalize(glm::mix(from.up, to.up, alpha))};
+}
+
+double CameraPath::GetDuration() const {
+  return poses_.empty() ? 0.0 : poses_.back().time;
+}
+
+bool CameraPath::IsEmpty() const { return poses_.empty(); }
+
+void CameraPath::Load(const std::string& path) {
+  std::ifstream input(path, std::ios::binary);
+  Header header;
+  if (!input.read((char*)&header, sizeof(header)) ||
+      memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 ||
+      header.version != VERSION)
+    throw std::runtime_error("not a camera path: " + path);
+  poses_.resize(header.n_poses);
+  if (!input.read((char*)poses_.data(), poses_.size() * sizeof(Pose))) {
+    poses_.clear();
+    throw std::runtime_error("truncated camera path: " + path);
+  }
+}
+
+void CameraPath::Save(const std::string& path) const {
+  Header header;
+  memcpy(header.magic, MAGIC, sizeof(MAGIC));
+  header.version = VERSION;
+  header.n_poses = poses_.size();
+  std::ofstream output(path, std::ios::binary | std::ios::trunc);
+  output.write((const char*)&header, sizeof(header));
+  output.write((const char*)poses_.data(), poses_.size() * sizeof(Pose));
+  if (!output)
+    throw std::runtime_error("unable to write file: " + path);
+}
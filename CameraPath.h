@@ -0,0 +1,91 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef CAMERAPATH_H
+#define CAMERAPATH_H
+
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+/**
+ * Poses of the camera at the times they were recorded, to replay a flight
+ * through the scene
+ *
+ * A pose is sampled at any time between the first and the last one by
+ * interpolating the two around it, and clamped outside of them, so a path
+ * recorded at the frame rate of an interactive session is replayed the same
+ * at a fixed frame time. The file is a header with the number of poses and
+ * the poses themselves, 40 bytes each in the byte order of the machine.
+ */
+class CameraPath {
+public:
+  /**
+   * Camera at a time, in seconds since the start of the path
+   */
+  struct Pose {
+    float time;
+    glm::vec3 eye;
+    glm::vec3 center;
+    glm::vec3 up;
+  };
+
+  /**
+   * Appends a pose, later than the last one
+   */
+  void Add(const Pose& pose);
+
+  /**
+   * Obtains the pose at a time
+   */
+  Pose Sample(double time) const;
+
+  /**
+   * Obtains the time of the last pose
+   */
+  double GetDuration() const;
+
+  /**
+   * Checks if the path has no poses
+   */
+  bool IsEmpty() const;
+
+  /**
+   * Reads the poses of a file, replacing the current ones
+   * Throws runtime_error if the file can't be read or isn't a path
+   */
+  void Load(const std::string& path);
+
+  /**
+   * Writes the poses to a file
+   * Throws runtime_error if the file can't be written
+   */
+  void Save(const std::string& path) const;
+
+private:
+  std::vector<Pose> poses_;
+};
+
+#endif
@@ -0,0 +1,83 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef COMMANDLIST_H
+#define COMMANDLIST_H
+
+#include <glm/glm.hpp>
+
+#include "MeshArena.h"
+#include "ShaderProgram.h"
+
+/**
+ * Draw commands recorded on any thread and executed later, in their order,
+ * on the thread of the context of the device that created the list
+ *
+ * It's the seam between the passes and the graphics api: recording makes no
+ * api calls, so a pass can split its cpu work among worker threads that each
+ * fill a list of their own, and the lists are executed in order. The gl
+ * backend (GLCommandList) replays the commands with the usual calls from the
+ * render thread; an explicit api would encode them into command buffers on
+ * the workers instead. The programs and the arenas must outlive the
+ * execution. Lists are created by a RenderDevice.
+ */
+class CommandList {
+public:
+  /**
+   * Destructor
+   */
+  virtual ~CommandList();
+
+  /**
+   * Drops the recorded commands
+   */
+  virtual void Reset() = 0;
+
+  /**
+   * Records setting an uniform of a program
+   */
+  virtual void SetUniform(ShaderProgram* program,
+                          ShaderProgram::Uniform uniform,
+                          const glm::vec3& value) = 0;
+  virtual void SetUniform(ShaderProgram* program,
+                          ShaderProgram::Uniform uniform,
+                          const glm::vec4& value) = 0;
+
+  /**
+   * Records a draw of a mesh of an arena, which must be bound when executed
+   */
+  virtual void Draw(MeshArena* arena, int mesh, int primitive) = 0;
+
+  /**
+   * Executes the commands, on the thread of the context
+   */
+  virtual void Execute() = 0;
+
+  /**
+   * Obtains the number of recorded commands
+   */
+  virtual int GetSize() = 0;
+};
+
+#endif
@@ -0,0 +1,173 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <vector>
+
+#include "CpuProfiler.h"
+
+namespace {
+
+// Zones kept per thread, past which they are dropped
+const int MAX_EVENTS = 1 << 17;
+
+struct Event {
+  const char* name;
+  long long begin;
+  long long end;
+};
+
+// Zones of a thread, appended only by it; the count is published after the
+// zone is written, so the buffer may be read while the thread records
+struct Buffer {
+  std::string name;  // under the mutex
+  std::vector<Event> events;
+  std::atomic<int> count;
+  std::atomic<int> dropped;
+};
+
+std::chrono::steady_clock::time_point epoch;
+std::mutex mutex;  // of the buffer list and the names
+// By track; never freed, as the workers may record while the statics are
+// destroyed at exit
+std::vector<Buffer*> buffers;
+thread_local Buffer* thread_buffer = nullptr;
+Buffer* gpu_buffer = nullptr;
+std::set<std::string> gpu_names;  // interned, of the gpu track
+
+// Adds the buffer of a track
+Buffer* AddBuffer(const std::string& name) {
+  std::lock_guard<std::mutex> lock(mutex);
+  auto buffer = new Buffer();
+  buffers.push_back(buffer);
+  buffer->name = name.empty() ? "thread " + std::to_string(buffers.size())
+                              : name;
+  buffer->events.resize(MAX_EVENTS);
+  buffer->count = 0;
+  buffer->dropped = 0;
+  return buffer;
+}
+
+// Obtains the buffer of the calling thread, added on the first call
+Buffer* GetThreadBuffer() {
+  if (!thread_buffer)
+    thread_buffer = AddBuffer("");
+  return thread_buffer;
+}
+
+void Append(Buffer* buffer, const char* name, long long begin, long long end) {
+  int count = buffer->count.load(std::memory_order_relaxed);
+  if (count == MAX_EVENTS) {
+    buffer->dropped++;
+    return;
+  }
+  buffer->events[count] = {name, begin, end};
+  buffer->count.store(count + 1, std::memory_order_release);
+}
+
+// Writes a string as a JSON literal
+void WriteString(FILE* file, const std::string& s) {
+  fputc('"', file);
+  for (char c : s) {
+    if (c == '"' || c == '\\')
+      fputc('\\', file);
+    fputc(c, file);
+  }
+  fputc('"', file);
+}
+
+}  // namespace
+
+bool CpuProfiler::enabled_ = false;
+
+void CpuProfiler::Enable() {
+  epoch = std::chrono::steady_clock::now();
+  enabled_ = true;
+}
+
+void CpuProfiler::SetThreadName(const std::string& name) {
+  if (!enabled_)
+    return;
+  auto buffer = GetThreadBuffer();
+  std::lock_guard<std::mutex> lock(mutex);
+  buffer->name = name;
+}
+
+long long CpuProfiler::Now() {
+  using namespace std::chrono;
+  return duration_cast<nanoseconds>(steady_clock::now() - epoch).count();
+}
+
+void CpuProfiler::Record(const char* name, long long begin, long long end) {
+  Append(GetThreadBuffer(), name, begin, end);
+}
+
+void CpuProfiler::RecordGpu(const std::string& name, long long begin,
+                            long long end) {
+  if (!gpu_buffer)
+    gpu_buffer = AddBuffer("gpu");
+  const char* interned;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    interned = gpu_names.insert(name).first->c_str();
+  }
+  Append(gpu_buffer, interned, begin, end);
+}
+
+void CpuProfiler::Write(const std::string& path) {
+  FILE* file = fopen(path.c_str(), "w");
+  if (!file)
+    throw std::runtime_error("unable to write file: " + path);
+  std::lock_guard<std::mutex> lock(mutex);
+  fprintf(file, "{\"traceEvents\": [");
+  int dropped = 0;
+  for (size_t tid = 0; tid < buffers.size(); ++tid) {
+    auto& buffer = *buffers[tid];
+    fprintf(file, "%s\n{\"ph\": \"M\", \"pid\": 1, \"tid\": %zu, "
+            "\"name\": \"thread_name\", \"args\": {\"name\": ",
+            tid ? "," : "", tid);
+    WriteString(file, buffer.name);
+    fprintf(file, "}}");
+    int count = buffer.count.load(std::memory_order_acquire);
+    for (int i = 0; i < count; ++i) {
+      auto& event = buffer.events[i];
+      fprintf(file, ",\n{\"ph\": \"X\", \"pid\": 1, \"tid\": %zu, \"name\": ",
+              tid);
+      WriteString(file, event.name);
+      fprintf(file, ", \"ts\": %.3f, \"dur\": %.3f}", event.begin / 1e3,
+              (event.end - event.begin) / 1e3);
+    }
+    dropped += buffer.dropped;
+  }
+  fprintf(file, "\n]}\n");
+  fclose(file);
+  if (dropped)
+    fprintf(stderr, "warning: %d zones past the trace capacity dropped\n",
+            dropped);
+}
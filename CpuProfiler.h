@@ -0,0 +1,107 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef CPUPROFILER_H
+#define CPUPROFILER_H
+
+#include <string>
+
+/**
+ * Starts a zone named by a string literal that ends with the scope
+ */
+#define PROFILE_ZONE(name) CpuProfiler::Zone profile_zone(name)
+
+/**
+ * Timeline of named zones of every thread, written as a Chrome trace
+ *
+ * Each thread records its zones into its own buffer, allocated the first
+ * time it records and never reallocated, so recording takes no lock; the
+ * zones past the capacity of a buffer are dropped. The gpu times of the
+ * passes are added on a track of their own, in the cpu clock. While the
+ * profiler is disabled a zone costs one branch.
+ */
+class CpuProfiler {
+public:
+  /**
+   * Scoped zone; the name must outlive the profiler
+   */
+  class Zone {
+  public:
+    explicit Zone(const char* name)
+        : name_(enabled_ ? name : nullptr), begin_(name_ ? Now() : 0) {}
+
+    ~Zone() {
+      if (name_)
+        Record(name_, begin_, Now());
+    }
+
+  private:
+    const char* name_;
+    long long begin_;
+  };
+
+  /**
+   * Starts recording, before the threads that record are started
+   */
+  static void Enable();
+
+  /**
+   * Checks if the zones are recorded
+   */
+  static bool IsEnabled() { return enabled_; }
+
+  /**
+   * Names the track of the calling thread
+   */
+  static void SetThreadName(const std::string& name);
+
+  /**
+   * Obtains the nanoseconds since the profiler was enabled
+   */
+  static long long Now();
+
+  /**
+   * Records a zone of the calling thread, in nanoseconds of Now()
+   */
+  static void Record(const char* name, long long begin, long long end);
+
+  /**
+   * Records a zone of the gpu track, in nanoseconds of Now(); the zones are
+   * added by one thread, the one that reads the gpu times
+   */
+  static void RecordGpu(const std::string& name, long long begin,
+                        long long end);
+
+  /**
+   * Writes the zones recorded so far in the Chrome trace event format, as
+   * loaded by chrome://tracing and Perfetto
+   * Throws runtime_error if the file can't be written
+   */
+  static void Write(const std::string& path);
+
+private:
+  static bool enabled_;
+};
+
+#endif
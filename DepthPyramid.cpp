@@ -0,0 +1,131 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+
+#include "DepthPyramid.h"
+#include "GLCheck.h"
+#include "GLState.h"
+
+namespace {
+
+// Threads per side of the work groups of the reduction shaders
+const int GROUP_SIZE = 8;
+
+// Dispatches a reduction shader over a level of a size
+void DispatchLevel(int width, int height) {
+  glDispatchCompute((width + GROUP_SIZE - 1) / GROUP_SIZE,
+                    (height + GROUP_SIZE - 1) / GROUP_SIZE, 1);
+}
+
+}  // namespace
+
+DepthPyramid::DepthPyramid()
+    : texture_(0), width_(0), height_(0), n_levels_(0), built_(false) {}
+
+DepthPyramid::~DepthPyramid() {
+  if (texture_)
+    GLState::DeleteTextures(1, &texture_);
+}
+
+void DepthPyramid::Init(int samples, bool closest) {
+  auto group_size = std::to_string(GROUP_SIZE);
+  auto depth_header = ShaderProgram::GenerateDefines(
+      {{"GROUP_SIZE", group_size},
+       {"FROM_DEPTH", "1"},
+       {"SAMPLES", std::to_string(std::max(samples, 1))},
+       {"MULTISAMPLED", samples ? "1" : "0"},
+       {"CLOSEST", closest ? "1" : "0"}});
+  depth_shader_.LoadComputeShader("shaders/hiz_cs.glsl", depth_header);
+  depth_shader_.LinkShader();
+  auto reduce_header = ShaderProgram::GenerateDefines(
+      {{"GROUP_SIZE", group_size},
+       {"FROM_DEPTH", "0"},
+       {"CLOSEST", closest ? "1" : "0"}});
+  reduce_shader_.LoadComputeShader("shaders/hiz_cs.glsl", reduce_header);
+  reduce_shader_.LinkShader();
+}
+
+void DepthPyramid::Build(FrameBuffer* framebuffer,
+                         const glm::mat4& view_projection) {
+  int width = framebuffer->GetWidth();
+  int height = framebuffer->GetHeight();
+  if (width <= 0 || height <= 0)
+    return;
+  if (width != width_ || height != height_)
+    Allocate(width, height);
+
+  // The depth buffer may be larger than the rendered size, only its lower
+  // left corner is copied
+  depth_shader_.Enable();
+  GLState::BindTexture(0, framebuffer->GetDepthTexture());
+  depth_shader_.SetUniform("depth_texture", 0);
+  glBindImageTexture(0, texture_, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R32F);
+  depth_shader_.SetUniform("level_image", 0);
+  DispatchLevel(width, height);
+
+  reduce_shader_.Enable();
+  reduce_shader_.SetUniform("previous_image", 0);
+  reduce_shader_.SetUniform("level_image", 1);
+  for (int level = 1; level < n_levels_; ++level) {
+    glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+    glBindImageTexture(0, texture_, level - 1, GL_FALSE, 0, GL_READ_ONLY,
+                       GL_R32F);
+    glBindImageTexture(1, texture_, level, GL_FALSE, 0, GL_WRITE_ONLY,
+                       GL_R32F);
+    DispatchLevel(std::max(width >> level, 1), std::max(height >> level, 1));
+  }
+  glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+  view_projection_ = view_projection;
+  built_ = true;
+}
+
+void DepthPyramid::Bind(ShaderProgram* shader, int unit) {
+  // No sampler object, the levels are read with texelFetch
+  unsigned int sampler = 0;
+  GLState::BindTexture(unit, texture_);
+  GLState::BindSamplers(unit, 1, &sampler);
+  shader->SetUniform("depth_pyramid", unit);
+  shader->SetUniform("pyramid_view_projection", view_projection_);
+  shader->SetUniform("pyramid_size", glm::vec2(width_, height_));
+  shader->SetUniform("pyramid_levels", built_ ? n_levels_ : 0);
+}
+
+void DepthPyramid::Allocate(int width, int height) {
+  if (texture_)
+    GLState::DeleteTextures(1, &texture_);
+  width_ = width;
+  height_ = height;
+  n_levels_ = 1 + (int)std::log2(std::max(width, height));
+  glCreateTextures(GL_TEXTURE_2D, 1, &texture_);
+  glTextureStorage2D(texture_, n_levels_, GL_R32F, width, height);
+  glTextureParameteri(texture_, GL_TEXTURE_MIN_FILTER,
+                      GL_NEAREST_MIPMAP_NEAREST);
+  glTextureParameteri(texture_, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  // The old contents don't match the new size
+  built_ = false;
+}
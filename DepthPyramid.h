@@ -0,0 +1,97 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef DEPTHPYRAMID_H
+#define DEPTHPYRAMID_H
+
+#include <glm/glm.hpp>
+
+#include "FrameBuffer.h"
+#include "ShaderProgram.h"
+
+/**
+ * Hierarchical depth buffer (Hi-Z), for occlusion culling, or with the
+ * closest depths for tracing rays (see ScreenReflections)
+ *
+ * The first level is a copy of the depth buffer, the farthest of its samples
+ * when it is multisampled, and each further level halves the previous one
+ * and keeps the farthest depth of the texels it covers. A sphere whose
+ * nearest depth is farther than every texel under its screen rectangle, at
+ * the level where that rectangle covers at most 2x2 texels, is hidden (see
+ * shaders/cull_cs.glsl). The pyramid remembers the view projection it was
+ * built with, so the next frame can be culled against it before anything is
+ * drawn. A pyramid of the closest depths keeps the nearest one instead, so
+ * a ray in front of a texel is in front of everything it covers.
+ */
+class DepthPyramid {
+public:
+  /**
+   * Default constructor
+   */
+  DepthPyramid();
+
+  /**
+   * Destructor
+   */
+  ~DepthPyramid();
+
+  /**
+   * Creates the reduction shaders, for depth buffers with the samples, of
+   * the farthest or the closest depths
+   * Throws runtime_error if a shader doesn't compile
+   */
+  void Init(int samples, bool closest = false);
+
+  /**
+   * Builds the pyramid from the depth texture of a frame buffer, rendered
+   * with the view projection
+   * The storage is reallocated when the size of the frame buffer changes
+   */
+  void Build(FrameBuffer* framebuffer, const glm::mat4& view_projection);
+
+  /**
+   * Binds the pyramid to a texture unit and sets the uniforms of a shader
+   * that tests against it (depth_pyramid, pyramid_view_projection,
+   * pyramid_size and pyramid_levels); until the first Build there are no
+   * levels, so nothing is hidden
+   */
+  void Bind(ShaderProgram* shader, int unit);
+
+private:
+  /**
+   * Creates the texture with every level of a size
+   */
+  void Allocate(int width, int height);
+
+  ShaderProgram depth_shader_;   // copies the depth buffer to the first level
+  ShaderProgram reduce_shader_;  // halves a level into the next one
+  unsigned int texture_;
+  int width_;
+  int height_;
+  int n_levels_;
+  bool built_;
+  glm::mat4 view_projection_;
+};
+
+#endif
@@ -0,0 +1,120 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <algorithm>
+#include <cmath>
+
+#include "DynamicResolution.h"
+#include "GLCheck.h"
+
+namespace {
+
+// Queries in the ring, more than the frames the gpu may lag behind
+const int N_QUERIES = 6;
+
+// Share of the distance to the wanted scale moved per measured frame
+const float SCALE_DAMPING = 0.2f;
+
+// Steps of the scale, so small noise in the timings doesn't resize
+const float SCALE_STEP = 1.0f / 32;
+
+}  // namespace
+
+DynamicResolution::DynamicResolution()
+    : next_(0), target_ms_(0), min_scale_(1), scale_(1), gpu_time_(0) {}
+
+DynamicResolution::~DynamicResolution() {
+  if (!queries_.empty())
+    glDeleteQueries(queries_.size(), queries_.data());
+}
+
+void DynamicResolution::Init(float target_ms, float min_scale) {
+  target_ms_ = target_ms;
+  SetMinScale(min_scale);
+  queries_.resize(N_QUERIES);
+  glCreateQueries(GL_TIME_ELAPSED, N_QUERIES, queries_.data());
+  pending_.assign(N_QUERIES, false);
+}
+
+void DynamicResolution::BeginTiming() {
+  // A query still in flight after a whole ring is skipped, not waited for
+  if (pending_[next_]) {
+    next_ = -1;
+    return;
+  }
+  glBeginQuery(GL_TIME_ELAPSED, queries_[next_]);
+}
+
+void DynamicResolution::EndTiming() {
+  if (next_ < 0) {
+    next_ = 0;
+    return;
+  }
+  glEndQuery(GL_TIME_ELAPSED);
+  pending_[next_] = true;
+  next_ = (next_ + 1) % N_QUERIES;
+}
+
+bool DynamicResolution::Update() {
+  // The queries finish in order, so the newest available one is the latest
+  bool measured = false;
+  for (int i = 0; i < N_QUERIES; ++i) {
+    int query = (next_ + i) % N_QUERIES;
+    if (!pending_[query])
+      continue;
+    GLint available = 0;
+    glGetQueryObjectiv(queries_[query], GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available)
+      break;
+    GLuint64 nanoseconds = 0;
+    glGetQueryObjectui64v(queries_[query], GL_QUERY_RESULT, &nanoseconds);
+    gpu_time_ = nanoseconds / 1e6f;
+    pending_[query] = false;
+    measured = true;
+  }
+  if (!measured || gpu_time_ <= 0)
+    return false;
+
+  float wanted = scale_ * std::sqrt(target_ms_ / gpu_time_);
+  wanted = std::min(std::max(wanted, min_scale_), 1.0f);
+  // Moves by at least a step once the wanted scale is a step away
+  if (std::abs(wanted - scale_) < SCALE_STEP)
+    return false;
+  float delta = (wanted - scale_) * SCALE_DAMPING;
+  delta = std::copysign(std::max(std::abs(delta), SCALE_STEP), delta);
+  float scale = std::round((scale_ + delta) / SCALE_STEP) * SCALE_STEP;
+  scale = std::min(std::max(scale, min_scale_), 1.0f);
+  if (scale == scale_)
+    return false;
+  scale_ = scale;
+  return true;
+}
+
+void DynamicResolution::SetMinScale(float min_scale) {
+  min_scale_ = std::min(std::max(min_scale, SCALE_STEP), 1.0f);
+}
+
+float DynamicResolution::GetScale() { return scale_; }
+
+float DynamicResolution::GetGpuTime() { return gpu_time_; }
@@ -0,0 +1,95 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef DYNAMICRESOLUTION_H
+#define DYNAMICRESOLUTION_H
+
+#include <vector>
+
+/**
+ * Scale of the internal resolution driven by the measured gpu time
+ *
+ * The gpu time of the timed passes is measured with a ring of
+ * GL_TIME_ELAPSED queries, read a few frames later when available so the
+ * cpu never waits for them. As the time of those passes grows with the
+ * pixels, the scale moves toward sqrt(target / measured) of the current one,
+ * damped and in steps, so it follows load changes without oscillating.
+ */
+class DynamicResolution {
+public:
+  /**
+   * Default constructor
+   */
+  DynamicResolution();
+
+  /**
+   * Destructor
+   */
+  ~DynamicResolution();
+
+  /**
+   * Creates the queries, with the gpu time aimed at in milliseconds and the
+   * lowest scale of each dimension
+   */
+  void Init(float target_ms, float min_scale);
+
+  /**
+   * Starts and ends the timing of the passes of the frame
+   */
+  void BeginTiming();
+  void EndTiming();
+
+  /**
+   * Reads the finished timings and adjusts the scale
+   * Returns true if the scale changed
+   */
+  bool Update();
+
+  /**
+   * Changes the lowest scale; a scale below it rises to it over the next
+   * updates, as it would toward a wanted one
+   */
+  void SetMinScale(float min_scale);
+
+  /**
+   * Obtains the scale of the width and the height, in [min scale, 1]
+   */
+  float GetScale();
+
+  /**
+   * Obtains the last gpu time measured, in milliseconds
+   */
+  float GetGpuTime();
+
+private:
+  std::vector<unsigned int> queries_;
+  std::vector<bool> pending_;  // issued and not read yet
+  int next_;                   // query of the next frame
+  float target_ms_;
+  float min_scale_;
+  float scale_;
+  float gpu_time_;
+};
+
+#endif
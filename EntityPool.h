@@ -0,0 +1,138 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef ENTITYPOOL_H
+#define ENTITYPOOL_H
+
+#include <vector>
+
+/**
+ * Elements kept contiguous behind stable handles
+ *
+ * The elements are dense in insertion order, so the passes over all of them
+ * walk a single array with no indirection; only the lookups by handle go
+ * through the index of each one. A removal moves the last element into the
+ * freed place, and the handle is given to a later element.
+ */
+template <typename T>
+class EntityPool {
+public:
+  /**
+   * Appends an element
+   * Returns its handle
+   */
+  int Add(const T& element) {
+    int handle;
+    if (free_handles_.empty()) {
+      handle = indices_.size();
+      indices_.push_back(0);
+    } else {
+      handle = free_handles_.back();
+      free_handles_.pop_back();
+    }
+    indices_[handle] = elements_.size();
+    handles_.push_back(handle);
+    elements_.push_back(element);
+    return handle;
+  }
+
+  /**
+   * Removes the element of a handle
+   * Returns the index that now holds the former last element, or -1 if the
+   * removed element was the last one
+   */
+  int Remove(int handle) {
+    int index = indices_[handle];
+    int last = elements_.size() - 1;
+    int moved = -1;
+    if (index != last) {
+      elements_[index] = elements_[last];
+      handles_[index] = handles_[last];
+      indices_[handles_[index]] = index;
+      moved = index;
+    }
+    elements_.pop_back();
+    handles_.pop_back();
+    indices_[handle] = -1;
+    free_handles_.push_back(handle);
+    return moved;
+  }
+
+  /**
+   * Moves the element at index order[i] to index i, for each index; the
+   * handles keep their elements
+   */
+  void Reorder(const int* order) {
+    int n = elements_.size();
+    reordered_elements_.resize(n);
+    reordered_handles_.resize(n);
+    for (int i = 0; i < n; ++i) {
+      reordered_elements_[i] = elements_[order[i]];
+      reordered_handles_[i] = handles_[order[i]];
+      indices_[reordered_handles_[i]] = i;
+    }
+    // The old arrays keep their capacity for the next reorder
+    elements_.swap(reordered_elements_);
+    handles_.swap(reordered_handles_);
+  }
+
+  /**
+   * Checks if a handle was added and not removed since
+   */
+  bool Contains(int handle) const {
+    return handle >= 0 && handle < (int)indices_.size() &&
+           indices_[handle] >= 0;
+  }
+
+  /**
+   * Obtains the index of the element of a handle
+   */
+  int GetIndex(int handle) const { return indices_[handle]; }
+
+  /**
+   * Obtains the element of a handle
+   */
+  T& Get(int handle) { return elements_[indices_[handle]]; }
+
+  /**
+   * Obtains the number of elements
+   */
+  int GetSize() const { return elements_.size(); }
+
+  /**
+   * Obtains the contiguous elements
+   */
+  T* GetData() { return elements_.data(); }
+  const T* GetData() const { return elements_.data(); }
+
+private:
+  std::vector<T> elements_;
+  std::vector<int> handles_;       // of each element
+  std::vector<int> indices_;       // of each handle, -1 once removed
+  std::vector<int> free_handles_;
+  std::vector<T> reordered_elements_;
+  std::vector<int> reordered_handles_;
+};
+
+#endif
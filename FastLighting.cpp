@@ -0,0 +1,56 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <algorithm>
+#include <cmath>
+
+#include "FastLighting.h"
+
+float FastPow(float x, float n) {
+  // x^n = x e^((n - 1) ln x) and ln x ~ x - 1 near 1, where the lobe is;
+  // the factor x keeps n = 1 exact and the term zero at 90 degrees
+  return x * std::exp2((n - 1) * 1.442695f * (x - 1));
+}
+
+FastLightingReport ComputeFastLightingError() {
+  const int n_angles = 10000;
+  const float exponents[] = {1, 2, 4, 8, 16, 32, 64, 128, 256};
+  FastLightingReport report = {0, 0, 0};
+  int n_samples = 0;
+  for (float n : exponents) {
+    for (int i = 0; i < n_angles; ++i) {
+      double angle = (i + 0.5) / n_angles * M_PI / 2;
+      float x = (float)std::cos(angle);
+      double err = std::abs(FastPow(x, n) - std::pow((double)x, (double)n));
+      report.mean_error += err;
+      if (err > report.max_error) {
+        report.max_error = err;
+        report.max_error_exponent = n;
+      }
+      ++n_samples;
+    }
+  }
+  report.mean_error /= n_samples;
+  return report;
+}
@@ -0,0 +1,50 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef FASTLIGHTING_H
+#define FASTLIGHTING_H
+
+/**
+ * Spherical gaussian fit of x^n for x in [0, 1], used by the specular and
+ * spot terms of the fast lighting variant (--fast-lighting)
+ * Mirrors fast_pow in shaders/lighting.glsl
+ */
+float FastPow(float x, float n);
+
+/**
+ * Error of the fast lighting terms compared to exact pow
+ */
+struct FastLightingReport {
+  double mean_error;  // absolute, over the angles and the exponents
+  double max_error;
+  double max_error_exponent;  // exponent of the largest error
+};
+
+/**
+ * Measures the error of FastPow over the angles from 0 to 90 degrees and the
+ * exponents from 1 to 256 of the materials and spot lights
+ */
+FastLightingReport ComputeFastLightingError();
+
+#endif
@@ -0,0 +1,64 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef FILEWATCHER_H
+#define FILEWATCHER_H
+
+#include <string>
+
+/**
+ * Watches the files of a directory for writes, without blocking
+ *
+ * Uses inotify, so it only notices changes on Linux; elsewhere Poll() never
+ * reports any. Editors that save through a temporary file and a rename are
+ * noticed too.
+ */
+class FileWatcher {
+public:
+  /**
+   * Default constructor, watches nothing
+   */
+  FileWatcher();
+
+  /**
+   * Destructor
+   */
+  ~FileWatcher();
+
+  /**
+   * Starts watching the files of a directory
+   * Throws runtime_error if the directory can't be watched
+   */
+  void Init(const std::string& directory);
+
+  /**
+   * Checks if a file was written since the last call, without waiting
+   */
+  bool Poll();
+
+private:
+  int fd_;
+};
+
+#endif
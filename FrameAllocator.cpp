@@ -0,0 +1,99 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <cstdlib>
+#include <new>
+
+#include "FrameAllocator.h"
+
+namespace {
+
+// Alignment of every allocation, enough for any scalar or glm type
+const size_t ALIGNMENT = alignof(std::max_align_t);
+
+// Size of the block before a frame needs more
+const size_t INITIAL_CAPACITY = 64 * 1024;
+
+// Heap allocations of the thread
+thread_local long long heap_allocations = 0;
+
+}  // namespace
+
+std::vector<char*> FrameAllocator::overflow_;
+char* FrameAllocator::block_ = nullptr;
+size_t FrameAllocator::capacity_ = 0;
+size_t FrameAllocator::used_ = 0;
+size_t FrameAllocator::frame_bytes_ = 0;
+
+void* FrameAllocator::Allocate(size_t bytes) {
+  bytes = (bytes + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+  if (!block_) {
+    capacity_ = INITIAL_CAPACITY;
+    block_ = static_cast<char*>(std::malloc(capacity_));
+  }
+  char* memory;
+  if (used_ + bytes <= capacity_) {
+    memory = block_ + used_;
+  } else {
+    memory = static_cast<char*>(std::malloc(bytes));
+    overflow_.push_back(memory);
+  }
+  used_ += bytes;
+  return memory;
+}
+
+void FrameAllocator::Reset() {
+  frame_bytes_ = used_;
+  if (!overflow_.empty()) {
+    for (auto memory : overflow_)
+      std::free(memory);
+    overflow_.clear();
+    // The next frames fit, with room for some growth
+    std::free(block_);
+    capacity_ = used_ + used_ / 2;
+    block_ = static_cast<char*>(std::malloc(capacity_));
+  }
+  used_ = 0;
+}
+
+size_t FrameAllocator::GetFrameBytes() { return frame_bytes_; }
+
+size_t FrameAllocator::GetCapacity() { return capacity_; }
+
+long long FrameAllocator::GetHeapAllocations() { return heap_allocations; }
+
+// Replacements of the global allocation functions that count the heap
+// allocations; the other forms of new and delete call these
+void* operator new(size_t bytes) {
+  heap_allocations++;
+  if (void* memory = std::malloc(bytes ? bytes : 1))
+    return memory;
+  throw std::bad_alloc();
+}
+
+void* operator new[](size_t bytes) { return operator new(bytes); }
+
+void operator delete(void* memory) noexcept { std::free(memory); }
+
+void operator delete[](void* memory) noexcept { std::free(memory); }
@@ -0,0 +1,104 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef FRAMEALLOCATOR_H
+#define FRAMEALLOCATOR_H
+
+#include <cstddef>
+#include <vector>
+
+/**
+ * Linear allocator of the transient data of a frame on the render thread,
+ * and count of the heap allocations of each thread
+ *
+ * Allocations bump a pointer through a block that Reset() rewinds at the
+ * start of every frame; freeing does nothing. When a frame needs more than
+ * the block, the extra memory comes from the heap and the next Reset()
+ * replaces the block with one that fits the whole frame, so the steady state
+ * doesn't touch the heap. The memory is only valid until the next Reset(),
+ * and only the render thread may use it.
+ *
+ * The global operator new is replaced to count the heap allocations of the
+ * calling thread, which shows the frame doing none.
+ */
+class FrameAllocator {
+public:
+  /**
+   * Standard allocator of the frame memory, for FrameVector
+   */
+  template <typename T>
+  struct Allocator {
+    typedef T value_type;
+
+    Allocator() {}
+    template <typename U>
+    Allocator(const Allocator<U>&) {}
+
+    T* allocate(size_t n) {
+      return static_cast<T*>(FrameAllocator::Allocate(n * sizeof(T)));
+    }
+    void deallocate(T*, size_t) {}
+
+    template <typename U>
+    bool operator==(const Allocator<U>&) const { return true; }
+    template <typename U>
+    bool operator!=(const Allocator<U>&) const { return false; }
+  };
+
+  /**
+   * Allocates bytes valid until the next reset, aligned for any type
+   */
+  static void* Allocate(size_t bytes);
+
+  /**
+   * Frees the memory of the frame, once per frame
+   */
+  static void Reset();
+
+  /**
+   * Obtains the bytes the last frame allocated, and the size of the block
+   */
+  static size_t GetFrameBytes();
+  static size_t GetCapacity();
+
+  /**
+   * Obtains the number of heap allocations made by the calling thread
+   */
+  static long long GetHeapAllocations();
+
+private:
+  static std::vector<char*> overflow_;  // heap memory of the current frame
+  static char* block_;
+  static size_t capacity_;
+  static size_t used_;
+  static size_t frame_bytes_;  // of the last frame
+};
+
+/**
+ * Vector in the memory of the frame
+ */
+template <typename T>
+using FrameVector = std::vector<T, FrameAllocator::Allocator<T>>;
+
+#endif
@@ -22,80 +22,214 @@
  * SOFTWARE.
  */
 
+#include <algorithm>
 #include <stdexcept>
-
-#include <GL/glew.h>
+#include <utility>
 
 #include "FrameBuffer.h"
+#include "GLCheck.h"
+#include "GLDebug.h"
+#include "GLState.h"
+#include "GpuMemory.h"
+
+namespace {
+
+// The capacity is a multiple of this value
+const int CAPACITY_GRANULARITY = 256;
+
+// Checks if a base format is of unnormalized integers, cleared as such
+bool IsInteger(int base_format) {
+  return base_format == GL_RED_INTEGER || base_format == GL_RG_INTEGER ||
+         base_format == GL_RGB_INTEGER || base_format == GL_RGBA_INTEGER;
+}
+
+}  // namespace
 
 FrameBuffer::FrameBuffer()
     : width_(16),
       height_(16),
+      capacity_width_(0),
+      capacity_height_(0),
+      allocations_(0),
+      allocated_bytes_(0),
+      samples_(0),
       framebuffer_(0),
       depthbuffer_(0),
-      current_texture_(0) {}
+      sampler_(0),
+      depth_mode_(DEPTH_NONE),
+      depth_source_(nullptr),
+      load_actions_(1, ACTION_PRESERVE),
+      store_actions_(1, ACTION_PRESERVE),
+      clear_color_{0, 0, 0, 0} {}
+
+FrameBuffer::~FrameBuffer() { Release(); }
+
+FrameBuffer::FrameBuffer(FrameBuffer&& other) : FrameBuffer() {
+  *this = std::move(other);
+}
+
+FrameBuffer& FrameBuffer::operator=(FrameBuffer&& other) {
+  if (this == &other)
+    return *this;
+  Release();
+  width_ = other.width_;
+  height_ = other.height_;
+  capacity_width_ = other.capacity_width_;
+  capacity_height_ = other.capacity_height_;
+  allocations_ = other.allocations_;
+  allocated_bytes_ = other.allocated_bytes_;
+  samples_ = other.samples_;
+  framebuffer_ = other.framebuffer_;
+  depthbuffer_ = other.depthbuffer_;
+  sampler_ = other.sampler_;
+  depth_mode_ = other.depth_mode_;
+  depth_source_ = other.depth_source_;
+  textures_ = std::move(other.textures_);
+  textures_infos_ = std::move(other.textures_infos_);
+  load_actions_ = std::move(other.load_actions_);
+  store_actions_ = std::move(other.store_actions_);
+  std::copy(other.clear_color_, other.clear_color_ + 4, clear_color_);
+  label_ = std::move(other.label_);
+  // The other one has nothing left to delete
+  other.allocated_bytes_ = 0;
+  other.framebuffer_ = 0;
+  other.depthbuffer_ = 0;
+  other.sampler_ = 0;
+  other.depth_mode_ = DEPTH_NONE;
+  other.depth_source_ = nullptr;
+  other.textures_.clear();
+  other.textures_infos_.clear();
+  return *this;
+}
 
-FrameBuffer::~FrameBuffer() {
+void FrameBuffer::Release() {
+  GpuMemory::Free(GpuMemory::FRAMEBUFFERS, allocated_bytes_);
   if (framebuffer_)
     glDeleteFramebuffers(1, &framebuffer_);
-  if (depthbuffer_)
+  if (HasDepthTexture() && !depth_source_)
+    GLState::DeleteTextures(1, &depthbuffer_);
+  else if (depth_mode_ == DEPTH_RENDERBUFFER)
     glDeleteRenderbuffers(1, &depthbuffer_);
-  glDeleteTextures(textures_.size(), textures_.data());
+  GLState::DeleteTextures(textures_.size(), textures_.data());
+  if (sampler_)
+    GLState::DeleteSampler(sampler_);
 }
 
-void FrameBuffer::Init(int width, int height) {
+void FrameBuffer::Init(int width, int height, DepthMode depth_mode,
+                       int samples) {
   width_ = width;
   height_ = height;
+  capacity_width_ = ComputeCapacity(width);
+  capacity_height_ = ComputeCapacity(height);
+  depth_mode_ = depth_mode;
+  samples_ = samples > 1 ? samples : 0;
+  allocations_ = 1;
 
   glGenFramebuffers(1, &framebuffer_);
-  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer_);
-
-  glGenRenderbuffers(1, &depthbuffer_);
-  glBindRenderbuffer(GL_RENDERBUFFER, depthbuffer_);
-  glFramebufferRenderbuffer(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
-                            GL_RENDERBUFFER, depthbuffer_);
-  glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT32, width, height);
+  // The textures are read with texelFetch, the sampler only makes them
+  // complete without mipmaps
+  glCreateSamplers(1, &sampler_);
+  glSamplerParameteri(sampler_, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glSamplerParameteri(sampler_, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glSamplerParameteri(sampler_, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glSamplerParameteri(sampler_, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  if (depth_mode_ != DEPTH_NONE) {
+    CreateDepthBuffer();
+    AttachDepthBuffer();
+  }
+  UpdateAllocatedBytes();
+  ApplyLabels();
+}
 
-  glBindRenderbuffer(GL_RENDERBUFFER, 0);
-  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+void FrameBuffer::ShareDepth(FrameBuffer* source) {
+  if (!source->GetDepthTexture())
+    throw std::runtime_error("The source frame buffer has no depth texture");
+  if (depth_mode_ == DEPTH_RENDERBUFFER)
+    glDeleteRenderbuffers(1, &depthbuffer_);
+  else if (HasDepthTexture() && !depth_source_)
+    GLState::DeleteTextures(1, &depthbuffer_);
+  depth_mode_ = source->depth_mode_;
+  depth_source_ = source;
+  depthbuffer_ = source->GetDepthTexture();
+  AttachDepthBuffer();
+  UpdateAllocatedBytes();
 }
 
 void FrameBuffer::Resize(int width, int height) {
   width_ = width;
   height_ = height;
+  if (!NeedsReallocation(width, height))
+    return;
 
+  capacity_width_ = ComputeCapacity(width);
+  capacity_height_ = ComputeCapacity(height);
+  AllocateStorage();
+}
+
+void FrameBuffer::AddColorTexture(int internal_format, int base_format,
+                                  int type) {
+  auto texture = CreateTexture(internal_format);
+  auto attachment = GL_COLOR_ATTACHMENT0 + textures_.size();
   glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer_);
+  glFramebufferTexture(GL_DRAW_FRAMEBUFFER, attachment, texture, 0);
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+  textures_.push_back(texture);
+  textures_infos_.push_back({ internal_format, base_format, type, true });
+  load_actions_.insert(load_actions_.end() - 1, ACTION_PRESERVE);
+  store_actions_.insert(store_actions_.end() - 1, ACTION_PRESERVE);
+  UpdateAllocatedBytes();
+  ApplyLabels();
+}
+
+void FrameBuffer::SetLoadAction(int attachment, Action action) {
+  GetAction(load_actions_, attachment) = action;
+}
+
+void FrameBuffer::SetStoreAction(int attachment, Action action) {
+  if (action == ACTION_CLEAR)
+    throw std::runtime_error("Clear isn't a valid store action");
+  GetAction(store_actions_, attachment) = action;
+}
+
+void FrameBuffer::SetSampled(int attachment, bool sampled) {
+  textures_infos_[attachment].sampled = sampled;
+}
+
+void FrameBuffer::SetLabel(const std::string& label) {
+  label_ = label;
+  ApplyLabels();
+}
 
-  glBindRenderbuffer(GL_RENDERBUFFER, depthbuffer_);
-  glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT32, width, height);
-  glBindRenderbuffer(GL_RENDERBUFFER, 0);
+void FrameBuffer::SetClearColor(float red, float green, float blue,
+                                float alpha) {
+  clear_color_[0] = red;
+  clear_color_[1] = green;
+  clear_color_[2] = blue;
+  clear_color_[3] = alpha;
+}
 
+void FrameBuffer::Load() {
+  const float one = 1;
+  const GLuint zeros[4] = {0, 0, 0, 0};
   for (size_t i = 0; i < textures_.size(); ++i) {
-    glBindTexture(GL_TEXTURE_2D, textures_[i]);
-    glTexImage2D(GL_TEXTURE_2D, 0, textures_infos_[i].internal_format, width_,
-                 height_, 0, textures_infos_[i].base_format,
-                 textures_infos_[i].type, 0);
-    glBindTexture(GL_TEXTURE_2D, 0);
+    if (load_actions_[i] != ACTION_CLEAR)
+      continue;
+    if (IsInteger(textures_infos_[i].base_format))
+      glClearBufferuiv(GL_COLOR, i, zeros);
+    else
+      glClearBufferfv(GL_COLOR, i, clear_color_);
   }
-
-  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+  if (depth_mode_ == DEPTH_STENCIL_TEXTURE &&
+      load_actions_.back() == ACTION_CLEAR)
+    glClearBufferfi(GL_DEPTH_STENCIL, 0, one, 0);
+  else if (depth_mode_ != DEPTH_NONE && load_actions_.back() == ACTION_CLEAR)
+    glClearBufferfv(GL_DEPTH, 0, &one);
+  Invalidate(load_actions_);
 }
 
-void FrameBuffer::AddColorTexture(int internal_format, int base_format,
-                                  int type) {
+void FrameBuffer::Store() {
   glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer_);
-  unsigned int texture;
-  glGenTextures(1, &texture);
-  glBindTexture(GL_TEXTURE_2D, texture);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-  glTexImage2D(GL_TEXTURE_2D, 0, internal_format, width_, height_, 0,
-               base_format, type, 0);
-  auto attachment = GL_COLOR_ATTACHMENT0 + current_texture_++;
-  glFramebufferTexture(GL_DRAW_FRAMEBUFFER, attachment, texture, 0);
-  textures_.push_back(texture);
-  textures_infos_.push_back({ internal_format, base_format, type });
-  glBindTexture(GL_TEXTURE_2D, 0);
+  Invalidate(store_actions_);
   glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
 }
 
@@ -108,11 +242,17 @@ void FrameBuffer::Verify() {
 }
 
 void FrameBuffer::Bind() {
+  // The source may have reallocated the shared depth texture
+  if (depth_source_ && depthbuffer_ != depth_source_->GetDepthTexture()) {
+    depthbuffer_ = depth_source_->GetDepthTexture();
+    AttachDepthBuffer();
+  }
   glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer_);
   std::vector<GLenum> attachments;
   for (size_t i = 0; i < textures_.size(); ++i)
     attachments.push_back(GL_COLOR_ATTACHMENT0 + i);
   glDrawBuffers(attachments.size(), attachments.data());
+  glViewport(0, 0, width_, height_);
 }
 
 void FrameBuffer::Unbind() { glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0); }
@@ -121,11 +261,176 @@ const std::vector<unsigned int>& FrameBuffer::GetTextures() {
   return textures_;
 }
 
-void FrameBuffer::UpdateDepthBufferSize(int width, int height) {
+unsigned int FrameBuffer::GetDepthTexture() {
+  return HasDepthTexture() ? depthbuffer_ : 0;
+}
+
+void FrameBuffer::BindTextures(int first_unit) {
+  std::vector<unsigned int> textures;
+  for (size_t i = 0; i < textures_.size(); ++i)
+    if (textures_infos_[i].sampled)
+      textures.push_back(textures_[i]);
+  textures.push_back(GetDepthTexture());
+  std::vector<unsigned int> samplers(textures.size(), sampler_);
+  GLState::BindTextures(first_unit, textures.size(), textures.data());
+  GLState::BindSamplers(first_unit, samplers.size(), samplers.data());
+}
+
+unsigned int FrameBuffer::GetSampler() { return sampler_; }
+
+int FrameBuffer::GetSamples() { return samples_; }
+
+unsigned int FrameBuffer::GetHandle() { return framebuffer_; }
+
+int FrameBuffer::GetWidth() { return width_; }
+
+int FrameBuffer::GetHeight() { return height_; }
+
+int FrameBuffer::GetCapacityWidth() { return capacity_width_; }
+
+int FrameBuffer::GetCapacityHeight() { return capacity_height_; }
+
+int FrameBuffer::GetAllocations() { return allocations_; }
+
+long FrameBuffer::GetAllocatedBytes() { return allocated_bytes_; }
+
+int FrameBuffer::ComputeCapacity(int size) {
+  auto n = (size + CAPACITY_GRANULARITY - 1) / CAPACITY_GRANULARITY;
+  return (n > 0 ? n : 1) * CAPACITY_GRANULARITY;
+}
+
+bool FrameBuffer::NeedsReallocation(int width, int height) {
+  // Grows as soon as needed, but only shrinks when both dimensions are below
+  // half of the capacity, so oscillating sizes don't reallocate
+  if (width > capacity_width_ || height > capacity_height_)
+    return true;
+  return width <= capacity_width_ / 2 && height <= capacity_height_ / 2 &&
+         ComputeCapacity(width) < capacity_width_;
+}
+
+void FrameBuffer::AllocateStorage() {
+  allocations_++;
+  if (!textures_.empty())
+    GLState::DeleteTextures(textures_.size(), textures_.data());
   glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer_);
-  glBindRenderbuffer(GL_RENDERBUFFER, depthbuffer_);
-  glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT32, width, height);
-  glBindRenderbuffer(GL_RENDERBUFFER, 0);
+  for (size_t i = 0; i < textures_.size(); ++i) {
+    textures_[i] = CreateTexture(textures_infos_[i].internal_format);
+    glFramebufferTexture(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i,
+                         textures_[i], 0);
+  }
   glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+
+  if (depth_mode_ != DEPTH_NONE && !depth_source_) {
+    if (HasDepthTexture())
+      GLState::DeleteTextures(1, &depthbuffer_);
+    else
+      glDeleteRenderbuffers(1, &depthbuffer_);
+    CreateDepthBuffer();
+    AttachDepthBuffer();
+  }
+  UpdateAllocatedBytes();
+  ApplyLabels();
 }
 
+unsigned int FrameBuffer::CreateTexture(int internal_format) {
+  // Created without binding, so the texture units of GLState stay valid
+  unsigned int texture;
+  if (samples_) {
+    // Multisampled textures are only read with texelFetch, so they have no
+    // sampler state
+    glCreateTextures(GL_TEXTURE_2D_MULTISAMPLE, 1, &texture);
+    glTextureStorage2DMultisample(texture, samples_, internal_format,
+                                  capacity_width_, capacity_height_, GL_TRUE);
+    return texture;
+  }
+  // The filtering is the one of the sampler object (see BindTextures)
+  glCreateTextures(GL_TEXTURE_2D, 1, &texture);
+  glTextureStorage2D(texture, 1, internal_format, capacity_width_,
+                     capacity_height_);
+  return texture;
+}
+
+void FrameBuffer::CreateDepthBuffer() {
+  if (depth_mode_ == DEPTH_STENCIL_TEXTURE) {
+    depthbuffer_ = CreateTexture(GL_DEPTH32F_STENCIL8);
+  } else if (depth_mode_ == DEPTH_TEXTURE) {
+    depthbuffer_ = CreateTexture(GL_DEPTH_COMPONENT32);
+  } else {
+    glGenRenderbuffers(1, &depthbuffer_);
+    glBindRenderbuffer(GL_RENDERBUFFER, depthbuffer_);
+    glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples_,
+                                     GL_DEPTH_COMPONENT32, capacity_width_,
+                                     capacity_height_);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+  }
+}
+
+void FrameBuffer::UpdateAllocatedBytes() {
+  int texel_bytes = 0;
+  for (auto& info : textures_infos_)
+    texel_bytes += GpuMemory::GetFormatSize(info.internal_format);
+  if (depth_mode_ == DEPTH_STENCIL_TEXTURE && !depth_source_)
+    texel_bytes += GpuMemory::GetFormatSize(GL_DEPTH32F_STENCIL8);
+  else if (depth_mode_ != DEPTH_NONE && !depth_source_)
+    texel_bytes += GpuMemory::GetFormatSize(GL_DEPTH_COMPONENT32);
+  long bytes = (long)capacity_width_ * capacity_height_ *
+               std::max(samples_, 1) * texel_bytes;
+  GpuMemory::Free(GpuMemory::FRAMEBUFFERS, allocated_bytes_);
+  GpuMemory::Allocate(GpuMemory::FRAMEBUFFERS, bytes);
+  allocated_bytes_ = bytes;
+}
+
+void FrameBuffer::ApplyLabels() {
+  GLDebug::Label(GL_FRAMEBUFFER, framebuffer_, label_);
+  if (label_.empty())
+    return;
+  for (size_t i = 0; i < textures_.size(); ++i)
+    GLDebug::Label(GL_TEXTURE, textures_[i],
+                   label_ + ".color" + std::to_string(i));
+  // A shared depth buffer has the label of its source
+  if (depth_mode_ == DEPTH_NONE || depth_source_)
+    return;
+  GLDebug::Label(HasDepthTexture() ? GL_TEXTURE : GL_RENDERBUFFER,
+                 depthbuffer_, label_ + ".depth");
+}
+
+FrameBuffer::Action& FrameBuffer::GetAction(std::vector<Action>& actions,
+                                            int attachment) {
+  if (attachment == DEPTH_ATTACHMENT)
+    return actions.back();
+  if (attachment < 0 || attachment >= (int)textures_.size())
+    throw std::runtime_error("Invalid frame buffer attachment");
+  return actions[attachment];
+}
+
+void FrameBuffer::Invalidate(const std::vector<Action>& actions) {
+  std::vector<GLenum> attachments;
+  for (size_t i = 0; i < textures_.size(); ++i)
+    if (actions[i] == ACTION_DONT_CARE)
+      attachments.push_back(GL_COLOR_ATTACHMENT0 + i);
+  if (depth_mode_ != DEPTH_NONE && actions.back() == ACTION_DONT_CARE)
+    attachments.push_back(depth_mode_ == DEPTH_STENCIL_TEXTURE
+                              ? GL_DEPTH_STENCIL_ATTACHMENT
+                              : GL_DEPTH_ATTACHMENT);
+  if (!attachments.empty())
+    glInvalidateFramebuffer(GL_DRAW_FRAMEBUFFER, attachments.size(),
+                            attachments.data());
+}
+
+void FrameBuffer::AttachDepthBuffer() {
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, framebuffer_);
+  if (depth_mode_ == DEPTH_STENCIL_TEXTURE)
+    glFramebufferTexture(GL_DRAW_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT,
+                         depthbuffer_, 0);
+  else if (depth_mode_ == DEPTH_TEXTURE)
+    glFramebufferTexture(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+                         depthbuffer_, 0);
+  else
+    glFramebufferRenderbuffer(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+                              GL_RENDERBUFFER, depthbuffer_);
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+}
+
+bool FrameBuffer::HasDepthTexture() {
+  return depth_mode_ == DEPTH_TEXTURE || depth_mode_ == DEPTH_STENCIL_TEXTURE;
+}
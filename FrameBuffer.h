@@ -25,9 +25,14 @@
 #ifndef FRAMEBUFFER_H
 #define FRAMEBUFFER_H
 
+#include <string>
 #include <vector>
 
 /// Opengl frame buffer abstraction
+///
+/// The attachments are allocated with immutable storage at a capacity that is
+/// rounded up from the requested size. Resizing only changes the rendered
+/// sub-rect, unless the new size outgrows the capacity or is well below it.
 class FrameBuffer {
 public:
   /// Default constructor
@@ -36,49 +41,193 @@ public:
   /// Destructor
   ~FrameBuffer();
 
+  /// Takes the gl objects of another frame buffer, which is left empty
+  /// The frame buffers sharing the depth of the other one (see ShareDepth)
+  /// still point to it
+  FrameBuffer(FrameBuffer&& other);
+  FrameBuffer& operator=(FrameBuffer&& other);
+
+  /// A frame buffer owns its gl objects, so it can't be copied
+  FrameBuffer(const FrameBuffer&) = delete;
+  FrameBuffer& operator=(const FrameBuffer&) = delete;
+
+  /// How the depth attachment is created
+  enum DepthMode {
+    /// No depth attachment (or one shared later with ShareDepth)
+    DEPTH_NONE,
+    /// Private render buffer, can't be sampled
+    DEPTH_RENDERBUFFER,
+    /// Texture that can be sampled and shared with other frame buffers
+    DEPTH_TEXTURE,
+    /// Same as DEPTH_TEXTURE, with a stencil buffer (only the depth is
+    /// sampled)
+    DEPTH_STENCIL_TEXTURE
+  };
+
+  /// What happens to the contents of an attachment when its first pass of the
+  /// frame starts (load) and once its last reader is done (store)
+  enum Action {
+    /// Keeps the contents
+    ACTION_PRESERVE,
+    /// Clears to the clear color (the integer textures to zero, the depth to
+    /// one and the stencil to zero), only valid as a load action
+    ACTION_CLEAR,
+    /// Leaves the contents undefined, so the driver may skip the memory
+    /// traffic
+    ACTION_DONT_CARE
+  };
+
+  /// Attachment index of the depth buffer for the actions
+  static const int DEPTH_ATTACHMENT = -1;
+
   /// Creates the frame buffer
-  void Init(int width, int height);
+  /// With more than one sample the attachments are multisampled textures
+  void Init(int width, int height, DepthMode depth_mode = DEPTH_RENDERBUFFER,
+            int samples = 0);
+
+  /// Attaches the depth texture of another frame buffer
+  /// The source keeps the ownership and must be resized before this one
+  void ShareDepth(FrameBuffer* source);
 
   /// Changes the width and the height of the frame buffer
+  /// The storage is only reallocated when the capacity doesn't fit the size
   void Resize(int width, int height);
 
   /// Adds a color render buffer and creates an texture for it
   void AddColorTexture(int internal_format, int base_format, int type);
 
+  /// Sets the load action of a color attachment (or DEPTH_ATTACHMENT)
+  void SetLoadAction(int attachment, Action action);
+
+  /// Sets the store action of a color attachment (or DEPTH_ATTACHMENT)
+  void SetStoreAction(int attachment, Action action);
+
+  /// Keeps a color attachment out of BindTextures() if it isn't sampled, so
+  /// the units of the others and of the depth don't move
+  void SetSampled(int attachment, bool sampled);
+
+  /// Names the frame buffer and its attachments for debuggers (see GLDebug)
+  /// The attachments are named label.color<i> and label.depth
+  void SetLabel(const std::string& label);
+
+  /// Sets the value of the color attachments cleared by the load actions
+  /// (zero by default)
+  void SetClearColor(float red, float green, float blue, float alpha = 0);
+
+  /// Applies the load actions, the frame buffer must be bound
+  void Load();
+
+  /// Applies the store actions, once the contents have been consumed
+  void Store();
+
   /// Verifies if the frame buffer is complete
   void Verify();
 
-  /// Binds the frame buffer
+  /// Binds the frame buffer and sets the viewport to its size
   void Bind();
 
   /// Binds the default buffer
   void Unbind();
 
   /// Obtains the render buffers textures
+  /// The handles change when the storage is reallocated
   const std::vector<unsigned int>& GetTextures();
 
+  /// Obtains the depth texture (0 if the depth isn't a texture)
+  unsigned int GetDepthTexture();
+
+  /// Binds the sampled color textures and then the depth texture to consecutive
+  /// texture units with a nearest sampler, in one call for the textures and
+  /// one for the samplers (see GLState::BindTextures)
+  void BindTextures(int first_unit);
+
+  /// Obtains the nearest sampler object used to read the textures
+  unsigned int GetSampler();
+
+  /// Obtains the number of samples (0 if it isn't multisampled)
+  int GetSamples();
+
+  /// Obtains the frame buffer handle
+  unsigned int GetHandle();
+
+  /// Obtains the rendered size
+  int GetWidth();
+  int GetHeight();
+
+  /// Obtains the allocated size
+  int GetCapacityWidth();
+  int GetCapacityHeight();
+
+  /// Obtains how many times the storage was allocated
+  int GetAllocations();
+
+  /// Obtains the bytes of the attachments at the allocated size, without a
+  /// shared depth buffer (see GpuMemory)
+  long GetAllocatedBytes();
+
 private:
-  /// Updates the depthbuffer size
-  void UpdateDepthBufferSize(int width, int height);
+  /// Deletes the gl objects and gives their memory back to GpuMemory
+  void Release();
+
+  /// Rounds the size up to the capacity granularity
+  static int ComputeCapacity(int size);
+
+  /// Returns true if the capacity must change to fit the size
+  bool NeedsReallocation(int width, int height);
+
+  /// Recreates every attachment with the current capacity
+  void AllocateStorage();
 
-  /// Updates a texture size
-  void UpdateTextureSize(int width, int height);
+  /// Creates a texture with immutable storage
+  unsigned int CreateTexture(int internal_format);
+
+  /// Creates the depth buffer storage
+  void CreateDepthBuffer();
+
+  /// Names the objects of the frame buffer with the label
+  void ApplyLabels();
+
+  /// Counts the bytes of the attachments as they are now in GpuMemory
+  void UpdateAllocatedBytes();
+
+  /// Attaches the current depth buffer to the frame buffer
+  void AttachDepthBuffer();
+
+  /// Returns true if the depth buffer is a texture
+  bool HasDepthTexture();
+
+  /// Obtains the action of an attachment
+  Action& GetAction(std::vector<Action>& actions, int attachment);
+
+  /// Invalidates the bound attachments with the given action
+  void Invalidate(const std::vector<Action>& actions);
 
   /// Information about each texture
   struct TextureInfo {
     int internal_format;
     int base_format;
     int type;
+    bool sampled;
   };
 
-  unsigned int width_;
-  unsigned int height_;
+  int width_;
+  int height_;
+  int capacity_width_;
+  int capacity_height_;
+  int allocations_;
+  long allocated_bytes_;
+  int samples_;
   unsigned int framebuffer_;
   unsigned int depthbuffer_;
-  unsigned int current_texture_;
+  unsigned int sampler_;
+  DepthMode depth_mode_;
+  FrameBuffer* depth_source_;
   std::vector<unsigned int> textures_;
   std::vector<TextureInfo> textures_infos_;
+  std::vector<Action> load_actions_;   // the depth is the last one
+  std::vector<Action> store_actions_;  // the depth is the last one
+  float clear_color_[4];
+  std::string label_;
 };
 
 #endif
-
@@ -0,0 +1,294 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <algorithm>
+#include <csignal>
+#include <cstdio>
+#include <stdexcept>
+
+#include <lodepng.h>
+
+#include "CpuProfiler.h"
+#include "FrameCapture.h"
+#include "GLCheck.h"
+#include "GpuMemory.h"
+
+FrameCapture::FrameCapture()
+    : stream_(nullptr),
+      stream_width_(0),
+      stream_height_(0),
+      buffer_(0),
+      mapped_(nullptr),
+      slot_size_(0),
+      slot_(0),
+      frame_(0),
+      encoding_(0),
+      written_(0),
+      dropped_(0),
+      failed_(0),
+      stop_(false) {}
+
+FrameCapture::~FrameCapture() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  wake_.notify_all();
+  for (auto &worker : workers_)
+    worker.join();
+  if (stream_)
+    pclose(stream_);
+  for (auto &slot : slots_)
+    if (slot.fence)
+      glDeleteSync((GLsync)slot.fence);
+  if (buffer_) {
+    glDeleteBuffers(1, &buffer_);
+    GpuMemory::Free(GpuMemory::STREAMING, slots_.size() * slot_size_);
+  }
+}
+
+void FrameCapture::Init(const std::string &directory, int slots,
+                        int n_workers) {
+  directory_ = directory;
+  slots_.assign(slots, {nullptr, false, 0, 0, 0});
+  if (n_workers <= 0)
+    n_workers = std::max((int)std::thread::hardware_concurrency() / 2, 1);
+  for (int i = 0; i < n_workers; ++i)
+    workers_.emplace_back(&FrameCapture::Run, this);
+}
+
+void FrameCapture::InitStream(const std::string &output, int width,
+                              int height, float frame_rate, int slots) {
+  // The rows are read bottom up; a closed pipe fails the writes instead of
+  // ending the process
+  char input[128];
+  snprintf(input, sizeof(input),
+           "ffmpeg -loglevel error -y -f rawvideo -pix_fmt rgba -s %dx%d "
+           "-r %g -i - -vf vflip ",
+           width, height, frame_rate);
+  signal(SIGPIPE, SIG_IGN);
+  stream_ = popen((input + output).c_str(), "w");
+  if (!stream_)
+    throw std::runtime_error("can't start ffmpeg for " + output);
+  stream_width_ = width;
+  stream_height_ = height;
+  // One thread keeps the frames in order
+  Init("", slots, 1);
+}
+
+void FrameCapture::Capture(int width, int height) {
+  PROFILE_ZONE("capture");
+  Collect(false);
+  int frame = frame_++;
+  auto &slot = slots_[slot_];
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    bool resized =
+        stream_ && (width != stream_width_ || height != stream_height_);
+    if (slot.busy || resized) {
+      dropped_++;
+      return;
+    }
+  }
+  size_t size = (size_t)width * height * 4;
+  if (size > slot_size_)
+    Resize(size);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    slot.busy = true;
+  }
+  slot.frame = frame;
+  slot.width = width;
+  slot.height = height;
+  // The read is queued on the gpu and returns right away, as the destination
+  // is a buffer
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer_);
+  glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE,
+               (void *)(slot_ * slot_size_));
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  slot_ = (slot_ + 1) % slots_.size();
+}
+
+void FrameCapture::Finish() {
+  Collect(true);
+  WaitIdle();
+  if (stream_) {
+    pclose(stream_);
+    stream_ = nullptr;
+  }
+}
+
+int FrameCapture::GetWrittenCount() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return written_;
+}
+
+int FrameCapture::GetDroppedCount() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return dropped_;
+}
+
+int FrameCapture::GetFailedCount() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return failed_;
+}
+
+void FrameCapture::Collect(bool wait) {
+  // The next slot to read into is the oldest, and the fences are signaled in
+  // the order of the reads
+  GLbitfield flags = wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0;
+  GLuint64 timeout = wait ? GL_TIMEOUT_IGNORED : 0;
+  for (size_t i = 0; i < slots_.size(); ++i) {
+    int index = (slot_ + i) % slots_.size();
+    auto &fence = slots_[index].fence;
+    if (!fence)
+      continue;
+    auto status = glClientWaitSync((GLsync)fence, flags, timeout);
+    if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+      break;
+    glDeleteSync((GLsync)fence);
+    fence = nullptr;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      ready_.push_back(index);
+    }
+    wake_.notify_one();
+  }
+}
+
+void FrameCapture::WaitIdle() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  idle_.wait(lock, [this] {
+    for (auto &slot : slots_)
+      if (slot.busy)
+        return false;
+    return encoding_ == 0;
+  });
+}
+
+void FrameCapture::Resize(size_t slot_size) {
+  Collect(true);
+  WaitIdle();
+  if (buffer_) {
+    glDeleteBuffers(1, &buffer_);
+    GpuMemory::Free(GpuMemory::STREAMING, slots_.size() * slot_size_);
+  }
+  // The mapping is coherent, so the pixels are visible to the encoders once
+  // the fence of their read is signaled; client storage keeps them in system
+  // memory, which the cpu reads faster
+  slot_size_ = slot_size;
+  size_t size = slots_.size() * slot_size;
+  GLbitfield flags =
+      GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+  glCreateBuffers(1, &buffer_);
+  glNamedBufferStorage(buffer_, size, nullptr, flags | GL_CLIENT_STORAGE_BIT);
+  GpuMemory::Allocate(GpuMemory::STREAMING, size);
+  mapped_ =
+      (unsigned char *)glMapNamedBufferRange(buffer_, 0, size, flags);
+}
+
+void FrameCapture::Run() {
+  CpuProfiler::SetThreadName("capture");
+  std::vector<unsigned char> image;
+  std::vector<unsigned char> png;
+  for (;;) {
+    int index;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      wake_.wait(lock, [this] { return stop_ || !ready_.empty(); });
+      if (stop_)
+        return;
+      index = ready_.front();
+      ready_.pop_front();
+      encoding_++;
+    }
+    Slot slot = slots_[index];
+    auto error = Write(index, slot, &image, &png);
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      encoding_--;
+      if (error.empty())
+        written_++;
+      else if (failed_++ == 0)
+        fprintf(stderr, "\ncapture of frame %d failed: %s\n", slot.frame,
+                error.c_str());
+    }
+    idle_.notify_all();
+  }
+}
+
+std::string FrameCapture::Write(int index, const Slot &slot,
+                                std::vector<unsigned char> *image,
+                                std::vector<unsigned char> *png) {
+  PROFILE_ZONE("encode frame");
+  const unsigned char *pixels = mapped_ + index * slot_size_;
+  if (stream_) {
+    // Straight from the mapping, ffmpeg encodes meanwhile
+    size_t size = (size_t)slot.width * slot.height * 4;
+    bool written = fwrite(pixels, 1, size, stream_) == size;
+    Free(index);
+    return written ? "" : "the ffmpeg stream was closed";
+  }
+
+  // The rows are read bottom up, and the alpha of the backbuffer isn't
+  // meaningful
+  image->resize((size_t)slot.width * slot.height * 3);
+  for (int y = 0; y < slot.height; ++y) {
+    auto source = pixels + (size_t)(slot.height - 1 - y) * slot.width * 4;
+    auto row = &(*image)[(size_t)y * slot.width * 3];
+    for (int x = 0; x < slot.width; ++x) {
+      row[3 * x + 0] = source[4 * x + 0];
+      row[3 * x + 1] = source[4 * x + 1];
+      row[3 * x + 2] = source[4 * x + 2];
+    }
+  }
+  Free(index);
+
+  // Speed over size: the color type is known, and the unfiltered rows are
+  // compressed without lazy matching
+  lodepng::State state;
+  state.info_raw.colortype = LCT_RGB;
+  state.info_png.color.colortype = LCT_RGB;
+  state.encoder.auto_convert = 0;
+  state.encoder.filter_strategy = LFS_ZERO;
+  state.encoder.zlibsettings.lazymatching = 0;
+  png->clear();
+  unsigned error =
+      lodepng::encode(*png, *image, slot.width, slot.height, state);
+  char name[32];
+  snprintf(name, sizeof(name), "/frame_%06d.png", slot.frame);
+  if (!error)
+    error = lodepng::save_file(*png, directory_ + name);
+  return error ? lodepng_error_text(error) : "";
+}
+
+void FrameCapture::Free(int index) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    slots_[index].busy = false;
+  }
+  idle_.notify_all();
+}
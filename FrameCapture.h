@@ -0,0 +1,155 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef FRAMECAPTURE_H
+#define FRAMECAPTURE_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Writes every presented frame to PNG files or to a video encoder, without
+ * stalling the gpu
+ *
+ * Each frame is read from the backbuffer into the next slot of a ring of
+ * persistently mapped pixel pack buffers, guarded by a fence. A few frames
+ * later, once the fence is signaled, the slot goes to encoder threads, which
+ * copy the pixels out of the mapping, free the slot and write the file with
+ * lodepng. The render thread only polls the fences; a frame whose slot is
+ * still in use when its turn comes is dropped and counted instead of waited
+ * for, and its number is skipped in the file names.
+ *
+ * When streaming, the frames are instead written in order by a single thread
+ * to the input of an ffmpeg process, straight out of the mapping, as raw
+ * RGBA rows that ffmpeg flips and encodes while the next frames render.
+ */
+class FrameCapture {
+public:
+  /**
+   * Default constructor
+   */
+  FrameCapture();
+
+  /**
+   * Destructor, waits for the frames being written
+   */
+  ~FrameCapture();
+
+  /**
+   * Starts the encoder threads, half of the hardware threads if 0, writing
+   * the frames to directory/frame_<number>.png
+   */
+  void Init(const std::string& directory, int slots = 8, int n_workers = 0);
+
+  /**
+   * Starts an ffmpeg process that encodes width x height frames at a frame
+   * rate to an output file or url, whose extension or protocol chooses the
+   * format; frames of another size are dropped
+   * Throws runtime_error if the process can't be started
+   */
+  void InitStream(const std::string& output, int width, int height,
+                  float frame_rate, int slots = 4);
+
+  /**
+   * Reads the width x height backbuffer into the next slot, once per frame,
+   * and hands the slots the gpu wrote to the encoder threads
+   */
+  void Capture(int width, int height);
+
+  /**
+   * Waits for every captured frame to be written, and ends the stream
+   */
+  void Finish();
+
+  /**
+   * Obtains the frames written, dropped for a busy slot and failed to write
+   */
+  int GetWrittenCount();
+  int GetDroppedCount();
+  int GetFailedCount();
+
+private:
+  // Frame read into a slot of the ring
+  struct Slot {
+    void* fence;  // of the read, until handed to the encoders
+    bool busy;    // read or not copied out yet
+    int frame;
+    int width;
+    int height;
+  };
+
+  // Hands the slots whose read is done to the encoders, oldest first, waiting
+  // for them if asked
+  void Collect(bool wait);
+
+  // Waits for the slots handed over and the frames being written
+  void WaitIdle();
+
+  // Recreates the buffer with slots of that many bytes, once they're free
+  void Resize(size_t slot_size);
+
+  // Encodes the frames of the slots handed over until stopped
+  void Run();
+
+  // Writes the pixels of a slot to the stream, or encodes them to a file,
+  // and frees the slot once they're copied out
+  // Returns the error, empty if none
+  std::string Write(int index, const Slot& slot,
+                    std::vector<unsigned char>* image,
+                    std::vector<unsigned char>* png);
+
+  // Marks a slot as free
+  void Free(int index);
+
+  std::string directory_;
+  FILE* stream_;  // input of the ffmpeg process, if streaming
+  int stream_width_;
+  int stream_height_;
+  unsigned int buffer_;
+  unsigned char* mapped_;
+  size_t slot_size_;  // bytes
+  int slot_;
+  int frame_;
+  std::vector<Slot> slots_;
+  std::vector<std::thread> workers_;
+
+  // What the encoder threads share with the render thread
+  std::mutex mutex_;
+  std::condition_variable wake_;  // on a slot handed over or the stop
+  std::condition_variable idle_;  // on a slot freed or a frame written
+  std::deque<int> ready_;         // slots handed over
+  int encoding_;
+  int written_;
+  int dropped_;
+  int failed_;
+  bool stop_;
+};
+
+#endif
@@ -0,0 +1,115 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <algorithm>
+#include <chrono>
+
+#include "CpuProfiler.h"
+#include "FramePipeline.h"
+#include "GLCheck.h"
+
+namespace {
+
+// Nanoseconds waited per try for the gpu to finish a frame
+const GLuint64 FRAME_WAIT_TIMEOUT = 1000000;
+
+}  // namespace
+
+FramePipeline::FramePipeline()
+    : frame_(0), wait_time_(0), latency_(0), gpu_time_(0) {}
+
+FramePipeline::~FramePipeline() {
+  for (auto fence : fences_)
+    if (fence)
+      glDeleteSync((GLsync)fence);
+  if (!queries_.empty()) {
+    glDeleteQueries(queries_.size(), queries_.data());
+    glDeleteQueries(begin_queries_.size(), begin_queries_.data());
+  }
+}
+
+void FramePipeline::Init(int frames_in_flight) {
+  int n = std::max(frames_in_flight, 1);
+  fences_.assign(n, nullptr);
+  queries_.resize(n);
+  glCreateQueries(GL_TIMESTAMP, n, queries_.data());
+  begin_queries_.resize(n);
+  glCreateQueries(GL_TIMESTAMP, n, begin_queries_.data());
+  input_times_.assign(n, -1);
+  frame_ = 0;
+}
+
+int FramePipeline::BeginFrame() {
+  using namespace std::chrono;
+  PROFILE_ZONE("wait for frame");
+  frame_ = (frame_ + 1) % fences_.size();
+  auto fence = (GLsync)fences_[frame_];
+  wait_time_ = 0;
+  if (!fence) {
+    glQueryCounter(begin_queries_[frame_], GL_TIMESTAMP);
+    return frame_;
+  }
+  auto begin = steady_clock::now();
+  GLenum status;
+  do {
+    status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+                              FRAME_WAIT_TIMEOUT);
+  } while (status == GL_TIMEOUT_EXPIRED);
+  wait_time_ =
+      duration<double, std::milli>(steady_clock::now() - begin).count();
+  glDeleteSync(fence);
+  fences_[frame_] = nullptr;
+
+  // The fence passed, so the timestamps are available without a stall
+  GLint64 end = 0;
+  glGetQueryObjecti64v(queries_[frame_], GL_QUERY_RESULT, &end);
+  if (input_times_[frame_] >= 0)
+    latency_ = (end - input_times_[frame_]) / 1e6;
+  input_times_[frame_] = -1;
+  // Every fenced frame had its start recorded
+  GLint64 start = 0;
+  glGetQueryObjecti64v(begin_queries_[frame_], GL_QUERY_RESULT, &start);
+  gpu_time_ = (end - start) / 1e6;
+  glQueryCounter(begin_queries_[frame_], GL_TIMESTAMP);
+  return frame_;
+}
+
+void FramePipeline::SampleInput() {
+  GLint64 now = 0;
+  glGetInteger64v(GL_TIMESTAMP, &now);
+  input_times_[frame_] = now;
+}
+
+void FramePipeline::EndFrame() {
+  glQueryCounter(queries_[frame_], GL_TIMESTAMP);
+  fences_[frame_] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
+
+int FramePipeline::GetFramesInFlight() { return fences_.size(); }
+
+double FramePipeline::GetWaitTime() { return wait_time_; }
+
+double FramePipeline::GetLatency() { return latency_; }
+
+double FramePipeline::GetGpuTime() { return gpu_time_; }
@@ -0,0 +1,113 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef FRAMEPIPELINE_H
+#define FRAMEPIPELINE_H
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * Bounds how many frames the cpu prepares ahead of the gpu
+ *
+ * Each frame in flight has a fence issued at its end. BeginFrame() waits for
+ * the fence of the frame that last used the same index, so the cpu records
+ * frame N + frames in flight while the gpu still renders frame N, but never
+ * further ahead. The per-frame resources (streaming buffer slots, upload
+ * segments) are sized to the same number of frames, so the slot that a frame
+ * writes is always one the gpu is done with, and the latency from input to
+ * display is bounded by the frames in flight.
+ *
+ * The latency of a frame is estimated on the gpu clock, from the time its
+ * input was sampled to the time the gpu finished it, swap included, which
+ * is known once its index comes back. So is its gpu time, from its first
+ * command to its end.
+ */
+class FramePipeline {
+public:
+  /**
+   * Default constructor
+   */
+  FramePipeline();
+
+  /**
+   * Destructor
+   */
+  ~FramePipeline();
+
+  /**
+   * Sets the number of frames in flight, at least one
+   */
+  void Init(int frames_in_flight);
+
+  /**
+   * Waits until the gpu is done with the frame that last had the next index
+   * Returns that index, in [0, frames in flight)
+   */
+  int BeginFrame();
+
+  /**
+   * Records that the input of the current frame is sampled now
+   */
+  void SampleInput();
+
+  /**
+   * Fences the commands of the current frame, after its last submission
+   */
+  void EndFrame();
+
+  /**
+   * Obtains the number of frames in flight
+   */
+  int GetFramesInFlight();
+
+  /**
+   * Obtains the milliseconds that the last BeginFrame() waited for the gpu
+   */
+  double GetWaitTime();
+
+  /**
+   * Obtains the milliseconds from the input sample to the end on the gpu of
+   * the frame that last had the current index, 0 if unknown
+   */
+  double GetLatency();
+
+  /**
+   * Obtains the milliseconds from the start to the end on the gpu of the
+   * frame that last had the current index, 0 if unknown
+   */
+  double GetGpuTime();
+
+private:
+  std::vector<void *> fences_;  // of each frame index, null if none
+  std::vector<unsigned int> queries_;  // gpu time at the end of each frame
+  std::vector<unsigned int> begin_queries_;  // and at its start
+  std::vector<int64_t> input_times_;   // gpu time of each input sample
+  int frame_;
+  double wait_time_;
+  double latency_;
+  double gpu_time_;
+};
+
+#endif
@@ -0,0 +1,123 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <algorithm>
+#include <stdexcept>
+
+#include "FrameTimes.h"
+
+namespace {
+
+// Width of the bins in milliseconds, and their number; the last one holds
+// everything longer
+const double BIN_WIDTH = 0.25;
+const int N_BINS = 400;
+
+}  // namespace
+
+FrameTimes::FrameTimes() : counts_{}, next_(0), frame_(0), n_columns_(0) {
+  Init();
+}
+
+void FrameTimes::Init(const std::string& csv_path, int n_samples,
+                      const std::vector<std::string>& columns) {
+  samples_[0].assign(std::max(n_samples, 1), 0);
+  Reset();
+  if (csv_path.empty())
+    return;
+  n_columns_ = columns.size();
+  csv_.open(csv_path, std::ios::trunc);
+  csv_ << "frame,frame_ms,cpu_ms,gpu_ms";
+  for (auto& column : columns)
+    csv_ << ',' << column;
+  csv_ << '\n';
+  if (!csv_)
+    throw std::runtime_error("Unable to write file: " + csv_path);
+}
+
+void FrameTimes::Reset() {
+  for (int i = 0; i < N_SERIES; ++i) {
+    samples_[i].assign(samples_[0].size(), 0);
+    histograms_[i].assign(N_BINS, 0);
+    counts_[i] = 0;
+  }
+  next_ = 0;
+}
+
+void FrameTimes::Add(double frame_ms, double cpu_ms, double gpu_ms,
+                     const float* values) {
+  double times[N_SERIES] = {frame_ms, cpu_ms, gpu_ms};
+  for (int i = 0; i < N_SERIES; ++i) {
+    Count(i, samples_[i][next_], -1);
+    samples_[i][next_] = times[i];
+    Count(i, times[i], 1);
+  }
+  next_ = (next_ + 1) % samples_[0].size();
+  if (csv_.is_open()) {
+    csv_ << frame_ << ',' << frame_ms << ',' << cpu_ms << ',' << gpu_ms;
+    for (int i = 0; i < n_columns_; ++i) {
+      csv_ << ',';
+      if (values && values[i] >= 0)
+        csv_ << values[i];
+    }
+    csv_ << '\n';
+  }
+  frame_++;
+}
+
+FrameTimes::Percentiles FrameTimes::GetPercentiles(Series series) {
+  Percentiles percentiles = {0, 0, 0, 0};
+  int count = counts_[series];
+  if (count == 0)
+    return percentiles;
+  // Each percentile is the upper edge of the bin that reaches its rank
+  double fractions[] = {0.5, 0.95, 0.99};
+  double* values[] = {&percentiles.p50, &percentiles.p95, &percentiles.p99};
+  int below = 0, next = 0;
+  for (int bin = 0; bin < N_BINS && next < 3; ++bin) {
+    below += histograms_[series][bin];
+    while (next < 3 && below >= fractions[next] * count)
+      *values[next++] = (bin + 1) * BIN_WIDTH;
+  }
+  auto& samples = samples_[series];
+  percentiles.max = *std::max_element(samples.begin(), samples.end());
+  for (int i = 0; i < 3; ++i)
+    *values[i] = std::min(*values[i], percentiles.max);
+  return percentiles;
+}
+
+int FrameTimes::GetCount(Series series) { return counts_[series]; }
+
+const char* FrameTimes::GetName(Series series) {
+  static const char* names[] = {"frame", "cpu", "gpu"};
+  return names[series];
+}
+
+void FrameTimes::Count(int series, double ms, int delta) {
+  if (ms <= 0)
+    return;
+  int bin = std::min((int)(ms / BIN_WIDTH), N_BINS - 1);
+  histograms_[series][bin] += delta;
+  counts_[series] += delta;
+}
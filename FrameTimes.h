@@ -0,0 +1,112 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef FRAMETIMES_H
+#define FRAMETIMES_H
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+/**
+ * Percentiles of the times of the recent frames, to show hitches that the
+ * average hides
+ *
+ * The times of the last frames are kept in a ring, and each series in a
+ * histogram of fixed bins that the ring updates as samples come and go, so
+ * the percentiles cost a pass over the bins no matter how many frames are
+ * kept. Times of 0 are unknown and not counted. Every frame may also be
+ * streamed to a CSV file.
+ */
+class FrameTimes {
+public:
+  /**
+   * Times recorded per frame
+   */
+  enum Series { FRAME_TIME, CPU_TIME, GPU_TIME, N_SERIES };
+
+  /**
+   * Percentiles of a series over the kept frames, in milliseconds
+   */
+  struct Percentiles {
+    double p50;
+    double p95;
+    double p99;
+    double max;
+  };
+
+  /**
+   * Default constructor
+   */
+  FrameTimes();
+
+  /**
+   * Sets the number of frames kept, and opens the CSV file the frames are
+   * written to, none if the path is empty, with more columns after the times
+   * Throws runtime_error if the file can't be written
+   */
+  void Init(const std::string& csv_path = "", int n_samples = 1024,
+            const std::vector<std::string>& columns = {});
+
+  /**
+   * Forgets the kept frames, the CSV file goes on
+   */
+  void Reset();
+
+  /**
+   * Records the times of a frame, in milliseconds, with the values of the
+   * more columns of the CSV file, if any; a negative value is left empty
+   */
+  void Add(double frame_ms, double cpu_ms, double gpu_ms,
+           const float* values = nullptr);
+
+  /**
+   * Computes the percentiles of a series; within a bin except for the max
+   */
+  Percentiles GetPercentiles(Series series);
+
+  /**
+   * Obtains the number of frames kept with a known time of a series
+   */
+  int GetCount(Series series);
+
+  /**
+   * Obtains the name of a series
+   */
+  static const char* GetName(Series series);
+
+private:
+  // Adds a sample to the histogram of a series, or removes it
+  void Count(int series, double ms, int delta);
+
+  std::vector<double> samples_[N_SERIES];  // ring of the last frames
+  std::vector<int> histograms_[N_SERIES];
+  int counts_[N_SERIES];  // known samples in the ring
+  int next_;
+  long frame_;
+  std::ofstream csv_;
+  int n_columns_;  // of the CSV file after the times
+};
+
+#endif
@@ -0,0 +1,54 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "Frustum.h"
+
+void ExtractFrustumPlanes(const glm::mat4& matrix, glm::vec4 planes[6]) {
+  auto row = [&](int i) {
+    return glm::vec4(matrix[0][i], matrix[1][i], matrix[2][i], matrix[3][i]);
+  };
+  for (int i = 0; i < 3; ++i) {
+    planes[2 * i] = row(3) + row(i);
+    planes[2 * i + 1] = row(3) - row(i);
+  }
+  for (int i = 0; i < 6; ++i)
+    planes[i] /= glm::length(glm::vec3(planes[i]));
+}
+
+bool ProjectSphere(const glm::vec4& sphere, const glm::mat4& view_projection,
+                   glm::vec4* rect) {
+  glm::vec2 rect_min(1e30f), rect_max(-1e30f);
+  for (int i = 0; i < 8; ++i) {
+    glm::vec3 corner(i & 1 ? 1 : -1, i & 2 ? 1 : -1, i & 4 ? 1 : -1);
+    auto clip = view_projection *
+                glm::vec4(glm::vec3(sphere) + corner * sphere.w, 1);
+    if (clip.w <= 0)
+      return false;
+    auto ndc = glm::vec2(clip) / clip.w;
+    rect_min = glm::min(rect_min, ndc);
+    rect_max = glm::max(rect_max, ndc);
+  }
+  *rect = glm::vec4(rect_min, rect_max);
+  return true;
+}
@@ -0,0 +1,160 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#include "GBufferDump.h"
+
+namespace {
+
+// Changes with the layout of the file
+const uint32_t VERSION = 1;
+
+// Start of every dump, followed by a TextureHeader per texture, the code,
+// the pixels of each texture, the depth and the bytes of the materials, the
+// point lights and the spot lights
+struct Header {
+  char magic[8];
+  uint32_t version;
+  int32_t width;
+  int32_t height;
+  uint32_t n_textures;
+  float projection[16];
+  float z_near;
+  float z_far;
+  int32_t cluster_grid[3];
+  int32_t tile_size;
+  uint32_t n_code_bytes;
+  uint32_t n_material_bytes;
+  uint32_t n_light_bytes;
+  uint32_t n_spot_light_bytes;
+};
+
+struct TextureHeader {
+  int32_t internal_format;
+  int32_t base_format;
+  int32_t type;
+  int32_t bytes_per_pixel;
+};
+
+const char MAGIC[8] = {'G', 'B', 'U', 'F', 'D', 'U', 'M', 'P'};
+
+}  // namespace
+
+void WriteGBufferDump(const std::string& path, const GBufferDump& dump) {
+  Header header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, MAGIC, sizeof(MAGIC));
+  header.version = VERSION;
+  header.width = dump.width;
+  header.height = dump.height;
+  header.n_textures = dump.textures.size();
+  memcpy(header.projection, &dump.projection[0][0], sizeof(header.projection));
+  header.z_near = dump.z_near;
+  header.z_far = dump.z_far;
+  for (int i = 0; i < 3; ++i)
+    header.cluster_grid[i] = dump.cluster_grid[i];
+  header.tile_size = dump.tile_size;
+  header.n_code_bytes = dump.lighting_code.size();
+  header.n_material_bytes = dump.materials.size();
+  header.n_light_bytes = dump.lights.size();
+  header.n_spot_light_bytes = dump.spot_lights.size();
+
+  std::ofstream output(path, std::ios::binary | std::ios::trunc);
+  if (!output.is_open())
+    throw std::runtime_error("Unable to open file: " + path);
+  output.write((const char*)&header, sizeof(header));
+  for (auto& texture : dump.textures) {
+    TextureHeader texture_header = {texture.internal_format,
+                                    texture.base_format, texture.type,
+                                    texture.bytes_per_pixel};
+    output.write((const char*)&texture_header, sizeof(texture_header));
+  }
+  output.write(dump.lighting_code.data(), dump.lighting_code.size());
+  for (auto& texture : dump.textures)
+    output.write((const char*)texture.pixels.data(), texture.pixels.size());
+  output.write((const char*)dump.depth.data(),
+               dump.depth.size() * sizeof(float));
+  output.write((const char*)dump.materials.data(), dump.materials.size());
+  output.write((const char*)dump.lights.data(), dump.lights.size());
+  output.write((const char*)dump.spot_lights.data(), dump.spot_lights.size());
+  output.close();
+  if (!output)
+    throw std::runtime_error("Unable to write file: " + path);
+}
+
+GBufferDump ReadGBufferDump(const std::string& path) {
+  std::ifstream input(path, std::ios::binary);
+  if (!input.is_open())
+    throw std::runtime_error("Unable to open file: " + path);
+  auto read = [&](void* data, size_t size) {
+    if (!input.read((char*)data, size))
+      throw std::runtime_error("Truncated file: " + path);
+  };
+  Header header;
+  read(&header, sizeof(header));
+  if (memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0 ||
+      header.version != VERSION)
+    throw std::runtime_error("Not a G-buffer dump of version " +
+                             std::to_string(VERSION) + ": " + path);
+
+  GBufferDump dump;
+  dump.width = header.width;
+  dump.height = header.height;
+  memcpy(&dump.projection[0][0], header.projection, sizeof(header.projection));
+  dump.z_near = header.z_near;
+  dump.z_far = header.z_far;
+  dump.cluster_grid = glm::ivec3(header.cluster_grid[0],
+                                 header.cluster_grid[1],
+                                 header.cluster_grid[2]);
+  dump.tile_size = header.tile_size;
+  size_t pixels = (size_t)header.width * header.height;
+  dump.textures.resize(header.n_textures);
+  for (auto& texture : dump.textures) {
+    TextureHeader texture_header;
+    read(&texture_header, sizeof(texture_header));
+    texture.internal_format = texture_header.internal_format;
+    texture.base_format = texture_header.base_format;
+    texture.type = texture_header.type;
+    texture.bytes_per_pixel = texture_header.bytes_per_pixel;
+  }
+  dump.lighting_code.resize(header.n_code_bytes);
+  read(&dump.lighting_code[0], dump.lighting_code.size());
+  for (auto& texture : dump.textures) {
+    texture.pixels.resize(pixels * texture.bytes_per_pixel);
+    read(texture.pixels.data(), texture.pixels.size());
+  }
+  dump.depth.resize(pixels);
+  read(dump.depth.data(), dump.depth.size() * sizeof(float));
+  dump.materials.resize(header.n_material_bytes);
+  read(dump.materials.data(), dump.materials.size());
+  dump.lights.resize(header.n_light_bytes);
+  read(dump.lights.data(), dump.lights.size());
+  dump.spot_lights.resize(header.n_spot_light_bytes);
+  read(dump.spot_lights.data(), dump.spot_lights.size());
+  return dump;
+}
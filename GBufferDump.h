@@ -0,0 +1,82 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef GBUFFERDUMP_H
+#define GBUFFERDUMP_H
+
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+/**
+ * Inputs of the lighting pass in one frame, for replaying it alone
+ *
+ * The G-buffer of that frame, single sampled and of a single view, with the
+ * generated code that reads it and the contents of the storage buffers of
+ * the materials and of the point and spot lights, the latter in view space.
+ * The pixels are in the order of glGetTextureSubImage, bottom row first,
+ * without padding.
+ */
+struct GBufferDump {
+  /**
+   * Color attachment, as in GBufferLayout::Attachment
+   */
+  struct Texture {
+    int internal_format;
+    int base_format;
+    int type;
+    int bytes_per_pixel;
+    std::vector<unsigned char> pixels;
+  };
+
+  int width;
+  int height;
+  glm::mat4 projection;
+  float z_near;
+  float z_far;
+  glm::ivec3 cluster_grid;  // CLUSTER_GRID of the application
+  int tile_size;            // TILE_SIZE of the compute lighting
+  std::string lighting_code;  // GBufferLayout::GenerateLightingPassCode()
+  std::vector<Texture> textures;
+  std::vector<float> depth;
+  std::vector<unsigned char> materials;    // MaterialsBlock
+  std::vector<unsigned char> lights;       // LightsBlock
+  std::vector<unsigned char> spot_lights;  // SpotLightsBlock
+};
+
+/**
+ * Writes a dump in a binary file of native byte order
+ * Throws runtime_error if the file can't be written
+ */
+void WriteGBufferDump(const std::string& path, const GBufferDump& dump);
+
+/**
+ * Reads a dump written by WriteGBufferDump()
+ * Throws runtime_error if the file can't be read, is truncated or is of
+ * another version
+ */
+GBufferDump ReadGBufferDump(const std::string& path);
+
+#endif
@@ -0,0 +1,627 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <sstream>
+#include <stdexcept>
+
+#include <glm/glm.hpp>
+
+#include "GBufferLayout.h"
+#include "GLCheck.h"
+#include "NormalEncoding.h"
+
+namespace {
+
+// Layouts selectable by name
+struct Preset {
+  const char* name;
+  const char* description;
+};
+
+const Preset PRESETS[] = {
+    {"reference", "rgb32f=position,rgb32f=normal,rgba8=albedo+material"},
+    {"default", "rgb32f=normal,rgba8=albedo+material"},
+    {"compact", "rg16snorm=normal.oct,rgba8=albedo+material"},
+    {"packed", "rgba16f=normal+material,rgba8=albedo"},
+    {"packed-oct", "rgba16f=normal.oct+material,rgba8=albedo"},
+    {"wide-material", "rgb32f=normal,rgba8=albedo,r16=material"},
+    {"thin", "rgba8=normal.oct+material"},
+};
+
+const char* DEFAULT_PRESET = "default";
+
+// Glsl code shared by the generated functions
+const char* GEOMETRY_HELPERS = R"(
+// Signed octahedral mapping of an unit vector to [-1, 1]^2
+vec2 encode_octahedral(vec3 n) {
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    bvec2 positive = greaterThanEqual(n.xy, vec2(0));
+    vec2 sign_not_zero = mix(vec2(-1), vec2(1), positive);
+    return n.z >= 0 ? n.xy : (1 - abs(n.yx)) * sign_not_zero;
+}
+)";
+
+const char* LIGHTING_HELPERS = R"(
+// Inverse of encode_octahedral
+vec3 decode_octahedral(vec2 e) {
+    vec3 n = vec3(e, 1 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0);
+    n.xy += mix(vec2(t), vec2(-t), greaterThanEqual(n.xy, vec2(0)));
+    return n;
+}
+
+#ifdef VIEWS
+// Transforms of the views drawn in tiles of the buffer, VIEW_COLUMNS per
+// row from the bottom left, as in geometry.glsl
+layout (std140) uniform ViewsBlock {
+    mat4 view_to_clip[VIEWS];
+    mat4 clip_to_view[VIEWS];
+};
+#endif
+
+// Rebuilds the view-space position from the depth buffer; with several
+// views, from the view of the tile, back to the view of the camera
+vec3 reconstruct_position(vec2 uv, float depth) {
+#ifdef VIEWS
+    vec2 grid = vec2(VIEW_COLUMNS, VIEW_ROWS);
+    ivec2 tile = min(ivec2(uv * grid), ivec2(grid) - 1);
+    int v = min(tile.y * VIEW_COLUMNS + tile.x, VIEWS - 1);
+    uv = uv * grid - vec2(tile);
+    vec4 position = clip_to_view[v] * vec4(vec3(uv, depth) * 2 - 1, 1);
+#else
+    vec4 ndc = vec4(vec3(uv, depth) * 2 - 1, 1);
+    vec4 position = inv_projection * ndc;
+#endif
+    return position.xyz / position.w;
+}
+)";
+
+const char* CHANNELS = "rgba";
+
+std::string Trim(const std::string& str) {
+  auto begin = str.find_first_not_of(" \t");
+  if (begin == std::string::npos) return "";
+  auto end = str.find_last_not_of(" \t");
+  return str.substr(begin, end - begin + 1);
+}
+
+std::vector<std::string> Split(const std::string& str, char separator) {
+  std::vector<std::string> parts;
+  std::stringstream stream(str);
+  std::string part;
+  while (std::getline(stream, part, separator))
+    parts.push_back(Trim(part));
+  return parts;
+}
+
+}  // namespace
+
+GBufferLayout::GBufferLayout() { Parse(DEFAULT_PRESET); }
+
+void GBufferLayout::Parse(const std::string& description) {
+  auto layout = Trim(description);
+  for (auto& preset : PRESETS) {
+    if (layout == preset.name) {
+      layout = preset.description;
+      break;
+    }
+  }
+
+  description_ = layout;
+  attachments_.clear();
+  formats_.clear();
+  fields_.clear();
+
+  for (auto& attachment_str : Split(layout, ',')) {
+    auto equal = attachment_str.find('=');
+    if (equal == std::string::npos)
+      throw std::runtime_error("G-buffer attachment without fields: " +
+                               attachment_str);
+    auto format_name = Trim(attachment_str.substr(0, equal));
+    auto format = FindFormat(format_name);
+    if (!format)
+      throw std::runtime_error("unknown G-buffer format: " + format_name);
+    attachments_.push_back({format_name, format->internal_format,
+                            format->base_format, format->type,
+                            format->bytes_per_pixel});
+    formats_.push_back(format);
+    for (auto& field : Split(attachment_str.substr(equal + 1), '+'))
+      AddField(field);
+  }
+
+  int n_normals = 0, n_materials = 0;
+  for (auto& field : fields_) {
+    n_normals += field.type == NORMAL || field.type == NORMAL_OCTAHEDRAL;
+    n_materials += field.type == MATERIAL;
+  }
+  if (n_normals != 1 || n_materials != 1)
+    throw std::runtime_error(
+        "the G-buffer needs exactly one normal and one material: " + layout);
+  if (attachments_.size() > 8)
+    throw std::runtime_error("too many G-buffer attachments: " + layout);
+}
+
+void GBufferLayout::UseHalfFloats() {
+  for (size_t i = 0; i < formats_.size(); ++i) {
+    if (!formats_[i]->half_format) continue;
+    formats_[i] = FindFormat(formats_[i]->half_format);
+    attachments_[i] = {formats_[i]->name, formats_[i]->internal_format,
+                       formats_[i]->base_format, formats_[i]->type,
+                       formats_[i]->bytes_per_pixel};
+  }
+  UpdateDescription();
+}
+
+GBufferLayout::PrecisionReport GBufferLayout::ComputePrecision(
+    const glm::mat4& projection, float near, float far) {
+  const int n_samples = 100000;
+  auto inv_projection = glm::inverse(projection);
+  PrecisionReport report = {0, 0, 0, 0, 0};
+  srand(1);
+  auto random = []() { return (float)rand() / RAND_MAX; };
+  for (int i = 0; i < n_samples; ++i) {
+    // Random point in the frustum, with the same screen coverage per depth
+    auto ndc = glm::vec2(random(), random()) * 2.0f - 1.0f;
+    float distance = near + (far - near) * random();
+    auto eye_ray = inv_projection * glm::vec4(ndc, 1, 1);
+    auto position = glm::vec3(eye_ray) / eye_ray.w;
+    position *= distance / -position.z;
+    auto normal = glm::normalize(
+        glm::vec3(random(), random(), random()) * 2.0f - 1.0f);
+
+    // Simulates write_gbuffer() and read_gbuffer()
+    std::vector<glm::vec4> texels(attachments_.size());
+    for (auto& field : fields_) {
+      glm::vec4 value;
+      if (field.type == POSITION)
+        value = glm::vec4(position, 0);
+      else if (field.type == NORMAL)
+        value = glm::vec4(normal, 0);
+      else if (field.type == NORMAL_OCTAHEDRAL)
+        value = glm::vec4(EncodeOctahedral(normal), 0, 0);
+      else
+        continue;
+      for (int j = 0; j < field.n_channels; ++j)
+        texels[field.attachment][field.first_channel + j] = value[j];
+    }
+    for (size_t j = 0; j < texels.size(); ++j)
+      texels[j] = Quantize(formats_[j], texels[j]);
+
+    auto stored_position = position;
+    auto stored_normal = normal;
+    bool has_position = false;
+    for (auto& field : fields_) {
+      glm::vec3 value;
+      for (int j = 0; j < field.n_channels && j < 3; ++j)
+        value[j] = texels[field.attachment][field.first_channel + j];
+      if (field.type == POSITION) {
+        stored_position = value;
+        has_position = true;
+      } else if (field.type == NORMAL) {
+        stored_normal = glm::normalize(value);
+      } else if (field.type == NORMAL_OCTAHEDRAL) {
+        stored_normal = DecodeOctahedral(glm::vec2(value));
+      }
+    }
+    if (!has_position) {
+      // The depth is rasterized as a float and read back as a float
+      auto clip = projection * glm::vec4(position, 1);
+      float depth = clip.z / clip.w * 0.5f + 0.5f;
+      auto ndc_position = glm::vec4(ndc, depth * 2 - 1, 1);
+      auto view_position = inv_projection * ndc_position;
+      stored_position = glm::vec3(view_position) / view_position.w;
+    }
+
+    double position_error = glm::distance(glm::dvec3(position),
+                                          glm::dvec3(stored_position));
+    auto a = glm::dvec3(normal);
+    auto b = glm::dvec3(stored_normal);
+    double normal_error =
+        std::atan2(glm::length(glm::cross(a, b)), glm::dot(a, b)) * 180.0 /
+        M_PI;
+    report.mean_position_error += position_error / n_samples;
+    report.max_position_error =
+        std::max(report.max_position_error, position_error);
+    report.max_relative_position_error =
+        std::max(report.max_relative_position_error,
+                 position_error / glm::length(position));
+    report.mean_normal_error += normal_error / n_samples;
+    report.max_normal_error = std::max(report.max_normal_error, normal_error);
+  }
+  return report;
+}
+
+const std::vector<GBufferLayout::Attachment>& GBufferLayout::GetAttachments() {
+  return attachments_;
+}
+
+std::string GBufferLayout::GetSamplerName(int attachment) {
+  return "gbuffer" + std::to_string(attachment);
+}
+
+bool GBufferLayout::StoresPosition() {
+  for (auto& field : fields_)
+    if (field.type == POSITION) return true;
+  return false;
+}
+
+int GBufferLayout::GetMaterialAttachment() {
+  for (auto& field : fields_)
+    if (field.type == MATERIAL) return field.attachment;
+  return -1;
+}
+
+int GBufferLayout::GetMaterialCapacity() {
+  auto format = formats_[GetMaterialAttachment()];
+  // Floats hold every integer up to 2^(mantissa bits + 1)
+  int values = format->max_value ? format->max_value + 1
+               : format->type == GL_HALF_FLOAT ? 1 << 11
+                                               : 1 << 24;
+  return values - 1;
+}
+
+int GBufferLayout::GetBytesPerPixel() {
+  int bytes = 4;  // depth
+  for (auto& attachment : attachments_)
+    bytes += attachment.bytes_per_pixel;
+  return bytes;
+}
+
+const std::string& GBufferLayout::GetDescription() { return description_; }
+
+std::string GBufferLayout::GenerateGeometryPassCode() {
+  std::stringstream code;
+  code << "// G-buffer layout: " << description_ << "\n";
+  for (size_t i = 0; i < attachments_.size(); ++i)
+    code << "layout(location = " << i << ") out vec4 gbuffer_out" << i
+         << ";\n";
+  code << GEOMETRY_HELPERS << "\n";
+  code << "void write_gbuffer(vec3 position, vec3 normal, int material,\n"
+       << "                   vec3 albedo) {\n";
+  for (size_t i = 0; i < attachments_.size(); ++i)
+    code << "    gbuffer_out" << i << " = vec4(0);\n";
+  for (auto& field : fields_) {
+    std::string value;
+    switch (field.type) {
+      case POSITION:
+        value = "position";
+        break;
+      case NORMAL:
+        value = "normal";
+        break;
+      case NORMAL_OCTAHEDRAL:
+        value = "encode_octahedral(normal)";
+        break;
+      case MATERIAL:
+        // 0 is reserved for the background
+        value = "float(material + 1)";
+        break;
+      case ALBEDO:
+        value = "albedo";
+        break;
+    }
+    code << "    gbuffer_out" << field.attachment << "."
+         << std::string(CHANNELS + field.first_channel, field.n_channels)
+         << " = " << Encode(field, value) << ";\n";
+  }
+  code << "}\n";
+  return code.str();
+}
+
+std::string GBufferLayout::GenerateDecalPassCode() {
+  std::stringstream code;
+  code << "// G-buffer layout: " << description_ << "\n";
+  for (size_t i = 0; i < attachments_.size(); ++i)
+    code << "layout(location = " << i << ") out vec4 gbuffer_out" << i
+         << ";\n";
+  code << GEOMETRY_HELPERS << "\n";
+  code << "void write_decal(vec3 normal, vec3 albedo, float opacity) {\n";
+  for (size_t i = 0; i < attachments_.size(); ++i)
+    code << "    gbuffer_out" << i << " = vec4(0, 0, 0, opacity);\n";
+  for (auto& field : fields_) {
+    if (!IsDecalField(field)) continue;
+    std::string value;
+    if (field.type == NORMAL)
+      value = "normal";
+    else if (field.type == NORMAL_OCTAHEDRAL)
+      value = "encode_octahedral(normal)";
+    else
+      value = "albedo";
+    code << "    gbuffer_out" << field.attachment << "."
+         << std::string(CHANNELS + field.first_channel, field.n_channels)
+         << " = " << Encode(field, value) << ";\n";
+  }
+  code << "}\n";
+  return code.str();
+}
+
+std::vector<glm::bvec4> GBufferLayout::GetDecalMasks() {
+  std::vector<glm::bvec4> masks(attachments_.size(), glm::bvec4(false));
+  for (auto& field : fields_) {
+    if (!IsDecalField(field)) continue;
+    for (int i = 0; i < field.n_channels; ++i)
+      masks[field.attachment][field.first_channel + i] = true;
+  }
+  return masks;
+}
+
+std::string GBufferLayout::GenerateLightingPassCode(int samples) {
+  bool multisampled = samples > 1;
+  auto sampler = multisampled ? "sampler2DMS" : "sampler2D";
+  auto sample = multisampled ? "sample_index" : "0";
+  std::stringstream code;
+  code << "// G-buffer layout: " << description_ << "\n";
+  code << "#define GBUFFER_SAMPLES " << (multisampled ? samples : 1) << "\n";
+  // Fixed units, so the samplers are never set (see FrameBuffer::BindTextures)
+  auto n = attachments_.size();
+  for (size_t i = 0; i < n; ++i)
+    code << "layout(binding = " << i << ") uniform " << sampler << " "
+         << GetSamplerName(i) << ";\n";
+  code << "layout(binding = " << n << ") uniform " << sampler
+       << " gbuffer_depth;\n";
+  code << "#define GBUFFER_TEXTURES " << n + 1 << "  // first free unit\n";
+  code << "uniform mat4 inv_projection;\n";
+  code << "uniform vec2 gbuffer_size;  // rendered size, below the capacity\n";
+  code << GenerateReadFunctions(false, sample);
+  return code.str();
+}
+
+std::string GBufferLayout::GenerateFetchLightingPassCode() {
+  if (!StoresPosition())
+    throw std::runtime_error("the framebuffer fetch needs the position in "
+                             "the G-buffer layout");
+  std::stringstream code;
+  code << "#extension GL_EXT_shader_framebuffer_fetch : require\n";
+  code << "// G-buffer layout: " << description_ << "\n";
+  code << "#define GBUFFER_SAMPLES 1\n";
+  code << "#define GBUFFER_FETCH\n";
+  auto n = attachments_.size();
+  for (size_t i = 0; i < n; ++i)
+    code << "layout(location = " << i << ") inout vec4 gbuffer_fetch" << i
+         << ";\n";
+  code << "#define GBUFFER_LIT_LOCATION " << n << "\n";
+  // No samplers, the units after the attachments stay as in the other passes
+  code << "#define GBUFFER_TEXTURES " << n + 1 << "  // first free unit\n";
+  code << "uniform mat4 inv_projection;\n";
+  code << "uniform vec2 gbuffer_size;  // rendered size, below the capacity\n";
+  code << GenerateReadFunctions(true, "0");
+  return code.str();
+}
+
+std::string GBufferLayout::GenerateReadFunctions(bool framebuffer_fetch,
+                                                 const std::string& sample) {
+  std::stringstream code;
+  code << LIGHTING_HELPERS << "\n";
+  auto source = [&](int attachment) -> std::string {
+    if (framebuffer_fetch)
+      return "gbuffer_fetch" + std::to_string(attachment);
+    return "texelFetch(" + GetSamplerName(attachment) + ", coord, " + sample +
+           ")";
+  };
+  code << "// Reads a G-buffer sample, returns false for background pixels\n";
+  code << "bool read_gbuffer(ivec2 coord, int sample_index, out vec3 position,"
+       << "\n                 out vec3 normal, out int material) {\n";
+
+  // The material is read first so the background skips the other fetches
+  std::vector<bool> fetched(attachments_.size(), false);
+  auto fetch = [&](int attachment) {
+    if (fetched[attachment]) return;
+    fetched[attachment] = true;
+    code << "    vec4 gbuffer_in" << attachment << " = " << source(attachment)
+         << ";\n";
+  };
+  auto channels = [&](const Field& field) {
+    return "gbuffer_in" + std::to_string(field.attachment) + "." +
+           std::string(CHANNELS + field.first_channel, field.n_channels);
+  };
+  for (auto& field : fields_) {
+    if (field.type != MATERIAL) continue;
+    fetch(field.attachment);
+    code << "    material = int(round(" << Decode(field, channels(field))
+         << ")) - 1;\n";
+    code << "    if (material < 0)\n"
+         << "        return false;\n";
+  }
+  bool has_position = false;
+  for (auto& field : fields_) {
+    switch (field.type) {
+      case POSITION:
+        fetch(field.attachment);
+        code << "    position = " << Decode(field, channels(field)) << ";\n";
+        has_position = true;
+        break;
+      case NORMAL:
+        fetch(field.attachment);
+        code << "    normal = normalize(" << Decode(field, channels(field))
+             << ");\n";
+        break;
+      case NORMAL_OCTAHEDRAL:
+        fetch(field.attachment);
+        code << "    normal = normalize(decode_octahedral("
+             << Decode(field, channels(field)) << "));\n";
+        break;
+      default:
+        break;
+    }
+  }
+  if (!has_position)
+    code << "    vec2 uv = (vec2(coord) + 0.5) / gbuffer_size;\n"
+         << "    float depth = texelFetch(gbuffer_depth, coord, " << sample
+         << ").x;\n"
+         << "    position = reconstruct_position(uv, depth);\n";
+  code << "    return true;\n";
+  code << "}\n";
+
+  code << "\n// Reads the albedo of a G-buffer sample\n";
+  code << "vec3 read_albedo(ivec2 coord, int sample_index) {\n";
+  std::string albedo = "vec3(1)";
+  for (auto& field : fields_) {
+    if (field.type != ALBEDO) continue;
+    albedo = Decode(field, source(field.attachment) + "." +
+                               std::string(CHANNELS + field.first_channel,
+                                           field.n_channels));
+  }
+  code << "    return " << albedo << ";\n";
+  code << "}\n";
+  return code.str();
+}
+
+void GBufferLayout::PrintPresets() {
+  for (auto& preset : PRESETS)
+    printf("%-12s %s\n", preset.name, preset.description);
+}
+
+void GBufferLayout::AddField(const std::string& name) {
+  Field field;
+  field.name = name;
+  if (name == "position") {
+    field.type = POSITION;
+    field.n_channels = 3;
+  } else if (name == "normal") {
+    field.type = NORMAL;
+    field.n_channels = 3;
+  } else if (name == "normal.oct") {
+    field.type = NORMAL_OCTAHEDRAL;
+    field.n_channels = 2;
+  } else if (name == "material") {
+    field.type = MATERIAL;
+    field.n_channels = 1;
+  } else if (name == "albedo") {
+    field.type = ALBEDO;
+    field.n_channels = 3;
+  } else {
+    throw std::runtime_error("unknown G-buffer field: " + name);
+  }
+
+  field.attachment = attachments_.size() - 1;
+  field.first_channel = 0;
+  for (auto& other : fields_) {
+    if (other.type == field.type)
+      throw std::runtime_error("repeated G-buffer field: " + name);
+    if (other.attachment == field.attachment)
+      field.first_channel += other.n_channels;
+  }
+
+  auto format = formats_.back();
+  if (field.first_channel + field.n_channels > format->n_channels)
+    throw std::runtime_error(std::string("not enough channels in ") +
+                             format->name + " for " + name);
+  if (field.type == POSITION && format->max_value)
+    throw std::runtime_error("the position requires a float format");
+  fields_.push_back(field);
+}
+
+glm::vec4 GBufferLayout::Quantize(const Format* format, glm::vec4 value) {
+  if (format->type == GL_HALF_FLOAT) {
+    auto xy = glm::unpackHalf2x16(glm::packHalf2x16(glm::vec2(value)));
+    auto zw = glm::unpackHalf2x16(
+        glm::packHalf2x16(glm::vec2(value.z, value.w)));
+    return glm::vec4(xy, zw);
+  } else if (format->max_value) {
+    float max_value = format->max_value;
+    if (!format->is_signed) value = value * 0.5f + 0.5f;
+    auto low = format->is_signed ? -1.0f : 0.0f;
+    value = glm::round(glm::clamp(value, low, 1.0f) * max_value) / max_value;
+    if (!format->is_signed) value = value * 2.0f - 1.0f;
+    return value;
+  }
+  return value;
+}
+
+void GBufferLayout::UpdateDescription() {
+  description_.clear();
+  for (size_t i = 0; i < attachments_.size(); ++i) {
+    if (i > 0) description_ += ",";
+    description_ += attachments_[i].format + "=";
+    bool first = true;
+    for (auto& field : fields_) {
+      if (field.attachment != (int)i) continue;
+      if (!first) description_ += "+";
+      description_ += field.name;
+      first = false;
+    }
+  }
+}
+
+bool GBufferLayout::IsDecalField(const Field& field) {
+  // The alpha channel holds the opacity of the blending
+  bool blendable = field.type == NORMAL ||
+                   field.type == NORMAL_OCTAHEDRAL || field.type == ALBEDO;
+  return blendable && field.first_channel + field.n_channels <= 3;
+}
+
+std::string GBufferLayout::Encode(const Field& field,
+                                  const std::string& value) {
+  auto format = formats_[field.attachment];
+  if (!format->max_value) return value;
+  auto max_value = std::to_string(format->max_value) + ".0";
+  if (field.type == MATERIAL) return value + " / " + max_value;
+  // The albedo is already in [0, 1]
+  if (format->is_signed || field.type == ALBEDO) return value;
+  return value + " * 0.5 + 0.5";
+}
+
+std::string GBufferLayout::Decode(const Field& field,
+                                  const std::string& value) {
+  auto format = formats_[field.attachment];
+  if (!format->max_value) return value;
+  auto max_value = std::to_string(format->max_value) + ".0";
+  if (field.type == MATERIAL) return value + " * " + max_value;
+  if (format->is_signed || field.type == ALBEDO) return value;
+  return value + " * 2 - 1";
+}
+
+const GBufferLayout::Format* GBufferLayout::FindFormat(
+    const std::string& name) {
+  static const Format formats[] = {
+      {"r8", GL_R8, GL_RED, GL_UNSIGNED_BYTE, 1, 1, 255, false, nullptr},
+      {"rg8", GL_RG8, GL_RG, GL_UNSIGNED_BYTE, 2, 2, 255, false, nullptr},
+      {"rgba8", GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, 4, 4, 255, false,
+       nullptr},
+      {"r16", GL_R16, GL_RED, GL_UNSIGNED_SHORT, 1, 2, 65535, false, nullptr},
+      {"rg16", GL_RG16, GL_RG, GL_UNSIGNED_SHORT, 2, 4, 65535, false,
+       nullptr},
+      {"rgba16", GL_RGBA16, GL_RGBA, GL_UNSIGNED_SHORT, 4, 8, 65535, false,
+       nullptr},
+      {"rg16snorm", GL_RG16_SNORM, GL_RG, GL_SHORT, 2, 4, 32767, true,
+       nullptr},
+      {"rgba16snorm", GL_RGBA16_SNORM, GL_RGBA, GL_SHORT, 4, 8, 32767, true,
+       nullptr},
+      {"r16f", GL_R16F, GL_RED, GL_HALF_FLOAT, 1, 2, 0, true, nullptr},
+      {"rg16f", GL_RG16F, GL_RG, GL_HALF_FLOAT, 2, 4, 0, true, nullptr},
+      {"rgba16f", GL_RGBA16F, GL_RGBA, GL_HALF_FLOAT, 4, 8, 0, true, nullptr},
+      {"r32f", GL_R32F, GL_RED, GL_FLOAT, 1, 4, 0, true, "r16f"},
+      {"rg32f", GL_RG32F, GL_RG, GL_FLOAT, 2, 8, 0, true, "rg16f"},
+      // RGB16F isn't required to be color-renderable, so RGBA16F is used
+      {"rgb32f", GL_RGB32F, GL_RGB, GL_FLOAT, 3, 12, 0, true, "rgba16f"},
+      {"rgba32f", GL_RGBA32F, GL_RGBA, GL_FLOAT, 4, 16, 0, true, "rgba16f"},
+  };
+  for (auto& format : formats)
+    if (name == format.name) return &format;
+  return nullptr;
+}
@@ -0,0 +1,247 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef GBUFFERLAYOUT_H
+#define GBUFFERLAYOUT_H
+
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+/**
+ * Declarative description of the G-buffer
+ *
+ * The layout is written as a list of attachments, each one with its format and
+ * the fields packed in its channels, for instance:
+ *
+ *     rgb32f=normal,rgba8=albedo+material
+ *     rgba16f=normal.oct+material,rgba8=albedo
+ *
+ * Fields: position (3 channels), normal (3), normal.oct (2), material (1) and
+ * albedo (3), the color of the diffuse map. The position is rebuilt from the
+ * depth buffer when it isn't in the layout, and the albedo is white.
+ * The frame buffer attachments and the G-buffer code of both passes are
+ * generated from it.
+ */
+class GBufferLayout {
+public:
+  /**
+   * Render target of the layout
+   */
+  struct Attachment {
+    std::string format;
+    int internal_format;
+    int base_format;
+    int type;
+    int bytes_per_pixel;
+  };
+
+  /**
+   * Default constructor, uses the default layout
+   */
+  GBufferLayout();
+
+  /**
+   * Parses a layout description or a preset name
+   * Throws runtime_error if the description is invalid
+   */
+  void Parse(const std::string& description);
+
+  /**
+   * Replaces the 32 bits float formats by their 16 bits equivalents
+   */
+  void UseHalfFloats();
+
+  /**
+   * Error of the stored values compared to exact fp32 values
+   */
+  struct PrecisionReport {
+    double mean_position_error;
+    double max_position_error;
+    double max_relative_position_error;  // error / distance to the eye
+    double mean_normal_error;            // degrees
+    double max_normal_error;             // degrees
+  };
+
+  /**
+   * Measures the precision of the layout by simulating the G-buffer storage
+   * of random points in the view frustum
+   */
+  PrecisionReport ComputePrecision(const glm::mat4& projection, float near,
+                                   float far);
+
+  /**
+   * Obtains the layout attachments
+   */
+  const std::vector<Attachment>& GetAttachments();
+
+  /**
+   * Obtains the sampler name of an attachment in the lighting pass
+   */
+  std::string GetSamplerName(int attachment);
+
+  /**
+   * Returns true if the position is stored in a render target
+   */
+  bool StoresPosition();
+
+  /**
+   * Obtains the index of the attachment that stores the material
+   */
+  int GetMaterialAttachment();
+
+  /**
+   * Obtains the number of materials the material channel stores exactly, 0
+   * being the background
+   */
+  int GetMaterialCapacity();
+
+  /**
+   * Obtains the number of bytes per pixel, including the depth buffer
+   */
+  int GetBytesPerPixel();
+
+  /**
+   * Obtains the layout description
+   */
+  const std::string& GetDescription();
+
+  /**
+   * Generates the geometry pass outputs and write_gbuffer()
+   */
+  std::string GenerateGeometryPassCode();
+
+  /**
+   * Generates the decal pass outputs and write_decal(), which blends the
+   * normal and the albedo with the opacity in the alpha of the outputs
+   * Only the fields in the rgb channels can be blended, the others are left
+   * out of the channels written, given by GetDecalMasks()
+   */
+  std::string GenerateDecalPassCode();
+
+  /**
+   * Obtains the channels of each attachment written by the decals
+   */
+  std::vector<glm::bvec4> GetDecalMasks();
+
+  /**
+   * Generates the lighting pass samplers, read_gbuffer() and read_albedo()
+   * With more than one sample the samplers are multisampled and
+   * GBUFFER_SAMPLES is defined. The samplers use the units of the attachments
+   * and then the depth, and GBUFFER_TEXTURES is the number of those units
+   */
+  std::string GenerateLightingPassCode(int samples = 0);
+
+  /**
+   * Generates read_gbuffer() and read_albedo() for a lighting pass rendered
+   * into the G-buffer, which read the attachments back as inout outputs
+   * (EXT_shader_framebuffer_fetch) so they can stay in tile memory; the lit
+   * color goes after them, at GBUFFER_LIT_LOCATION
+   * Throws runtime_error if the layout doesn't store the position, since the
+   * depth can't be fetched
+   */
+  std::string GenerateFetchLightingPassCode();
+
+  /**
+   * Prints the list of presets
+   */
+  static void PrintPresets();
+
+private:
+  /**
+   * Value packed in the channels of an attachment
+   */
+  enum FieldType { POSITION, NORMAL, NORMAL_OCTAHEDRAL, MATERIAL, ALBEDO };
+
+  struct Field {
+    std::string name;
+    FieldType type;
+    int attachment;
+    int first_channel;
+    int n_channels;
+  };
+
+  /**
+   * Information about the formats accepted in the description
+   */
+  struct Format {
+    const char* name;
+    int internal_format;
+    int base_format;
+    int type;
+    int n_channels;
+    int bytes_per_pixel;
+    int max_value;  // 0 for float formats, else value that maps to 1.0
+    bool is_signed;
+    const char* half_format;  // 16 bits equivalent of 32 bits float formats
+  };
+
+  /**
+   * Adds the field given its name to the last attachment
+   */
+  void AddField(const std::string& name);
+
+  /**
+   * Returns true if the decals blend the field
+   */
+  static bool IsDecalField(const Field& field);
+
+  /**
+   * Obtains the glsl code that converts a value to the attachment format
+   */
+  std::string Encode(const Field& field, const std::string& value);
+
+  /**
+   * Obtains the glsl code that converts the attachment value back
+   */
+  std::string Decode(const Field& field, const std::string& value);
+
+  /**
+   * Generates read_gbuffer() and read_albedo(), which read the attachments
+   * from their inout outputs with framebuffer_fetch or else from their
+   * samplers
+   */
+  std::string GenerateReadFunctions(bool framebuffer_fetch,
+                                    const std::string& sample);
+
+  /**
+   * Simulates the storage of a value in a format
+   */
+  static glm::vec4 Quantize(const Format* format, glm::vec4 value);
+
+  /**
+   * Updates the textual description given the attachments and the fields
+   */
+  void UpdateDescription();
+
+  static const Format* FindFormat(const std::string& name);
+
+  std::string description_;
+  std::vector<Attachment> attachments_;
+  std::vector<const Format*> formats_;
+  std::vector<Field> fields_;
+};
+
+#endif
@@ -0,0 +1,100 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef GLCHECK_H
+#define GLCHECK_H
+
+/**
+ * Gl error checking policy, chosen at compile time by GL_CHECKS; the sources
+ * include this header instead of GL/glew.h
+ *
+ * 2: every call of a function glew loads is followed by glGetError(), and an
+ *    error is printed with the function and the line that called it; the
+ *    debug messages of the driver are synchronous
+ * 1: only the debug messages of the driver are printed, asynchronously, so
+ *    the driver doesn't wait on the gpu to report them
+ * 0: nothing, the calls go straight to the glew function pointers
+ *
+ * Without GL_CHECKS, builds without NDEBUG check every call and the others
+ * nothing. The core functions of OpenGL 1.1, such as glEnable(), aren't
+ * loaded by glew and aren't checked themselves: their errors are reported
+ * by the next checked call.
+ */
+#ifndef GL_CHECKS
+#ifdef NDEBUG
+#define GL_CHECKS 0
+#else
+#define GL_CHECKS 2
+#endif
+#endif
+
+#if GL_CHECKS >= 2
+#define GLEW_GET_FUN(function) \
+  GLCheck::Call<decltype(function)>{function, #function, __FILE__, __LINE__}
+#endif
+
+#include <GL/glew.h>
+
+#include "GLDebug.h"
+
+#if GL_CHECKS >= 2
+namespace GLCheck {
+
+/**
+ * Glew function pointer that checks the errors after every call
+ */
+template <typename Function>
+struct Call;
+
+template <typename Result, typename... Args>
+struct Call<Result(GLAPIENTRY*)(Args...)> {
+  Result(GLAPIENTRY* function)(Args...);
+  const char* name;
+  const char* file;
+  int line;
+
+  Result operator()(Args... args) const {
+    Result result = function(args...);
+    GLDebug::CheckError(name, file, line);
+    return result;
+  }
+};
+
+template <typename... Args>
+struct Call<void(GLAPIENTRY*)(Args...)> {
+  void(GLAPIENTRY* function)(Args...);
+  const char* name;
+  const char* file;
+  int line;
+
+  void operator()(Args... args) const {
+    function(args...);
+    GLDebug::CheckError(name, file, line);
+  }
+};
+
+}  // namespace GLCheck
+#endif
+
+#endif
@@ -0,0 +1,67 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "GLCommandList.h"
+
+GLCommandList::GLCommandList() {}
+
+void GLCommandList::Reset() { commands_.clear(); }
+
+void GLCommandList::SetUniform(ShaderProgram* program,
+                               ShaderProgram::Uniform uniform,
+                               const glm::vec3& value) {
+  commands_.push_back({UNIFORM_VEC3, program, uniform, glm::vec4(value, 0),
+                       nullptr, 0, 0});
+}
+
+void GLCommandList::SetUniform(ShaderProgram* program,
+                               ShaderProgram::Uniform uniform,
+                               const glm::vec4& value) {
+  commands_.push_back(
+      {UNIFORM_VEC4, program, uniform, value, nullptr, 0, 0});
+}
+
+void GLCommandList::Draw(MeshArena* arena, int mesh, int primitive) {
+  commands_.push_back({DRAW, nullptr, {-1}, glm::vec4(0), arena, mesh,
+                       primitive});
+}
+
+void GLCommandList::Execute() {
+  for (auto& command : commands_) {
+    switch (command.type) {
+      case UNIFORM_VEC3:
+        command.program->SetUniform(command.uniform,
+                                    glm::vec3(command.value));
+        break;
+      case UNIFORM_VEC4:
+        command.program->SetUniform(command.uniform, command.value);
+        break;
+      case DRAW:
+        command.arena->Draw(command.mesh, command.primitive);
+        break;
+    }
+  }
+}
+
+int GLCommandList::GetSize() { return commands_.size(); }
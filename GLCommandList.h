@@ -0,0 +1,74 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef GLCOMMANDLIST_H
+#define GLCOMMANDLIST_H
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "CommandList.h"
+#include "MeshArena.h"
+#include "ShaderProgram.h"
+
+/**
+ * Command list of the gl backend, which replays the recorded commands with
+ * the usual calls on the render thread
+ *
+ * The list keeps its storage, so recording a similar frame allocates nothing.
+ */
+class GLCommandList : public CommandList {
+public:
+  /**
+   * Default constructor
+   */
+  GLCommandList();
+
+  void Reset() override;
+  void SetUniform(ShaderProgram* program, ShaderProgram::Uniform uniform,
+                  const glm::vec3& value) override;
+  void SetUniform(ShaderProgram* program, ShaderProgram::Uniform uniform,
+                  const glm::vec4& value) override;
+  void Draw(MeshArena* arena, int mesh, int primitive) override;
+  void Execute() override;
+  int GetSize() override;
+
+private:
+  enum CommandType { UNIFORM_VEC3, UNIFORM_VEC4, DRAW };
+
+  struct Command {
+    CommandType type;
+    ShaderProgram* program;
+    ShaderProgram::Uniform uniform;
+    glm::vec4 value;
+    MeshArena* arena;
+    int mesh;
+    int primitive;
+  };
+
+  std::vector<Command> commands_;
+};
+
+#endif
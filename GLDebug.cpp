@@ -0,0 +1,89 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <cstdio>
+
+#include "GLCheck.h"
+#include "GLDebug.h"
+
+namespace {
+
+// Prints a message of the driver, the notifications are left out
+void APIENTRY PrintMessage(GLenum source, GLenum type, GLuint id,
+                           GLenum severity, GLsizei length,
+                           const GLchar* message, const void* user) {
+  if (severity == GL_DEBUG_SEVERITY_NOTIFICATION)
+    return;
+  const char* kind = "message";
+  if (type == GL_DEBUG_TYPE_ERROR)
+    kind = "error";
+  else if (type == GL_DEBUG_TYPE_PERFORMANCE)
+    kind = "performance";
+  else if (type == GL_DEBUG_TYPE_DEPRECATED_BEHAVIOR ||
+           type == GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR ||
+           type == GL_DEBUG_TYPE_PORTABILITY)
+    kind = "warning";
+  fprintf(stderr, "gl %s %u: %s\n", kind, id, message);
+}
+
+}  // namespace
+
+void GLDebug::Label(unsigned int identifier, unsigned int name,
+                    const std::string& label) {
+  if (!GLEW_KHR_debug || !name || label.empty())
+    return;
+  glObjectLabel(identifier, name, label.size(), label.c_str());
+}
+
+void GLDebug::PushGroup(const std::string& name) {
+  if (GLEW_KHR_debug)
+    glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, name.size(),
+                     name.c_str());
+}
+
+void GLDebug::PopGroup() {
+  if (GLEW_KHR_debug)
+    glPopDebugGroup();
+}
+
+void GLDebug::InstallCallback(bool synchronous) {
+  if (!GLEW_KHR_debug)
+    return;
+  // Synchronous, a break in the callback shows the call that caused it
+  glEnable(GL_DEBUG_OUTPUT);
+  if (synchronous)
+    glEnable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+  glDebugMessageCallback(PrintMessage, nullptr);
+}
+
+void GLDebug::CheckError(const char* function, const char* file, int line) {
+  for (GLenum error; (error = glGetError()) != GL_NO_ERROR;) {
+    // The glew pointers are named __glew<Function>
+    std::string name = function;
+    if (name.compare(0, 6, "__glew") == 0)
+      name = "gl" + name.substr(6);
+    fprintf(stderr, "gl error 0x%04x at %s, %s:%d\n", error, name.c_str(),
+            file, line);
+  }
+}
@@ -0,0 +1,66 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef GLDEBUG_H
+#define GLDEBUG_H
+
+#include <string>
+
+/**
+ * KHR_debug names and groups, as shown by frame debuggers and profilers
+ *
+ * The wrapper classes label their objects with the names they are given, and
+ * the render graph puts the commands of each pass in a group named after
+ * it. Without KHR_debug every call does nothing.
+ */
+class GLDebug {
+public:
+  /**
+   * Names an object, with its KHR_debug identifier (e.g. GL_BUFFER)
+   * An empty label is skipped
+   */
+  static void Label(unsigned int identifier, unsigned int name,
+                    const std::string& label);
+
+  /**
+   * Starts and ends a named group of commands; groups nest
+   */
+  static void PushGroup(const std::string& name);
+  static void PopGroup();
+
+  /**
+   * Prints the errors, warnings and performance messages of the driver to
+   * stderr, as the calls cause them if synchronous; the context should be a
+   * debug one
+   */
+  static void InstallCallback(bool synchronous);
+
+  /**
+   * Prints the errors of the calls since the last check, after a call of a
+   * function at a line of a file, see GLCheck.h
+   */
+  static void CheckError(const char* function, const char* file, int line);
+};
+
+#endif
@@ -0,0 +1,83 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "GLDevice.h"
+
+#include "GLCommandList.h"
+
+GLDevice::GLDevice() {}
+
+void GLDevice::CreateBuffer(UniformBuffer* buffer, const std::string& label,
+                            UniformBuffer::Target target,
+                            UniformBuffer::Usage usage, int slots) {
+  buffer->Init(target, usage, slots);
+  buffer->SetLabel(label);
+}
+
+void GLDevice::CreateRenderTarget(FrameBuffer* target,
+                                  const std::string& label, int width,
+                                  int height, FrameBuffer::DepthMode depth_mode,
+                                  int samples) {
+  target->Init(width, height, depth_mode, samples);
+  target->SetLabel(label);
+}
+
+void GLDevice::CreateGraphicsPipeline(ShaderProgram* program,
+                                      const std::string& vertex_path,
+                                      const std::string& vertex_header,
+                                      const std::string& fragment_path,
+                                      const std::string& fragment_header) {
+  program->LoadVertexShader(vertex_path, vertex_header);
+  if (!fragment_path.empty())
+    program->LoadFragmentShader(fragment_path, fragment_header);
+  program->BeginLink();
+}
+
+void GLDevice::CreateVertexStage(ShaderProgram* program,
+                                 const std::string& path,
+                                 const std::string& header) {
+  program->SetSeparable();
+  program->LoadVertexShader(path, header);
+  program->BeginLink();
+}
+
+void GLDevice::CreateScreenPipeline(ShaderProgram* program,
+                                    ShaderProgram* vertex_stage,
+                                    const std::string& fragment_path,
+                                    const std::string& fragment_header) {
+  program->SetVertexProgram(vertex_stage);
+  program->LoadFragmentShader(fragment_path, fragment_header);
+  program->BeginLink();
+}
+
+void GLDevice::CreateComputePipeline(ShaderProgram* program,
+                                     const std::string& path,
+                                     const std::string& header) {
+  program->LoadComputeShader(path, header);
+  program->BeginLink();
+}
+
+std::unique_ptr<CommandList> GLDevice::CreateCommandList() {
+  return std::unique_ptr<CommandList>(new GLCommandList());
+}
@@ -0,0 +1,68 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef GLDEVICE_H
+#define GLDEVICE_H
+
+#include <memory>
+#include <string>
+
+#include "RenderDevice.h"
+
+/**
+ * Render device of the gl backend
+ *
+ * It initializes the wrapper classes directly, links the programs with
+ * BeginLink() so they build in parallel, and creates GLCommandList lists.
+ */
+class GLDevice : public RenderDevice {
+public:
+  /**
+   * Default constructor
+   */
+  GLDevice();
+
+  void CreateBuffer(UniformBuffer* buffer, const std::string& label,
+                    UniformBuffer::Target target, UniformBuffer::Usage usage,
+                    int slots = 3) override;
+  void CreateRenderTarget(FrameBuffer* target, const std::string& label,
+                          int width, int height,
+                          FrameBuffer::DepthMode depth_mode,
+                          int samples = 0) override;
+  void CreateGraphicsPipeline(
+      ShaderProgram* program, const std::string& vertex_path,
+      const std::string& vertex_header, const std::string& fragment_path = "",
+      const std::string& fragment_header = "") override;
+  void CreateVertexStage(ShaderProgram* program, const std::string& path,
+                         const std::string& header = "") override;
+  void CreateScreenPipeline(ShaderProgram* program,
+                            ShaderProgram* vertex_stage,
+                            const std::string& fragment_path,
+                            const std::string& fragment_header = "") override;
+  void CreateComputePipeline(ShaderProgram* program, const std::string& path,
+                             const std::string& header = "") override;
+  std::unique_ptr<CommandList> CreateCommandList() override;
+};
+
+#endif
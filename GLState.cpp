@@ -0,0 +1,134 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <algorithm>
+
+#include "GLCheck.h"
+#include "GLState.h"
+
+namespace {
+
+// Name that no object has, so the next bind isn't skipped
+const unsigned int UNKNOWN = ~0u;
+
+// Stores the names bound to consecutive units, returns false if they were
+// all bound already
+bool UpdateUnits(std::vector<unsigned int>* bound, int first_unit, int n,
+                 const unsigned int* names) {
+  if (first_unit + n > (int)bound->size())
+    bound->resize(first_unit + n, 0);
+  auto first = bound->begin() + first_unit;
+  if (std::equal(names, names + n, first))
+    return false;
+  std::copy(names, names + n, first);
+  return true;
+}
+
+}  // namespace
+
+unsigned int GLState::program_ = 0;
+unsigned int GLState::pipeline_ = 0;
+unsigned int GLState::vertex_array_ = 0;
+std::vector<unsigned int> GLState::textures_;
+std::vector<unsigned int> GLState::samplers_;
+int GLState::draws_ = 0;
+
+void GLState::UseProgram(unsigned int program) {
+  if (program_ == program)
+    return;
+  glUseProgram(program);
+  program_ = program;
+}
+
+void GLState::BindProgramPipeline(unsigned int pipeline) {
+  UseProgram(0);
+  if (pipeline_ == pipeline)
+    return;
+  glBindProgramPipeline(pipeline);
+  pipeline_ = pipeline;
+}
+
+void GLState::BindVertexArray(unsigned int vertex_array) {
+  if (vertex_array_ == vertex_array)
+    return;
+  glBindVertexArray(vertex_array);
+  vertex_array_ = vertex_array;
+}
+
+void GLState::BindTexture(int unit, unsigned int texture) {
+  if (UpdateUnits(&textures_, unit, 1, &texture))
+    glBindTextureUnit(unit, texture);
+}
+
+void GLState::BindTextures(int first_unit, int n,
+                           const unsigned int* textures) {
+  if (UpdateUnits(&textures_, first_unit, n, textures))
+    glBindTextures(first_unit, n, textures);
+}
+
+void GLState::BindSamplers(int first_unit, int n,
+                           const unsigned int* samplers) {
+  if (UpdateUnits(&samplers_, first_unit, n, samplers))
+    glBindSamplers(first_unit, n, samplers);
+}
+
+void GLState::DeleteProgram(unsigned int program) {
+  // A program in use is only deleted once it's no longer used, so its name
+  // can't be reused before the next UseProgram()
+  glDeleteProgram(program);
+  if (program_ == program)
+    program_ = UNKNOWN;
+}
+
+void GLState::DeleteProgramPipeline(unsigned int pipeline) {
+  glDeleteProgramPipelines(1, &pipeline);
+  if (pipeline_ == pipeline)
+    pipeline_ = 0;
+}
+
+void GLState::DeleteVertexArray(unsigned int vertex_array) {
+  glDeleteVertexArrays(1, &vertex_array);
+  if (vertex_array_ == vertex_array)
+    vertex_array_ = 0;
+}
+
+void GLState::DeleteTextures(int n, const unsigned int* textures) {
+  glDeleteTextures(n, textures);
+  for (auto& bound : textures_)
+    if (std::find(textures, textures + n, bound) != textures + n)
+      bound = 0;
+}
+
+void GLState::DeleteSampler(unsigned int sampler) {
+  glDeleteSamplers(1, &sampler);
+  std::replace(samplers_.begin(), samplers_.end(), sampler, 0u);
+}
+
+void GLState::CountDraw() { draws_++; }
+
+int GLState::TakeDrawCount() {
+  int draws = draws_;
+  draws_ = 0;
+  return draws;
+}
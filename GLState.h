@@ -0,0 +1,101 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef GLSTATE_H
+#define GLSTATE_H
+
+#include <vector>
+
+/**
+ * Cache of the bindings the wrapper classes change for every pass and draw
+ *
+ * Each bind is skipped when the object is already bound, and nothing is
+ * unbound after use: the next pass binds what it needs. The bindings cached
+ * here must only change through this class, and the objects must be deleted
+ * through it too, so a new object that reuses the name is bound again.
+ * The wrappers also count their draw calls here, for the statistics.
+ */
+class GLState {
+public:
+  /**
+   * Uses a program, which takes precedence over the bound pipeline
+   */
+  static void UseProgram(unsigned int program);
+
+  /**
+   * Binds a program pipeline and stops using the current program
+   */
+  static void BindProgramPipeline(unsigned int pipeline);
+
+  /**
+   * Binds a vertex array object
+   */
+  static void BindVertexArray(unsigned int vertex_array);
+
+  /**
+   * Binds a texture to a texture unit, whatever its target
+   */
+  static void BindTexture(int unit, unsigned int texture);
+
+  /**
+   * Binds textures to consecutive texture units with one call, skipped when
+   * they are all bound already
+   */
+  static void BindTextures(int first_unit, int n, const unsigned int* textures);
+
+  /**
+   * Binds sampler objects to consecutive texture units with one call, skipped
+   * when they are all bound already; zero uses the state of the texture
+   */
+  static void BindSamplers(int first_unit, int n, const unsigned int* samplers);
+
+  /**
+   * Deletes objects and forgets their bindings
+   */
+  static void DeleteProgram(unsigned int program);
+  static void DeleteProgramPipeline(unsigned int pipeline);
+  static void DeleteVertexArray(unsigned int vertex_array);
+  static void DeleteTextures(int n, const unsigned int* textures);
+  static void DeleteSampler(unsigned int sampler);
+
+  /**
+   * Counts a draw call; a multi-draw is one call
+   */
+  static void CountDraw();
+
+  /**
+   * Obtains the draw calls counted since the previous take
+   */
+  static int TakeDrawCount();
+
+private:
+  static unsigned int program_;
+  static unsigned int pipeline_;
+  static unsigned int vertex_array_;
+  static std::vector<unsigned int> textures_;  // by unit
+  static std::vector<unsigned int> samplers_;  // by unit
+  static int draws_;
+};
+
+#endif
@@ -0,0 +1,158 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <algorithm>
+#include <cstdio>
+
+#include "GLCheck.h"
+#include "GpuMemory.h"
+
+namespace {
+
+const double MEGABYTE = 1048576.0;
+
+}  // namespace
+
+long GpuMemory::bytes_[N_CATEGORIES] = {};
+long GpuMemory::peak_bytes_[N_CATEGORIES] = {};
+long GpuMemory::peak_total_bytes_ = 0;
+
+void GpuMemory::Allocate(Category category, long bytes) {
+  bytes_[category] += bytes;
+  peak_bytes_[category] = std::max(peak_bytes_[category], bytes_[category]);
+  peak_total_bytes_ = std::max(peak_total_bytes_, GetTotalBytes());
+}
+
+void GpuMemory::Free(Category category, long bytes) {
+  bytes_[category] -= bytes;
+}
+
+long GpuMemory::GetBytes(Category category) { return bytes_[category]; }
+
+long GpuMemory::GetPeakBytes(Category category) {
+  return peak_bytes_[category];
+}
+
+long GpuMemory::GetTotalBytes() {
+  long total = 0;
+  for (auto bytes : bytes_)
+    total += bytes;
+  return total;
+}
+
+long GpuMemory::GetPeakTotalBytes() { return peak_total_bytes_; }
+
+const char* GpuMemory::GetName(Category category) {
+  switch (category) {
+    case FRAMEBUFFERS:
+      return "framebuffers";
+    case RENDER_TARGETS:
+      return "render targets";
+    case MESHES:
+      return "meshes";
+    case STREAMING:
+      return "streaming";
+    default:
+      return "";
+  }
+}
+
+int GpuMemory::GetFormatSize(int internal_format) {
+  switch (internal_format) {
+    case GL_R8:
+      return 1;
+    case GL_RG8:
+    case GL_R16:
+    case GL_R16F:
+    case GL_DEPTH_COMPONENT16:
+      return 2;
+    case GL_RGBA8:
+    case GL_SRGB8_ALPHA8:
+    case GL_RGB10_A2:
+    case GL_R11F_G11F_B10F:
+    case GL_RG16:
+    case GL_RG16F:
+    case GL_RG16_SNORM:
+    case GL_R32F:
+    case GL_R32UI:
+    case GL_DEPTH_COMPONENT24:
+    case GL_DEPTH_COMPONENT32:
+    case GL_DEPTH_COMPONENT32F:
+    case GL_DEPTH24_STENCIL8:
+      return 4;
+    case GL_DEPTH32F_STENCIL8:
+    case GL_RGBA16:
+    case GL_RGBA16F:
+    case GL_RGBA16_SNORM:
+    case GL_RG32F:
+      return 8;
+    case GL_RGB32F:
+      return 12;
+    case GL_RGBA32F:
+      return 16;
+    default:
+      return 4;
+  }
+}
+
+bool GpuMemory::GetDriverMemory(long* available, long* total) {
+  // Both extensions report kilobytes
+  if (GLEW_NVX_gpu_memory_info) {
+    GLint available_kb = 0, total_kb = 0;
+    glGetIntegerv(GL_GPU_MEMORY_INFO_CURRENT_AVAILABLE_VIDMEM_NVX,
+                  &available_kb);
+    glGetIntegerv(GL_GPU_MEMORY_INFO_DEDICATED_VIDMEM_NVX, &total_kb);
+    *available = available_kb * 1024L;
+    *total = total_kb * 1024L;
+    return true;
+  }
+  if (GLEW_ATI_meminfo) {
+    // The free memory of the texture pool, then the largest free block and
+    // the same for the shared memory
+    GLint free_kb[4] = {};
+    glGetIntegerv(GL_TEXTURE_FREE_MEMORY_ATI, free_kb);
+    *available = free_kb[0] * 1024L;
+    *total = 0;
+    return true;
+  }
+  return false;
+}
+
+void GpuMemory::PrintStats() {
+  printf("gpu memory:\n");
+  for (int i = 0; i < N_CATEGORIES; ++i) {
+    auto category = (Category)i;
+    printf("  %-15s %8.1f MB, peak %8.1f MB\n", GetName(category),
+           bytes_[i] / MEGABYTE, peak_bytes_[i] / MEGABYTE);
+  }
+  printf("  %-15s %8.1f MB, peak %8.1f MB\n", "total",
+         GetTotalBytes() / MEGABYTE, peak_total_bytes_ / MEGABYTE);
+  long available, total;
+  if (GetDriverMemory(&available, &total)) {
+    printf("  driver          %8.1f MB available", available / MEGABYTE);
+    if (total)
+      printf(" of %.1f MB", total / MEGABYTE);
+    printf("\n");
+  }
+}
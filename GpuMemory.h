@@ -0,0 +1,92 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef GPUMEMORY_H
+#define GPUMEMORY_H
+
+/**
+ * Bytes of gpu memory allocated by the wrapper classes, by category
+ *
+ * The sizes are the ones requested from the driver, which may pad and
+ * align them; the driver's own view of the video memory is also reported
+ * where GL_NVX_gpu_memory_info or GL_ATI_meminfo is supported. Allocations
+ * are only counted from the gl thread.
+ */
+class GpuMemory {
+public:
+  enum Category {
+    FRAMEBUFFERS,    // attachments of the G-buffer and the light buffer
+    RENDER_TARGETS,  // transient targets of the render graph
+    MESHES,          // vertex and index buffers
+    STREAMING,       // buffers written every frame, and the upload staging
+    N_CATEGORIES
+  };
+
+  /**
+   * Counts bytes allocated and freed in a category
+   */
+  static void Allocate(Category category, long bytes);
+  static void Free(Category category, long bytes);
+
+  /**
+   * Obtains the bytes of a category now and at its peak
+   */
+  static long GetBytes(Category category);
+  static long GetPeakBytes(Category category);
+
+  /**
+   * Obtains the bytes of every category now and at the peak of the sum
+   */
+  static long GetTotalBytes();
+  static long GetPeakTotalBytes();
+
+  /**
+   * Obtains the name of a category
+   */
+  static const char* GetName(Category category);
+
+  /**
+   * Obtains the size of a texel of an internal format, in bytes
+   */
+  static int GetFormatSize(int internal_format);
+
+  /**
+   * Obtains the video memory available and, if known, the total as reported
+   * by the driver, in bytes, zero if unknown
+   * Returns false without an extension that reports it
+   */
+  static bool GetDriverMemory(long* available, long* total);
+
+  /**
+   * Prints the bytes of every category, the totals and the driver's view
+   */
+  static void PrintStats();
+
+private:
+  static long bytes_[N_CATEGORIES];
+  static long peak_bytes_[N_CATEGORIES];
+  static long peak_total_bytes_;
+};
+
+#endif
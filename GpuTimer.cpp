@@ -0,0 +1,114 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "CpuProfiler.h"
+#include "GLCheck.h"
+#include "GpuTimer.h"
+
+namespace {
+
+// Frames in the ring, more than the frames the gpu may lag behind
+const int N_FRAMES = 5;
+
+}  // namespace
+
+GpuTimer::GpuTimer()
+    : frames_(N_FRAMES), frame_(0), clock_offset_(0), calibrated_(false) {}
+
+GpuTimer::~GpuTimer() {
+  for (auto& frame : frames_)
+    if (!frame.queries.empty())
+      glDeleteQueries(frame.queries.size(), frame.queries.data());
+}
+
+void GpuTimer::BeginFrame() {
+  // The clocks are matched once, their drift over a run is small
+  if (CpuProfiler::IsEnabled() && !calibrated_) {
+    GLint64 gpu_time = 0;
+    glGetInteger64v(GL_TIMESTAMP, &gpu_time);
+    clock_offset_ = CpuProfiler::Now() - gpu_time;
+    calibrated_ = true;
+  }
+  frame_ = (frame_ + 1) % N_FRAMES;
+  Collect(&frames_[frame_]);
+}
+
+void GpuTimer::Begin(const std::string& name) {
+  int section = 0;
+  while (section < (int)sections_.size() && sections_[section].name != name)
+    ++section;
+  if (section == (int)sections_.size())
+    sections_.push_back({name, 0, 0});
+
+  // The queries are created once per slot and reused by later frames
+  auto& frame = frames_[frame_];
+  size_t n_queries = 2 * (frame.sections.size() + 1);
+  if (frame.queries.size() < n_queries) {
+    size_t first = frame.queries.size();
+    frame.queries.resize(n_queries);
+    glCreateQueries(GL_TIMESTAMP, n_queries - first,
+                    frame.queries.data() + first);
+  }
+  glQueryCounter(frame.queries[n_queries - 2], GL_TIMESTAMP);
+  frame.sections.push_back(section);
+}
+
+void GpuTimer::End() {
+  auto& frame = frames_[frame_];
+  glQueryCounter(frame.queries[2 * frame.sections.size() - 1], GL_TIMESTAMP);
+}
+
+const std::vector<GpuTimer::Section>& GpuTimer::GetSections() {
+  return sections_;
+}
+
+void GpuTimer::ResetSections() {
+  for (auto& section : sections_) {
+    section.milliseconds = 0;
+    section.frames = 0;
+  }
+}
+
+void GpuTimer::Collect(Frame* frame) {
+  if (frame->sections.empty())
+    return;
+  // The queries finish in order, so the last one covers the others
+  GLint available = 0;
+  glGetQueryObjectiv(frame->queries[2 * frame->sections.size() - 1],
+                     GL_QUERY_RESULT_AVAILABLE, &available);
+  if (available) {
+    for (size_t i = 0; i < frame->sections.size(); ++i) {
+      GLuint64 begin = 0, end = 0;
+      glGetQueryObjectui64v(frame->queries[2 * i], GL_QUERY_RESULT, &begin);
+      glGetQueryObjectui64v(frame->queries[2 * i + 1], GL_QUERY_RESULT, &end);
+      auto& section = sections_[frame->sections[i]];
+      section.milliseconds += (end - begin) / 1e6;
+      section.frames++;
+      if (calibrated_)
+        CpuProfiler::RecordGpu(section.name, begin + clock_offset_,
+                               end + clock_offset_);
+    }
+  }
+  frame->sections.clear();
+}
@@ -0,0 +1,103 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef GPUTIMER_H
+#define GPUTIMER_H
+
+#include <string>
+#include <vector>
+
+/**
+ * Gpu time of named sections of the frame, such as the render passes
+ *
+ * Each section is bracketed by two GL_TIMESTAMP queries. The queries of a
+ * frame are read when its slot of the ring comes back, several frames later,
+ * and only if the gpu is done with them, so the cpu never waits; a frame
+ * still in flight by then is dropped. Timestamps don't nest with the
+ * GL_TIME_ELAPSED queries of DynamicResolution, so both can run at once.
+ * While the CpuProfiler is enabled, the sections read are also added to its
+ * gpu track.
+ */
+class GpuTimer {
+public:
+  /**
+   * Average time of a section since the last reset
+   */
+  struct Section {
+    std::string name;
+    double milliseconds;  // summed over the frames
+    int frames;
+  };
+
+  /**
+   * Default constructor
+   */
+  GpuTimer();
+
+  /**
+   * Destructor
+   */
+  ~GpuTimer();
+
+  /**
+   * Starts a frame, reading the sections of the frame that last used its
+   * slot of the ring
+   */
+  void BeginFrame();
+
+  /**
+   * Starts and ends the timing of a section; sections don't nest
+   */
+  void Begin(const std::string& name);
+  void End();
+
+  /**
+   * Obtains the sections measured since the last reset, in the order they
+   * were first timed
+   */
+  const std::vector<Section>& GetSections();
+
+  /**
+   * Clears the measured times
+   */
+  void ResetSections();
+
+private:
+  // Queries issued in a slot of the ring, two per timed section
+  struct Frame {
+    std::vector<unsigned int> queries;
+    std::vector<int> sections;
+  };
+
+  // Reads the queries of a frame if they are available, and frees them
+  void Collect(Frame* frame);
+
+  std::vector<Frame> frames_;
+  int frame_;
+  std::vector<Section> sections_;
+  long long clock_offset_;  // from the gpu clock to the profiler's
+  bool calibrated_;
+};
+
+#endif
@@ -0,0 +1,179 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <utility>
+
+#include "BufferBindings.h"
+#include "GLCheck.h"
+#include "GLState.h"
+#include "GpuMemory.h"
+#include "GroundLightCache.h"
+
+namespace {
+
+// Texels per side of the texture and of its tiles, and tiles per side
+const int TEXTURE_SIZE = 2048;
+const int TILE_SIZE = 64;
+const int N_TILES = TEXTURE_SIZE / TILE_SIZE;
+
+// Threads per side of the work groups, each shading a tile
+const int GROUP_SIZE = 8;
+
+// Tiles shaded per frame at most, and lights kept per tile
+const int TILE_BUDGET = 64;
+const int MAX_TILE_LIGHTS = 256;
+
+// A stale tile is shaded again after a frame per this distance to the eye,
+// and at least every few frames
+const float REFRESH_DISTANCE = 20.0f;
+const int MAX_PERIOD = 8;
+
+// Format of the texture
+const int FORMAT = GL_RGBA16F;
+
+// Explicit uniform locations of the shader, after the tiles to shade
+const ShaderProgram::Uniform TILES = {0};
+const ShaderProgram::Uniform N_SHADED_TILES = {TILE_BUDGET};
+const ShaderProgram::Uniform GROUND = {TILE_BUDGET + 1};
+const ShaderProgram::Uniform LIGHT_ROTATION = {TILE_BUDGET + 2};
+const ShaderProgram::Uniform N_LIGHTS = {TILE_BUDGET + 6};
+
+}  // namespace
+
+GroundLightCache::GroundLightCache()
+    : texture_(0), sampler_(0), height_(0), half_size_(0), frame_(0),
+      allocated_bytes_(0) {}
+
+GroundLightCache::~GroundLightCache() {
+  if (texture_)
+    GLState::DeleteTextures(1, &texture_);
+  if (sampler_)
+    glDeleteSamplers(1, &sampler_);
+  GpuMemory::Free(GpuMemory::RENDER_TARGETS, allocated_bytes_);
+}
+
+void GroundLightCache::Init(float height, float half_size) {
+  height_ = height;
+  half_size_ = half_size;
+  glCreateTextures(GL_TEXTURE_2D, 1, &texture_);
+  glTextureStorage2D(texture_, 1, FORMAT, TEXTURE_SIZE, TEXTURE_SIZE);
+  allocated_bytes_ =
+      (long)TEXTURE_SIZE * TEXTURE_SIZE * GpuMemory::GetFormatSize(FORMAT);
+  GpuMemory::Allocate(GpuMemory::RENDER_TARGETS, allocated_bytes_);
+
+  glCreateSamplers(1, &sampler_);
+  glSamplerParameteri(sampler_, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glSamplerParameteri(sampler_, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glSamplerParameteri(sampler_, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glSamplerParameteri(sampler_, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+  stale_.assign(N_TILES * N_TILES, true);
+  refreshed_.assign(N_TILES * N_TILES, -MAX_PERIOD);
+
+  auto header = ShaderProgram::GenerateDefines(
+      {{"GROUP_SIZE", std::to_string(GROUP_SIZE)},
+       {"TILE_SIZE", std::to_string(TILE_SIZE)},
+       {"TILE_BUDGET", std::to_string(TILE_BUDGET)},
+       {"MAX_TILE_LIGHTS", std::to_string(MAX_TILE_LIGHTS)}});
+  shader_.LoadComputeShader("shaders/ground_cache_cs.glsl", header);
+  shader_.LinkShader();
+}
+
+void GroundLightCache::Invalidate() {
+  std::fill(stale_.begin(), stale_.end(), true);
+}
+
+void GroundLightCache::Invalidate(const glm::vec4& sphere) {
+  float tile_size = 2 * half_size_ / N_TILES;
+  float radius = std::sqrt(std::max(
+      sphere.w * sphere.w - (sphere.y - height_) * (sphere.y - height_),
+      0.0f));
+  if (radius == 0)
+    return;
+  auto first = glm::ivec2(glm::floor(
+      (glm::vec2(sphere.x, sphere.z) - radius + half_size_) / tile_size));
+  auto last = glm::ivec2(glm::floor(
+      (glm::vec2(sphere.x, sphere.z) + radius + half_size_) / tile_size));
+  first = glm::max(first, 0);
+  last = glm::min(last, N_TILES - 1);
+  for (int y = first.y; y <= last.y; ++y)
+    for (int x = first.x; x <= last.x; ++x)
+      stale_[y * N_TILES + x] = true;
+}
+
+int GroundLightCache::Update(const glm::vec3& eye, unsigned int lights,
+                             int n_lights, const glm::mat4& rotation) {
+  frame_++;
+  float tile_size = 2 * half_size_ / N_TILES;
+  std::vector<std::pair<float, int>> due;
+  for (int t = 0; t < N_TILES * N_TILES; ++t) {
+    if (!stale_[t])
+      continue;
+    glm::vec3 center(-half_size_ + (t % N_TILES + 0.5f) * tile_size, height_,
+                     -half_size_ + (t / N_TILES + 0.5f) * tile_size);
+    float distance = glm::distance(eye, center);
+    int period = std::min(1 + (int)(distance / REFRESH_DISTANCE), MAX_PERIOD);
+    if (frame_ - refreshed_[t] >= period)
+      due.push_back({distance, t});
+  }
+  int n = std::min<int>(due.size(), TILE_BUDGET);
+  if (n == 0)
+    return 0;
+  std::partial_sort(due.begin(), due.begin() + n, due.end());
+
+  glm::vec4 tiles[TILE_BUDGET];
+  for (int i = 0; i < n; ++i) {
+    int t = due[i].second;
+    tiles[i] = glm::vec4(t % N_TILES, t / N_TILES, 0, 0);
+    stale_[t] = false;
+    refreshed_[t] = frame_;
+  }
+  shader_.Enable();
+  shader_.SetUniform(TILES, tiles, n);
+  shader_.SetUniform(N_SHADED_TILES, n);
+  shader_.SetUniform(GROUND, glm::vec4(-half_size_, -half_size_,
+                                       tile_size / TILE_SIZE, height_));
+  shader_.SetUniform(LIGHT_ROTATION, rotation);
+  shader_.SetUniform(N_LIGHTS, n_lights);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER,
+                   buffer_bindings::WORLD_SPOT_LIGHTS, lights);
+  glBindImageTexture(0, texture_, 0, GL_FALSE, 0, GL_WRITE_ONLY, FORMAT);
+  shader_.SetUniform("cache_image", 0);
+  glDispatchCompute(n, 1, 1);
+  glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+  return n;
+}
+
+void GroundLightCache::Bind(ShaderProgram* shader, int unit,
+                            const glm::mat4& view) {
+  GLState::BindTexture(unit, texture_);
+  GLState::BindSamplers(unit, 1, &sampler_);
+  shader->SetUniform("cache_view_to_world", glm::inverse(view));
+  shader->SetUniform("cache_ground",
+                     glm::vec4(-half_size_, -half_size_,
+                               1 / (2 * half_size_), height_));
+}
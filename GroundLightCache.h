@@ -0,0 +1,104 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef GROUNDLIGHTCACHE_H
+#define GROUNDLIGHTCACHE_H
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "ShaderProgram.h"
+
+/**
+ * Diffuse light of the spot lights on the ground, cached in texture space
+ *
+ * The ground is a square of a texture, split in square tiles. A compute pass
+ * shades the texels of some tiles with the lights in world space, each tile
+ * a work group that first keeps the lights whose range reaches it (see
+ * shaders/ground_cache_cs.glsl), and the lighting pass reads the ground
+ * pixels from the texture instead of looping over their lights (see
+ * shaders/ground_cache.glsl). The tiles only need shading after the lights
+ * change; then each frame refreshes a budget of them, the nearest to the eye
+ * first, and the farther ones every few frames, so the cost depends neither
+ * on the resolution nor on the ground on the screen. The cache has no
+ * specular term, which depends on the view.
+ */
+class GroundLightCache {
+public:
+  /**
+   * Default constructor
+   */
+  GroundLightCache();
+
+  /**
+   * Destructor
+   */
+  ~GroundLightCache();
+
+  /**
+   * Creates the texture of a ground at a height, of a half size, and the
+   * shader; every tile is stale
+   * Throws runtime_error if the shader doesn't compile
+   */
+  void Init(float height, float half_size);
+
+  /**
+   * Marks every tile stale, once the lights changed
+   */
+  void Invalidate();
+
+  /**
+   * Marks stale the tiles that a sphere of world space (xyz, radius) reaches,
+   * such as the range of a light turned on or off
+   */
+  void Invalidate(const glm::vec4& sphere);
+
+  /**
+   * Shades the stale tiles due in this frame, up to the budget, with the
+   * first lights of a buffer of the world-space lights of LightTransform,
+   * turned by a rotation; returns the tiles shaded
+   */
+  int Update(const glm::vec3& eye, unsigned int lights, int n_lights,
+             const glm::mat4& rotation);
+
+  /**
+   * Binds the texture to a unit and sets the uniforms of a shader that reads
+   * it, in the view space of a camera
+   */
+  void Bind(ShaderProgram* shader, int unit, const glm::mat4& view);
+
+private:
+  ShaderProgram shader_;
+  unsigned int texture_;
+  unsigned int sampler_;
+  float height_;
+  float half_size_;
+  int frame_;
+  std::vector<bool> stale_;
+  std::vector<int> refreshed_;  // frame of the last shading of each tile
+  long allocated_bytes_;
+};
+
+#endif
@@ -0,0 +1,109 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <string>
+
+#include "BufferBindings.h"
+#include "GLCheck.h"
+#include "Impostors.h"
+
+namespace {
+
+// Cells per side of the atlas and texels per side of each cell
+const int CELLS = 8;
+const int CELL_SIZE = 64;
+
+// First texture unit of the atlas when drawn, after the diffuse maps
+const int ATLAS_UNIT = 1;
+
+}  // namespace
+
+Impostors::Impostors() : sphere_(0), baked_(false) {}
+
+void Impostors::Init(const std::string& gbuffer_code,
+                     const std::string& maps_code,
+                     const std::string& models_code) {
+  // Albedo, normal and depth, and material plus one
+  atlas_.Init(CELLS * CELL_SIZE, CELLS * CELL_SIZE);
+  atlas_.AddColorTexture(GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE);
+  atlas_.AddColorTexture(GL_RGBA16F, GL_RGBA, GL_HALF_FLOAT);
+  atlas_.AddColorTexture(GL_R16UI, GL_RED_INTEGER, GL_UNSIGNED_SHORT);
+  atlas_.SetLabel("impostors");
+  atlas_.Verify();
+
+  // The meshes batch binds the impostors it culled
+  ShaderProgram::RegisterBlockBinding("ImpostorInstancesBlock",
+                                      buffer_bindings::IMPOSTOR_INSTANCES);
+  auto defines = ShaderProgram::GenerateDefines(
+                     {{"IMPOSTOR_CELLS", std::to_string(CELLS)},
+                      {"IMPOSTOR_CELL_SIZE", std::to_string(CELL_SIZE)}}) +
+                 models_code;
+  bake_shader_.LoadVertexShader("shaders/impostor_bake_vs.glsl", defines);
+  bake_shader_.LoadFragmentShader("shaders/impostor_bake_fs.glsl",
+                                  maps_code);
+  bake_shader_.BeginLink();
+  shader_.LoadVertexShader("shaders/impostor_vs.glsl", defines);
+  shader_.LoadFragmentShader("shaders/impostor_fs.glsl",
+                             defines + gbuffer_code);
+  shader_.BeginLink();
+}
+
+std::vector<ShaderProgram*> Impostors::GetPrograms() {
+  return {&bake_shader_, &shader_};
+}
+
+void Impostors::Bake(MeshBatch* batch, int draw, int lod,
+                     const glm::vec4& sphere) {
+  sphere_ = sphere;
+  atlas_.Bind();
+  // The material clears to no mesh
+  const float zero[4] = {0, 0, 0, 0};
+  const unsigned int zero_uint[4] = {0, 0, 0, 0};
+  const float one = 1;
+  glClearBufferfv(GL_COLOR, 0, zero);
+  glClearBufferfv(GL_COLOR, 1, zero);
+  glClearBufferuiv(GL_COLOR, 2, zero_uint);
+  glClearBufferfv(GL_DEPTH, 0, &one);
+  glEnable(GL_DEPTH_TEST);
+  bake_shader_.Enable();
+  bake_shader_.SetUniform("sphere", sphere);
+  for (int y = 0; y < CELLS; ++y) {
+    for (int x = 0; x < CELLS; ++x) {
+      glViewport(x * CELL_SIZE, y * CELL_SIZE, CELL_SIZE, CELL_SIZE);
+      bake_shader_.SetUniform("cell", glm::ivec2(x, y));
+      batch->DrawLevel(draw, lod);
+    }
+  }
+  glDisable(GL_DEPTH_TEST);
+  atlas_.Unbind();
+  baked_ = true;
+}
+
+bool Impostors::IsBaked() { return baked_; }
+
+void Impostors::Enable() {
+  shader_.Enable();
+  shader_.SetUniform("sphere", sphere_);
+  atlas_.BindTextures(ATLAS_UNIT);
+}
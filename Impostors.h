@@ -0,0 +1,102 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef IMPOSTORS_H
+#define IMPOSTORS_H
+
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "FrameBuffer.h"
+#include "MeshBatch.h"
+#include "ShaderProgram.h"
+
+/**
+ * Impostors of a mesh, for its distant instances
+ *
+ * Bake() renders the mesh once for each cell of an octahedral atlas, from
+ * the direction of the cell towards its bounding sphere with an orthographic
+ * view around it (see shaders/impostor.glsl), and keeps the albedo, the
+ * normal in model space with the depth along the view, and the material of
+ * each texel. The batch then culls the distant instances to a list of
+ * impostors (see MeshBatch::SetImpostorAngle), each drawn as 2 triangles on
+ * the plane of its sphere facing the eye, from the cell of the direction of
+ * the eye. Each fragment moves back to its baked depth and writes the
+ * G-buffer like the geometry pass.
+ */
+class Impostors {
+public:
+  /**
+   * Default constructor
+   */
+  Impostors();
+
+  /**
+   * Creates the atlas and starts building the baking and the drawing
+   * programs, the latter with the G-buffer code of the geometry pass (see
+   * GBufferLayout::GenerateGeometryPassCode) and the former with the
+   * defines of the diffuse maps, both with the definitions of the layout of
+   * the models (see shaders/models.glsl); the caller finishes their links,
+   * see GetPrograms()
+   */
+  void Init(const std::string& gbuffer_code, const std::string& maps_code,
+            const std::string& models_code);
+
+  /**
+   * Obtains the programs started by Init(), to finish their links and to
+   * reload them
+   */
+  std::vector<ShaderProgram*> GetPrograms();
+
+  /**
+   * Renders the atlas from a level of detail of a draw of a batch, whose
+   * mesh has a bounding sphere in model space
+   * The materials and the diffuse maps must be bound as for the geometry
+   * pass; changes the frame buffer, the viewport and the depth test
+   */
+  void Bake(MeshBatch* batch, int draw, int lod, const glm::vec4& sphere);
+
+  /**
+   * Checks if the atlas was baked
+   */
+  bool IsBaked();
+
+  /**
+   * Enables the drawing program, with the atlas on the texture units after
+   * the diffuse maps, for MeshBatch::DrawImpostors()
+   * The camera and the models must be bound as for the geometry pass
+   */
+  void Enable();
+
+private:
+  ShaderProgram bake_shader_;
+  ShaderProgram shader_;
+  FrameBuffer atlas_;
+  glm::vec4 sphere_;
+  bool baked_;
+};
+
+#endif
@@ -0,0 +1,230 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <algorithm>
+
+#include "CpuProfiler.h"
+#include "JobSystem.h"
+#include "ThreadAffinity.h"
+
+namespace {
+
+// Pool and queue of the calling thread, when it's a worker
+thread_local JobSystem* current_system = nullptr;
+thread_local int current_queue = -1;
+
+}  // namespace
+
+JobSystem::JobSystem() : queued_(0), stop_(false) {
+  queues_.emplace_back(new Queue());
+}
+
+JobSystem::~JobSystem() {
+  {
+    std::lock_guard<std::mutex> lock(sleep_mutex_);
+    stop_ = true;
+  }
+  wake_.notify_all();
+  for (auto& worker : workers_)
+    worker.join();
+}
+
+void JobSystem::Init(int n_workers, const std::vector<int>& cpus) {
+  if (!cpus.empty())
+    n_workers = cpus.size();
+  else if (n_workers <= 0)
+    n_workers = std::max<int>(std::thread::hardware_concurrency(), 2) - 1;
+  queues_.clear();
+  for (int i = 0; i <= n_workers; ++i)
+    queues_.emplace_back(new Queue());
+  for (int i = 0; i < n_workers; ++i) {
+    workers_.emplace_back(&JobSystem::Work, this, i);
+    if (!cpus.empty())
+      ThreadAffinity::Pin(workers_.back().native_handle(), cpus[i]);
+  }
+}
+
+JobSystem::Job JobSystem::Submit(std::function<void()> body,
+                                 const std::vector<Job>& dependencies) {
+  Job job = std::make_shared<Task>();
+  job->body = std::move(body);
+  job->pending = 1;
+  job->done = false;
+  for (auto& dependency : dependencies) {
+    if (!dependency)
+      continue;
+    std::lock_guard<std::mutex> lock(dependency->mutex);
+    if (!dependency->done) {
+      job->pending++;
+      dependency->dependents.push_back(job);
+    }
+  }
+  if (--job->pending == 0) {
+    if (workers_.empty())
+      Run(job);
+    else
+      Push(job);
+  }
+  return job;
+}
+
+void JobSystem::Wait(const Job& job) {
+  if (!job)
+    return;
+  int queue = GetQueue();
+  for (;;) {
+    {
+      std::lock_guard<std::mutex> lock(job->mutex);
+      if (job->done)
+        break;
+    }
+    Job next = Pop(queue);
+    if (next) {
+      Run(next);
+      continue;
+    }
+    // The job runs on a worker, or waits on dependencies that do
+    std::unique_lock<std::mutex> lock(sleep_mutex_);
+    wake_.wait(lock, [&] {
+      std::lock_guard<std::mutex> job_lock(job->mutex);
+      return job->done || queued_ > 0;
+    });
+  }
+  if (job->error)
+    std::rethrow_exception(job->error);
+}
+
+void JobSystem::ParallelFor(int n, const std::function<void(int, int)>& body,
+                            int min_slice) {
+  int n_slices = std::max(std::min<int>(GetWorkerCount() + 1,
+                                        n / std::max(min_slice, 1)),
+                          1);
+  auto slice_begin = [&](int slice) {
+    return (int)((long long)n * slice / n_slices);
+  };
+  std::vector<Job> slices;
+  for (int i = 1; i < n_slices; ++i) {
+    int begin = slice_begin(i), end = slice_begin(i + 1);
+    slices.push_back(Submit([&body, begin, end] { body(begin, end); }));
+  }
+  // The slices refer to the body, so they're all waited for before it goes
+  std::exception_ptr error;
+  try {
+    body(0, slice_begin(1));
+  } catch (...) {
+    error = std::current_exception();
+  }
+  for (auto& slice : slices) {
+    try {
+      Wait(slice);
+    } catch (...) {
+      if (!error)
+        error = std::current_exception();
+    }
+  }
+  if (error)
+    std::rethrow_exception(error);
+}
+
+int JobSystem::GetWorkerCount() { return workers_.size(); }
+
+void JobSystem::Push(Job job) {
+  auto& queue = *queues_[GetQueue()];
+  {
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    queue.jobs.push_back(std::move(job));
+  }
+  {
+    std::lock_guard<std::mutex> lock(sleep_mutex_);
+    queued_++;
+  }
+  wake_.notify_all();
+}
+
+JobSystem::Job JobSystem::Pop(int queue) {
+  int n_queues = queues_.size();
+  for (int i = 0; i < n_queues; ++i) {
+    auto& victim = *queues_[(queue + i) % n_queues];
+    std::lock_guard<std::mutex> lock(victim.mutex);
+    if (victim.jobs.empty())
+      continue;
+    Job job;
+    if (i == 0) {
+      job = std::move(victim.jobs.back());
+      victim.jobs.pop_back();
+    } else {
+      job = std::move(victim.jobs.front());
+      victim.jobs.pop_front();
+    }
+    queued_--;
+    return job;
+  }
+  return Job();
+}
+
+void JobSystem::Run(const Job& job) {
+  try {
+    PROFILE_ZONE("job");
+    job->body();
+  } catch (...) {
+    job->error = std::current_exception();
+  }
+  std::vector<Job> dependents;
+  {
+    std::lock_guard<std::mutex> lock(job->mutex);
+    job->done = true;
+    dependents.swap(job->dependents);
+  }
+  // Wakes the threads waiting on it, even if nothing else is queued; taking
+  // the lock orders it after their check of the job
+  sleep_mutex_.lock();
+  sleep_mutex_.unlock();
+  wake_.notify_all();
+  for (auto& dependent : dependents)
+    if (--dependent->pending == 0)
+      Push(dependent);
+}
+
+void JobSystem::Work(int queue) {
+  current_system = this;
+  current_queue = queue;
+  CpuProfiler::SetThreadName("worker " + std::to_string(queue));
+  for (;;) {
+    Job job = Pop(queue);
+    if (job) {
+      Run(job);
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(sleep_mutex_);
+    wake_.wait(lock, [&] { return stop_ || queued_ > 0; });
+    if (stop_)
+      return;
+  }
+}
+
+int JobSystem::GetQueue() {
+  if (current_system == this)
+    return current_queue;
+  return queues_.size() - 1;
+}
@@ -0,0 +1,152 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef JOBSYSTEM_H
+#define JOBSYSTEM_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Pool of worker threads that run a graph of jobs
+ *
+ * A job runs once all the jobs it depends on are done. Every worker has its
+ * own queue: the jobs a worker submits go to the back of its queue, and it
+ * runs the newest of them first, while idle workers steal the oldest jobs of
+ * the others. Threads that wait on a job run queued jobs meanwhile, so
+ * waiting from a job doesn't block a worker. The pool is created once and
+ * reused every frame, so a job costs no thread creation.
+ */
+class JobSystem {
+private:
+  struct Task;
+
+public:
+  /**
+   * Reference to a submitted job, empty if none
+   */
+  typedef std::shared_ptr<Task> Job;
+
+  /**
+   * Default constructor
+   */
+  JobSystem();
+
+  /**
+   * Destructor, waits for the running jobs and drops the queued ones
+   */
+  ~JobSystem();
+
+  /**
+   * Starts that many workers, one per hardware thread besides the calling one
+   * if 0, or one pinned to each cpu if any are given (see ThreadAffinity)
+   */
+  void Init(int n_workers = 0, const std::vector<int>& cpus = {});
+
+  /**
+   * Queues a job that runs once the dependencies, which may be empty, are
+   * done
+   * Without workers the job runs right away if it can
+   */
+  Job Submit(std::function<void()> body,
+             const std::vector<Job>& dependencies = {});
+
+  /**
+   * Runs queued jobs until the job is done
+   * Rethrows the exception of the job, if it threw one
+   */
+  void Wait(const Job& job);
+
+  /**
+   * Calls body(begin, end) over slices of [0, n) of at least min_slice
+   * elements, as jobs, and waits for them
+   */
+  void ParallelFor(int n, const std::function<void(int, int)>& body,
+                   int min_slice = 256);
+
+  /**
+   * Obtains the number of workers
+   */
+  int GetWorkerCount();
+
+private:
+  // Job with the count of its unfinished dependencies, plus one until it's
+  // submitted, and the jobs that depend on it
+  struct Task {
+    std::function<void()> body;
+    std::atomic<int> pending;
+    std::mutex mutex;
+    bool done;
+    std::exception_ptr error;
+    std::vector<Job> dependents;
+  };
+
+  // Jobs ready to run of a worker or, for the last one, of the other threads
+  struct Queue {
+    std::mutex mutex;
+    std::deque<Job> jobs;
+  };
+
+  /**
+   * Queues a job whose dependencies are done, in the calling worker's queue
+   */
+  void Push(Job job);
+
+  /**
+   * Takes the newest job of a queue, or steals the oldest of another one
+   * Returns an empty job if every queue is empty
+   */
+  Job Pop(int queue);
+
+  /**
+   * Runs a job and queues the dependents whose dependencies are now done
+   */
+  void Run(const Job& job);
+
+  /**
+   * Runs jobs until the pool stops
+   */
+  void Work(int queue);
+
+  /**
+   * Obtains the queue of the calling thread
+   */
+  int GetQueue();
+
+  std::vector<std::thread> workers_;
+  std::vector<std::unique_ptr<Queue>> queues_;  // a worker's, then others'
+  std::atomic<int> queued_;
+  std::mutex sleep_mutex_;
+  std::condition_variable wake_;  // on a queued or finished job
+  bool stop_;
+};
+
+#endif
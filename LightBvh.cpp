@@ -0,0 +1,179 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <algorithm>
+#include <string>
+
+#include "BufferBindings.h"
+#include "GLCheck.h"
+#include "LightBvh.h"
+
+namespace {
+
+// Threads per work group of the build shaders
+const int GROUP_SIZE = 64;
+
+// Bits of the Morton codes, ten per axis, and sorted per pass
+const int CODE_BITS = 30;
+const int RADIX_BITS = 6;
+const int RADIX = 1 << RADIX_BITS;
+
+// Names of the stages of shaders/bvh_cs.glsl
+const char* STAGE_NAMES[] = {"BOUNDS",  "MORTON", "HISTOGRAM", "SCAN",
+                             "SCATTER", "NODES",  "REFIT"};
+
+// Creates an uninitialized buffer of a size in bytes
+unsigned int CreateBuffer(size_t size) {
+  unsigned int buffer;
+  glCreateBuffers(1, &buffer);
+  glNamedBufferStorage(buffer, size, nullptr, GL_DYNAMIC_STORAGE_BIT);
+  return buffer;
+}
+
+}  // namespace
+
+LightBvh::LightBvh()
+    : max_lights_(0),
+      n_groups_(0),
+      nodes_buffer_(0),
+      bounds_buffer_(0),
+      parents_buffer_(0),
+      sort_buffers_(),
+      histogram_buffer_(0) {}
+
+LightBvh::~LightBvh() {
+  if (nodes_buffer_) {
+    glDeleteBuffers(1, &nodes_buffer_);
+    glDeleteBuffers(1, &bounds_buffer_);
+    glDeleteBuffers(1, &parents_buffer_);
+    glDeleteBuffers(2, sort_buffers_);
+    glDeleteBuffers(1, &histogram_buffer_);
+  }
+}
+
+void LightBvh::Init(int max_lights) {
+  max_lights_ = std::max(max_lights, 1);
+  n_groups_ = (max_lights_ + GROUP_SIZE - 1) / GROUP_SIZE;
+  int n_nodes = 2 * max_lights_ - 1;
+  nodes_buffer_ = CreateBuffer(n_nodes * sizeof(Node));
+  bounds_buffer_ = CreateBuffer(6 * sizeof(unsigned int));
+  parents_buffer_ = CreateBuffer(n_nodes * 2 * sizeof(unsigned int));
+  for (int i = 0; i < 2; ++i)
+    sort_buffers_[i] = CreateBuffer(max_lights_ * 2 * sizeof(unsigned int));
+  histogram_buffer_ =
+      CreateBuffer((size_t)RADIX * n_groups_ * sizeof(unsigned int));
+  scan_.Init(RADIX * n_groups_, GROUP_SIZE);
+
+  ShaderProgram::RegisterBlockBinding("BvhNodesBlock",
+                                      buffer_bindings::BVH_NODES);
+  ShaderProgram::RegisterBlockBinding("BvhBoundsBlock",
+                                      buffer_bindings::BVH_BOUNDS);
+  ShaderProgram::RegisterBlockBinding("BvhParentsBlock",
+                                      buffer_bindings::BVH_PARENTS);
+  ShaderProgram::RegisterBlockBinding("SortInputBlock",
+                                      buffer_bindings::SORT_INPUT);
+  ShaderProgram::RegisterBlockBinding("SortOutputBlock",
+                                      buffer_bindings::SORT_OUTPUT);
+  ShaderProgram::RegisterBlockBinding("SortHistogramBlock",
+                                      buffer_bindings::SORT_HISTOGRAM);
+  ShaderProgram::RegisterBlockBinding("LightsBlock", buffer_bindings::LIGHTS);
+  for (int stage = 0; stage < N_STAGES; ++stage) {
+    auto header = ShaderProgram::GenerateDefines(
+        {{"GROUP_SIZE", std::to_string(GROUP_SIZE)},
+         {"RADIX_BITS", std::to_string(RADIX_BITS)},
+         {"MAX_LIGHTS", std::to_string(max_lights_)},
+         {STAGE_NAMES[stage], ""}});
+    shaders_[stage].LoadComputeShader("shaders/bvh_cs.glsl", header);
+    shaders_[stage].LinkShader();
+  }
+  ShaderProgram::CheckBlockMember(
+      shaders_[NODES].GetStorageBlockInfo("BvhNodesBlock"),
+      "bvh_nodes[0].right", BvhNodeLayout::Offset(3), sizeof(Node));
+}
+
+void LightBvh::Build(UniformBuffer* lights) {
+  ShaderProgram::BindStorageBuffer(buffer_bindings::LIGHTS, lights->GetId(),
+                                   lights->GetOffset(), lights->GetSize());
+  ShaderProgram::BindStorageBuffer(buffer_bindings::BVH_NODES,
+                                   nodes_buffer_);
+  ShaderProgram::BindStorageBuffer(buffer_bindings::BVH_BOUNDS,
+                                   bounds_buffer_);
+  ShaderProgram::BindStorageBuffer(buffer_bindings::BVH_PARENTS,
+                                   parents_buffer_);
+  ShaderProgram::BindStorageBuffer(buffer_bindings::SORT_HISTOGRAM,
+                                   histogram_buffer_);
+
+  // The bounds start empty, as in bvh_order()
+  const unsigned int empty[] = {0xFFFFFFFFu, 0};
+  for (int i = 0; i < 2; ++i)
+    glClearNamedBufferSubData(bounds_buffer_, GL_R32UI,
+                              3 * i * sizeof(unsigned int),
+                              3 * sizeof(unsigned int), GL_RED_INTEGER,
+                              GL_UNSIGNED_INT, &empty[i]);
+  shaders_[BOUNDS].Enable();
+  glDispatchCompute(n_groups_, 1, 1);
+  glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+  shaders_[MORTON].Enable();
+  ShaderProgram::BindStorageBuffer(buffer_bindings::SORT_OUTPUT,
+                                   sort_buffers_[0]);
+  glDispatchCompute(n_groups_, 1, 1);
+  glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+
+  // Each pass sorts from one buffer into the other
+  int input = 0;
+  for (int shift = 0; shift < CODE_BITS; shift += RADIX_BITS) {
+    ShaderProgram::BindStorageBuffer(buffer_bindings::SORT_INPUT,
+                                     sort_buffers_[input]);
+    ShaderProgram::BindStorageBuffer(buffer_bindings::SORT_OUTPUT,
+                                     sort_buffers_[1 - input]);
+    shaders_[HISTOGRAM].Enable();
+    shaders_[HISTOGRAM].SetUniform("radix_shift", shift);
+    glDispatchCompute(n_groups_, 1, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    shaders_[SCAN].Enable();
+    shaders_[SCAN].SetUniform("n_sort_groups", n_groups_);
+    glDispatchCompute(scan_.Bind(RADIX * n_groups_), 1, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    shaders_[SCATTER].Enable();
+    shaders_[SCATTER].SetUniform("radix_shift", shift);
+    glDispatchCompute(n_groups_, 1, 1);
+    glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+    input = 1 - input;
+  }
+
+  ShaderProgram::BindStorageBuffer(buffer_bindings::SORT_INPUT,
+                                   sort_buffers_[input]);
+  shaders_[NODES].Enable();
+  glDispatchCompute(n_groups_, 1, 1);
+  glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+  shaders_[REFIT].Enable();
+  glDispatchCompute(n_groups_, 1, 1);
+  glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+void LightBvh::Bind() {
+  ShaderProgram::BindStorageBuffer(buffer_bindings::BVH_NODES,
+                                   nodes_buffer_);
+}
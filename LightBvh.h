@@ -0,0 +1,118 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef LIGHTBVH_H
+#define LIGHTBVH_H
+
+#include <glm/glm.hpp>
+
+#include "BlockLayout.h"
+#include "ShaderProgram.h"
+#include "StreamCompaction.h"
+#include "UniformBuffer.h"
+
+/**
+ * Bounding volume hierarchy of the point lights, rebuilt on the gpu every
+ * frame, as they move
+ *
+ * Each light gets the Morton code of its position in the bounds of all of
+ * them, a radix sort orders the lights by their codes and every internal
+ * node of the linear BVH is found from the sorted codes alone, at once, then
+ * the bounds are fitted from the leaves up (see shaders/bvh_cs.glsl). The
+ * light clusters walk the tree instead of testing every light, so each one
+ * costs about the logarithm of the number of lights (see
+ * shaders/light_bvh.glsl). Nothing waits on the cpu, which only dispatches.
+ */
+class LightBvh {
+public:
+  /**
+   * Node of the tree, as struct BvhNode of shaders/light_bvh.glsl
+   */
+  struct Node {
+    glm::vec3 bounds_min;
+    int left;
+    glm::vec3 bounds_max;
+    int right;
+  };
+
+  /**
+   * Default constructor
+   */
+  LightBvh();
+
+  /**
+   * Destructor
+   */
+  ~LightBvh();
+
+  /**
+   * Creates the buffers of up to max_lights point lights and the build
+   * shaders
+   * Throws runtime_error if a shader doesn't compile
+   */
+  void Init(int max_lights);
+
+  /**
+   * Builds the tree of the point lights of LightsBlock, as they are in the
+   * buffer
+   */
+  void Build(UniformBuffer* lights);
+
+  /**
+   * Binds the tree for a shader that walks it
+   */
+  void Bind();
+
+private:
+  // Build stages of shaders/bvh_cs.glsl
+  enum Stage {
+    BOUNDS,
+    MORTON,
+    HISTOGRAM,
+    SCAN,
+    SCATTER,
+    NODES,
+    REFIT,
+    N_STAGES
+  };
+
+  ShaderProgram shaders_[N_STAGES];
+  StreamCompaction scan_;
+  int max_lights_;
+  int n_groups_;  // of the dispatches over the lights
+  unsigned int nodes_buffer_;
+  unsigned int bounds_buffer_;
+  unsigned int parents_buffer_;
+  unsigned int sort_buffers_[2];
+  unsigned int histogram_buffer_;
+};
+
+typedef BlockLayout<glm::vec3, int, glm::vec3, int> BvhNodeLayout;
+CHECK_BLOCK_MEMBER(LightBvh::Node, BvhNodeLayout, 0, bounds_min);
+CHECK_BLOCK_MEMBER(LightBvh::Node, BvhNodeLayout, 1, left);
+CHECK_BLOCK_MEMBER(LightBvh::Node, BvhNodeLayout, 2, bounds_max);
+CHECK_BLOCK_MEMBER(LightBvh::Node, BvhNodeLayout, 3, right);
+CHECK_BLOCK_STRIDE(LightBvh::Node, BvhNodeLayout, Std430Stride);
+
+#endif
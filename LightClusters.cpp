@@ -0,0 +1,165 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "BufferBindings.h"
+#include "GLCheck.h"
+#include "LightClusters.h"
+
+namespace {
+
+// Size of the light index list, as the average number of lights per cluster
+const int AVERAGE_LIGHTS_PER_CLUSTER = 32;
+
+// Threads per work group of the assignment shader
+const int GROUP_SIZE = 64;
+
+}  // namespace
+
+LightClusters::LightClusters()
+    : uses_bvh_(false),
+      light_budget_(0),
+      grid_(0),
+      capacity_(0),
+      ranges_buffer_(0),
+      indices_buffer_(0),
+      ambient_buffer_(0) {}
+
+LightClusters::~LightClusters() {
+  if (ranges_buffer_)
+    glDeleteBuffers(1, &ranges_buffer_);
+  if (indices_buffer_)
+    glDeleteBuffers(1, &indices_buffer_);
+  if (ambient_buffer_)
+    glDeleteBuffers(1, &ambient_buffer_);
+}
+
+void LightClusters::Init(const glm::ivec3& grid, int bvh_lights,
+                         int light_budget) {
+  grid_ = grid;
+  uses_bvh_ = bvh_lights > 0;
+  light_budget_ = light_budget;
+  int n_clusters = grid.x * grid.y * grid.z;
+  capacity_ = n_clusters * AVERAGE_LIGHTS_PER_CLUSTER;
+
+  // Offset and counts per cluster; a counter followed by the indices
+  glGenBuffers(1, &ranges_buffer_);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, ranges_buffer_);
+  glBufferData(GL_SHADER_STORAGE_BUFFER, n_clusters * 4 * sizeof(GLuint),
+               nullptr, GL_DYNAMIC_COPY);
+  glGenBuffers(1, &indices_buffer_);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, indices_buffer_);
+  glBufferData(GL_SHADER_STORAGE_BUFFER, (capacity_ + 1) * sizeof(GLuint),
+               nullptr, GL_DYNAMIC_COPY);
+  // The counter of the folded lights, padded to the vec4 of each cluster
+  if (light_budget_) {
+    glGenBuffers(1, &ambient_buffer_);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, ambient_buffer_);
+    glBufferData(GL_SHADER_STORAGE_BUFFER,
+                 (n_clusters + 1) * 4 * sizeof(GLfloat), nullptr,
+                 GL_DYNAMIC_COPY);
+    ShaderProgram::RegisterBlockBinding("ClusterAmbientBlock",
+                                        buffer_bindings::CLUSTER_AMBIENT);
+  }
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+  ShaderProgram::RegisterBlockBinding("ClusterRangesBlock",
+                                      buffer_bindings::CLUSTER_RANGES);
+  ShaderProgram::RegisterBlockBinding("ClusterLightsBlock",
+                                      buffer_bindings::CLUSTER_LIGHTS);
+  ShaderProgram::RegisterBlockBinding("LightsBlock", buffer_bindings::LIGHTS);
+  ShaderProgram::RegisterBlockBinding("SpotLightsBlock",
+                                      buffer_bindings::SPOT_LIGHTS);
+
+  ShaderProgram::Defines defines = {
+      {"GROUP_SIZE", std::to_string(GROUP_SIZE)}};
+  if (uses_bvh_) {
+    bvh_.Init(bvh_lights);
+    defines["LIGHT_BVH"] = "";
+  }
+  if (light_budget_)
+    defines["CLUSTER_LIGHT_BUDGET"] = std::to_string(light_budget_);
+  auto header = ShaderProgram::GenerateDefines(defines);
+  assign_shader_.LoadComputeShader("shaders/clusters_cs.glsl", header);
+  assign_shader_.LinkShader();
+}
+
+void LightClusters::Update(const glm::mat4& projection, float near, float far,
+                           int width, int height, UniformBuffer* lights,
+                           unsigned int spot_lights_buffer) {
+  screen_size_ = glm::vec2(width, height);
+  depth_range_ = glm::vec2(near, far);
+
+  // Resets the counter of the index list
+  const GLuint zero = 0;
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, indices_buffer_);
+  glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(GLuint), &zero);
+  if (light_budget_) {
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, ambient_buffer_);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(GLuint), &zero);
+  }
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+  if (uses_bvh_) {
+    bvh_.Build(lights);
+    bvh_.Bind();
+  }
+  assign_shader_.Enable();
+  Bind(&assign_shader_);
+  assign_shader_.SetUniform("inv_projection", glm::inverse(projection));
+  assign_shader_.SetUniform("cluster_capacity", capacity_);
+  ShaderProgram::BindStorageBuffer(buffer_bindings::LIGHTS, lights->GetId(),
+                                   lights->GetOffset(), lights->GetSize());
+  ShaderProgram::BindStorageBuffer(buffer_bindings::SPOT_LIGHTS,
+                                   spot_lights_buffer);
+  int n_clusters = grid_.x * grid_.y * grid_.z;
+  glDispatchCompute((n_clusters + GROUP_SIZE - 1) / GROUP_SIZE, 1, 1);
+  glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+void LightClusters::Bind(ShaderProgram* shader) {
+  ShaderProgram::BindStorageBuffer(buffer_bindings::CLUSTER_RANGES,
+                                   ranges_buffer_);
+  ShaderProgram::BindStorageBuffer(buffer_bindings::CLUSTER_LIGHTS,
+                                   indices_buffer_);
+  if (light_budget_)
+    ShaderProgram::BindStorageBuffer(buffer_bindings::CLUSTER_AMBIENT,
+                                     ambient_buffer_);
+  SetUniforms(shader);
+}
+
+int LightClusters::ReadFoldedCount() {
+  if (!light_budget_)
+    return 0;
+  GLuint count = 0;
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, ambient_buffer_);
+  glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(GLuint), &count);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+  return count;
+}
+
+void LightClusters::SetUniforms(ShaderProgram* shader) {
+  shader->SetUniform("cluster_grid", grid_);
+  shader->SetUniform("cluster_screen_size", screen_size_);
+  shader->SetUniform("cluster_depth_range", depth_range_);
+}
@@ -0,0 +1,110 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef LIGHTCLUSTERS_H
+#define LIGHTCLUSTERS_H
+
+#include <string>
+
+#include <glm/glm.hpp>
+
+#include "LightBvh.h"
+#include "ShaderProgram.h"
+#include "UniformBuffer.h"
+
+/**
+ * Froxel grid with the lights that touch each cell
+ *
+ * The view frustum is split into a screen-space grid and exponential depth
+ * slices. Every frame a compute shader tests each light against every cluster
+ * and writes an offset and the counts of point and spot lights per cluster,
+ * into one shared list of light indices. Shaders find their cluster and
+ * lights with the functions of shaders/clusters.glsl, which they #include.
+ * With a light BVH, the point lights of each cluster are found by walking
+ * it, rebuilt before every assignment, instead of testing all of them.
+ * With a light budget, a cluster keeps that many spot lights at most, the
+ * most significant ones by their intensity at its nearest point, and the
+ * light of the others that reaches its center is added as an ambient term,
+ * so the cost of a crowded cluster is bounded.
+ */
+class LightClusters {
+public:
+  /**
+   * Default constructor
+   */
+  LightClusters();
+
+  /**
+   * Destructor
+   */
+  ~LightClusters();
+
+  /**
+   * Creates the buffers and the assignment shader, with a BVH of up to
+   * bvh_lights point lights if there are any, and a budget of spot lights
+   * per cluster, none if 0
+   * With a budget, the shaders that read the clusters need the
+   * CLUSTER_LIGHT_BUDGET define, for their ambient terms
+   * Throws runtime_error if a shader doesn't compile
+   */
+  void Init(const glm::ivec3& grid, int bvh_lights = 0, int light_budget = 0);
+
+  /**
+   * Assigns the point and spot lights of the storage buffers to the clusters
+   */
+  void Update(const glm::mat4& projection, float near, float far, int width,
+              int height, UniformBuffer* lights,
+              unsigned int spot_lights_buffer);
+
+  /**
+   * Binds the buffers and sets the uniforms of a shader that reads them
+   */
+  void Bind(ShaderProgram* shader);
+
+  /**
+   * Obtains the number of spot lights left out of the clusters by the budget
+   * in the last assignment, waiting for it
+   */
+  int ReadFoldedCount();
+
+private:
+  /**
+   * Sets the grid uniforms of a shader
+   */
+  void SetUniforms(ShaderProgram* shader);
+
+  ShaderProgram assign_shader_;
+  LightBvh bvh_;
+  bool uses_bvh_;
+  int light_budget_;
+  glm::ivec3 grid_;
+  int capacity_;
+  unsigned int ranges_buffer_;
+  unsigned int indices_buffer_;
+  unsigned int ambient_buffer_;
+  glm::vec2 screen_size_;
+  glm::vec2 depth_range_;
+};
+
+#endif
@@ -0,0 +1,133 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "Frustum.h"
+#include "LightCuller.h"
+
+namespace {
+
+// Spheres handled per iteration
+const int LANES = 4;
+
+}  // namespace
+
+void LightCuller::Clear() {
+  x_.clear();
+  y_.clear();
+  z_.clear();
+  radius_.clear();
+}
+
+void LightCuller::Add(const glm::vec4& sphere) {
+  x_.push_back(sphere.x);
+  y_.push_back(sphere.y);
+  z_.push_back(sphere.z);
+  radius_.push_back(sphere.w);
+}
+
+const std::vector<int>& LightCuller::Cull(const glm::mat4& projection) {
+  glm::vec4 planes[6];
+  ExtractFrustumPlanes(projection, planes);
+
+  // Pads to full iterations with spheres that are never visible
+  int n = GetSize();
+  int padded = (n + LANES - 1) / LANES * LANES;
+  x_.resize(padded, 0);
+  y_.resize(padded, 0);
+  z_.resize(padded, 0);
+  radius_.resize(padded, -std::numeric_limits<float>::infinity());
+
+  visible_.clear();
+  for (int i = 0; i < padded; i += LANES) {
+#if defined(__SSE2__)
+    auto x = _mm_loadu_ps(&x_[i]);
+    auto y = _mm_loadu_ps(&y_[i]);
+    auto z = _mm_loadu_ps(&z_[i]);
+    auto radius = _mm_loadu_ps(&radius_[i]);
+    auto inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+    for (auto& plane : planes) {
+      auto distance = _mm_add_ps(
+          _mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(plane.x)),
+                     _mm_mul_ps(y, _mm_set1_ps(plane.y))),
+          _mm_add_ps(_mm_mul_ps(z, _mm_set1_ps(plane.z)),
+                     _mm_set1_ps(plane.w)));
+      auto touches = _mm_add_ps(distance, radius);
+      inside = _mm_and_ps(inside, _mm_cmpge_ps(touches, _mm_setzero_ps()));
+    }
+    int mask = _mm_movemask_ps(inside);
+#else
+    int mask = 0;
+    for (int lane = 0; lane < LANES; ++lane) {
+      auto center = glm::vec4(x_[i + lane], y_[i + lane], z_[i + lane], 1);
+      bool inside = true;
+      for (auto& plane : planes)
+        inside &= glm::dot(plane, center) + radius_[i + lane] >= 0;
+      mask |= inside << lane;
+    }
+#endif
+    for (int lane = 0; lane < LANES; ++lane)
+      if (mask & (1 << lane)) visible_.push_back(i + lane);
+  }
+
+  x_.resize(n);
+  y_.resize(n);
+  z_.resize(n);
+  radius_.resize(n);
+  return visible_;
+}
+
+int LightCuller::GetSize() { return x_.size(); }
+
+glm::vec4 LightCuller::BoundSpotLight(const glm::vec3& apex,
+                                      const glm::vec3& direction,
+                                      float cos_angle, float range,
+                                      const glm::vec4& plane) {
+  // Highest direction of the cone, relative to the plane
+  auto normal = glm::vec3(plane);
+  float height = glm::dot(normal, apex) + plane.w;
+  float sin_angle = std::sqrt(1 - cos_angle * cos_angle);
+  float cos_axis = glm::dot(normal, direction);
+  float sin_axis = std::sqrt(std::max(1 - cos_axis * cos_axis, 0.0f));
+  float rise = cos_axis > cos_angle
+                   ? 1.0f
+                   : cos_axis * cos_angle + sin_axis * sin_angle;
+
+  // Every ray ends at the range or at the plane; the sphere bounds the
+  // spherical sector of that radius
+  float length = range;
+  if (height > 0 && rise < 0)
+    length = std::min(length, height / -rise);
+  if (cos_angle < std::sqrt(0.5f))
+    return glm::vec4(apex, length);
+  float radius = length / (2 * cos_angle);
+  return glm::vec4(apex + direction * radius, radius);
+}
@@ -0,0 +1,79 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef LIGHTCULLER_H
+#define LIGHTCULLER_H
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+/**
+ * Frustum culling of the light bounding spheres on the CPU
+ *
+ * The spheres are stored as separate x, y, z and radius arrays, so the test
+ * against the frustum planes handles 4 spheres per iteration with SSE2 (with a
+ * scalar fallback on other architectures). LightTransform uses it instead of
+ * its compute shader when the lights are culled on the CPU.
+ */
+class LightCuller {
+public:
+  /**
+   * Removes every sphere
+   */
+  void Clear();
+
+  /**
+   * Adds a sphere (center and radius), in view space
+   */
+  void Add(const glm::vec4& sphere);
+
+  /**
+   * Obtains the indices of the spheres that touch the frustum of the
+   * projection, in the order they were added
+   */
+  const std::vector<int>& Cull(const glm::mat4& projection);
+
+  /**
+   * Obtains the number of spheres
+   */
+  int GetSize();
+
+  /**
+   * Bounds the part of a spot light cone within its range and above a plane
+   * (the ground)
+   */
+  static glm::vec4 BoundSpotLight(const glm::vec3& apex,
+                                  const glm::vec3& direction, float cos_angle,
+                                  float range, const glm::vec4& plane);
+
+private:
+  std::vector<float> x_;
+  std::vector<float> y_;
+  std::vector<float> z_;
+  std::vector<float> radius_;
+  std::vector<int> visible_;
+};
+
+#endif
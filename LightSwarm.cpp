@@ -0,0 +1,108 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <algorithm>
+
+#include "BufferBindings.h"
+#include "GLCheck.h"
+#include "LightSwarm.h"
+
+namespace {
+
+// Threads per work group of the simulation shader
+const int GROUP_SIZE = 256;
+
+// Bytes of struct SwarmLight of shaders/swarm_cs.glsl
+const int SWARM_LIGHT_SIZE = 48;
+
+// Offset of the point lights after the ambient and their count in LightsBlock
+const size_t LIGHTS_OFFSET = 16;
+
+// Distance where the lights of the swarm fade out
+const float SWARM_LIGHT_RANGE = 3.0f;
+
+// Longest step of the simulation, in seconds; longer frames slow it down
+const double MAX_TIME_STEP = 0.1;
+
+}  // namespace
+
+LightSwarm::LightSwarm()
+    : n_lights_(0), time_(-1.0), frame_(0), state_buffer_(0) {}
+
+LightSwarm::~LightSwarm() {
+  if (state_buffer_)
+    glDeleteBuffers(1, &state_buffer_);
+}
+
+void LightSwarm::Init(int n_lights, const glm::vec3& box_min,
+                      const glm::vec3& box_max) {
+  n_lights_ = n_lights;
+  box_min_ = box_min;
+  box_max_ = box_max;
+
+  // Zero lifetimes, so every light spawns on the first update
+  glCreateBuffers(1, &state_buffer_);
+  glNamedBufferStorage(state_buffer_,
+                       std::max(n_lights, 1) * SWARM_LIGHT_SIZE, nullptr, 0);
+  glClearNamedBufferData(state_buffer_, GL_R32F, GL_RED, GL_FLOAT, nullptr);
+
+  ShaderProgram::RegisterBlockBinding("SwarmLightsBlock",
+                                      buffer_bindings::SWARM_LIGHTS);
+  ShaderProgram::RegisterBlockBinding("LightsBlock", buffer_bindings::LIGHTS);
+  shader_.LoadComputeShader(
+      "shaders/swarm_cs.glsl",
+      ShaderProgram::GenerateDefines(
+          {{"GROUP_SIZE", std::to_string(GROUP_SIZE)}}));
+  shader_.LinkShader();
+  ShaderProgram::CheckBlockMember(
+      shader_.GetStorageBlockInfo("SwarmLightsBlock"),
+      "swarm_lights[0].position", 0, SWARM_LIGHT_SIZE);
+  ShaderProgram::CheckBlockMember(shader_.GetStorageBlockInfo("LightsBlock"),
+                                  "point_lights[0].position", LIGHTS_OFFSET,
+                                  sizeof(PointLight));
+}
+
+void LightSwarm::Update(double time, const glm::mat4& world_to_view,
+                        UniformBuffer* lights) {
+  double step = time_ < 0 ? 0 : std::min(time - time_, MAX_TIME_STEP);
+  time_ = time;
+  shader_.Enable();
+  ShaderProgram::BindStorageBuffer(buffer_bindings::SWARM_LIGHTS,
+                                   state_buffer_);
+  ShaderProgram::BindStorageBuffer(buffer_bindings::LIGHTS, lights->GetId(),
+                                   lights->GetOffset(), lights->GetSize());
+  shader_.SetUniform("world_to_view", world_to_view);
+  shader_.SetUniform("time_step", (float)std::max(step, 0.0));
+  shader_.SetUniform("swarm_frame", (int)frame_++);
+  shader_.SetUniform("n_swarm_lights", n_lights_);
+  shader_.SetUniform("box_min", box_min_);
+  shader_.SetUniform("box_max", box_max_);
+  shader_.SetUniform("light_range", SWARM_LIGHT_RANGE);
+  glDispatchCompute((n_lights_ + GROUP_SIZE - 1) / GROUP_SIZE, 1, 1);
+  glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+int LightSwarm::GetSize() { return n_lights_; }
+
+size_t LightSwarm::GetLightsOffset() { return LIGHTS_OFFSET; }
@@ -0,0 +1,102 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef LIGHTSWARM_H
+#define LIGHTSWARM_H
+
+#include <glm/glm.hpp>
+
+#include "ShaderProgram.h"
+#include "UniformBuffer.h"
+
+/**
+ * Point lights simulated on the gpu
+ *
+ * Every light of the swarm keeps its world-space position, velocity, color
+ * and lifetime in a storage buffer that only a compute shader reads and
+ * writes: each update moves the lights around the vertical axis of the box,
+ * bounces them off its sides and respawns the expired ones at random, then
+ * writes them to view space as the point lights of the lighting passes (see
+ * shaders/swarm_cs.glsl). The cpu only sets the uniforms and dispatches, so
+ * the cost on it doesn't grow with the number of lights.
+ */
+class LightSwarm {
+public:
+  /**
+   * Point light, as struct PointLight of shaders/lighting.glsl
+   */
+  struct PointLight {
+    glm::vec3 position;
+    float range;
+    glm::vec3 diffuse;
+    float specular;
+  };
+
+  /**
+   * Default constructor
+   */
+  LightSwarm();
+
+  /**
+   * Destructor
+   */
+  ~LightSwarm();
+
+  /**
+   * Creates the state of that many lights, which the first update spawns in
+   * the box, and loads the simulation shader
+   * Throws runtime_error if the shader fails or its blocks aren't laid out
+   * as expected
+   */
+  void Init(int n_lights, const glm::vec3& box_min, const glm::vec3& box_max);
+
+  /**
+   * Advances the lights to a time in seconds and writes them to the point
+   * lights of LightsBlock, which must have room for all of them after its
+   * header
+   */
+  void Update(double time, const glm::mat4& world_to_view,
+              UniformBuffer* lights);
+
+  /**
+   * Obtains the number of lights
+   */
+  int GetSize();
+
+  /**
+   * Obtains the bytes of LightsBlock up to the first point light
+   */
+  static size_t GetLightsOffset();
+
+private:
+  int n_lights_;
+  glm::vec3 box_min_;
+  glm::vec3 box_max_;
+  double time_;  // of the last update, negative before the first one
+  unsigned int frame_;
+  unsigned int state_buffer_;
+  ShaderProgram shader_;
+};
+
+#endif
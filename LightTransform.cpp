@@ -0,0 +1,320 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <algorithm>
+
+#include "BufferBindings.h"
+#include "Frustum.h"
+#include "GLCheck.h"
+#include "LightTransform.h"
+
+namespace {
+
+// Threads per work group of the transform shader
+const int GROUP_SIZE = 64;
+
+// Offset of the lights after the count in SpotLightsBlock
+const int LIGHTS_OFFSET = 16;
+
+// Explicit uniform locations of the transform shader
+const ShaderProgram::Uniform WORLD_TO_VIEW = {0};
+const ShaderProgram::Uniform GROUND_PLANE = {4};
+const int FRUSTUM_PLANES_LOCATION = 5;
+const ShaderProgram::Uniform N_FRUSTUMS = {
+    FRUSTUM_PLANES_LOCATION + 6 * LightTransform::MAX_FRUSTUMS};
+const ShaderProgram::Uniform N_ACTIVE_LIGHTS = {N_FRUSTUMS.location + 1};
+const ShaderProgram::Uniform MAX_LIGHT_DISTANCE = {N_FRUSTUMS.location + 2};
+const ShaderProgram::Uniform MIN_SPECULAR_RADIUS = {N_FRUSTUMS.location + 3};
+
+// Specialization constants of the SPIR-V transform shader
+const unsigned int GROUP_SIZE_ID = 0;
+const unsigned int N_LIGHTS_ID = 1;
+
+// Checks the lights array of a block against struct SpotLight
+void CheckLayout(const ShaderProgram::BlockInfo& block,
+                 const std::string& prefix, size_t base) {
+  typedef LightTransform::SpotLight SpotLight;
+  const char* members[] = {"position", "range",     "diffuse",
+                           "specular", "direction", "cone"};
+  for (int i = 0; i < 6; ++i)
+    ShaderProgram::CheckBlockMember(block, prefix + members[i],
+                                    base + SpotLightLayout::Offset(i),
+                                    sizeof(SpotLight));
+}
+
+}  // namespace
+
+LightTransform::LightTransform()
+    : n_lights_(0),
+      n_active_(0),
+      max_distance_(0),
+      min_specular_radius_(0),
+      cpu_culling_(false),
+      world_buffer_(0),
+      view_buffer_(0),
+      world_shadow_buffer_(0),
+      view_shadow_buffer_(0),
+      slot_buffer_(0) {}
+
+LightTransform::~LightTransform() {
+  if (world_buffer_)
+    glDeleteBuffers(1, &world_buffer_);
+  if (view_buffer_)
+    glDeleteBuffers(1, &view_buffer_);
+  if (world_shadow_buffer_)
+    glDeleteBuffers(1, &world_shadow_buffer_);
+  if (view_shadow_buffer_)
+    glDeleteBuffers(1, &view_shadow_buffer_);
+  if (slot_buffer_)
+    glDeleteBuffers(1, &slot_buffer_);
+}
+
+void LightTransform::Init(const std::vector<SpotLight>& lights, bool spirv,
+                          bool shadows) {
+  n_lights_ = lights.size();
+  n_active_ = n_lights_;
+  lights_ = lights;
+
+  // The world-space lights never change; the view-space ones are written by
+  // the shader, or uploaded with cpu culling, after their count
+  auto size = std::max<size_t>(lights.size(), 1) * sizeof(SpotLight);
+  glGenBuffers(1, &world_buffer_);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, world_buffer_);
+  glBufferStorage(GL_SHADER_STORAGE_BUFFER, size,
+                  lights.empty() ? nullptr : lights.data(), 0);
+  glGenBuffers(1, &view_buffer_);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, view_buffer_);
+  glBufferData(GL_SHADER_STORAGE_BUFFER, LIGHTS_OFFSET + size, nullptr,
+               GL_DYNAMIC_COPY);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+  glCreateBuffers(1, &slot_buffer_);
+  glNamedBufferStorage(slot_buffer_,
+                       std::max<size_t>(lights.size(), 1) * sizeof(int),
+                       nullptr, GL_DYNAMIC_STORAGE_BIT);
+  if (shadows && !spirv) {
+    auto shadows_size =
+        std::max<size_t>(lights.size(), 1) * sizeof(SpotShadow);
+    glCreateBuffers(1, &world_shadow_buffer_);
+    glNamedBufferStorage(world_shadow_buffer_, shadows_size, nullptr,
+                         GL_DYNAMIC_STORAGE_BIT);
+    glCreateBuffers(1, &view_shadow_buffer_);
+    glNamedBufferStorage(view_shadow_buffer_, shadows_size, nullptr,
+                         GL_DYNAMIC_STORAGE_BIT);
+    ShaderProgram::RegisterBlockBinding("WorldSpotShadowsBlock",
+                                        buffer_bindings::WORLD_SPOT_SHADOWS);
+    ShaderProgram::RegisterBlockBinding("SpotShadowsBlock",
+                                        buffer_bindings::SPOT_SHADOWS);
+  }
+
+  ShaderProgram::RegisterBlockBinding("WorldSpotLightsBlock",
+                                      buffer_bindings::WORLD_SPOT_LIGHTS);
+  ShaderProgram::RegisterBlockBinding("SpotLightsBlock",
+                                      buffer_bindings::SPOT_LIGHTS);
+  ShaderProgram::RegisterBlockBinding("SpotLightSlotsBlock",
+                                      buffer_bindings::SPOT_LIGHT_SLOTS);
+  compaction_.Init(n_lights_, GROUP_SIZE);
+
+  // The SPIR-V shader may have no names to check its blocks with; it's built
+  // from the same source as the checked one
+  if (spirv) {
+    shader_.LoadSpirvShader(GL_COMPUTE_SHADER, "shaders/spirv/lights_cs.spv",
+                            {{GROUP_SIZE_ID, GROUP_SIZE},
+                             {N_LIGHTS_ID, (unsigned int)n_lights_}});
+    shader_.LinkShader();
+    return;
+  }
+  ShaderProgram::Defines defines = {
+      {"GROUP_SIZE", std::to_string(GROUP_SIZE)},
+      {"N_WORLD_SPOT_LIGHTS", std::to_string(n_lights_)}};
+  if (shadows)
+    defines["SPOT_SHADOWS"] = "";
+  shader_.LoadComputeShader("shaders/lights_cs.glsl",
+                            ShaderProgram::GenerateDefines(defines));
+  shader_.LinkShader();
+  CheckLayout(shader_.GetStorageBlockInfo("WorldSpotLightsBlock"),
+              "world_spot_lights[0].", 0);
+  CheckLayout(shader_.GetStorageBlockInfo("SpotLightsBlock"),
+              "spot_lights[0].", LIGHTS_OFFSET);
+  if (shadows) {
+    auto block = shader_.GetStorageBlockInfo("SpotShadowsBlock");
+    const char* members[] = {"spot_shadows[0].view_to_light",
+                             "spot_shadows[0].tile"};
+    for (int i = 0; i < 2; ++i)
+      ShaderProgram::CheckBlockMember(block, members[i],
+                                      SpotShadowLayout::Offset(i),
+                                      sizeof(SpotShadow));
+  }
+}
+
+void LightTransform::SetShadows(const std::vector<SpotShadow>& shadows) {
+  if (cpu_culling_)
+    shadows_ = shadows;
+  if (world_shadow_buffer_ && !shadows.empty())
+    glNamedBufferSubData(world_shadow_buffer_, 0,
+                         shadows.size() * sizeof(SpotShadow), shadows.data());
+}
+
+void LightTransform::SetActiveCount(int n_active) {
+  n_active_ = std::max(0, std::min(n_active, n_lights_));
+}
+
+void LightTransform::SetMaxDistance(float distance) {
+  max_distance_ = distance;
+}
+
+void LightTransform::SetMinSpecularRadius(float radius) {
+  min_specular_radius_ = radius;
+}
+
+void LightTransform::SetCpuCulling(bool cpu_culling) {
+  cpu_culling_ = cpu_culling;
+}
+
+void LightTransform::Update(const glm::mat4& world_to_view,
+                            const glm::mat4& projection,
+                            const glm::vec4& ground) {
+  Update(world_to_view, &projection, 1, ground);
+}
+
+void LightTransform::Update(const glm::mat4& world_to_view,
+                            const glm::mat4* view_to_clips, int n_views,
+                            const glm::vec4& ground) {
+  int n_frustums = std::min(n_views, MAX_FRUSTUMS);
+  if (cpu_culling_) {
+    UpdateOnCpu(world_to_view, view_to_clips, n_frustums, ground);
+    return;
+  }
+
+  // Resets the count of visible lights, which no tile writes without active
+  // lights
+  const GLint zero = 0;
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, view_buffer_);
+  glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(GLint), &zero);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+  shader_.Enable();
+  ShaderProgram::BindStorageBuffer(buffer_bindings::WORLD_SPOT_LIGHTS,
+                                   world_buffer_);
+  ShaderProgram::BindStorageBuffer(buffer_bindings::SPOT_LIGHTS,
+                                   view_buffer_);
+  ShaderProgram::BindStorageBuffer(buffer_bindings::SPOT_LIGHT_SLOTS,
+                                   slot_buffer_);
+  if (view_shadow_buffer_) {
+    ShaderProgram::BindStorageBuffer(buffer_bindings::WORLD_SPOT_SHADOWS,
+                                     world_shadow_buffer_);
+    ShaderProgram::BindStorageBuffer(buffer_bindings::SPOT_SHADOWS,
+                                     view_shadow_buffer_);
+  }
+  shader_.SetUniform(WORLD_TO_VIEW, world_to_view);
+  shader_.SetUniform(GROUND_PLANE, ground);
+  shader_.SetUniform(N_FRUSTUMS, n_frustums);
+  for (int f = 0; f < n_frustums; ++f) {
+    glm::vec4 planes[6];
+    ExtractFrustumPlanes(view_to_clips[f], planes);
+    for (int i = 0; i < 6; ++i) {
+      ShaderProgram::Uniform plane = {FRUSTUM_PLANES_LOCATION + 6 * f + i};
+      shader_.SetUniform(plane, planes[i]);
+    }
+  }
+  shader_.SetUniform(N_ACTIVE_LIGHTS, n_active_);
+  shader_.SetUniform(MAX_LIGHT_DISTANCE, max_distance_);
+  shader_.SetUniform(MIN_SPECULAR_RADIUS, min_specular_radius_);
+  glDispatchCompute(compaction_.Bind(n_active_), 1, 1);
+  glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+void LightTransform::UpdateOnCpu(const glm::mat4& world_to_view,
+                                 const glm::mat4* view_to_clips,
+                                 int n_frustums, const glm::vec4& ground) {
+  // The lights are moved and bounded as in shaders/lights_cs.glsl
+  std::vector<SpotLight> lights(lights_.begin(), lights_.begin() + n_active_);
+  std::vector<glm::vec4> bounds(n_active_);
+  auto rotation = glm::mat3(world_to_view);
+  culler_.Clear();
+  for (int i = 0; i < n_active_; ++i) {
+    auto& light = lights[i];
+    light.position = glm::vec3(world_to_view * glm::vec4(light.position, 1));
+    light.direction = glm::normalize(rotation * light.direction);
+    bounds[i] = LightCuller::BoundSpotLight(
+        light.position, light.direction, glm::unpackHalf2x16(light.cone).x,
+        light.range, ground);
+    if (bounds[i].w < min_specular_radius_ * glm::length(glm::vec3(bounds[i])))
+      light.specular = 0;
+    culler_.Add(bounds[i]);
+  }
+  std::vector<char> visible(n_active_, false);
+  for (int f = 0; f < n_frustums; ++f)
+    for (int i : culler_.Cull(view_to_clips[f]))
+      visible[i] = true;
+
+  // The visible lights keep their order, after their count
+  std::vector<int> slots(n_active_, -1);
+  std::vector<SpotLight> visible_lights;
+  std::vector<SpotShadow> visible_shadows;
+  for (int i = 0; i < n_active_; ++i) {
+    if (!visible[i] ||
+        (max_distance_ > 0 &&
+         glm::length(glm::vec3(bounds[i])) - bounds[i].w > max_distance_))
+      continue;
+    slots[i] = visible_lights.size();
+    visible_lights.push_back(lights[i]);
+    // A light without a shadow yet has an empty tile
+    if (view_shadow_buffer_)
+      visible_shadows.push_back(i < (int)shadows_.size()
+                                    ? shadows_[i]
+                                    : SpotShadow{glm::mat4(1), glm::vec4(0)});
+  }
+  GLint count = visible_lights.size();
+  glNamedBufferSubData(view_buffer_, 0, sizeof(count), &count);
+  if (count)
+    glNamedBufferSubData(view_buffer_, LIGHTS_OFFSET,
+                         count * sizeof(SpotLight), visible_lights.data());
+  if (n_active_)
+    glNamedBufferSubData(slot_buffer_, 0, n_active_ * sizeof(int),
+                         slots.data());
+  if (!visible_shadows.empty())
+    glNamedBufferSubData(view_shadow_buffer_, 0,
+                         visible_shadows.size() * sizeof(SpotShadow),
+                         visible_shadows.data());
+}
+
+unsigned int LightTransform::GetBuffer() { return view_buffer_; }
+
+unsigned int LightTransform::GetWorldBuffer() { return world_buffer_; }
+
+unsigned int LightTransform::GetShadowBuffer() { return view_shadow_buffer_; }
+
+unsigned int LightTransform::GetSlotBuffer() { return slot_buffer_; }
+
+int LightTransform::GetSize() { return n_lights_; }
+
+int LightTransform::GetActiveCount() { return n_active_; }
+
+int LightTransform::ReadVisibleCount() {
+  GLint count = 0;
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, view_buffer_);
+  glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(GLint), &count);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+  return count;
+}
@@ -0,0 +1,223 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef LIGHTTRANSFORM_H
+#define LIGHTTRANSFORM_H
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "BlockLayout.h"
+#include "LightCuller.h"
+#include "ShaderProgram.h"
+#include "StreamCompaction.h"
+
+/**
+ * Moves the spot lights from world space to view space on the gpu
+ *
+ * The lights are uploaded once. Every frame a compute shader transforms them
+ * with a single matrix, bounds each cone within its range and above the
+ * ground, drops the ones outside the view frustum and appends the others to
+ * the SpotLightsBlock read by the lighting passes (see shaders/lights_cs.glsl).
+ * With shadows, the shadow of each visible light is copied to the same slot
+ * of SpotShadowsBlock. The slot of each active light, or -1, goes to
+ * SpotLightSlotsBlock, so a pass that knows a light on the cpu finds it.
+ * SetCpuCulling() does the same on the cpu with LightCuller and uploads the
+ * visible lights, for drivers where the compute pre-pass is slower.
+ */
+class LightTransform {
+public:
+  /**
+   * Spot light, as struct SpotLight of shaders/lighting.glsl
+   */
+  struct SpotLight {
+    glm::vec3 position;
+    float range;
+    glm::vec3 diffuse;
+    float specular;
+    glm::vec3 direction;
+    unsigned int cone;  // packHalf2x16(cutoff cosine, exponent)
+  };
+
+  /**
+   * Shadow of a spot light, as struct SpotShadow of shaders/lighting.glsl
+   */
+  struct SpotShadow {
+    glm::mat4 view_to_light;  // view space to the clip space of its map
+    glm::vec4 tile;  // offset and size in the atlas texture, size 0 for none
+  };
+
+  /**
+   * Default constructor
+   */
+  LightTransform();
+
+  /**
+   * Destructor
+   */
+  ~LightTransform();
+
+  /**
+   * Uploads the world-space lights and creates the transform shader, from
+   * the SPIR-V built by `make spirv` if spirv is set; the number of lights is
+   * a constant of the shader; the SPIR-V shader has no shadows
+   * Throws runtime_error if the shader doesn't compile or its blocks don't
+   * match struct SpotLight
+   */
+  void Init(const std::vector<SpotLight>& lights, bool spirv = false,
+            bool shadows = false);
+
+  /**
+   * Uploads the shadow of every light, in the order of the lights, for the
+   * next updates
+   */
+  void SetShadows(const std::vector<SpotShadow>& shadows);
+
+  /**
+   * Keeps only the first lights for the next updates, all of them by default
+   */
+  void SetActiveCount(int n_active);
+
+  /**
+   * Also culls, for the next updates, the lights whose bounds are all
+   * farther than a distance from the eye, none if 0 as by default
+   */
+  void SetMaxDistance(float distance);
+
+  /**
+   * Also drops, for the next updates, the specular of the lights whose
+   * bounds have a smaller radius than that at a unit distance from the eye,
+   * so they're shaded diffuse only, none if 0 as by default
+   */
+  void SetMinSpecularRadius(float radius);
+
+  /**
+   * Transforms and culls the lights on the cpu for the next updates, and
+   * uploads the visible ones, instead of the transform shader
+   */
+  void SetCpuCulling(bool cpu_culling);
+
+  /**
+   * Writes the visible lights in view space
+   * The ground plane is in view space
+   */
+  void Update(const glm::mat4& world_to_view, const glm::mat4& projection,
+              const glm::vec4& ground);
+
+  /**
+   * Same as Update(), but keeps the lights in the frustum of any of up to
+   * MAX_FRUSTUMS transforms from view space to clip space
+   */
+  void Update(const glm::mat4& world_to_view, const glm::mat4* view_to_clips,
+              int n_views, const glm::vec4& ground);
+
+  /**
+   * Most frustums the lights are culled against, as in
+   * shaders/lights_cs.glsl
+   */
+  static const int MAX_FRUSTUMS = 16;
+
+  /**
+   * Obtains the storage buffer of the visible lights (SpotLightsBlock)
+   */
+  unsigned int GetBuffer();
+
+  /**
+   * Obtains the storage buffer of every light in world space
+   * (WorldSpotLightsBlock)
+   */
+  unsigned int GetWorldBuffer();
+
+  /**
+   * Obtains the storage buffer of the shadows of the visible lights
+   * (SpotShadowsBlock), 0 without shadows
+   */
+  unsigned int GetShadowBuffer();
+
+  /**
+   * Obtains the storage buffer of the slot of each active light among the
+   * visible ones, -1 if it was culled (SpotLightSlotsBlock)
+   */
+  unsigned int GetSlotBuffer();
+
+  /**
+   * Obtains the number of lights, visible or not
+   */
+  int GetSize();
+
+  /**
+   * Obtains the number of lights kept by the updates
+   */
+  int GetActiveCount();
+
+  /**
+   * Reads the number of visible lights of the last update
+   * Waits for the gpu, so it's only meant for statistics
+   */
+  int ReadVisibleCount();
+
+private:
+  /**
+   * Update() on the cpu, with the same results as the transform shader
+   */
+  void UpdateOnCpu(const glm::mat4& world_to_view,
+                   const glm::mat4* view_to_clips, int n_frustums,
+                   const glm::vec4& ground);
+
+  ShaderProgram shader_;
+  StreamCompaction compaction_;
+  int n_lights_;
+  int n_active_;
+  float max_distance_;
+  float min_specular_radius_;
+  bool cpu_culling_;
+  std::vector<SpotLight> lights_;    // world space, with cpu culling
+  std::vector<SpotShadow> shadows_;  // of every light, with cpu culling
+  LightCuller culler_;
+  unsigned int world_buffer_;
+  unsigned int view_buffer_;
+  unsigned int world_shadow_buffer_;
+  unsigned int view_shadow_buffer_;
+  unsigned int slot_buffer_;
+};
+
+typedef BlockLayout<glm::vec3, float, glm::vec3, float, glm::vec3,
+                    unsigned int> SpotLightLayout;
+CHECK_BLOCK_MEMBER(LightTransform::SpotLight, SpotLightLayout, 0, position);
+CHECK_BLOCK_MEMBER(LightTransform::SpotLight, SpotLightLayout, 1, range);
+CHECK_BLOCK_MEMBER(LightTransform::SpotLight, SpotLightLayout, 2, diffuse);
+CHECK_BLOCK_MEMBER(LightTransform::SpotLight, SpotLightLayout, 3, specular);
+CHECK_BLOCK_MEMBER(LightTransform::SpotLight, SpotLightLayout, 4, direction);
+CHECK_BLOCK_MEMBER(LightTransform::SpotLight, SpotLightLayout, 5, cone);
+CHECK_BLOCK_STRIDE(LightTransform::SpotLight, SpotLightLayout, Std430Stride);
+
+typedef BlockLayout<glm::mat4, glm::vec4> SpotShadowLayout;
+CHECK_BLOCK_MEMBER(LightTransform::SpotShadow, SpotShadowLayout, 0,
+                   view_to_light);
+CHECK_BLOCK_MEMBER(LightTransform::SpotShadow, SpotShadowLayout, 1, tile);
+CHECK_BLOCK_STRIDE(LightTransform::SpotShadow, SpotShadowLayout,
+                   Std430Stride);
+
+#endif
@@ -0,0 +1,127 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <algorithm>
+
+#include "BufferBindings.h"
+#include "GLCheck.h"
+#include "LightTree.h"
+
+namespace {
+
+// Intensity of a light for the sampling of the tree, its luminance plus the
+// gray specular
+float GetIntensity(const LightTransform::SpotLight& light) {
+  return glm::dot(light.diffuse, glm::vec3(0.2126f, 0.7152f, 0.0722f)) +
+         light.specular;
+}
+
+}  // namespace
+
+LightTree::LightTree() : nodes_buffer_(0), lights_buffer_(0) {}
+
+LightTree::~LightTree() {
+  if (nodes_buffer_)
+    glDeleteBuffers(1, &nodes_buffer_);
+  if (lights_buffer_)
+    glDeleteBuffers(1, &lights_buffer_);
+}
+
+void LightTree::Init(const std::vector<LightTransform::SpotLight>& lights) {
+  std::vector<int> order(lights.size());
+  for (size_t i = 0; i < order.size(); ++i)
+    order[i] = i;
+  nodes_.clear();
+  if (!lights.empty())
+    Build(lights, &order, 0, lights.size());
+  std::vector<LightTransform::SpotLight> sorted;
+  for (int light : order)
+    sorted.push_back(lights[light]);
+
+  glCreateBuffers(1, &nodes_buffer_);
+  glNamedBufferStorage(nodes_buffer_,
+                       std::max<size_t>(nodes_.size(), 1) * sizeof(Node),
+                       nodes_.empty() ? nullptr : nodes_.data(), 0);
+  glCreateBuffers(1, &lights_buffer_);
+  glNamedBufferStorage(
+      lights_buffer_,
+      std::max<size_t>(sorted.size(), 1) * sizeof(LightTransform::SpotLight),
+      sorted.empty() ? nullptr : sorted.data(), 0);
+  ShaderProgram::RegisterBlockBinding("LightNodesBlock",
+                                      buffer_bindings::LIGHT_NODES);
+  ShaderProgram::RegisterBlockBinding("TreeLightsBlock",
+                                      buffer_bindings::TREE_LIGHTS);
+}
+
+int LightTree::Build(const std::vector<LightTransform::SpotLight>& lights,
+                     std::vector<int>* order, int begin, int end) {
+  Node node = {lights[(*order)[begin]].position, 0.0f,
+               lights[(*order)[begin]].position, 0.0f, 0, 0, begin, 0};
+  for (int i = begin; i < end; ++i) {
+    auto& light = lights[(*order)[i]];
+    node.bounds_min = glm::min(node.bounds_min, light.position);
+    node.bounds_max = glm::max(node.bounds_max, light.position);
+    node.intensity += GetIntensity(light);
+    node.range = std::max(node.range, light.range);
+  }
+  int index = nodes_.size();
+  nodes_.push_back(node);
+  if (end - begin == 1) {
+    nodes_[index].left = -1 - begin;
+    return index;
+  }
+
+  // The children are appended after the node, so its entry is set last
+  glm::vec3 extent = node.bounds_max - node.bounds_min;
+  int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2)
+                                 : (extent.y > extent.z ? 1 : 2);
+  int middle = begin + (end - begin) / 2;
+  std::nth_element(order->begin() + begin, order->begin() + middle,
+                   order->begin() + end, [&](int a, int b) {
+                     return lights[a].position[axis] <
+                            lights[b].position[axis];
+                   });
+  int left = Build(lights, order, begin, middle);
+  int right = Build(lights, order, middle, end);
+  nodes_[index].left = left;
+  nodes_[index].right = right;
+  auto& brighter = nodes_[left].intensity >= nodes_[right].intensity
+                       ? nodes_[left]
+                       : nodes_[right];
+  nodes_[index].representative = brighter.representative;
+  return index;
+}
+
+void LightTree::Bind(ShaderProgram* shader, const glm::mat4& lights_to_view,
+                     int samples, unsigned int seed) {
+  ShaderProgram::BindStorageBuffer(buffer_bindings::LIGHT_NODES,
+                                   nodes_buffer_);
+  ShaderProgram::BindStorageBuffer(buffer_bindings::TREE_LIGHTS,
+                                   lights_buffer_);
+  shader->SetUniform("tree_to_view", lights_to_view);
+  shader->SetUniform("view_to_tree", glm::inverse(lights_to_view));
+  shader->SetUniform("n_tree_nodes", (int)nodes_.size());
+  shader->SetUniform("light_samples", samples);
+  shader->SetUniform("light_seed", (int)seed);
+}
@@ -0,0 +1,123 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef LIGHTTREE_H
+#define LIGHTTREE_H
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "BlockLayout.h"
+#include "LightTransform.h"
+#include "ShaderProgram.h"
+
+/**
+ * Binary tree of the spot lights, sampled by the stochastic lighting or cut
+ * by the lightcuts
+ *
+ * The lights are split at the median of the longest axis of their positions
+ * down to one light per leaf, and every node keeps the bounds of its
+ * positions, the summed intensity and the largest range of its lights. Each
+ * pixel walks the tree a few times, picking the child of every node in
+ * proportion to how much light it can bring to the pixel, and shades only
+ * the lights it reaches, divided by their probability (see
+ * shaders/light_tree.glsl). The cost per pixel grows with the depth of the
+ * tree rather than with the number of lights; the noise is left to the
+ * temporal antialiasing, which averages the samples of every frame.
+ *
+ * Every node also has a representative light, the one of its brighter
+ * child, which stands for all of its lights scaled to their intensity. The
+ * lightcuts refine a cut of the tree per pixel from the root, splitting the
+ * node with the largest bound of its error until every bound is below a
+ * fraction of the estimate, and shade the representative of each node of
+ * the cut, so the cost follows the lights that matter to the pixel and not
+ * their total number.
+ *
+ * The lights only turn together around the origin, so the tree is built once
+ * in their own space and the pixels are moved into it.
+ */
+class LightTree {
+public:
+  /**
+   * Node of the tree, as struct LightNode of shaders/light_tree.glsl
+   */
+  struct Node {
+    glm::vec3 bounds_min;  // of the positions of its lights
+    float intensity;
+    glm::vec3 bounds_max;
+    float range;  // the largest one of its lights
+    int left;     // -1 - the index of the light in a leaf
+    int right;
+    int representative;  // index of a light of the node
+    int padding;
+  };
+
+  /**
+   * Default constructor
+   */
+  LightTree();
+
+  /**
+   * Destructor
+   */
+  ~LightTree();
+
+  /**
+   * Builds the tree of the lights and uploads it with the lights in the
+   * order of its leaves
+   */
+  void Init(const std::vector<LightTransform::SpotLight>& lights);
+
+  /**
+   * Binds the tree and sets the uniforms of a shader that samples it, with
+   * the transform of the lights to view space and the seed of the frame
+   */
+  void Bind(ShaderProgram* shader, const glm::mat4& lights_to_view,
+            int samples, unsigned int seed);
+
+private:
+  // Appends the node of the lights of a range of the order and its
+  // descendants, reordering the range
+  // Returns the index of the node
+  int Build(const std::vector<LightTransform::SpotLight>& lights,
+            std::vector<int>* order, int begin, int end);
+
+  std::vector<Node> nodes_;
+  unsigned int nodes_buffer_;
+  unsigned int lights_buffer_;
+};
+
+typedef BlockLayout<glm::vec3, float, glm::vec3, float, int, int, int>
+    LightNodeLayout;
+CHECK_BLOCK_MEMBER(LightTree::Node, LightNodeLayout, 0, bounds_min);
+CHECK_BLOCK_MEMBER(LightTree::Node, LightNodeLayout, 1, intensity);
+CHECK_BLOCK_MEMBER(LightTree::Node, LightNodeLayout, 2, bounds_max);
+CHECK_BLOCK_MEMBER(LightTree::Node, LightNodeLayout, 3, range);
+CHECK_BLOCK_MEMBER(LightTree::Node, LightNodeLayout, 4, left);
+CHECK_BLOCK_MEMBER(LightTree::Node, LightNodeLayout, 5, right);
+CHECK_BLOCK_MEMBER(LightTree::Node, LightNodeLayout, 6, representative);
+CHECK_BLOCK_STRIDE(LightTree::Node, LightNodeLayout, Std430Stride);
+
+#endif
@@ -0,0 +1,164 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <algorithm>
+#include <cstring>
+
+#include "GLCheck.h"
+#include "GLState.h"
+#include "GpuMemory.h"
+#include "MeshArena.h"
+
+namespace {
+
+// Buffers of the arena
+enum Buffers { VERTICES_BUFFER, INDICES_BUFFER, N_BUFFERS };
+
+// Meshes with more vertices need 32 bit indices
+const int MAX_SHORT_INDEXED_VERTICES = 1 << 16;
+
+// Creates an immutable buffer with the bytes, filled now or by the queue
+// Returns the ticket of the queue, if any
+uint64_t CreateStorage(unsigned int id, std::vector<unsigned char> data,
+                       UploadQueue *queue) {
+  glNamedBufferStorage(id, std::max<size_t>(data.size(), 1),
+                       data.empty() || queue ? nullptr : data.data(), 0);
+  return queue ? queue->Add(id, std::move(data)) : 0;
+}
+
+// Obtains the offset of an index in the index buffer
+const void *IndexOffset(unsigned int index, unsigned int type) {
+  size_t size = type == GL_UNSIGNED_SHORT ? sizeof(unsigned short)
+                                          : sizeof(unsigned int);
+  return (const void *)(index * size);
+}
+
+}  // namespace
+
+MeshArena::MeshArena()
+    : n_vertices_(0),
+      max_vertices_(0),
+      index_type_(GL_UNSIGNED_INT),
+      queue_(nullptr),
+      ticket_(0),
+      vao_(0),
+      buffers_{},
+      bytes_(0) {}
+
+MeshArena::~MeshArena() {
+  if (vao_) {
+    GLState::DeleteVertexArray(vao_);
+    glDeleteBuffers(N_BUFFERS, buffers_);
+    GpuMemory::Free(GpuMemory::MESHES, bytes_);
+  }
+}
+
+void MeshArena::Init(const VertexLayout &layout) { layout_ = layout; }
+
+int MeshArena::AddMesh(const void *vertices, int n_vertices,
+                       const unsigned int *indices, int n_indices) {
+  size_t stride = layout_.GetStride();
+  ranges_.push_back({(unsigned int)indices_.size(), (unsigned int)n_indices,
+                     (int)(vertices_.size() / stride)});
+  auto bytes = (const unsigned char *)vertices;
+  vertices_.insert(vertices_.end(), bytes, bytes + stride * n_vertices);
+  indices_.insert(indices_.end(), indices, indices + n_indices);
+  n_vertices_ += n_vertices;
+  max_vertices_ = std::max(max_vertices_, n_vertices);
+  return ranges_.size() - 1;
+}
+
+int MeshArena::AddIndices(int mesh, const unsigned int *indices,
+                          int n_indices) {
+  ranges_.push_back({(unsigned int)indices_.size(), (unsigned int)n_indices,
+                     ranges_[mesh].base_vertex});
+  indices_.insert(indices_.end(), indices, indices + n_indices);
+  return ranges_.size() - 1;
+}
+
+const MeshArena::Range &MeshArena::GetRange(int mesh) { return ranges_[mesh]; }
+
+void MeshArena::Upload(UploadQueue *queue) {
+  glCreateVertexArrays(1, &vao_);
+  glCreateBuffers(N_BUFFERS, buffers_);
+  queue_ = queue;
+  bytes_ = vertices_.size();
+  CreateStorage(buffers_[VERTICES_BUFFER], std::move(vertices_), queue);
+  layout_.Apply(vao_, 0, buffers_[VERTICES_BUFFER]);
+
+  std::vector<unsigned char> indices;
+  if (max_vertices_ <= MAX_SHORT_INDEXED_VERTICES) {
+    index_type_ = GL_UNSIGNED_SHORT;
+    // Padded to whole words, so the shaders can read them as uints
+    indices.resize((indices_.size() + 1) / 2 * sizeof(unsigned int));
+    auto shorts = (unsigned short *)indices.data();
+    for (size_t i = 0; i < indices_.size(); ++i)
+      shorts[i] = indices_[i];
+  } else {
+    index_type_ = GL_UNSIGNED_INT;
+    indices.resize(indices_.size() * sizeof(unsigned int));
+    if (!indices_.empty())
+      memcpy(indices.data(), indices_.data(), indices.size());
+  }
+  bytes_ += indices.size();
+  ticket_ = CreateStorage(buffers_[INDICES_BUFFER], std::move(indices), queue);
+  GpuMemory::Allocate(GpuMemory::MESHES, bytes_);
+  glVertexArrayElementBuffer(vao_, buffers_[INDICES_BUFFER]);
+
+  // Only the ranges are needed from now on
+  std::vector<unsigned char>().swap(vertices_);
+  std::vector<unsigned int>().swap(indices_);
+}
+
+bool MeshArena::IsReady() {
+  return vao_ && (!queue_ || queue_->IsDone(ticket_));
+}
+
+void MeshArena::Bind() { GLState::BindVertexArray(vao_); }
+
+unsigned int MeshArena::GetIndexType() { return index_type_; }
+
+unsigned int MeshArena::GetVertexBuffer() { return buffers_[VERTICES_BUFFER]; }
+
+unsigned int MeshArena::GetIndexBuffer() { return buffers_[INDICES_BUFFER]; }
+
+int MeshArena::GetVertexCount() { return n_vertices_; }
+
+void MeshArena::Draw(int mesh, int primitive) {
+  auto &range = ranges_[mesh];
+  Bind();
+  glDrawElementsBaseVertex(primitive, range.n_indices, index_type_,
+                           IndexOffset(range.first_index, index_type_),
+                           range.base_vertex);
+  GLState::CountDraw();
+}
+
+void MeshArena::DrawInstances(int mesh, int primitive, int n) {
+  auto &range = ranges_[mesh];
+  Bind();
+  glDrawElementsInstancedBaseVertex(
+      primitive, range.n_indices, index_type_,
+      IndexOffset(range.first_index, index_type_), n, range.base_vertex);
+  GLState::CountDraw();
+}
@@ -0,0 +1,148 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef MESHARENA_H
+#define MESHARENA_H
+
+#include <cstdint>
+#include <vector>
+
+#include "UploadQueue.h"
+#include "VertexArray.h"
+
+/**
+ * Meshes of one vertex format suballocated from shared buffers
+ *
+ * The vertices and indices of every mesh are appended to one vertex buffer
+ * and one index buffer, sourced by a single vao, so drawing one mesh after
+ * another costs no binds. Each mesh is a range of indices plus the base
+ * vertex added to them, which is also what an indirect draw command takes.
+ * The indices are relative to the base vertex, so they're stored in 16 bits
+ * when every mesh has few enough vertices.
+ */
+class MeshArena {
+public:
+  /**
+   * Place of a mesh in the shared buffers
+   */
+  struct Range {
+    unsigned int first_index;
+    unsigned int n_indices;
+    int base_vertex;
+  };
+
+  /**
+   * Default constructor
+   */
+  MeshArena();
+
+  /**
+   * Destructor
+   */
+  ~MeshArena();
+
+  /**
+   * Sets the format of the vertices
+   * Must be called before adding meshes
+   */
+  void Init(const VertexLayout &layout);
+
+  /**
+   * Appends a mesh, with the vertices in the format of the arena
+   * Returns the id of the mesh
+   */
+  int AddMesh(const void *vertices, int n_vertices,
+              const unsigned int *indices, int n_indices);
+
+  /**
+   * Appends another set of indices into the vertices of a mesh, such as a
+   * simplified version of it
+   * Returns the id of the new mesh
+   */
+  int AddIndices(int mesh, const unsigned int *indices, int n_indices);
+
+  /**
+   * Obtains the range of a mesh
+   */
+  const Range &GetRange(int mesh);
+
+  /**
+   * Creates the vao and uploads the meshes into immutable buffers, right
+   * away or through a queue, over the next frames
+   * Must be called once, after adding all of them
+   */
+  void Upload(UploadQueue *queue = nullptr);
+
+  /**
+   * Checks if the meshes can be drawn: they were uploaded and, with a queue,
+   * all their data was copied
+   */
+  bool IsReady();
+
+  /**
+   * Binds the vao, with the index buffer
+   */
+  void Bind();
+
+  /**
+   * Obtains the type of the indices, GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+   * Valid after Upload()
+   */
+  unsigned int GetIndexType();
+
+  /**
+   * Obtains the buffers of the vertices and of the indices, for the shaders
+   * that read the meshes from storage blocks
+   * Valid after Upload()
+   */
+  unsigned int GetVertexBuffer();
+  unsigned int GetIndexBuffer();
+
+  /**
+   * Obtains the number of vertices of all the meshes
+   */
+  int GetVertexCount();
+
+  /**
+   * Draws a mesh, or $n instances of it
+   */
+  void Draw(int mesh, int primitive);
+  void DrawInstances(int mesh, int primitive, int n);
+
+private:
+  VertexLayout layout_;
+  std::vector<unsigned char> vertices_;
+  std::vector<unsigned int> indices_;
+  std::vector<Range> ranges_;
+  int n_vertices_;
+  int max_vertices_;  // of a single mesh
+  unsigned int index_type_;
+  UploadQueue *queue_;
+  uint64_t ticket_;  // of the last upload in the queue
+  unsigned int vao_;
+  unsigned int buffers_[2];
+  size_t bytes_;  // of the buffers, see GpuMemory
+};
+
+#endif
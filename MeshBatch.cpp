@@ -0,0 +1,680 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+
+#include <glm/glm.hpp>
+
+#include "BufferBindings.h"
+#include "FrameAllocator.h"
+#include "Frustum.h"
+#include "GLCheck.h"
+#include "GLState.h"
+#include "MeshBatch.h"
+#include "VertexArray.h"
+
+namespace {
+
+// Threads per work group of the culling shader
+const int GROUP_SIZE = 64;
+
+// Texture unit of the depth pyramid in the culling shader
+const int PYRAMID_UNIT = 0;
+
+// Bits of the quantized depths of the instance sort, in passes of
+// SORT_RADIX_BITS
+const int SORT_KEY_BITS = 16;
+const int SORT_RADIX_BITS = 8;
+
+// Eye movement and cosine of the direction change below which the instances
+// keep their order
+const float SORT_EYE_DISTANCE = 1.0f;
+const float SORT_MIN_COSINE = 0.999f;
+
+// Vertices of the triangle strip of an impostor
+const int IMPOSTOR_VERTICES = 4;
+
+// Buffers of the batch, with the commands, the instances and the compacted
+// commands of each pass after the early ones; the commands are reset every
+// frame from a copy with no instances
+enum Buffers {
+  RESET_COMMANDS_BUFFER,
+  COMMANDS_BUFFER,
+  LATE_COMMANDS_BUFFER,
+  SHADOW_COMMANDS_BUFFER,
+  DRAWS_BUFFER,
+  INSTANCES_BUFFER,
+  LATE_INSTANCES_BUFFER,
+  SHADOW_INSTANCES_BUFFER,
+  CULL_DRAWS_BUFFER,
+  CULL_LODS_BUFFER,
+  CULL_MESHLETS_BUFFER,
+  CANDIDATES_BUFFER,
+  DRAWN_BUFFER,
+  COMPACT_COMMANDS_BUFFER,
+  LATE_COMPACT_COMMANDS_BUFFER,
+  SHADOW_COMPACT_COMMANDS_BUFFER,
+  DRAW_COUNTS_BUFFER,  // of the compacted commands of each pass
+  IMPOSTOR_COMMANDS_BUFFER,  // of each pass
+  IMPOSTOR_INSTANCES_BUFFER,
+  LATE_IMPOSTOR_INSTANCES_BUFFER,
+  N_BUFFERS
+};
+
+// Creates an immutable buffer with the contents of a vector
+template <typename T>
+void CreateStorage(unsigned int id, const std::vector<T> &data) {
+  glNamedBufferStorage(id, std::max<size_t>(data.size(), 1) * sizeof(T),
+                       data.empty() ? nullptr : data.data(), 0);
+}
+
+// Replaces a buffer by an immutable one of a size, the immutable storage
+// can't be resized
+void RecreateStorage(unsigned int *id, size_t size, const void *data,
+                     unsigned int flags) {
+  glDeleteBuffers(1, id);
+  glCreateBuffers(1, id);
+  glNamedBufferStorage(*id, std::max<size_t>(size, 1), data, flags);
+}
+
+// Smallest power of two not below n, or 0
+int Capacity(int n) {
+  int capacity = n ? 1 : 0;
+  while (capacity < n)
+    capacity *= 2;
+  return capacity;
+}
+
+// Checks the members of a block array against a structure
+template <typename Layout>
+void CheckLayout(const ShaderProgram::BlockInfo &block,
+                 const std::string &prefix,
+                 std::vector<const char *> members, size_t stride) {
+  for (size_t i = 0; i < members.size(); ++i)
+    ShaderProgram::CheckBlockMember(block, prefix + members[i],
+                                    Layout::Offset(i), stride);
+}
+
+}  // namespace
+
+MeshBatch::MeshBatch()
+    : layout_changed_(false),
+      candidates_capacity_(0),
+      first_changed_(0),
+      end_changed_(0),
+      n_instances_(0),
+      sorted_eye_(0),
+      sorted_direction_(0),
+      sorted_(false),
+      compact_(false),
+      views_(1),
+      view_radius_(0),
+      box_visibility_(0),
+      first_box_model_(0),
+      models_per_box_(1),
+      n_boxes_(0),
+      impostor_angle_(0),
+      buffers_{} {
+  arena_.Init(
+      VertexLayout().Add<short>(0, 4, true).AddPacked(1).AddHalf(2, 2));
+}
+
+MeshBatch::~MeshBatch() {
+  if (buffers_[0])
+    glDeleteBuffers(N_BUFFERS, buffers_);
+}
+
+int MeshBatch::AddMesh(const float *positions, const float *normals,
+                       int n_vertices, const unsigned int *indices,
+                       int n_indices, const float *texcoords,
+                       const int *materials) {
+  // Maps the bounds of the mesh to [-1, 1], with the same scale in every
+  // axis so the quantization error is uniform
+  glm::vec3 min(INFINITY), max(-INFINITY);
+  for (int i = 0; i < 3 * n_vertices; ++i) {
+    min[i % 3] = std::min(min[i % 3], positions[i]);
+    max[i % 3] = std::max(max[i % 3], positions[i]);
+  }
+  glm::vec3 center = n_vertices ? (min + max) / 2.0f : glm::vec3(0);
+  glm::vec3 extent = n_vertices ? (max - min) / 2.0f : glm::vec3(0);
+  float scale = std::max({extent.x, extent.y, extent.z});
+  if (scale == 0)
+    scale = 1;
+
+  std::vector<Vertex> vertices;
+  for (int i = 0; i < n_vertices; ++i) {
+    Vertex vertex;
+    for (int j = 0; j < 3; ++j)
+      vertex.position[j] =
+          QuantizeSnorm16((positions[3 * i + j] - center[j]) / scale);
+    vertex.position[3] = materials ? materials[i] : 0;
+    vertex.normal = PackSigned2101010(normals[3 * i], normals[3 * i + 1],
+                                      normals[3 * i + 2]);
+    // The half of the first component, in the low bits; the packing of
+    // gtc/packing.hpp puns the types, which the release build rejects
+    for (int j = 0; j < 2; ++j)
+      vertex.texcoord[j] = glm::packHalf2x16(
+          glm::vec2(texcoords ? texcoords[2 * i + j] : 0.0f, 0.0f));
+    vertices.push_back(vertex);
+  }
+  dequantizations_.push_back(glm::vec4(center, scale));
+  bounding_spheres_.push_back(glm::vec4(center, glm::length(extent)));
+  meshlets_.push_back(BuildMeshlets(positions, normals, indices, n_indices));
+  positions_.emplace_back(positions, positions + 3 * n_vertices);
+  normals_.emplace_back(normals, normals + 3 * n_vertices);
+  vertex_meshes_.push_back(vertex_meshes_.size());
+  return arena_.AddMesh(vertices.data(), n_vertices, indices, n_indices);
+}
+
+int MeshBatch::AddLod(int mesh, const unsigned int *indices, int n_indices) {
+  int vertex_mesh = vertex_meshes_[mesh];
+  dequantizations_.push_back(dequantizations_[mesh]);
+  bounding_spheres_.push_back(bounding_spheres_[mesh]);
+  meshlets_.push_back(BuildMeshlets(positions_[vertex_mesh].data(),
+                                    normals_[vertex_mesh].data(), indices,
+                                    n_indices));
+  positions_.emplace_back();
+  normals_.emplace_back();
+  vertex_meshes_.push_back(vertex_mesh);
+  return arena_.AddIndices(mesh, indices, n_indices);
+}
+
+int MeshBatch::AddDraw(const std::vector<int> &lods, int material_id) {
+  int draw = cull_draws_.size();
+  cull_draws_.push_back({bounding_spheres_[lods[0]], (int)cull_lods_.size(),
+                         (int)lods.size(), {0, 0}});
+  for (auto mesh : lods) {
+    auto &range = arena_.GetRange(mesh);
+    cull_lods_.push_back({(int)commands_.size(), (int)meshlets_[mesh].size()});
+    for (auto &meshlet : meshlets_[mesh]) {
+      // The base instance of each command is its index in draws
+      commands_.push_back({(unsigned int)meshlet.n_indices, 0,
+                           range.first_index + meshlet.first_index,
+                           range.base_vertex,
+                           (unsigned int)commands_.size()});
+      draws_.push_back({dequantizations_[mesh], material_id, 0, {0, 0}});
+      cull_meshlets_.push_back({meshlet.sphere, meshlet.cone});
+    }
+  }
+  draw_counts_.push_back(0);
+  draw_capacities_.push_back(0);
+  layout_changed_ = true;
+  return draw;
+}
+
+glm::vec4 MeshBatch::GetBoundingSphere(int mesh) {
+  return bounding_spheres_[mesh];
+}
+
+void MeshBatch::AddDraw(const std::vector<int> &lods, int material_id,
+                        int first_model, int n_instances) {
+  int draw = AddDraw(lods, material_id);
+  for (int i = 0; i < n_instances; ++i)
+    AddInstance(draw, first_model + i);
+}
+
+int MeshBatch::AddInstance(int draw, int model) {
+  sorted_ = false;
+  int instance = candidates_.Add({draw, model});
+  MarkChanged(candidates_.GetIndex(instance));
+  // Every meshlet of every level has room for all the instances
+  if (++draw_counts_[draw] > draw_capacities_[draw]) {
+    draw_capacities_[draw] = Capacity(draw_counts_[draw]);
+    layout_changed_ = true;
+  }
+  return instance;
+}
+
+void MeshBatch::SetInstanceModel(int instance, int model) {
+  candidates_.Get(instance).model = model;
+  MarkChanged(candidates_.GetIndex(instance));
+  sorted_ = false;
+}
+
+void MeshBatch::RemoveInstance(int instance) {
+  --draw_counts_[candidates_.Get(instance).draw];
+  // The drawn flags are rewritten by each early pass, so they don't move
+  int moved = candidates_.Remove(instance);
+  if (moved >= 0)
+    MarkChanged(moved);
+  sorted_ = false;
+}
+
+int MeshBatch::GetInstanceCount() { return candidates_.GetSize(); }
+
+bool MeshBatch::IsSorted(const glm::vec3 &eye, const glm::vec3 &direction) {
+  return sorted_ && glm::distance(eye, sorted_eye_) < SORT_EYE_DISTANCE &&
+         glm::dot(direction, sorted_direction_) > SORT_MIN_COSINE;
+}
+
+void MeshBatch::SortInstances(const glm::vec3 &eye,
+                              const glm::vec3 &direction,
+                              const glm::mat4 *models) {
+  int n = candidates_.GetSize();
+  if (n < 2 || IsSorted(eye, direction))
+    return;
+  sorted_ = true;
+  sorted_eye_ = eye;
+  sorted_direction_ = direction;
+
+  // The depths are quantized over their range, the sort keys are integers
+  auto candidates = candidates_.GetData();
+  FrameVector<float> depths(n);
+  float nearest = INFINITY, farthest = -INFINITY;
+  for (int i = 0; i < n; ++i) {
+    auto &sphere = cull_draws_[candidates[i].draw].sphere;
+    auto center = glm::vec3(models[candidates[i].model] *
+                            glm::vec4(glm::vec3(sphere), 1));
+    depths[i] = glm::dot(center - eye, direction);
+    nearest = std::min(nearest, depths[i]);
+    farthest = std::max(farthest, depths[i]);
+  }
+  float scale = farthest > nearest
+                    ? ((1 << SORT_KEY_BITS) - 1) / (farthest - nearest)
+                    : 0.0f;
+  FrameVector<unsigned int> keys(n);
+  for (int i = 0; i < n; ++i)
+    keys[i] = (unsigned int)((depths[i] - nearest) * scale);
+
+  // Least significant digit first, each pass stable
+  FrameVector<int> order(n), scratch(n);
+  for (int i = 0; i < n; ++i)
+    order[i] = i;
+  const int RADIX = 1 << SORT_RADIX_BITS;
+  for (int shift = 0; shift < SORT_KEY_BITS; shift += SORT_RADIX_BITS) {
+    int offsets[RADIX] = {};
+    for (int i = 0; i < n; ++i)
+      ++offsets[(keys[i] >> shift) & (RADIX - 1)];
+    for (int digit = 0, sum = 0; digit < RADIX; ++digit) {
+      int count = offsets[digit];
+      offsets[digit] = sum;
+      sum += count;
+    }
+    for (int i = 0; i < n; ++i) {
+      int index = order[i];
+      scratch[offsets[(keys[index] >> shift) & (RADIX - 1)]++] = index;
+    }
+    order.swap(scratch);
+  }
+
+  // The drawn flags are rewritten by each early pass, so they don't move
+  candidates_.Reorder(order.data());
+  MarkChanged(0);
+  MarkChanged(n - 1);
+}
+
+void MeshBatch::LayOutInstances() {
+  n_instances_ = 0;
+  for (size_t draw = 0; draw < cull_draws_.size(); ++draw) {
+    auto &cull_draw = cull_draws_[draw];
+    for (int lod = 0; lod < cull_draw.n_lods; ++lod) {
+      auto &cull_lod = cull_lods_[cull_draw.first_lod + lod];
+      for (int i = 0; i < cull_lod.n_commands; ++i) {
+        draws_[cull_lod.first_command + i].first_instance = n_instances_;
+        n_instances_ += draw_capacities_[draw];
+      }
+    }
+  }
+  layout_changed_ = false;
+}
+
+void MeshBatch::MarkChanged(int slot) {
+  if (first_changed_ == end_changed_) {
+    first_changed_ = slot;
+    end_changed_ = slot + 1;
+  } else {
+    first_changed_ = std::min(first_changed_, slot);
+    end_changed_ = std::max(end_changed_, slot + 1);
+  }
+}
+
+void MeshBatch::UpdateInstances() {
+  if (layout_changed_) {
+    LayOutInstances();
+    RecreateStorage(&buffers_[DRAWS_BUFFER], draws_.size() * sizeof(Draw),
+                    draws_.data(), 0);
+    for (int pass = 0; pass < N_PASSES; ++pass)
+      RecreateStorage(&buffers_[INSTANCES_BUFFER + pass],
+                      n_instances_ * sizeof(int), nullptr, 0);
+  }
+  int n_candidates = candidates_.GetSize();
+  end_changed_ = std::min(end_changed_, n_candidates);
+  if (n_candidates > candidates_capacity_) {
+    candidates_capacity_ = Capacity(n_candidates);
+    RecreateStorage(&buffers_[CANDIDATES_BUFFER],
+                    candidates_capacity_ * sizeof(Candidate), nullptr,
+                    GL_DYNAMIC_STORAGE_BIT);
+    // Nothing was drawn before the first frame
+    std::vector<int> drawn(candidates_capacity_, 0);
+    RecreateStorage(&buffers_[DRAWN_BUFFER], drawn.size() * sizeof(int),
+                    drawn.data(), 0);
+    for (int pass = EARLY_PASS; pass <= LATE_PASS; ++pass)
+      RecreateStorage(&buffers_[IMPOSTOR_INSTANCES_BUFFER + pass],
+                      candidates_capacity_ * sizeof(int), nullptr, 0);
+    first_changed_ = 0;
+    end_changed_ = n_candidates;
+  }
+  if (first_changed_ < end_changed_)
+    glNamedBufferSubData(buffers_[CANDIDATES_BUFFER],
+                         first_changed_ * sizeof(Candidate),
+                         (end_changed_ - first_changed_) * sizeof(Candidate),
+                         candidates_.GetData() + first_changed_);
+  first_changed_ = end_changed_ = 0;
+}
+
+void MeshBatch::Upload(UploadQueue *queue) {
+  arena_.Upload(queue);
+  positions_.clear();
+  normals_.clear();
+  glCreateBuffers(N_BUFFERS, buffers_);
+  CreateStorage(buffers_[RESET_COMMANDS_BUFFER], commands_);
+  for (int pass = 0; pass < N_PASSES; ++pass)
+    CreateStorage(buffers_[COMMANDS_BUFFER + pass], commands_);
+  CreateStorage(buffers_[CULL_DRAWS_BUFFER], cull_draws_);
+  CreateStorage(buffers_[CULL_LODS_BUFFER], cull_lods_);
+  CreateStorage(buffers_[CULL_MESHLETS_BUFFER], cull_meshlets_);
+  compact_ = GLEW_ARB_indirect_parameters;
+  if (compact_) {
+    for (int pass = 0; pass < N_PASSES; ++pass)
+      CreateStorage(buffers_[COMPACT_COMMANDS_BUFFER + pass], commands_);
+    std::vector<unsigned int> counts(N_PASSES, 0);
+    CreateStorage(buffers_[DRAW_COUNTS_BUFFER], counts);
+  }
+  glNamedBufferStorage(buffers_[IMPOSTOR_COMMANDS_BUFFER],
+                       N_PASSES * sizeof(ImpostorCommand), nullptr,
+                       GL_DYNAMIC_STORAGE_BIT);
+  // The draws and their instances are sized by UpdateInstances()
+  layout_changed_ = true;
+  candidates_capacity_ = -1;
+  UpdateInstances();
+
+  ShaderProgram::RegisterBlockBinding("CommandsBlock",
+                                      buffer_bindings::COMMANDS);
+  ShaderProgram::RegisterBlockBinding("CullDrawsBlock",
+                                      buffer_bindings::CULL_DRAWS);
+  ShaderProgram::RegisterBlockBinding("CullLodsBlock",
+                                      buffer_bindings::CULL_LODS);
+  ShaderProgram::RegisterBlockBinding("CullMeshletsBlock",
+                                      buffer_bindings::CULL_MESHLETS);
+  ShaderProgram::RegisterBlockBinding("CandidatesBlock",
+                                      buffer_bindings::CANDIDATES);
+  ShaderProgram::RegisterBlockBinding("DrawnBlock", buffer_bindings::DRAWN);
+  ShaderProgram::RegisterBlockBinding("LateInstancesBlock",
+                                      buffer_bindings::LATE_INSTANCES);
+  ShaderProgram::RegisterBlockBinding("VisibilityVerticesBlock",
+                                      buffer_bindings::VISIBILITY_VERTICES);
+  ShaderProgram::RegisterBlockBinding("VisibilityIndicesBlock",
+                                      buffer_bindings::VISIBILITY_INDICES);
+  ShaderProgram::RegisterBlockBinding("CompactCommandsBlock",
+                                      buffer_bindings::COMPACT_COMMANDS);
+  ShaderProgram::RegisterBlockBinding("DrawCountsBlock",
+                                      buffer_bindings::DRAW_COUNTS);
+  ShaderProgram::RegisterBlockBinding("BoxVisibilityBlock",
+                                      buffer_bindings::BOX_VISIBILITY);
+  ShaderProgram::RegisterBlockBinding("ImpostorCommandsBlock",
+                                      buffer_bindings::IMPOSTOR_COMMANDS);
+  ShaderProgram::RegisterBlockBinding("ImpostorInstancesBlock",
+                                      buffer_bindings::IMPOSTOR_INSTANCES);
+  ShaderProgram::Defines defines = {
+      {"GROUP_SIZE", std::to_string(GROUP_SIZE)},
+      {"MAX_VIEWS", std::to_string(MAX_VIEWS)}};
+  if (ShaderProgram::IsSubgroupSupported())
+    defines["SUBGROUPS"] = "";
+  auto header = ShaderProgram::GenerateDefines(defines);
+  cull_shader_.LoadComputeShader("shaders/cull_cs.glsl",
+                                 header + models_code_);
+  cull_shader_.LinkShader();
+  if (compact_) {
+    compaction_.Init(commands_.size(), GROUP_SIZE);
+    compact_shader_.LoadComputeShader("shaders/compact_cs.glsl", header);
+    compact_shader_.LinkShader();
+  }
+  CheckLayout<CommandLayout>(
+      cull_shader_.GetStorageBlockInfo("CommandsBlock"), "commands[0].",
+      {"count", "instance_count", "first_index", "base_vertex",
+       "base_instance"},
+      sizeof(Command));
+  CheckLayout<CullDrawLayout>(
+      cull_shader_.GetStorageBlockInfo("CullDrawsBlock"), "cull_draws[0].",
+      {"sphere", "first_lod", "n_lods"}, sizeof(CullDraw));
+  CheckLayout<CullLodLayout>(cull_shader_.GetStorageBlockInfo("CullLodsBlock"),
+                             "cull_lods[0].", {"first_command", "n_commands"},
+                             sizeof(CullLod));
+  CheckLayout<CullMeshletLayout>(
+      cull_shader_.GetStorageBlockInfo("CullMeshletsBlock"),
+      "cull_meshlets[0].", {"sphere", "cone"}, sizeof(CullMeshlet));
+  CheckLayout<CandidateLayout>(
+      cull_shader_.GetStorageBlockInfo("CandidatesBlock"), "candidates[0].",
+      {"draw", "model"}, sizeof(Candidate));
+  CheckLayout<ImpostorCommandLayout>(
+      cull_shader_.GetStorageBlockInfo("ImpostorCommandsBlock"),
+      "impostor_commands[0].",
+      {"count", "instance_count", "first", "base_instance"},
+      sizeof(ImpostorCommand));
+}
+
+bool MeshBatch::IsReady() { return arena_.IsReady(); }
+
+void MeshBatch::SetViews(int views, float radius) {
+  views_ = views;
+  view_radius_ = radius;
+}
+
+void MeshBatch::SetBoxVisibility(unsigned int buffer, int first_model,
+                                 int models_per_box, int n_boxes) {
+  box_visibility_ = buffer;
+  first_box_model_ = first_model;
+  models_per_box_ = models_per_box;
+  n_boxes_ = buffer ? n_boxes : 0;
+}
+
+void MeshBatch::SetImpostorAngle(float angle) { impostor_angle_ = angle; }
+
+void MeshBatch::SetModelsCode(const std::string &code) { models_code_ = code; }
+
+void MeshBatch::Cull(Pass pass, const glm::mat4 &view_projection,
+                     const glm::vec3 &eye, float lod_angle,
+                     DepthPyramid *pyramid) {
+  Cull(pass, &view_projection, 1, eye, lod_angle, pyramid);
+}
+
+void MeshBatch::Cull(Pass pass, const glm::mat4 *view_projections,
+                     int n_views, const glm::vec3 &eye, float lod_angle,
+                     DepthPyramid *pyramid) {
+  // The late pass culls the same instances as the early one
+  if (pass == EARLY_PASS)
+    UpdateInstances();
+  glCopyNamedBufferSubData(buffers_[RESET_COMMANDS_BUFFER],
+                           buffers_[COMMANDS_BUFFER + pass], 0, 0,
+                           commands_.size() * sizeof(Command));
+
+  cull_shader_.Enable();
+  ShaderProgram::BindStorageBuffer(buffer_bindings::DRAWS,
+                                   buffers_[DRAWS_BUFFER]);
+  ShaderProgram::BindStorageBuffer(buffer_bindings::INSTANCES,
+                                   buffers_[INSTANCES_BUFFER + pass]);
+  ShaderProgram::BindStorageBuffer(buffer_bindings::COMMANDS,
+                                   buffers_[COMMANDS_BUFFER + pass]);
+  ShaderProgram::BindStorageBuffer(buffer_bindings::CULL_DRAWS,
+                                   buffers_[CULL_DRAWS_BUFFER]);
+  ShaderProgram::BindStorageBuffer(buffer_bindings::CULL_LODS,
+                                   buffers_[CULL_LODS_BUFFER]);
+  ShaderProgram::BindStorageBuffer(buffer_bindings::CULL_MESHLETS,
+                                   buffers_[CULL_MESHLETS_BUFFER]);
+  ShaderProgram::BindStorageBuffer(buffer_bindings::CANDIDATES,
+                                   buffers_[CANDIDATES_BUFFER]);
+  ShaderProgram::BindStorageBuffer(buffer_bindings::DRAWN,
+                                   buffers_[DRAWN_BUFFER]);
+  if (pyramid)
+    pyramid->Bind(&cull_shader_, PYRAMID_UNIT);
+  else
+    cull_shader_.SetUniform("pyramid_levels", 0);
+  cull_shader_.SetUniform("late_pass", pass == LATE_PASS);
+  cull_shader_.SetUniform("shadow_pass", pass == SHADOW_PASS);
+  // The boxes hide what the previous frame hid, like the early pyramid
+  int n_boxes = pass == EARLY_PASS ? n_boxes_ : 0;
+  if (n_boxes)
+    ShaderProgram::BindStorageBuffer(buffer_bindings::BOX_VISIBILITY,
+                                     box_visibility_);
+  cull_shader_.SetUniform("n_boxes", n_boxes);
+  cull_shader_.SetUniform("first_box", first_box_model_);
+  cull_shader_.SetUniform("box_models", models_per_box_);
+  float impostor_angle = pass == SHADOW_PASS ? 0.0f : impostor_angle_;
+  if (impostor_angle > 0) {
+    ImpostorCommand reset = {IMPOSTOR_VERTICES, 0, 0, 0};
+    glNamedBufferSubData(buffers_[IMPOSTOR_COMMANDS_BUFFER],
+                         pass * sizeof(ImpostorCommand), sizeof(reset),
+                         &reset);
+    ShaderProgram::BindStorageBuffer(buffer_bindings::IMPOSTOR_COMMANDS,
+                                     buffers_[IMPOSTOR_COMMANDS_BUFFER]);
+    ShaderProgram::BindStorageBuffer(
+        buffer_bindings::IMPOSTOR_INSTANCES,
+        buffers_[IMPOSTOR_INSTANCES_BUFFER + pass]);
+  }
+  cull_shader_.SetUniform("impostor_angle", impostor_angle);
+  int n_candidates = candidates_.GetSize();
+  cull_shader_.SetUniform("n_candidates", n_candidates);
+  cull_shader_.SetUniform("eye", eye);
+  cull_shader_.SetUniform("lod_angle", lod_angle);
+  cull_shader_.SetUniform("eye_radius",
+                          pass == SHADOW_PASS ? 0.0f : view_radius_);
+  int n_frustums = n_views;
+  if (n_frustums > MAX_VIEWS)
+    n_frustums = MAX_VIEWS;
+  cull_shader_.SetUniform("n_frustums", n_frustums);
+  glm::vec4 planes[6 * MAX_VIEWS];
+  for (int f = 0; f < n_frustums; ++f)
+    ExtractFrustumPlanes(view_projections[f], planes + 6 * f);
+  cull_shader_.SetUniform(cull_shader_.GetUniform("frustum_planes"), planes,
+                          6 * n_frustums);
+  glDispatchCompute((n_candidates + GROUP_SIZE - 1) / GROUP_SIZE, 1, 1);
+  glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+  if (compact_)
+    Compact(pass);
+}
+
+void MeshBatch::Compact(Pass pass) {
+  unsigned int zero = 0;
+  glClearNamedBufferSubData(buffers_[DRAW_COUNTS_BUFFER], GL_R32UI,
+                            pass * sizeof(unsigned int), sizeof(unsigned int),
+                            GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+  compact_shader_.Enable();
+  ShaderProgram::BindStorageBuffer(buffer_bindings::COMMANDS,
+                                   buffers_[COMMANDS_BUFFER + pass]);
+  ShaderProgram::BindStorageBuffer(buffer_bindings::COMPACT_COMMANDS,
+                                   buffers_[COMPACT_COMMANDS_BUFFER + pass]);
+  ShaderProgram::BindStorageBuffer(buffer_bindings::DRAW_COUNTS,
+                                   buffers_[DRAW_COUNTS_BUFFER]);
+  int n_commands = commands_.size();
+  compact_shader_.SetUniform("n_commands", n_commands);
+  compact_shader_.SetUniform("pass", (int)pass);
+  compact_shader_.SetUniform("views", pass == SHADOW_PASS ? 1 : views_);
+  int n_groups = compaction_.Bind(n_commands);
+  glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+  glDispatchCompute(n_groups, 1, 1);
+  glMemoryBarrier(GL_COMMAND_BARRIER_BIT);
+}
+
+void MeshBatch::DrawAll(Pass pass) {
+  // The base instances index the draws, so every pass shares them
+  ShaderProgram::BindStorageBuffer(buffer_bindings::DRAWS,
+                                   buffers_[DRAWS_BUFFER]);
+  ShaderProgram::BindStorageBuffer(buffer_bindings::INSTANCES,
+                                   buffers_[INSTANCES_BUFFER + pass]);
+  ShaderProgram::BindStorageBuffer(buffer_bindings::PULLED_VERTICES,
+                                   arena_.GetVertexBuffer());
+  arena_.Bind();
+  if (compact_) {
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER,
+                 buffers_[COMPACT_COMMANDS_BUFFER + pass]);
+    glBindBuffer(GL_PARAMETER_BUFFER_ARB, buffers_[DRAW_COUNTS_BUFFER]);
+    glMultiDrawElementsIndirectCountARB(
+        GL_TRIANGLES, arena_.GetIndexType(), nullptr,
+        pass * sizeof(unsigned int), commands_.size(), 0);
+    glBindBuffer(GL_PARAMETER_BUFFER_ARB, 0);
+  } else {
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, buffers_[COMMANDS_BUFFER + pass]);
+    glMultiDrawElementsIndirect(GL_TRIANGLES, arena_.GetIndexType(), nullptr,
+                                commands_.size(), 0);
+  }
+  GLState::CountDraw();
+  glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+void MeshBatch::DrawImpostors(Pass pass) {
+  if (!impostor_angle_ || pass == SHADOW_PASS)
+    return;
+  ShaderProgram::BindStorageBuffer(buffer_bindings::IMPOSTOR_INSTANCES,
+                                   buffers_[IMPOSTOR_INSTANCES_BUFFER + pass]);
+  // The quads have no attributes, but a vertex array must be bound
+  arena_.Bind();
+  glBindBuffer(GL_DRAW_INDIRECT_BUFFER, buffers_[IMPOSTOR_COMMANDS_BUFFER]);
+  auto offset = pass * sizeof(ImpostorCommand);
+  glDrawArraysIndirect(GL_TRIANGLE_STRIP,
+                       reinterpret_cast<const void *>(offset));
+  GLState::CountDraw();
+  glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+}
+
+void MeshBatch::DrawLevel(int draw, int lod) {
+  ShaderProgram::BindStorageBuffer(buffer_bindings::DRAWS,
+                                   buffers_[DRAWS_BUFFER]);
+  arena_.Bind();
+  auto type = arena_.GetIndexType();
+  size_t index_size =
+      type == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int);
+  auto &cull_lod = cull_lods_[cull_draws_[draw].first_lod + lod];
+  for (int i = 0; i < cull_lod.n_commands; ++i) {
+    auto &command = commands_[cull_lod.first_command + i];
+    glDrawElementsInstancedBaseVertexBaseInstance(
+        GL_TRIANGLES, command.count, type,
+        reinterpret_cast<const void *>(command.first_index * index_size), 1,
+        command.base_vertex, command.base_instance);
+    GLState::CountDraw();
+  }
+}
+
+void MeshBatch::BindVisibilityBuffers() {
+  // Only the instance counts differ from the reset commands
+  ShaderProgram::BindStorageBuffer(buffer_bindings::DRAWS,
+                                   buffers_[DRAWS_BUFFER]);
+  ShaderProgram::BindStorageBuffer(buffer_bindings::COMMANDS,
+                                   buffers_[RESET_COMMANDS_BUFFER]);
+  ShaderProgram::BindStorageBuffer(buffer_bindings::INSTANCES,
+                                   buffers_[INSTANCES_BUFFER]);
+  ShaderProgram::BindStorageBuffer(buffer_bindings::LATE_INSTANCES,
+                                   buffers_[LATE_INSTANCES_BUFFER]);
+  ShaderProgram::BindStorageBuffer(buffer_bindings::VISIBILITY_VERTICES,
+                                   arena_.GetVertexBuffer());
+  ShaderProgram::BindStorageBuffer(buffer_bindings::VISIBILITY_INDICES,
+                                   arena_.GetIndexBuffer());
+}
+
+unsigned int MeshBatch::GetIndexType() { return arena_.GetIndexType(); }
+
+unsigned int MeshBatch::GetVertexBuffer() { return arena_.GetVertexBuffer(); }
+
+int MeshBatch::GetVertexCount() { return arena_.GetVertexCount(); }
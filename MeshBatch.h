@@ -0,0 +1,473 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef MESHBATCH_H
+#define MESHBATCH_H
+
+#include <string>
+#include <vector>
+
+#include "BlockLayout.h"
+#include "DepthPyramid.h"
+#include "EntityPool.h"
+#include "MeshArena.h"
+#include "MeshOptimizer.h"
+#include "ShaderProgram.h"
+#include "StreamCompaction.h"
+
+/**
+ * Triangle meshes in shared buffers, drawn with a single indirect call
+ *
+ * The meshes are suballocated from a MeshArena, with the positions, normals
+ * and texture coordinates interleaved in a single buffer, and every draw is
+ * an indirect command plus an entry of the DrawsBlock storage block, which
+ * the vertex shader reads with the base instance of the command to find its
+ * material and where its model matrix indices start in the InstancesBlock
+ * storage block (see shaders/geometry.glsl). Adding meshes or draws doesn't
+ * add calls, state changes or rebinds to the frame.
+ *
+ * The instances of the draws are added, moved and removed by handle at any
+ * time, with no limit on their number. They are kept dense in the candidates
+ * storage block, a removal moving the last one into its place, and only the
+ * changed ones are sent before the next early pass; the slots of a draw in
+ * InstancesBlock grow in powers of two, so the buffers are only recreated
+ * once in a while.
+ *
+ * Each mesh is split into meshlets (see BuildMeshlets), and each draw has a
+ * command per meshlet of each level of detail of its mesh. Every frame a
+ * compute shader tests the bounding sphere of each instance against the
+ * frustum and a depth pyramid, picks the level of the visible ones from their
+ * angular size, culls the meshlets of that level that face away or are out of
+ * the frustum and appends the instance to the commands of the others,
+ * counting it in them (see shaders/cull_cs.glsl). With
+ * ARB_indirect_parameters, a second compute shader then compacts the
+ * commands with instances into a dense list, in their order, with one pass
+ * of prefix sums (see StreamCompaction), and the draw call reads their
+ * count, so the commands of the culled meshlets cost nothing however many
+ * there are (see shaders/compact_cs.glsl). The cpu never reads the result.
+ *
+ * The culling runs in two passes with their own commands. The early pass
+ * tests against the pyramid of the previous frame and its draws fill the
+ * depth buffer; once the pyramid is rebuilt from it, the late pass tests the
+ * instances the early one rejected, so the ones that came into view are
+ * drawn in the same frame.
+ *
+ * The distant instances of both passes may be drawn as impostors instead,
+ * a quad each, which the culling appends to a list of its own (see
+ * SetImpostorAngle).
+ */
+class MeshBatch {
+public:
+  /**
+   * Per-draw data, as struct Draw of shaders/geompass_vs.glsl
+   */
+  struct Draw {
+    glm::vec4 dequantization;  // offset in xyz and scale in w
+    int material_id;
+    int first_instance;
+    int padding[2];
+  };
+
+  /**
+   * Layout of glMultiDrawElementsIndirect, as struct Command of
+   * shaders/cull_cs.glsl
+   */
+  struct Command {
+    unsigned int count;
+    unsigned int instance_count;
+    unsigned int first_index;
+    int base_vertex;
+    unsigned int base_instance;
+  };
+
+  /**
+   * Culling data of the draws, as struct CullDraw of shaders/cull_cs.glsl
+   */
+  struct CullDraw {
+    glm::vec4 sphere;  // bounding sphere of the mesh, in model space
+    int first_lod;     // the full detail level, the others follow
+    int n_lods;
+    int padding[2];
+  };
+
+  /**
+   * Commands of a level of detail of a draw, one per meshlet, as struct
+   * CullLod of shaders/cull_cs.glsl
+   */
+  struct CullLod {
+    int first_command;
+    int n_commands;
+  };
+
+  /**
+   * Bounds of the meshlet of each command in model space, as struct
+   * CullMeshlet of shaders/cull_cs.glsl
+   */
+  struct CullMeshlet {
+    glm::vec4 sphere;
+    glm::vec4 cone;  // axis and cutoff, as in Meshlet
+  };
+
+  /**
+   * Layout of glDrawArraysIndirect, as struct ImpostorCommand of
+   * shaders/cull_cs.glsl
+   */
+  struct ImpostorCommand {
+    unsigned int count;
+    unsigned int instance_count;
+    unsigned int first;
+    unsigned int base_instance;
+  };
+
+  /**
+   * Instance to cull, as struct Candidate of shaders/cull_cs.glsl
+   */
+  struct Candidate {
+    int draw;
+    int model;
+  };
+
+  /**
+   * Culling passes of a frame, each with its own draws; the shadow pass
+   * culls for a shadow map, after the early pass, without the pyramid
+   */
+  enum Pass { EARLY_PASS, LATE_PASS, SHADOW_PASS, N_PASSES };
+
+  /**
+   * Most views an instance is drawn from in one call, see SetViews()
+   */
+  static const int MAX_VIEWS = 16;
+
+  /**
+   * Default constructor
+   */
+  MeshBatch();
+
+  /**
+   * Destructor
+   */
+  ~MeshBatch();
+
+  /**
+   * Appends a triangle mesh, with 3 floats per position and per normal
+   * The positions are quantized to 16 bits relative to the bounds of the
+   * mesh, and the normals are packed in 10 bits per component; the triangles
+   * are split into meshlets in their order
+   * The optional texture coordinates, 2 floats per vertex, are stored as
+   * half floats. The optional materials of the vertices are offsets to the
+   * material of the draws, so a mesh with several materials is still a
+   * single draw; they go in the fourth component of the position
+   * Returns the id of the mesh
+   */
+  int AddMesh(const float *positions, const float *normals, int n_vertices,
+              const unsigned int *indices, int n_indices,
+              const float *texcoords = nullptr,
+              const int *materials = nullptr);
+
+  /**
+   * Appends a level of detail of a mesh: other indices into its vertices,
+   * split into meshlets as well
+   * Returns the id of the new mesh
+   */
+  int AddLod(int mesh, const unsigned int *indices, int n_indices);
+
+  /**
+   * Obtains the bounding sphere of a mesh in model space, the radius in w
+   */
+  glm::vec4 GetBoundingSphere(int mesh);
+
+  /**
+   * Adds a draw with no instances of a mesh given by its levels of detail
+   * from the full one down
+   * Returns the id of the draw
+   */
+  int AddDraw(const std::vector<int> &lods, int material_id);
+
+  /**
+   * Adds a draw of n instances, whose model matrices start at first_model
+   */
+  void AddDraw(const std::vector<int> &lods, int material_id, int first_model,
+               int n_instances);
+
+  /**
+   * Adds an instance of a draw with the model matrix at an index of the
+   * models; the models may only rotate and translate
+   * Returns the handle of the instance, valid until it is removed
+   */
+  int AddInstance(int draw, int model);
+
+  /**
+   * Changes the model matrix index of an instance
+   */
+  void SetInstanceModel(int instance, int model);
+
+  /**
+   * Removes an instance; its handle may be given to a later one
+   */
+  void RemoveInstance(int instance);
+
+  /**
+   * Obtains the number of instances of every draw
+   */
+  int GetInstanceCount();
+
+  /**
+   * Orders the instances front to back along the view direction, so the
+   * nearest ones fill the depth buffer before the early depth test meets the
+   * others; the instances of each command follow the culling threads, so
+   * the order is only approximate
+   * The depths of the bounding spheres, with the model matrices given, are
+   * quantized and radix sorted. The order is kept while the eye and the
+   * direction barely move and no instance is added, removed or given
+   * another model
+   */
+  void SortInstances(const glm::vec3 &eye, const glm::vec3 &direction,
+                     const glm::mat4 *models);
+
+  /**
+   * Uploads the meshes and the draws and creates the culling shader
+   * The meshes go right away or through a queue, and the draws right away
+   * Must be called once, after adding all of them; until then the batch is
+   * only touched by the cpu, so it may be filled on another thread. The
+   * instances may still be changed afterwards, on the gl thread
+   * Throws runtime_error if the shader doesn't compile or its blocks don't
+   * match the structures
+   */
+  void Upload(UploadQueue *queue = nullptr);
+
+  /**
+   * Checks if the batch was uploaded and its meshes are all on the gpu
+   * Cull() and DrawAll() can only be called once it is
+   */
+  bool IsReady();
+
+  /**
+   * Draws every instance of the early and late passes once per view, the
+   * view in gl_InstanceID % views (see shaders/geometry.glsl); the views are
+   * up to radius away from the eye given to Cull(), which the backface test
+   * and the levels of detail of the meshlets allow for
+   * The compacted commands multiply their instances, so it requires
+   * ARB_indirect_parameters
+   */
+  void SetViews(int views, float radius);
+
+  /**
+   * Makes the early pass also cull the instances whose box failed its
+   * occlusion query: the visibility of each box of models_per_box models
+   * from first_model on is a uint of the buffer (see OcclusionQueries), and
+   * the other models are never culled by it; a 0 buffer stops it
+   */
+  void SetBoxVisibility(unsigned int buffer, int first_model,
+                        int models_per_box, int n_boxes);
+
+  /**
+   * Makes the early and the late passes cull the instances whose bounding
+   * sphere radius over distance to the eye is below angle to impostors
+   * instead of any level of detail (see Impostors); 0 stops it
+   * The impostors are of a single mesh, so every draw must be of it. The
+   * shadow pass keeps the levels of detail
+   */
+  void SetImpostorAngle(float angle);
+
+  /**
+   * Adds definitions to the culling shader for the layout of the models it
+   * reads (see shaders/models.glsl); must be called before Upload()
+   */
+  void SetModelsCode(const std::string &code);
+
+  /**
+   * Culls the instances and picks their levels of detail on the gpu
+   * An instance moves to the next level once its bounding sphere radius over
+   * its distance to the eye falls below lod_angle, and to every further
+   * level at each 1/sqrt(2) of it
+   * The early pass tests every instance against the pyramid, and the late
+   * pass only the ones rejected by the early pass of the frame (see Pass)
+   * The shadow pass may be culled many times per frame and takes no pyramid
+   * The model matrices must be bound to buffer_bindings::MODELS
+   */
+  void Cull(Pass pass, const glm::mat4 &view_projection, const glm::vec3 &eye,
+            float lod_angle, DepthPyramid *pyramid);
+
+  /**
+   * Same as Cull(), but keeps the instances in the frustum of any of up to
+   * MAX_VIEWS view projections
+   */
+  void Cull(Pass pass, const glm::mat4 *view_projections, int n_views,
+            const glm::vec3 &eye, float lod_angle, DepthPyramid *pyramid);
+
+  /**
+   * Issues every draw of the last Cull() of a pass in a single call, with
+   * the vertices also bound to PulledVerticesBlock for the programs that
+   * fetch them without attributes
+   * The geometry program must be enabled
+   */
+  void DrawAll(Pass pass);
+
+  /**
+   * Issues the impostors of the last Cull() of the early or the late pass,
+   * a triangle strip of 4 vertices each, in a single call
+   * The impostor program must be enabled, it reads the model of each
+   * instance from buffer_bindings::IMPOSTOR_INSTANCES
+   */
+  void DrawImpostors(Pass pass);
+
+  /**
+   * Draws each meshlet of a level of detail of a draw once, with no
+   * culling, with the base instances of its commands; for baking
+   * The program must be enabled
+   */
+  void DrawLevel(int draw, int lod);
+
+  /**
+   * Binds the buffers read by the resolve of the visibility buffer: the
+   * draws, the commands, the instances of the early and the late passes,
+   * and the vertices and the indices of the meshes
+   */
+  void BindVisibilityBuffers();
+
+  /**
+   * Obtains the type of the indices, GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+   */
+  unsigned int GetIndexType();
+
+  /**
+   * Obtains the buffer of the vertices of the meshes, in the format of
+   * AddMesh(), and their number; for the passes that read them from storage
+   * blocks (see VertexSkinning)
+   * Valid after Upload()
+   */
+  unsigned int GetVertexBuffer();
+  int GetVertexCount();
+
+private:
+  // Computes the first slot of each command in InstancesBlock from the
+  // capacity of its draw
+  void LayOutInstances();
+
+  // Compacts the commands of a pass with instances, in their order
+  void Compact(Pass pass);
+
+  // Sends the changed instances, recreating the buffers that grew
+  void UpdateInstances();
+
+  // Marks an instance to be sent
+  void MarkChanged(int slot);
+
+  // Checks if the order of the last SortInstances() holds for a view
+  bool IsSorted(const glm::vec3 &eye, const glm::vec3 &direction);
+
+  // Quantized position, with an unused w, and packed normal: 12 bytes
+  struct Vertex {
+    short position[4];
+    unsigned int normal;
+    unsigned short texcoord[2];
+  };
+
+  MeshArena arena_;
+  std::vector<glm::vec4> dequantizations_;  // of each mesh
+  std::vector<glm::vec4> bounding_spheres_;
+  std::vector<std::vector<Meshlet>> meshlets_;
+  // Vertices of the meshes, kept until the upload to split the levels of
+  // detail, and the mesh whose vertices each mesh indexes
+  std::vector<std::vector<float>> positions_;
+  std::vector<std::vector<float>> normals_;
+  std::vector<int> vertex_meshes_;
+  std::vector<Command> commands_;
+  std::vector<Draw> draws_;
+  std::vector<CullDraw> cull_draws_;
+  std::vector<CullLod> cull_lods_;
+  std::vector<CullMeshlet> cull_meshlets_;  // of each command
+  EntityPool<Candidate> candidates_;  // handles of the instances
+  std::vector<int> draw_counts_;      // instances of each draw
+  std::vector<int> draw_capacities_;  // their slots per command
+  bool layout_changed_;
+  int candidates_capacity_;  // in the candidates buffer
+  int first_changed_, end_changed_;
+  int n_instances_;  // slots of the draws in InstancesBlock
+  // View of the last sort, and if the instances changed since
+  glm::vec3 sorted_eye_, sorted_direction_;
+  bool sorted_;
+  ShaderProgram cull_shader_;
+  ShaderProgram compact_shader_;
+  bool compact_;  // if the commands with instances are compacted
+  StreamCompaction compaction_;
+  int views_;
+  float view_radius_;
+  unsigned int box_visibility_;  // see SetBoxVisibility()
+  int first_box_model_, models_per_box_, n_boxes_;
+  float impostor_angle_;  // see SetImpostorAngle()
+  std::string models_code_;  // see SetModelsCode()
+  unsigned int buffers_[20];
+};
+
+typedef BlockLayout<glm::vec4, int, int> DrawLayout;
+CHECK_BLOCK_MEMBER(MeshBatch::Draw, DrawLayout, 0, dequantization);
+CHECK_BLOCK_MEMBER(MeshBatch::Draw, DrawLayout, 1, material_id);
+CHECK_BLOCK_MEMBER(MeshBatch::Draw, DrawLayout, 2, first_instance);
+CHECK_BLOCK_STRIDE(MeshBatch::Draw, DrawLayout, Std430Stride);
+
+typedef BlockLayout<unsigned int, unsigned int, unsigned int, int,
+                    unsigned int> CommandLayout;
+CHECK_BLOCK_MEMBER(MeshBatch::Command, CommandLayout, 0, count);
+CHECK_BLOCK_MEMBER(MeshBatch::Command, CommandLayout, 1, instance_count);
+CHECK_BLOCK_MEMBER(MeshBatch::Command, CommandLayout, 2, first_index);
+CHECK_BLOCK_MEMBER(MeshBatch::Command, CommandLayout, 3, base_vertex);
+CHECK_BLOCK_MEMBER(MeshBatch::Command, CommandLayout, 4, base_instance);
+CHECK_BLOCK_STRIDE(MeshBatch::Command, CommandLayout, Std430Stride);
+
+typedef BlockLayout<glm::vec4, int, int> CullDrawLayout;
+CHECK_BLOCK_MEMBER(MeshBatch::CullDraw, CullDrawLayout, 0, sphere);
+CHECK_BLOCK_MEMBER(MeshBatch::CullDraw, CullDrawLayout, 1, first_lod);
+CHECK_BLOCK_MEMBER(MeshBatch::CullDraw, CullDrawLayout, 2, n_lods);
+CHECK_BLOCK_STRIDE(MeshBatch::CullDraw, CullDrawLayout, Std430Stride);
+
+typedef BlockLayout<int, int> CullLodLayout;
+CHECK_BLOCK_MEMBER(MeshBatch::CullLod, CullLodLayout, 0, first_command);
+CHECK_BLOCK_MEMBER(MeshBatch::CullLod, CullLodLayout, 1, n_commands);
+CHECK_BLOCK_STRIDE(MeshBatch::CullLod, CullLodLayout, Std430Stride);
+
+typedef BlockLayout<glm::vec4, glm::vec4> CullMeshletLayout;
+CHECK_BLOCK_MEMBER(MeshBatch::CullMeshlet, CullMeshletLayout, 0, sphere);
+CHECK_BLOCK_MEMBER(MeshBatch::CullMeshlet, CullMeshletLayout, 1, cone);
+CHECK_BLOCK_STRIDE(MeshBatch::CullMeshlet, CullMeshletLayout, Std430Stride);
+
+typedef BlockLayout<unsigned int, unsigned int, unsigned int, unsigned int>
+    ImpostorCommandLayout;
+CHECK_BLOCK_MEMBER(MeshBatch::ImpostorCommand, ImpostorCommandLayout, 0,
+                   count);
+CHECK_BLOCK_MEMBER(MeshBatch::ImpostorCommand, ImpostorCommandLayout, 1,
+                   instance_count);
+CHECK_BLOCK_MEMBER(MeshBatch::ImpostorCommand, ImpostorCommandLayout, 2,
+                   first);
+CHECK_BLOCK_MEMBER(MeshBatch::ImpostorCommand, ImpostorCommandLayout, 3,
+                   base_instance);
+CHECK_BLOCK_STRIDE(MeshBatch::ImpostorCommand, ImpostorCommandLayout,
+                   Std430Stride);
+
+typedef BlockLayout<int, int> CandidateLayout;
+CHECK_BLOCK_MEMBER(MeshBatch::Candidate, CandidateLayout, 0, draw);
+CHECK_BLOCK_MEMBER(MeshBatch::Candidate, CandidateLayout, 1, model);
+CHECK_BLOCK_STRIDE(MeshBatch::Candidate, CandidateLayout, Std430Stride);
+
+#endif
@@ -0,0 +1,248 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "MeshCache.h"
+
+namespace {
+
+// Changes whenever the layout of the file or the processing of the meshes
+// does, so older files are rebuilt
+const uint32_t VERSION = 3;
+
+// Start of every cache file, followed by the index count of each level, the
+// materials, the null-terminated texture paths of the materials padded to 4
+// bytes, the positions, the normals, the texture coordinates, the material of
+// each vertex and the indices of each level
+struct Header {
+  char magic[4];
+  uint32_t version;
+  uint64_t key;
+  uint32_t n_materials;
+  uint32_t n_texture_bytes;  // with the padding
+  uint32_t n_vertices;
+  uint32_t n_lods;
+};
+
+const char MAGIC[4] = {'M', 'E', 'S', 'H'};
+
+}  // namespace
+
+MeshCache::MeshCache()
+    : mapping_(nullptr),
+      size_(0),
+      n_materials_(0),
+      materials_(nullptr),
+      n_vertices_(0),
+      positions_(nullptr),
+      normals_(nullptr),
+      texcoords_(nullptr),
+      material_ids_(nullptr) {}
+
+MeshCache::~MeshCache() { Close(); }
+
+uint64_t MeshCache::ComputeKey(const std::string& source,
+                               const std::string& settings) {
+  std::ifstream input(source, std::ios::binary);
+  if (!input.is_open())
+    throw std::runtime_error("Unable to open file: " + source);
+  uint64_t hash = 14695981039346656037ull;
+  auto add = [&](const char* data, size_t size) {
+    for (size_t i = 0; i < size; ++i)
+      hash = (hash ^ (unsigned char)data[i]) * 1099511628211ull;
+    hash = (hash ^ 0xff) * 1099511628211ull;
+  };
+  std::vector<char> buffer(1 << 16);
+  while (input.read(buffer.data(), buffer.size()) || input.gcount() > 0)
+    add(buffer.data(), input.gcount());
+  add(settings.data(), settings.size());
+  return hash;
+}
+
+std::string MeshCache::GetPath(const std::string& directory, uint64_t key) {
+  char name[32];
+  snprintf(name, sizeof(name), "/%016llx.mesh", (unsigned long long)key);
+  return directory + name;
+}
+
+bool MeshCache::Open(const std::string& path, uint64_t key) {
+  Close();
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    return false;
+  struct stat info;
+  if (fstat(fd, &info) == 0 && (size_t)info.st_size >= sizeof(Header)) {
+    size_ = info.st_size;
+    mapping_ = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapping_ == MAP_FAILED)
+      mapping_ = nullptr;
+  }
+  // The mapping stays valid once the descriptor is closed
+  close(fd);
+  if (!mapping_)
+    return false;
+
+  auto header = (const Header*)mapping_;
+  auto counts = (const uint32_t*)(header + 1);
+  bool valid = memcmp(header->magic, MAGIC, sizeof(MAGIC)) == 0 &&
+               header->version == VERSION && header->key == key &&
+               sizeof(Header) + header->n_lods * sizeof(uint32_t) <= size_;
+  size_t expected = 0;
+  if (valid) {
+    expected = sizeof(Header) + header->n_lods * sizeof(uint32_t) +
+               header->n_materials * sizeof(ObjMaterial) +
+               header->n_texture_bytes +
+               ((3 + 3 + 2) * sizeof(float) + sizeof(int)) *
+                   (size_t)header->n_vertices;
+    for (uint32_t i = 0; i < header->n_lods; ++i)
+      expected += counts[i] * sizeof(unsigned int);
+  }
+  if (!valid || expected != size_) {
+    Close();
+    return false;
+  }
+
+  n_materials_ = header->n_materials;
+  materials_ = (const ObjMaterial*)(counts + header->n_lods);
+  auto names = (const char*)(materials_ + n_materials_);
+  auto names_end = names + header->n_texture_bytes;
+  for (int i = 0; i < n_materials_; ++i) {
+    auto end = (const char*)memchr(names, '\0', names_end - names);
+    if (!end) {
+      Close();
+      return false;
+    }
+    textures_.emplace_back(names, end);
+    names = end + 1;
+  }
+  n_vertices_ = header->n_vertices;
+  positions_ = (const float*)names_end;
+  normals_ = positions_ + 3 * n_vertices_;
+  texcoords_ = normals_ + 3 * n_vertices_;
+  material_ids_ = (const int*)(texcoords_ + 2 * n_vertices_);
+  auto indices = (const unsigned int*)(material_ids_ + n_vertices_);
+  for (uint32_t i = 0; i < header->n_lods; ++i) {
+    indices_.push_back(indices);
+    n_indices_.push_back(counts[i]);
+    indices += counts[i];
+  }
+  return true;
+}
+
+void MeshCache::Write(const std::string& path, uint64_t key,
+                      const ObjMesh& mesh,
+                      const std::vector<std::vector<unsigned int>>& lods) {
+  Header header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, MAGIC, sizeof(MAGIC));
+  header.version = VERSION;
+  header.key = key;
+  header.n_materials = mesh.materials.size();
+  std::string names;
+  for (auto& texture : mesh.textures)
+    names.append(texture.c_str(), texture.size() + 1);
+  names.resize((names.size() + 3) / 4 * 4, '\0');
+  header.n_texture_bytes = names.size();
+  header.n_vertices = mesh.positions.size() / 3;
+  header.n_lods = lods.size();
+  std::vector<uint32_t> counts;
+  for (auto& lod : lods)
+    counts.push_back(lod.size());
+
+  // Written to a temporary file first, so an interrupted write never leaves
+  // a truncated file under the final name
+  auto temporary = path + ".tmp";
+  {
+    std::ofstream output(temporary, std::ios::binary | std::ios::trunc);
+    output.write((const char*)&header, sizeof(header));
+    output.write((const char*)counts.data(), counts.size() * sizeof(uint32_t));
+    output.write((const char*)mesh.materials.data(),
+                 header.n_materials * sizeof(ObjMaterial));
+    output.write(names.data(), names.size());
+    output.write((const char*)mesh.positions.data(),
+                 3 * header.n_vertices * sizeof(float));
+    output.write((const char*)mesh.normals.data(),
+                 3 * header.n_vertices * sizeof(float));
+    output.write((const char*)mesh.texcoords.data(),
+                 2 * header.n_vertices * sizeof(float));
+    output.write((const char*)mesh.material_ids.data(),
+                 header.n_vertices * sizeof(int));
+    for (auto& lod : lods)
+      output.write((const char*)lod.data(), lod.size() * sizeof(unsigned int));
+    output.close();
+    if (!output) {
+      remove(temporary.c_str());
+      return;
+    }
+  }
+  rename(temporary.c_str(), path.c_str());
+}
+
+int MeshCache::GetMaterialCount() { return n_materials_; }
+
+const ObjMaterial* MeshCache::GetMaterials() { return materials_; }
+
+const std::vector<std::string>& MeshCache::GetTextures() { return textures_; }
+
+int MeshCache::GetVertexCount() { return n_vertices_; }
+
+const float* MeshCache::GetPositions() { return positions_; }
+
+const float* MeshCache::GetNormals() { return normals_; }
+
+const float* MeshCache::GetTexcoords() { return texcoords_; }
+
+const int* MeshCache::GetMaterialIds() { return material_ids_; }
+
+int MeshCache::GetLodCount() { return indices_.size(); }
+
+const unsigned int* MeshCache::GetIndices(int lod) { return indices_[lod]; }
+
+int MeshCache::GetIndexCount(int lod) { return n_indices_[lod]; }
+
+void MeshCache::Close() {
+  if (mapping_)
+    munmap(mapping_, size_);
+  mapping_ = nullptr;
+  size_ = 0;
+  n_materials_ = 0;
+  materials_ = nullptr;
+  textures_.clear();
+  n_vertices_ = 0;
+  positions_ = nullptr;
+  normals_ = nullptr;
+  texcoords_ = nullptr;
+  material_ids_ = nullptr;
+  indices_.clear();
+  n_indices_.clear();
+}
@@ -0,0 +1,159 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef MESHCACHE_H
+#define MESHCACHE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "ObjLoader.h"
+
+/**
+ * Binary file of an imported mesh with its levels of detail
+ *
+ * It holds what the application adds to MeshBatch once a source file is
+ * parsed, optimized and simplified: the material table with the paths of the
+ * diffuse maps, the vertices, with 3 floats per position and per normal, 2
+ * per texture coordinate and a material, and the indices of each level into
+ * them. The textures themselves aren't in the file. The file is named
+ * after a key of the source and memory mapped, so loading it does no parsing
+ * and the batch copies straight from the mapping.
+ */
+class MeshCache {
+public:
+  /**
+   * Default constructor
+   */
+  MeshCache();
+
+  /**
+   * Destructor, unmaps the file
+   */
+  ~MeshCache();
+
+  /**
+   * Computes the key of a source file: the 64 bits FNV-1a of its contents
+   * and of the settings of the import
+   * Throws runtime_error if the file can't be read
+   */
+  static uint64_t ComputeKey(const std::string& source,
+                             const std::string& settings);
+
+  /**
+   * Obtains the path of the file of a key in a cache directory
+   */
+  static std::string GetPath(const std::string& directory, uint64_t key);
+
+  /**
+   * Maps a cache file
+   * Returns false if it is missing, truncated or of another version or key
+   */
+  bool Open(const std::string& path, uint64_t key);
+
+  /**
+   * Writes a cache file
+   * The cache is only an optimization, so failing to write it isn't an error
+   */
+  static void Write(const std::string& path, uint64_t key,
+                    const ObjMesh& mesh,
+                    const std::vector<std::vector<unsigned int>>& lods);
+
+  /**
+   * Obtains the number of materials of the opened file
+   */
+  int GetMaterialCount();
+
+  /**
+   * Obtains the materials of the opened file
+   */
+  const ObjMaterial* GetMaterials();
+
+  /**
+   * Obtains the diffuse map of each material of the opened file, "" for none
+   */
+  const std::vector<std::string>& GetTextures();
+
+  /**
+   * Obtains the number of vertices of the opened file
+   */
+  int GetVertexCount();
+
+  /**
+   * Obtains the positions of the opened file, 3 floats per vertex
+   */
+  const float* GetPositions();
+
+  /**
+   * Obtains the normals of the opened file, 3 floats per vertex
+   */
+  const float* GetNormals();
+
+  /**
+   * Obtains the texture coordinates of the opened file, 2 floats per vertex
+   */
+  const float* GetTexcoords();
+
+  /**
+   * Obtains the material of each vertex of the opened file
+   */
+  const int* GetMaterialIds();
+
+  /**
+   * Obtains the number of levels of detail of the opened file
+   */
+  int GetLodCount();
+
+  /**
+   * Obtains the indices of a level of detail of the opened file
+   */
+  const unsigned int* GetIndices(int lod);
+
+  /**
+   * Obtains the number of indices of a level of detail of the opened file
+   */
+  int GetIndexCount(int lod);
+
+private:
+  /**
+   * Unmaps the opened file, if any
+   */
+  void Close();
+
+  void* mapping_;
+  size_t size_;
+  int n_materials_;
+  const ObjMaterial* materials_;
+  std::vector<std::string> textures_;
+  int n_vertices_;
+  const float* positions_;
+  const float* normals_;
+  const float* texcoords_;
+  const int* material_ids_;
+  std::vector<const unsigned int*> indices_;  // of each level
+  std::vector<int> n_indices_;
+};
+
+#endif
@@ -0,0 +1,560 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <tuple>
+
+#include <glm/glm.hpp>
+
+#include "MeshOptimizer.h"
+
+namespace {
+
+// A cluster boundary is kept when the triangles since the last one are as
+// cache friendly on their own, with a cold cache, as the whole mesh times this
+const float CLUSTER_ACMR_SLACK = 1.05f;
+
+// Fifo post-transform cache, counting the vertex shader runs
+class FifoCache {
+ public:
+  FifoCache(int n_vertices, int size)
+      : stamps_(n_vertices, -1), size_(size), misses_(0), flushed_(0) {}
+
+  // Fetches a vertex, returns whether it had to be shaded
+  bool Fetch(unsigned int vertex) {
+    int stamp = stamps_[vertex];
+    if (stamp >= flushed_ && misses_ - stamp < size_)
+      return false;
+    stamps_[vertex] = misses_++;
+    return true;
+  }
+
+  // Empties the cache
+  void Flush() { flushed_ = misses_; }
+
+ private:
+  std::vector<int> stamps_;  // value of misses_ when each vertex got in
+  int size_;
+  int misses_;
+  int flushed_;
+};
+
+// Obtains a vertex with triangles left to fan from, first among the recently
+// emitted ones and then in index order; -1 once every triangle is emitted
+int SkipDeadEnd(const std::vector<int> &live,
+                std::vector<unsigned int> *dead_ends, int *cursor) {
+  while (!dead_ends->empty()) {
+    unsigned int vertex = dead_ends->back();
+    dead_ends->pop_back();
+    if (live[vertex] > 0)
+      return vertex;
+  }
+  for (; *cursor < (int)live.size(); ++*cursor)
+    if (live[*cursor] > 0)
+      return *cursor;
+  return -1;
+}
+
+// Drops the boundaries that would split the triangles into clusters less
+// cache friendly than the whole order
+std::vector<int> MergeClusters(const std::vector<unsigned int> &indices,
+                               const std::vector<int> &boundaries,
+                               int n_vertices, int cache_size) {
+  float threshold =
+      ComputeAcmr(indices, n_vertices, cache_size) * CLUSTER_ACMR_SLACK;
+  FifoCache cache(n_vertices, cache_size);
+  std::vector<int> clusters = {0};
+  int misses = 0;
+  size_t next = 0;
+  for (size_t i = 0; i < indices.size(); i += 3) {
+    for (; next < boundaries.size() && boundaries[next] <= (int)i; ++next) {
+      int n_triangles = (i - clusters.back()) / 3;
+      if (n_triangles > 0 && misses <= threshold * n_triangles) {
+        clusters.push_back(i);
+        cache.Flush();
+        misses = 0;
+      }
+    }
+    for (int k = 0; k < 3; ++k)
+      misses += cache.Fetch(indices[i + k]);
+  }
+  return clusters;
+}
+
+// Sum of squared distances to a set of planes, as the symmetric matrix
+// [a b c d]^T [a b c d] of each plane ax + by + cz + d = 0
+struct Quadric {
+  double xx, xy, xz, xw, yy, yz, yw, zz, zw, ww;
+
+  // Adds a plane, weighted
+  void AddPlane(glm::dvec3 n, double d, double weight) {
+    xx += weight * n.x * n.x;
+    xy += weight * n.x * n.y;
+    xz += weight * n.x * n.z;
+    xw += weight * n.x * d;
+    yy += weight * n.y * n.y;
+    yz += weight * n.y * n.z;
+    yw += weight * n.y * d;
+    zz += weight * n.z * n.z;
+    zw += weight * n.z * d;
+    ww += weight * d * d;
+  }
+
+  void operator+=(const Quadric &q) {
+    xx += q.xx, xy += q.xy, xz += q.xz, xw += q.xw, yy += q.yy;
+    yz += q.yz, yw += q.yw, zz += q.zz, zw += q.zw, ww += q.ww;
+  }
+
+  // Obtains the error of a point
+  double Evaluate(glm::dvec3 p) const {
+    return xx * p.x * p.x + 2 * xy * p.x * p.y + 2 * xz * p.x * p.z +
+           2 * xw * p.x + yy * p.y * p.y + 2 * yz * p.y * p.z + 2 * yw * p.y +
+           zz * p.z * p.z + 2 * zw * p.z + ww;
+  }
+};
+
+// Collapse of the from vertex onto the to vertex
+struct Collapse {
+  unsigned int from;
+  unsigned int to;
+  double error;
+};
+
+// Computes the bounding sphere and the normal cone of the triangles of a
+// meshlet
+void ComputeMeshletBounds(const float *positions, const float *normals,
+                          const unsigned int *indices, Meshlet *meshlet) {
+  auto position = [&](unsigned int vertex) {
+    return glm::vec3(positions[3 * vertex], positions[3 * vertex + 1],
+                     positions[3 * vertex + 2]);
+  };
+  auto normal = [&](unsigned int vertex) {
+    return glm::vec3(normals[3 * vertex], normals[3 * vertex + 1],
+                     normals[3 * vertex + 2]);
+  };
+
+  int begin = meshlet->first_index;
+  int end = begin + meshlet->n_indices;
+  glm::vec3 min(INFINITY), max(-INFINITY);
+  for (int i = begin; i < end; ++i) {
+    min = glm::min(min, position(indices[i]));
+    max = glm::max(max, position(indices[i]));
+  }
+  glm::vec3 center = (min + max) / 2.0f;
+  float radius = 0;
+  for (int i = begin; i < end; ++i)
+    radius = std::max(radius, glm::distance(center, position(indices[i])));
+  meshlet->sphere = glm::vec4(center, radius);
+
+  std::vector<glm::vec3> faces;
+  glm::vec3 sum(0);
+  for (int i = begin; i < end; i += 3) {
+    auto p0 = position(indices[i]);
+    auto face = glm::cross(position(indices[i + 1]) - p0,
+                           position(indices[i + 2]) - p0);
+    float length = glm::length(face);
+    if (length == 0)
+      continue;
+    face /= length;
+    auto vertex_normals = normal(indices[i]) + normal(indices[i + 1]) +
+                          normal(indices[i + 2]);
+    if (glm::dot(face, vertex_normals) < 0)
+      face = -face;
+    faces.push_back(face);
+    sum += face;
+  }
+
+  // The cutoff is the sine of the widest angle between the axis and a face
+  // normal; wider than about 84 degrees the test can't cull anything useful
+  meshlet->cone = glm::vec4(0, 0, 0, 1);
+  if (glm::length(sum) == 0)
+    return;
+  auto axis = glm::normalize(sum);
+  float min_dot = 1;
+  for (auto &face : faces)
+    min_dot = std::min(min_dot, glm::dot(axis, face));
+  if (min_dot > 0.1f)
+    meshlet->cone = glm::vec4(axis, std::sqrt(1 - min_dot * min_dot));
+}
+
+// Moves the vertices of an attribute with n components each to their new
+// index, dropping the unused ones; skips attributes of another vertex count
+template <typename T>
+void RemapVertices(std::vector<T> *attribute, int n_components,
+                   const std::vector<unsigned int> &remap) {
+  if (attribute->size() != n_components * remap.size())
+    return;
+  std::vector<T> reordered(attribute->size());
+  size_t n_used = 0;
+  for (size_t v = 0; v < remap.size(); ++v) {
+    if (remap[v] == ~0u)
+      continue;
+    std::copy_n(&(*attribute)[n_components * v], n_components,
+                &reordered[n_components * remap[v]]);
+    n_used++;
+  }
+  reordered.resize(n_components * n_used);
+  attribute->swap(reordered);
+}
+
+}  // namespace
+
+std::vector<int> OptimizeVertexCache(std::vector<unsigned int> *indices,
+                                     int n_vertices, int cache_size) {
+  int n_triangles = indices->size() / 3;
+
+  // Triangles that use each vertex, the ones of vertex v starting at
+  // offsets[v]
+  std::vector<int> offsets(n_vertices + 1, 0);
+  for (auto vertex : *indices)
+    offsets[vertex + 1]++;
+  for (int v = 0; v < n_vertices; ++v)
+    offsets[v + 1] += offsets[v];
+  std::vector<int> adjacency(indices->size());
+  std::vector<int> fill(offsets.begin(), offsets.end() - 1);
+  for (size_t i = 0; i < indices->size(); ++i)
+    adjacency[fill[(*indices)[i]]++] = i / 3;
+
+  // Tipsify: fans around a vertex, then moves to the emitted vertex with
+  // triangles left that will still be in the cache after fanning around it
+  std::vector<int> live(n_vertices);
+  for (int v = 0; v < n_vertices; ++v)
+    live[v] = offsets[v + 1] - offsets[v];
+  std::vector<int> cache_time(n_vertices, 0);
+  std::vector<bool> emitted(n_triangles, false);
+  std::vector<unsigned int> dead_ends;
+  std::vector<unsigned int> output;
+  std::vector<int> boundaries;
+  output.reserve(indices->size());
+  int time = cache_size + 1;
+  int cursor = 0;
+  int fan = SkipDeadEnd(live, &dead_ends, &cursor);
+  while (fan >= 0) {
+    std::vector<unsigned int> candidates;
+    for (int a = offsets[fan]; a < offsets[fan + 1]; ++a) {
+      int triangle = adjacency[a];
+      if (emitted[triangle])
+        continue;
+      for (int k = 0; k < 3; ++k) {
+        unsigned int vertex = (*indices)[3 * triangle + k];
+        output.push_back(vertex);
+        dead_ends.push_back(vertex);
+        candidates.push_back(vertex);
+        live[vertex]--;
+        if (time - cache_time[vertex] > cache_size)
+          cache_time[vertex] = time++;
+      }
+      emitted[triangle] = true;
+    }
+
+    fan = -1;
+    int best = -1;
+    for (auto vertex : candidates) {
+      if (live[vertex] <= 0)
+        continue;
+      int age = time - cache_time[vertex];
+      int priority = age + 2 * live[vertex] <= cache_size ? age : 0;
+      if (priority > best) {
+        best = priority;
+        fan = vertex;
+      }
+    }
+    if (fan < 0) {
+      boundaries.push_back(output.size());
+      fan = SkipDeadEnd(live, &dead_ends, &cursor);
+    }
+  }
+
+  indices->swap(output);
+  return MergeClusters(*indices, boundaries, n_vertices, cache_size);
+}
+
+void OptimizeOverdraw(const float *positions,
+                      std::vector<unsigned int> *indices,
+                      const std::vector<int> &clusters) {
+  struct Cluster {
+    int begin;
+    int end;
+    glm::vec3 centroid;
+    glm::vec3 normal;  // sum of the face normals, weighted by their area
+    float occlusion;
+  };
+
+  auto position = [&](unsigned int vertex) {
+    return glm::vec3(positions[3 * vertex], positions[3 * vertex + 1],
+                     positions[3 * vertex + 2]);
+  };
+
+  std::vector<Cluster> sorted;
+  glm::vec3 mesh_centroid(0);
+  for (size_t c = 0; c < clusters.size(); ++c) {
+    int end = c + 1 < clusters.size() ? clusters[c + 1] : indices->size();
+    Cluster cluster = {clusters[c], end, glm::vec3(0), glm::vec3(0), 0};
+    for (int i = cluster.begin; i < cluster.end; i += 3) {
+      auto p0 = position((*indices)[i]);
+      auto p1 = position((*indices)[i + 1]);
+      auto p2 = position((*indices)[i + 2]);
+      cluster.centroid += p0 + p1 + p2;
+      cluster.normal += glm::cross(p1 - p0, p2 - p0);
+    }
+    mesh_centroid += cluster.centroid;
+    cluster.centroid /= std::max(end - cluster.begin, 1);
+    sorted.push_back(cluster);
+  }
+  mesh_centroid /= std::max<size_t>(indices->size(), 1);
+
+  // Clusters on the outside and facing away from the center hide the most
+  for (auto &cluster : sorted) {
+    float length = glm::length(cluster.normal);
+    if (length > 0)
+      cluster.occlusion = glm::dot(cluster.centroid - mesh_centroid,
+                                   cluster.normal / length);
+  }
+  std::stable_sort(sorted.begin(), sorted.end(),
+                   [](const Cluster &a, const Cluster &b) {
+                     return a.occlusion > b.occlusion;
+                   });
+
+  std::vector<unsigned int> output;
+  output.reserve(indices->size());
+  for (auto &cluster : sorted)
+    output.insert(output.end(), indices->begin() + cluster.begin,
+                  indices->begin() + cluster.end);
+  indices->swap(output);
+}
+
+std::vector<unsigned int> OptimizeVertexFetch(
+    std::vector<unsigned int> *indices, int n_vertices) {
+  std::vector<unsigned int> remap(n_vertices, ~0u);
+  unsigned int n_used = 0;
+  for (auto &vertex : *indices) {
+    if (remap[vertex] == ~0u)
+      remap[vertex] = n_used++;
+    vertex = remap[vertex];
+  }
+  return remap;
+}
+
+void OptimizeMesh(std::vector<float> *positions, std::vector<float> *normals,
+                  std::vector<unsigned int> *indices,
+                  std::vector<float> *texcoords,
+                  std::vector<int> *materials) {
+  int n_vertices = positions->size() / 3;
+  auto clusters = OptimizeVertexCache(indices, n_vertices);
+  OptimizeOverdraw(positions->data(), indices, clusters);
+  auto remap = OptimizeVertexFetch(indices, n_vertices);
+
+  for (auto attribute : {positions, normals})
+    RemapVertices(attribute, 3, remap);
+  if (texcoords)
+    RemapVertices(texcoords, 2, remap);
+  if (materials)
+    RemapVertices(materials, 1, remap);
+}
+
+std::vector<unsigned int> SimplifyMesh(const float *positions, int n_vertices,
+                                       const std::vector<unsigned int> &indices,
+                                       int target_n_indices) {
+  auto position = [&](unsigned int vertex) {
+    return glm::dvec3(positions[3 * vertex], positions[3 * vertex + 1],
+                      positions[3 * vertex + 2]);
+  };
+
+  // Merges the vertices split by their normals, so the seams can collapse
+  std::map<std::tuple<float, float, float>, unsigned int> welded;
+  std::vector<unsigned int> remap(n_vertices);
+  for (int v = 0; v < n_vertices; ++v) {
+    auto key = std::make_tuple(positions[3 * v], positions[3 * v + 1],
+                               positions[3 * v + 2]);
+    remap[v] = welded.insert({key, v}).first->second;
+  }
+  std::vector<unsigned int> result;
+  for (auto vertex : indices)
+    result.push_back(remap[vertex]);
+
+  // The quadric of each vertex starts with the planes of its triangles,
+  // weighted by their area
+  std::vector<Quadric> quadrics(n_vertices, Quadric());
+  for (size_t i = 0; i < result.size(); i += 3) {
+    auto p0 = position(result[i]);
+    auto normal =
+        glm::cross(position(result[i + 1]) - p0, position(result[i + 2]) - p0);
+    double area = glm::length(normal);
+    if (area == 0)
+      continue;
+    normal /= area;
+    for (int k = 0; k < 3; ++k)
+      quadrics[result[i + k]].AddPlane(normal, -glm::dot(normal, p0),
+                                       area / 2);
+  }
+
+  // An edge in a single triangle is on a border, whose vertices are locked
+  std::map<std::pair<unsigned int, unsigned int>, int> edges;
+  for (size_t i = 0; i < result.size(); i += 3)
+    for (int k = 0; k < 3; ++k) {
+      unsigned int a = result[i + k], b = result[i + (k + 1) % 3];
+      edges[{std::min(a, b), std::max(a, b)}]++;
+    }
+  std::vector<bool> locked(n_vertices, false);
+  for (auto &edge : edges)
+    if (edge.second == 1)
+      locked[edge.first.first] = locked[edge.first.second] = true;
+
+  // Each pass collapses the cheapest independent edges
+  while ((int)result.size() > target_n_indices) {
+    std::vector<int> offsets(n_vertices + 1, 0);
+    for (auto vertex : result)
+      offsets[vertex + 1]++;
+    for (int v = 0; v < n_vertices; ++v)
+      offsets[v + 1] += offsets[v];
+    std::vector<int> adjacency(result.size());
+    std::vector<int> fill(offsets.begin(), offsets.end() - 1);
+    for (size_t i = 0; i < result.size(); ++i)
+      adjacency[fill[result[i]]++] = i / 3;
+
+    std::vector<Collapse> collapses;
+    for (size_t i = 0; i < result.size(); i += 3)
+      for (int k = 0; k < 3; ++k) {
+        unsigned int a = result[i + k], b = result[i + (k + 1) % 3];
+        Quadric q = quadrics[a];
+        q += quadrics[b];
+        if (!locked[a])
+          collapses.push_back({a, b, q.Evaluate(position(b))});
+        if (!locked[b])
+          collapses.push_back({b, a, q.Evaluate(position(a))});
+      }
+    std::sort(collapses.begin(), collapses.end(),
+              [](const Collapse &a, const Collapse &b) {
+                return a.error < b.error;
+              });
+
+    // A collapse moves the triangles around its from vertex, so the vertices
+    // of those triangles can't move again in the same pass
+    std::vector<bool> touched(n_vertices, false);
+    int n_removed = 0;
+    int max_removed = (result.size() - target_n_indices + 2) / 3;
+    for (auto &collapse : collapses) {
+      if (n_removed >= max_removed)
+        break;
+      unsigned int from = collapse.from, to = collapse.to;
+      if (touched[from] || touched[to])
+        continue;
+      bool flips = false;
+      int n_shared = 0;
+      for (int a = offsets[from]; a < offsets[from + 1] && !flips; ++a) {
+        const unsigned int *t = &result[3 * adjacency[a]];
+        if (t[0] == to || t[1] == to || t[2] == to) {
+          n_shared++;
+          continue;
+        }
+        glm::dvec3 p[3], moved[3];
+        for (int k = 0; k < 3; ++k) {
+          p[k] = position(t[k]);
+          moved[k] = t[k] == from ? position(to) : p[k];
+        }
+        auto before = glm::cross(p[1] - p[0], p[2] - p[0]);
+        auto after = glm::cross(moved[1] - moved[0], moved[2] - moved[0]);
+        flips = glm::dot(before, after) <= 0;
+      }
+      if (flips)
+        continue;
+      for (int a = offsets[from]; a < offsets[from + 1]; ++a)
+        for (int k = 0; k < 3; ++k)
+          touched[result[3 * adjacency[a] + k]] = true;
+      remap[from] = to;
+      quadrics[to] += quadrics[from];
+      n_removed += n_shared;
+    }
+    if (n_removed == 0)
+      break;
+
+    // Drops the triangles collapsed into edges
+    std::vector<unsigned int> collapsed;
+    for (size_t i = 0; i < result.size(); i += 3) {
+      unsigned int t[3];
+      for (int k = 0; k < 3; ++k)
+        t[k] = remap[result[i + k]];
+      if (t[0] != t[1] && t[1] != t[2] && t[2] != t[0])
+        collapsed.insert(collapsed.end(), t, t + 3);
+    }
+    result.swap(collapsed);
+  }
+  return result;
+}
+
+std::vector<Meshlet> BuildMeshlets(const float *positions,
+                                   const float *normals,
+                                   const unsigned int *indices, int n_indices,
+                                   int max_vertices, int max_triangles) {
+  std::vector<Meshlet> meshlets;
+  std::vector<unsigned int> vertices;  // distinct ones of the open meshlet
+  int first_index = 0;
+  auto close_meshlet = [&](int end) {
+    Meshlet meshlet = {first_index, end - first_index, glm::vec4(0),
+                       glm::vec4(0)};
+    ComputeMeshletBounds(positions, normals, indices, &meshlet);
+    meshlets.push_back(meshlet);
+    vertices.clear();
+    first_index = end;
+  };
+
+  // Vertices of triangle i that the open meshlet doesn't have yet
+  auto find_new_vertices = [&](int i) {
+    std::vector<unsigned int> added;
+    for (int j = 0; j < 3; ++j) {
+      auto vertex = indices[i + j];
+      if (std::find(vertices.begin(), vertices.end(), vertex) ==
+              vertices.end() &&
+          std::find(added.begin(), added.end(), vertex) == added.end())
+        added.push_back(vertex);
+    }
+    return added;
+  };
+
+  for (int i = 0; i + 2 < n_indices; i += 3) {
+    auto added = find_new_vertices(i);
+    if (vertices.size() + added.size() > (size_t)max_vertices ||
+        (i - first_index) / 3 >= max_triangles) {
+      close_meshlet(i);
+      added = find_new_vertices(i);
+    }
+    vertices.insert(vertices.end(), added.begin(), added.end());
+  }
+  if (first_index < n_indices - n_indices % 3)
+    close_meshlet(n_indices - n_indices % 3);
+  return meshlets;
+}
+
+float ComputeAcmr(const std::vector<unsigned int> &indices, int n_vertices,
+                  int cache_size) {
+  if (indices.empty())
+    return 0;
+  FifoCache cache(n_vertices, cache_size);
+  int misses = 0;
+  for (auto vertex : indices)
+    misses += cache.Fetch(vertex);
+  return misses / (indices.size() / 3.0f);
+}
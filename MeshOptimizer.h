@@ -0,0 +1,120 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef MESHOPTIMIZER_H
+#define MESHOPTIMIZER_H
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+/**
+ * Load-time reordering and simplification of triangle meshes
+ *
+ * The triangles are first ordered for the post-transform vertex cache with
+ * Tipsify (Sander, Nehab and Barczak, 2007), which also splits them into
+ * clusters; the clusters are then sorted so the ones that occlude the most
+ * are drawn first, and at last the vertices are renumbered in the order the
+ * triangles fetch them. Indices follow the triangle lists of MeshBatch.
+ */
+
+/**
+ * Run of consecutive triangles of a mesh, with its bounds for culling
+ */
+struct Meshlet {
+  int first_index;  // in the indices of the mesh
+  int n_indices;
+  glm::vec4 sphere;  // bounding sphere, center in xyz and radius in w
+  glm::vec4 cone;    // normal cone, axis in xyz and cutoff in w (see below)
+};
+
+/**
+ * Orders the triangles for a fifo vertex cache of the given size
+ * Returns the first index of each cluster, breaking the order at the points
+ * where no vertex in the cache had triangles left
+ */
+std::vector<int> OptimizeVertexCache(std::vector<unsigned int> *indices,
+                                     int n_vertices, int cache_size = 16);
+
+/**
+ * Sorts the clusters of OptimizeVertexCache by how much they may occlude the
+ * rest of the mesh: outwards facing and far from its center first
+ * The positions have 3 floats per vertex
+ */
+void OptimizeOverdraw(const float *positions,
+                      std::vector<unsigned int> *indices,
+                      const std::vector<int> &clusters);
+
+/**
+ * Renumbers the vertices in the order the triangles first use them
+ * Returns the new index of each vertex, ~0u for the unused ones
+ */
+std::vector<unsigned int> OptimizeVertexFetch(
+    std::vector<unsigned int> *indices, int n_vertices);
+
+/**
+ * Applies every step above to a mesh with 3 floats per position and per
+ * normal, and optionally 2 per texture coordinate and a material per vertex,
+ * dropping the unused vertices
+ */
+void OptimizeMesh(std::vector<float> *positions, std::vector<float> *normals,
+                  std::vector<unsigned int> *indices,
+                  std::vector<float> *texcoords = nullptr,
+                  std::vector<int> *materials = nullptr);
+
+/**
+ * Simplifies a mesh by quadric error edge collapses (Garland and Heckbert,
+ * 1997) until it has at most target_n_indices, or no edge can collapse
+ * without flipping a triangle; the vertices on open borders stay in place
+ * The positions have 3 floats per vertex. The result indexes the same
+ * vertices; those with the same position are merged, keeping the first
+ */
+std::vector<unsigned int> SimplifyMesh(const float *positions, int n_vertices,
+                                       const std::vector<unsigned int> &indices,
+                                       int target_n_indices);
+
+/**
+ * Splits the triangles of a mesh, in their order, into meshlets of at most
+ * max_vertices distinct vertices and max_triangles triangles (the sizes of
+ * the mesh shader outputs)
+ * The positions and the normals have 3 floats per vertex. The faces are
+ * oriented by the normals of their vertices rather than by their winding.
+ * Every triangle of a meshlet faces away from an eye when
+ * dot(center - eye, axis) >= cutoff * distance(center, eye) + radius; the
+ * cutoff is 1 when the normals spread too far for the test to ever pass
+ */
+std::vector<Meshlet> BuildMeshlets(const float *positions,
+                                   const float *normals,
+                                   const unsigned int *indices, int n_indices,
+                                   int max_vertices = 64,
+                                   int max_triangles = 124);
+
+/**
+ * Obtains the average number of vertex shader runs per triangle with a fifo
+ * cache of the given size
+ */
+float ComputeAcmr(const std::vector<unsigned int> &indices, int n_vertices,
+                  int cache_size = 16);
+
+#endif
@@ -0,0 +1,124 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+#include <glm/glm.hpp>
+
+#include "NormalEncoding.h"
+
+namespace {
+
+struct EncodingInfo {
+  const char* name;
+  int size;
+};
+
+const EncodingInfo ENCODINGS[] = {
+    {"rgb32f", 12}, {"rg16f", 4}, {"rg16snorm", 4},
+};
+
+glm::vec2 SignNotZero(glm::vec2 v) {
+  return glm::vec2(v.x >= 0 ? 1 : -1, v.y >= 0 ? 1 : -1);
+}
+
+}  // namespace
+
+const char* GetNormalEncodingName(NormalEncoding encoding) {
+  return ENCODINGS[encoding].name;
+}
+
+bool ParseNormalEncoding(const char* name, NormalEncoding* encoding) {
+  for (int i = 0; i < N_NORMAL_ENCODINGS; ++i) {
+    if (!strcmp(name, ENCODINGS[i].name)) {
+      *encoding = (NormalEncoding)i;
+      return true;
+    }
+  }
+  return false;
+}
+
+int GetNormalEncodingSize(NormalEncoding encoding) {
+  return ENCODINGS[encoding].size;
+}
+
+glm::vec2 EncodeOctahedral(glm::vec3 n) {
+  n /= std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+  auto e = glm::vec2(n);
+  if (n.z < 0)
+    e = (1.0f - glm::abs(glm::vec2(e.y, e.x))) * SignNotZero(e);
+  return e;
+}
+
+glm::vec3 DecodeOctahedral(glm::vec2 e) {
+  auto n = glm::vec3(e, 1.0f - std::abs(e.x) - std::abs(e.y));
+  if (n.z < 0) {
+    auto wrapped = (1.0f - glm::abs(glm::vec2(n.y, n.x))) * SignNotZero(e);
+    n.x = wrapped.x;
+    n.y = wrapped.y;
+  }
+  return glm::normalize(n);
+}
+
+glm::vec3 RoundTripNormal(NormalEncoding encoding, glm::vec3 n) {
+  switch (encoding) {
+    case NORMALS_RG16F:
+      return DecodeOctahedral(
+          glm::unpackHalf2x16(glm::packHalf2x16(EncodeOctahedral(n))));
+    case NORMALS_RG16_SNORM:
+      return DecodeOctahedral(
+          glm::unpackSnorm2x16(glm::packSnorm2x16(EncodeOctahedral(n))));
+    default:
+      return n;
+  }
+}
+
+void PrintNormalEncodingReport() {
+  // Tests directions evenly distributed over the sphere (fibonacci lattice)
+  const int n_samples = 200000;
+  const double golden_angle = M_PI * (3.0 - std::sqrt(5.0));
+  printf("%-10s %6s %14s %14s\n", "encoding", "bytes", "mean err (deg)",
+         "max err (deg)");
+  for (int i = 0; i < N_NORMAL_ENCODINGS; ++i) {
+    auto encoding = (NormalEncoding)i;
+    double sum = 0, max = 0;
+    for (int j = 0; j < n_samples; ++j) {
+      double z = 1 - (2.0 * j + 1) / n_samples;
+      double r = std::sqrt(1 - z * z);
+      double phi = golden_angle * j;
+      auto n = glm::vec3(r * std::cos(phi), r * std::sin(phi), z);
+      auto a = glm::dvec3(n);
+      auto b = glm::dvec3(RoundTripNormal(encoding, n));
+      double angle = std::atan2(glm::length(glm::cross(a, b)), glm::dot(a, b));
+      double err = angle * 180.0 / M_PI;
+      sum += err;
+      max = std::max(max, err);
+    }
+    printf("%-10s %6d %14.5f %14.5f\n", GetNormalEncodingName(encoding),
+           GetNormalEncodingSize(encoding), sum / n_samples, max);
+  }
+}
@@ -0,0 +1,76 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef NORMALENCODING_H
+#define NORMALENCODING_H
+
+#include <glm/glm.hpp>
+
+/**
+ * Formats used to store the normals in the G-buffer
+ */
+enum NormalEncoding {
+  NORMALS_RGB32F,      // Raw normal, 12 bytes per pixel
+  NORMALS_RG16F,       // Octahedral normal in half floats, 4 bytes per pixel
+  NORMALS_RG16_SNORM,  // Octahedral normal in 16 bits snorm, 4 bytes per pixel
+  N_NORMAL_ENCODINGS
+};
+
+/**
+ * Obtains the encoding name used in the command line ("rgb32f", ...)
+ */
+const char* GetNormalEncodingName(NormalEncoding encoding);
+
+/**
+ * Obtains the encoding given its name, returns false if it doesn't exist
+ */
+bool ParseNormalEncoding(const char* name, NormalEncoding* encoding);
+
+/**
+ * Obtains the number of bytes per pixel used by the encoding
+ */
+int GetNormalEncodingSize(NormalEncoding encoding);
+
+/**
+ * Octahedral mapping of an unit vector to [-1, 1]^2
+ * Mirrors encode_octahedral in the shaders
+ */
+glm::vec2 EncodeOctahedral(glm::vec3 n);
+
+/**
+ * Inverse of EncodeOctahedral
+ */
+glm::vec3 DecodeOctahedral(glm::vec2 e);
+
+/**
+ * Simulates the storage of a normal in the G-buffer
+ */
+glm::vec3 RoundTripNormal(NormalEncoding encoding, glm::vec3 n);
+
+/**
+ * Prints the angular error and size of each encoding
+ */
+void PrintNormalEncodingReport();
+
+#endif
@@ -0,0 +1,592 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <stdexcept>
+#include <thread>
+
+#include <glm/glm.hpp>
+
+#include "ObjLoader.h"
+#include "ParallelFor.h"
+
+namespace {
+
+// Smallest chunk parsed by its own thread, in bytes
+const size_t MIN_CHUNK_SIZE = 1 << 20;
+
+// Position, normal and texture coordinate indices of a vertex, -1 for the
+// missing ones
+struct VertexKey {
+  int position;
+  int normal;
+  int texcoord;
+
+  bool operator==(const VertexKey& other) const {
+    return position == other.position && normal == other.normal &&
+           texcoord == other.texcoord;
+  }
+  bool operator!=(const VertexKey& other) const { return !(*this == other); }
+};
+
+// Key of the free slots of VertexCache
+const VertexKey EMPTY_KEY = {-1, -1, -1};
+
+// Open addressing hash table from the indices of a corner to the vertex of
+// the mesh, with linear probing
+class VertexCache {
+public:
+  VertexCache()
+      : size_(0), shift_(64 - 10), keys_(1 << 10, EMPTY_KEY),
+        values_(1 << 10) {}
+
+  // Finds the vertex of a key, or inserts the one given
+  // Returns whether the key was new
+  bool FindOrInsert(const VertexKey& key, unsigned int* vertex) {
+    if (2 * (size_ + 1) > keys_.size())
+      Grow();
+    auto slot = Find(key);
+    if (keys_[slot] == key) {
+      *vertex = values_[slot];
+      return false;
+    }
+    keys_[slot] = key;
+    values_[slot] = *vertex;
+    size_++;
+    return true;
+  }
+
+private:
+  // Obtains the slot of a key, or the empty one where it would go
+  size_t Find(const VertexKey& key) {
+    size_t mask = keys_.size() - 1;
+    uint64_t hash =
+        ((uint64_t)key.position << 32 | (uint32_t)key.normal) ^
+        (uint64_t)(uint32_t)key.texcoord * 0xC2B2AE3D27D4EB4Full;
+    size_t slot = (hash * 0x9E3779B97F4A7C15ull) >> shift_;
+    while (keys_[slot] != EMPTY_KEY && keys_[slot] != key)
+      slot = (slot + 1) & mask;
+    return slot;
+  }
+
+  // Doubles the capacity, keeping the load under one half
+  void Grow() {
+    std::vector<VertexKey> keys(2 * keys_.size(), EMPTY_KEY);
+    std::vector<unsigned int> values(keys.size());
+    keys.swap(keys_);
+    values.swap(values_);
+    shift_--;
+    for (size_t i = 0; i < keys.size(); ++i) {
+      if (keys[i] != EMPTY_KEY) {
+        auto slot = Find(keys[i]);
+        keys_[slot] = keys[i];
+        values_[slot] = values[i];
+      }
+    }
+  }
+
+  size_t size_;
+  int shift_;
+  std::vector<VertexKey> keys_;
+  std::vector<unsigned int> values_;
+};
+
+// Reads a whole file
+std::string ReadFile(const std::string& path) {
+  std::ifstream input(path, std::ios::binary | std::ios::ate);
+  if (!input.is_open())
+    throw std::runtime_error("Unable to open file: " + path);
+  std::string contents(input.tellg(), '\0');
+  input.seekg(0);
+  input.read(&contents[0], contents.size());
+  if (!input)
+    throw std::runtime_error("Unable to read file: " + path);
+  return contents;
+}
+
+// Skips the spaces and tabs
+const char* SkipSpaces(const char* p) {
+  while (*p == ' ' || *p == '\t')
+    p++;
+  return p;
+}
+
+// Skips to the start of the next line
+const char* SkipLine(const char* p) {
+  while (*p && *p != '\n')
+    p++;
+  return *p ? p + 1 : p;
+}
+
+// Parses an integer with an optional sign, returns the end of it
+// The value is left at zero if there are no digits
+const char* ParseInt(const char* p, int* value) {
+  bool negative = *p == '-';
+  if (*p == '-' || *p == '+')
+    p++;
+  int result = 0;
+  while (*p >= '0' && *p <= '9')
+    result = 10 * result + (*p++ - '0');
+  *value = negative ? -result : result;
+  return p;
+}
+
+// Parses a decimal number with optional fraction and exponent, returns the
+// end of it
+// Unlike strtod it ignores the locale and doesn't round exactly, which is
+// far below the precision of the floats it is stored in
+const char* ParseFloat(const char* p, float* value) {
+  static const double POWERS[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,
+                                  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                                  1e12, 1e13, 1e14, 1e15, 1e16, 1e17,
+                                  1e18, 1e19, 1e20, 1e21, 1e22};
+  bool negative = *p == '-';
+  if (*p == '-' || *p == '+')
+    p++;
+
+  // Up to 19 significant digits fit the mantissa, the rest only scale it
+  uint64_t mantissa = 0;
+  int digits = 0;
+  int exponent = 0;
+  for (; *p >= '0' && *p <= '9'; ++p) {
+    if (digits < 19) {
+      mantissa = 10 * mantissa + (*p - '0');
+      digits += mantissa != 0;
+    } else {
+      exponent++;
+    }
+  }
+  if (*p == '.') {
+    for (++p; *p >= '0' && *p <= '9'; ++p) {
+      if (digits < 19) {
+        mantissa = 10 * mantissa + (*p - '0');
+        digits += mantissa != 0;
+        exponent--;
+      }
+    }
+  }
+  if (*p == 'e' || *p == 'E') {
+    int power;
+    p = ParseInt(p + 1, &power);
+    exponent += power;
+  }
+
+  double result = (double)mantissa;
+  if (exponent >= -22 && exponent <= 22)
+    result = exponent < 0 ? result / POWERS[-exponent]
+                          : result * POWERS[exponent];
+  else
+    result *= std::pow(10.0, exponent);
+  *value = (float)(negative ? -result : result);
+  return p;
+}
+
+// Reads the rest of a line as a name, without the surrounding spaces
+std::string ReadName(const char* p) {
+  p = SkipSpaces(p);
+  auto end = p;
+  while (*end && *end != '\n')
+    end++;
+  while (end > p && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r'))
+    end--;
+  return std::string(p, end);
+}
+
+// Obtains where the values of a keyword followed by a space start, nullptr
+// if the line starts with something else
+const char* MatchKeyword(const char* p, const char* keyword) {
+  size_t length = strlen(keyword);
+  if (strncmp(p, keyword, length) != 0 ||
+      (p[length] != ' ' && p[length] != '\t'))
+    return nullptr;
+  return p + length + 1;
+}
+
+// Parses the n floats of a position, a normal or a texture coordinate
+const char* ParseVector(const char* p, float* vector, int n = 3) {
+  for (int i = 0; i < n; ++i)
+    p = ParseFloat(SkipSpaces(p), &vector[i]);
+  return p;
+}
+
+// Converts a one-based or negative (relative to the end) OBJ index to a
+// zero-based one, -1 if it's out of range
+int ResolveIndex(int index, int n) {
+  if (index < 0)
+    index += n;
+  else
+    index -= 1;
+  return index >= 0 && index < n ? index : -1;
+}
+
+// Records of the file that are read
+enum Record {
+  POSITION_RECORD,
+  NORMAL_RECORD,
+  TEXCOORD_RECORD,
+  FACE_RECORD,
+  MATERIAL_RECORD,  // usemtl
+  LIBRARY_RECORD,   // mtllib
+  OTHER_RECORD
+};
+
+// Obtains the record of a line, and where its values start
+Record ReadRecord(const char* line, const char** values) {
+  auto p = SkipSpaces(line);
+  if (p[0] == 'v' && p[1] == ' ') {
+    *values = p + 2;
+    return POSITION_RECORD;
+  } else if (p[0] == 'v' && p[1] == 'n' && p[2] == ' ') {
+    *values = p + 3;
+    return NORMAL_RECORD;
+  } else if (p[0] == 'v' && p[1] == 't' && p[2] == ' ') {
+    *values = p + 3;
+    return TEXCOORD_RECORD;
+  } else if (p[0] == 'f' && p[1] == ' ') {
+    *values = p + 2;
+    return FACE_RECORD;
+  } else if ((*values = MatchKeyword(p, "usemtl"))) {
+    return MATERIAL_RECORD;
+  } else if ((*values = MatchKeyword(p, "mtllib"))) {
+    return LIBRARY_RECORD;
+  }
+  return OTHER_RECORD;
+}
+
+// Material of the faces that don't name a known one
+ObjMaterial GetDefaultMaterial() {
+  return {{0.8f, 0.8f, 0.8f}, {0.2f, 0.2f, 0.2f}, {0, 0, 0}, 1};
+}
+
+// Material of an MTL file with the path of its diffuse map, if any
+struct MaterialDefinition {
+  ObjMaterial material;
+  std::string texture;
+};
+
+// Obtains the directory of a path, with the trailing slash
+std::string GetDirectory(const std::string& path) {
+  return path.substr(0, path.find_last_of('/') + 1);
+}
+
+// Reads the materials of an MTL file, by name
+void LoadMaterialLibrary(
+    const std::string& path,
+    std::map<std::string, MaterialDefinition>* definitions) {
+  auto contents = ReadFile(path);
+  MaterialDefinition* definition = nullptr;
+  for (auto p = contents.c_str(); *p; p = SkipLine(p)) {
+    auto line = SkipSpaces(p);
+    const char* values;
+    if ((values = MatchKeyword(line, "newmtl"))) {
+      definition = &(*definitions)[ReadName(values)];
+      definition->material = GetDefaultMaterial();
+      definition->texture.clear();
+      continue;
+    } else if (!definition) {
+      continue;
+    }
+    auto material = &definition->material;
+    if ((values = MatchKeyword(line, "Kd"))) {
+      ParseVector(values, material->diffuse);
+    } else if ((values = MatchKeyword(line, "Ka"))) {
+      ParseVector(values, material->ambient);
+    } else if ((values = MatchKeyword(line, "Ks"))) {
+      ParseVector(values, material->specular);
+    } else if ((values = MatchKeyword(line, "Ns"))) {
+      ParseFloat(SkipSpaces(values), &material->shininess);
+    } else if ((values = MatchKeyword(line, "map_Kd"))) {
+      // The options come before the file name, which is the last word
+      auto name = ReadName(values);
+      auto space = name.find_last_of(" \t");
+      if (space != std::string::npos)
+        name = name.substr(space + 1);
+      definition->texture = GetDirectory(path) + name;
+    }
+  }
+}
+
+// Position, normal and texture coordinate indices of a triangle corner, -1
+// for the missing ones, and its material, -1 for the one in use at the start
+// of its chunk
+struct Corner {
+  int position;
+  int normal;
+  int texcoord;
+  int material;  // into the usemtl names of its chunk
+};
+
+// Lines of the file parsed by one thread, with the records before it
+struct Chunk {
+  const char* begin;
+  const char* end;
+  int n_positions;
+  int n_normals;
+  int n_texcoords;
+  int n_lines;
+  int first_position;  // prefix sums of the counts of the chunks before
+  int first_normal;
+  int first_texcoord;
+  int first_line;
+  std::vector<Corner> corners;  // 3 per triangle
+  std::vector<std::string> materials;  // names of its usemtl, in order
+  std::vector<std::string> libraries;  // of its mtllib
+  std::string error;  // of the first invalid face
+};
+
+// Counts the positions, the normals, the texture coordinates and the lines of
+// a chunk
+void CountRecords(Chunk* chunk) {
+  for (auto p = chunk->begin; p < chunk->end; p = SkipLine(p)) {
+    const char* values;
+    auto record = ReadRecord(p, &values);
+    chunk->n_positions += record == POSITION_RECORD;
+    chunk->n_normals += record == NORMAL_RECORD;
+    chunk->n_texcoords += record == TEXCOORD_RECORD;
+    chunk->n_lines++;
+  }
+}
+
+// Parses the records of a chunk, writing its vertex attributes at their place
+// in the arrays of the whole file and its faces as triangle fans of corners
+// with global indices
+// The materials are only named here, the previous chunks decide the one of
+// the faces before the first usemtl
+void ParseChunk(Chunk* chunk, float* positions, float* normals,
+                float* texcoords) {
+  int n_positions = chunk->first_position;
+  int n_normals = chunk->first_normal;
+  int n_texcoords = chunk->first_texcoord;
+  int line = chunk->first_line;
+  int material = -1;
+  std::vector<Corner> face;
+  for (auto p = chunk->begin; p < chunk->end; p = SkipLine(p), ++line) {
+    const char* values;
+    auto record = ReadRecord(p, &values);
+    if (record == POSITION_RECORD) {
+      ParseVector(values, &positions[3 * n_positions++]);
+    } else if (record == NORMAL_RECORD) {
+      ParseVector(values, &normals[3 * n_normals++]);
+    } else if (record == TEXCOORD_RECORD) {
+      ParseVector(values, &texcoords[2 * n_texcoords++], 2);
+    } else if (record == MATERIAL_RECORD) {
+      chunk->materials.push_back(ReadName(values));
+      material = chunk->materials.size() - 1;
+    } else if (record == LIBRARY_RECORD) {
+      // Several files may follow, separated by spaces
+      auto names = ReadName(values);
+      for (size_t begin = 0; begin < names.size();) {
+        auto end = std::min(names.find_first_of(" \t", begin), names.size());
+        if (end > begin)
+          chunk->libraries.push_back(names.substr(begin, end - begin));
+        begin = end + 1;
+      }
+    } else if (record == FACE_RECORD) {
+      // Each corner is v, v/vt, v//vn or v/vt/vn
+      face.clear();
+      for (p = SkipSpaces(values); *p && *p != '\n' && *p != '\r';
+           p = SkipSpaces(p)) {
+        int position, texcoord = 0, normal = 0;
+        p = ParseInt(p, &position);
+        if (*p == '/') {
+          p = ParseInt(p + 1, &texcoord);
+          if (*p == '/')
+            p = ParseInt(p + 1, &normal);
+        }
+        bool has_texcoord = texcoord != 0;
+        bool has_normal = normal != 0;
+        position = ResolveIndex(position, n_positions);
+        texcoord = has_texcoord ? ResolveIndex(texcoord, n_texcoords) : -1;
+        normal = has_normal ? ResolveIndex(normal, n_normals) : -1;
+        if (position < 0 || (has_texcoord && texcoord < 0) ||
+            (has_normal && normal < 0)) {
+          chunk->error = std::to_string(line);
+          return;
+        }
+        face.push_back({position, normal, texcoord, material});
+      }
+      for (size_t i = 2; i < face.size(); ++i)
+        chunk->corners.insert(chunk->corners.end(),
+                              {face[0], face[i - 1], face[i]});
+    }
+  }
+}
+
+// Splits a file in chunks of whole lines, one per hardware thread for large
+// files
+std::vector<Chunk> SplitChunks(const std::string& contents) {
+  int n_threads = std::max<int>(std::thread::hardware_concurrency(), 1);
+  int n_chunks = std::max<int>(
+      std::min<size_t>(n_threads, contents.size() / MIN_CHUNK_SIZE), 1);
+  std::vector<Chunk> chunks;
+  auto start = contents.c_str();
+  auto end = start + contents.size();
+  auto begin = start;
+  for (int i = 0; i < n_chunks && begin < end; ++i) {
+    // Moves the end to the start of the next line
+    auto chunk_end =
+        std::max(begin, start + contents.size() * (i + 1) / n_chunks);
+    while (chunk_end < end && chunk_end[-1] != '\n')
+      chunk_end++;
+    Chunk chunk = {};
+    chunk.begin = begin;
+    chunk.end = chunk_end;
+    chunks.push_back(chunk);
+    begin = chunk_end;
+  }
+  return chunks;
+}
+
+}  // namespace
+
+ObjMesh LoadObjMesh(const std::string& path) {
+  auto contents = ReadFile(path);
+
+  // The chunks are counted first, so each one starts parsing at the right
+  // place of the arrays and resolves the relative indices
+  auto chunks = SplitChunks(contents);
+  ParallelFor(chunks.size(), [&](int begin, int end) {
+    for (int i = begin; i < end; ++i)
+      CountRecords(&chunks[i]);
+  }, 1);
+  int n_positions = 0, n_normals = 0, n_texcoords = 0, n_lines = 1;
+  for (auto& chunk : chunks) {
+    chunk.first_position = n_positions;
+    chunk.first_normal = n_normals;
+    chunk.first_texcoord = n_texcoords;
+    chunk.first_line = n_lines;
+    n_positions += chunk.n_positions;
+    n_normals += chunk.n_normals;
+    n_texcoords += chunk.n_texcoords;
+    n_lines += chunk.n_lines;
+  }
+  std::vector<float> positions(3 * n_positions);
+  std::vector<float> normals(3 * n_normals);
+  std::vector<float> texcoords(2 * n_texcoords);
+  ParallelFor(chunks.size(), [&](int begin, int end) {
+    for (int i = begin; i < end; ++i)
+      ParseChunk(&chunks[i], positions.data(), normals.data(),
+                 texcoords.data());
+  }, 1);
+
+  ObjMesh mesh;
+  std::map<std::string, MaterialDefinition> library;
+  auto directory = GetDirectory(path);
+  for (auto& chunk : chunks) {
+    if (!chunk.error.empty())
+      throw std::runtime_error("Invalid index in " + path + ":" + chunk.error);
+    for (auto& name : chunk.libraries)
+      LoadMaterialLibrary(directory + name, &library);
+  }
+
+  // The materials get their ids in the order of their first usemtl, the
+  // unknown names and the faces before any usemtl the default material
+  std::map<std::string, int> material_ids;
+  std::vector<VertexCache> caches;  // of each material
+  auto find_material = [&](const std::string& name) -> int {
+    auto found = material_ids.find(name);
+    if (found != material_ids.end())
+      return found->second;
+    auto definition = library.find(name);
+    if (definition != library.end()) {
+      mesh.materials.push_back(definition->second.material);
+      mesh.textures.push_back(definition->second.texture);
+    } else {
+      mesh.materials.push_back(GetDefaultMaterial());
+      mesh.textures.emplace_back();
+    }
+    caches.emplace_back();
+    int id = mesh.materials.size() - 1;
+    material_ids[name] = id;
+    return id;
+  };
+
+  // The corners are deduplicated in the order of the file, so the vertices
+  // don't depend on the number of chunks
+  std::vector<bool> missing_normals;  // of each vertex of the mesh
+  bool any_missing_normal = false;
+  int material = -1;  // in use at the start of the chunk
+  for (auto& chunk : chunks) {
+    std::vector<int> ids;  // of the usemtl names of the chunk
+    for (auto& name : chunk.materials)
+      ids.push_back(find_material(name));
+    for (auto& corner : chunk.corners) {
+      if (corner.material < 0 && material < 0)
+        material = find_material("");
+      int id = corner.material >= 0 ? ids[corner.material] : material;
+      int texcoord = mesh.textures[id].empty() ? -1 : corner.texcoord;
+      unsigned int vertex = mesh.positions.size() / 3;
+      VertexKey key = {corner.position, corner.normal, texcoord};
+      if (caches[id].FindOrInsert(key, &vertex)) {
+        for (int i = 0; i < 3; ++i) {
+          mesh.positions.push_back(positions[3 * corner.position + i]);
+          mesh.normals.push_back(
+              corner.normal >= 0 ? normals[3 * corner.normal + i] : 0);
+        }
+        for (int i = 0; i < 2; ++i)
+          mesh.texcoords.push_back(
+              texcoord >= 0 ? texcoords[2 * texcoord + i] : 0);
+        mesh.material_ids.push_back(id);
+        missing_normals.push_back(corner.normal < 0);
+        any_missing_normal |= corner.normal < 0;
+      }
+      mesh.indices.push_back(vertex);
+    }
+    if (!ids.empty())
+      material = ids.back();
+    std::vector<Corner>().swap(chunk.corners);
+  }
+  if (!any_missing_normal)
+    return mesh;
+
+  // The corners without normals share a vertex per position, which sums the
+  // normals of its faces weighted by their areas
+  auto position = [&](unsigned int vertex) {
+    return glm::vec3(mesh.positions[3 * vertex],
+                     mesh.positions[3 * vertex + 1],
+                     mesh.positions[3 * vertex + 2]);
+  };
+  std::vector<glm::vec3> sums(missing_normals.size(), glm::vec3(0));
+  for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+    auto v0 = mesh.indices[i], v1 = mesh.indices[i + 1],
+         v2 = mesh.indices[i + 2];
+    auto face_normal = glm::cross(position(v1) - position(v0),
+                                  position(v2) - position(v0));
+    for (auto v : {v0, v1, v2})
+      sums[v] += face_normal;
+  }
+  for (size_t v = 0; v < missing_normals.size(); ++v) {
+    if (missing_normals[v] && glm::length(sums[v]) > 0) {
+      auto normal = glm::normalize(sums[v]);
+      for (int i = 0; i < 3; ++i)
+        mesh.normals[3 * v + i] = normal[i];
+    }
+  }
+  return mesh;
+}
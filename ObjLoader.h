@@ -0,0 +1,75 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef OBJLOADER_H
+#define OBJLOADER_H
+
+#include <string>
+#include <vector>
+
+/**
+ * Phong material of an MTL file
+ */
+struct ObjMaterial {
+  float diffuse[3];   // Kd
+  float ambient[3];   // Ka
+  float specular[3];  // Ks
+  float shininess;    // Ns
+};
+
+/**
+ * Triangle mesh of a Wavefront OBJ file, in the layout of MeshBatch::AddMesh
+ */
+struct ObjMesh {
+  std::vector<float> positions;   // 3 floats per vertex
+  std::vector<float> normals;     // 3 floats per vertex
+  std::vector<float> texcoords;   // 2 floats per vertex
+  std::vector<int> material_ids;  // of each vertex, into materials
+  std::vector<unsigned int> indices;
+  std::vector<ObjMaterial> materials;  // in the order of their first face
+  std::vector<std::string> textures;   // diffuse map of each, "" for none
+};
+
+/**
+ * Reads every face of an OBJ file into a single mesh, as triangle fans
+ *
+ * Large files are split at line boundaries into a chunk per hardware thread.
+ * The threads count the records of their chunks, then parse them into the
+ * arrays of the whole file at the offsets given by the prefix sums of the
+ * counts. The corners are deduplicated in a hash table, in the order of the
+ * file; the texture coordinates are only kept for materials with a diffuse
+ * map, so elsewhere corners that differ only in them share a vertex. Corners
+ * without a normal get the average of the face normals around their
+ * position. Every shape of the file goes into
+ * the same mesh: groups and objects are ignored, and the material of each
+ * face comes from the last usemtl, looked up in the mtllib files next to the
+ * OBJ. Corners of faces with different materials don't share vertices. Faces
+ * without a known material get a plain gray one. The paths of the diffuse
+ * maps are relative to the working directory, like the one of the OBJ.
+ * Throws runtime_error if a file can't be read or a face has an invalid
+ * index
+ */
+ObjMesh LoadObjMesh(const std::string& path);
+
+#endif
@@ -0,0 +1,112 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "GLCheck.h"
+#include "GpuMemory.h"
+#include "ObjectPicking.h"
+
+namespace {
+
+// Bytes of a slot, the model and the material identifiers
+const int SLOT_SIZE = 2 * sizeof(GLuint);
+
+}  // namespace
+
+ObjectPicking::ObjectPicking()
+    : buffer_(0),
+      mapped_(nullptr),
+      next_(0),
+      pending_(0),
+      requested_(false),
+      x_(0),
+      y_(0) {}
+
+ObjectPicking::~ObjectPicking() {
+  for (auto fence : fences_)
+    if (fence)
+      glDeleteSync((GLsync)fence);
+  if (buffer_) {
+    glDeleteBuffers(1, &buffer_);
+    GpuMemory::Free(GpuMemory::STREAMING, fences_.size() * SLOT_SIZE);
+  }
+}
+
+void ObjectPicking::Init(int slots) {
+  fences_.assign(slots, nullptr);
+  // The mapping is coherent, so the identifiers are visible once the fence
+  // of their copy is signaled
+  GLbitfield flags =
+      GL_MAP_READ_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+  size_t size = slots * SLOT_SIZE;
+  glCreateBuffers(1, &buffer_);
+  glNamedBufferStorage(buffer_, size, nullptr, flags | GL_CLIENT_STORAGE_BIT);
+  GpuMemory::Allocate(GpuMemory::STREAMING, size);
+  mapped_ = (const unsigned int*)glMapNamedBufferRange(buffer_, 0, size,
+                                                        flags);
+}
+
+void ObjectPicking::Request(int x, int y) {
+  requested_ = true;
+  x_ = x;
+  y_ = y;
+}
+
+void ObjectPicking::Copy(unsigned int texture, int width, int height) {
+  if (!requested_ || pending_ == (int)fences_.size())
+    return;
+  requested_ = false;
+  // The slot of a pixel outside of the texture keeps the background
+  int slot = next_;
+  if (x_ >= 0 && y_ >= 0 && x_ < width && y_ < height) {
+    // The copy is queued on the gpu and returns right away, as the
+    // destination is a buffer
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, buffer_);
+    glGetTextureSubImage(texture, 0, x_, y_, 0, 1, 1, 1, GL_RG_INTEGER,
+                         GL_UNSIGNED_INT, SLOT_SIZE,
+                         (void*)(size_t)(slot * SLOT_SIZE));
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  } else {
+    glClearNamedBufferSubData(buffer_, GL_RG32UI, slot * SLOT_SIZE,
+                              SLOT_SIZE, GL_RG_INTEGER, GL_UNSIGNED_INT,
+                              nullptr);
+  }
+  fences_[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  next_ = (next_ + 1) % fences_.size();
+  pending_++;
+}
+
+bool ObjectPicking::Poll(Hit* hit) {
+  if (pending_ == 0)
+    return false;
+  int slot = (next_ + fences_.size() - pending_) % fences_.size();
+  auto status = glClientWaitSync((GLsync)fences_[slot], 0, 0);
+  if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+    return false;
+  glDeleteSync((GLsync)fences_[slot]);
+  fences_[slot] = nullptr;
+  pending_--;
+  hit->model = (int)mapped_[2 * slot] - 1;
+  hit->material = (int)mapped_[2 * slot + 1] - 1;
+  return true;
+}
@@ -0,0 +1,95 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef OBJECTPICKING_H
+#define OBJECTPICKING_H
+
+#include <vector>
+
+/**
+ * Finds the object under a pixel from the identifiers the geometry pass
+ * writes, without stalling the gpu
+ *
+ * The identifiers are two unsigned integers per pixel, the model and the
+ * material plus one, 0 for the background. A pick copies the pixel of the
+ * identifier texture into the next slot of a persistently mapped pixel pack
+ * buffer, guarded by a fence, and is resolved a frame or two later once the
+ * fence is signaled; the render thread only polls the fences. A pick asked
+ * for while every slot is in flight waits for the next copy.
+ */
+class ObjectPicking {
+public:
+  /**
+   * Object under a picked pixel, -1 for the background
+   */
+  struct Hit {
+    int model;
+    int material;
+  };
+
+  /**
+   * Default constructor
+   */
+  ObjectPicking();
+
+  /**
+   * Destructor
+   */
+  ~ObjectPicking();
+
+  /**
+   * Creates the buffer with a slot for each pick in flight
+   */
+  void Init(int slots = 4);
+
+  /**
+   * Picks a pixel at the next Copy(), from the bottom left; a pick not
+   * copied yet is replaced
+   */
+  void Request(int x, int y);
+
+  /**
+   * Copies the pixel picked, if any, of the identifier texture of the size
+   * given, where the geometry pass drew; a pixel outside of it has no hit
+   */
+  void Copy(unsigned int texture, int width, int height);
+
+  /**
+   * Checks the fence of the oldest pick in flight without waiting
+   * Returns true with its hit if the copy is done
+   */
+  bool Poll(Hit* hit);
+
+private:
+  std::vector<void*> fences_;  // of the copy into each slot, or null
+  unsigned int buffer_;
+  const unsigned int* mapped_;
+  int next_;     // slot of the next copy
+  int pending_;  // picks in flight, in the slots before next_
+  bool requested_;
+  int x_;
+  int y_;
+};
+
+#endif
@@ -0,0 +1,141 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <algorithm>
+#include <cmath>
+
+#include "Frustum.h"
+#include "GLCheck.h"
+#include "GLDebug.h"
+#include "OcclusionQueries.h"
+
+namespace {
+
+// Vertices of the triangle strip of a box
+const int BOX_VERTICES = 14;
+
+}  // namespace
+
+OcclusionQueries::OcclusionQueries()
+    : buffer_(0), first_model_(0), n_models_(0), models_per_box_(1) {}
+
+OcclusionQueries::~OcclusionQueries() {
+  if (!queries_.empty())
+    glDeleteQueries(queries_.size(), queries_.data());
+  if (buffer_)
+    glDeleteBuffers(1, &buffer_);
+}
+
+void OcclusionQueries::Init(int first_model, int n_models,
+                            int models_per_box) {
+  first_model_ = first_model;
+  n_models_ = n_models;
+  models_per_box_ = models_per_box;
+  int n_boxes = GetBoxCount();
+  queries_.resize(n_boxes);
+  queried_.assign(n_boxes, false);
+  glCreateQueries(GL_ANY_SAMPLES_PASSED_CONSERVATIVE, n_boxes,
+                  queries_.data());
+  std::vector<unsigned int> visible(n_boxes, 1);
+  glCreateBuffers(1, &buffer_);
+  glNamedBufferStorage(buffer_, std::max(n_boxes, 1) * sizeof(unsigned int),
+                       visible.data(), GL_DYNAMIC_STORAGE_BIT);
+  GLDebug::Label(GL_BUFFER, buffer_, "box visibility");
+
+  box_shader_.LoadVertexShader("shaders/box_vs.glsl");
+  box_shader_.LinkShader();
+  box_shader_.SetLabel("occlusion boxes");
+  box_vao_.Init();
+  box_vao_.SetLabel("occlusion boxes");
+}
+
+void OcclusionQueries::Collect() {
+  // Without waiting, an unavailable result leaves the last one
+  for (size_t i = 0; i < queries_.size(); ++i) {
+    if (queried_[i])
+      glGetQueryBufferObjectuiv(queries_[i], buffer_, GL_QUERY_RESULT_NO_WAIT,
+                                i * sizeof(unsigned int));
+    queried_[i] = false;
+  }
+}
+
+void OcclusionQueries::Query(const glm::mat4* models, const glm::vec4& sphere,
+                             const glm::mat4& view_projection,
+                             const glm::vec3& eye) {
+  glm::vec4 planes[6];
+  ExtractFrustumPlanes(view_projection, planes);
+  box_shader_.Enable();
+  box_shader_.SetUniform("view_projection", view_projection);
+  glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+  glDepthMask(GL_FALSE);
+  glDisable(GL_CULL_FACE);
+  for (int box = 0; box < GetBoxCount(); ++box) {
+    // The models keep the sizes, so the spheres only move
+    int first = first_model_ + box * models_per_box_;
+    int end = std::min(first + models_per_box_, first_model_ + n_models_);
+    glm::vec3 box_min(INFINITY), box_max(-INFINITY);
+    for (int model = first; model < end; ++model) {
+      auto center = glm::vec3(models[model] * glm::vec4(glm::vec3(sphere), 1));
+      box_min = glm::min(box_min, center - sphere.w);
+      box_max = glm::max(box_max, center + sphere.w);
+    }
+    auto box_center = (box_min + box_max) / 2.0f;
+    float radius = glm::length(box_max - box_center);
+    bool in_frustum = true;
+    for (auto& plane : planes)
+      if (glm::dot(glm::vec3(plane), box_center) + plane.w < -radius)
+        in_frustum = false;
+    // The near plane clips a box around the eye
+    bool around_eye = glm::all(glm::greaterThan(eye, box_min)) &&
+                      glm::all(glm::lessThan(eye, box_max));
+    if (!in_frustum || around_eye) {
+      SetVisible(box);
+      continue;
+    }
+    box_shader_.SetUniform("box_min", box_min);
+    box_shader_.SetUniform("box_max", box_max);
+    glBeginQuery(GL_ANY_SAMPLES_PASSED_CONSERVATIVE, queries_[box]);
+    box_vao_.DrawArrays(GL_TRIANGLE_STRIP, BOX_VERTICES);
+    glEndQuery(GL_ANY_SAMPLES_PASSED_CONSERVATIVE);
+    queried_[box] = true;
+  }
+  glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+  glDepthMask(GL_TRUE);
+}
+
+unsigned int OcclusionQueries::GetBuffer() { return buffer_; }
+
+int OcclusionQueries::GetFirstModel() { return first_model_; }
+
+int OcclusionQueries::GetModelsPerBox() { return models_per_box_; }
+
+int OcclusionQueries::GetBoxCount() {
+  return (n_models_ + models_per_box_ - 1) / models_per_box_;
+}
+
+void OcclusionQueries::SetVisible(int box) {
+  unsigned int visible = 1;
+  glNamedBufferSubData(buffer_, box * sizeof(unsigned int),
+                       sizeof(unsigned int), &visible);
+}
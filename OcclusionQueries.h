@@ -0,0 +1,109 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef OCCLUSIONQUERIES_H
+#define OCCLUSIONQUERIES_H
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "ShaderProgram.h"
+#include "VertexArray.h"
+
+/**
+ * Occlusion queries of boxes of instances, for culling without a depth
+ * pyramid
+ *
+ * Each box groups consecutive models and is drawn with a query against the
+ * depth buffer of the frame, writing neither color nor depth. The next frame
+ * copies the results that are available to a buffer of one visibility per
+ * box on the gpu, which the culling reads (see MeshBatch::SetBoxVisibility),
+ * so the cpu never waits for them. A box that comes into view behind the
+ * depth is drawn a frame late. The boxes outside of the frustum or around
+ * the eye aren't queried and stay visible.
+ */
+class OcclusionQueries {
+public:
+  /**
+   * Default constructor
+   */
+  OcclusionQueries();
+
+  /**
+   * Destructor
+   */
+  ~OcclusionQueries();
+
+  /**
+   * Creates the queries and the visibility buffer of the boxes of
+   * models_per_box models from first_model on, every box visible until
+   * queried
+   * Throws runtime_error if the box shader doesn't compile
+   */
+  void Init(int first_model, int n_models, int models_per_box);
+
+  /**
+   * Copies the results of the last queries to the visibility buffer, except
+   * the ones that aren't available yet
+   */
+  void Collect();
+
+  /**
+   * Queries the box of each group of models around a bounding sphere in
+   * model space against the bound depth buffer
+   * The depth test must be enabled; the color and depth masks are restored
+   */
+  void Query(const glm::mat4* models, const glm::vec4& sphere,
+             const glm::mat4& view_projection, const glm::vec3& eye);
+
+  /**
+   * Obtains the buffer of the visibility of each box, as a uint
+   */
+  unsigned int GetBuffer();
+
+  /**
+   * Obtains the first model and the models of each box, and the boxes
+   */
+  int GetFirstModel();
+  int GetModelsPerBox();
+  int GetBoxCount();
+
+private:
+  /**
+   * Marks a box visible without a query
+   */
+  void SetVisible(int box);
+
+  ShaderProgram box_shader_;
+  VertexArray box_vao_;  // attribute-less, see shaders/box_vs.glsl
+  std::vector<unsigned int> queries_;
+  std::vector<bool> queried_;  // since the last Collect()
+  unsigned int buffer_;
+  int first_model_;
+  int n_models_;
+  int models_per_box_;
+};
+
+#endif
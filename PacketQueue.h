@@ -0,0 +1,74 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef PACKETQUEUE_H
+#define PACKETQUEUE_H
+
+#include <atomic>
+#include <cstddef>
+
+/**
+ * Bounded queue of one producer thread and one consumer thread, with no lock
+ *
+ * The slots are assigned in place, so the packets that hold vectors reuse
+ * their capacity once the queue went around. The producer only writes the
+ * tail and the consumer the head; each one reads the other's with acquire
+ * after the slot it releases.
+ */
+template <typename T, int N>
+class PacketQueue {
+public:
+  /**
+   * Copies a packet to the back, by the producer
+   * Returns false if the queue is full, which leaves the packet to the caller
+   */
+  bool Push(const T& packet) {
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    if (tail - head_.load(std::memory_order_acquire) == N)
+      return false;
+    packets_[tail % N] = packet;
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * Copies the front packet out and removes it, by the consumer
+   * Returns false if the queue is empty
+   */
+  bool Pop(T* packet) {
+    size_t head = head_.load(std::memory_order_relaxed);
+    if (head == tail_.load(std::memory_order_acquire))
+      return false;
+    *packet = packets_[head % N];
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+private:
+  T packets_[N];
+  std::atomic<size_t> head_{0};  // next popped, written by the consumer
+  std::atomic<size_t> tail_{0};  // next pushed, written by the producer
+};
+
+#endif
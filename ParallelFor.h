@@ -0,0 +1,58 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef PARALLELFOR_H
+#define PARALLELFOR_H
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+/**
+ * Calls body(begin, end) over contiguous slices of [0, n), one per hardware
+ * thread
+ *
+ * The calling thread runs the first slice and waits for the others. The
+ * slices don't overlap, so the body can write its elements of a shared
+ * (e.g. mapped) array without locks. Slices are at least min_slice elements
+ * long, so small ranges use fewer threads, down to the calling thread alone.
+ */
+template <typename Body>
+void ParallelFor(int n, const Body& body, int min_slice = 256) {
+  int n_threads = std::max<int>(std::thread::hardware_concurrency(), 1);
+  n_threads = std::max(std::min(n_threads, n / std::max(min_slice, 1)), 1);
+  auto slice_begin = [&](int slice) {
+    return (int)((long long)n * slice / n_threads);
+  };
+
+  std::vector<std::thread> workers;
+  workers.reserve(n_threads - 1);
+  for (int i = 1; i < n_threads; ++i)
+    workers.emplace_back(body, slice_begin(i), slice_begin(i + 1));
+  body(0, slice_begin(1));
+  for (auto& worker : workers)
+    worker.join();
+}
+
+#endif
@@ -0,0 +1,267 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <algorithm>
+#include <cctype>
+
+#include "GLCheck.h"
+#include "GLDebug.h"
+#include "GLState.h"
+#include "PerformanceHud.h"
+
+namespace {
+
+// Size of the overlay texture; only the rows used are uploaded and drawn
+const int WIDTH = 256;
+const int HEIGHT = 192;
+
+// Pixels around the content and between the lines of text
+const int MARGIN = 4;
+const int GLYPH_WIDTH = 5;
+const int GLYPH_HEIGHT = 7;
+const int ADVANCE = GLYPH_WIDTH + 1;
+const int LINE_HEIGHT = GLYPH_HEIGHT + 2;
+
+// Graph of one column per frame, its full height in milliseconds, and the
+// line marking a 60 Hz frame
+const int GRAPH_HEIGHT = 40;
+const int HISTORY = WIDTH - 2 * MARGIN;
+const float GRAPH_MS = 1000.0f / 30;
+const float TARGET_MS = 1000.0f / 60;
+
+// Intensities of the texture; the shader maps them to colors over a
+// translucent background
+const unsigned char BACKGROUND = 0;
+const unsigned char GUIDE = 64;
+const unsigned char BAR = 128;
+const unsigned char MARK = 255;
+const unsigned char TEXT = 255;
+
+// Window height at which the overlay is scaled up by one more pixel
+const int SCALE_HEIGHT = 1080;
+
+// Frames in the ring of primitive queries, more than the gpu may lag behind
+const int N_QUERIES = 5;
+
+// Rows of a glyph, from the top, with the leftmost pixel in the fifth bit
+struct Glyph {
+  char c;
+  unsigned char rows[GLYPH_HEIGHT];
+};
+
+const Glyph FONT[] = {
+    {'0', {0x0e, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0e}},
+    {'1', {0x04, 0x0c, 0x04, 0x04, 0x04, 0x04, 0x0e}},
+    {'2', {0x0e, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1f}},
+    {'3', {0x1f, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0e}},
+    {'4', {0x02, 0x06, 0x0a, 0x12, 0x1f, 0x02, 0x02}},
+    {'5', {0x1f, 0x10, 0x1e, 0x01, 0x01, 0x11, 0x0e}},
+    {'6', {0x06, 0x08, 0x10, 0x1e, 0x11, 0x11, 0x0e}},
+    {'7', {0x1f, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08}},
+    {'8', {0x0e, 0x11, 0x11, 0x0e, 0x11, 0x11, 0x0e}},
+    {'9', {0x0e, 0x11, 0x11, 0x0f, 0x01, 0x02, 0x0c}},
+    {'a', {0x00, 0x00, 0x0e, 0x01, 0x0f, 0x11, 0x0f}},
+    {'b', {0x10, 0x10, 0x16, 0x19, 0x11, 0x11, 0x1e}},
+    {'c', {0x00, 0x00, 0x0e, 0x10, 0x10, 0x11, 0x0e}},
+    {'d', {0x01, 0x01, 0x0d, 0x13, 0x11, 0x11, 0x0f}},
+    {'e', {0x00, 0x00, 0x0e, 0x11, 0x1f, 0x10, 0x0e}},
+    {'f', {0x06, 0x09, 0x08, 0x1c, 0x08, 0x08, 0x08}},
+    {'g', {0x00, 0x0f, 0x11, 0x11, 0x0f, 0x01, 0x0e}},
+    {'h', {0x10, 0x10, 0x16, 0x19, 0x11, 0x11, 0x11}},
+    {'i', {0x04, 0x00, 0x0c, 0x04, 0x04, 0x04, 0x0e}},
+    {'j', {0x02, 0x00, 0x06, 0x02, 0x02, 0x12, 0x0c}},
+    {'k', {0x10, 0x10, 0x12, 0x14, 0x18, 0x14, 0x12}},
+    {'l', {0x0c, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0e}},
+    {'m', {0x00, 0x00, 0x1a, 0x15, 0x15, 0x11, 0x11}},
+    {'n', {0x00, 0x00, 0x16, 0x19, 0x11, 0x11, 0x11}},
+    {'o', {0x00, 0x00, 0x0e, 0x11, 0x11, 0x11, 0x0e}},
+    {'p', {0x00, 0x00, 0x1e, 0x11, 0x1e, 0x10, 0x10}},
+    {'q', {0x00, 0x00, 0x0d, 0x13, 0x0f, 0x01, 0x01}},
+    {'r', {0x00, 0x00, 0x16, 0x19, 0x10, 0x10, 0x10}},
+    {'s', {0x00, 0x00, 0x0e, 0x10, 0x0e, 0x01, 0x1e}},
+    {'t', {0x08, 0x08, 0x1c, 0x08, 0x08, 0x09, 0x06}},
+    {'u', {0x00, 0x00, 0x11, 0x11, 0x11, 0x13, 0x0d}},
+    {'v', {0x00, 0x00, 0x11, 0x11, 0x11, 0x0a, 0x04}},
+    {'w', {0x00, 0x00, 0x11, 0x11, 0x15, 0x15, 0x0a}},
+    {'x', {0x00, 0x00, 0x11, 0x0a, 0x04, 0x0a, 0x11}},
+    {'y', {0x00, 0x00, 0x11, 0x11, 0x0f, 0x01, 0x0e}},
+    {'z', {0x00, 0x00, 0x1f, 0x02, 0x04, 0x08, 0x1f}},
+    {'.', {0x00, 0x00, 0x00, 0x00, 0x00, 0x0c, 0x0c}},
+    {':', {0x00, 0x0c, 0x0c, 0x00, 0x0c, 0x0c, 0x00}},
+    {'%', {0x18, 0x19, 0x02, 0x04, 0x08, 0x13, 0x03}},
+    {'/', {0x00, 0x01, 0x02, 0x04, 0x08, 0x10, 0x00}},
+    {'-', {0x00, 0x00, 0x00, 0x1f, 0x00, 0x00, 0x00}},
+    {'(', {0x02, 0x04, 0x08, 0x08, 0x08, 0x04, 0x02}},
+    {')', {0x08, 0x04, 0x02, 0x02, 0x02, 0x04, 0x08}},
+    {'=', {0x00, 0x00, 0x1f, 0x00, 0x1f, 0x00, 0x00}},
+    {',', {0x00, 0x00, 0x00, 0x00, 0x0c, 0x04, 0x08}},
+    {'_', {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1f}},
+    {'+', {0x00, 0x04, 0x04, 0x1f, 0x04, 0x04, 0x00}},
+};
+
+// Finds the glyph of a character, nullptr if the font doesn't have it
+const Glyph* FindGlyph(char c) {
+  c = std::tolower((unsigned char)c);
+  for (auto& glyph : FONT)
+    if (glyph.c == c)
+      return &glyph;
+  return nullptr;
+}
+
+}  // namespace
+
+PerformanceHud::PerformanceHud()
+    : triangle_(nullptr),
+      texture_(0),
+      pixels_(WIDTH * HEIGHT, BACKGROUND),
+      frame_history_(HISTORY, 0),
+      gpu_history_(HISTORY, 0),
+      history_index_(0),
+      queried_(N_QUERIES, false),
+      query_index_(0),
+      primitives_(0) {}
+
+PerformanceHud::~PerformanceHud() {
+  if (texture_)
+    GLState::DeleteTextures(1, &texture_);
+  if (!queries_.empty())
+    glDeleteQueries(queries_.size(), queries_.data());
+}
+
+void PerformanceHud::Init(ShaderProgram* vertex, VertexArray* triangle) {
+  triangle_ = triangle;
+  glCreateTextures(GL_TEXTURE_2D, 1, &texture_);
+  glTextureStorage2D(texture_, 1, GL_R8, WIDTH, HEIGHT);
+  GLDebug::Label(GL_TEXTURE, texture_, "hud");
+  queries_.resize(N_QUERIES);
+  glCreateQueries(GL_PRIMITIVES_GENERATED, N_QUERIES, queries_.data());
+  shader_.SetVertexProgram(vertex);
+  shader_.LoadFragmentShader("shaders/hud_fs.glsl");
+  shader_.LinkShader();
+}
+
+void PerformanceHud::SetText(const std::vector<std::string>& lines) {
+  lines_ = lines;
+}
+
+void PerformanceHud::AddFrame(double frame_ms, double gpu_ms) {
+  frame_history_[history_index_] = frame_ms;
+  gpu_history_[history_index_] = gpu_ms;
+  history_index_ = (history_index_ + 1) % HISTORY;
+}
+
+void PerformanceHud::BeginPrimitives() {
+  query_index_ = (query_index_ + 1) % N_QUERIES;
+  auto query = queries_[query_index_];
+  if (queried_[query_index_]) {
+    GLint available = 0;
+    glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+    if (available) {
+      GLuint64 count = 0;
+      glGetQueryObjectui64v(query, GL_QUERY_RESULT, &count);
+      primitives_ = count;
+    }
+  }
+  glBeginQuery(GL_PRIMITIVES_GENERATED, query);
+  queried_[query_index_] = true;
+}
+
+void PerformanceHud::EndPrimitives() { glEndQuery(GL_PRIMITIVES_GENERATED); }
+
+long long PerformanceHud::GetPrimitives() { return primitives_; }
+
+void PerformanceHud::Draw(int width, int height) {
+  int rows = Rasterize();
+  glTextureSubImage2D(texture_, 0, 0, 0, WIDTH, rows, GL_RED,
+                      GL_UNSIGNED_BYTE, pixels_.data());
+
+  // The rows go from the top, and the window from the bottom
+  int scale = 1 + height / SCALE_HEIGHT;
+  int x = MARGIN * scale;
+  int y = height - (MARGIN + rows) * scale;
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+  glViewport(0, 0, width, height);
+  glEnable(GL_SCISSOR_TEST);
+  glScissor(x, y, std::min(WIDTH * scale, width - x), rows * scale);
+  glEnable(GL_BLEND);
+  glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+  glDisable(GL_DEPTH_TEST);
+  shader_.Enable();
+  shader_.SetUniform("hud_origin", glm::ivec2(x, y + rows * scale - 1));
+  shader_.SetUniform("hud_scale", scale);
+  GLState::BindTexture(0, texture_);
+  triangle_->DrawArrays(GL_TRIANGLES, 3);
+  glDisable(GL_BLEND);
+  glDisable(GL_SCISSOR_TEST);
+}
+
+int PerformanceHud::Rasterize() {
+  int n_lines = std::min<int>(
+      lines_.size(), (HEIGHT - 3 * MARGIN - GRAPH_HEIGHT) / LINE_HEIGHT);
+  int graph_y = MARGIN + n_lines * LINE_HEIGHT + MARGIN;
+  int rows = graph_y + GRAPH_HEIGHT + MARGIN;
+  std::fill(pixels_.begin(), pixels_.begin() + rows * WIDTH, BACKGROUND);
+  for (int i = 0; i < n_lines; ++i)
+    DrawText(lines_[i], MARGIN, MARGIN + i * LINE_HEIGHT);
+  DrawGraph(graph_y);
+  return rows;
+}
+
+void PerformanceHud::DrawText(const std::string& text, int x, int y) {
+  for (char c : text) {
+    if (x + GLYPH_WIDTH > WIDTH - MARGIN)
+      break;
+    auto glyph = FindGlyph(c);
+    for (int row = 0; glyph && row < GLYPH_HEIGHT; ++row) {
+      auto line = &pixels_[(y + row) * WIDTH + x];
+      for (int column = 0; column < GLYPH_WIDTH; ++column)
+        if (glyph->rows[row] & (0x10 >> column))
+          line[column] = TEXT;
+    }
+    x += ADVANCE;
+  }
+}
+
+void PerformanceHud::DrawGraph(int y) {
+  // Rows of a time from the bottom of the graph, clamped to its height
+  auto height = [](float ms) {
+    return std::min(GRAPH_HEIGHT, (int)(ms / GRAPH_MS * GRAPH_HEIGHT));
+  };
+  int bottom = y + GRAPH_HEIGHT - 1;
+  auto guide = &pixels_[(bottom - height(TARGET_MS)) * WIDTH + MARGIN];
+  for (int x = 0; x < HISTORY; x += 2)
+    guide[x] = GUIDE;
+
+  // The oldest frame is on the left
+  for (int x = 0; x < HISTORY; ++x) {
+    int frame = (history_index_ + x) % HISTORY;
+    int column = MARGIN + x;
+    for (int row = 0; row < height(frame_history_[frame]); ++row)
+      pixels_[(bottom - row) * WIDTH + column] = BAR;
+    if (gpu_history_[frame] > 0) {
+      int row = std::max(height(gpu_history_[frame]) - 1, 0);
+      pixels_[(bottom - row) * WIDTH + column] = MARK;
+    }
+  }
+}
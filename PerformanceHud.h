@@ -0,0 +1,117 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef PERFORMANCEHUD_H
+#define PERFORMANCEHUD_H
+
+#include <string>
+#include <vector>
+
+#include "ShaderProgram.h"
+#include "VertexArray.h"
+
+/**
+ * Overlay of the performance statistics in the corner of the window: lines
+ * of text and a graph of the recent frame times
+ *
+ * The text and the graph are drawn on the cpu with a built-in 5x7 font into
+ * a small single channel texture, uploaded once per frame and blended over
+ * the backbuffer by one full-screen triangle clipped to the overlay. The
+ * font has the lowercase letters, the digits and a few symbols, other
+ * characters are left blank.
+ */
+class PerformanceHud {
+public:
+  /**
+   * Default constructor
+   */
+  PerformanceHud();
+
+  /**
+   * Destructor
+   */
+  ~PerformanceHud();
+
+  /**
+   * Creates the texture and the shader, linked with the vertex program of
+   * the full-screen passes, which draw the triangle
+   * Throws runtime_error if the shader doesn't compile
+   */
+  void Init(ShaderProgram* vertex, VertexArray* triangle);
+
+  /**
+   * Replaces the lines of text, shown above the graph
+   */
+  void SetText(const std::vector<std::string>& lines);
+
+  /**
+   * Appends the times of a frame to the graph; the frame time is drawn as a
+   * bar and the gpu time as a brighter mark, the ones not measured are <= 0
+   */
+  void AddFrame(double frame_ms, double gpu_ms);
+
+  /**
+   * Starts and ends counting the primitives generated by the draws between
+   * the calls; the count is read when the query comes back, frames later,
+   * so the cpu never waits
+   */
+  void BeginPrimitives();
+  void EndPrimitives();
+
+  /**
+   * Obtains the last primitive count read, zero before the first one
+   */
+  long long GetPrimitives();
+
+  /**
+   * Draws the overlay in the top left corner of the backbuffer, of the size
+   * of the window, scaled up by whole pixels for large windows
+   */
+  void Draw(int width, int height);
+
+private:
+  // Draws the text and the graph into the pixels, returns the rows used
+  int Rasterize();
+
+  // Draws a line of text at a pixel, the top left corner of the first glyph
+  void DrawText(const std::string& text, int x, int y);
+
+  // Draws the graph of the frame times below a row
+  void DrawGraph(int y);
+
+  ShaderProgram shader_;
+  VertexArray* triangle_;
+  unsigned int texture_;
+  std::vector<unsigned char> pixels_;  // rows from the top, as uploaded
+  std::vector<std::string> lines_;
+  std::vector<float> frame_history_;  // ring of milliseconds
+  std::vector<float> gpu_history_;
+  int history_index_;  // of the oldest frame
+  std::vector<unsigned int> queries_;  // ring of primitive counts
+  std::vector<bool> queried_;
+  int query_index_;
+  long long primitives_;
+};
+
+#endif
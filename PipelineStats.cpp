@@ -0,0 +1,120 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "GLCheck.h"
+#include "PipelineStats.h"
+
+namespace {
+
+// Frames in the ring, more than the frames the gpu may lag behind
+const int N_FRAMES = 5;
+
+// Statistics of a section, in the order of the Section members
+const GLenum TARGETS[] = {GL_VERTEX_SHADER_INVOCATIONS_ARB,
+                          GL_CLIPPING_INPUT_PRIMITIVES_ARB,
+                          GL_FRAGMENT_SHADER_INVOCATIONS_ARB};
+const int N_TARGETS = sizeof(TARGETS) / sizeof(TARGETS[0]);
+
+}  // namespace
+
+PipelineStats::PipelineStats() : frames_(N_FRAMES), frame_(0) {}
+
+PipelineStats::~PipelineStats() {
+  for (auto& frame : frames_)
+    if (!frame.queries.empty())
+      glDeleteQueries(frame.queries.size(), frame.queries.data());
+}
+
+bool PipelineStats::IsSupported() {
+  return GLEW_ARB_pipeline_statistics_query;
+}
+
+void PipelineStats::BeginFrame() {
+  frame_ = (frame_ + 1) % N_FRAMES;
+  Collect(&frames_[frame_]);
+}
+
+void PipelineStats::Begin(const std::string& name) {
+  int section = 0;
+  while (section < (int)sections_.size() && sections_[section].name != name)
+    ++section;
+  if (section == (int)sections_.size())
+    sections_.push_back({name, 0, 0, 0, 0});
+
+  // The queries are created once per slot and reused by later frames
+  auto& frame = frames_[frame_];
+  size_t first = N_TARGETS * frame.sections.size();
+  if (frame.queries.size() < first + N_TARGETS) {
+    frame.queries.resize(first + N_TARGETS);
+    for (int i = 0; i < N_TARGETS; ++i)
+      glCreateQueries(TARGETS[i], 1, &frame.queries[first + i]);
+  }
+  for (int i = 0; i < N_TARGETS; ++i)
+    glBeginQuery(TARGETS[i], frame.queries[first + i]);
+  frame.sections.push_back(section);
+}
+
+void PipelineStats::End() {
+  for (int i = 0; i < N_TARGETS; ++i)
+    glEndQuery(TARGETS[i]);
+}
+
+const std::vector<PipelineStats::Section>& PipelineStats::GetSections() {
+  return sections_;
+}
+
+void PipelineStats::ResetSections() {
+  for (auto& section : sections_) {
+    section.vertices = 0;
+    section.primitives = 0;
+    section.fragments = 0;
+    section.frames = 0;
+  }
+}
+
+void PipelineStats::Collect(Frame* frame) {
+  if (frame->sections.empty())
+    return;
+  // The statistics of a section end together, but may not be available in
+  // order, so each one is checked
+  size_t n_queries = N_TARGETS * frame->sections.size();
+  GLint available = 1;
+  for (size_t i = 0; available && i < n_queries; ++i)
+    glGetQueryObjectiv(frame->queries[i], GL_QUERY_RESULT_AVAILABLE,
+                       &available);
+  if (available) {
+    for (size_t i = 0; i < frame->sections.size(); ++i) {
+      GLuint64 counts[N_TARGETS];
+      for (int j = 0; j < N_TARGETS; ++j)
+        glGetQueryObjectui64v(frame->queries[N_TARGETS * i + j],
+                              GL_QUERY_RESULT, &counts[j]);
+      auto& section = sections_[frame->sections[i]];
+      section.vertices += counts[0];
+      section.primitives += counts[1];
+      section.fragments += counts[2];
+      section.frames++;
+    }
+  }
+  frame->sections.clear();
+}
@@ -0,0 +1,106 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef PIPELINESTATS_H
+#define PIPELINESTATS_H
+
+#include <string>
+#include <vector>
+
+/**
+ * Pipeline statistics of named sections of the frame, such as the render
+ * passes, from ARB_pipeline_statistics_query
+ *
+ * Each section counts the vertex shader invocations, the primitives that
+ * reach the clipper and the fragment shader invocations. Like GpuTimer, the
+ * queries of a frame are read when its slot of the ring comes back, only if
+ * they are available, so the cpu never waits.
+ */
+class PipelineStats {
+public:
+  /**
+   * Counts of a section since the last reset
+   */
+  struct Section {
+    std::string name;
+    double vertices;  // summed over the frames
+    double primitives;
+    double fragments;
+    int frames;
+  };
+
+  /**
+   * Default constructor
+   */
+  PipelineStats();
+
+  /**
+   * Destructor
+   */
+  ~PipelineStats();
+
+  /**
+   * Checks if the driver supports the queries
+   */
+  static bool IsSupported();
+
+  /**
+   * Starts a frame, reading the sections of the frame that last used its
+   * slot of the ring
+   */
+  void BeginFrame();
+
+  /**
+   * Starts and ends the counting of a section; sections don't nest
+   */
+  void Begin(const std::string& name);
+  void End();
+
+  /**
+   * Obtains the sections counted since the last reset, in the order they
+   * were first counted
+   */
+  const std::vector<Section>& GetSections();
+
+  /**
+   * Clears the counts
+   */
+  void ResetSections();
+
+private:
+  // Queries issued in a slot of the ring, one per statistic and section
+  struct Frame {
+    std::vector<unsigned int> queries;
+    std::vector<int> sections;
+  };
+
+  // Reads the queries of a frame if they are available
+  void Collect(Frame* frame);
+
+  std::vector<Frame> frames_;
+  int frame_;
+  std::vector<Section> sections_;
+};
+
+#endif
@@ -0,0 +1,100 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "QualityGovernor.h"
+
+namespace {
+
+// Shares of the target above which the knobs go down and below which they
+// go back up
+const float LOWER_THRESHOLD = 1.05f;
+const float RAISE_THRESHOLD = 0.8f;
+
+// Frames in a row past a threshold before a change, longer to raise since a
+// knob raised too early is lowered again right after
+const int LOWER_FRAMES = 30;
+const int RAISE_FRAMES = 180;
+
+// Frames waited after a change, so the timings measure it
+const int COOLDOWN_FRAMES = 30;
+
+}  // namespace
+
+QualityGovernor::QualityGovernor()
+    : target_ms_(0), over_frames_(0), under_frames_(0), cooldown_(0) {}
+
+void QualityGovernor::Init(float target_ms) { target_ms_ = target_ms; }
+
+void QualityGovernor::AddKnob(const std::string& name, int n_levels,
+                              std::function<void(int)> apply) {
+  knobs_.push_back({name, n_levels, 0, apply});
+}
+
+bool QualityGovernor::Update(float gpu_ms) {
+  if (gpu_ms <= 0 || target_ms_ <= 0)
+    return false;
+  if (cooldown_ > 0) {
+    --cooldown_;
+    return false;
+  }
+  over_frames_ = gpu_ms > target_ms_ * LOWER_THRESHOLD ? over_frames_ + 1 : 0;
+  under_frames_ =
+      gpu_ms < target_ms_ * RAISE_THRESHOLD ? under_frames_ + 1 : 0;
+  if (over_frames_ >= LOWER_FRAMES) {
+    for (size_t i = 0; i < knobs_.size(); ++i) {
+      if (knobs_[i].level + 1 < knobs_[i].n_levels) {
+        lowered_.push_back(i);
+        SetLevel(i, knobs_[i].level + 1, gpu_ms);
+        return true;
+      }
+    }
+  } else if (under_frames_ >= RAISE_FRAMES && !lowered_.empty()) {
+    int knob = lowered_.back();
+    lowered_.pop_back();
+    SetLevel(knob, knobs_[knob].level - 1, gpu_ms);
+    return true;
+  }
+  return false;
+}
+
+const QualityGovernor::Change& QualityGovernor::GetLastChange() {
+  return last_change_;
+}
+
+int QualityGovernor::GetKnobCount() { return knobs_.size(); }
+
+const std::string& QualityGovernor::GetKnobName(int knob) {
+  return knobs_[knob].name;
+}
+
+int QualityGovernor::GetLevel(int knob) { return knobs_[knob].level; }
+
+void QualityGovernor::SetLevel(int knob, int level, float gpu_ms) {
+  knobs_[knob].level = level;
+  knobs_[knob].apply(level);
+  last_change_ = {knobs_[knob].name, level, gpu_ms};
+  over_frames_ = 0;
+  under_frames_ = 0;
+  cooldown_ = COOLDOWN_FRAMES;
+}
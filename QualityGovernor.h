@@ -0,0 +1,108 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef QUALITYGOVERNOR_H
+#define QUALITYGOVERNOR_H
+
+#include <functional>
+#include <string>
+#include <vector>
+
+/**
+ * Quality knobs lowered and raised to hold a gpu time
+ *
+ * The knobs are added in the order they're given up, each with levels from
+ * the full quality, 0, down to the cheapest one. While the measured gpu time
+ * stays above the target for a while, the first knob that can still be
+ * lowered goes down a level; while it stays well below, the last knob
+ * lowered goes back up. The band between the two thresholds, the frames each
+ * must hold and the frames waited after every change, so their effect is
+ * measured, keep it from oscillating.
+ */
+class QualityGovernor {
+public:
+  /**
+   * Change of a knob
+   */
+  struct Change {
+    std::string knob;
+    int level;
+    float gpu_ms;  // measured when it changed
+  };
+
+  /**
+   * Default constructor
+   */
+  QualityGovernor();
+
+  /**
+   * Sets the gpu time aimed at, in milliseconds
+   */
+  void Init(float target_ms);
+
+  /**
+   * Adds a knob after the others, applied with the level it's set to
+   */
+  void AddKnob(const std::string& name, int n_levels,
+               std::function<void(int)> apply);
+
+  /**
+   * Takes the gpu time of a frame and changes a knob if it's time to
+   * Returns true if one changed
+   */
+  bool Update(float gpu_ms);
+
+  /**
+   * Obtains the last change
+   */
+  const Change& GetLastChange();
+
+  /**
+   * Obtains the number of knobs, and the name and the level of one
+   */
+  int GetKnobCount();
+  const std::string& GetKnobName(int knob);
+  int GetLevel(int knob);
+
+private:
+  struct Knob {
+    std::string name;
+    int n_levels;
+    int level;
+    std::function<void(int)> apply;
+  };
+
+  // Moves a knob by a level and records the change
+  void SetLevel(int knob, int level, float gpu_ms);
+
+  std::vector<Knob> knobs_;
+  std::vector<int> lowered_;  // knobs in the order their levels went down
+  float target_ms_;
+  int over_frames_;   // in a row above the upper threshold
+  int under_frames_;  // in a row below the lower one
+  int cooldown_;      // frames left before the next change
+  Change last_change_;
+};
+
+#endif
@@ -0,0 +1,198 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+#ifdef __linux__
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#include "CpuProfiler.h"
+#include "RemoteControl.h"
+
+namespace {
+
+// Milliseconds the server thread waits on a socket before checking the stop
+const int POLL_MILLISECONDS = 100;
+
+}  // namespace
+
+RemoteControl::RemoteControl()
+    : socket_(-1), stop_(false), head_(0), tail_(0) {}
+
+RemoteControl::~RemoteControl() { Stop(); }
+
+void RemoteControl::Start(int port) {
+#ifdef __linux__
+  socket_ = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  int reuse = 1;
+  sockaddr_in address = {};
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_ANY);
+  address.sin_port = htons(port);
+  if (socket_ < 0 ||
+      setsockopt(socket_, SOL_SOCKET, SO_REUSEADDR, &reuse,
+                 sizeof(reuse)) < 0 ||
+      bind(socket_, (sockaddr *)&address, sizeof(address)) < 0 ||
+      listen(socket_, 4) < 0) {
+    if (socket_ >= 0)
+      close(socket_);
+    socket_ = -1;
+    throw std::runtime_error("can't listen on port " + std::to_string(port));
+  }
+  thread_ = std::thread(&RemoteControl::Run, this);
+#else
+  throw std::runtime_error("the remote control needs linux");
+#endif
+}
+
+void RemoteControl::Stop() {
+  if (!thread_.joinable())
+    return;
+  stop_ = true;
+  thread_.join();
+#ifdef __linux__
+  close(socket_);
+#endif
+  socket_ = -1;
+}
+
+void RemoteControl::Publish(const std::string &stats) {
+  std::unique_lock<std::mutex> lock(stats_mutex_, std::try_to_lock);
+  if (lock.owns_lock())
+    stats_ = stats;
+}
+
+bool RemoteControl::Poll(Command *command) {
+  unsigned int head = head_.load(std::memory_order_relaxed);
+  if (head == tail_.load(std::memory_order_acquire))
+    return false;
+  *command = queue_[head % QUEUE_SIZE];
+  head_.store(head + 1, std::memory_order_release);
+  return true;
+}
+
+bool RemoteControl::Push(const Command &command) {
+  unsigned int tail = tail_.load(std::memory_order_relaxed);
+  if (tail - head_.load(std::memory_order_acquire) == QUEUE_SIZE)
+    return false;
+  queue_[tail % QUEUE_SIZE] = command;
+  tail_.store(tail + 1, std::memory_order_release);
+  return true;
+}
+
+void RemoteControl::Run() {
+#ifdef __linux__
+  CpuProfiler::SetThreadName("remote");
+  while (!stop_) {
+    pollfd listening = {socket_, POLLIN, 0};
+    if (poll(&listening, 1, POLL_MILLISECONDS) <= 0)
+      continue;
+    int client = accept4(socket_, nullptr, nullptr, SOCK_CLOEXEC);
+    if (client < 0)
+      continue;
+    Serve(client);
+    close(client);
+  }
+#endif
+}
+
+void RemoteControl::Serve(int client) {
+#ifdef __linux__
+  // An HTTP request is answered once its headers end, and then closed
+  std::string line;
+  bool http = false;
+  std::string path;
+  while (!stop_) {
+    pollfd connection = {client, POLLIN, 0};
+    int ready = poll(&connection, 1, POLL_MILLISECONDS);
+    if (ready < 0)
+      return;
+    if (ready == 0)
+      continue;
+    char data[MAX_LINE];
+    ssize_t size = recv(client, data, sizeof(data), 0);
+    if (size <= 0)
+      return;
+    for (ssize_t i = 0; i < size; ++i) {
+      if (data[i] != '\n') {
+        if (data[i] != '\r' && (int)line.size() < MAX_LINE)
+          line += data[i];
+        continue;
+      }
+      std::string answer;
+      if (!http && line.compare(0, 4, "GET ") == 0) {
+        http = true;
+        path = line.substr(4, line.find(' ', 4) - 4);
+      } else if (http && line.empty()) {
+        if (path == "/stats") {
+          std::lock_guard<std::mutex> lock(stats_mutex_);
+          answer = "HTTP/1.0 200 OK\r\nContent-Type: application/json\r\n"
+                   "Content-Length: " +
+                   std::to_string(stats_.size() + 1) + "\r\n\r\n" + stats_ +
+                   "\n";
+        } else {
+          answer = "HTTP/1.0 404 Not Found\r\nContent-Length: 0\r\n\r\n";
+        }
+      } else if (!http) {
+        answer = Answer(line);
+      }
+      line.clear();
+      if (!answer.empty() &&
+          send(client, answer.data(), answer.size(), MSG_NOSIGNAL) < 0)
+        return;
+      if (http && !answer.empty())
+        return;
+    }
+  }
+#endif
+}
+
+std::string RemoteControl::Answer(const std::string &line) {
+  if (line == "stats") {
+    std::lock_guard<std::mutex> lock(stats_mutex_);
+    return stats_ + "\n";
+  }
+  Command command = {};
+  char state[4];
+  if (sscanf(line.c_str(), "camera %d", &command.value) == 1) {
+    command.type = Command::CAMERA;
+  } else if (sscanf(line.c_str(), "lights %d", &command.value) == 1 &&
+             command.value >= 0) {
+    command.type = Command::LIGHTS;
+  } else if (sscanf(line.c_str(), "pass %31s %3s", command.pass, state) ==
+                 2 &&
+             (!strcmp(state, "on") || !strcmp(state, "off"))) {
+    command.type = Command::PASS;
+    command.value = !strcmp(state, "on");
+  } else {
+    return "error: unknown command\n";
+  }
+  return Push(command) ? "ok\n" : "error: too many commands queued\n";
+}
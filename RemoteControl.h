@@ -0,0 +1,128 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef REMOTECONTROL_H
+#define REMOTECONTROL_H
+
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+
+/**
+ * Tcp server of the live stats and of commands, on a thread of its own
+ *
+ * Every line a client sends is a command, answered with a line:
+ *   stats                    the last stats published, as a JSON object
+ *   camera <index>           switches to a camera of the scene
+ *   lights <count>           lights the scene with its first lights only
+ *   pass <name> <on|off>     enables or disables a pass of the render graph
+ * An HTTP GET of /stats is answered with the stats too, so a dashboard or
+ * curl can sample them. The commands go through a lock-free queue of a
+ * single producer, the server thread, and a single consumer, the render
+ * thread, which applies them at the start of a frame; they are only checked
+ * against the scene there. Publishing the stats skips the frame instead of
+ * waiting while the server thread copies them, so the render thread never
+ * waits on the network.
+ */
+class RemoteControl {
+public:
+  /**
+   * Command received from a client
+   */
+  struct Command {
+    enum Type { CAMERA, LIGHTS, PASS };
+    Type type;
+    int value;  // camera index, light count, or 1 to enable the pass
+    char pass[32];
+  };
+
+  /**
+   * Default constructor
+   */
+  RemoteControl();
+
+  /**
+   * Destructor, stops the server
+   */
+  ~RemoteControl();
+
+  /**
+   * Listens on a tcp port of every interface and starts the server thread
+   * Throws runtime_error if the port can't be listened on
+   */
+  void Start(int port);
+
+  /**
+   * Stops the server thread and closes its connections
+   */
+  void Stop();
+
+  /**
+   * Replaces the stats sent to the clients, a JSON object; skipped while the
+   * server thread reads them
+   */
+  void Publish(const std::string& stats);
+
+  /**
+   * Takes the oldest command received
+   * Returns false if there is none
+   */
+  bool Poll(Command* command);
+
+private:
+  // Commands queued at most; a command is refused while the queue is full
+  static const int QUEUE_SIZE = 64;
+
+  // Longest line read from a client
+  static const int MAX_LINE = 256;
+
+  // Accepts the clients one at a time until stopped
+  void Run();
+
+  // Answers the lines of a client until it closes the connection
+  void Serve(int client);
+
+  // Answers a line of a client, queueing its command
+  std::string Answer(const std::string& line);
+
+  // Queues a command for Poll()
+  // Returns false if the queue is full
+  bool Push(const Command& command);
+
+  int socket_;
+  std::thread thread_;
+  std::atomic<bool> stop_;
+
+  std::mutex stats_mutex_;
+  std::string stats_;
+
+  // Ring of the queued commands, written at tail_ by the server thread and
+  // read at head_ by the render thread
+  Command queue_[QUEUE_SIZE];
+  std::atomic<unsigned int> head_;
+  std::atomic<unsigned int> tail_;
+};
+
+#endif
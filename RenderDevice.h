@@ -0,0 +1,114 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef RENDERDEVICE_H
+#define RENDERDEVICE_H
+
+#include <memory>
+#include <string>
+
+#include "CommandList.h"
+#include "FrameBuffer.h"
+#include "ShaderProgram.h"
+#include "UniformBuffer.h"
+
+/**
+ * Creates the resources of the renderer: the buffers, the render targets, the
+ * pipelines and the command lists
+ *
+ * main.cpp creates its buffers, render targets, pipelines and command lists
+ * through the device instead of initializing the wrapper classes itself. The
+ * classes of the other passes (the impostors, the ambient occlusion, the
+ * reflections and the like) still initialize their own wrappers, so another
+ * graphics api needs them routed here as well. GLDevice is the gl backend;
+ * the resources stay the wrappers, which an explicit backend would implement
+ * over its own objects. Every method but CreateCommandList() must be called
+ * on the thread of the context.
+ */
+class RenderDevice {
+public:
+  /**
+   * Destructor
+   */
+  virtual ~RenderDevice();
+
+  /**
+   * Creates a buffer named for debuggers
+   * A streaming buffer has up to that many slots in flight
+   */
+  virtual void CreateBuffer(UniformBuffer* buffer, const std::string& label,
+                            UniformBuffer::Target target,
+                            UniformBuffer::Usage usage, int slots = 3) = 0;
+
+  /**
+   * Creates a render target named for debuggers, without attachments
+   * With more than one sample the attachments are multisampled
+   */
+  virtual void CreateRenderTarget(FrameBuffer* target,
+                                  const std::string& label, int width,
+                                  int height, FrameBuffer::DepthMode depth_mode,
+                                  int samples = 0) = 0;
+
+  /**
+   * Starts building a pipeline of a vertex and, if its path isn't empty, a
+   * fragment program, with the headers inserted after their #version lines
+   * The pipeline is ready after program->FinishLink(), which throws
+   * runtime_error with the log if it doesn't build; so are the others
+   */
+  virtual void CreateGraphicsPipeline(
+      ShaderProgram* program, const std::string& vertex_path,
+      const std::string& vertex_header, const std::string& fragment_path = "",
+      const std::string& fragment_header = "") = 0;
+
+  /**
+   * Starts building a vertex stage shared by the pipelines of
+   * CreateScreenPipeline()
+   */
+  virtual void CreateVertexStage(ShaderProgram* program,
+                                 const std::string& path,
+                                 const std::string& header = "") = 0;
+
+  /**
+   * Starts building a pipeline of the fragment program and the vertex stage,
+   * which must outlive it
+   */
+  virtual void CreateScreenPipeline(
+      ShaderProgram* program, ShaderProgram* vertex_stage,
+      const std::string& fragment_path,
+      const std::string& fragment_header = "") = 0;
+
+  /**
+   * Starts building a compute pipeline
+   */
+  virtual void CreateComputePipeline(ShaderProgram* program,
+                                     const std::string& path,
+                                     const std::string& header = "") = 0;
+
+  /**
+   * Creates an empty command list, which may be recorded on any thread
+   */
+  virtual std::unique_ptr<CommandList> CreateCommandList() = 0;
+};
+
+#endif
@@ -0,0 +1,378 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <set>
+#include <stdexcept>
+
+#include "FrameBuffer.h"
+#include "GLCheck.h"
+#include "GLDebug.h"
+#include "GpuTimer.h"
+#include "PipelineStats.h"
+#include "RenderGraph.h"
+
+const char* RenderGraph::BACKBUFFER = "backbuffer";
+
+RenderGraph::RenderGraph()
+    : pool_(nullptr),
+      timer_(nullptr),
+      stats_(nullptr),
+      output_(nullptr),
+      compiled_(false),
+      width_(16),
+      height_(16) {
+  resources_[BACKBUFFER] = {BACKBUFFER_RESOURCE, nullptr, 0, 1.0f, 0};
+}
+
+void RenderGraph::Init(RenderTargetPool* pool) { pool_ = pool; }
+
+void RenderGraph::SetTimer(GpuTimer* timer) { timer_ = timer; }
+
+void RenderGraph::SetPipelineStats(PipelineStats* stats) { stats_ = stats; }
+
+void RenderGraph::ImportFrameBuffer(const std::string& name,
+                                    FrameBuffer* framebuffer, int attachment) {
+  resources_[name] = {IMPORTED, framebuffer, 0, 1.0f, attachment};
+  compiled_ = false;
+}
+
+void RenderGraph::AddTransient(const std::string& name, int internal_format,
+                               float scale) {
+  resources_[name] = {TRANSIENT, nullptr, internal_format, scale, 0};
+  compiled_ = false;
+}
+
+void RenderGraph::AddPass(const std::string& name,
+                          const std::vector<std::string>& reads,
+                          const std::string& target, int clear,
+                          std::function<void()> execute) {
+  for (auto& resource : reads)
+    if (!resources_.count(resource))
+      throw std::runtime_error("pass " + name + " reads unknown resource " +
+                               resource);
+  if (!resources_.count(target))
+    throw std::runtime_error("pass " + name + " writes unknown resource " +
+                             target);
+  passes_.push_back({name, reads, target, clear, execute, true});
+  compiled_ = false;
+}
+
+void RenderGraph::AddCopyPass(const std::string& name,
+                              const std::string& source) {
+  AddPass(name, {source}, BACKBUFFER, CLEAR_NONE,
+          [this, source]() { CopyToBackbuffer(Resolve(source)); });
+}
+
+void RenderGraph::SetPassEnabled(const std::string& name, bool enabled) {
+  for (auto& pass : passes_) {
+    if (pass.name == name && pass.enabled != enabled) {
+      pass.enabled = enabled;
+      compiled_ = false;
+    }
+  }
+}
+
+bool RenderGraph::HasPass(const std::string& name) {
+  for (auto& pass : passes_)
+    if (pass.name == name) return true;
+  return false;
+}
+
+bool RenderGraph::IsPassEnabled(const std::string& name) {
+  for (auto& pass : passes_)
+    if (pass.name == name) return pass.enabled;
+  return false;
+}
+
+void RenderGraph::SetOutputSize(int width, int height) {
+  width_ = width;
+  height_ = height;
+}
+
+void RenderGraph::SetOutputFrameBuffer(FrameBuffer* framebuffer) {
+  output_ = framebuffer;
+}
+
+void RenderGraph::Execute() {
+  if (!compiled_)
+    Compile();
+
+  for (auto& step : steps_) {
+    for (auto& name : step.acquires) {
+      int width, height;
+      GetSize(name, &width, &height);
+      acquired_[name] = pool_->Acquire(resources_[name].internal_format,
+                                       width, height);
+    }
+    if (step.pass < 0) {
+      static const std::string copy_name = "copy to " + std::string(BACKBUFFER);
+      GLDebug::PushGroup(copy_name);
+      BindBackbuffer();
+      InvalidateDrawFrameBuffer(!output_, CLEAR_ALL);
+      CopyToBackbuffer(step.reads[0]);
+    } else {
+      auto& name = passes_[step.pass].name;
+      GLDebug::PushGroup(name);
+      BindTarget(step);
+      if (timer_)
+        timer_->Begin(name);
+      if (stats_)
+        stats_->Begin(name);
+      passes_[step.pass].execute();
+      if (stats_)
+        stats_->End();
+      if (timer_)
+        timer_->End();
+    }
+    for (auto& name : step.releases)
+      StoreResource(name);
+    GLDebug::PopGroup();
+  }
+
+  // Only the color of the backbuffer is presented
+  BindBackbuffer();
+  InvalidateDrawFrameBuffer(!output_, CLEAR_DEPTH | CLEAR_STENCIL);
+}
+
+unsigned int RenderGraph::GetTexture(const std::string& name) {
+  auto resolved = Resolve(name);
+  auto& resource = resources_[resolved];
+  if (resource.type == IMPORTED)
+    return resource.framebuffer->GetTextures()[resource.attachment];
+  auto target = acquired_.find(resolved);
+  if (target == acquired_.end())
+    throw std::runtime_error("resource " + name + " isn't alive");
+  return target->second.texture;
+}
+
+void RenderGraph::GetSize(const std::string& name, int* width, int* height) {
+  auto& resource = resources_[Resolve(name)];
+  if (resource.type == IMPORTED) {
+    *width = resource.framebuffer->GetWidth();
+    *height = resource.framebuffer->GetHeight();
+  } else {
+    *width = std::max(1, (int)(width_ * resource.scale));
+    *height = std::max(1, (int)(height_ * resource.scale));
+  }
+}
+
+void RenderGraph::Print() {
+  if (!compiled_)
+    Compile();
+  printf("render graph:\n");
+  for (auto& step : steps_) {
+    auto name = step.pass < 0 ? "copy" : passes_[step.pass].name.c_str();
+    printf("  %-12s", name);
+    for (auto& read : step.reads)
+      printf(" %s", read.c_str());
+    printf(" -> %s%s\n", step.target.c_str(),
+           step.first_write ? " (load)" : "");
+  }
+}
+
+void RenderGraph::Compile() {
+  // Bypasses the disabled passes; the ones that read their own target leave
+  // it as it is
+  aliases_.clear();
+  for (auto& pass : passes_)
+    if (!pass.enabled && !pass.reads.empty() && pass.reads[0] != pass.target)
+      aliases_[pass.target] = pass.reads[0];
+
+  std::vector<int> active;
+  for (size_t i = 0; i < passes_.size(); ++i)
+    if (passes_[i].enabled) active.push_back(i);
+
+  // Orders the passes: readers after writers, writers of the same resource in
+  // the order they were added
+  std::map<int, std::set<int>> dependencies;
+  for (auto p : active) {
+    auto& pass = passes_[p];
+    for (auto q : active) {
+      if (p == q) continue;
+      auto& other = passes_[q];
+      bool writes_input = false;
+      for (auto& read : pass.reads)
+        writes_input |= Resolve(read) == other.target;
+      bool same_target = other.target == pass.target;
+      if ((writes_input && !(same_target && q > p)) || (same_target && q < p))
+        dependencies[p].insert(q);
+    }
+  }
+  std::vector<int> order;
+  std::set<int> done;
+  while (order.size() < active.size()) {
+    int next = -1;
+    for (auto p : active) {
+      if (done.count(p)) continue;
+      bool ready = true;
+      for (auto q : dependencies[p])
+        ready &= done.count(q) > 0;
+      if (ready) {
+        next = p;
+        break;
+      }
+    }
+    if (next < 0)
+      throw std::runtime_error("the render graph has a cycle");
+    order.push_back(next);
+    done.insert(next);
+  }
+
+  // Culls the passes that don't contribute to the backbuffer
+  auto output = Resolve(BACKBUFFER);
+  std::set<std::string> needed = {output};
+  std::vector<int> culled;
+  for (auto it = order.rbegin(); it != order.rend(); ++it) {
+    auto& pass = passes_[*it];
+    if (!needed.count(pass.target)) continue;
+    culled.push_back(*it);
+    for (auto& read : pass.reads)
+      needed.insert(Resolve(read));
+  }
+  std::reverse(culled.begin(), culled.end());
+
+  steps_.clear();
+  std::set<std::string> written;
+  for (auto p : culled) {
+    auto& pass = passes_[p];
+    Step step;
+    step.pass = p;
+    for (auto& read : pass.reads)
+      step.reads.push_back(Resolve(read));
+    step.target = pass.target;
+    step.first_write = !written.count(pass.target);
+    written.insert(pass.target);
+    steps_.push_back(step);
+  }
+  if (output != BACKBUFFER)
+    steps_.push_back({-1, {output}, BACKBUFFER, false, {}, {}});
+
+  // Lifetimes, the transients are acquired on their first use and every
+  // resource is stored after its last one
+  for (auto& resource : resources_) {
+    if (resource.second.type == BACKBUFFER_RESOURCE) continue;
+    int first = -1, last = -1;
+    for (size_t i = 0; i < steps_.size(); ++i) {
+      auto& step = steps_[i];
+      bool uses = step.target == resource.first ||
+                  std::count(step.reads.begin(), step.reads.end(),
+                             resource.first);
+      if (!uses) continue;
+      if (first < 0) first = i;
+      last = i;
+    }
+    if (first < 0) continue;
+    if (resource.second.type == TRANSIENT)
+      steps_[first].acquires.push_back(resource.first);
+    steps_[last].releases.push_back(resource.first);
+  }
+  compiled_ = true;
+}
+
+std::string RenderGraph::Resolve(const std::string& name) {
+  auto resolved = name;
+  for (auto it = aliases_.find(resolved); it != aliases_.end();
+       it = aliases_.find(resolved))
+    resolved = it->second;
+  return resolved;
+}
+
+void RenderGraph::BindTarget(const Step& step) {
+  auto& resource = resources_[step.target];
+  if (resource.type == BACKBUFFER_RESOURCE) {
+    BindBackbuffer();
+    glViewport(0, 0, width_, height_);
+  } else if (resource.type == IMPORTED) {
+    resource.framebuffer->Bind();
+  } else {
+    int width, height;
+    GetSize(step.target, &width, &height);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, acquired_[step.target].framebuffer);
+    glViewport(0, 0, width, height);
+  }
+
+  if (!step.first_write)
+    return;
+  if (resource.type == IMPORTED) {
+    resource.framebuffer->Load();
+    return;
+  }
+  int clear = passes_[step.pass].clear;
+  GLbitfield mask = 0;
+  if (clear & CLEAR_COLOR) mask |= GL_COLOR_BUFFER_BIT;
+  if (clear & CLEAR_DEPTH) mask |= GL_DEPTH_BUFFER_BIT;
+  if (clear & CLEAR_STENCIL) mask |= GL_STENCIL_BUFFER_BIT;
+  if (mask)
+    glClear(mask);
+  InvalidateDrawFrameBuffer(resource.type == BACKBUFFER_RESOURCE && !output_,
+                            CLEAR_ALL & ~clear);
+}
+
+void RenderGraph::StoreResource(const std::string& name) {
+  auto& resource = resources_[name];
+  if (resource.type == IMPORTED) {
+    resource.framebuffer->Store();
+    return;
+  }
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, acquired_[name].framebuffer);
+  InvalidateDrawFrameBuffer(false, CLEAR_ALL);
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+  pool_->Release(acquired_[name]);
+  acquired_.erase(name);
+}
+
+void RenderGraph::InvalidateDrawFrameBuffer(bool backbuffer, int buffers) {
+  // The window frame buffer names its buffers differently
+  std::vector<GLenum> attachments;
+  if (buffers & CLEAR_COLOR)
+    attachments.push_back(backbuffer ? GL_COLOR : GL_COLOR_ATTACHMENT0);
+  if (buffers & CLEAR_DEPTH)
+    attachments.push_back(backbuffer ? GL_DEPTH : GL_DEPTH_ATTACHMENT);
+  if (buffers & CLEAR_STENCIL)
+    attachments.push_back(backbuffer ? GL_STENCIL : GL_STENCIL_ATTACHMENT);
+  if (!attachments.empty())
+    glInvalidateFramebuffer(GL_DRAW_FRAMEBUFFER, attachments.size(),
+                            attachments.data());
+}
+
+void RenderGraph::CopyToBackbuffer(const std::string& source) {
+  auto& resource = resources_[source];
+  unsigned int framebuffer = resource.type == IMPORTED
+                                 ? resource.framebuffer->GetHandle()
+                                 : acquired_[source].framebuffer;
+  int width, height;
+  GetSize(source, &width, &height);
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+  glReadBuffer(GL_COLOR_ATTACHMENT0 + resource.attachment);
+  BindBackbuffer();
+  glBlitFramebuffer(0, 0, width, height, 0, 0, width_, height_,
+                    GL_COLOR_BUFFER_BIT, GL_LINEAR);
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+}
+
+void RenderGraph::BindBackbuffer() {
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, output_ ? output_->GetHandle() : 0);
+}
@@ -0,0 +1,255 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef RENDERGRAPH_H
+#define RENDERGRAPH_H
+
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "RenderTargetPool.h"
+
+class FrameBuffer;
+class GpuTimer;
+class PipelineStats;
+
+/**
+ * Frame described as passes that declare the resources they read and write
+ *
+ * Every pass renders into one target: the backbuffer, an imported frame buffer
+ * (such as the G-buffer) or a transient texture. The graph orders the passes
+ * by their dependencies, culls the ones that don't contribute to the
+ * backbuffer, takes the transient textures from the pool only while they are
+ * alive (so textures with disjoint lifetimes are aliased), and clears a target
+ * only on its first write of the frame, when the pass asks for it. Targets
+ * that aren't cleared on their first write are invalidated instead, and every
+ * target is invalidated after its last reader, so tiled GPUs neither load nor
+ * store dead contents. Imported frame buffers use their own load and store
+ * actions instead of the clear flags.
+ *
+ * Each pass runs in a debug group with its name (see GLDebug).
+ *
+ * A disabled pass is bypassed: the readers of its target read its first input
+ * instead, and if it wrote the backbuffer the input is copied to it.
+ */
+class RenderGraph {
+public:
+  /**
+   * Clears requested by the passes on the first write of their target
+   * CLEAR_NONE discards the previous contents, for passes that cover every
+   * pixel
+   */
+  enum ClearFlags {
+    CLEAR_NONE = 0,
+    CLEAR_COLOR = 1,
+    CLEAR_DEPTH = 2,
+    CLEAR_STENCIL = 4,
+    CLEAR_ALL = CLEAR_COLOR | CLEAR_DEPTH | CLEAR_STENCIL
+  };
+
+  /**
+   * Name of the window frame buffer
+   */
+  static const char* BACKBUFFER;
+
+  /**
+   * Default constructor
+   */
+  RenderGraph();
+
+  /**
+   * Sets the pool used for the transient textures
+   */
+  void Init(RenderTargetPool* pool);
+
+  /**
+   * Sets a timer for the gpu time of each pass, none if null
+   */
+  void SetTimer(GpuTimer* timer);
+
+  /**
+   * Sets the pipeline statistics counted for each pass, none if null
+   */
+  void SetPipelineStats(PipelineStats* stats);
+
+  /**
+   * Adds a frame buffer owned outside of the graph; its readers and the copy
+   * to the backbuffer use the texture of that color attachment
+   */
+  void ImportFrameBuffer(const std::string& name, FrameBuffer* framebuffer,
+                         int attachment = 0);
+
+  /**
+   * Adds a texture allocated from the pool while the passes use it
+   * The size is relative to the backbuffer
+   */
+  void AddTransient(const std::string& name, int internal_format,
+                    float scale = 1.0f);
+
+  /**
+   * Adds a pass
+   */
+  void AddPass(const std::string& name, const std::vector<std::string>& reads,
+               const std::string& target, int clear,
+               std::function<void()> execute);
+
+  /**
+   * Adds a pass that copies a resource to the backbuffer
+   * Used to present the output of compute passes
+   */
+  void AddCopyPass(const std::string& name, const std::string& source);
+
+  /**
+   * Enables or disables a pass
+   */
+  void SetPassEnabled(const std::string& name, bool enabled);
+
+  /**
+   * Returns true if the pass exists
+   */
+  bool HasPass(const std::string& name);
+
+  /**
+   * Returns true if the pass exists and is enabled
+   */
+  bool IsPassEnabled(const std::string& name);
+
+  /**
+   * Sets the backbuffer size
+   */
+  void SetOutputSize(int width, int height);
+
+  /**
+   * Draws the backbuffer into a frame buffer instead of the window, until
+   * set back to nullptr; it must have the output size and a stencil buffer
+   */
+  void SetOutputFrameBuffer(FrameBuffer* framebuffer);
+
+  /**
+   * Runs the passes
+   */
+  void Execute();
+
+  /**
+   * Obtains the texture of a transient resource (only during Execute)
+   * Bypassed resources give the texture of the resource they alias
+   */
+  unsigned int GetTexture(const std::string& name);
+
+  /**
+   * Obtains the size of a transient resource
+   */
+  void GetSize(const std::string& name, int* width, int* height);
+
+  /**
+   * Prints the compiled passes
+   */
+  void Print();
+
+private:
+  enum ResourceType { BACKBUFFER_RESOURCE, IMPORTED, TRANSIENT };
+
+  struct Resource {
+    ResourceType type;
+    FrameBuffer* framebuffer;
+    int internal_format;
+    float scale;
+    int attachment;  // read by the passes, of the imported frame buffers
+  };
+
+  struct Pass {
+    std::string name;
+    std::vector<std::string> reads;
+    std::string target;
+    int clear;
+    std::function<void()> execute;
+    bool enabled;
+  };
+
+  /**
+   * Compiled pass, with the bypassed resources already resolved
+   */
+  struct Step {
+    int pass;  // -1 for the copy to the backbuffer
+    std::vector<std::string> reads;
+    std::string target;
+    bool first_write;
+    std::vector<std::string> acquires;
+    std::vector<std::string> releases;
+  };
+
+  /**
+   * Orders the enabled passes, culls the unused ones and computes the
+   * transient lifetimes
+   */
+  void Compile();
+
+  /**
+   * Follows the aliases of disabled passes
+   */
+  std::string Resolve(const std::string& name);
+
+  /**
+   * Binds the target of a step and applies its load actions on the first
+   * write
+   */
+  void BindTarget(const Step& step);
+
+  /**
+   * Discards the contents of a resource after its last reader
+   */
+  void StoreResource(const std::string& name);
+
+  /**
+   * Discards buffers (as ClearFlags) of the bound draw frame buffer
+   */
+  static void InvalidateDrawFrameBuffer(bool backbuffer, int buffers);
+
+  /**
+   * Copies a transient texture to the backbuffer
+   */
+  void CopyToBackbuffer(const std::string& source);
+
+  /**
+   * Binds the backbuffer, the window's or the output frame buffer, to draw
+   */
+  void BindBackbuffer();
+
+  RenderTargetPool* pool_;
+  GpuTimer* timer_;
+  PipelineStats* stats_;
+  FrameBuffer* output_;  // of the backbuffer, the window's if null
+  std::map<std::string, Resource> resources_;
+  std::vector<Pass> passes_;
+  std::map<std::string, std::string> aliases_;
+  std::vector<Step> steps_;
+  std::map<std::string, RenderTargetPool::Target> acquired_;
+  bool compiled_;
+  int width_;
+  int height_;
+};
+
+#endif
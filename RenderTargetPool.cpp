@@ -0,0 +1,160 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <stdexcept>
+
+#include "GLCheck.h"
+#include "GLState.h"
+#include "GpuMemory.h"
+#include "RenderTargetPool.h"
+
+namespace {
+
+// Number of frames an unused target is kept alive
+const int MAX_IDLE_FRAMES = 3;
+
+bool IsDepthFormat(int internal_format) {
+  return internal_format == GL_DEPTH_COMPONENT16 ||
+         internal_format == GL_DEPTH_COMPONENT24 ||
+         internal_format == GL_DEPTH_COMPONENT32 ||
+         internal_format == GL_DEPTH_COMPONENT32F ||
+         internal_format == GL_DEPTH24_STENCIL8 ||
+         internal_format == GL_DEPTH32F_STENCIL8;
+}
+
+long TargetSize(const RenderTargetPool::Target& target) {
+  return (long)target.width * target.height *
+         GpuMemory::GetFormatSize(target.internal_format);
+}
+
+}  // namespace
+
+RenderTargetPool::RenderTargetPool()
+    : frame_(0),
+      allocated_bytes_(0),
+      peak_bytes_(0),
+      in_use_(0),
+      peak_in_use_(0) {}
+
+RenderTargetPool::~RenderTargetPool() {
+  for (auto& entry : entries_)
+    Destroy(entry.target);
+}
+
+RenderTargetPool::Target RenderTargetPool::Acquire(int internal_format,
+                                                   int width, int height) {
+  in_use_++;
+  peak_in_use_ = std::max(peak_in_use_, in_use_);
+  for (auto& entry : entries_) {
+    auto& target = entry.target;
+    if (!entry.in_use && target.internal_format == internal_format &&
+        target.width == width && target.height == height) {
+      entry.in_use = true;
+      entry.last_frame = frame_;
+      return target;
+    }
+  }
+  auto target = Create(internal_format, width, height);
+  entries_.push_back({target, true, frame_});
+  allocated_bytes_ += TargetSize(target);
+  peak_bytes_ = std::max(peak_bytes_, allocated_bytes_);
+  return target;
+}
+
+void RenderTargetPool::Release(const Target& target) {
+  for (auto& entry : entries_) {
+    if (entry.target.texture == target.texture) {
+      if (!entry.in_use)
+        throw std::runtime_error("render target released twice");
+      entry.in_use = false;
+      entry.last_frame = frame_;
+      in_use_--;
+      return;
+    }
+  }
+  throw std::runtime_error("render target doesn't belong to the pool");
+}
+
+void RenderTargetPool::BeginFrame() {
+  frame_++;
+  for (size_t i = 0; i < entries_.size();) {
+    auto& entry = entries_[i];
+    if (!entry.in_use && frame_ - entry.last_frame > MAX_IDLE_FRAMES) {
+      allocated_bytes_ -= TargetSize(entry.target);
+      Destroy(entry.target);
+      entries_[i] = entries_.back();
+      entries_.pop_back();
+    } else {
+      ++i;
+    }
+  }
+}
+
+long RenderTargetPool::GetAllocatedBytes() { return allocated_bytes_; }
+
+long RenderTargetPool::GetPeakBytes() { return peak_bytes_; }
+
+int RenderTargetPool::GetTargetsInUse() { return in_use_; }
+
+int RenderTargetPool::GetPeakTargetsInUse() { return peak_in_use_; }
+
+void RenderTargetPool::PrintStats() {
+  printf("render targets: %d allocated (%.1f MB), peak %d in use (%.1f MB)\n",
+         (int)entries_.size(), allocated_bytes_ / 1048576.0, peak_in_use_,
+         peak_bytes_ / 1048576.0);
+}
+
+RenderTargetPool::Target RenderTargetPool::Create(int internal_format,
+                                                  int width, int height) {
+  Target target = {0, 0, internal_format, width, height};
+  // Created without binding, so the texture units of GLState stay valid
+  glCreateTextures(GL_TEXTURE_2D, 1, &target.texture);
+  glTextureParameteri(target.texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTextureParameteri(target.texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTextureParameteri(target.texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTextureParameteri(target.texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glTextureStorage2D(target.texture, 1, internal_format, width, height);
+
+  auto attachment = IsDepthFormat(internal_format) ? GL_DEPTH_ATTACHMENT
+                                                   : GL_COLOR_ATTACHMENT0;
+  glGenFramebuffers(1, &target.framebuffer);
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, target.framebuffer);
+  glFramebufferTexture(GL_DRAW_FRAMEBUFFER, attachment, target.texture, 0);
+  if (attachment == GL_DEPTH_ATTACHMENT)
+    glDrawBuffer(GL_NONE);
+  auto status = glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER);
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+  if (status != GL_FRAMEBUFFER_COMPLETE)
+    throw std::runtime_error("Couldn't create the render target");
+  GpuMemory::Allocate(GpuMemory::RENDER_TARGETS, TargetSize(target));
+  return target;
+}
+
+void RenderTargetPool::Destroy(const Target& target) {
+  GpuMemory::Free(GpuMemory::RENDER_TARGETS, TargetSize(target));
+  glDeleteFramebuffers(1, &target.framebuffer);
+  GLState::DeleteTextures(1, &target.texture);
+}
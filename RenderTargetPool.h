@@ -0,0 +1,119 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef RENDERTARGETPOOL_H
+#define RENDERTARGETPOOL_H
+
+#include <vector>
+
+/**
+ * Pool of transient render targets
+ *
+ * Each target is a texture attached to its own frame buffer. Released targets
+ * are handed out again to requests with the same format and size, in the same
+ * frame or in the next ones, and are only deleted after staying unused for a
+ * few frames.
+ */
+class RenderTargetPool {
+public:
+  /**
+   * Texture and frame buffer handed out by the pool
+   */
+  struct Target {
+    unsigned int texture;
+    unsigned int framebuffer;
+    int internal_format;
+    int width;
+    int height;
+  };
+
+  /**
+   * Default constructor
+   */
+  RenderTargetPool();
+
+  /**
+   * Destructor, deletes every target
+   */
+  ~RenderTargetPool();
+
+  /**
+   * Obtains a target with the given format and size
+   * Depth formats are attached as depth, the others as color attachment 0
+   */
+  Target Acquire(int internal_format, int width, int height);
+
+  /**
+   * Gives the target back to the pool
+   */
+  void Release(const Target& target);
+
+  /**
+   * Starts a new frame, deletes the targets unused for a while
+   */
+  void BeginFrame();
+
+  /**
+   * Obtains the memory used by the targets, in bytes
+   */
+  long GetAllocatedBytes();
+  long GetPeakBytes();
+
+  /**
+   * Obtains the number of targets in use (now and at the peak)
+   */
+  int GetTargetsInUse();
+  int GetPeakTargetsInUse();
+
+  /**
+   * Prints the pool usage
+   */
+  void PrintStats();
+
+private:
+  struct Entry {
+    Target target;
+    bool in_use;
+    int last_frame;
+  };
+
+  /**
+   * Creates the texture and the frame buffer of a target
+   */
+  Target Create(int internal_format, int width, int height);
+
+  /**
+   * Deletes the gl objects of a target
+   */
+  void Destroy(const Target& target);
+
+  std::vector<Entry> entries_;
+  int frame_;
+  long allocated_bytes_;
+  long peak_bytes_;
+  int in_use_;
+  int peak_in_use_;
+};
+
+#endif
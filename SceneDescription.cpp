@@ -0,0 +1,290 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtx/transform.hpp>
+
+#include "SceneDescription.h"
+
+namespace {
+
+// Changes whenever the layout of the binary file does
+const uint32_t VERSION = 1;
+
+// Start of every binary file, followed by the models, the lights, the
+// materials and the cameras
+struct Header {
+  char magic[4];
+  uint32_t version;
+  uint32_t n_instances;
+  uint32_t n_lights;
+  uint32_t n_materials;
+  uint32_t n_cameras;
+  float ambient[3];
+  float ground_height;
+  float ground_half_size;
+  uint32_t reserved;  // keeps the arrays 16 bytes aligned
+};
+
+const char MAGIC[4] = {'S', 'C', 'N', 'E'};
+
+// Reads the values of a record of a text file; false if any is missing
+template <typename T>
+bool ReadValues(std::istringstream& line, T* values, int n) {
+  for (int i = 0; i < n; ++i)
+    if (!(line >> values[i]))
+      return false;
+  return true;
+}
+
+}  // namespace
+
+SceneDescription::SceneDescription()
+    : mapping_(nullptr),
+      size_(0),
+      ambient_(0.0f),
+      ground_height_(0.0f),
+      ground_half_size_(0.0f) {}
+
+SceneDescription::~SceneDescription() { Close(); }
+
+void SceneDescription::Load(const std::string& path) {
+  Close();
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    throw std::runtime_error("Unable to open file: " + path);
+  struct stat info;
+  if (fstat(fd, &info) == 0 && info.st_size > 0) {
+    size_ = info.st_size;
+    mapping_ = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapping_ == MAP_FAILED)
+      mapping_ = nullptr;
+  }
+  // The mapping stays valid once the descriptor is closed
+  close(fd);
+  if (!mapping_) {
+    Close();
+    throw std::runtime_error("Unable to read file: " + path);
+  }
+
+  // The text form is parsed and the mapping dropped
+  auto header = (const Header*)mapping_;
+  if (size_ < sizeof(MAGIC) ||
+      memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0) {
+    std::string text((const char*)mapping_, size_);
+    Close();
+    ParseText(text, path);
+    return;
+  }
+
+  bool valid = size_ >= sizeof(Header) && header->version == VERSION &&
+               header->n_materials > 0 && header->n_cameras > 0;
+  if (valid) {
+    size_t expected = sizeof(Header) +
+                      header->n_instances * sizeof(glm::mat4) +
+                      header->n_lights * sizeof(LightTransform::SpotLight) +
+                      header->n_materials * sizeof(ObjMaterial) +
+                      header->n_cameras * sizeof(Camera);
+    valid = expected == size_;
+  }
+  if (!valid) {
+    Close();
+    throw std::runtime_error("Invalid scene file: " + path);
+  }
+  ambient_ = glm::vec3(header->ambient[0], header->ambient[1],
+                       header->ambient[2]);
+  ground_height_ = header->ground_height;
+  ground_half_size_ = header->ground_half_size;
+  auto models = (const glm::mat4*)(header + 1);
+  models_.Map(models, header->n_instances);
+  auto lights = (const LightTransform::SpotLight*)(models + models_.size);
+  lights_.Map(lights, header->n_lights);
+  auto materials = (const ObjMaterial*)(lights + lights_.size);
+  materials_.Map(materials, header->n_materials);
+  auto cameras = (const Camera*)(materials + materials_.size);
+  cameras_.Map(cameras, header->n_cameras);
+}
+
+void SceneDescription::Write(const std::string& path) {
+  Header header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, MAGIC, sizeof(MAGIC));
+  header.version = VERSION;
+  header.n_instances = models_.size;
+  header.n_lights = lights_.size;
+  header.n_materials = materials_.size;
+  header.n_cameras = cameras_.size;
+  for (int i = 0; i < 3; ++i)
+    header.ambient[i] = ambient_[i];
+  header.ground_height = ground_height_;
+  header.ground_half_size = ground_half_size_;
+
+  std::ofstream output(path, std::ios::binary | std::ios::trunc);
+  output.write((const char*)&header, sizeof(header));
+  output.write((const char*)models_.data, models_.size * sizeof(glm::mat4));
+  output.write((const char*)lights_.data,
+               lights_.size * sizeof(LightTransform::SpotLight));
+  output.write((const char*)materials_.data,
+               materials_.size * sizeof(ObjMaterial));
+  output.write((const char*)cameras_.data, cameras_.size * sizeof(Camera));
+  output.close();
+  if (!output)
+    throw std::runtime_error("Unable to write file: " + path);
+}
+
+void SceneDescription::SetAmbient(const glm::vec3& ambient) {
+  ambient_ = ambient;
+}
+
+void SceneDescription::SetGround(float height, float half_size) {
+  ground_height_ = height;
+  ground_half_size_ = half_size;
+}
+
+void SceneDescription::AddInstance(const glm::mat4& model) {
+  models_.Add(model);
+}
+
+void SceneDescription::AddLight(const LightTransform::SpotLight& light) {
+  lights_.Add(light);
+}
+
+void SceneDescription::AddMaterial(const ObjMaterial& material) {
+  materials_.Add(material);
+}
+
+void SceneDescription::AddCamera(const Camera& camera) {
+  cameras_.Add(camera);
+}
+
+glm::vec3 SceneDescription::GetAmbient() { return ambient_; }
+
+float SceneDescription::GetGroundHeight() { return ground_height_; }
+
+float SceneDescription::GetGroundHalfSize() { return ground_half_size_; }
+
+int SceneDescription::GetInstanceCount() { return models_.size; }
+
+const glm::mat4* SceneDescription::GetModels() { return models_.data; }
+
+int SceneDescription::GetLightCount() { return lights_.size; }
+
+const LightTransform::SpotLight* SceneDescription::GetLights() {
+  return lights_.data;
+}
+
+int SceneDescription::GetMaterialCount() { return materials_.size; }
+
+const ObjMaterial* SceneDescription::GetMaterials() { return materials_.data; }
+
+int SceneDescription::GetCameraCount() { return cameras_.size; }
+
+const SceneDescription::Camera* SceneDescription::GetCameras() {
+  return cameras_.data;
+}
+
+void SceneDescription::ParseText(const std::string& text,
+                                 const std::string& path) {
+  std::istringstream input(text);
+  std::string line_text;
+  for (int line_number = 1; std::getline(input, line_text); ++line_number) {
+    auto comment = line_text.find('#');
+    if (comment != std::string::npos)
+      line_text.resize(comment);
+    std::istringstream line(line_text);
+    std::string record;
+    if (!(line >> record))
+      continue;
+
+    float values[16];
+    bool valid = false;
+    if (record == "ambient") {
+      valid = ReadValues(line, values, 3);
+      ambient_ = glm::vec3(values[0], values[1], values[2]);
+    } else if (record == "ground") {
+      valid = ReadValues(line, values, 2);
+      SetGround(values[0], values[1]);
+    } else if (record == "material") {
+      ObjMaterial material;
+      valid = ReadValues(line, material.diffuse, 3) &&
+              ReadValues(line, material.ambient, 3) &&
+              ReadValues(line, material.specular, 3) &&
+              ReadValues(line, &material.shininess, 1);
+      AddMaterial(material);
+    } else if (record == "camera") {
+      valid = ReadValues(line, values, 9);
+      AddCamera({glm::vec3(values[0], values[1], values[2]),
+                 glm::vec3(values[3], values[4], values[5]),
+                 glm::vec3(values[6], values[7], values[8])});
+    } else if (record == "instance") {
+      valid = ReadValues(line, values, 4);
+      auto position = glm::vec3(values[0], values[1], values[2]);
+      auto rotation = glm::rotate(glm::radians(values[3]), glm::vec3(0, 1, 0));
+      AddInstance(glm::translate(position) * rotation);
+    } else if (record == "light") {
+      valid = ReadValues(line, values, 13);
+      auto cone = glm::packHalf2x16(glm::vec2(values[11], values[12]));
+      AddLight({glm::vec3(values[0], values[1], values[2]), values[3],
+                glm::vec3(values[4], values[5], values[6]), values[7],
+                glm::normalize(glm::vec3(values[8], values[9], values[10])),
+                cone});
+    }
+    std::string extra;
+    if (!valid || line >> extra) {
+      throw std::runtime_error("Invalid scene record at " + path + ":" +
+                               std::to_string(line_number) + ": " +
+                               line_text);
+    }
+  }
+  if (!materials_.size || !cameras_.size) {
+    throw std::runtime_error("The scene needs a material and a camera: " +
+                             path);
+  }
+}
+
+void SceneDescription::Close() {
+  if (mapping_)
+    munmap(mapping_, size_);
+  mapping_ = nullptr;
+  size_ = 0;
+  ambient_ = glm::vec3(0.0f);
+  ground_height_ = 0.0f;
+  ground_half_size_ = 0.0f;
+  models_ = Array<glm::mat4>();
+  lights_ = Array<LightTransform::SpotLight>();
+  materials_ = Array<ObjMaterial>();
+  cameras_ = Array<Camera>();
+}
@@ -0,0 +1,185 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef SCENEDESCRIPTION_H
+#define SCENEDESCRIPTION_H
+
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "LightTransform.h"
+#include "ObjLoader.h"
+
+/**
+ * What the application draws: the bear instances, the spot lights, the
+ * materials of the ground and the camera presets
+ *
+ * Each kind is a single array in the layout its buffer takes, so the
+ * instances and the lights go to the gpu in one copy: the model matrices of
+ * ModelsBlock, the LightTransform spot lights and the ObjMaterial the
+ * materials buffer is built from. The binary file is those arrays after a
+ * header, memory mapped, so loading it does no parsing; the text file has a
+ * line per element, and Write() converts it. A scene is read from either
+ * file or built with the Add methods.
+ *
+ * The text form has one record per line, # starts a comment:
+ *
+ *     ambient <r> <g> <b>
+ *     ground <height> <half size>
+ *     material <diffuse rgb> <ambient rgb> <specular rgb> <shininess>
+ *     camera <eye xyz> <center xyz> <up xyz>
+ *     instance <position xyz> <rotation about y in degrees>
+ *     light <position xyz> <range> <diffuse rgb> <specular> <direction xyz>
+ *           <cutoff cosine> <exponent>
+ *
+ * The first material is the one of the ground, and there is at least one
+ * material and one camera.
+ */
+class SceneDescription {
+public:
+  /**
+   * Camera preset
+   */
+  struct Camera {
+    glm::vec3 eye;
+    glm::vec3 center;
+    glm::vec3 up;
+  };
+
+  /**
+   * Default constructor, an empty scene
+   */
+  SceneDescription();
+
+  /**
+   * Destructor, unmaps the file
+   */
+  ~SceneDescription();
+
+  /**
+   * Replaces the scene with a binary or a text scene file
+   * Throws runtime_error if the file can't be read or is invalid
+   */
+  void Load(const std::string& path);
+
+  /**
+   * Writes the scene to a binary file
+   * Throws runtime_error if the file can't be written
+   */
+  void Write(const std::string& path);
+
+  /**
+   * Sets the global ambient light
+   */
+  void SetAmbient(const glm::vec3& ambient);
+
+  /**
+   * Sets the height and the half size of the ground, a square centered on
+   * the origin
+   */
+  void SetGround(float height, float half_size);
+
+  /**
+   * Appends an element of the scene
+   */
+  void AddInstance(const glm::mat4& model);
+  void AddLight(const LightTransform::SpotLight& light);
+  void AddMaterial(const ObjMaterial& material);
+  void AddCamera(const Camera& camera);
+
+  /**
+   * Obtains the global ambient light
+   */
+  glm::vec3 GetAmbient();
+
+  /**
+   * Obtains the height and the half size of the ground
+   */
+  float GetGroundHeight();
+  float GetGroundHalfSize();
+
+  /**
+   * Obtains the number of elements of a kind and the array of them
+   */
+  int GetInstanceCount();
+  const glm::mat4* GetModels();
+  int GetLightCount();
+  const LightTransform::SpotLight* GetLights();
+  int GetMaterialCount();
+  const ObjMaterial* GetMaterials();
+  int GetCameraCount();
+  const Camera* GetCameras();
+
+private:
+  // Elements of a kind, in the mapping of a binary file until one is added
+  template <typename T>
+  struct Array {
+    std::vector<T> owned;
+    const T* data;
+    size_t size;
+
+    Array() : data(nullptr), size(0) {}
+
+    // Appends an element, copying the mapped ones first
+    void Add(const T& element) {
+      if (data != owned.data())
+        owned.assign(data, data + size);
+      owned.push_back(element);
+      data = owned.data();
+      size = owned.size();
+    }
+
+    // Refers to mapped elements
+    void Map(const T* elements, size_t n) {
+      owned.clear();
+      data = elements;
+      size = n;
+    }
+  };
+
+  /**
+   * Parses a text scene file into empty arrays
+   * Throws runtime_error at the first invalid line
+   */
+  void ParseText(const std::string& text, const std::string& path);
+
+  /**
+   * Empties the scene and unmaps the file, if any
+   */
+  void Close();
+
+  void* mapping_;
+  size_t size_;
+  glm::vec3 ambient_;
+  float ground_height_;
+  float ground_half_size_;
+  Array<glm::mat4> models_;
+  Array<LightTransform::SpotLight> lights_;
+  Array<ObjMaterial> materials_;
+  Array<Camera> cameras_;
+};
+
+#endif
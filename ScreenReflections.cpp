@@ -0,0 +1,155 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <string>
+
+#include "GLCheck.h"
+#include "GLState.h"
+#include "GpuMemory.h"
+#include "ScreenReflections.h"
+
+namespace {
+
+// Threads per side of the work groups of the shader
+const int GROUP_SIZE = 8;
+
+// Format of the reflections, and of the lit image they read
+const int FORMAT = GL_RGBA16F;
+
+// Weight of the history in the blend
+const float HISTORY_WEIGHT = 0.8f;
+
+}  // namespace
+
+ScreenReflections::ScreenReflections()
+    : history_(0),
+      lit_(0),
+      lit_framebuffer_(0),
+      history_valid_(false),
+      lit_valid_(false),
+      frame_(0),
+      size_(0, 0),
+      allocated_bytes_(0) {}
+
+ScreenReflections::~ScreenReflections() {
+  if (lit_framebuffer_)
+    glDeleteFramebuffers(1, &lit_framebuffer_);
+  if (history_) {
+    unsigned int textures[] = {history_, lit_};
+    GLState::DeleteTextures(2, textures);
+  }
+  GpuMemory::Free(GpuMemory::RENDER_TARGETS, allocated_bytes_);
+}
+
+void ScreenReflections::Init(const std::string& gbuffer_code) {
+  auto header = ShaderProgram::GenerateDefines(
+      {{"GROUP_SIZE", std::to_string(GROUP_SIZE)}});
+  trace_shader_.LoadComputeShader("shaders/ssr_cs.glsl",
+                                  header + gbuffer_code);
+  trace_shader_.LinkShader();
+  pyramid_.Init(0, true);
+  glCreateFramebuffers(1, &lit_framebuffer_);
+}
+
+glm::ivec2 ScreenReflections::GetSize(FrameBuffer* gbuffer) {
+  return glm::max(glm::ivec2(gbuffer->GetWidth(), gbuffer->GetHeight()) / 2,
+                  glm::ivec2(1));
+}
+
+void ScreenReflections::Trace(FrameBuffer* gbuffer, const glm::mat4& view,
+                              const glm::mat4& projection,
+                              unsigned int output) {
+  auto size = GetSize(gbuffer);
+  if (size != size_)
+    Allocate(size);
+  pyramid_.Build(gbuffer, projection * view);
+
+  // The pyramid and the textures of the last frame follow the G-buffer
+  trace_shader_.Enable();
+  gbuffer->BindTextures(0);
+  int unit = gbuffer->GetTextures().size() + 1;
+  pyramid_.Bind(&trace_shader_, unit);
+  unsigned int textures[] = {lit_, history_};
+  unsigned int samplers[] = {0, 0};
+  GLState::BindTextures(unit + 1, 2, textures);
+  GLState::BindSamplers(unit + 1, 2, samplers);
+  trace_shader_.SetUniform("inv_projection", glm::inverse(projection));
+  trace_shader_.SetUniform(
+      "gbuffer_size", glm::vec2(gbuffer->GetWidth(), gbuffer->GetHeight()));
+  trace_shader_.SetUniform("reflection_size", glm::vec2(size_));
+  trace_shader_.SetUniform("projection", projection);
+  trace_shader_.SetUniform("reprojection",
+                           lit_view_projection_ * glm::inverse(view));
+  trace_shader_.SetUniform("lit_weight", lit_valid_ ? 1.0f : 0.0f);
+  trace_shader_.SetUniform("history_weight",
+                           history_valid_ ? HISTORY_WEIGHT : 0.0f);
+  trace_shader_.SetUniform("frame", frame_++);
+  glBindImageTexture(0, output, 0, GL_FALSE, 0, GL_WRITE_ONLY, FORMAT);
+  trace_shader_.SetUniform("target_image", 0);
+  glDispatchCompute((size_.x + GROUP_SIZE - 1) / GROUP_SIZE,
+                    (size_.y + GROUP_SIZE - 1) / GROUP_SIZE, 1);
+  glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT |
+                  GL_TEXTURE_UPDATE_BARRIER_BIT);
+
+  glCopyImageSubData(output, GL_TEXTURE_2D, 0, 0, 0, 0, history_,
+                     GL_TEXTURE_2D, 0, 0, 0, 0, size_.x, size_.y, 1);
+  history_valid_ = true;
+}
+
+void ScreenReflections::StoreLitImage(FrameBuffer* lit,
+                                      const glm::mat4& view_projection) {
+  if (!lit_)
+    return;
+  glBlitNamedFramebuffer(lit->GetHandle(), lit_framebuffer_, 0, 0,
+                         lit->GetWidth(), lit->GetHeight(), 0, 0, size_.x,
+                         size_.y, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+  lit_view_projection_ = view_projection;
+  lit_valid_ = true;
+}
+
+void ScreenReflections::Allocate(glm::ivec2 size) {
+  if (history_) {
+    unsigned int textures[] = {history_, lit_};
+    GLState::DeleteTextures(2, textures);
+  }
+  GpuMemory::Free(GpuMemory::RENDER_TARGETS, allocated_bytes_);
+  size_ = size;
+  unsigned int textures[2];
+  glCreateTextures(GL_TEXTURE_2D, 2, textures);
+  for (auto texture : textures) {
+    glTextureStorage2D(texture, 1, FORMAT, size.x, size.y);
+    glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTextureParameteri(texture, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTextureParameteri(texture, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  }
+  history_ = textures[0];
+  lit_ = textures[1];
+  glNamedFramebufferTexture(lit_framebuffer_, GL_COLOR_ATTACHMENT0, lit_, 0);
+  allocated_bytes_ = 2L * size.x * size.y * GpuMemory::GetFormatSize(FORMAT);
+  GpuMemory::Allocate(GpuMemory::RENDER_TARGETS, allocated_bytes_);
+  // The old contents don't match the new size
+  history_valid_ = false;
+  lit_valid_ = false;
+}
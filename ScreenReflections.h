@@ -0,0 +1,113 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef SCREENREFLECTIONS_H
+#define SCREENREFLECTIONS_H
+
+#include <string>
+
+#include <glm/glm.hpp>
+
+#include "DepthPyramid.h"
+#include "FrameBuffer.h"
+#include "ShaderProgram.h"
+
+/**
+ * Reflections of the glossy surfaces traced in screen space, at half the
+ * resolution of the G-buffer
+ *
+ * Every texel takes one pixel of its 2x2 block and, if its material is
+ * glossy, marches the reflected ray through a pyramid of the closest depths
+ * of the G-buffer: the ray climbs a level each time it leaves a texel it
+ * stays in front of, and goes down one when it reaches the depth of a texel,
+ * so empty space is crossed in a few steps whatever the geometry (see
+ * shaders/ssr_cs.glsl). The hit reads the lit image of the last frame,
+ * reprojected, since the current one isn't lit yet. Each texel stores the
+ * reflected light weighted by a confidence that fades at the edges of the
+ * screen and with the distance, and the confidence, blended with the
+ * reprojected reflections of the last frame; the lighting falls back to the
+ * ambient light for the rest (see shaders/reflections_fs.glsl). The cost
+ * only depends on the size of the G-buffer.
+ */
+class ScreenReflections {
+public:
+  /**
+   * Default constructor
+   */
+  ScreenReflections();
+
+  /**
+   * Destructor
+   */
+  ~ScreenReflections();
+
+  /**
+   * Creates the shaders; the tracing reads the G-buffer with the code
+   * generated by its layout (see GBufferLayout) and the materials
+   * Throws runtime_error if a shader doesn't compile
+   */
+  void Init(const std::string& gbuffer_code);
+
+  /**
+   * Obtains the size of the reflections of a G-buffer, half of it rounded
+   * down
+   */
+  static glm::ivec2 GetSize(FrameBuffer* gbuffer);
+
+  /**
+   * Traces the reflections of the G-buffer, rendered with the view and the
+   * projection, into the lower left rectangle of the size above of a texture
+   * of the format GL_RGBA16F; binds its textures from the unit zero
+   * The history is reallocated, and lost, when the size of the frame buffer
+   * changes
+   */
+  void Trace(FrameBuffer* gbuffer, const glm::mat4& view,
+             const glm::mat4& projection, unsigned int output);
+
+  /**
+   * Keeps a downsampled copy of the lit image of a frame rendered with the
+   * view projection, for the hits of the next one
+   */
+  void StoreLitImage(FrameBuffer* lit, const glm::mat4& view_projection);
+
+private:
+  /**
+   * Creates the history textures of a size
+   */
+  void Allocate(glm::ivec2 size);
+
+  ShaderProgram trace_shader_;
+  DepthPyramid pyramid_;  // closest depths of the G-buffer
+  unsigned int history_;  // reflections of the last frame
+  unsigned int lit_;      // lit image of the last frame
+  unsigned int lit_framebuffer_;
+  glm::mat4 lit_view_projection_;
+  bool history_valid_;
+  bool lit_valid_;
+  int frame_;
+  glm::ivec2 size_;
+  long allocated_bytes_;
+};
+
+#endif
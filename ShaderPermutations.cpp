@@ -0,0 +1,166 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#include "ShaderPermutations.h"
+
+ShaderPermutations::ShaderPermutations() : vertex_program_(nullptr) {}
+
+void ShaderPermutations::Init(const std::string& vertex_path,
+                              const std::string& fragment_path,
+                              const std::string& header) {
+  vertex_program_ = nullptr;
+  vertex_path_ = vertex_path;
+  fragment_path_ = fragment_path;
+  compute_path_.clear();
+  header_ = header;
+  programs_.clear();
+  requested_.clear();
+}
+
+void ShaderPermutations::Init(ShaderProgram* vertex_program,
+                              const std::string& fragment_path,
+                              const std::string& header) {
+  vertex_program_ = vertex_program;
+  vertex_path_.clear();
+  fragment_path_ = fragment_path;
+  compute_path_.clear();
+  header_ = header;
+  programs_.clear();
+  requested_.clear();
+}
+
+void ShaderPermutations::InitCompute(const std::string& compute_path,
+                                     const std::string& header) {
+  vertex_program_ = nullptr;
+  vertex_path_.clear();
+  fragment_path_.clear();
+  compute_path_ = compute_path;
+  header_ = header;
+  programs_.clear();
+  requested_.clear();
+}
+
+void ShaderPermutations::Prepare(const ShaderProgram::Defines& defines) {
+  // The definitions are sorted, so equal sets have the same key
+  auto key = ShaderProgram::GenerateDefines(defines);
+  if (programs_.count(key))
+    return;
+
+  std::unique_ptr<ShaderProgram> program(new ShaderProgram());
+  auto header = key + header_;
+  if (vertex_program_) {
+    program->SetVertexProgram(vertex_program_);
+    program->LoadFragmentShader(fragment_path_, header);
+  } else if (compute_path_.empty()) {
+    program->LoadVertexShader(vertex_path_, header);
+    program->LoadFragmentShader(fragment_path_, header);
+  } else {
+    program->LoadComputeShader(compute_path_, header);
+  }
+  program->BeginLink();
+  programs_[key] = std::move(program);
+}
+
+ShaderProgram* ShaderPermutations::Get(const ShaderProgram::Defines& defines) {
+  Prepare(defines);
+  auto key = ShaderProgram::GenerateDefines(defines);
+  requested_[key] = defines;
+  auto it = programs_.find(key);
+
+  // A built program stays in use while it's rebuilt; the rebuild is finished
+  // by whoever started it with ShaderProgram::Reload()
+  if (it->second->IsLinked())
+    return it->second.get();
+  try {
+    it->second->FinishLink();
+  } catch (std::exception&) {
+    programs_.erase(it);
+    throw;
+  }
+  return it->second.get();
+}
+
+ShaderProgram* ShaderPermutations::GetReady(
+    const ShaderProgram::Defines& defines,
+    const ShaderProgram::Defines& fallback) {
+  Prepare(defines);
+  auto key = ShaderProgram::GenerateDefines(defines);
+  auto& program = programs_[key];
+  if (program->IsLinked() || program->IsLinkDone())
+    return Get(defines);
+  requested_[key] = defines;
+  return Get(fallback);
+}
+
+bool ShaderPermutations::IsBuilding(const ShaderProgram::Defines& defines) {
+  auto it = programs_.find(ShaderProgram::GenerateDefines(defines));
+  return it != programs_.end() && !it->second->IsLinked() &&
+         !it->second->IsLinkDone();
+}
+
+void ShaderPermutations::LoadWarmUp(const std::string& path) {
+  std::ifstream input(path);
+  std::string line;
+  while (std::getline(input, line)) {
+    ShaderProgram::Defines defines;
+    std::istringstream words(line);
+    std::string word;
+    while (words >> word) {
+      auto equal = word.find('=');
+      defines[word.substr(0, equal)] =
+          equal == std::string::npos ? "" : word.substr(equal + 1);
+    }
+    Prepare(defines);
+  }
+}
+
+void ShaderPermutations::SaveWarmUp(const std::string& path) {
+  std::ofstream output(path, std::ios::trunc);
+  if (!output.is_open())
+    throw std::runtime_error("Unable to write the warm-up list: " + path);
+  for (auto& request : requested_) {
+    const char* separator = "";
+    for (auto& define : request.second) {
+      output << separator << define.first;
+      if (!define.second.empty())
+        output << "=" << define.second;
+      separator = " ";
+    }
+    output << "\n";
+  }
+}
+
+int ShaderPermutations::GetSize() { return programs_.size(); }
+
+std::vector<ShaderProgram*> ShaderPermutations::GetPrograms() {
+  std::vector<ShaderProgram*> programs;
+  for (auto& program : programs_)
+    if (program.second->IsLinked())
+      programs.push_back(program.second.get());
+  return programs;
+}
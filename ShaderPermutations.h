@@ -0,0 +1,136 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef SHADERPERMUTATIONS_H
+#define SHADERPERMUTATIONS_H
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "ShaderProgram.h"
+
+/**
+ * Variants of one shader program that differ in preprocessor definitions
+ *
+ * The definitions are inserted after the #version line of every stage,
+ * followed by the common header. Each set of definitions is compiled and
+ * linked once, the first time it's requested, so features and constants can
+ * be resolved at compile time instead of branching on uniforms. GetReady()
+ * builds a new set in the background while a fallback set is used, and the
+ * sets requested in a session can be saved as a warm-up list that the next
+ * session starts building at startup.
+ */
+class ShaderPermutations {
+public:
+  /**
+   * Default constructor, does nothing
+   */
+  ShaderPermutations();
+
+  /**
+   * Sets the vertex and fragment programs of the permutations
+   * The header is inserted after the definitions of every permutation
+   */
+  void Init(const std::string& vertex_path, const std::string& fragment_path,
+            const std::string& header = "");
+
+  /**
+   * Shares a separable vertex program among the permutations, which must
+   * outlive them; only the fragment program is built for each set of
+   * definitions (see ShaderProgram::SetVertexProgram)
+   */
+  void Init(ShaderProgram* vertex_program, const std::string& fragment_path,
+            const std::string& header = "");
+
+  /**
+   * Sets the compute program of the permutations
+   */
+  void InitCompute(const std::string& compute_path,
+                   const std::string& header = "");
+
+  /**
+   * Starts building the program of a set of definitions, without waiting
+   * (see ShaderProgram::BeginLink)
+   */
+  void Prepare(const ShaderProgram::Defines& defines = {});
+
+  /**
+   * Obtains the program of a set of definitions, building it if needed
+   * A program being rebuilt (see ShaderProgram::Reload) is returned as it is
+   * until its rebuild is finished
+   * Throws runtime_error if a new program doesn't compile or link
+   */
+  ShaderProgram* Get(const ShaderProgram::Defines& defines = {});
+
+  /**
+   * Obtains the program of a set of definitions if it's built; otherwise
+   * starts building it and obtains the program of the fallback definitions,
+   * building that one if needed
+   * Throws runtime_error if a new program doesn't compile or link
+   */
+  ShaderProgram* GetReady(const ShaderProgram::Defines& defines,
+                          const ShaderProgram::Defines& fallback);
+
+  /**
+   * Checks if the program of a set of definitions was started and isn't
+   * built yet
+   */
+  bool IsBuilding(const ShaderProgram::Defines& defines);
+
+  /**
+   * Starts building the sets of definitions of a warm-up list, one set per
+   * line as NAME or NAME=value words; a missing file is an empty list
+   */
+  void LoadWarmUp(const std::string& path);
+
+  /**
+   * Writes the sets of definitions requested so far as a warm-up list
+   * Throws runtime_error if the file can't be written
+   */
+  void SaveWarmUp(const std::string& path);
+
+  /**
+   * Obtains the number of permutations built
+   */
+  int GetSize();
+
+  /**
+   * Obtains the programs of the permutations built, which are never removed
+   * until the next Init(), so they can be reloaded
+   */
+  std::vector<ShaderProgram*> GetPrograms();
+
+private:
+  ShaderProgram* vertex_program_;
+  std::string vertex_path_;
+  std::string fragment_path_;
+  std::string compute_path_;
+  std::string header_;
+  std::map<std::string, std::unique_ptr<ShaderProgram>> programs_;
+  std::map<std::string, ShaderProgram::Defines> requested_;  // by key
+};
+
+#endif
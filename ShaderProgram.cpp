@@ -22,130 +22,653 @@
  * SOFTWARE.
  */
 
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
 #include <fstream>
 #include <iostream>
+#include <iterator>
+#include <sstream>
 #include <stdexcept>
+#include <utility>
+#include <vector>
 
 #include <glm/gtc/type_ptr.hpp>
-#include <GL/glew.h>
 
+#include "EmbeddedShaders.h"
+#include "GLCheck.h"
+#include "GLDebug.h"
+#include "GLState.h"
 #include "ShaderProgram.h"
 
-ShaderProgram::ShaderProgram() : program_(0), vs_(0), fs_(0) {}
+std::map<std::string, int> ShaderProgram::block_bindings_;
+std::string ShaderProgram::binary_cache_;
+bool ShaderProgram::read_from_disk_ = false;
 
-ShaderProgram::~ShaderProgram() {
-  if (vs_)
-    glDeleteShader(vs_);
-  if (fs_)
-    glDeleteShader(fs_);
+ShaderProgram::ShaderProgram()
+    : program_(0),
+      pending_(0),
+      separable_(false),
+      vertex_program_(nullptr),
+      pipeline_(0),
+      pipeline_stages_{0, 0} {}
+
+ShaderProgram::~ShaderProgram() { Release(); }
+
+ShaderProgram::ShaderProgram(ShaderProgram&& other) : ShaderProgram() {
+  *this = std::move(other);
+}
+
+ShaderProgram& ShaderProgram::operator=(ShaderProgram&& other) {
+  if (this == &other)
+    return *this;
+  Release();
+  program_ = other.program_;
+  locations_ = std::move(other.locations_);
+  stages_ = std::move(other.stages_);
+  pending_ = other.pending_;
+  separable_ = other.separable_;
+  vertex_program_ = other.vertex_program_;
+  pipeline_ = other.pipeline_;
+  pipeline_stages_[0] = other.pipeline_stages_[0];
+  pipeline_stages_[1] = other.pipeline_stages_[1];
+  shaders_ = std::move(other.shaders_);
+  binary_path_ = std::move(other.binary_path_);
+  label_ = std::move(other.label_);
+  // The other one has nothing left to delete
+  other.program_ = 0;
+  other.locations_.clear();
+  other.stages_.clear();
+  other.pending_ = 0;
+  other.vertex_program_ = nullptr;
+  other.pipeline_ = 0;
+  other.pipeline_stages_[0] = other.pipeline_stages_[1] = 0;
+  other.shaders_.clear();
+  return *this;
+}
+
+void ShaderProgram::Release() {
+  DeletePending();
   if (program_)
-    glDeleteProgram(program_);
+    GLState::DeleteProgram(program_);
+  if (pipeline_)
+    GLState::DeleteProgramPipeline(pipeline_);
+}
+
+void ShaderProgram::LoadVertexShader(const std::string& path,
+                                     const std::string& header) {
+  LoadShader(GL_VERTEX_SHADER, path, header);
+}
+
+void ShaderProgram::LoadFragmentShader(const std::string& path,
+                                       const std::string& header) {
+  LoadShader(GL_FRAGMENT_SHADER, path, header);
 }
 
-void ShaderProgram::LoadVertexShader(const std::string& path) {
-  CompileShader(&vs_, GL_VERTEX_SHADER, path);
+void ShaderProgram::LoadComputeShader(const std::string& path,
+                                      const std::string& header) {
+  LoadShader(GL_COMPUTE_SHADER, path, header);
 }
 
-void ShaderProgram::LoadFragmentShader(const std::string& path) {
-  CompileShader(&fs_, GL_FRAGMENT_SHADER, path);
+void ShaderProgram::LoadSpirvShader(int shader_type, const std::string& path,
+                                    const Constants& constants) {
+  if (!IsSpirvSupported())
+    throw std::runtime_error("SPIR-V shaders aren't supported: " + path);
+  stages_.push_back({shader_type, path, "", ReadFile(path), true, constants});
+}
+
+bool ShaderProgram::IsSpirvSupported() { return GLEW_ARB_gl_spirv; }
+
+bool ShaderProgram::IsSubgroupSupported() {
+  if (!GLEW_KHR_shader_subgroup)
+    return false;
+  GLint stages = 0, features = 0;
+  glGetIntegerv(GL_SUBGROUP_SUPPORTED_STAGES_KHR, &stages);
+  glGetIntegerv(GL_SUBGROUP_SUPPORTED_FEATURES_KHR, &features);
+  GLint needed = GL_SUBGROUP_FEATURE_BASIC_BIT_KHR |
+                 GL_SUBGROUP_FEATURE_BALLOT_BIT_KHR |
+                 GL_SUBGROUP_FEATURE_ARITHMETIC_BIT_KHR;
+  return (stages & GL_COMPUTE_SHADER_BIT) && (features & needed) == needed;
+}
+
+void ShaderProgram::SetSeparable() { separable_ = true; }
+
+void ShaderProgram::SetVertexProgram(ShaderProgram* vertex) {
+  separable_ = true;
+  vertex_program_ = vertex;
 }
 
 void ShaderProgram::LinkShader() {
-  if (!vs_ || !fs_)
-    throw new std::runtime_error("Vertex or fragment not loaded");
-
-  program_ = glCreateProgram();
-  glAttachShader(program_, vs_);
-  glAttachShader(program_, fs_);
-  glLinkProgram(program_);
-  glDeleteShader(vs_);
-  vs_ = 0;
-  glDeleteShader(fs_);
-  fs_ = 0;
+  BeginLink();
+  FinishLink();
+}
+
+void ShaderProgram::BeginLink() {
+  auto has = [&](int type) {
+    return std::any_of(stages_.begin(), stages_.end(),
+                       [=](const Stage& stage) { return stage.type == type; });
+  };
+  if (separable_ ? stages_.empty()
+                 : !has(GL_COMPUTE_SHADER) &&
+                       (!has(GL_VERTEX_SHADER) || !has(GL_FRAGMENT_SHADER)))
+    throw std::runtime_error("Vertex or fragment not loaded");
+
+  // The new program is built aside; the current one stays usable meanwhile
+  DeletePending();
+  binary_path_ = GetBinaryPath();
+  if (!binary_path_.empty() && LoadBinary(binary_path_)) {
+    binary_path_.clear();
+    return;
+  }
+
+  // No status is queried here, so the driver can build in the background
+  for (auto& stage : stages_)
+    shaders_.push_back(CompileShader(stage));
+  pending_ = glCreateProgram();
+  if (separable_)
+    glProgramParameteri(pending_, GL_PROGRAM_SEPARABLE, GL_TRUE);
+  if (!binary_path_.empty())
+    glProgramParameteri(pending_, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+  for (auto shader : shaders_)
+    glAttachShader(pending_, shader);
+  glLinkProgram(pending_);
+}
+
+void ShaderProgram::FinishLink() {
+  if (!pending_)
+    return;
+
+  // The compile errors are more useful than the link error they cause
+  try {
+    for (size_t i = 0; i < shaders_.size(); ++i)
+      CheckShader(shaders_[i], stages_[i]);
+  } catch (std::exception&) {
+    DeletePending();
+    throw;
+  }
 
   int success = 0;
-  glGetProgramiv(program_, GL_LINK_STATUS, &success);
+  glGetProgramiv(pending_, GL_LINK_STATUS, &success);
   if (!success) {
     GLint length = 0;
-    glGetProgramiv(program_, GL_INFO_LOG_LENGTH, &length);
+    glGetProgramiv(pending_, GL_INFO_LOG_LENGTH, &length);
     char log[length];
-    glGetProgramInfoLog(program_, length, &length, log);
+    glGetProgramInfoLog(pending_, length, &length, log);
+    DeletePending();
     throw std::runtime_error(std::string("link error: ") + log);
   }
+
+  for (auto shader : shaders_)
+    glDeleteShader(shader);
+  shaders_.clear();
+  if (program_)
+    GLState::DeleteProgram(program_);
+  program_ = pending_;
+  pending_ = 0;
+  ApplyLabel();
+  if (!binary_path_.empty())
+    SaveBinary(binary_path_);
+  ResolveUniforms();
+  ApplyBlockBindings(GL_UNIFORM_BLOCK);
+  ApplyBlockBindings(GL_SHADER_STORAGE_BLOCK);
 }
 
-void ShaderProgram::Enable() { glUseProgram(program_); }
+void ShaderProgram::Reload() {
+  for (auto& stage : stages_)
+    stage.source = stage.spirv
+                       ? ReadFile(stage.path)
+                       : InsertHeader(ReadSource(stage.path), stage.header);
+  BeginLink();
+}
+
+bool ShaderProgram::IsLinkDone() {
+  GLint done = GL_TRUE;
+  if (!pending_)
+    return true;
+  if (GLEW_KHR_parallel_shader_compile)
+    glGetProgramiv(pending_, GL_COMPLETION_STATUS_KHR, &done);
+  else if (GLEW_ARB_parallel_shader_compile)
+    glGetProgramiv(pending_, GL_COMPLETION_STATUS_ARB, &done);
+  return done;
+}
 
-void ShaderProgram::Disable() { glUseProgram(0); }
+bool ShaderProgram::IsLinked() { return program_ != 0; }
+
+void ShaderProgram::EnableParallelCompile() {
+  // 0xFFFFFFFF lets the implementation pick the number of threads
+  if (GLEW_KHR_parallel_shader_compile)
+    glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+  else if (GLEW_ARB_parallel_shader_compile)
+    glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+}
+
+void ShaderProgram::SetBinaryCache(const std::string& directory) {
+  binary_cache_ = directory;
+}
+
+void ShaderProgram::SetReadFromDisk(bool read_from_disk) {
+  read_from_disk_ = read_from_disk;
+}
+
+void ShaderProgram::SetLabel(const std::string& label) {
+  label_ = label;
+  ApplyLabel();
+}
+
+void ShaderProgram::Enable() {
+  if (!vertex_program_) {
+    GLState::UseProgram(program_);
+    return;
+  }
+
+  // The stages are updated when either program was rebuilt
+  if (!pipeline_) {
+    glCreateProgramPipelines(1, &pipeline_);
+    ApplyLabel();
+  }
+  if (pipeline_stages_[0] != vertex_program_->program_) {
+    pipeline_stages_[0] = vertex_program_->program_;
+    glUseProgramStages(pipeline_, GL_VERTEX_SHADER_BIT, pipeline_stages_[0]);
+  }
+  if (pipeline_stages_[1] != program_) {
+    pipeline_stages_[1] = program_;
+    glUseProgramStages(pipeline_, GL_FRAGMENT_SHADER_BIT, pipeline_stages_[1]);
+  }
+  GLState::BindProgramPipeline(pipeline_);
+}
 
 void ShaderProgram::SetAttribLocation(const char* name, unsigned int location) {
   glBindAttribLocation(program_, location, name);
 }
 
+ShaderProgram::Uniform ShaderProgram::GetUniform(const std::string& name) {
+  auto found = locations_.find(name);
+  if (found != locations_.end())
+    return {found->second};
+  auto location = glGetUniformLocation(program_, name.c_str());
+  locations_[name] = location;
+  return {location};
+}
+
+void ShaderProgram::SetUniform(Uniform uniform, int value) {
+  glProgramUniform1i(program_, uniform.location, value);
+}
+
+void ShaderProgram::SetUniform(Uniform uniform, float value) {
+  glProgramUniform1f(program_, uniform.location, value);
+}
+
+void ShaderProgram::SetUniform(Uniform uniform, const glm::vec2& value) {
+  glProgramUniform2fv(program_, uniform.location, 1, glm::value_ptr(value));
+}
+
+void ShaderProgram::SetUniform(Uniform uniform, const glm::vec3& value) {
+  glProgramUniform3fv(program_, uniform.location, 1, glm::value_ptr(value));
+}
+
+void ShaderProgram::SetUniform(Uniform uniform, const glm::vec4& value) {
+  glProgramUniform4fv(program_, uniform.location, 1, glm::value_ptr(value));
+}
+
+void ShaderProgram::SetUniform(Uniform uniform, const glm::ivec2& value) {
+  glProgramUniform2iv(program_, uniform.location, 1, glm::value_ptr(value));
+}
+
+void ShaderProgram::SetUniform(Uniform uniform, const glm::ivec3& value) {
+  glProgramUniform3iv(program_, uniform.location, 1, glm::value_ptr(value));
+}
+
+void ShaderProgram::SetUniform(Uniform uniform, const glm::mat4& value) {
+  glProgramUniformMatrix4fv(program_, uniform.location, 1, false,
+                            glm::value_ptr(value));
+}
+
+void ShaderProgram::SetUniform(Uniform uniform, const glm::vec4* values,
+                               int n) {
+  glProgramUniform4fv(program_, uniform.location, n, glm::value_ptr(*values));
+}
+
 void ShaderProgram::SetUniform(const std::string& name, int value) {
-  GLuint location = glGetUniformLocation(program_, name.c_str());
-  glUniform1i(location, value);
+  SetUniform(GetUniform(name), value);
 }
 
 void ShaderProgram::SetUniform(const std::string& name, float value) {
-  GLuint location = glGetUniformLocation(program_, name.c_str());
-  glUniform1f(location, value);
+  SetUniform(GetUniform(name), value);
+}
+
+void ShaderProgram::SetUniform(const std::string& name,
+                               const glm::vec2& value) {
+  SetUniform(GetUniform(name), value);
 }
 
 void ShaderProgram::SetUniform(const std::string& name,
                                const glm::vec3& value) {
-  GLuint location = glGetUniformLocation(program_, name.c_str());
-  glUniform3fv(location, 1, glm::value_ptr(value));
+  SetUniform(GetUniform(name), value);
 }
 
 void ShaderProgram::SetUniform(const std::string& name,
                                const glm::vec4& value) {
-  GLuint location = glGetUniformLocation(program_, name.c_str());
-  glUniform4fv(location, 1, glm::value_ptr(value));
+  SetUniform(GetUniform(name), value);
+}
+
+void ShaderProgram::SetUniform(const std::string& name,
+                               const glm::ivec2& value) {
+  SetUniform(GetUniform(name), value);
+}
+
+void ShaderProgram::SetUniform(const std::string& name,
+                               const glm::ivec3& value) {
+  SetUniform(GetUniform(name), value);
 }
 
 void ShaderProgram::SetUniform(const std::string& name,
                                const glm::mat4& value) {
-  GLuint location = glGetUniformLocation(program_, name.c_str());
-  glUniformMatrix4fv(location, 1, false, glm::value_ptr(value));
+  SetUniform(GetUniform(name), value);
+}
+
+void ShaderProgram::SetTexture2D(Uniform sampler, int sampler_id,
+                                 int texture_id) {
+  GLState::BindTexture(sampler_id, texture_id);
+  SetUniform(sampler, sampler_id);
 }
 
 void ShaderProgram::SetTexture2D(const std::string& name, int sampler_id,
                                  int texture_id) {
-  glActiveTexture(GL_TEXTURE0 + sampler_id);
-  glBindTexture(GL_TEXTURE_2D, texture_id);
-  SetUniform(name, sampler_id);
+  SetTexture2D(GetUniform(name), sampler_id, texture_id);
+}
+
+void ShaderProgram::SetTexture2DMultisample(Uniform sampler, int sampler_id,
+                                            int texture_id) {
+  GLState::BindTexture(sampler_id, texture_id);
+  SetUniform(sampler, sampler_id);
+}
+
+void ShaderProgram::SetTexture2DMultisample(const std::string& name,
+                                            int sampler_id, int texture_id) {
+  SetTexture2DMultisample(GetUniform(name), sampler_id, texture_id);
+}
+
+void ShaderProgram::RegisterBlockBinding(const std::string& name,
+                                         int binding_point) {
+  auto found = block_bindings_.find(name);
+  if (found != block_bindings_.end() && found->second != binding_point)
+    throw std::runtime_error(name + " already bound to " +
+                             std::to_string(found->second));
+  block_bindings_[name] = binding_point;
+}
+
+void ShaderProgram::BindUniformBuffer(int binding_point,
+                                      unsigned int buffer_id, size_t offset,
+                                      size_t size) {
+  if (size)
+    glBindBufferRange(GL_UNIFORM_BUFFER, binding_point, buffer_id, offset,
+                      size);
+  else
+    glBindBufferBase(GL_UNIFORM_BUFFER, binding_point, buffer_id);
+}
+
+void ShaderProgram::BindStorageBuffer(int binding_point,
+                                      unsigned int buffer_id, size_t offset,
+                                      size_t size) {
+  if (size)
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, binding_point, buffer_id,
+                      offset, size);
+  else
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding_point, buffer_id);
+}
+
+ShaderProgram::BlockInfo ShaderProgram::GetUniformBlockInfo(
+    const std::string& name) {
+  return GetBlockInfo(name, GL_UNIFORM_BLOCK, GL_UNIFORM);
+}
+
+ShaderProgram::BlockInfo ShaderProgram::GetStorageBlockInfo(
+    const std::string& name) {
+  return GetBlockInfo(name, GL_SHADER_STORAGE_BLOCK, GL_BUFFER_VARIABLE);
 }
 
-void ShaderProgram::SetUniformBuffer(const std::string& name, int binding_point,
-                                     unsigned int buffer_id) {
-  auto block_index = glGetUniformBlockIndex(program_, name.c_str());
-  glUniformBlockBinding(program_, block_index, binding_point);
-  glBindBufferBase(GL_UNIFORM_BUFFER, binding_point, buffer_id);
+void ShaderProgram::CheckBlockMember(const BlockInfo& block,
+                                     const std::string& member, size_t offset,
+                                     size_t stride) {
+  // The members optimized out by the compiler are never read
+  auto found = block.members.find(member);
+  if (found == block.members.end())
+    return;
+  auto& layout = found->second;
+  auto array_stride = layout.top_level_array_stride
+                          ? layout.top_level_array_stride
+                          : layout.array_stride;
+  if ((size_t)layout.offset == offset &&
+      (!stride || (size_t)array_stride == stride))
+    return;
+
+  std::string error = block.name + "::" + member + " expected at " +
+                      std::to_string(offset) +
+                      (stride ? " stride " + std::to_string(stride) : "") +
+                      ", the driver lays out " +
+                      std::to_string(block.size) + " bytes:";
+  for (auto& m : block.members) {
+    error += "\n  " + m.first + " at " + std::to_string(m.second.offset);
+    if (m.second.top_level_array_stride)
+      error += " stride " + std::to_string(m.second.top_level_array_stride);
+    else if (m.second.array_stride)
+      error += " stride " + std::to_string(m.second.array_stride);
+  }
+  throw std::runtime_error(error);
 }
 
 unsigned int ShaderProgram::GetHandle() { return program_; }
 
+void ShaderProgram::ApplyLabel() {
+  auto label = label_;
+  for (size_t i = 0; label_.empty() && i < stages_.size(); ++i)
+    label += (i ? "+" : "") + stages_[i].path;
+  GLDebug::Label(GL_PROGRAM, program_, label);
+  GLDebug::Label(GL_PROGRAM_PIPELINE, pipeline_, label);
+}
+
+void ShaderProgram::ResolveUniforms() {
+  locations_.clear();
+  GLint n_uniforms = 0, max_length = 0;
+  glGetProgramInterfaceiv(program_, GL_UNIFORM, GL_ACTIVE_RESOURCES,
+                          &n_uniforms);
+  glGetProgramInterfaceiv(program_, GL_UNIFORM, GL_MAX_NAME_LENGTH,
+                          &max_length);
+  std::vector<char> name(std::max(max_length, 1));
+  const GLenum props[] = {GL_LOCATION, GL_BLOCK_INDEX};
+  for (GLint i = 0; i < n_uniforms; ++i) {
+    GLint values[2] = {-1, -1};
+    glGetProgramResourceiv(program_, GL_UNIFORM, i, 2, props, 2, nullptr,
+                           values);
+    if (values[1] != -1)
+      continue;
+    glGetProgramResourceName(program_, GL_UNIFORM, i, name.size(), nullptr,
+                             name.data());
+    locations_[name.data()] = values[0];
+  }
+}
+
+void ShaderProgram::ApplyBlockBindings(unsigned int block_interface) {
+  GLint n_blocks = 0, max_length = 0;
+  glGetProgramInterfaceiv(program_, block_interface, GL_ACTIVE_RESOURCES,
+                          &n_blocks);
+  glGetProgramInterfaceiv(program_, block_interface, GL_MAX_NAME_LENGTH,
+                          &max_length);
+  std::vector<char> name(std::max(max_length, 1));
+  for (GLint i = 0; i < n_blocks; ++i) {
+    glGetProgramResourceName(program_, block_interface, i, name.size(),
+                             nullptr, name.data());
+    auto found = block_bindings_.find(name.data());
+    if (found == block_bindings_.end())
+      continue;
+    if (block_interface == GL_UNIFORM_BLOCK)
+      glUniformBlockBinding(program_, i, found->second);
+    else
+      glShaderStorageBlockBinding(program_, i, found->second);
+  }
+}
+
+ShaderProgram::BlockInfo ShaderProgram::GetBlockInfo(
+    const std::string& name, unsigned int block_interface,
+    unsigned int member_interface) {
+  auto block_index =
+      glGetProgramResourceIndex(program_, block_interface, name.c_str());
+  if (block_index == GL_INVALID_INDEX)
+    throw std::runtime_error("block not active: " + name);
+
+  BlockInfo info;
+  info.name = name;
+  const GLenum block_props[] = {GL_BUFFER_DATA_SIZE, GL_NUM_ACTIVE_VARIABLES};
+  GLint block_values[2] = {0, 0};
+  glGetProgramResourceiv(program_, block_interface, block_index, 2,
+                         block_props, 2, nullptr, block_values);
+  info.size = block_values[0];
+
+  std::vector<GLint> indices(block_values[1]);
+  const GLenum active_variables = GL_ACTIVE_VARIABLES;
+  if (!indices.empty())
+    glGetProgramResourceiv(program_, block_interface, block_index, 1,
+                           &active_variables, indices.size(), nullptr,
+                           indices.data());
+
+  // Only the buffer variables know the stride of their top-level array
+  bool storage = member_interface == GL_BUFFER_VARIABLE;
+  const GLenum member_props[] = {GL_NAME_LENGTH, GL_OFFSET, GL_ARRAY_STRIDE,
+                                 GL_TOP_LEVEL_ARRAY_STRIDE};
+  for (auto index : indices) {
+    GLint values[4] = {0, 0, 0, 0};
+    glGetProgramResourceiv(program_, member_interface, index, storage ? 4 : 3,
+                           member_props, 4, nullptr, values);
+    std::string member(std::max(values[0], 1), '\0');
+    glGetProgramResourceName(program_, member_interface, index, values[0],
+                             nullptr, &member[0]);
+    member.resize(values[0] ? values[0] - 1 : 0);
+    info.members[member] = {values[1], values[2], values[3]};
+  }
+  return info;
+}
+
 std::string ShaderProgram::ReadFile(const std::string& path) {
-  std::ifstream input(path);
+  if (!read_from_disk_) {
+    for (int i = 0; i < n_embedded_shaders; ++i)
+      if (path == embedded_shaders[i].path)
+        return embedded_shaders[i].source;
+  }
+  std::ifstream input(path, std::ios::binary);
   if (!input.is_open())
     throw std::runtime_error("Unable to open file: " + path);
+  std::ostringstream output;
+  output << input.rdbuf();
+  return output.str();
+}
+
+std::string ShaderProgram::GenerateDefines(const Defines& defines) {
+  std::string output;
+  for (auto& define : defines) {
+    output += "#define " + define.first;
+    if (!define.second.empty())
+      output += " " + define.second;
+    output += "\n";
+  }
+  return output;
+}
+
+std::string ShaderProgram::InsertHeader(const std::string& source,
+                                        const std::string& header) {
+  if (header.empty())
+    return source;
+  auto version = source.find("#version");
+  if (version == std::string::npos)
+    return header + source;
+  auto line_end = source.find('\n', version) + 1;
+  auto line = std::count(source.begin(), source.begin() + line_end, '\n');
+  return source.substr(0, line_end) + header + "\n#line " +
+         std::to_string(line + 1) + "\n" + source.substr(line_end);
+}
+
+std::string ShaderProgram::ReadSource(const std::string& path) {
+  std::set<std::string> included = {NormalizePath(path)};
+  return ResolveIncludes(ReadFile(path), path, &included);
+}
+
+std::string ShaderProgram::ResolveIncludes(const std::string& source,
+                                           const std::string& path,
+                                           std::set<std::string>* included) {
+  auto directory = path.substr(0, path.find_last_of('/') + 1);
+  std::istringstream input(source);
   std::string output;
-  while (!input.eof()) {
-    char line[1024];
-    input.getline(line, 1024);
-    output = output + line + "\n";
+  std::string line;
+  int number = 0;
+  while (std::getline(input, line)) {
+    ++number;
+    auto start = line.find_first_not_of(" \t");
+    if (start == std::string::npos || line.compare(start, 8, "#include")) {
+      output += line + "\n";
+      continue;
+    }
+    auto open = line.find('"', start);
+    auto close = line.find('"', open + 1);
+    if (open == std::string::npos || close == std::string::npos)
+      throw std::runtime_error(path + ":" + std::to_string(number) +
+                               ": expected #include \"file\"");
+    auto file =
+        NormalizePath(directory + line.substr(open + 1, close - open - 1));
+    if (included->insert(file).second) {
+      // The line numbers of the errors stay those of each file
+      output += "#line 1\n" + ResolveIncludes(ReadFile(file), file, included) +
+                "#line " + std::to_string(number + 1) + "\n";
+    } else {
+      output += "\n";
+    }
   }
   return output;
 }
 
-void ShaderProgram::CompileShader(unsigned int* id, int shader_type,
-                                  const std::string& path) {
-  auto shader_str = ReadFile(path);
-  auto shader_cstr = shader_str.c_str();
-  auto shader = glCreateShader(shader_type);
+std::string ShaderProgram::NormalizePath(const std::string& path) {
+  std::vector<std::string> segments;
+  std::istringstream input(path);
+  std::string segment;
+  while (std::getline(input, segment, '/')) {
+    if (segment.empty() || segment == ".")
+      continue;
+    if (segment == ".." && !segments.empty() && segments.back() != "..")
+      segments.pop_back();
+    else
+      segments.push_back(segment);
+  }
+  std::string output = !path.empty() && path[0] == '/' ? "/" : "";
+  for (size_t i = 0; i < segments.size(); ++i)
+    output += (i ? "/" : "") + segments[i];
+  return output;
+}
+
+void ShaderProgram::LoadShader(int shader_type, const std::string& path,
+                               const std::string& header) {
+  stages_.push_back({shader_type, path, header,
+                     InsertHeader(ReadSource(path), header), false, {}});
+}
+
+unsigned int ShaderProgram::CompileShader(const Stage& stage) {
+  auto shader = glCreateShader(stage.type);
+  if (stage.spirv) {
+    std::vector<GLuint> ids, values;
+    for (auto& constant : stage.constants) {
+      ids.push_back(constant.first);
+      values.push_back(constant.second);
+    }
+    glShaderBinary(1, &shader, GL_SHADER_BINARY_FORMAT_SPIR_V_ARB,
+                   stage.source.data(), stage.source.size());
+    glSpecializeShaderARB(shader, "main", ids.size(), ids.data(),
+                          values.data());
+    return shader;
+  }
+  auto shader_cstr = stage.source.c_str();
   glShaderSource(shader, 1, &shader_cstr, NULL);
   glCompileShader(shader);
+  return shader;
+}
+
+void ShaderProgram::CheckShader(unsigned int shader, const Stage& stage) {
   GLint success = 0;
   glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
   if (!success) {
@@ -153,9 +676,85 @@ void ShaderProgram::CompileShader(unsigned int* id, int shader_type,
     glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &length);
     char log[length];
     glGetShaderInfoLog(shader, length, &length, log);
+    throw std::runtime_error(stage.path + ": " + log);
+  }
+}
+
+void ShaderProgram::DeletePending() {
+  for (auto shader : shaders_)
     glDeleteShader(shader);
-    throw std::runtime_error(path + ": " + log);
+  shaders_.clear();
+  if (pending_)
+    glDeleteProgram(pending_);
+  pending_ = 0;
+}
+
+bool ShaderProgram::LoadBinary(const std::string& path) {
+  std::ifstream input(path, std::ios::binary);
+  if (!input.is_open())
+    return false;
+  GLenum format = 0;
+  input.read((char*)&format, sizeof(format));
+  std::vector<char> binary((std::istreambuf_iterator<char>(input)),
+                           std::istreambuf_iterator<char>());
+  if (!input.good() && !input.eof())
+    return false;
+
+  // A driver update can reject the binaries of the previous version
+  pending_ = glCreateProgram();
+  if (separable_)
+    glProgramParameteri(pending_, GL_PROGRAM_SEPARABLE, GL_TRUE);
+  glProgramBinary(pending_, format, binary.data(), binary.size());
+  int success = 0;
+  glGetProgramiv(pending_, GL_LINK_STATUS, &success);
+  if (!success) {
+    glDeleteProgram(pending_);
+    pending_ = 0;
   }
-  *id = shader;
+  return success;
+}
+
+void ShaderProgram::SaveBinary(const std::string& path) {
+  GLint length = 0;
+  glGetProgramiv(program_, GL_PROGRAM_BINARY_LENGTH, &length);
+  if (length <= 0)
+    return;
+  std::vector<char> binary(length);
+  GLenum format = 0;
+  glGetProgramBinary(program_, length, &length, &format, binary.data());
+
+  // The cache is only an optimization, so failing to write it isn't an error
+  std::ofstream output(path, std::ios::binary | std::ios::trunc);
+  output.write((const char*)&format, sizeof(format));
+  output.write(binary.data(), length);
 }
 
+std::string ShaderProgram::GetBinaryPath() {
+  GLint n_formats = 0;
+  if (!binary_cache_.empty())
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &n_formats);
+  if (n_formats == 0)
+    return "";
+
+  // 64 bits FNV-1a of the driver and the sources with their headers
+  uint64_t hash = 14695981039346656037ull;
+  auto add = [&](const std::string& data) {
+    for (unsigned char c : data)
+      hash = (hash ^ c) * 1099511628211ull;
+    hash = (hash ^ 0xff) * 1099511628211ull;
+  };
+  for (auto name : {GL_VENDOR, GL_RENDERER, GL_VERSION})
+    add((const char*)glGetString(name));
+  add(separable_ ? "separable" : "");
+  for (auto& stage : stages_) {
+    add(std::to_string(stage.type));
+    add(stage.source);
+    for (auto& constant : stage.constants)
+      add(std::to_string(constant.first) + "=" +
+          std::to_string(constant.second));
+  }
+
+  char name[32];
+  snprintf(name, sizeof(name), "/%016llx.bin", (unsigned long long)hash);
+  return binary_cache_ + name;
+}
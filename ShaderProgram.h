@@ -25,7 +25,11 @@
 #ifndef SHADERPROGRAM_H
 #define SHADERPROGRAM_H
 
+#include <map>
+#include <set>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 #include <glm/glm.hpp>
 
@@ -34,6 +38,48 @@
  */
 class ShaderProgram {
 public:
+  /**
+   * Preprocessor definitions of a shader, as names and values
+   * An empty value only defines the name
+   */
+  typedef std::map<std::string, std::string> Defines;
+
+  /**
+   * Specialization constants of a SPIR-V shader, as constant ids and values
+   * The values are the bits of the constants (e.g. floatBitsToUint)
+   */
+  typedef std::map<unsigned int, unsigned int> Constants;
+
+  /**
+   * Location of an uniform, resolved once instead of at every set
+   * Inactive uniforms have location -1 and their sets are ignored
+   */
+  struct Uniform {
+    int location;
+  };
+
+  /**
+   * Offset and strides in bytes of a block member, as laid out by the driver
+   * The strides are zero when the member isn't an array; the top-level array
+   * stride is only known for the members of storage blocks
+   */
+  struct BlockMember {
+    int offset;
+    int array_stride;
+    int top_level_array_stride;
+  };
+
+  /**
+   * Layout of an active block, its minimum size and its members by name
+   * Arrays of structures in storage blocks only list their first element
+   * (e.g. "lights[0].position")
+   */
+  struct BlockInfo {
+    std::string name;
+    int size;
+    std::map<std::string, BlockMember> members;
+  };
+
   /**
    * Default constructor, does nothing
    */
@@ -45,25 +91,141 @@ public:
   ~ShaderProgram();
 
   /**
-   * Loads and compiles the vertex program
+   * Takes the program, the pending link and the stages of another shader
+   * program, which is left empty
+   * The programs using the other one as vertex program (see
+   * SetVertexProgram) still point to it
+   */
+  ShaderProgram(ShaderProgram&& other);
+  ShaderProgram& operator=(ShaderProgram&& other);
+
+  /**
+   * A shader program owns its gl objects, so it can't be copied
+   */
+  ShaderProgram(const ShaderProgram&) = delete;
+  ShaderProgram& operator=(const ShaderProgram&) = delete;
+
+  /**
+   * Loads the vertex program, compiled when linking
+   * The header, if any, is inserted right after the #version line
+   */
+  void LoadVertexShader(const std::string& path,
+                        const std::string& header = "");
+
+  /**
+   * Loads the fragment program, compiled when linking
+   * The header, if any, is inserted right after the #version line
+   */
+  void LoadFragmentShader(const std::string& path,
+                          const std::string& header = "");
+
+  /**
+   * Loads a compute program, linked alone
+   * The header, if any, is inserted right after the #version line
+   */
+  void LoadComputeShader(const std::string& path,
+                         const std::string& header = "");
+
+  /**
+   * Loads a precompiled SPIR-V shader (ARB_gl_spirv), specialized with the
+   * constants when linking; the entry point is main
+   * The driver may not know the names of a SPIR-V shader, so its uniforms
+   * need explicit locations and its blocks explicit bindings
+   */
+  void LoadSpirvShader(int shader_type, const std::string& path,
+                       const Constants& constants = {});
+
+  /**
+   * Checks if the driver loads SPIR-V shaders
    */
-  void LoadVertexShader(const std::string& path);
+  static bool IsSpirvSupported();
 
   /**
-   * Loads and compiles the fragment program
+   * Checks if the compute shaders have the basic, ballot and arithmetic
+   * subgroup operations (KHR_shader_subgroup)
    */
-  void LoadFragmentShader(const std::string& path);
+  static bool IsSubgroupSupported();
 
   /**
-   * Links the shader program
+   * Links the program as a separable stage (ARB_separate_shader_objects),
+   * which only needs a vertex or a fragment shader; call before linking
+   */
+  void SetSeparable();
+
+  /**
+   * Takes the vertex stage from a separable program, which must outlive this
+   * one, and makes this program separable. Enable() then binds a program
+   * pipeline with both stages, so programs that share a vertex shader compile
+   * it once instead of linking it into each of them
+   */
+  void SetVertexProgram(ShaderProgram* vertex);
+
+  /**
+   * Compiles and links the shader program, or loads its binary from the
+   * cache when the sources and the driver are the same
+   * Throws runtime_error with the log if a shader doesn't compile or link
    */
   void LinkShader();
 
   /**
-   * Enables or disables the program
+   * Splits LinkShader() to build several programs at once: BeginLink()
+   * submits the compilation and the link without waiting for them, and
+   * FinishLink() waits, checks the result and throws like LinkShader()
+   * When the driver compiles in parallel, the programs started before the
+   * first FinishLink() are built concurrently
+   */
+  void BeginLink();
+  void FinishLink();
+
+  /**
+   * Reads the sources again and starts building them with BeginLink()
+   * The current program stays in use until FinishLink() succeeds, and is
+   * kept if it throws; the Uniform handles must be obtained again
+   */
+  void Reload();
+
+  /**
+   * Checks, without waiting, if the link started by BeginLink() is done
+   * Always true without the KHR_parallel_shader_compile or the
+   * ARB_parallel_shader_compile extension
+   */
+  bool IsLinkDone();
+
+  /**
+   * Checks if a program was built, which stays usable while it's rebuilt
+   */
+  bool IsLinked();
+
+  /**
+   * Lets the driver use all its compiler threads, if it supports
+   * KHR_parallel_shader_compile or ARB_parallel_shader_compile
+   */
+  static void EnableParallelCompile();
+
+  /**
+   * Sets the directory where the linked programs are cached, keyed by a hash
+   * of their sources and the driver version; empty disables the cache
+   * The directory must exist. A binary the driver rejects is compiled again
+   */
+  static void SetBinaryCache(const std::string& directory);
+
+  /**
+   * Reads the shaders from the disk instead of the copies embedded in the
+   * executable, so Reload() sees their changes
+   */
+  static void SetReadFromDisk(bool read_from_disk);
+
+  /**
+   * Names the program and its pipeline for debuggers (see GLDebug), also
+   * once it is rebuilt; by default the paths of its stages, joined by +
+   */
+  void SetLabel(const std::string& label);
+
+  /**
+   * Enables the program, or its pipeline with the vertex program
+   * It stays enabled until another program is
    */
   void Enable();
-  void Disable();
 
   /**
    * Sets an attribute location
@@ -71,45 +233,216 @@ public:
   void SetAttribLocation(const char* name, unsigned int location);
 
   /**
-   * Sets an uniform variable
+   * Obtains the location of an uniform of the linked program
+   * The locations of the uniforms outside blocks are resolved by
+   * LinkShader(); other names, such as array elements, are resolved once
+   */
+  Uniform GetUniform(const std::string& name);
+
+  /**
+   * Sets an uniform variable of the program, enabled or not
+   * The names are looked up in the locations resolved after linking
    */
+  void SetUniform(Uniform uniform, int value);
+  void SetUniform(Uniform uniform, float value);
+  void SetUniform(Uniform uniform, const glm::vec2& value);
+  void SetUniform(Uniform uniform, const glm::vec3& value);
+  void SetUniform(Uniform uniform, const glm::vec4& value);
+  void SetUniform(Uniform uniform, const glm::ivec2& value);
+  void SetUniform(Uniform uniform, const glm::ivec3& value);
+  void SetUniform(Uniform uniform, const glm::mat4& value);
+  void SetUniform(Uniform uniform, const glm::vec4* values, int n);
   void SetUniform(const std::string& name, int value);
   void SetUniform(const std::string& name, float value);
+  void SetUniform(const std::string& name, const glm::vec2& value);
   void SetUniform(const std::string& name, const glm::vec3& value);
   void SetUniform(const std::string& name, const glm::vec4& value);
+  void SetUniform(const std::string& name, const glm::ivec2& value);
+  void SetUniform(const std::string& name, const glm::ivec3& value);
   void SetUniform(const std::string& name, const glm::mat4& value);
 
   /**
    * Binds a texture to a sampler
    */
+  void SetTexture2D(Uniform sampler, int sampler_id, int texture_id);
   void SetTexture2D(const std::string& name, int sampler_id, int texture_id);
 
   /**
-   * Binds an uniform buffer
+   * Binds a multisampled texture to a sampler
    */
-  void SetUniformBuffer(const std::string& name, int binding_point,
-                        unsigned int buffer_id);
+  void SetTexture2DMultisample(Uniform sampler, int sampler_id,
+                               int texture_id);
+  void SetTexture2DMultisample(const std::string& name, int sampler_id,
+                               int texture_id);
+
+  /**
+   * Binds the blocks with that name to a binding point, in the programs
+   * linked afterwards; the blocks not registered keep their layout binding
+   * Throws runtime_error if the name already has another binding point
+   */
+  static void RegisterBlockBinding(const std::string& name, int binding_point);
+
+  /**
+   * Binds a buffer to the binding point of an uniform or storage block
+   * A non-zero size binds only that range of the buffer
+   */
+  static void BindUniformBuffer(int binding_point, unsigned int buffer_id,
+                                size_t offset = 0, size_t size = 0);
+  static void BindStorageBuffer(int binding_point, unsigned int buffer_id,
+                                size_t offset = 0, size_t size = 0);
+
+  /**
+   * Queries the layout of an active uniform or shader storage block
+   * Throws runtime_error if the program has no such block
+   */
+  BlockInfo GetUniformBlockInfo(const std::string& name);
+  BlockInfo GetStorageBlockInfo(const std::string& name);
+
+  /**
+   * Checks that a block member is at an offset and, if the stride isn't
+   * zero, that its top-level array has that stride; inactive members pass
+   * Throws runtime_error with the layout of the driver otherwise
+   */
+  static void CheckBlockMember(const BlockInfo& block,
+                               const std::string& member, size_t offset,
+                               size_t stride = 0);
 
   /**
    * Obtains the shader program handle
    */
   unsigned int GetHandle();
 
+  /**
+   * Reads the whole file and returns it as a string; shader paths come from
+   * the embedded copies unless SetReadFromDisk() is set
+   * Throws runtime_error if the file doesn't exist
+   */
+  static std::string ReadFile(const std::string& path);
+
+  /**
+   * Generates the #define lines of the definitions, sorted by name
+   * Used to build the headers of the shader permutations
+   */
+  static std::string GenerateDefines(const Defines& defines);
+
 private:
   /**
-   * Reads the whole file and returns it as a string
+   * Deletes the program, the pipeline and the pending link
+   */
+  void Release();
+
+  /**
+   * Inserts the header after the #version line of the source
+   */
+  std::string InsertHeader(const std::string& source,
+                           const std::string& header);
+
+  /**
+   * Resolves the locations of the uniforms outside blocks
    */
-  std::string ReadFile(const std::string& path);
+  void ResolveUniforms();
 
   /**
-   * Loads and compiles a shader from a file
+   * Binds the registered blocks of a program interface of the linked program
    */
-  void CompileShader(unsigned int* id, int shader_type,
-                     const std::string& path);
+  void ApplyBlockBindings(unsigned int block_interface);
+
+  /**
+   * Queries the layout of an active block of a program interface
+   */
+  BlockInfo GetBlockInfo(const std::string& name, unsigned int block_interface,
+                         unsigned int member_interface);
+
+  /**
+   * Source of a shader of the program, with the header already inserted, or
+   * its SPIR-V binary and specialization constants
+   */
+  struct Stage {
+    int type;
+    std::string path;
+    std::string header;
+    std::string source;
+    bool spirv;
+    Constants constants;
+  };
+
+  /**
+   * Reads a shader and replaces its #include "file" lines, relative to its
+   * directory, by the files; each file is included once
+   */
+  static std::string ReadSource(const std::string& path);
+
+  /**
+   * Replaces the #include lines of a source read from the path
+   */
+  static std::string ResolveIncludes(const std::string& source,
+                                     const std::string& path,
+                                     std::set<std::string>* included);
+
+  /**
+   * Removes the . segments of a path, and the .. segments with the directory
+   * before them, so an included file is found among the embedded copies and
+   * included once however it's reached
+   */
+  static std::string NormalizePath(const std::string& path);
+
+  /**
+   * Loads a shader from a file, to compile it when linking
+   */
+  void LoadShader(int shader_type, const std::string& path,
+                  const std::string& header);
+
+  /**
+   * Submits the compilation of a shader of the program
+   */
+  unsigned int CompileShader(const Stage& stage);
+
+  /**
+   * Throws runtime_error with the log if a shader didn't compile
+   */
+  void CheckShader(unsigned int shader, const Stage& stage);
+
+  /**
+   * Deletes the program being built and its shaders, if any
+   */
+  void DeletePending();
+
+  /**
+   * Creates the program from the binary cache
+   * Returns false if the binary is missing or rejected by the driver
+   */
+  bool LoadBinary(const std::string& path);
+
+  /**
+   * Writes the binary of the linked program to the cache
+   */
+  void SaveBinary(const std::string& path);
+
+  /**
+   * Obtains the cache file of the program sources
+   */
+  std::string GetBinaryPath();
+
+  /**
+   * Names the program and the pipeline with the label or the stage paths
+   */
+  void ApplyLabel();
+
+  static std::map<std::string, int> block_bindings_;
+  static std::string binary_cache_;
+  static bool read_from_disk_;
 
   unsigned int program_;
-  unsigned int vs_;
-  unsigned int fs_;
+  std::unordered_map<std::string, int> locations_;
+  std::vector<Stage> stages_;
+  unsigned int pending_;               // program being built, if any
+  bool separable_;
+  ShaderProgram* vertex_program_;      // separable vertex stage, if any
+  unsigned int pipeline_;              // with the vertex program, if any
+  unsigned int pipeline_stages_[2];    // vertex and fragment programs used
+  std::vector<unsigned int> shaders_;  // in the order of the stages
+  std::string binary_path_;            // to save after linking, if any
+  std::string label_;
 };
 
 #endif
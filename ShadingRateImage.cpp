@@ -0,0 +1,109 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <string>
+
+#include "GLCheck.h"
+#include "GLState.h"
+#include "ShadingRateImage.h"
+
+namespace {
+
+// Entries of the palette written by the classification shader
+enum Entry { FULL_RATE, COARSE_RATE, BACKGROUND_RATE, N_ENTRIES };
+
+}  // namespace
+
+ShadingRateImage::ShadingRateImage()
+    : coarse_rate_(RATE_2X2),
+      texture_(0),
+      tile_width_(0),
+      tile_height_(0),
+      width_(0),
+      height_(0) {}
+
+ShadingRateImage::~ShadingRateImage() {
+  if (texture_)
+    GLState::DeleteTextures(1, &texture_);
+}
+
+bool ShadingRateImage::IsSupported() { return GLEW_NV_shading_rate_image; }
+
+void ShadingRateImage::Init(const std::string& gbuffer_code,
+                            CoarseRate coarse_rate) {
+  coarse_rate_ = coarse_rate;
+  glGetIntegerv(GL_SHADING_RATE_IMAGE_TEXEL_WIDTH_NV, &tile_width_);
+  glGetIntegerv(GL_SHADING_RATE_IMAGE_TEXEL_HEIGHT_NV, &tile_height_);
+  auto header = ShaderProgram::GenerateDefines(
+      {{"TILE_WIDTH", std::to_string(tile_width_)},
+       {"TILE_HEIGHT", std::to_string(tile_height_)},
+       {"FULL_RATE", std::to_string(FULL_RATE)},
+       {"COARSE_RATE", std::to_string(COARSE_RATE)},
+       {"BACKGROUND_RATE", std::to_string(BACKGROUND_RATE)}});
+  shader_.LoadComputeShader("shaders/shading_rate_cs.glsl",
+                            header + gbuffer_code);
+  shader_.LinkShader();
+}
+
+void ShadingRateImage::Build(FrameBuffer* gbuffer,
+                             const glm::mat4& inv_projection) {
+  int width = gbuffer->GetWidth();
+  int height = gbuffer->GetHeight();
+  int tiles_x = (width + tile_width_ - 1) / tile_width_;
+  int tiles_y = (height + tile_height_ - 1) / tile_height_;
+  if (tiles_x != width_ || tiles_y != height_)
+    Allocate(tiles_x, tiles_y);
+
+  shader_.Enable();
+  gbuffer->BindTextures(0);
+  shader_.SetUniform("inv_projection", inv_projection);
+  shader_.SetUniform("gbuffer_size", glm::vec2(width, height));
+  glBindImageTexture(0, texture_, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_R8UI);
+  shader_.SetUniform("rate_image", 0);
+  glDispatchCompute(tiles_x, tiles_y, 1);
+  glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+}
+
+void ShadingRateImage::Enable() {
+  GLenum coarse = coarse_rate_ == RATE_4X4
+                      ? GL_SHADING_RATE_1_INVOCATION_PER_4X4_PIXELS_NV
+                      : GL_SHADING_RATE_1_INVOCATION_PER_2X2_PIXELS_NV;
+  GLenum palette[N_ENTRIES] = {GL_SHADING_RATE_1_INVOCATION_PER_PIXEL_NV,
+                               coarse,
+                               GL_SHADING_RATE_1_INVOCATION_PER_4X4_PIXELS_NV};
+  glShadingRateImagePaletteNV(0, 0, N_ENTRIES, palette);
+  glBindShadingRateImageNV(texture_);
+  glEnable(GL_SHADING_RATE_IMAGE_NV);
+}
+
+void ShadingRateImage::Disable() { glDisable(GL_SHADING_RATE_IMAGE_NV); }
+
+void ShadingRateImage::Allocate(int width, int height) {
+  if (texture_)
+    GLState::DeleteTextures(1, &texture_);
+  width_ = width;
+  height_ = height;
+  glCreateTextures(GL_TEXTURE_2D, 1, &texture_);
+  glTextureStorage2D(texture_, 1, GL_R8UI, width, height);
+}
@@ -0,0 +1,105 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef SHADINGRATEIMAGE_H
+#define SHADINGRATEIMAGE_H
+
+#include <string>
+
+#include <glm/glm.hpp>
+
+#include "FrameBuffer.h"
+#include "ShaderProgram.h"
+
+/**
+ * Shading rate image of the lighting pass (NV_shading_rate_image)
+ *
+ * Every tile of the size of the rate image texels is classified from the
+ * G-buffer (see shaders/shading_rate_cs.glsl): the tiles with only
+ * background are shaded once per 4x4 pixels, the tiles whose pixels lie on
+ * one plane with the same normal, such as the ground, at the coarse rate,
+ * and the others, with edges or curved surfaces, once per pixel.
+ */
+class ShadingRateImage {
+public:
+  /**
+   * Rates of the planar tiles
+   */
+  enum CoarseRate { RATE_2X2, RATE_4X4 };
+
+  /**
+   * Default constructor
+   */
+  ShadingRateImage();
+
+  /**
+   * Destructor
+   */
+  ~ShadingRateImage();
+
+  /**
+   * Returns true if the driver supports NV_shading_rate_image
+   */
+  static bool IsSupported();
+
+  /**
+   * Creates the classification shader, which reads the G-buffer with the
+   * code generated by its layout (see GBufferLayout)
+   * Throws runtime_error if the shader doesn't compile
+   */
+  void Init(const std::string& gbuffer_code, CoarseRate coarse_rate);
+
+  /**
+   * Classifies the tiles of the G-buffer, whose position is rebuilt with the
+   * inverse projection; binds its textures from the unit zero
+   * The storage is reallocated when the size of the frame buffer changes
+   */
+  void Build(FrameBuffer* gbuffer, const glm::mat4& inv_projection);
+
+  /**
+   * Enables the rates for the next draws, until Disable
+   */
+  void Enable();
+
+  /**
+   * Shades the next draws once per pixel
+   */
+  void Disable();
+
+private:
+  /**
+   * Creates the texture with a texel per tile of a size
+   */
+  void Allocate(int width, int height);
+
+  ShaderProgram shader_;
+  CoarseRate coarse_rate_;
+  unsigned int texture_;
+  int tile_width_;
+  int tile_height_;
+  int width_;
+  int height_;
+};
+
+#endif
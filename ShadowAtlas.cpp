@@ -0,0 +1,330 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/glm.hpp>
+
+#include "FrameAllocator.h"
+#include "Frustum.h"
+#include "GLCheck.h"
+#include "GLState.h"
+#include "ShadowAtlas.h"
+
+namespace {
+
+// Smallest and largest tile sizes, both powers of two
+const int MIN_TILE_SIZE = 64;
+const int MAX_TILE_SIZE = 1024;
+
+// A light keeps its tile size while the radius of its range on the screen
+// stays between these fractions of it
+const float SHRINK_RATIO = 0.35f;
+const float GROW_RATIO = 1.4f;
+
+// Near plane of the maps, as a fraction of the range of the light
+const float NEAR_RATIO = 0.02f;
+
+// Field of view of the maps relative to the cone, so the filter doesn't
+// read past the tile at its border, and its maximum in radians
+const float CONE_MARGIN = 1.05f;
+const float MAX_FIELD_OF_VIEW = 2.8f;
+
+// Depth bias of the maps, per slope and in units of the depth format
+const float SLOPE_BIAS = 2.0f;
+const float CONSTANT_BIAS = 4.0f;
+
+// Obtains the view projection of the map of a light in world space, a
+// square frustum around its cone up to its range
+glm::mat4 ComputeViewProjection(const LightTransform::SpotLight& light) {
+  float cutoff = glm::unpackHalf2x16(light.cone).x;
+  float field_of_view =
+      std::min(2 * std::acos(cutoff) * CONE_MARGIN, MAX_FIELD_OF_VIEW);
+  auto up = std::abs(light.direction.y) < 0.99f ? glm::vec3(0, 1, 0)
+                                                : glm::vec3(1, 0, 0);
+  auto view =
+      glm::lookAt(light.position, light.position + light.direction, up);
+  auto projection = glm::perspective(field_of_view, 1.0f,
+                                     light.range * NEAR_RATIO, light.range);
+  return projection * view;
+}
+
+}  // namespace
+
+ShadowAtlas::ShadowAtlas() : sampler_(0), size_(0), frame_(0) {}
+
+ShadowAtlas::~ShadowAtlas() {
+  if (sampler_)
+    GLState::DeleteSampler(sampler_);
+}
+
+void ShadowAtlas::Init(int size,
+                       const std::vector<LightTransform::SpotLight>& lights) {
+  size_ = size;
+  lights_ = lights;
+  Tile empty = {glm::mat4(1), glm::vec3(0), glm::ivec2(0), 0, false, false,
+                -1, 0.0f};
+  tiles_.assign(lights.size(), empty);
+  free_blocks_.assign(GetLevel(size) + 1, std::set<int>());
+  free_blocks_.back().insert(GetKey(glm::ivec2(0)));
+
+  // The maps are kept between frames
+  framebuffer_.Init(size, size, FrameBuffer::DEPTH_TEXTURE);
+  framebuffer_.SetLabel("shadowatlas");
+  framebuffer_.SetLoadAction(FrameBuffer::DEPTH_ATTACHMENT,
+                             FrameBuffer::ACTION_PRESERVE);
+  framebuffer_.SetStoreAction(FrameBuffer::DEPTH_ATTACHMENT,
+                              FrameBuffer::ACTION_PRESERVE);
+  framebuffer_.Verify();
+
+  glCreateSamplers(1, &sampler_);
+  glSamplerParameteri(sampler_, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glSamplerParameteri(sampler_, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glSamplerParameteri(sampler_, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glSamplerParameteri(sampler_, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glSamplerParameteri(sampler_, GL_TEXTURE_COMPARE_MODE,
+                      GL_COMPARE_REF_TO_TEXTURE);
+  glSamplerParameteri(sampler_, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+}
+
+FrameBuffer* ShadowAtlas::GetFrameBuffer() { return &framebuffer_; }
+
+const std::vector<int>& ShadowAtlas::Update(const glm::mat4& lights_to_world,
+                                            const glm::mat4& view_projection,
+                                            const glm::vec3& eye,
+                                            float pixels_per_unit, int budget,
+                                            bool geometry_changed) {
+  ++frame_;
+  glm::vec4 planes[6];
+  ExtractFrustumPlanes(view_projection, planes);
+
+  // Size wanted by each light, 0 if its range is out of the view
+  int n_lights = lights_.size();
+  FrameVector<int> wanted(n_lights, 0);
+  FrameVector<glm::mat4> matrices(n_lights);
+  FrameVector<glm::vec3> positions(n_lights);
+  for (int i = 0; i < n_lights; ++i) {
+    auto light = lights_[i];
+    light.position = glm::vec3(lights_to_world * glm::vec4(light.position, 1));
+    light.direction =
+        glm::normalize(glm::mat3(lights_to_world) * light.direction);
+    matrices[i] = ComputeViewProjection(light);
+    positions[i] = light.position;
+
+    auto& tile = tiles_[i];
+    tile.screen_pixels = 0;
+    bool visible = true;
+    for (auto& plane : planes)
+      if (glm::dot(glm::vec3(plane), light.position) + plane.w < -light.range)
+        visible = false;
+    if (!visible)
+      continue;
+    float distance = glm::distance(eye, light.position);
+    tile.screen_pixels = distance > light.range
+                             ? light.range * pixels_per_unit / distance
+                             : (float)MAX_TILE_SIZE;
+    int size = MIN_TILE_SIZE;
+    while (size < tile.screen_pixels && size < MAX_TILE_SIZE)
+      size *= 2;
+    if (tile.size && tile.screen_pixels > tile.size * SHRINK_RATIO &&
+        tile.screen_pixels < tile.size * GROW_RATIO)
+      size = tile.size;
+    wanted[i] = size;
+  }
+
+  // Tiles of the wrong size are given back before the new ones are taken,
+  // the most important lights first; a light that doesn't fit takes a
+  // smaller tile, or none
+  for (int i = 0; i < n_lights; ++i) {
+    auto& tile = tiles_[i];
+    if (tile.size && tile.size != wanted[i]) {
+      Free(tile.offset, tile.size);
+      tile.size = 0;
+      tile.valid = false;
+    }
+  }
+  // std::stable_sort would take a buffer from the heap, the ties are ordered
+  // by the lights instead
+  FrameVector<int> order(n_lights);
+  std::iota(order.begin(), order.end(), 0);
+  std::sort(order.begin(), order.end(), [this](int a, int b) {
+    if (tiles_[a].screen_pixels != tiles_[b].screen_pixels)
+      return tiles_[a].screen_pixels > tiles_[b].screen_pixels;
+    return a < b;
+  });
+  for (int i : order) {
+    auto& tile = tiles_[i];
+    if (tile.size || !wanted[i])
+      continue;
+    for (int size = wanted[i]; size >= MIN_TILE_SIZE; size /= 2) {
+      if (Allocate(size, &tile.offset)) {
+        tile.size = size;
+        break;
+      }
+    }
+  }
+
+  // The maps without shadow yet go first, then the oldest ones
+  updated_.clear();
+  for (int i = 0; i < n_lights; ++i) {
+    auto& tile = tiles_[i];
+    if (geometry_changed)
+      tile.current = false;
+    if (tile.size &&
+        !(tile.valid && tile.current && tile.view_projection == matrices[i]))
+      updated_.push_back(i);
+  }
+  std::sort(updated_.begin(), updated_.end(), [this](int a, int b) {
+    auto& tile_a = tiles_[a];
+    auto& tile_b = tiles_[b];
+    if (tile_a.valid != tile_b.valid)
+      return !tile_a.valid;
+    if (tile_a.last_update != tile_b.last_update)
+      return tile_a.last_update < tile_b.last_update;
+    if (tile_a.screen_pixels != tile_b.screen_pixels)
+      return tile_a.screen_pixels > tile_b.screen_pixels;
+    return a < b;
+  });
+  if ((int)updated_.size() > budget)
+    updated_.resize(budget);
+  for (int i : updated_) {
+    auto& tile = tiles_[i];
+    tile.view_projection = matrices[i];
+    tile.position = positions[i];
+    tile.valid = true;
+    tile.current = true;
+    tile.last_update = frame_;
+  }
+  return updated_;
+}
+
+const ShadowAtlas::Tile& ShadowAtlas::GetTile(int light) {
+  return tiles_[light];
+}
+
+const std::vector<LightTransform::SpotShadow>& ShadowAtlas::GetShadows(
+    const glm::mat4& world_to_view) {
+  // The texture may be larger than the atlas (see FrameBuffer)
+  float texture_size = framebuffer_.GetCapacityWidth();
+  auto view_to_world = glm::inverse(world_to_view);
+  shadows_.resize(tiles_.size());
+  for (size_t i = 0; i < tiles_.size(); ++i) {
+    auto& tile = tiles_[i];
+    if (!tile.size || !tile.valid) {
+      shadows_[i] = {glm::mat4(1), glm::vec4(0)};
+      continue;
+    }
+    shadows_[i].view_to_light = tile.view_projection * view_to_world;
+    shadows_[i].tile =
+        glm::vec4(glm::vec2(tile.offset), tile.size, 0) / texture_size;
+  }
+  return shadows_;
+}
+
+void ShadowAtlas::BeginTiles() {
+  glEnable(GL_DEPTH_TEST);
+  glDepthFunc(GL_LESS);
+  glDepthMask(GL_TRUE);
+  glEnable(GL_POLYGON_OFFSET_FILL);
+  glPolygonOffset(SLOPE_BIAS, CONSTANT_BIAS);
+  glEnable(GL_SCISSOR_TEST);
+}
+
+void ShadowAtlas::BeginTile(int light) {
+  auto& tile = tiles_[light];
+  glViewport(tile.offset.x, tile.offset.y, tile.size, tile.size);
+  glScissor(tile.offset.x, tile.offset.y, tile.size, tile.size);
+  glClear(GL_DEPTH_BUFFER_BIT);
+}
+
+void ShadowAtlas::EndTiles() {
+  glDisable(GL_SCISSOR_TEST);
+  glDisable(GL_POLYGON_OFFSET_FILL);
+}
+
+void ShadowAtlas::Bind(int unit) {
+  unsigned int texture = framebuffer_.GetDepthTexture();
+  GLState::BindTexture(unit, texture);
+  GLState::BindSamplers(unit, 1, &sampler_);
+}
+
+int ShadowAtlas::GetLevel(int size) {
+  int level = 0;
+  while ((MIN_TILE_SIZE << level) < size)
+    ++level;
+  return level;
+}
+
+bool ShadowAtlas::Allocate(int size, glm::ivec2* offset) {
+  int level = GetLevel(size);
+  int from = level;
+  while (from < (int)free_blocks_.size() && free_blocks_[from].empty())
+    ++from;
+  if (from == (int)free_blocks_.size())
+    return false;
+  int key = *free_blocks_[from].begin();
+  free_blocks_[from].erase(free_blocks_[from].begin());
+  glm::ivec2 block(key % size_, key / size_);
+
+  // Splits the block down to the size, keeping its first quarter
+  for (int i = from; i > level; --i) {
+    int half = MIN_TILE_SIZE << (i - 1);
+    for (int q = 1; q < 4; ++q)
+      free_blocks_[i - 1].insert(
+          GetKey(block + glm::ivec2(q & 1, q >> 1) * half));
+  }
+  *offset = block;
+  return true;
+}
+
+void ShadowAtlas::Free(glm::ivec2 offset, int size) {
+  int level = GetLevel(size);
+  int top = free_blocks_.size() - 1;
+  while (level < top) {
+    int block_size = MIN_TILE_SIZE << level;
+    auto parent = offset / (2 * block_size) * (2 * block_size);
+    bool merges = true;
+    for (int q = 0; q < 4; ++q) {
+      auto buddy = parent + glm::ivec2(q & 1, q >> 1) * block_size;
+      if (buddy != offset && !free_blocks_[level].count(GetKey(buddy)))
+        merges = false;
+    }
+    if (!merges)
+      break;
+    for (int q = 0; q < 4; ++q) {
+      auto buddy = parent + glm::ivec2(q & 1, q >> 1) * block_size;
+      free_blocks_[level].erase(GetKey(buddy));
+    }
+    offset = parent;
+    ++level;
+  }
+  free_blocks_[level].insert(GetKey(offset));
+}
+
+int ShadowAtlas::GetKey(glm::ivec2 offset) {
+  return offset.y * size_ + offset.x;
+}
@@ -0,0 +1,164 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef SHADOWATLAS_H
+#define SHADOWATLAS_H
+
+#include <set>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "FrameBuffer.h"
+#include "LightTransform.h"
+
+/**
+ * Shadow maps of the spot lights, as tiles of a single depth texture
+ *
+ * Each visible light gets a square tile whose side, a power of two, follows
+ * the pixels its range covers on the screen. The tiles come from a buddy
+ * allocator, so a light keeps its tile, and its map, until its size changes;
+ * the size only changes once the covered pixels move well past it. A map is
+ * cached while its light and the geometry don't move, and at most a budget of
+ * maps is rendered per frame: first the ones of the lights that just got a
+ * tile, which have no shadow until then, then the oldest ones. A map keeps
+ * the matrix it was rendered with, so a stale one stays consistent.
+ */
+class ShadowAtlas {
+public:
+  /**
+   * Tile of a light
+   */
+  struct Tile {
+    glm::mat4 view_projection;  // world to the clip space of the light
+    glm::vec3 position;         // of the light, in world space
+    glm::ivec2 offset;          // in the atlas, in pixels
+    int size;                   // in pixels per side, 0 without a tile
+    bool valid;                 // rendered since the tile was assigned
+    bool current;               // rendered with the geometry of now
+    long last_update;           // frame of the last render
+    float screen_pixels;        // radius of the range on the screen
+  };
+
+  /**
+   * Default constructor
+   */
+  ShadowAtlas();
+
+  /**
+   * Destructor
+   */
+  ~ShadowAtlas();
+
+  /**
+   * Creates the depth texture, of a power of two size, and its sampler for
+   * the lights, which are in world space before a transform given to Update
+   * Throws runtime_error if the frame buffer is incomplete
+   */
+  void Init(int size, const std::vector<LightTransform::SpotLight>& lights);
+
+  /**
+   * Obtains the frame buffer with the depth texture
+   */
+  FrameBuffer* GetFrameBuffer();
+
+  /**
+   * Assigns the tiles for the lights moved to world space by a transform and
+   * seen by a camera with the view projection, at an eye, whose screen
+   * covers some pixels per unit at a unit distance; picks up to budget maps
+   * to render in this frame, and every map is stale if the geometry changed
+   * Returns the lights whose maps are rendered, whose new matrices are
+   * already given by GetShadows
+   */
+  const std::vector<int>& Update(const glm::mat4& lights_to_world,
+                                 const glm::mat4& view_projection,
+                                 const glm::vec3& eye, float pixels_per_unit,
+                                 int budget, bool geometry_changed);
+
+  /**
+   * Obtains the tile of a light
+   */
+  const Tile& GetTile(int light);
+
+  /**
+   * Obtains the shadow of each light, for the lighting in view space, until
+   * the next call
+   */
+  const std::vector<LightTransform::SpotShadow>& GetShadows(
+      const glm::mat4& world_to_view);
+
+  /**
+   * Prepares the rendering of the maps into the bound frame buffer, with
+   * the depth bias
+   */
+  void BeginTiles();
+
+  /**
+   * Clears the tile of a light and restricts the next draws to it
+   */
+  void BeginTile(int light);
+
+  /**
+   * Restores the state changed by the tiles
+   */
+  void EndTiles();
+
+  /**
+   * Binds the depth texture to a unit with a comparison sampler
+   */
+  void Bind(int unit);
+
+private:
+  /**
+   * Obtains the level of the buddy allocator of a tile size
+   */
+  int GetLevel(int size);
+
+  /**
+   * Takes a free block of a size, returns false if there is none
+   */
+  bool Allocate(int size, glm::ivec2* offset);
+
+  /**
+   * Gives a block back, merging it with its free buddies
+   */
+  void Free(glm::ivec2 offset, int size);
+
+  /**
+   * Obtains the key of a block in the free lists
+   */
+  int GetKey(glm::ivec2 offset);
+
+  FrameBuffer framebuffer_;
+  unsigned int sampler_;
+  int size_;
+  std::vector<LightTransform::SpotLight> lights_;
+  std::vector<Tile> tiles_;
+  std::vector<std::set<int>> free_blocks_;  // per level, from the smallest
+  std::vector<int> updated_;
+  std::vector<LightTransform::SpotShadow> shadows_;
+  long frame_;
+};
+
+#endif
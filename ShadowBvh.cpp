@@ -0,0 +1,270 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <algorithm>
+#include <array>
+#include <cfloat>
+#include <string>
+#include <utility>
+
+#include "BufferBindings.h"
+#include "GLCheck.h"
+#include "ShadowBvh.h"
+
+namespace {
+
+// Threads per work group of the refit shader
+const int GROUP_SIZE = 64;
+
+// Triangles of a leaf of the mesh level at most
+const int LEAF_TRIANGLES = 4;
+
+// Creates a buffer of a size in bytes with its data, which the gl may update
+unsigned int CreateBuffer(size_t size, const void* data) {
+  unsigned int buffer;
+  glCreateBuffers(1, &buffer);
+  glNamedBufferStorage(buffer, size, data, GL_DYNAMIC_STORAGE_BIT);
+  return buffer;
+}
+
+// Node of nothing, which no ray crosses
+ShadowBvh::Node EmptyNode() {
+  return {glm::vec3(FLT_MAX), 0, glm::vec3(-FLT_MAX), 0};
+}
+
+// Orders a range of items so that the ones before the middle have their
+// centers before the ones after it along the longest axis of the bounds of
+// the centers, and returns the middle
+template <typename T, typename Center>
+int SplitAtMedian(std::vector<T>* items, int begin, int end, Center center) {
+  glm::vec3 low(FLT_MAX), high(-FLT_MAX);
+  for (int i = begin; i < end; ++i) {
+    low = glm::min(low, center((*items)[i]));
+    high = glm::max(high, center((*items)[i]));
+  }
+  auto size = high - low;
+  int axis = size.x > size.y ? (size.x > size.z ? 0 : 2)
+                             : (size.y > size.z ? 1 : 2);
+  int middle = begin + (end - begin) / 2;
+  std::nth_element(items->begin() + begin, items->begin() + middle,
+                   items->begin() + end, [&](const T& a, const T& b) {
+                     return center(a)[axis] < center(b)[axis];
+                   });
+  return middle;
+}
+
+// Centroid of a triangle, from its corners, times 3
+glm::vec3 GetCentroid(const std::array<glm::vec3, 3>& triangle) {
+  return triangle[0] + triangle[1] + triangle[2];
+}
+
+}  // namespace
+
+ShadowBvh::ShadowBvh()
+    : first_model_(0),
+      n_instances_(0),
+      uploaded_(false),
+      mesh_nodes_buffer_(0),
+      triangles_buffer_(0),
+      instance_nodes_buffer_(0),
+      instances_buffer_(0),
+      parents_buffer_(0),
+      refits_buffer_(0) {}
+
+ShadowBvh::~ShadowBvh() {
+  if (instance_nodes_buffer_) {
+    glDeleteBuffers(1, &mesh_nodes_buffer_);
+    glDeleteBuffers(1, &triangles_buffer_);
+    glDeleteBuffers(1, &instance_nodes_buffer_);
+    glDeleteBuffers(1, &instances_buffer_);
+    glDeleteBuffers(1, &parents_buffer_);
+    glDeleteBuffers(1, &refits_buffer_);
+  }
+}
+
+void ShadowBvh::Init(const glm::mat4* worlds, int first_model,
+                     int n_instances, const std::string& models_code) {
+  first_model_ = first_model;
+  n_instances_ = n_instances;
+  int n_nodes = std::max(2 * n_instances - 1, 1);
+
+  // Without instances a leaf of nothing stands for one
+  instance_nodes_.assign(n_nodes, EmptyNode());
+  parents_.assign(n_nodes, -1);
+  if (n_instances > 0) {
+    std::vector<std::pair<glm::vec3, int>> centers;
+    for (int i = 0; i < n_instances; ++i)
+      centers.push_back({glm::vec3(worlds[first_model + i][3]), i});
+    int next_internal = 0;
+    BuildInstanceNode(&centers, 0, n_instances, -1, &next_internal);
+  } else {
+    instance_nodes_[0].right = -1;
+  }
+  instance_nodes_buffer_ = CreateBuffer(n_nodes * sizeof(Node),
+                                        instance_nodes_.data());
+  parents_buffer_ = CreateBuffer(n_nodes * sizeof(int), parents_.data());
+  refits_buffer_ = CreateBuffer(n_nodes * sizeof(unsigned int), nullptr);
+  instances_buffer_ =
+      CreateBuffer(std::max(n_instances, 1) * sizeof(glm::mat4), nullptr);
+
+  // The mesh is a leaf of one triangle of no area until it's uploaded, and
+  // no ray enters the instances before their first refit
+  Node empty = EmptyNode();
+  empty.right = -1;
+  glm::vec4 triangle[3] = {};
+  mesh_nodes_buffer_ = CreateBuffer(sizeof(Node), &empty);
+  triangles_buffer_ = CreateBuffer(sizeof(triangle), triangle);
+
+  ShaderProgram::RegisterBlockBinding("ShadowMeshNodesBlock",
+                                      buffer_bindings::SHADOW_MESH_NODES);
+  ShaderProgram::RegisterBlockBinding("ShadowTrianglesBlock",
+                                      buffer_bindings::SHADOW_TRIANGLES);
+  ShaderProgram::RegisterBlockBinding("ShadowNodesBlock",
+                                      buffer_bindings::SHADOW_NODES);
+  ShaderProgram::RegisterBlockBinding("ShadowInstancesBlock",
+                                      buffer_bindings::SHADOW_INSTANCES);
+  ShaderProgram::RegisterBlockBinding("ShadowParentsBlock",
+                                      buffer_bindings::SHADOW_PARENTS);
+  ShaderProgram::RegisterBlockBinding("ShadowRefitsBlock",
+                                      buffer_bindings::SHADOW_REFITS);
+  shader_.LoadComputeShader(
+      "shaders/shadow_bvh_cs.glsl",
+      models_code + ShaderProgram::GenerateDefines(
+                        {{"GROUP_SIZE", std::to_string(GROUP_SIZE)}}));
+  shader_.LinkShader();
+  ShaderProgram::CheckBlockMember(
+      shader_.GetStorageBlockInfo("ShadowNodesBlock"),
+      "shadow_nodes[0].right", ShadowNodeLayout::Offset(3), sizeof(Node));
+}
+
+void ShadowBvh::SetMesh(const float* positions, const unsigned int* indices,
+                        int n_indices) {
+  std::vector<std::array<glm::vec3, 3>> triangles(n_indices / 3);
+  for (size_t i = 0; i < triangles.size(); ++i)
+    for (int j = 0; j < 3; ++j) {
+      auto position = positions + 3 * indices[3 * i + j];
+      triangles[i][j] = glm::vec3(position[0], position[1], position[2]);
+    }
+  triangles_.swap(triangles);
+  mesh_nodes_.clear();
+  if (triangles_.empty())
+    return;
+  BuildMeshNode(0, triangles_.size());
+}
+
+void ShadowBvh::Upload() {
+  if (mesh_nodes_.empty())
+    return;
+  std::vector<glm::vec4> corners;
+  for (auto& triangle : triangles_)
+    for (auto& corner : triangle)
+      corners.push_back(glm::vec4(corner, 1));
+  glDeleteBuffers(1, &mesh_nodes_buffer_);
+  glDeleteBuffers(1, &triangles_buffer_);
+  mesh_nodes_buffer_ = CreateBuffer(mesh_nodes_.size() * sizeof(Node),
+                                    mesh_nodes_.data());
+  triangles_buffer_ = CreateBuffer(corners.size() * sizeof(glm::vec4),
+                                   corners.data());
+  triangles_.clear();
+  triangles_.shrink_to_fit();
+  uploaded_ = true;
+}
+
+void ShadowBvh::Refit(UniformBuffer* models,
+                      const glm::mat4& world_to_view) {
+  if (!uploaded_ || !n_instances_)
+    return;
+  ShaderProgram::BindStorageBuffer(buffer_bindings::MODELS, models->GetId());
+  Bind();
+  ShaderProgram::BindStorageBuffer(buffer_bindings::SHADOW_PARENTS,
+                                   parents_buffer_);
+  ShaderProgram::BindStorageBuffer(buffer_bindings::SHADOW_REFITS,
+                                   refits_buffer_);
+  // No node has a refitted child yet
+  const unsigned int zero = 0;
+  glClearNamedBufferData(refits_buffer_, GL_R32UI, GL_RED_INTEGER,
+                         GL_UNSIGNED_INT, &zero);
+  shader_.Enable();
+  shader_.SetUniform("world_to_view", world_to_view);
+  shader_.SetUniform("first_model", first_model_);
+  shader_.SetUniform("n_instances", n_instances_);
+  glDispatchCompute((n_instances_ + GROUP_SIZE - 1) / GROUP_SIZE, 1, 1);
+  glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+void ShadowBvh::Bind() {
+  ShaderProgram::BindStorageBuffer(buffer_bindings::SHADOW_MESH_NODES,
+                                   mesh_nodes_buffer_);
+  ShaderProgram::BindStorageBuffer(buffer_bindings::SHADOW_TRIANGLES,
+                                   triangles_buffer_);
+  ShaderProgram::BindStorageBuffer(buffer_bindings::SHADOW_NODES,
+                                   instance_nodes_buffer_);
+  ShaderProgram::BindStorageBuffer(buffer_bindings::SHADOW_INSTANCES,
+                                   instances_buffer_);
+}
+
+int ShadowBvh::BuildMeshNode(int begin, int end) {
+  int index = mesh_nodes_.size();
+  Node node = EmptyNode();
+  for (int i = begin; i < end; ++i)
+    for (auto& corner : triangles_[i]) {
+      node.bounds_min = glm::min(node.bounds_min, corner);
+      node.bounds_max = glm::max(node.bounds_max, corner);
+    }
+  mesh_nodes_.push_back(node);
+  if (end - begin <= LEAF_TRIANGLES) {
+    mesh_nodes_[index].left = begin;
+    mesh_nodes_[index].right = begin - end;
+    return index;
+  }
+  int middle = SplitAtMedian(&triangles_, begin, end, GetCentroid);
+  int left = BuildMeshNode(begin, middle);
+  int right = BuildMeshNode(middle, end);
+  mesh_nodes_[index].left = left;
+  mesh_nodes_[index].right = right;
+  return index;
+}
+
+int ShadowBvh::BuildInstanceNode(
+    std::vector<std::pair<glm::vec3, int>>* centers, int begin, int end,
+    int parent, int* next_internal) {
+  // The leaves follow the n - 1 internal nodes, in the order of the centers
+  if (end - begin == 1) {
+    int index = n_instances_ - 1 + begin;
+    instance_nodes_[index].left = (*centers)[begin].second;
+    instance_nodes_[index].right = -1;
+    parents_[index] = parent;
+    return index;
+  }
+  int index = (*next_internal)++;
+  parents_[index] = parent;
+  int middle = SplitAtMedian(
+      centers, begin, end,
+      [](const std::pair<glm::vec3, int>& center) { return center.first; });
+  instance_nodes_[index].left =
+      BuildInstanceNode(centers, begin, middle, index, next_internal);
+  instance_nodes_[index].right =
+      BuildInstanceNode(centers, middle, end, index, next_internal);
+  return index;
+}
@@ -0,0 +1,145 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef SHADOWBVH_H
+#define SHADOWBVH_H
+
+#include <array>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "BlockLayout.h"
+#include "ShaderProgram.h"
+#include "UniformBuffer.h"
+
+/**
+ * Two-level bounding volume hierarchy of the instances of a mesh, which the
+ * spot lights trace their shadow rays through instead of rendering maps
+ *
+ * The mesh level bounds the triangles of the mesh, a few per leaf, in mesh
+ * space; it's built once on the cpu, splitting the triangles at the median
+ * of their centroids along the longest axis. The instance level has a leaf
+ * per instance and is built the same way from where the instances start,
+ * but its bounds are refitted on the gpu every frame, in view space, from
+ * the model matrices as they are then (see shaders/shadow_bvh_cs.glsl). Each
+ * leaf keeps the transform from view space to its mesh, so the rays walk
+ * one copy of the mesh level. The lighting traces one ray per lit pixel and
+ * light toward the light and stops at the first triangle it crosses (see
+ * shaders/shadow_bvh.glsl), so its cost grows with the logarithm of the
+ * geometry instead of rendering it once per light.
+ */
+class ShadowBvh {
+public:
+  /**
+   * Node of both levels, as struct ShadowNode of shaders/shadow_bvh.glsl
+   */
+  struct Node {
+    glm::vec3 bounds_min;
+    int left;
+    glm::vec3 bounds_max;
+    int right;
+  };
+
+  /**
+   * Default constructor
+   */
+  ShadowBvh();
+
+  /**
+   * Destructor
+   */
+  ~ShadowBvh();
+
+  /**
+   * Builds the instance level of the models from first_model on of
+   * ModelsBlock, from their world transforms, with an empty mesh until
+   * Upload(), and loads the refit shader, after the code of
+   * shaders/models.glsl
+   * Throws runtime_error if the shader fails or its blocks aren't laid out
+   * as expected
+   */
+  void Init(const glm::mat4* worlds, int first_model, int n_instances,
+            const std::string& models_code);
+
+  /**
+   * Builds the mesh level of the triangles of a mesh, with 3 floats per
+   * position; only touches the cpu, so it may run on a worker thread
+   */
+  void SetMesh(const float* positions, const unsigned int* indices,
+               int n_indices);
+
+  /**
+   * Sends the mesh level of SetMesh()
+   */
+  void Upload();
+
+  /**
+   * Refits the instance level to the model matrices of a buffer, moved to
+   * view space
+   * Does nothing before Upload(), the rays cross nothing until then
+   */
+  void Refit(UniformBuffer* models, const glm::mat4& world_to_view);
+
+  /**
+   * Binds both levels for a shader that traces rays
+   */
+  void Bind();
+
+private:
+  // Splits the triangles of a range into a node of the mesh level and
+  // returns its index
+  int BuildMeshNode(int begin, int end);
+
+  // Splits the instances of a range of centers, with their instances, into a
+  // node of the instance level under a parent and returns its index; the
+  // internal nodes are taken in turn from next_internal on
+  int BuildInstanceNode(std::vector<std::pair<glm::vec3, int>>* centers,
+                        int begin, int end, int parent, int* next_internal);
+
+  ShaderProgram shader_;
+  int first_model_;
+  int n_instances_;
+  bool uploaded_;
+  std::vector<std::array<glm::vec3, 3>> triangles_;  // until Upload()
+  std::vector<Node> mesh_nodes_;
+  std::vector<Node> instance_nodes_;
+  std::vector<int> parents_;  // of the instance nodes, -1 at the root
+  unsigned int mesh_nodes_buffer_;
+  unsigned int triangles_buffer_;
+  unsigned int instance_nodes_buffer_;
+  unsigned int instances_buffer_;
+  unsigned int parents_buffer_;
+  unsigned int refits_buffer_;
+};
+
+typedef BlockLayout<glm::vec3, int, glm::vec3, int> ShadowNodeLayout;
+CHECK_BLOCK_MEMBER(ShadowBvh::Node, ShadowNodeLayout, 0, bounds_min);
+CHECK_BLOCK_MEMBER(ShadowBvh::Node, ShadowNodeLayout, 1, left);
+CHECK_BLOCK_MEMBER(ShadowBvh::Node, ShadowNodeLayout, 2, bounds_max);
+CHECK_BLOCK_MEMBER(ShadowBvh::Node, ShadowNodeLayout, 3, right);
+CHECK_BLOCK_STRIDE(ShadowBvh::Node, ShadowNodeLayout, Std430Stride);
+
+#endif
@@ -0,0 +1,82 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "StatsPage.h"
+
+namespace {
+
+const char MAGIC[8] = "GLSTATS";
+
+}  // namespace
+
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t),
+              "the sequence must read as a plain 32-bit integer");
+
+StatsPage::StatsPage() : page_(nullptr) {}
+
+StatsPage::~StatsPage() {
+  if (page_)
+    munmap(page_, sizeof(Layout));
+}
+
+void StatsPage::Open(const std::string& path) {
+  int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0)
+    throw std::runtime_error("can't create " + path + ": " +
+                             strerror(errno));
+  void* mapping = MAP_FAILED;
+  if (ftruncate(fd, sizeof(Layout)) == 0)
+    mapping = mmap(nullptr, sizeof(Layout), PROT_READ | PROT_WRITE,
+                   MAP_SHARED, fd, 0);
+  int error = errno;
+  // The mapping stays valid once the descriptor is closed
+  close(fd);
+  if (mapping == MAP_FAILED)
+    throw std::runtime_error("can't map " + path + ": " + strerror(error));
+
+  // The file reads as zeros until the header is complete
+  page_ = (Layout*)mapping;
+  page_->version = VERSION;
+  page_->size = sizeof(Layout);
+  page_->pid = getpid();
+  page_->sequence.store(0, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  memcpy(page_->magic, MAGIC, sizeof(MAGIC));
+}
+
+void StatsPage::Publish(const Stats& stats) {
+  uint32_t sequence = page_->sequence.load(std::memory_order_relaxed);
+  page_->sequence.store(sequence + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  memcpy(&page_->stats, &stats, sizeof(Stats));
+  page_->sequence.store(sequence + 2, std::memory_order_release);
+}
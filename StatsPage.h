@@ -0,0 +1,115 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef STATSPAGE_H
+#define STATSPAGE_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+#include "GpuMemory.h"
+
+/**
+ * Memory mapped file with the live statistics, for the tools that poll them
+ * from other processes
+ *
+ * The file holds a Layout, of native byte order and alignment, whose header
+ * is written once and whose stats are published once per frame under a
+ * sequence lock: the sequence is odd while they are written, so a reader
+ * copies them between two reads of an equal, even sequence, and tries again
+ * otherwise. Publishing takes no lock and no system call, and a reader costs
+ * the render loop nothing. The version changes with the layout.
+ */
+class StatsPage {
+public:
+  static const uint32_t VERSION = 1;
+  static const int MAX_PASSES = 32;
+  static const int PASS_NAME_SIZE = 24;
+
+  /**
+   * Average gpu time per frame of a pass, over the last second
+   */
+  struct Pass {
+    char name[PASS_NAME_SIZE];  // null terminated
+    float milliseconds;
+  };
+
+  /**
+   * Statistics of a frame; the times are in milliseconds
+   */
+  struct Stats {
+    uint64_t frame;
+    float frame_ms[4];  // p50, p95, p99 and max of the kept frames
+    float cpu_ms[4];
+    float gpu_ms[4];
+    int32_t fps;  // of the last second
+    int32_t lights;
+    int32_t active_lights;
+    int32_t visible_lights;  // of the last second
+    int64_t gpu_bytes[GpuMemory::N_CATEGORIES];  // see GpuMemory
+    int64_t gpu_peak_total_bytes;
+    int64_t heap_allocations;  // of the frame allocator, since the start
+    int32_t n_passes;
+    Pass passes[MAX_PASSES];
+  };
+
+  /**
+   * Contents of the file
+   */
+  struct Layout {
+    char magic[8];  // "GLSTATS"
+    uint32_t version;
+    uint32_t size;  // of the layout, in bytes
+    uint32_t pid;   // of the writer
+    std::atomic<uint32_t> sequence;
+    Stats stats;
+  };
+
+  /**
+   * Default constructor
+   */
+  StatsPage();
+
+  /**
+   * Destructor, unmaps the file and leaves it with the last stats
+   */
+  ~StatsPage();
+
+  /**
+   * Creates or truncates the file, maps it and writes the header
+   * Throws runtime_error if the file can't be created or mapped
+   */
+  void Open(const std::string& path);
+
+  /**
+   * Copies the stats of a frame into the file
+   */
+  void Publish(const Stats& stats);
+
+private:
+  Layout* page_;
+};
+
+#endif
@@ -0,0 +1,115 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <algorithm>
+#include <cstring>
+
+#include <glm/gtc/type_ptr.hpp>
+
+#include "Std140Buffer.h"
+
+Std140Buffer::Std140Buffer() : padding_(0) {}
+
+template <typename T> void Std140Buffer::Add(T element) {
+  AddBytes(&element, sizeof(T));
+}
+
+template <typename T> void Std140Buffer::Add(T *elements, int n) {
+  AddBytes(elements, n * sizeof(T));
+}
+
+void Std140Buffer::Add(glm::vec3 element) {
+  AddBytes(glm::value_ptr(element), 3 * sizeof(float));
+}
+
+void Std140Buffer::Add(glm::vec4 element) {
+  AddBytes(glm::value_ptr(element), 4 * sizeof(float));
+}
+
+void Std140Buffer::Add(glm::mat4 element) {
+  AddBytes(glm::value_ptr(element), 16 * sizeof(float));
+}
+
+void Std140Buffer::FinishChunk() {
+  if (padding_ == 0)
+    return;
+  for (int i = padding_; i < 16; ++i)
+    buffer_.push_back(0);
+  padding_ = 0;
+}
+
+void Std140Buffer::Write(size_t offset, const void *data, size_t size) {
+  if (offset + size > buffer_.size())
+    return;
+  auto bytes = (const unsigned char *)data;
+  std::copy(bytes, bytes + size, buffer_.begin() + offset);
+}
+
+void Std140Buffer::GetChangedRanges(const Std140Buffer &previous,
+                                    size_t block_size,
+                                    std::vector<Range> *ranges) const {
+  ranges->clear();
+  size_t size = buffer_.size();
+  size_t start = size;  // start of the current range, size if none
+  for (size_t block = 0; block < size; block += block_size) {
+    size_t n = std::min(block_size, size - block);
+    bool dirty = memcmp(&buffer_[block], &previous.buffer_[block], n) != 0;
+    if (dirty && start == size) {
+      start = block;
+    } else if (!dirty && start != size) {
+      ranges->push_back({start, block - start});
+      start = size;
+    }
+  }
+  if (start != size)
+    ranges->push_back({start, size - start});
+}
+
+const unsigned char *Std140Buffer::GetData() const { return buffer_.data(); }
+
+size_t Std140Buffer::GetSize() const { return buffer_.size(); }
+
+void Std140Buffer::Clear() {
+  buffer_.clear();
+  padding_ = 0;
+}
+
+void Std140Buffer::AddBytes(const void *data, int size) {
+  int glsl_size = (size >= 4) ? size : 4;
+
+  if (padding_ + size > 16)
+    FinishChunk();
+
+  auto bytes = (const unsigned char *)data;
+  buffer_.insert(buffer_.end(), bytes, bytes + size);
+  buffer_.resize(buffer_.size() + glsl_size - size, 0);
+
+  padding_ = (padding_ + glsl_size) % 16;
+}
+
+template void Std140Buffer::Add(bool);
+template void Std140Buffer::Add(int);
+template void Std140Buffer::Add(unsigned int);
+template void Std140Buffer::Add(float);
+template void Std140Buffer::Add(float *, int);
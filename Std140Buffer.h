@@ -0,0 +1,121 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef STD140BUFFER_H
+#define STD140BUFFER_H
+
+#include <cstddef>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+/**
+ * Cpu side of a std140 buffer
+ *
+ * Packs the elements with the std140 alignment of scalars and vectors and
+ * pads the chunks (array elements and structures) to a vec4, and finds the
+ * ranges that changed from another packing. It makes no gl call, so the
+ * packing can be measured and checked without a context (see
+ * tools/pack_bench.cpp); UniformBuffer sends it to the gpu.
+ */
+class Std140Buffer {
+public:
+  /**
+   * Range of bytes of the buffer
+   */
+  struct Range {
+    size_t offset;
+    size_t size;
+  };
+
+  /**
+   * Default constructor
+   */
+  Std140Buffer();
+
+  /**
+   * Adds an element to the buffer
+   */
+  template <typename T> void Add(T element);
+
+  /**
+   * Adds a vetor/matrix to the buffer
+   */
+  template <typename T> void Add(T *elements, int n);
+  void Add(glm::vec3 element);
+  void Add(glm::vec4 element);
+  void Add(glm::mat4 element);
+
+  /**
+   * Adds an array of structures with a single copy
+   * The structures must have the layout of the GLSL array (see BlockLayout)
+   */
+  template <typename T> void AddArray(const T *elements, int n) {
+    static_assert(sizeof(T) % 16 == 0,
+                  "the array stride must be a multiple of a vec4");
+    FinishChunk();
+    AddBytes((const void *)elements, n * sizeof(T));
+  }
+
+  /**
+   * Complete the current chunk
+   * Should be used when finishing an element of an array
+   */
+  void FinishChunk();
+
+  /**
+   * Rewrites bytes already added, ignoring a range past the end
+   */
+  void Write(size_t offset, const void *data, size_t size);
+
+  /**
+   * Finds the blocks of that many bytes that differ from a buffer of the
+   * same size, merged into ranges in order
+   */
+  void GetChangedRanges(const Std140Buffer &previous, size_t block_size,
+                        std::vector<Range> *ranges) const;
+
+  /**
+   * Obtains the packed bytes
+   */
+  const unsigned char *GetData() const;
+  size_t GetSize() const;
+
+  /**
+   * Empties the buffer, keeping its memory
+   */
+  void Clear();
+
+private:
+  /**
+   * Adds some memory data to the buffer
+   */
+  void AddBytes(const void *data, int size);
+
+  std::vector<unsigned char> buffer_;
+  int padding_;
+};
+
+#endif
+
@@ -0,0 +1,60 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <algorithm>
+
+#include "BufferBindings.h"
+#include "GLCheck.h"
+#include "ShaderProgram.h"
+#include "StreamCompaction.h"
+
+StreamCompaction::StreamCompaction()
+    : buffer_(0), group_size_(1), max_tiles_(0) {}
+
+StreamCompaction::~StreamCompaction() {
+  if (buffer_)
+    glDeleteBuffers(1, &buffer_);
+}
+
+void StreamCompaction::Init(int max_elements, int group_size) {
+  group_size_ = std::max(group_size, 1);
+  max_tiles_ = std::max((max_elements + group_size_ - 1) / group_size_, 1);
+  // The next tile to claim, then the status of each one
+  glCreateBuffers(1, &buffer_);
+  glNamedBufferStorage(buffer_, (1 + max_tiles_) * sizeof(unsigned int),
+                       nullptr, GL_DYNAMIC_STORAGE_BIT);
+  ShaderProgram::RegisterBlockBinding("ScanTilesBlock",
+                                      buffer_bindings::SCAN_TILES);
+}
+
+int StreamCompaction::Bind(int n_elements) {
+  int n_tiles = (n_elements + group_size_ - 1) / group_size_;
+  n_tiles = std::max(0, std::min(n_tiles, max_tiles_));
+  const unsigned int zero = 0;
+  glClearNamedBufferSubData(buffer_, GL_R32UI, 0,
+                            (1 + n_tiles) * sizeof(unsigned int),
+                            GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+  ShaderProgram::BindStorageBuffer(buffer_bindings::SCAN_TILES, buffer_);
+  return n_tiles;
+}
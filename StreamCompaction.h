@@ -0,0 +1,70 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef STREAMCOMPACTION_H
+#define STREAMCOMPACTION_H
+
+/**
+ * State of the tiles of the single-pass prefix sums of shaders/scan.glsl,
+ * which compact the visible commands of MeshBatch and the visible lights of
+ * LightTransform in the order of their elements
+ *
+ * Each work group of a dispatch scans a tile of its elements and publishes
+ * its sum, and the next groups look back over those sums for their prefix,
+ * so the scan reads every element once and needs no second dispatch. The
+ * tiles must start from zero, so they are reset before each dispatch.
+ */
+class StreamCompaction {
+public:
+  /**
+   * Default constructor
+   */
+  StreamCompaction();
+
+  /**
+   * Destructor
+   */
+  ~StreamCompaction();
+
+  /**
+   * Creates the tiles of the dispatches of up to max_elements threads in
+   * work groups of group_size; registers ScanTilesBlock, so it comes before
+   * linking the shaders that include shaders/scan.glsl
+   */
+  void Init(int max_elements, int group_size);
+
+  /**
+   * Resets the tiles and binds them for a dispatch over n_elements, up to
+   * the ones of Init
+   * Returns the number of work groups to dispatch
+   */
+  int Bind(int n_elements);
+
+private:
+  unsigned int buffer_;
+  int group_size_;
+  int max_tiles_;
+};
+
+#endif
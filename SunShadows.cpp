@@ -0,0 +1,231 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <algorithm>
+#include <cmath>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "GLCheck.h"
+#include "GLState.h"
+#include "SunShadows.h"
+
+namespace {
+
+// Blend between the logarithmic and the uniform splits of the slices
+const float SPLIT_BLEND = 0.75f;
+
+// Extra radius of the box of a cascade over the sphere of its slice, which
+// the camera moves through before the box follows it, and the extra radius
+// above which a box fitted to a larger slice is shrunk back
+const float BOX_MARGIN = 0.25f;
+const float SHRINK_MARGIN = 0.75f;
+
+// Distance towards the sun beyond the box where the geometry still casts
+// shadows into it
+const float CASTER_DISTANCE = 100.0f;
+
+// Depth bias of the maps, per slope and in units of the depth format
+const float SLOPE_BIAS = 2.0f;
+const float CONSTANT_BIAS = 4.0f;
+
+}  // namespace
+
+// Defined, as std::min takes it by reference
+const int SunShadows::MAX_CASCADES;
+
+SunShadows::SunShadows()
+    : sampler_(0), size_(0), period_(1), specular_(0), frame_(0) {}
+
+SunShadows::~SunShadows() {
+  if (sampler_)
+    GLState::DeleteSampler(sampler_);
+}
+
+void SunShadows::Init(int size, int n_cascades, int period,
+                      const glm::vec3& direction, const glm::vec3& diffuse,
+                      float specular) {
+  size_ = size;
+  period_ = std::max(period, 1);
+  direction_ = glm::normalize(direction);
+  diffuse_ = diffuse;
+  specular_ = specular;
+  auto up = std::abs(direction_.y) < 0.99f ? glm::vec3(0, 1, 0)
+                                           : glm::vec3(1, 0, 0);
+  sun_view_ = glm::lookAt(glm::vec3(0), -direction_, up);
+  Cascade empty = {glm::mat4(1), glm::vec3(0), 0.0f, -1, false};
+  cascades_.assign(std::min(n_cascades, MAX_CASCADES), empty);
+
+  // The cascades are side by side and kept between frames
+  framebuffer_.Init(size * cascades_.size(), size,
+                    FrameBuffer::DEPTH_TEXTURE);
+  framebuffer_.SetLabel("sunshadows");
+  framebuffer_.SetLoadAction(FrameBuffer::DEPTH_ATTACHMENT,
+                             FrameBuffer::ACTION_PRESERVE);
+  framebuffer_.SetStoreAction(FrameBuffer::DEPTH_ATTACHMENT,
+                              FrameBuffer::ACTION_PRESERVE);
+  framebuffer_.Verify();
+
+  glCreateSamplers(1, &sampler_);
+  glSamplerParameteri(sampler_, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glSamplerParameteri(sampler_, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glSamplerParameteri(sampler_, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glSamplerParameteri(sampler_, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glSamplerParameteri(sampler_, GL_TEXTURE_COMPARE_MODE,
+                      GL_COMPARE_REF_TO_TEXTURE);
+  glSamplerParameteri(sampler_, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+}
+
+FrameBuffer* SunShadows::GetFrameBuffer() { return &framebuffer_; }
+
+const std::vector<int>& SunShadows::Update(const glm::mat4& world_to_view,
+                                           const glm::mat4& projection,
+                                           float near, float distance,
+                                           bool render) {
+  updated_.clear();
+  long frame = frame_++;
+  if (!render)
+    return updated_;
+
+  // The corners of the frustum on the near and the far planes, in view
+  // space, give the corners of a slice at any depth along their rays
+  auto clip_to_view = glm::inverse(projection);
+  glm::vec3 near_corners[4], far_corners[4];
+  for (int i = 0; i < 4; ++i) {
+    auto x = (float)(i & 1) * 2 - 1, y = (float)(i >> 1) * 2 - 1;
+    auto p = clip_to_view * glm::vec4(x, y, -1, 1);
+    auto q = clip_to_view * glm::vec4(x, y, 1, 1);
+    near_corners[i] = glm::vec3(p) / p.w;
+    far_corners[i] = glm::vec3(q) / q.w;
+  }
+  auto view_to_sun = sun_view_ * glm::inverse(world_to_view);
+
+  int n_cascades = cascades_.size();
+  for (int i = 0; i < n_cascades; ++i) {
+    auto& cascade = cascades_[i];
+    bool due = i == 0 || frame % period_ == (i - 1) % period_;
+    if (!due && cascade.valid)
+      continue;
+
+    // Bounding sphere of the slice, in the space of the sun
+    glm::vec3 corners[8];
+    float split[2];
+    for (int k = 0; k < 2; ++k) {
+      float t = (float)(i + k) / n_cascades;
+      float log_split = near * std::pow(distance / near, t);
+      float uniform_split = near + (distance - near) * t;
+      split[k] = SPLIT_BLEND * log_split + (1 - SPLIT_BLEND) * uniform_split;
+    }
+    glm::vec3 center(0);
+    for (int k = 0; k < 8; ++k) {
+      auto& a = near_corners[k % 4];
+      auto& b = far_corners[k % 4];
+      float t = (split[k / 4] + a.z) / (a.z - b.z);
+      corners[k] = glm::vec3(view_to_sun * glm::vec4(a + (b - a) * t, 1));
+      center += corners[k] / 8.0f;
+    }
+    float radius = 0;
+    for (auto& corner : corners)
+      radius = std::max(radius, glm::distance(center, corner));
+
+    // The box only moves once the slice leaves it, or it's too wide
+    auto offset = glm::abs(center - cascade.center);
+    float reach = std::max(std::max(offset.x, offset.y), offset.z) + radius;
+    if (!cascade.valid || reach > cascade.radius ||
+        cascade.radius > radius * (1 + SHRINK_MARGIN)) {
+      cascade.radius = radius * (1 + BOX_MARGIN);
+      float texel = 2 * cascade.radius / size_;
+      cascade.center = glm::vec3(glm::floor(glm::vec2(center) / texel + 0.5f) *
+                                     texel,
+                                 center.z);
+    }
+    ComputeViewProjection(&cascade);
+    cascade.last_update = frame;
+    cascade.valid = true;
+    updated_.push_back(i);
+  }
+  return updated_;
+}
+
+const SunShadows::Cascade& SunShadows::GetCascade(int cascade) {
+  return cascades_[cascade];
+}
+
+SunShadows::Block SunShadows::GetBlock(const glm::mat4& world_to_view) {
+  Block block;
+  block.direction = glm::normalize(glm::mat3(world_to_view) * direction_);
+  block.specular = specular_;
+  block.diffuse = diffuse_;
+  block.n_cascades = cascades_.size();
+  // The texture may be larger than the tiles (see FrameBuffer)
+  auto texture_size = glm::vec2(framebuffer_.GetCapacityWidth(),
+                                framebuffer_.GetCapacityHeight());
+  auto view_to_world = glm::inverse(world_to_view);
+  for (int i = 0; i < MAX_CASCADES; ++i) {
+    if (i >= (int)cascades_.size() || !cascades_[i].valid) {
+      block.view_to_clip[i] = glm::mat4(1);
+      block.tiles[i] = glm::vec4(0);
+      continue;
+    }
+    block.view_to_clip[i] = cascades_[i].view_projection * view_to_world;
+    block.tiles[i] = glm::vec4(glm::vec2(i * size_, 0) / texture_size,
+                               glm::vec2(size_) / texture_size);
+  }
+  return block;
+}
+
+void SunShadows::BeginCascades() {
+  glEnable(GL_DEPTH_TEST);
+  glDepthFunc(GL_LESS);
+  glDepthMask(GL_TRUE);
+  glEnable(GL_POLYGON_OFFSET_FILL);
+  glPolygonOffset(SLOPE_BIAS, CONSTANT_BIAS);
+  glEnable(GL_SCISSOR_TEST);
+}
+
+void SunShadows::BeginCascade(int cascade) {
+  glViewport(cascade * size_, 0, size_, size_);
+  glScissor(cascade * size_, 0, size_, size_);
+  glClear(GL_DEPTH_BUFFER_BIT);
+}
+
+void SunShadows::EndCascades() {
+  glDisable(GL_SCISSOR_TEST);
+  glDisable(GL_POLYGON_OFFSET_FILL);
+}
+
+void SunShadows::Bind(int unit) {
+  unsigned int texture = framebuffer_.GetDepthTexture();
+  GLState::BindTexture(unit, texture);
+  GLState::BindSamplers(unit, 1, &sampler_);
+}
+
+void SunShadows::ComputeViewProjection(Cascade* cascade) {
+  // The casters towards the sun are kept, up to CASTER_DISTANCE
+  auto c = cascade->center;
+  float r = cascade->radius;
+  auto projection = glm::ortho(c.x - r, c.x + r, c.y - r, c.y + r,
+                               -(c.z + r + CASTER_DISTANCE), -(c.z - r));
+  cascade->view_projection = projection * sun_view_;
+}
@@ -0,0 +1,163 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef SUNSHADOWS_H
+#define SUNSHADOWS_H
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "FrameBuffer.h"
+
+/**
+ * Directional sun light with cascaded shadow maps
+ *
+ * The view frustum is split in slices of growing depth, each covered by the
+ * orthographic map of a cascade, a tile of a single depth texture. A box is
+ * wider than the bounding sphere of its slice and only moves once the slice
+ * leaves it, by whole texels, so the texels of the static geometry land on
+ * the same depths; every map keeps the matrix it was rendered with, and the
+ * lighting picks the first one that covers a position, so a cached cascade
+ * stays usable while the camera moves. The nearest cascade is rendered every
+ * frame and the others take turns, one per frame of a period.
+ */
+class SunShadows {
+public:
+  /**
+   * Most cascades, also the size of the arrays of SunBlock in
+   * shaders/sun_shading.glsl
+   */
+  static const int MAX_CASCADES = 4;
+
+  /**
+   * Cascade of the maps
+   */
+  struct Cascade {
+    glm::mat4 view_projection;  // world to the clip space of the map
+    glm::vec3 center;           // of the box, in the space of the sun
+    float radius;               // half the side of the box
+    long last_update;           // frame of the last render
+    bool valid;                 // rendered since the box was set
+  };
+
+  /**
+   * Uniform block of the sun, as SunBlock in shaders/sun_shading.glsl
+   */
+  struct Block {
+    glm::vec3 direction;  // towards the sun, in view space
+    float specular;
+    glm::vec3 diffuse;
+    int n_cascades;
+    glm::mat4 view_to_clip[MAX_CASCADES];  // of each map, identity if none
+    glm::vec4 tiles[MAX_CASCADES];  // offset and size, zero without a map
+  };
+
+  /**
+   * Default constructor
+   */
+  SunShadows();
+
+  /**
+   * Destructor
+   */
+  ~SunShadows();
+
+  /**
+   * Creates the depth texture of the cascades, with tiles of size pixels per
+   * side, for a sun in a world-space direction towards it with its colors;
+   * every cascade after the first is rendered once every period frames
+   * Throws runtime_error if the frame buffer is incomplete
+   */
+  void Init(int size, int n_cascades, int period, const glm::vec3& direction,
+            const glm::vec3& diffuse, float specular);
+
+  /**
+   * Obtains the frame buffer with the depth texture
+   */
+  FrameBuffer* GetFrameBuffer();
+
+  /**
+   * Fits the cascades to the slices of a camera view, whose projection is
+   * perspective, from the near plane up to the shadow distance, and picks
+   * the cascades to render in this frame, none unless render is set
+   * Returns the cascades rendered, whose new matrices are already given by
+   * GetCascade
+   */
+  const std::vector<int>& Update(const glm::mat4& world_to_view,
+                                 const glm::mat4& projection, float near,
+                                 float distance, bool render);
+
+  /**
+   * Obtains a cascade
+   */
+  const Cascade& GetCascade(int cascade);
+
+  /**
+   * Obtains the uniform block of the sun and its maps for the lighting in
+   * view space
+   */
+  Block GetBlock(const glm::mat4& world_to_view);
+
+  /**
+   * Prepares the rendering of the maps into the bound frame buffer, with
+   * the depth bias
+   */
+  void BeginCascades();
+
+  /**
+   * Clears the tile of a cascade and restricts the next draws to it
+   */
+  void BeginCascade(int cascade);
+
+  /**
+   * Restores the state changed by the cascades
+   */
+  void EndCascades();
+
+  /**
+   * Binds the depth texture to a unit with a comparison sampler
+   */
+  void Bind(int unit);
+
+private:
+  /**
+   * Computes the matrix of a cascade from its box
+   */
+  void ComputeViewProjection(Cascade* cascade);
+
+  FrameBuffer framebuffer_;
+  unsigned int sampler_;
+  int size_;
+  int period_;
+  glm::vec3 direction_;
+  glm::vec3 diffuse_;
+  float specular_;
+  glm::mat4 sun_view_;  // world to the space of the sun, a rotation
+  std::vector<Cascade> cascades_;
+  std::vector<int> updated_;
+  long frame_;
+};
+
+#endif
@@ -0,0 +1,224 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <dlfcn.h>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+
+#include "CpuProfiler.h"
+#include "Telemetry.h"
+
+namespace {
+
+// Files of the energy counter of the first cpu package, in microjoules
+const char* RAPL_ENERGY = "/sys/class/powercap/intel-rapl:0/energy_uj";
+const char* RAPL_RANGE = "/sys/class/powercap/intel-rapl:0/max_energy_range_uj";
+
+// Arguments of the NVML functions, as in nvml.h
+const int NVML_SUCCESS = 0;
+const int NVML_CLOCK_GRAPHICS = 0;
+const int NVML_TEMPERATURE_GPU = 0;
+
+// Reads the number in a file, returns false if it can't be read
+bool ReadNumber(const char* path, double* number) {
+  std::ifstream file(path);
+  return (bool)(file >> *number);
+}
+
+// Adds a reading to its sum if it's known
+void Accumulate(float value, float* sum, int* known) {
+  if (value < 0)
+    return;
+  *sum += value;
+  (*known)++;
+}
+
+}  // namespace
+
+Telemetry::Telemetry()
+    : nvml_(nullptr),
+      gpu_(nullptr),
+      nvml_shutdown_(nullptr),
+      get_clock_(nullptr),
+      get_power_(nullptr),
+      get_temperature_(nullptr),
+      cpu_energy_range_(0),
+      stop_(false),
+      period_ms_(0),
+      reading_{-1, -1, -1, -1} {
+  Reset();
+}
+
+Telemetry::~Telemetry() { Stop(); }
+
+void Telemetry::Start(int period_ms) {
+  period_ms_ = period_ms;
+  OpenNvml();
+  if (!ReadNumber(RAPL_RANGE, &cpu_energy_range_))
+    cpu_energy_range_ = 0;
+  cpu_energy_range_ /= 1e6;
+  thread_ = std::thread(&Telemetry::Run, this);
+}
+
+void Telemetry::Stop() {
+  if (!thread_.joinable())
+    return;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  wake_.notify_one();
+  thread_.join();
+  if (nvml_) {
+    nvml_shutdown_();
+    dlclose(nvml_);
+    nvml_ = nullptr;
+  }
+}
+
+Telemetry::Reading Telemetry::GetReading() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return reading_;
+}
+
+void Telemetry::Reset() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  sums_ = {{0, 0, 0, 0}, -1, -1, -1, -1, 0};
+  std::fill(known_, known_ + 4, 0);
+}
+
+Telemetry::Summary Telemetry::GetSummary() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto summary = sums_;
+  float* means[] = {&summary.mean.gpu_clock_mhz, &summary.mean.gpu_power_w,
+                    &summary.mean.gpu_temperature_c,
+                    &summary.mean.cpu_power_w};
+  for (int i = 0; i < 4; ++i)
+    *means[i] = known_[i] ? *means[i] / known_[i] : -1;
+  return summary;
+}
+
+bool Telemetry::OpenNvml() {
+  nvml_ = dlopen("libnvidia-ml.so.1", RTLD_NOW | RTLD_LOCAL);
+  if (!nvml_)
+    return false;
+  auto init = (int (*)())dlsym(nvml_, "nvmlInit_v2");
+  auto get_handle =
+      (int (*)(unsigned int, void**))dlsym(nvml_,
+                                           "nvmlDeviceGetHandleByIndex_v2");
+  nvml_shutdown_ = (int (*)())dlsym(nvml_, "nvmlShutdown");
+  get_clock_ = (int (*)(void*, int, unsigned int*))dlsym(
+      nvml_, "nvmlDeviceGetClockInfo");
+  get_power_ =
+      (int (*)(void*, unsigned int*))dlsym(nvml_, "nvmlDeviceGetPowerUsage");
+  get_temperature_ = (int (*)(void*, int, unsigned int*))dlsym(
+      nvml_, "nvmlDeviceGetTemperature");
+  bool found = init && get_handle && nvml_shutdown_ && get_clock_ &&
+               get_power_ && get_temperature_;
+  if (found && init() == NVML_SUCCESS) {
+    if (get_handle(0, &gpu_) == NVML_SUCCESS)
+      return true;
+    nvml_shutdown_();
+  }
+  dlclose(nvml_);
+  nvml_ = nullptr;
+  return false;
+}
+
+void Telemetry::ReadGpu(Reading* reading) {
+  if (!nvml_)
+    return;
+  unsigned int value;
+  if (get_clock_(gpu_, NVML_CLOCK_GRAPHICS, &value) == NVML_SUCCESS)
+    reading->gpu_clock_mhz = value;
+  // In milliwatts
+  if (get_power_(gpu_, &value) == NVML_SUCCESS)
+    reading->gpu_power_w = value / 1000.0f;
+  if (get_temperature_(gpu_, NVML_TEMPERATURE_GPU, &value) == NVML_SUCCESS)
+    reading->gpu_temperature_c = value;
+}
+
+bool Telemetry::ReadCpuEnergy(double* joules) {
+  double microjoules;
+  if (!ReadNumber(RAPL_ENERGY, &microjoules))
+    return false;
+  *joules = microjoules / 1e6;
+  return true;
+}
+
+void Telemetry::Run() {
+  CpuProfiler::SetThreadName("telemetry");
+  using namespace std::chrono;
+  auto last = steady_clock::now();
+  double last_energy = 0;
+  bool has_energy = ReadCpuEnergy(&last_energy);
+  for (;;) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      if (wake_.wait_for(lock, milliseconds(period_ms_),
+                         [this] { return stop_; }))
+        return;
+    }
+    auto now = steady_clock::now();
+    double seconds = duration<double>(now - last).count();
+    last = now;
+    Reading reading = {-1, -1, -1, -1};
+    ReadGpu(&reading);
+    // The counter wraps around its range
+    double energy, cpu_joules = -1;
+    if (ReadCpuEnergy(&energy)) {
+      if (has_energy) {
+        cpu_joules = energy - last_energy;
+        if (cpu_joules < 0)
+          cpu_joules += cpu_energy_range_;
+        reading.cpu_power_w = cpu_joules / seconds;
+      }
+      last_energy = energy;
+      has_energy = true;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    reading_ = reading;
+    sums_.samples++;
+    Accumulate(reading.gpu_clock_mhz, &sums_.mean.gpu_clock_mhz, &known_[0]);
+    Accumulate(reading.gpu_power_w, &sums_.mean.gpu_power_w, &known_[1]);
+    Accumulate(reading.gpu_temperature_c, &sums_.mean.gpu_temperature_c,
+               &known_[2]);
+    Accumulate(reading.cpu_power_w, &sums_.mean.cpu_power_w, &known_[3]);
+    if (reading.gpu_clock_mhz >= 0 &&
+        (sums_.min_gpu_clock_mhz < 0 ||
+         reading.gpu_clock_mhz < sums_.min_gpu_clock_mhz))
+      sums_.min_gpu_clock_mhz = reading.gpu_clock_mhz;
+    sums_.max_gpu_temperature_c =
+        std::max(sums_.max_gpu_temperature_c, reading.gpu_temperature_c);
+    // The power of the gpu holds over the period since the last sample
+    if (reading.gpu_power_w >= 0)
+      sums_.gpu_joules =
+          std::max(sums_.gpu_joules, 0.0) + reading.gpu_power_w * seconds;
+    if (cpu_joules >= 0)
+      sums_.cpu_joules = std::max(sums_.cpu_joules, 0.0) + cpu_joules;
+  }
+}
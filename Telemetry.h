@@ -0,0 +1,137 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+/**
+ * Power, clock and temperature readings of the gpu and the cpu, sampled on a
+ * thread of its own
+ *
+ * The gpu is read through NVML, loaded at runtime so the build doesn't need
+ * it, and the cpu package through the RAPL energy counter of powercap; a
+ * source that isn't available reads as negative. The thread samples both
+ * every period, and sums the energy and the readings since the last reset,
+ * so a benchmark can tell a throttled gpu from a slower frame and report the
+ * energy per frame. The render thread only copies the readings under a lock
+ * the thread holds for a few assignments.
+ */
+class Telemetry {
+public:
+  /**
+   * Readings of a sample, negative if unknown
+   */
+  struct Reading {
+    float gpu_clock_mhz;
+    float gpu_power_w;
+    float gpu_temperature_c;
+    float cpu_power_w;
+  };
+
+  /**
+   * Readings since the last reset
+   */
+  struct Summary {
+    Reading mean;
+    float min_gpu_clock_mhz;
+    float max_gpu_temperature_c;
+    double gpu_joules;  // negative if unknown
+    double cpu_joules;  // negative if unknown
+    int samples;
+  };
+
+  /**
+   * Default constructor
+   */
+  Telemetry();
+
+  /**
+   * Destructor, stops the thread
+   */
+  ~Telemetry();
+
+  /**
+   * Opens the sources and starts sampling them every period
+   */
+  void Start(int period_ms);
+
+  /**
+   * Stops the thread, if it was started
+   */
+  void Stop();
+
+  /**
+   * Obtains the readings of the last sample
+   */
+  Reading GetReading();
+
+  /**
+   * Starts summing the readings from the next sample
+   */
+  void Reset();
+
+  /**
+   * Obtains the readings since the last reset
+   */
+  Summary GetSummary();
+
+private:
+  // Loads NVML and finds the first gpu
+  // Returns false if there's no NVML or no gpu
+  bool OpenNvml();
+
+  // Reads the gpu readings, leaves them if NVML isn't open
+  void ReadGpu(Reading* reading);
+
+  // Reads the energy counter of the cpu package, in joules
+  // Returns false if there's no counter or it can't be read
+  bool ReadCpuEnergy(double* joules);
+
+  // Samples the sources every period until stopped
+  void Run();
+
+  // NVML functions, with the handles of the library and of the gpu
+  void* nvml_;
+  void* gpu_;
+  int (*nvml_shutdown_)();
+  int (*get_clock_)(void*, int, unsigned int*);
+  int (*get_power_)(void*, unsigned int*);
+  int (*get_temperature_)(void*, int, unsigned int*);
+  double cpu_energy_range_;  // joules the counter wraps at
+
+  std::thread thread_;
+  std::mutex mutex_;
+  std::condition_variable wake_;  // on the stop
+  bool stop_;
+  int period_ms_;
+  Reading reading_;
+  Summary sums_;  // of the readings, divided by GetSummary()
+  int known_[4];  // samples of each reading since the reset
+};
+
+#endif
@@ -0,0 +1,202 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <map>
+
+#include <lodepng.h>
+
+#include "GLCheck.h"
+#include "GLState.h"
+#include "ParallelFor.h"
+#include "TextureArray.h"
+#include "TextureCompression.h"
+
+namespace {
+
+// Obtains the number of levels of a power of two size
+int CountLevels(int size) {
+  int n_levels = 1;
+  while ((size >> n_levels) > 0)
+    n_levels++;
+  return n_levels;
+}
+
+}  // namespace
+
+TextureArray::TextureArray()
+    : size_(0),
+      n_layers_(0),
+      n_levels_(0),
+      compressed_(false),
+      bindless_(false),
+      texture_(0),
+      queue_(nullptr),
+      ticket_(0) {}
+
+TextureArray::~TextureArray() {
+  if (texture_)
+    GLState::DeleteTextures(1, &texture_);
+  for (auto handle : handles_)
+    glMakeTextureHandleNonResidentARB(handle);
+  if (!layer_textures_.empty())
+    GLState::DeleteTextures(layer_textures_.size(), layer_textures_.data());
+}
+
+void TextureArray::UseBindless() { bindless_ = true; }
+
+std::vector<int> TextureArray::Decode(const std::vector<std::string>& paths,
+                                      int size) {
+  size_ = size;
+  n_levels_ = CountLevels(size);
+
+  // Each file is decoded once, in the order of its first use
+  std::map<std::string, int> file_ids;
+  std::vector<std::string> files;
+  for (auto& path : paths) {
+    if (!path.empty() && file_ids.emplace(path, files.size()).second)
+      files.push_back(path);
+  }
+  std::vector<std::vector<std::vector<unsigned char>>> levels(files.size());
+  std::vector<unsigned> errors(files.size(), 0);
+  std::vector<int> sizes(files.size(), size);
+
+  // The compressed files are used only if every one is there, since the
+  // layers share a format
+  std::vector<char> compressed(files.size(), 0);
+  if (GLEW_EXT_texture_compression_s3tc) {
+    ParallelFor(files.size(), [&](int begin, int end) {
+      for (int i = begin; i < end; ++i)
+        compressed[i] = ReadKtx2(GetKtx2Path(files[i]), size, &levels[i]);
+    }, 1);
+  }
+  compressed_ = !files.empty() &&
+                std::find(compressed.begin(), compressed.end(), 0) ==
+                    compressed.end();
+  if (!compressed_) {
+    ParallelFor(files.size(), [&](int begin, int end) {
+      for (int i = begin; i < end; ++i) {
+        std::vector<unsigned char> image;
+        unsigned width, height;
+        errors[i] = lodepng::decode(image, width, height, files[i]);
+        if (errors[i])
+          continue;
+        // Only the layers of the array share a size
+        if (bindless_)
+          while (sizes[i] > 1 && sizes[i] / 2 >= (int)std::max(width, height))
+            sizes[i] /= 2;
+        levels[i] = BuildMipmaps(
+            ResampleImage(image, width, height, sizes[i]), sizes[i]);
+      }
+    }, 1);
+  }
+
+  std::vector<int> file_layers(files.size(), -1);
+  for (size_t i = 0; i < files.size(); ++i) {
+    if (errors[i]) {
+      fprintf(stderr, "Unable to decode texture %s: %s\n", files[i].c_str(),
+              lodepng_error_text(errors[i]));
+      continue;
+    }
+    file_layers[i] = n_layers_++;
+    layer_sizes_.push_back(sizes[i]);
+    for (auto& level : levels[i])
+      images_.push_back(std::move(level));
+  }
+  std::vector<int> layers;
+  for (auto& path : paths)
+    layers.push_back(path.empty() ? -1 : file_layers[file_ids[path]]);
+  return layers;
+}
+
+void TextureArray::Upload(UploadQueue* queue) {
+  queue_ = queue;
+  if (!n_layers_)
+    return;
+  unsigned int format =
+      compressed_ ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT : GL_RGBA8;
+  // The layers of the bindless textures are their first layer, so the copies
+  // of the queue reach them the same way
+  if (bindless_) {
+    layer_textures_.resize(n_layers_);
+    glCreateTextures(GL_TEXTURE_2D_ARRAY, n_layers_, layer_textures_.data());
+  } else {
+    glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &texture_);
+    glTextureStorage3D(texture_, n_levels_, format, size_, size_, n_layers_);
+    glTextureParameteri(texture_, GL_TEXTURE_MIN_FILTER,
+                        GL_LINEAR_MIPMAP_LINEAR);
+    glTextureParameteri(texture_, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  }
+  size_t first_image = 0;
+  for (int layer = 0; layer < n_layers_; ++layer) {
+    int layer_size = layer_sizes_[layer];
+    int n_levels = CountLevels(layer_size);
+    unsigned int texture = texture_;
+    int z = layer;
+    if (bindless_) {
+      texture = layer_textures_[layer];
+      z = 0;
+      glTextureStorage3D(texture, n_levels, format, layer_size, layer_size,
+                         1);
+      glTextureParameteri(texture, GL_TEXTURE_MIN_FILTER,
+                          GL_LINEAR_MIPMAP_LINEAR);
+      glTextureParameteri(texture, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    }
+    for (int level = 0; level < n_levels; ++level) {
+      auto& image = images_[first_image + level];
+      int level_size = layer_size >> level;
+      if (queue) {
+        ticket_ = queue->AddTexture(texture, level, 0, 0, z, level_size,
+                                    level_size, std::move(image),
+                                    compressed_ ? format : 0);
+      } else if (compressed_) {
+        glCompressedTextureSubImage3D(texture, level, 0, 0, z, level_size,
+                                      level_size, 1, format, image.size(),
+                                      image.data());
+      } else {
+        glTextureSubImage3D(texture, level, 0, 0, z, level_size, level_size,
+                            1, GL_RGBA, GL_UNSIGNED_BYTE, image.data());
+      }
+    }
+    first_image += n_levels;
+  }
+  std::vector<std::vector<unsigned char>>().swap(images_);
+
+  // The parameters are fixed once a texture has a handle; the residency
+  // doesn't wait for the copies, which are done before the maps are read
+  for (auto texture : layer_textures_) {
+    handles_.push_back(glGetTextureHandleARB(texture));
+    glMakeTextureHandleResidentARB(handles_.back());
+  }
+}
+
+bool TextureArray::IsReady() {
+  bool created = texture_ || !layer_textures_.empty();
+  return !n_layers_ || (created && (!queue_ || queue_->IsDone(ticket_)));
+}
+
+void TextureArray::Bind(int unit) { GLState::BindTexture(unit, texture_); }
+
+const std::vector<uint64_t>& TextureArray::GetHandles() { return handles_; }
@@ -0,0 +1,116 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef TEXTUREARRAY_H
+#define TEXTUREARRAY_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "UploadQueue.h"
+
+/**
+ * Diffuse maps of the materials, as the layers of a single array texture
+ *
+ * A batch draws every material with one call, so the shaders pick the map of
+ * a material by its layer instead of rebinding textures. The layers share a
+ * size, a power of two, and the images are resampled to it. The PNG files are
+ * decoded and their mipmaps built by Decode(), a file per worker thread and
+ * only on the cpu, so it may run on a loading thread. The BC1 KTX2 files that
+ * tools/compress_textures.cpp makes from them are read instead when the gpu
+ * supports S3TC, so the texture takes an eighth of the memory and nothing is
+ * filtered at startup. Upload() then creates the texture and copies the
+ * levels through the pixel unpack buffer of an UploadQueue, so the frames
+ * that stream them never stall on the copies. With UseBindless() each layer
+ * is a texture of its own instead, read through a bindless handle.
+ */
+class TextureArray {
+public:
+  /**
+   * Default constructor
+   */
+  TextureArray();
+
+  /**
+   * Destructor
+   */
+  ~TextureArray();
+
+  /**
+   * Makes every layer a texture of its own, a single layer array, with a
+   * resident bindless handle (ARB_bindless_texture); the decoded images keep
+   * their size rounded up to a power of two, up to the one asked
+   * Must be called before Decode()
+   */
+  void UseBindless();
+
+  /**
+   * Decodes PNG files, "" for none, into layers of size x size texels with
+   * every mipmap; repeated files share a layer
+   * Reads the KTX2 file of each one instead if all of them have one of that
+   * size
+   * Returns the layer of each file, -1 for none and for the files that can't
+   * be decoded, which are reported on stderr
+   * Must be called once, before Upload()
+   */
+  std::vector<int> Decode(const std::vector<std::string>& paths, int size);
+
+  /**
+   * Creates the texture and uploads the levels right away or through a
+   * queue; does nothing without layers
+   */
+  void Upload(UploadQueue* queue = nullptr);
+
+  /**
+   * Checks if every level is on the gpu
+   */
+  bool IsReady();
+
+  /**
+   * Binds the texture to a texture unit, without bindless handles
+   */
+  void Bind(int unit);
+
+  /**
+   * Obtains the bindless handle of each layer, once uploaded
+   */
+  const std::vector<uint64_t>& GetHandles();
+
+private:
+  int size_;
+  int n_layers_;
+  int n_levels_;
+  bool compressed_;  // BC1 levels
+  bool bindless_;
+  std::vector<int> layer_sizes_;
+  std::vector<std::vector<unsigned char>> images_;  // of each layer and level
+  unsigned int texture_;
+  std::vector<unsigned int> layer_textures_;  // with bindless handles
+  std::vector<uint64_t> handles_;
+  UploadQueue* queue_;
+  uint64_t ticket_;
+};
+
+#endif
@@ -0,0 +1,367 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+
+#include <glm/glm.hpp>
+
+#include "TextureCompression.h"
+
+namespace {
+
+// VK_FORMAT_BC1_RGB_UNORM_BLOCK, the vkFormat of the KTX2 files
+const uint32_t VK_FORMAT_BC1_RGB = 131;
+
+// Bytes of a BC1 block
+const int BC1_BLOCK_SIZE = 8;
+
+const unsigned char KTX2_IDENTIFIER[12] = {0xAB, 'K',  'T',  'X', ' ',  '2',
+                                           '0',  0xBB, '\r', '\n', 0x1A, '\n'};
+
+// Start of a KTX2 file, after the identifier
+struct Ktx2Header {
+  uint32_t vk_format;
+  uint32_t type_size;
+  uint32_t pixel_width;
+  uint32_t pixel_height;
+  uint32_t pixel_depth;
+  uint32_t layer_count;
+  uint32_t face_count;
+  uint32_t level_count;
+  uint32_t supercompression_scheme;
+  uint32_t dfd_byte_offset;
+  uint32_t dfd_byte_length;
+  uint32_t kvd_byte_offset;
+  uint32_t kvd_byte_length;
+  uint64_t sgd_byte_offset;
+  uint64_t sgd_byte_length;
+};
+
+// Entry of the level index of a KTX2 file
+struct Ktx2Level {
+  uint64_t byte_offset;
+  uint64_t byte_length;
+  uint64_t uncompressed_byte_length;
+};
+
+// Basic data format descriptor of BC1, with its single sample (see the
+// Khronos Data Format Specification)
+const uint32_t BC1_DFD[] = {
+    44,                      // total size
+    0,                       // KHR vendor, basic descriptor type
+    2 | 40 << 16,            // version 1.3, size of the block
+    128 | 1 << 8 | 1 << 16,  // BC1A model, BT.709 primaries, linear
+    3 | 3 << 8,              // 4x4 texel blocks
+    BC1_BLOCK_SIZE,          // bytes of the first plane
+    0,
+    63 << 16,                // 64 bits of color
+    0,
+    0,
+    0xFFFFFFFF,
+};
+
+// Metadata of the rows stored from the bottom, padded to 4 bytes
+const char KTX2_ORIENTATION[] = "KTXorientation\0ru";
+
+// Obtains the number of levels of a texture down to 1x1
+int CountLevels(int size) {
+  int n_levels = 1;
+  while ((size >> n_levels) > 0)
+    n_levels++;
+  return n_levels;
+}
+
+// Obtains the bytes of a level of BC1 blocks
+size_t GetBC1Size(int size) {
+  size_t blocks = (size + 3) / 4;
+  return blocks * blocks * BC1_BLOCK_SIZE;
+}
+
+// Rounds up to a multiple
+size_t Align(size_t value, size_t alignment) {
+  return (value + alignment - 1) / alignment * alignment;
+}
+
+// Quantizes a color in [0, 255] to 565
+uint16_t PackRgb565(glm::vec3 color) {
+  auto c = glm::clamp(color / 255.0f, 0.0f, 1.0f);
+  return (uint16_t)std::round(c.r * 31) << 11 |
+         (uint16_t)std::round(c.g * 63) << 5 | (uint16_t)std::round(c.b * 31);
+}
+
+// Expands a 565 color to [0, 255], as the gpu does
+glm::vec3 UnpackRgb565(uint16_t color) {
+  int r = color >> 11, g = color >> 5 & 63, b = color & 31;
+  return glm::vec3(r << 3 | r >> 2, g << 2 | g >> 4, b << 3 | b >> 2);
+}
+
+// Compresses the 16 texels of a block, in rows from the bottom, to the 4
+// colors mode of BC1
+void CompressBlock(const glm::vec3 texels[16], unsigned char* block) {
+  glm::vec3 mean(0);
+  for (int i = 0; i < 16; ++i)
+    mean += texels[i] / 16.0f;
+  glm::mat3 covariance(0);
+  for (int i = 0; i < 16; ++i)
+    covariance += glm::outerProduct(texels[i] - mean, texels[i] - mean);
+
+  // Principal axis by power iteration, luminance for flat blocks
+  glm::vec3 axis(1);
+  for (int i = 0; i < 8; ++i) {
+    auto next = covariance * axis;
+    float length = glm::length(next);
+    if (length < 1e-6f)
+      break;
+    axis = next / length;
+  }
+  axis = glm::normalize(axis);
+  float low = INFINITY, high = -INFINITY;
+  for (int i = 0; i < 16; ++i) {
+    float t = glm::dot(texels[i] - mean, axis);
+    low = std::min(low, t);
+    high = std::max(high, t);
+  }
+
+  // The 4 colors mode needs the first endpoint greater than the second
+  uint16_t c0 = PackRgb565(mean + axis * high);
+  uint16_t c1 = PackRgb565(mean + axis * low);
+  if (c0 < c1)
+    std::swap(c0, c1);
+  uint32_t indices = 0;
+  if (c0 != c1) {
+    auto p0 = UnpackRgb565(c0), p1 = UnpackRgb565(c1);
+    glm::vec3 palette[] = {p0, p1, (2.0f * p0 + p1) / 3.0f,
+                           (p0 + 2.0f * p1) / 3.0f};
+    for (int i = 0; i < 16; ++i) {
+      int best = 0;
+      float best_distance = INFINITY;
+      for (int j = 0; j < 4; ++j) {
+        auto d = texels[i] - palette[j];
+        float distance = glm::dot(d, d);
+        if (distance < best_distance) {
+          best = j;
+          best_distance = distance;
+        }
+      }
+      indices |= (uint32_t)best << (2 * i);
+    }
+  }
+  // Little endian, like the gpu reads it
+  unsigned char bytes[] = {(unsigned char)c0,
+                           (unsigned char)(c0 >> 8),
+                           (unsigned char)c1,
+                           (unsigned char)(c1 >> 8),
+                           (unsigned char)indices,
+                           (unsigned char)(indices >> 8),
+                           (unsigned char)(indices >> 16),
+                           (unsigned char)(indices >> 24)};
+  memcpy(block, bytes, BC1_BLOCK_SIZE);
+}
+
+}  // namespace
+
+std::vector<unsigned char> ResampleImage(
+    const std::vector<unsigned char>& image, int width, int height, int size) {
+  auto texel = [&](int x, int y, int channel) {
+    x = (x % width + width) % width;
+    y = (y % height + height) % height;
+    return (float)image[4 * (y * width + x) + channel];
+  };
+  std::vector<unsigned char> resampled(4 * size * size);
+  for (int y = 0; y < size; ++y) {
+    float source_y = (size - y - 0.5f) * height / size - 0.5f;
+    int y0 = (int)std::floor(source_y);
+    float fy = source_y - y0;
+    for (int x = 0; x < size; ++x) {
+      float source_x = (x + 0.5f) * width / size - 0.5f;
+      int x0 = (int)std::floor(source_x);
+      float fx = source_x - x0;
+      for (int c = 0; c < 4; ++c) {
+        float bottom = texel(x0, y0, c) * (1 - fx) + texel(x0 + 1, y0, c) * fx;
+        float top =
+            texel(x0, y0 + 1, c) * (1 - fx) + texel(x0 + 1, y0 + 1, c) * fx;
+        resampled[4 * (y * size + x) + c] =
+            (unsigned char)(bottom * (1 - fy) + top * fy + 0.5f);
+      }
+    }
+  }
+  return resampled;
+}
+
+std::vector<std::vector<unsigned char>> BuildMipmaps(
+    std::vector<unsigned char> image, int size) {
+  std::vector<std::vector<unsigned char>> levels;
+  levels.push_back(std::move(image));
+  for (; size > 1; size /= 2) {
+    auto& level = levels.back();
+    int half = size / 2;
+    std::vector<unsigned char> next(4 * half * half);
+    for (int y = 0; y < half; ++y) {
+      for (int x = 0; x < half; ++x) {
+        for (int c = 0; c < 4; ++c) {
+          int sum = 0;
+          for (int i = 0; i < 4; ++i)
+            sum += level[4 * ((2 * y + i / 2) * size + 2 * x + i % 2) + c];
+          next[4 * (y * half + x) + c] = (sum + 2) / 4;
+        }
+      }
+    }
+    levels.push_back(std::move(next));
+  }
+  return levels;
+}
+
+std::vector<unsigned char> CompressBC1(const std::vector<unsigned char>& image,
+                                       int size) {
+  int blocks = (size + 3) / 4;
+  std::vector<unsigned char> compressed(GetBC1Size(size));
+  for (int by = 0; by < blocks; ++by) {
+    for (int bx = 0; bx < blocks; ++bx) {
+      // The texels past the edge of small levels repeat the last ones
+      glm::vec3 texels[16];
+      for (int i = 0; i < 16; ++i) {
+        int x = std::min(4 * bx + i % 4, size - 1);
+        int y = std::min(4 * by + i / 4, size - 1);
+        auto texel = &image[4 * (y * size + x)];
+        texels[i] = glm::vec3(texel[0], texel[1], texel[2]);
+      }
+      CompressBlock(texels, &compressed[BC1_BLOCK_SIZE * (by * blocks + bx)]);
+    }
+  }
+  return compressed;
+}
+
+std::string GetKtx2Path(const std::string& png_path) {
+  auto dot = png_path.find_last_of('.');
+  auto slash = png_path.find_last_of('/');
+  if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+    return png_path + ".ktx2";
+  return png_path.substr(0, dot) + ".ktx2";
+}
+
+void WriteKtx2(const std::string& path, int size,
+               const std::vector<std::vector<unsigned char>>& levels) {
+  Ktx2Header header;
+  memset(&header, 0, sizeof(header));
+  header.vk_format = VK_FORMAT_BC1_RGB;
+  header.type_size = 1;
+  header.pixel_width = size;
+  header.pixel_height = size;
+  header.face_count = 1;
+  header.level_count = levels.size();
+  size_t offset = sizeof(KTX2_IDENTIFIER) + sizeof(header) +
+                  levels.size() * sizeof(Ktx2Level);
+  header.dfd_byte_offset = offset;
+  header.dfd_byte_length = sizeof(BC1_DFD);
+  offset += sizeof(BC1_DFD);
+  uint32_t kvd_length = sizeof(KTX2_ORIENTATION);
+  header.kvd_byte_offset = offset;
+  header.kvd_byte_length = Align(sizeof(kvd_length) + kvd_length, 4);
+  offset += header.kvd_byte_length;
+
+  // The levels go from the smallest one, each aligned to a block
+  std::vector<Ktx2Level> index(levels.size());
+  for (int i = levels.size() - 1; i >= 0; --i) {
+    offset = Align(offset, BC1_BLOCK_SIZE);
+    index[i] = {offset, levels[i].size(), levels[i].size()};
+    offset += levels[i].size();
+  }
+
+  std::ofstream output(path, std::ios::binary | std::ios::trunc);
+  output.write((const char*)KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER));
+  output.write((const char*)&header, sizeof(header));
+  output.write((const char*)index.data(), index.size() * sizeof(Ktx2Level));
+  output.write((const char*)BC1_DFD, sizeof(BC1_DFD));
+  output.write((const char*)&kvd_length, sizeof(kvd_length));
+  output.write(KTX2_ORIENTATION, kvd_length);
+  auto position = header.kvd_byte_offset + sizeof(kvd_length) + kvd_length;
+  for (int i = levels.size() - 1; i >= 0; --i) {
+    const char padding[BC1_BLOCK_SIZE] = {};
+    output.write(padding, index[i].byte_offset - position);
+    output.write((const char*)levels[i].data(), levels[i].size());
+    position = index[i].byte_offset + levels[i].size();
+  }
+  output.close();
+  if (!output)
+    throw std::runtime_error("Unable to write file: " + path);
+}
+
+bool ReadKtx2Index(const std::string& path, int size,
+                   std::vector<uint64_t>* offsets) {
+  std::ifstream input(path, std::ios::binary | std::ios::ate);
+  if (!input.is_open())
+    return false;
+  uint64_t file_size = input.tellg();
+  input.seekg(0);
+  unsigned char identifier[sizeof(KTX2_IDENTIFIER)];
+  Ktx2Header header;
+  input.read((char*)identifier, sizeof(identifier));
+  input.read((char*)&header, sizeof(header));
+  if (!input ||
+      memcmp(identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0)
+    return false;
+  int n_levels = CountLevels(size);
+  if (header.vk_format != VK_FORMAT_BC1_RGB ||
+      header.pixel_width != (uint32_t)size ||
+      header.pixel_height != (uint32_t)size || header.pixel_depth != 0 ||
+      header.layer_count > 1 || header.face_count != 1 ||
+      header.level_count != (uint32_t)n_levels ||
+      header.supercompression_scheme != 0)
+    return false;
+
+  std::vector<Ktx2Level> index(n_levels);
+  input.read((char*)index.data(), n_levels * sizeof(Ktx2Level));
+  if (!input)
+    return false;
+  offsets->clear();
+  for (int i = 0; i < n_levels; ++i) {
+    auto& level = index[i];
+    if (level.byte_length != GetBC1Size(size >> i) ||
+        level.byte_offset > file_size ||
+        level.byte_length > file_size - level.byte_offset)
+      return false;
+    offsets->push_back(level.byte_offset);
+  }
+  return true;
+}
+
+bool ReadKtx2(const std::string& path, int size,
+              std::vector<std::vector<unsigned char>>* levels) {
+  std::vector<uint64_t> offsets;
+  if (!ReadKtx2Index(path, size, &offsets))
+    return false;
+  std::ifstream input(path, std::ios::binary);
+  levels->clear();
+  for (size_t i = 0; i < offsets.size(); ++i) {
+    levels->emplace_back(GetBC1Size(size >> i));
+    input.seekg(offsets[i]);
+    input.read((char*)levels->back().data(), levels->back().size());
+  }
+  return (bool)input;
+}
@@ -0,0 +1,99 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef TEXTURECOMPRESSION_H
+#define TEXTURECOMPRESSION_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * Preparation of the diffuse maps: resampling, mipmaps and BC1 compression
+ *
+ * The images are RGBA8, with the rows from the bottom like OpenGL. BC1 keeps
+ * two 565 endpoints and a 2 bits index per texel for each 4x4 block, 8 bytes
+ * instead of 64, and is sampled by the gpu as is. The compressed mipmaps are
+ * stored in KTX2 files (see tools/compress_textures.cpp), which the renderer
+ * loads instead of the PNG files they come from, so nothing is decoded or
+ * filtered at startup.
+ */
+
+/**
+ * Resamples an image to size x size texels with bilinear filtering, wrapping
+ * at the edges like the repeat mode; the rows are flipped, since the PNG rows
+ * start at the top and the texture coordinates at the bottom
+ */
+std::vector<unsigned char> ResampleImage(
+    const std::vector<unsigned char>& image, int width, int height, int size);
+
+/**
+ * Builds every mipmap of a square image of a power of two size, each one
+ * averaging the 2x2 blocks of the previous one; returns the levels from the
+ * full size down, the first being the image
+ */
+std::vector<std::vector<unsigned char>> BuildMipmaps(
+    std::vector<unsigned char> image, int size);
+
+/**
+ * Compresses a square image to BC1 blocks, in rows from the bottom; sizes
+ * under 4 texels take a single block row and column
+ * The endpoints of each block are the extremes of its texels along their
+ * principal axis
+ */
+std::vector<unsigned char> CompressBC1(const std::vector<unsigned char>& image,
+                                       int size);
+
+/**
+ * Obtains the KTX2 file of a PNG file: the same path with the extension
+ * replaced
+ */
+std::string GetKtx2Path(const std::string& png_path);
+
+/**
+ * Writes the BC1 levels of a square texture, from the full size down, to a
+ * KTX2 file
+ * Throws runtime_error if the file can't be written
+ */
+void WriteKtx2(const std::string& path, int size,
+               const std::vector<std::vector<unsigned char>>& levels);
+
+/**
+ * Reads the BC1 levels of a square texture of a size from a KTX2 file
+ * written by WriteKtx2
+ * Returns false if the file is missing, invalid or of another format, size
+ * or number of levels
+ */
+bool ReadKtx2(const std::string& path, int size,
+              std::vector<std::vector<unsigned char>>* levels);
+
+/**
+ * Reads where each BC1 level of a KTX2 file, from the full size down,
+ * starts in the file, so parts of them can be read without the others
+ * Returns false in the same cases as ReadKtx2
+ */
+bool ReadKtx2Index(const std::string& path, int size,
+                   std::vector<uint64_t>* offsets);
+
+#endif
@@ -0,0 +1,171 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+
+#include "ThreadAffinity.h"
+
+namespace {
+
+const char* NODES = "/sys/devices/system/node";
+
+// Parses a cpu list of sysfs, such as 0-3,8,10-11, in increasing order
+std::vector<int> ParseCpuList(const std::string& list) {
+  std::vector<int> cpus;
+  size_t begin = 0;
+  while (begin < list.size()) {
+    size_t end = list.find(',', begin);
+    if (end == std::string::npos)
+      end = list.size();
+    int first, last;
+    int n = sscanf(list.c_str() + begin, "%d-%d", &first, &last);
+    if (n == 1)
+      last = first;
+    for (int cpu = first; n >= 1 && cpu <= last; ++cpu)
+      cpus.push_back(cpu);
+    begin = end + 1;
+  }
+  std::sort(cpus.begin(), cpus.end());
+  return cpus;
+}
+
+// Reads the cpu list of a file, empty if it can't be read
+std::vector<int> ReadCpuList(const std::string& path) {
+  std::ifstream file(path);
+  std::string list;
+  if (!(file >> list))
+    return {};
+  return ParseCpuList(list);
+}
+
+// Obtains the hardware threads of the core of a cpu, itself if unknown
+std::vector<int> GetSiblings(int cpu) {
+  auto siblings = ReadCpuList("/sys/devices/system/cpu/cpu" +
+                              std::to_string(cpu) +
+                              "/topology/thread_siblings_list");
+  if (siblings.empty())
+    siblings.push_back(cpu);
+  return siblings;
+}
+
+// Obtains the NUMA node of a cpu, 0 if unknown, and the cpus of the node,
+// all of them if unknown
+int FindNode(int cpu, std::vector<int>* cpus) {
+  DIR* nodes = opendir(NODES);
+  int found = 0;
+  while (nodes) {
+    auto entry = readdir(nodes);
+    if (!entry)
+      break;
+    int node;
+    if (sscanf(entry->d_name, "node%d", &node) != 1)
+      continue;
+    auto node_cpus = ReadCpuList(std::string(NODES) + "/" + entry->d_name +
+                                 "/cpulist");
+    if (std::binary_search(node_cpus.begin(), node_cpus.end(), cpu)) {
+      found = node;
+      *cpus = node_cpus;
+      break;
+    }
+  }
+  if (nodes)
+    closedir(nodes);
+  return found;
+}
+
+}  // namespace
+
+ThreadAffinity::ThreadAffinity() : render_cpu_(-1), node_(0) {}
+
+bool ThreadAffinity::Init(bool smt) {
+  render_cpu_ = -1;
+  worker_cpus_.clear();
+  cpu_set_t allowed;
+  CPU_ZERO(&allowed);
+  if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+    return false;
+  std::vector<int> cpus;
+  for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+    if (CPU_ISSET(cpu, &allowed))
+      cpus.push_back(cpu);
+  if (cpus.empty())
+    return false;
+
+  // The cpus of the node that the process may run on
+  std::vector<int> node_cpus = cpus;
+  node_ = FindNode(cpus[0], &node_cpus);
+  std::vector<int> candidates;
+  std::set_intersection(cpus.begin(), cpus.end(), node_cpus.begin(),
+                        node_cpus.end(), std::back_inserter(candidates));
+
+  // A core is kept through its first allowed hardware thread
+  auto render_core = GetSiblings(candidates[0]);
+  std::vector<int> workers;
+  for (int cpu : candidates) {
+    auto siblings = GetSiblings(cpu);
+    if (std::find(render_core.begin(), render_core.end(), cpu) !=
+        render_core.end())
+      continue;
+    auto first = std::find_first_of(siblings.begin(), siblings.end(),
+                                    candidates.begin(), candidates.end());
+    if (smt || first == siblings.end() || *first == cpu)
+      workers.push_back(cpu);
+  }
+  if (workers.empty())
+    return false;
+  render_cpu_ = candidates[0];
+  worker_cpus_ = workers;
+  return true;
+}
+
+int ThreadAffinity::GetRenderCpu() { return render_cpu_; }
+
+const std::vector<int>& ThreadAffinity::GetWorkerCpus() {
+  return worker_cpus_;
+}
+
+int ThreadAffinity::GetNode() { return node_; }
+
+bool ThreadAffinity::Pin(std::thread::native_handle_type thread, int cpu) {
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  CPU_SET(cpu, &set);
+  return pthread_setaffinity_np(thread, sizeof(set), &set) == 0;
+}
+
+bool ThreadAffinity::SetPriority(int nice) {
+  // On Linux the nice value of a thread id is of that thread only
+  return setpriority(PRIO_PROCESS, syscall(SYS_gettid), nice) == 0;
+}
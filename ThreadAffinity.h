@@ -0,0 +1,90 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef THREADAFFINITY_H
+#define THREADAFFINITY_H
+
+#include <thread>
+#include <vector>
+
+/**
+ * Placement of the render thread and the workers on the cpus of a NUMA node
+ *
+ * The cpus the process may run on and their cores and nodes are read from
+ * sysfs. The render thread gets the first core of the node of the first of
+ * them to itself, and the workers get one hardware thread of each other core
+ * of the node, or every hardware thread with smt, so the scheduler neither
+ * migrates them nor moves a worker next to the render thread. Without the
+ * topology every cpu is its own core on a single node.
+ */
+class ThreadAffinity {
+public:
+  /**
+   * Default constructor, with nothing planned
+   */
+  ThreadAffinity();
+
+  /**
+   * Plans the cpus of the render thread and of the workers, with the smt
+   * siblings of their cores or not
+   * Returns false if the process may run on one core only, with nothing
+   * planned
+   */
+  bool Init(bool smt);
+
+  /**
+   * Obtains the cpu of the render thread, -1 if none is planned
+   */
+  int GetRenderCpu();
+
+  /**
+   * Obtains the cpu of each worker, empty if none is planned
+   */
+  const std::vector<int>& GetWorkerCpus();
+
+  /**
+   * Obtains the NUMA node of the planned cpus
+   */
+  int GetNode();
+
+  /**
+   * Pins a thread to a cpu
+   * Returns false if the system refused
+   */
+  static bool Pin(std::thread::native_handle_type thread, int cpu);
+
+  /**
+   * Sets the nice value of the calling thread alone, lower runs first
+   * Returns false if the system refused, as it does for negative values
+   * without the permission to raise priorities
+   */
+  static bool SetPriority(int nice);
+
+private:
+  int render_cpu_;
+  std::vector<int> worker_cpus_;
+  int node_;
+};
+
+#endif
@@ -0,0 +1,106 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <algorithm>
+
+#include "TransformHierarchy.h"
+
+int TransformHierarchy::AddNode(const glm::mat4& local, int parent) {
+  int node = locals_.size();
+  locals_.push_back(local);
+  worlds_.push_back(local);
+  parents_.push_back(parent);
+  first_children_.push_back(-1);
+  next_siblings_.push_back(-1);
+  is_dirty_.push_back(false);
+  if (parent >= 0) {
+    next_siblings_[node] = first_children_[parent];
+    first_children_[parent] = node;
+  }
+  // New nodes are uploaded like moved ones
+  SetLocal(node, local);
+  return node;
+}
+
+void TransformHierarchy::SetLocal(int node, const glm::mat4& local) {
+  locals_[node] = local;
+  if (!is_dirty_[node]) {
+    is_dirty_[node] = true;
+    dirty_.push_back(node);
+  }
+}
+
+const glm::mat4& TransformHierarchy::GetLocal(int node) {
+  return locals_[node];
+}
+
+std::vector<TransformHierarchy::Range> TransformHierarchy::Update() {
+  std::vector<Range> ranges;
+  if (dirty_.empty())
+    return ranges;
+
+  // Only the topmost dirty nodes are walked; the subtrees of the others are
+  // part of theirs
+  std::vector<int> updated;
+  for (int node : dirty_) {
+    bool covered = false;
+    for (int p = parents_[node]; p >= 0 && !covered; p = parents_[p])
+      covered = is_dirty_[p];
+    if (!covered)
+      CollectSubtree(node, &updated);
+  }
+  for (int node : dirty_)
+    is_dirty_[node] = false;
+  dirty_.clear();
+
+  // In node order every parent is final before its children, so the
+  // matrices are computed in one pass over contiguous memory
+  std::sort(updated.begin(), updated.end());
+  for (int node : updated) {
+    int parent = parents_[node];
+    if (parent >= 0)
+      worlds_[node] = worlds_[parent] * locals_[node];
+    else
+      worlds_[node] = locals_[node];
+  }
+  for (int node : updated) {
+    if (!ranges.empty() &&
+        ranges.back().first + ranges.back().second == node)
+      ranges.back().second++;
+    else
+      ranges.push_back({node, 1});
+  }
+  return ranges;
+}
+
+int TransformHierarchy::GetSize() { return locals_.size(); }
+
+const glm::mat4* TransformHierarchy::GetWorlds() { return worlds_.data(); }
+
+void TransformHierarchy::CollectSubtree(int node, std::vector<int>* nodes) {
+  nodes->push_back(node);
+  for (int child = first_children_[node]; child >= 0;
+       child = next_siblings_[child])
+    CollectSubtree(child, nodes);
+}
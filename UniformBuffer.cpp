@@ -22,79 +22,260 @@
  * SOFTWARE.
  */
 
+#include <algorithm>
 #include <cstring>
+#include <utility>
 
-#include <GL/glew.h>
-#include <glm/gtc/type_ptr.hpp>
-
+#include "GLCheck.h"
+#include "GLDebug.h"
+#include "GpuMemory.h"
 #include "UniformBuffer.h"
 
-UniformBuffer::UniformBuffer() : ubo_(0), padding_(0) {}
+namespace {
 
-UniformBuffer::~UniformBuffer() {
-  if (ubo_)
-    glDeleteBuffers(1, &ubo_);
-}
+// Nanoseconds waited per try for the gpu to release a slot
+const GLuint64 SLOT_WAIT_TIMEOUT = 1000000;
+
+// Granularity in bytes of the changes detected in dynamic buffers
+const size_t DIRTY_BLOCK_SIZE = 256;
 
-void UniformBuffer::Init() { glGenBuffers(1, &ubo_); }
+}  // namespace
+
+UniformBuffer::UniformBuffer()
+    : ubo_(0),
+      target_(GL_UNIFORM_BUFFER),
+      usage_(DYNAMIC),
+      sent_(false),
+      slots_(0),
+      slot_(0),
+      slot_capacity_(0),
+      offset_(0),
+      size_(0),
+      mapped_(nullptr),
+      allocated_bytes_(0),
+      stats_{0, 0, 0} {}
+
+UniformBuffer::~UniformBuffer() { Release(); }
+
+UniformBuffer::UniformBuffer(UniformBuffer &&other) : UniformBuffer() {
+  *this = std::move(other);
+}
 
-template <typename T> void UniformBuffer::Add(T element) {
-  AddToBuffer(&element, sizeof(T));
+UniformBuffer &UniformBuffer::operator=(UniformBuffer &&other) {
+  if (this == &other)
+    return *this;
+  Release();
+  ubo_ = other.ubo_;
+  target_ = other.target_;
+  buffer_ = std::move(other.buffer_);
+  usage_ = other.usage_;
+  sent_ = other.sent_;
+  uploaded_ = std::move(other.uploaded_);
+  dirty_ranges_ = std::move(other.dirty_ranges_);
+  slots_ = other.slots_;
+  slot_ = other.slot_;
+  slot_capacity_ = other.slot_capacity_;
+  offset_ = other.offset_;
+  size_ = other.size_;
+  mapped_ = other.mapped_;
+  allocated_bytes_ = other.allocated_bytes_;
+  fences_ = std::move(other.fences_);
+  stats_ = other.stats_;
+  label_ = std::move(other.label_);
+  // The other one has nothing left to delete or write to
+  other.ubo_ = 0;
+  other.mapped_ = nullptr;
+  other.allocated_bytes_ = 0;
+  other.fences_.clear();
+  other.slots_ = 0;
+  other.slot_capacity_ = 0;
+  return *this;
 }
 
-template <typename T> void UniformBuffer::Add(T *elements, int n) {
-  AddToBuffer(elements, n * sizeof(T));
+void UniformBuffer::Release() {
+  for (auto fence : fences_)
+    if (fence)
+      glDeleteSync((GLsync)fence);
+  if (ubo_)
+    glDeleteBuffers(1, &ubo_);
+  GpuMemory::Free(GpuMemory::STREAMING, allocated_bytes_);
 }
 
-void UniformBuffer::Add(glm::vec3 element) {
-  AddToBuffer(glm::value_ptr(element), 3 * sizeof(float));
+void UniformBuffer::Init(Target target, Usage usage, int slots) {
+  target_ = target == STORAGE ? GL_SHADER_STORAGE_BUFFER : GL_UNIFORM_BUFFER;
+  usage_ = usage;
+  slots_ = usage == STREAM ? std::max(slots, 1) : 0;
+  fences_.assign(slots_, nullptr);
+  glCreateBuffers(1, &ubo_);
+  GLDebug::Label(GL_BUFFER, ubo_, label_);
 }
 
-void UniformBuffer::Add(glm::vec4 element) {
-  AddToBuffer(glm::value_ptr(element), 4 * sizeof(float));
+void UniformBuffer::FinishChunk() { buffer_.FinishChunk(); }
+
+void UniformBuffer::SendToDevice() {
+  size_ = buffer_.GetSize();
+  if (usage_ == STATIC) {
+    Allocate(size_, buffer_.GetData(), 0);
+    CountUpload(size_, true);
+    return;
+  }
+  if (usage_ == DYNAMIC) {
+    if (uploaded_.GetSize() != buffer_.GetSize()) {
+      Allocate(size_, buffer_.GetData(), GL_DYNAMIC_STORAGE_BIT);
+      CountUpload(size_, true);
+    } else {
+      UploadDirtyRanges();
+    }
+    uploaded_ = buffer_;
+    return;
+  }
+
+  memcpy(NextSlot(size_), buffer_.GetData(), size_);
 }
 
-void UniformBuffer::Add(glm::mat4 element) {
-  AddToBuffer(glm::value_ptr(element), 16 * sizeof(float));
+void *UniformBuffer::Map(size_t size) {
+  size_ = size;
+  if (usage_ == STREAM)
+    return NextSlot(size);
+  CountUpload(size, true);
+
+  offset_ = 0;
+  if (usage_ == STATIC) {
+    Allocate(size, nullptr, GL_MAP_WRITE_BIT);
+  } else {
+    // The next SendToDevice() can't diff against the mapped contents
+    Allocate(size, nullptr, GL_MAP_WRITE_BIT | GL_DYNAMIC_STORAGE_BIT);
+    uploaded_.Clear();
+  }
+  return glMapNamedBufferRange(ubo_, 0, size,
+                               GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
 }
 
-void UniformBuffer::FinishChunk() {
-  if (padding_ == 0)
+void UniformBuffer::Unmap() {
+  // The streaming slots are coherent and stay mapped
+  if (usage_ == STREAM)
     return;
-  for (int i = padding_; i < 16; ++i)
-    buffer_.push_back(0);
-  padding_ = 0;
+  glUnmapNamedBuffer(ubo_);
 }
 
-void UniformBuffer::SendToDevice() {
-  glBindBuffer(GL_UNIFORM_BUFFER, ubo_);
-  glBufferData(GL_UNIFORM_BUFFER, buffer_.size(), buffer_.data(),
-               GL_DYNAMIC_DRAW);
-  glBindBuffer(GL_UNIFORM_BUFFER, 0);
+void UniformBuffer::SendRange(size_t offset, const void *data, size_t size) {
+  glNamedBufferSubData(ubo_, offset, size, data);
+  CountUpload(size, false);
+  // The next SendToDevice() diffs against the new contents
+  buffer_.Write(offset, data, size);
+  uploaded_.Write(offset, data, size);
+}
+
+void UniformBuffer::SetLabel(const std::string &label) {
+  label_ = label;
+  GLDebug::Label(GL_BUFFER, ubo_, label_);
 }
 
 unsigned int UniformBuffer::GetId() { return ubo_; }
 
-void UniformBuffer::Clear() { buffer_.clear(); }
+size_t UniformBuffer::GetOffset() { return offset_; }
 
-void UniformBuffer::AddToBuffer(void *data, int size) {
-  int glsl_size = (size >= 4) ? size : 4;
-  unsigned char bytes[size];
+size_t UniformBuffer::GetSize() { return size_; }
 
-  if (padding_ + size > 16)
-    FinishChunk();
+void UniformBuffer::Clear() { buffer_.Clear(); }
 
-  memcpy(bytes, data, size);
-  for (int i = 0; i < size; ++i)
-    buffer_.push_back(bytes[i]);
+int UniformBuffer::GetMaxArrayElements(size_t stride) {
+  GLint max_size = 0, alignment = 0;
+  glGetIntegerv(GL_MAX_UNIFORM_BLOCK_SIZE, &max_size);
+  glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+  // The smallest count of elements whose size is a multiple of both
+  size_t granularity = 1;
+  while ((granularity * stride) % std::max(alignment, 1) != 0)
+    ++granularity;
+  return (int)(max_size / stride / granularity * granularity);
+}
 
-  for (int i = size; i < glsl_size; ++i)
-    buffer_.push_back(0);
+const UniformBuffer::Stats &UniformBuffer::GetStats() { return stats_; }
 
-  padding_ = (padding_ + glsl_size) % 16;
+void UniformBuffer::ResetStats() { stats_ = {0, 0, 0}; }
+
+void UniformBuffer::UploadDirtyRanges() {
+  buffer_.GetChangedRanges(uploaded_, DIRTY_BLOCK_SIZE, &dirty_ranges_);
+  for (auto &range : dirty_ranges_) {
+    glNamedBufferSubData(ubo_, range.offset, range.size,
+                         buffer_.GetData() + range.offset);
+    CountUpload(range.size, false);
+  }
+}
+
+unsigned char *UniformBuffer::NextSlot(size_t size) {
+  // Fences the commands issued since the last update, which read the current
+  // slot, then moves to the next slot once the gpu has released it
+  if (mapped_) {
+    fences_[slot_] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot_ = (slot_ + 1) % slots_;
+    WaitSlot(slot_);
+  }
+  if (!mapped_ || size > slot_capacity_)
+    AllocateSlots(size);
+  offset_ = slot_ * slot_capacity_;
+  CountUpload(size, false);
+  return mapped_ + offset_;
+}
+
+void UniformBuffer::Allocate(size_t size, const void *data,
+                             unsigned int flags) {
+  // The storage is immutable, so it's replaced; the driver keeps the old one
+  // alive while the gpu reads it
+  if (sent_) {
+    glDeleteBuffers(1, &ubo_);
+    glCreateBuffers(1, &ubo_);
+    GLDebug::Label(GL_BUFFER, ubo_, label_);
+  }
+  glNamedBufferStorage(ubo_, size, data, flags);
+  GpuMemory::Free(GpuMemory::STREAMING, allocated_bytes_);
+  GpuMemory::Allocate(GpuMemory::STREAMING, size);
+  allocated_bytes_ = size;
+  sent_ = true;
 }
 
-template void UniformBuffer::Add(bool);
-template void UniformBuffer::Add(int);
-template void UniformBuffer::Add(float);
-template void UniformBuffer::Add(float *, int);
+void UniformBuffer::AllocateSlots(size_t size) {
+  for (auto& fence : fences_) {
+    if (fence)
+      glDeleteSync((GLsync)fence);
+    fence = nullptr;
+  }
+
+  // Grows geometrically, keeping the slots at the offset alignment
+  GLint alignment = 0;
+  glGetIntegerv(target_ == GL_SHADER_STORAGE_BUFFER
+                    ? GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT
+                    : GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT,
+                &alignment);
+  size_t granularity = std::max(alignment, 1);
+  size_t capacity = std::max({size, 2 * slot_capacity_, granularity});
+  slot_capacity_ = (capacity + granularity - 1) / granularity * granularity;
+
+  GLbitfield flags =
+      GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+  Allocate(slots_ * slot_capacity_, nullptr, flags);
+  mapped_ = (unsigned char *)glMapNamedBufferRange(
+      ubo_, 0, slots_ * slot_capacity_, flags);
+  slot_ = 0;
+  stats_.reallocations++;
+}
+
+void UniformBuffer::CountUpload(size_t bytes, bool reallocation) {
+  stats_.bytes += bytes;
+  stats_.uploads++;
+  if (reallocation)
+    stats_.reallocations++;
+}
+
+void UniformBuffer::WaitSlot(int slot) {
+  auto fence = (GLsync)fences_[slot];
+  if (!fence)
+    return;
+  GLenum status;
+  do {
+    status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+                              SLOT_WAIT_TIMEOUT);
+  } while (status == GL_TIMEOUT_EXPIRED);
+  glDeleteSync(fence);
+  fences_[slot] = nullptr;
+}
@@ -25,15 +25,53 @@
 #ifndef UNIFORMBUFFER_H
 #define UNIFORMBUFFER_H
 
+#include <cstddef>
+#include <string>
 #include <vector>
 
 #include <glm/glm.hpp>
 
+#include "Std140Buffer.h"
+
 /**
  * std140 uniform buffer
+ *
+ * It can also be a shader storage buffer, for std430 blocks whose sizes are
+ * only known at runtime. The packing is the same as long as the array
+ * elements are 16 bytes aligned (structures with vectors or matrices). The
+ * packing is done by a Std140Buffer, without gl calls.
+ *
+ * The usage decides how SendToDevice() uploads the data. The storage is
+ * always immutable and is replaced when its size changes. Static buffers are
+ * sent once. Dynamic buffers only upload the ranges that differ from the
+ * previous upload, so unchanged data costs no transfer.
+ * Streaming buffers are rewritten every frame: the storage is persistently
+ * mapped and split into slots, and each SendToDevice() copies the data into
+ * the next slot once the gpu is done reading it. Shaders must then bind the
+ * range given by GetOffset() and GetSize().
  */
 class UniformBuffer {
 public:
+  /**
+   * Binding target of the buffer
+   */
+  enum Target { UNIFORM, STORAGE };
+
+  /**
+   * How often the contents change
+   */
+  enum Usage { STATIC, DYNAMIC, STREAM };
+
+  /**
+   * Transfers to the gpu since the last ResetStats()
+   * The bytes written through Map() count as uploaded
+   */
+  struct Stats {
+    size_t bytes;
+    int uploads;
+    int reallocations;
+  };
+
   /**
    * Default constructor
    */
@@ -44,23 +82,48 @@ public:
    */
   ~UniformBuffer();
 
+  /**
+   * Takes the buffer, its contents and its fences from another uniform
+   * buffer, which is left empty
+   */
+  UniformBuffer(UniformBuffer &&other);
+  UniformBuffer &operator=(UniformBuffer &&other);
+
+  /**
+   * A uniform buffer owns its gl objects, so it can't be copied
+   */
+  UniformBuffer(const UniformBuffer &) = delete;
+  UniformBuffer &operator=(const UniformBuffer &) = delete;
+
   /**
    * Creates the uniform buffer
+   * A streaming buffer has up to that many slots in flight and expects one
+   * SendToDevice() per frame
    */
-  void Init();
+  void Init(Target target = UNIFORM, Usage usage = DYNAMIC, int slots = 3);
 
   /**
    * Adds an element to the buffer
    */
-  template <typename T> void Add(T element);
+  template <typename T> void Add(T element) { buffer_.Add(element); }
 
   /**
    * Adds a vetor/matrix to the buffer
    */
-  template <typename T> void Add(T *elements, int n);
-  void Add(glm::vec3 element);
-  void Add(glm::vec4 element);
-  void Add(glm::mat4 element);
+  template <typename T> void Add(T *elements, int n) {
+    buffer_.Add(elements, n);
+  }
+  void Add(glm::vec3 element) { buffer_.Add(element); }
+  void Add(glm::vec4 element) { buffer_.Add(element); }
+  void Add(glm::mat4 element) { buffer_.Add(element); }
+
+  /**
+   * Adds an array of structures with a single copy
+   * The structures must have the layout of the GLSL array (see BlockLayout)
+   */
+  template <typename T> void AddArray(const T *elements, int n) {
+    buffer_.AddArray(elements, n);
+  }
 
   /**
    * Complete the current chunk
@@ -70,28 +133,121 @@ public:
 
   /**
    * Sends the buffer to the gpu
+   * Sending a static buffer again replaces its storage
    */
   void SendToDevice();
 
+  /**
+   * Maps that many bytes of the buffer for the cpu to write them in place,
+   * instead of adding them and sending them to the device
+   * Static and dynamic buffers get new storage, written until Unmap(); a
+   * streaming buffer moves to its next slot, which is always mapped. The
+   * bytes may be written from several threads, as long as the ranges don't
+   * overlap
+   */
+  void *Map(size_t size);
+
+  /**
+   * Ends the writes of Map(), before any draw reads the buffer
+   */
+  void Unmap();
+
+  /**
+   * Rewrites a range of the storage of a dynamic buffer, leaving the rest as
+   * it was sent or mapped
+   */
+  void SendRange(size_t offset, const void *data, size_t size);
+
+  /**
+   * Names the buffer for debuggers (see GLDebug), also once its storage is
+   * replaced
+   */
+  void SetLabel(const std::string &label);
+
   /**
    * Obtains the buffer id
+   * The id of a streaming buffer changes when its slots grow
    */
   unsigned int GetId();
 
+  /**
+   * Obtains the range of the buffer written by the last SendToDevice()
+   */
+  size_t GetOffset();
+  size_t GetSize();
+
   /**
    * Limpa o buffer da cpu
    */
   void Clear();
 
+  /**
+   * Obtains how many array elements of a stride, in bytes, a uniform block
+   * of this device holds, so that consecutive ranges of that many elements
+   * also start at the offset alignment of the uniform buffers
+   */
+  static int GetMaxArrayElements(size_t stride);
+
+  /**
+   * Obtains or resets the upload counters
+   */
+  const Stats &GetStats();
+  void ResetStats();
+
 private:
   /**
-   * Adds some memory data to the buffer
+   * Deletes the buffer and the fences and gives the memory back to GpuMemory
+   */
+  void Release();
+
+  /**
+   * Uploads the blocks that differ from the last upload, merged into ranges
+   */
+  void UploadDirtyRanges();
+
+  /**
+   * Moves to the next streaming slot, with room for the size, once the gpu
+   * has released it
+   */
+  unsigned char *NextSlot(size_t size);
+
+  /**
+   * Replaces the immutable storage once it has been specified
+   */
+  void Allocate(size_t size, const void *data, unsigned int flags);
+
+  /**
+   * Recreates the streaming storage with slots that fit the size
+   */
+  void AllocateSlots(size_t size);
+
+  /**
+   * Adds an upload to the counters
+   */
+  void CountUpload(size_t bytes, bool reallocation);
+
+  /**
+   * Waits until the gpu is done with the commands that read a slot
    */
-  void AddToBuffer(void *data, int size);
+  void WaitSlot(int slot);
 
   unsigned int ubo_;
-  std::vector<unsigned char> buffer_;
-  int padding_;
+  unsigned int target_;
+  Std140Buffer buffer_;
+  Usage usage_;
+  bool sent_;
+  Std140Buffer uploaded_;  // last upload of a dynamic buffer
+  std::vector<Std140Buffer::Range> dirty_ranges_;
+  int slots_;
+  int slot_;
+  size_t slot_capacity_;
+  size_t offset_;
+  size_t size_;
+  unsigned char *mapped_;
+  size_t allocated_bytes_;  // of the storage, see GpuMemory
+  std::vector<void *> fences_;
+  Stats stats_;
+  std::string label_;
 };
 
 #endif
@@ -0,0 +1,244 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <algorithm>
+#include <cstring>
+
+#include "CpuProfiler.h"
+#include "GLCheck.h"
+#include "GpuMemory.h"
+#include "UploadQueue.h"
+
+UploadQueue::UploadQueue()
+    : queued_(0),
+      issued_(0),
+      staging_(0),
+      mapped_(nullptr),
+      segment_size_(0),
+      segment_(0),
+      threaded_(false),
+      stop_(false),
+      visible_(0) {}
+
+UploadQueue::~UploadQueue() {
+  StopThread();
+  for (auto &copied : copied_)
+    glDeleteSync((GLsync)copied.second);
+  for (auto &upload : uploads_)
+    if (upload.ready)
+      glDeleteSync((GLsync)upload.ready);
+  for (auto &upload : incoming_)
+    if (upload.ready)
+      glDeleteSync((GLsync)upload.ready);
+  for (auto fence : fences_)
+    if (fence)
+      glDeleteSync((GLsync)fence);
+  if (staging_) {
+    glDeleteBuffers(1, &staging_);
+    GpuMemory::Free(GpuMemory::STREAMING, fences_.size() * segment_size_);
+  }
+}
+
+void UploadQueue::Init(size_t segment_size, int segments) {
+  segment_size_ = segment_size;
+  fences_.assign(segments, nullptr);
+  GLbitfield flags =
+      GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+  glCreateBuffers(1, &staging_);
+  glNamedBufferStorage(staging_, segments * segment_size, nullptr, flags);
+  GpuMemory::Allocate(GpuMemory::STREAMING, segments * segment_size);
+  mapped_ = (unsigned char *)glMapNamedBufferRange(
+      staging_, 0, segments * segment_size, flags);
+}
+
+void UploadQueue::StartThread(std::function<void(bool)> set_context) {
+  set_context_ = std::move(set_context);
+  threaded_ = true;
+  thread_ = std::thread(&UploadQueue::Run, this);
+}
+
+void UploadQueue::StopThread() {
+  if (!thread_.joinable())
+    return;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  wake_.notify_one();
+  thread_.join();
+}
+
+uint64_t UploadQueue::Add(unsigned int buffer,
+                          std::vector<unsigned char> data) {
+  return Push({buffer, std::move(data), 0, 0, 0, 0, 0, 0, 0, 0, 0, nullptr});
+}
+
+uint64_t UploadQueue::AddTexture(unsigned int texture, int level, int x,
+                                 int y, int layer, int width, int height,
+                                 std::vector<unsigned char> data,
+                                 unsigned int compressed_format) {
+  return Push({0, std::move(data), 0, texture, level, x, y, layer, width,
+               height, compressed_format, nullptr});
+}
+
+void UploadQueue::Update() {
+  if (!threaded_) {
+    CopySegment(false);
+    return;
+  }
+  // The segments are done in order, so their fences are only waited for on
+  // the gpu; the later commands of the render thread see the copies
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto &copied : copied_) {
+    glWaitSync((GLsync)copied.second, 0, GL_TIMEOUT_IGNORED);
+    glDeleteSync((GLsync)copied.second);
+    visible_ = copied.first;
+  }
+  copied_.clear();
+}
+
+bool UploadQueue::IsDone(uint64_t ticket) {
+  return (threaded_ ? visible_ : issued_) >= ticket;
+}
+
+bool UploadQueue::IsEmpty() {
+  return threaded_ ? visible_ == queued_ : uploads_.empty();
+}
+
+uint64_t UploadQueue::Push(Upload upload) {
+  queued_ += upload.data.size();
+  if (upload.data.empty())
+    return queued_;
+  if (!threaded_) {
+    uploads_.push_back(std::move(upload));
+    return queued_;
+  }
+  // The storage was created by the render thread, which the loader thread
+  // waits for before copying to it
+  upload.ready = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  glFlush();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    incoming_.push_back(std::move(upload));
+  }
+  wake_.notify_one();
+  return queued_;
+}
+
+void UploadQueue::CopySegment(bool wait) {
+  if (uploads_.empty())
+    return;
+  auto &fence = fences_[segment_];
+  if (fence) {
+    GLbitfield flags = wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0;
+    GLuint64 timeout = wait ? GL_TIMEOUT_IGNORED : 0;
+    auto status = glClientWaitSync((GLsync)fence, flags, timeout);
+    if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+      return;
+    glDeleteSync((GLsync)fence);
+    fence = nullptr;
+  }
+
+  size_t base = segment_ * segment_size_;
+  size_t used = 0;
+  while (!uploads_.empty() && used < segment_size_) {
+    auto &upload = uploads_.front();
+    if (upload.ready) {
+      glWaitSync((GLsync)upload.ready, 0, GL_TIMEOUT_IGNORED);
+      glDeleteSync((GLsync)upload.ready);
+      upload.ready = nullptr;
+    }
+    size_t size =
+        std::min(segment_size_ - used, upload.data.size() - upload.copied);
+    // A row of BC1 blocks holds 4 rows of texels
+    size_t row_size = upload.compressed_format ? 8 * ((upload.width + 3) / 4)
+                                               : 4 * upload.width;
+    int row_height = upload.compressed_format ? 4 : 1;
+    if (!upload.buffer) {
+      // Whole rows, at an offset aligned to the texels
+      used = (used + 3) / 4 * 4;
+      size = std::min(size, segment_size_ - std::min(used, segment_size_));
+      size = size / row_size * row_size;
+      if (size == 0)
+        break;
+    }
+    memcpy(mapped_ + base + used, upload.data.data() + upload.copied, size);
+    if (upload.buffer) {
+      glCopyNamedBufferSubData(staging_, upload.buffer, base + used,
+                               upload.copied, size);
+    } else {
+      int row = upload.copied / row_size * row_height;
+      int n_rows = std::min<int>(size / row_size * row_height,
+                                 upload.height - row);
+      int y = upload.y + row;
+      glBindBuffer(GL_PIXEL_UNPACK_BUFFER, staging_);
+      if (upload.compressed_format) {
+        glCompressedTextureSubImage3D(upload.texture, upload.level, upload.x,
+                                      y, upload.layer, upload.width, n_rows,
+                                      1, upload.compressed_format, size,
+                                      (const void *)(base + used));
+      } else {
+        glTextureSubImage3D(upload.texture, upload.level, upload.x, y,
+                            upload.layer, upload.width, n_rows, 1, GL_RGBA,
+                            GL_UNSIGNED_BYTE, (const void *)(base + used));
+      }
+      glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+    used += size;
+    upload.copied += size;
+    issued_ += size;
+    if (upload.copied == upload.data.size())
+      uploads_.pop_front();
+  }
+  fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  segment_ = (segment_ + 1) % fences_.size();
+  if (threaded_) {
+    // Flushed, so the render thread's wait for it ends
+    auto copied = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    glFlush();
+    std::lock_guard<std::mutex> lock(mutex_);
+    copied_.push_back({issued_, copied});
+  }
+}
+
+void UploadQueue::Run() {
+  CpuProfiler::SetThreadName("uploads");
+  set_context_(true);
+  for (;;) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      wake_.wait(lock, [&] {
+        return stop_ || !incoming_.empty() || !uploads_.empty();
+      });
+      if (stop_)
+        break;
+      for (auto &upload : incoming_)
+        uploads_.push_back(std::move(upload));
+      incoming_.clear();
+    }
+    CopySegment(true);
+  }
+  glFinish();
+  set_context_(false);
+}
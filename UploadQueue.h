@@ -0,0 +1,171 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef UPLOADQUEUE_H
+#define UPLOADQUEUE_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/**
+ * Copies data into gpu buffers and textures over several frames
+ *
+ * The data goes through a persistently mapped staging buffer split into one
+ * segment per frame in flight, each guarded by a fence. Every Update() fills
+ * the next segment and copies it to the destination buffers on the gpu, so a
+ * frame spends at most a segment of copies on the queue however large the
+ * uploads are. A frame whose segment is still being read copies nothing
+ * instead of waiting for it. Texture images are copied in whole rows, or rows
+ * of blocks for compressed formats, with the staging buffer as the pixel
+ * unpack buffer, so glTextureSubImage3D() returns without reading client
+ * memory.
+ *
+ * After StartThread(), the segments are copied as fast as the gpu frees them
+ * by a loader thread on a context shared with the render thread. A fence of
+ * the render thread guards the storage of each queued copy, and a fence of
+ * the loader thread each copied segment, which Update() makes the render
+ * thread wait for on the gpu before its tickets are done.
+ */
+class UploadQueue {
+public:
+  /**
+   * Default constructor
+   */
+  UploadQueue();
+
+  /**
+   * Destructor
+   */
+  ~UploadQueue();
+
+  /**
+   * Creates the staging buffer, with segment_size bytes copied per frame at
+   * most
+   */
+  void Init(size_t segment_size, int segments = 3);
+
+  /**
+   * Starts copying the queued data on a loader thread, which calls
+   * set_context(true) to make a context shared with the calling one current
+   * and set_context(false) to release it
+   */
+  void StartThread(std::function<void(bool)> set_context);
+
+  /**
+   * Stops the loader thread after its current segment, if it was started
+   */
+  void StopThread();
+
+  /**
+   * Queues a copy of the data to the start of a buffer, whose storage must
+   * already fit it
+   * Returns a ticket for IsDone()
+   */
+  uint64_t Add(unsigned int buffer, std::vector<unsigned char> data);
+
+  /**
+   * Queues a copy of a width x height image to a layer of a level of an array
+   * texture, at the texel (x, y), whose storage must already fit it: RGBA8
+   * texels, or the 8 bytes BC1 blocks of compressed_format (an S3TC DXT1
+   * format); the rows must fit a segment
+   * Returns a ticket for IsDone()
+   */
+  uint64_t AddTexture(unsigned int texture, int level, int x, int y,
+                      int layer, int width, int height,
+                      std::vector<unsigned char> data,
+                      unsigned int compressed_format = 0);
+
+  /**
+   * Copies the next segment of the queued data, once per frame; with the
+   * loader thread, waits for the segments it copied instead
+   */
+  void Update();
+
+  /**
+   * Checks if every copy up to a ticket was issued, which the commands
+   * issued after this call see
+   */
+  bool IsDone(uint64_t ticket);
+
+  /**
+   * Checks if every queued copy was issued
+   */
+  bool IsEmpty();
+
+private:
+  // Data queued for a buffer or a texture and how much of it was copied
+  struct Upload {
+    unsigned int buffer;  // 0 for textures
+    std::vector<unsigned char> data;
+    size_t copied;
+    unsigned int texture;
+    int level;
+    int x;
+    int y;
+    int layer;
+    int width;
+    int height;
+    unsigned int compressed_format;  // 0 for RGBA8
+    void *ready;  // fence of the storage, with the loader thread
+  };
+
+  // Queues an upload for Update() or the loader thread
+  uint64_t Push(Upload upload);
+
+  // Copies the next segment, if its last copy is done or, when waiting, once
+  // it is
+  void CopySegment(bool wait);
+
+  // Copies the segments of the loader thread until it's stopped
+  void Run();
+
+  std::deque<Upload> uploads_;  // copied by the loader thread if started
+  uint64_t queued_;  // bytes
+  uint64_t issued_;
+  unsigned int staging_;
+  unsigned char *mapped_;
+  size_t segment_size_;
+  int segment_;
+  std::vector<void *> fences_;  // of each segment
+
+  // The loader thread and what it shares with the render thread
+  bool threaded_;
+  std::thread thread_;
+  std::function<void(bool)> set_context_;
+  std::mutex mutex_;
+  std::condition_variable wake_;  // on a queued upload or the stop
+  std::vector<Upload> incoming_;  // queued for the loader thread
+  std::deque<std::pair<uint64_t, void *>> copied_;  // issued_ and its fence
+  bool stop_;
+  uint64_t visible_;  // issued bytes the render thread waited for
+};
+
+#endif
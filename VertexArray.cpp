@@ -22,31 +22,144 @@
  * SOFTWARE.
  */
 
+#include <algorithm>
+#include <cmath>
 #include <type_traits>
+#include <utility>
 
-#include <GL/glew.h>
-
+#include "GLCheck.h"
+#include "GLDebug.h"
+#include "GLState.h"
+#include "GpuMemory.h"
 #include "VertexArray.h"
 
-VertexArray::VertexArray() : vao_(0), n_indices_(0), type_(0) {}
+namespace {
+
+// Obtains the attribute type of T
+template <typename T> int TypeOf() {
+  return std::is_same<T, float>::value          ? GL_FLOAT :
+         std::is_same<T, int>::value            ? GL_INT :
+         std::is_same<T, unsigned int>::value   ? GL_UNSIGNED_INT :
+         std::is_same<T, short>::value          ? GL_SHORT :
+         std::is_same<T, unsigned short>::value ? GL_UNSIGNED_SHORT :
+         std::is_same<T, char>::value           ? GL_BYTE :
+         std::is_same<T, unsigned char>::value  ? GL_UNSIGNED_BYTE : 0;
+}
+
+// Maps a value in [-1, 1] to a signed integer of the given maximum
+int QuantizeSnorm(float value, int max) {
+  return (int)std::round(std::min(std::max(value, -1.0f), 1.0f) * max);
+}
+
+// Creates an immutable buffer with $size bytes of $data, counted in $bytes
+unsigned int CreateBuffer(size_t size, const void *data, size_t *bytes) {
+  unsigned int id;
+  glCreateBuffers(1, &id);
+  glNamedBufferStorage(id, size, data, 0);
+  GpuMemory::Allocate(GpuMemory::MESHES, size);
+  *bytes += size;
+  return id;
+}
+
+}  // namespace
+
+VertexLayout::VertexLayout() : stride_(0), divisor_(0) {}
+
+template <typename T>
+VertexLayout& VertexLayout::Add(int location, int n_elements,
+                                bool normalized) {
+  attributes_.push_back(
+      {location, n_elements, TypeOf<T>(), normalized, stride_});
+  stride_ += sizeof(T) * n_elements;
+  return *this;
+}
+
+VertexLayout& VertexLayout::AddPacked(int location, bool normalized) {
+  attributes_.push_back(
+      {location, 4, GL_INT_2_10_10_10_REV, normalized, stride_});
+  stride_ += sizeof(unsigned int);
+  return *this;
+}
+
+VertexLayout& VertexLayout::AddHalf(int location, int n_elements) {
+  attributes_.push_back({location, n_elements, GL_HALF_FLOAT, false, stride_});
+  stride_ += sizeof(unsigned short) * n_elements;
+  return *this;
+}
+
+VertexLayout& VertexLayout::AddMatrix(int location) {
+  for (int column = 0; column < 4; ++column)
+    Add<float>(location + column, 4);
+  return *this;
+}
+
+VertexLayout& VertexLayout::SetDivisor(unsigned int divisor) {
+  divisor_ = divisor;
+  return *this;
+}
+
+size_t VertexLayout::GetStride() const { return stride_; }
+
+void VertexLayout::Apply(unsigned int vao, unsigned int binding,
+                         unsigned int buffer, size_t offset) const {
+  for (auto& attribute : attributes_) {
+    glEnableVertexArrayAttrib(vao, attribute.location);
+    glVertexArrayAttribFormat(vao, attribute.location, attribute.n_elements,
+                              attribute.type, attribute.normalized,
+                              attribute.offset);
+    glVertexArrayAttribBinding(vao, attribute.location, binding);
+  }
+  glVertexArrayVertexBuffer(vao, binding, buffer, offset, stride_);
+  glVertexArrayBindingDivisor(vao, binding, divisor_);
+}
+
+VertexArray::VertexArray()
+    : vao_(0), n_bindings_(0), n_indices_(0), type_(0), bytes_(0) {}
 
-VertexArray::~VertexArray() {
+VertexArray::~VertexArray() { Release(); }
+
+VertexArray::VertexArray(VertexArray&& other) : VertexArray() {
+  *this = std::move(other);
+}
+
+VertexArray& VertexArray::operator=(VertexArray&& other) {
+  if (this == &other)
+    return *this;
+  Release();
+  vao_ = other.vao_;
+  arrays_ = std::move(other.arrays_);
+  n_bindings_ = other.n_bindings_;
+  n_indices_ = other.n_indices_;
+  type_ = other.type_;
+  bytes_ = other.bytes_;
+  label_ = std::move(other.label_);
+  // The other one has nothing left to delete
+  other.vao_ = 0;
+  other.arrays_.clear();
+  other.n_bindings_ = 0;
+  other.n_indices_ = 0;
+  other.bytes_ = 0;
+  return *this;
+}
+
+void VertexArray::Release() {
   if (vao_)
-    glDeleteVertexArrays(1, &vao_);
+    GLState::DeleteVertexArray(vao_);
   if (!arrays_.empty())
     glDeleteBuffers(arrays_.size(), arrays_.data());
+  GpuMemory::Free(GpuMemory::MESHES, bytes_);
 }
 
-void VertexArray::Init() { glGenVertexArrays(1, &vao_); }
+void VertexArray::Init() {
+  glCreateVertexArrays(1, &vao_);
+  ApplyLabels();
+}
 
 template <typename T> void VertexArray::SetElementArray(const T *array, int n) {
-  glBindVertexArray(vao_);
-  unsigned int id;
-  glGenBuffers(1, &id);
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, id);
-  glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(T) * n, array, GL_STATIC_DRAW);
-  glBindVertexArray(0);
+  unsigned int id = CreateBuffer(sizeof(T) * n, array, &bytes_);
+  glVertexArrayElementBuffer(vao_, id);
   arrays_.push_back(id);
+  ApplyLabels();
   n_indices_ = n;
   type_ = std::is_same<T, unsigned int>::value   ? GL_UNSIGNED_INT :
           std::is_same<T, unsigned short>::value ? GL_UNSIGNED_SHORT :
@@ -55,42 +168,95 @@ template <typename T> void VertexArray::SetElementArray(const T *array, int n) {
 
 template <typename T>
 void VertexArray::AddArray(int location, const T *array, int n,
-                           int n_elements) {
-  unsigned int id;
-  glGenBuffers(1, &id);
-  glBindBuffer(GL_ARRAY_BUFFER, id);
-  glBindVertexArray(vao_);
-  glBufferData(GL_ARRAY_BUFFER, sizeof(T) * n, array, GL_STATIC_DRAW);
-  glEnableVertexAttribArray(location);
-  auto type = std::is_same<T, float>::value         ? GL_FLOAT :
-              std::is_same<T, int>::value           ? GL_INT :
-              std::is_same<T, unsigned int>::value  ? GL_UNSIGNED_INT :
-              std::is_same<T, char>::value          ? GL_BYTE :
-              std::is_same<T, unsigned char>::value ? GL_UNSIGNED_BYTE : 0;
-  glVertexAttribPointer(location, n_elements, type, false, 0, NULL);
-  glBindBuffer(GL_ARRAY_BUFFER, 0);
-  glBindVertexArray(0);
+                           int n_elements, bool normalized) {
+  unsigned int id = CreateBuffer(sizeof(T) * n, array, &bytes_);
+  VertexLayout()
+      .Add<T>(location, n_elements, normalized)
+      .Apply(vao_, n_bindings_++, id);
+  arrays_.push_back(id);
+  ApplyLabels();
+}
+
+void VertexArray::AddInterleavedArray(const VertexLayout& layout,
+                                      const void *vertices, int n_vertices) {
+  unsigned int id = CreateBuffer(layout.GetStride() * n_vertices, vertices,
+                                 &bytes_);
+  layout.Apply(vao_, n_bindings_++, id);
   arrays_.push_back(id);
+  ApplyLabels();
+}
+
+int VertexArray::AddStream(const VertexLayout& layout, unsigned int buffer,
+                           size_t offset) {
+  int binding = n_bindings_++;
+  layout.Apply(vao_, binding, buffer, offset);
+  return binding;
+}
+
+void VertexArray::SetStream(int binding, const VertexLayout& layout,
+                            unsigned int buffer, size_t offset) {
+  glVertexArrayVertexBuffer(vao_, binding, buffer, offset,
+                            layout.GetStride());
+}
+
+void VertexArray::SetLabel(const std::string& label) {
+  label_ = label;
+  ApplyLabels();
+}
+
+void VertexArray::ApplyLabels() {
+  GLDebug::Label(GL_VERTEX_ARRAY, vao_, label_);
+  if (label_.empty())
+    return;
+  for (size_t i = 0; i < arrays_.size(); ++i)
+    GLDebug::Label(GL_BUFFER, arrays_[i],
+                   label_ + ".buffer" + std::to_string(i));
 }
 
 void VertexArray::DrawElements(int primitive) {
-  glBindVertexArray(vao_);
+  GLState::BindVertexArray(vao_);
   glDrawElements(primitive, n_indices_, type_, 0);
-  glBindVertexArray(0);
+  GLState::CountDraw();
 }
 
 void VertexArray::DrawInstances(int primitive, int n) {
-  glBindVertexArray(vao_);
+  GLState::BindVertexArray(vao_);
   glDrawElementsInstanced(primitive, n_indices_, type_, 0, n);
-  glBindVertexArray(0);
+  GLState::CountDraw();
+}
+
+void VertexArray::DrawArrays(int primitive, int n) {
+  GLState::BindVertexArray(vao_);
+  glDrawArrays(primitive, 0, n);
+  GLState::CountDraw();
 }
 
+unsigned int PackSigned2101010(float x, float y, float z, float w) {
+  return (QuantizeSnorm(x, 511) & 0x3ff) |
+         (QuantizeSnorm(y, 511) & 0x3ff) << 10 |
+         (QuantizeSnorm(z, 511) & 0x3ff) << 20 |
+         (unsigned int)(QuantizeSnorm(w, 1) & 0x3) << 30;
+}
+
+short QuantizeSnorm16(float value) { return QuantizeSnorm(value, 32767); }
+
+template VertexLayout& VertexLayout::Add<float>(int, int, bool);
+template VertexLayout& VertexLayout::Add<int>(int, int, bool);
+template VertexLayout& VertexLayout::Add<unsigned int>(int, int, bool);
+template VertexLayout& VertexLayout::Add<short>(int, int, bool);
+template VertexLayout& VertexLayout::Add<unsigned short>(int, int, bool);
+template VertexLayout& VertexLayout::Add<char>(int, int, bool);
+template VertexLayout& VertexLayout::Add<unsigned char>(int, int, bool);
 template void VertexArray::SetElementArray(const unsigned int *, int);
 template void VertexArray::SetElementArray(const unsigned short *, int);
 template void VertexArray::SetElementArray(const unsigned char *, int);
-template void VertexArray::AddArray(int, const float *, int, int);
-template void VertexArray::AddArray(int, const int *, int, int);
-template void VertexArray::AddArray(int, const unsigned int *, int, int);
-template void VertexArray::AddArray(int, const char *, int, int);
-template void VertexArray::AddArray(int, const unsigned char *, int, int);
+template void VertexArray::AddArray(int, const float *, int, int, bool);
+template void VertexArray::AddArray(int, const int *, int, int, bool);
+template void VertexArray::AddArray(int, const unsigned int *, int, int, bool);
+template void VertexArray::AddArray(int, const short *, int, int, bool);
+template void VertexArray::AddArray(int, const unsigned short *, int, int,
+                                    bool);
+template void VertexArray::AddArray(int, const char *, int, int, bool);
+template void VertexArray::AddArray(int, const unsigned char *, int, int,
+                                    bool);
 
@@ -25,8 +25,86 @@
 #ifndef VERTEXARRAY_H
 #define VERTEXARRAY_H
 
+#include <cstddef>
+#include <string>
 #include <vector>
 
+/**
+ * Interleaved vertex format
+ *
+ * The attributes of each vertex follow one another in a single buffer, so
+ * every vertex is fetched from one stream. The stride is the size of the
+ * whole vertex, with no padding between attributes. Normalized integer
+ * attributes reach the shader mapped to [-1, 1] or [0, 1], which lets
+ * quantized data replace floats at a fraction of the size.
+ *
+ * A layout with a divisor is of an instance stream instead: its attributes
+ * advance once every divisor instances, fetched by the vertex fetch like the
+ * vertices, so the instance data isn't bound by the size of a uniform block.
+ */
+class VertexLayout {
+ public:
+  /**
+   * Default constructor, an empty vertex
+   */
+  VertexLayout();
+
+  /**
+   * Appends an attribute of n_elements values to the vertex
+   * T = float | int | unsigned int | short | unsigned short | char |
+   *     unsigned char
+   */
+  template <typename T>
+  VertexLayout& Add(int location, int n_elements, bool normalized = false);
+
+  /**
+   * Appends a 4 component attribute packed in 32 bits as
+   * GL_INT_2_10_10_10_REV, see PackSigned2101010()
+   */
+  VertexLayout& AddPacked(int location, bool normalized = true);
+
+  /**
+   * Appends an attribute of n_elements half floats, see glm::packHalf1x16()
+   */
+  VertexLayout& AddHalf(int location, int n_elements);
+
+  /**
+   * Appends a mat4 attribute, as 4 vec4 columns from location on
+   */
+  VertexLayout& AddMatrix(int location);
+
+  /**
+   * Makes the attributes advance once every divisor instances instead of
+   * once per vertex; 0 goes back to per vertex
+   */
+  VertexLayout& SetDivisor(unsigned int divisor);
+
+  /**
+   * Obtains the size in bytes of a vertex
+   */
+  size_t GetStride() const;
+
+  /**
+   * Enables the attributes of a vertex array and sources them from $buffer,
+   * from $offset on, through its $binding point
+   */
+  void Apply(unsigned int vao, unsigned int binding, unsigned int buffer,
+             size_t offset = 0) const;
+
+ private:
+  struct Attribute {
+    int location;
+    int n_elements;
+    int type;
+    bool normalized;
+    size_t offset;
+  };
+
+  std::vector<Attribute> attributes_;
+  size_t stride_;
+  unsigned int divisor_;
+};
+
 /**
  * Opengl vertex array object abstraction
  */
@@ -43,7 +121,20 @@ class VertexArray {
   ~VertexArray();
 
   /**
-   * Creates the vao
+   * Takes the vao and the buffers of another vertex array, which is left
+   * empty
+   */
+  VertexArray(VertexArray&& other);
+  VertexArray& operator=(VertexArray&& other);
+
+  /**
+   * A vertex array owns its gl objects, so it can't be copied
+   */
+  VertexArray(const VertexArray&) = delete;
+  VertexArray& operator=(const VertexArray&) = delete;
+
+  /**
+   * Creates the vao, whose buffers are immutable once added
    */
   void Init();
 
@@ -56,10 +147,36 @@ class VertexArray {
 
   /**
    * Adds an array and attachs it to the vao
-   * T = float | int | unsigned int | char | unsigned char
+   * T = float | int | unsigned int | short | unsigned short | char |
+   *     unsigned char
    */
   template <typename T>
-  void AddArray(int location, const T *array, int n, int n_elements);
+  void AddArray(int location, const T *array, int n, int n_elements,
+                bool normalized = false);
+
+  /**
+   * Adds an array of interleaved vertices and attachs its attributes to
+   * the vao
+   */
+  void AddInterleavedArray(const VertexLayout& layout, const void *vertices,
+                           int n_vertices);
+
+  /**
+   * Attaches the attributes of a layout, usually an instance stream, to a
+   * buffer the vao doesn't own, from an offset on, and returns their binding
+   * point; SetStream() moves them to another range, such as the next slot
+   * of a streaming UniformBuffer
+   */
+  int AddStream(const VertexLayout& layout, unsigned int buffer,
+                size_t offset = 0);
+  void SetStream(int binding, const VertexLayout& layout, unsigned int buffer,
+                 size_t offset);
+
+  /**
+   * Names the vao and its buffers for debuggers (see GLDebug); the buffers
+   * are named label.buffer<i> in the order they were added
+   */
+  void SetLabel(const std::string& label);
 
   /**
    * Draws the vao
@@ -71,12 +188,41 @@ class VertexArray {
    */
   void DrawInstances(int primitive, int n);
 
+  /**
+   * Draws $n vertices without indices, which may come from no array at all
+   */
+  void DrawArrays(int primitive, int n);
+
  private:
+  /**
+   * Deletes the vao and the buffers and gives their memory back to GpuMemory
+   */
+  void Release();
+
+  /**
+   * Names the vao and its buffers with the label
+   */
+  void ApplyLabels();
+
   unsigned int vao_;
   std::vector<unsigned int> arrays_;
+  unsigned int n_bindings_;
   unsigned int n_indices_;
   unsigned int type_;
+  size_t bytes_;  // of the buffers, see GpuMemory
+  std::string label_;
 };
 
+/**
+ * Packs a vector of components in [-1, 1] as GL_INT_2_10_10_10_REV, with 10
+ * bits for x, y and z and 2 bits for w
+ */
+unsigned int PackSigned2101010(float x, float y, float z, float w = 0);
+
+/**
+ * Quantizes a value in [-1, 1] to a normalized short
+ */
+short QuantizeSnorm16(float value);
+
 #endif
 
@@ -0,0 +1,167 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "BufferBindings.h"
+#include "GLCheck.h"
+#include "GpuMemory.h"
+#include "VertexSkinning.h"
+
+namespace {
+
+// Threads per work group of the skinning shader
+const int GROUP_SIZE = 256;
+
+// Bytes of a vertex of MeshBatch and of struct SkinnedVertex of
+// shaders/skin_cs.glsl
+const int SOURCE_VERTEX_SIZE = 16;
+const int SKINNED_VERTEX_SIZE = 32;
+
+// Heights, in the quantized space of the meshes, where the weight of the
+// upper bone starts and ends growing
+const glm::vec2 BONE_HEIGHTS(-0.3f, 0.7f);
+
+// Largest angle of the sway of the upper bone, in radians, and its period,
+// in seconds
+const float SWAY_ANGLE = 0.25f;
+const double SWAY_PERIOD = 2.0;
+
+// Axis of the sway
+const glm::vec3 SWAY_AXIS(0, 0, 1);
+
+}  // namespace
+
+VertexSkinning::VertexSkinning()
+    : n_models_(0),
+      n_poses_(1),
+      n_vertices_(0),
+      source_buffer_(0),
+      offsets_buffer_(0),
+      skinned_buffer_(0),
+      skinned_bytes_(0) {}
+
+VertexSkinning::~VertexSkinning() {
+  if (offsets_buffer_)
+    glDeleteBuffers(1, &offsets_buffer_);
+  if (skinned_buffer_) {
+    glDeleteBuffers(1, &skinned_buffer_);
+    GpuMemory::Free(GpuMemory::STREAMING, skinned_bytes_);
+  }
+}
+
+void VertexSkinning::Init(int n_models, int n_poses) {
+  n_models_ = n_models;
+  n_poses_ = std::max(n_poses, 1);
+
+  // No model is skinned until SetMesh()
+  glCreateBuffers(1, &offsets_buffer_);
+  std::vector<int> offsets(std::max(n_models, 1), -1);
+  glNamedBufferStorage(offsets_buffer_, offsets.size() * sizeof(int),
+                       offsets.data(), GL_DYNAMIC_STORAGE_BIT);
+  bones_.Init(UniformBuffer::STORAGE, UniformBuffer::STREAM);
+  bones_.SetLabel("skin bones");
+
+  ShaderProgram::RegisterBlockBinding("SkinSourceBlock",
+                                      buffer_bindings::SKIN_SOURCE);
+  ShaderProgram::RegisterBlockBinding("SkinBonesBlock",
+                                      buffer_bindings::SKIN_BONES);
+  ShaderProgram::RegisterBlockBinding("SkinnedVerticesBlock",
+                                      buffer_bindings::SKINNED_VERTICES);
+  ShaderProgram::RegisterBlockBinding("SkinOffsetsBlock",
+                                      buffer_bindings::SKIN_OFFSETS);
+  shader_.LoadComputeShader(
+      "shaders/skin_cs.glsl",
+      ShaderProgram::GenerateDefines(
+          {{"GROUP_SIZE", std::to_string(GROUP_SIZE)}}));
+  shader_.LinkShader();
+  ShaderProgram::CheckBlockMember(
+      shader_.GetStorageBlockInfo("SkinnedVerticesBlock"),
+      "skinned_vertices[0].position", 0, SKINNED_VERTEX_SIZE);
+}
+
+void VertexSkinning::SetMesh(unsigned int vertex_buffer, int n_vertices,
+                             int first_model, int n_models) {
+  source_buffer_ = vertex_buffer;
+  n_vertices_ = n_vertices;
+  skinned_bytes_ = (size_t)n_poses_ * n_vertices * SKINNED_VERTEX_SIZE;
+  glCreateBuffers(1, &skinned_buffer_);
+  glNamedBufferStorage(skinned_buffer_, std::max(skinned_bytes_, (size_t)1),
+                       nullptr, 0);
+  GpuMemory::Allocate(GpuMemory::STREAMING, skinned_bytes_);
+
+  // The models take the poses in turn
+  n_models = std::max(std::min(n_models, n_models_ - first_model), 0);
+  std::vector<int> offsets(n_models);
+  for (int i = 0; i < n_models; ++i)
+    offsets[i] = (i % n_poses_) * n_vertices;
+  if (n_models)
+    glNamedBufferSubData(offsets_buffer_, first_model * sizeof(int),
+                         n_models * sizeof(int), offsets.data());
+}
+
+void VertexSkinning::Update(double time) {
+  if (!skinned_buffer_ || !n_vertices_)
+    return;
+  // The poses are spread over a period of the sway
+  bones_.Clear();
+  for (int pose = 0; pose < n_poses_; ++pose) {
+    double phase = time / SWAY_PERIOD + (double)pose / n_poses_;
+    float angle = SWAY_ANGLE * (float)std::sin(2 * M_PI * phase);
+    bones_.Add(glm::mat4(1));
+    bones_.Add(glm::rotate(glm::mat4(1), angle, SWAY_AXIS));
+  }
+  bones_.SendToDevice();
+
+  shader_.Enable();
+  ShaderProgram::BindStorageBuffer(buffer_bindings::SKIN_SOURCE,
+                                   source_buffer_, 0,
+                                   n_vertices_ * SOURCE_VERTEX_SIZE);
+  ShaderProgram::BindStorageBuffer(buffer_bindings::SKIN_BONES,
+                                   bones_.GetId(), bones_.GetOffset(),
+                                   bones_.GetSize());
+  ShaderProgram::BindStorageBuffer(buffer_bindings::SKINNED_VERTICES,
+                                   skinned_buffer_);
+  shader_.SetUniform("n_vertices", n_vertices_);
+  shader_.SetUniform("n_poses", n_poses_);
+  shader_.SetUniform("bone_heights", BONE_HEIGHTS);
+  int n_threads = n_vertices_ * n_poses_;
+  glDispatchCompute((n_threads + GROUP_SIZE - 1) / GROUP_SIZE, 1, 1);
+  glMemoryBarrier(GL_SHADER_STORAGE_BARRIER_BIT);
+}
+
+void VertexSkinning::Bind() {
+  // Some buffer must be bound, even if no model is skinned yet
+  ShaderProgram::BindStorageBuffer(
+      buffer_bindings::SKINNED_VERTICES,
+      skinned_buffer_ ? skinned_buffer_ : offsets_buffer_);
+  ShaderProgram::BindStorageBuffer(buffer_bindings::SKIN_OFFSETS,
+                                   offsets_buffer_);
+}
+
+bool VertexSkinning::IsReady() { return skinned_buffer_ != 0; }
@@ -0,0 +1,101 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef VERTEXSKINNING_H
+#define VERTEXSKINNING_H
+
+#include "ShaderProgram.h"
+#include "UniformBuffer.h"
+
+/**
+ * Vertices of a batch skinned once per frame on the gpu
+ *
+ * The meshes have no skeletons, so the rig is procedural: each pose has a
+ * root bone at rest and an upper bone that sways about the center of the
+ * mesh, with the weight of the upper bone growing with the height of the
+ * vertex. A compute pre-pass blends every vertex of the batch for every
+ * pose into one storage buffer (see shaders/skin_cs.glsl), and the vertex
+ * shaders of the geometry, the shadows and every other pass read the
+ * vertices of the pose of their instance from it instead of their
+ * attributes (see SKINNING in shaders/geometry.glsl). The instances take
+ * the poses in turn, so the cost of skinning doesn't grow with the number
+ * of instances or of passes.
+ */
+class VertexSkinning {
+public:
+  /**
+   * Default constructor
+   */
+  VertexSkinning();
+
+  /**
+   * Destructor
+   */
+  ~VertexSkinning();
+
+  /**
+   * Creates the poses and the offsets of that many models, none of them
+   * skinned yet, and loads the skinning shader
+   * Throws runtime_error if the shader fails or its blocks aren't laid out
+   * as expected
+   */
+  void Init(int n_models, int n_poses);
+
+  /**
+   * Skins the vertices of a batch, in the format of MeshBatch, for the
+   * models from first_model on; must be called once, after the batch was
+   * uploaded
+   */
+  void SetMesh(unsigned int vertex_buffer, int n_vertices, int first_model,
+               int n_models);
+
+  /**
+   * Poses the bones at a time in seconds and skins the vertices
+   * Does nothing before SetMesh()
+   */
+  void Update(double time);
+
+  /**
+   * Binds the skinned vertices and the offsets of the models
+   */
+  void Bind();
+
+  /**
+   * Checks if the vertices were set
+   */
+  bool IsReady();
+
+private:
+  int n_models_;
+  int n_poses_;
+  int n_vertices_;
+  unsigned int source_buffer_;
+  unsigned int offsets_buffer_;
+  unsigned int skinned_buffer_;
+  size_t skinned_bytes_;  // see GpuMemory
+  UniformBuffer bones_;
+  ShaderProgram shader_;
+};
+
+#endif
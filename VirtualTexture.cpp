@@ -0,0 +1,535 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <stdexcept>
+
+#include "BufferBindings.h"
+#include "GLCheck.h"
+#include "GLState.h"
+#include "TextureCompression.h"
+#include "VirtualTexture.h"
+
+namespace {
+
+// Format of the layers, the one of the KTX2 files
+const GLenum FORMAT = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+
+// Threads that read the pages, which mostly wait for the disk
+const int N_WORKERS = 2;
+
+// Pages queued for the workers at most, so a sudden view of many new pages
+// loads the ones still wanted first
+const int MAX_LOADING_PAGES = 32;
+
+// Frames of feedback in flight, read back once the gpu is past them
+const int FEEDBACK_SLOTS = 3;
+
+// Frames since their last request during which pages aren't released: a
+// page can be seen by a single feedback pixel of a block, which comes back
+// every FEEDBACK_STRIDE^2 frames
+const int KEEP_FRAMES = 2 * VirtualTexture::FEEDBACK_STRIDE *
+                            VirtualTexture::FEEDBACK_STRIDE +
+                        FEEDBACK_SLOTS;
+
+// Obtains the bytes of a square level of BC1 blocks
+size_t GetBlocksSize(int size) {
+  size_t blocks = (size + 3) / 4;
+  return blocks * blocks * 8;
+}
+
+// Commits or releases the memory of a region of a level of a layer; the
+// commitment command takes the texture bound to the active unit, which is
+// always the first one
+void CommitRegion(unsigned int texture, int level, int x, int y, int layer,
+                  int width, int height, int depth, bool commit) {
+  GLState::BindTexture(0, texture);
+  glTexPageCommitmentARB(GL_TEXTURE_2D_ARRAY, level, x, y, layer, width,
+                         height, depth, commit);
+}
+
+}  // namespace
+
+VirtualTexture::VirtualTexture()
+    : size_(0),
+      max_pages_(0),
+      page_width_(0),
+      page_height_(0),
+      n_levels_(0),
+      n_sparse_levels_(0),
+      n_layers_(0),
+      pages_x_(0),
+      pages_y_(0),
+      layer_pages_(0),
+      texture_(0),
+      page_table_(0),
+      queue_(nullptr),
+      n_resident_(0),
+      n_loading_(0),
+      table_changed_(false),
+      frame_(0),
+      feedback_buffer_(0),
+      feedback_(nullptr),
+      slot_size_(0),
+      slot_(0),
+      writing_(false),
+      stopping_(false) {}
+
+VirtualTexture::~VirtualTexture() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  requests_ready_.notify_all();
+  for (auto& worker : workers_)
+    worker.join();
+  for (auto fence : fences_)
+    if (fence)
+      glDeleteSync((GLsync)fence);
+  if (feedback_buffer_)
+    glDeleteBuffers(1, &feedback_buffer_);
+  if (texture_)
+    GLState::DeleteTextures(1, &texture_);
+  if (page_table_)
+    GLState::DeleteTextures(1, &page_table_);
+}
+
+ShaderProgram::Defines VirtualTexture::GetDefines() {
+  return {{"VIRTUAL_TEXTURE", "1"},
+          {"FEEDBACK_STRIDE", std::to_string(FEEDBACK_STRIDE)}};
+}
+
+void VirtualTexture::Init(int size, int max_pages) {
+  if (!GLEW_ARB_sparse_texture || !GLEW_EXT_texture_compression_s3tc)
+    throw std::runtime_error("Sparse BC1 textures not supported");
+  GLint n_page_sizes = 0;
+  glGetInternalformativ(GL_TEXTURE_2D_ARRAY, FORMAT,
+                        GL_NUM_VIRTUAL_PAGE_SIZES_ARB, 1, &n_page_sizes);
+  if (n_page_sizes <= 0)
+    throw std::runtime_error("No sparse page size for BC1 array textures");
+  glGetInternalformativ(GL_TEXTURE_2D_ARRAY, FORMAT,
+                        GL_VIRTUAL_PAGE_SIZE_X_ARB, 1, &page_width_);
+  glGetInternalformativ(GL_TEXTURE_2D_ARRAY, FORMAT,
+                        GL_VIRTUAL_PAGE_SIZE_Y_ARB, 1, &page_height_);
+  if (page_width_ <= 0 || page_height_ <= 0 || size % page_width_ ||
+      size % page_height_) {
+    throw std::runtime_error(
+        "The sparse pages (" + std::to_string(page_width_) + "x" +
+        std::to_string(page_height_) + ") don't split the diffuse maps");
+  }
+  size_ = size;
+  max_pages_ = max_pages;
+  n_levels_ = 1;
+  while ((size >> n_levels_) > 0)
+    n_levels_++;
+  pages_x_ = size / page_width_;
+  pages_y_ = size / page_height_;
+
+  ShaderProgram::RegisterBlockBinding("PageRequestsBlock",
+                                      buffer_bindings::PAGE_REQUESTS);
+  for (int i = 0; i < N_WORKERS; ++i)
+    workers_.emplace_back(&VirtualTexture::RunWorker, this);
+}
+
+std::vector<int> VirtualTexture::Open(const std::vector<std::string>& paths) {
+  std::map<std::string, int> file_layers;
+  std::vector<int> layers;
+  for (auto& path : paths) {
+    if (path.empty()) {
+      layers.push_back(-1);
+      continue;
+    }
+    auto file = file_layers.find(path);
+    if (file == file_layers.end()) {
+      int layer = -1;
+      std::vector<uint64_t> offsets;
+      auto ktx2_path = GetKtx2Path(path);
+      if (ReadKtx2Index(ktx2_path, size_, &offsets)) {
+        layer = files_.size();
+        files_.push_back(ktx2_path);
+        offsets_.push_back(offsets);
+      } else {
+        fprintf(stderr, "Unable to open texture %s (run make textures)\n",
+                ktx2_path.c_str());
+      }
+      file = file_layers.emplace(path, layer).first;
+    }
+    layers.push_back(file->second);
+  }
+  n_layers_ = files_.size();
+  return layers;
+}
+
+void VirtualTexture::Upload(UploadQueue* queue) {
+  queue_ = queue;
+  if (!n_layers_)
+    return;
+  glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &texture_);
+  glTextureParameteri(texture_, GL_TEXTURE_SPARSE_ARB, GL_TRUE);
+  glTextureParameteri(texture_, GL_VIRTUAL_PAGE_SIZE_INDEX_ARB, 0);
+  glTextureStorage3D(texture_, n_levels_, FORMAT, size_, size_, n_layers_);
+  glTextureParameteri(texture_, GL_TEXTURE_MIN_FILTER,
+                      GL_LINEAR_MIPMAP_LINEAR);
+  glTextureParameteri(texture_, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  GLint n_sparse_levels = 0;
+  glGetTextureParameteriv(texture_, GL_NUM_SPARSE_LEVELS_ARB,
+                          &n_sparse_levels);
+
+  // The levels with whole pages, the smaller ones are the mip tail
+  n_sparse_levels_ = 0;
+  layer_pages_ = 0;
+  level_pages_.clear();
+  while (n_sparse_levels_ < n_sparse_levels &&
+         (size_ >> n_sparse_levels_) % page_width_ == 0 &&
+         (size_ >> n_sparse_levels_) % page_height_ == 0) {
+    level_pages_.push_back(layer_pages_);
+    layer_pages_ += (pages_x_ >> n_sparse_levels_) *
+                    (pages_y_ >> n_sparse_levels_);
+    n_sparse_levels_++;
+  }
+  level_pages_.push_back(layer_pages_);
+  pages_.assign(n_layers_ * layer_pages_, {ABSENT, 0, 0});
+  tail_tickets_.assign(n_layers_, 0);
+  for (int level = n_sparse_levels_; level < n_levels_; ++level) {
+    int level_size = size_ >> level;
+    CommitRegion(texture_, level, 0, 0, 0, level_size, level_size, n_layers_,
+                 true);
+  }
+
+  // Every texel starts at the mip tail
+  glCreateTextures(GL_TEXTURE_2D_ARRAY, 1, &page_table_);
+  glTextureStorage3D(page_table_, 1, GL_R8UI, pages_x_, pages_y_, n_layers_);
+  table_changed_ = true;
+
+  // The bits of a frame, aligned for the binding offsets
+  GLint alignment = 1;
+  glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+  int n_words = std::max((n_layers_ * layer_pages_ + 31) / 32, 1);
+  slot_size_ = n_words * sizeof(uint32_t);
+  slot_size_ = (slot_size_ + alignment - 1) / alignment * alignment;
+  fences_.assign(FEEDBACK_SLOTS, nullptr);
+  GLbitfield flags =
+      GL_MAP_READ_BIT | GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT |
+      GL_MAP_COHERENT_BIT;
+  std::vector<unsigned char> zeros(FEEDBACK_SLOTS * slot_size_, 0);
+  glCreateBuffers(1, &feedback_buffer_);
+  glNamedBufferStorage(feedback_buffer_, zeros.size(), zeros.data(), flags);
+  feedback_ = (uint32_t*)glMapNamedBufferRange(feedback_buffer_, 0,
+                                              zeros.size(), flags);
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (int layer = 0; layer < n_layers_; ++layer)
+      requests_.push_back(-1 - layer);
+  }
+  requests_ready_.notify_all();
+}
+
+bool VirtualTexture::IsReady() {
+  if (!n_layers_)
+    return true;
+  if (!texture_)
+    return false;
+  for (auto ticket : tail_tickets_)
+    if (!ticket || !queue_->IsDone(ticket))
+      return false;
+  return true;
+}
+
+void VirtualTexture::Update() {
+  if (!texture_)
+    return;
+  frame_++;
+  std::vector<int> requested;
+  ReadFeedback(&requested);
+  for (auto page : requested)
+    RequestPage(page);
+  CommitLoadedPages();
+  UpdatePageTable();
+}
+
+void VirtualTexture::Bind(ShaderProgram* shader, int unit) {
+  // No sampler objects, the page table is read with texelFetch
+  unsigned int textures[] = {texture_, page_table_};
+  unsigned int samplers[] = {0, 0};
+  GLState::BindTextures(unit, 2, textures);
+  GLState::BindSamplers(unit, 2, samplers);
+  shader->SetUniform("page_levels", unit + 1);
+  shader->SetUniform("page_size", glm::ivec2(page_width_, page_height_));
+  shader->SetUniform("n_sparse_levels", n_sparse_levels_);
+  auto pixel = glm::ivec2(-1);
+  if (writing_) {
+    ShaderProgram::BindStorageBuffer(buffer_bindings::PAGE_REQUESTS,
+                                     feedback_buffer_, slot_ * slot_size_,
+                                     slot_size_);
+    int block_pixel = frame_ % (FEEDBACK_STRIDE * FEEDBACK_STRIDE);
+    pixel = glm::ivec2(block_pixel % FEEDBACK_STRIDE,
+                       block_pixel / FEEDBACK_STRIDE);
+  }
+  shader->SetUniform("feedback_pixel", pixel);
+}
+
+int VirtualTexture::GetResidentPages() { return n_resident_; }
+
+bool VirtualTexture::IsStreaming() {
+  if (n_loading_ > 0 || !IsReady())
+    return true;
+  for (auto& page : pages_)
+    if (page.state == LOADING || page.state == UPLOADING)
+      return true;
+  return false;
+}
+
+int VirtualTexture::GetPage(int layer, int level, int x, int y) {
+  int width = pages_x_ >> level, height = pages_y_ >> level;
+  x = (x % width + width) % width;
+  y = (y % height + height) % height;
+  return layer * layer_pages_ + level_pages_[level] + y * width + x;
+}
+
+void VirtualTexture::GetPageCoords(int page, int* layer, int* level, int* x,
+                                   int* y) {
+  *layer = page / layer_pages_;
+  int index = page % layer_pages_;
+  *level = 0;
+  while (index >= level_pages_[*level + 1])
+    (*level)++;
+  index -= level_pages_[*level];
+  int width = pages_x_ >> *level;
+  *x = index % width;
+  *y = index / width;
+}
+
+VirtualTexture::LoadedPage VirtualTexture::LoadPage(int page, int layer) {
+  LoadedPage loaded = {page, layer, {}};
+  std::ifstream input(files_[layer], std::ios::binary);
+  auto& offsets = offsets_[layer];
+  if (page < 0) {
+    for (int level = n_sparse_levels_; level < n_levels_; ++level) {
+      loaded.levels.emplace_back(GetBlocksSize(size_ >> level));
+      input.seekg(offsets[level]);
+      input.read((char*)loaded.levels.back().data(),
+                 loaded.levels.back().size());
+    }
+  } else {
+    // The page is a rectangle of the blocks of its level, read a block row
+    // at a time
+    int level, x, y;
+    GetPageCoords(page, &layer, &level, &x, &y);
+    size_t level_blocks = (size_ >> level) / 4;
+    size_t row_size = page_width_ / 4 * 8;
+    int n_rows = page_height_ / 4;
+    loaded.levels.emplace_back(n_rows * row_size);
+    for (int row = 0; row < n_rows; ++row) {
+      size_t block_y = y * n_rows + row;
+      size_t block_x = x * page_width_ / 4;
+      input.seekg(offsets[level] + (block_y * level_blocks + block_x) * 8);
+      input.read((char*)&loaded.levels[0][row * row_size], row_size);
+    }
+  }
+  if (!input) {
+    fprintf(stderr, "Unable to read texture %s\n", files_[layer].c_str());
+    for (auto& level : loaded.levels)
+      std::fill(level.begin(), level.end(), 0);
+  }
+  return loaded;
+}
+
+void VirtualTexture::RunWorker() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    requests_ready_.wait(lock,
+                         [this] { return stopping_ || !requests_.empty(); });
+    if (stopping_)
+      return;
+    int request = requests_.front();
+    requests_.pop_front();
+    lock.unlock();
+    auto loaded = request < 0 ? LoadPage(-1, -1 - request)
+                              : LoadPage(request, request / layer_pages_);
+    lock.lock();
+    loaded_.push_back(std::move(loaded));
+  }
+}
+
+void VirtualTexture::ReadFeedback(std::vector<int>* requested) {
+  // The fence of the last frame follows its geometry pass, which wrote the
+  // bits through the mapping
+  if (writing_) {
+    glMemoryBarrier(GL_CLIENT_MAPPED_BUFFER_BARRIER_BIT);
+    fences_[slot_] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    slot_ = (slot_ + 1) % fences_.size();
+    writing_ = false;
+  }
+
+  // A slot the gpu is still writing leaves the frame without feedback
+  auto& fence = fences_[slot_];
+  if (fence) {
+    auto status = glClientWaitSync((GLsync)fence, 0, 0);
+    if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+      return;
+    glDeleteSync((GLsync)fence);
+    fence = nullptr;
+    auto bits = feedback_ + slot_ * slot_size_ / sizeof(uint32_t);
+    int n_words = (pages_.size() + 31) / 32;
+    for (int i = 0; i < n_words; ++i) {
+      for (uint32_t word = bits[i]; word; word &= word - 1) {
+        int bit = 0;
+        while (!(word >> bit & 1))
+          bit++;
+        requested->push_back(32 * i + bit);
+      }
+      bits[i] = 0;
+    }
+  }
+  writing_ = true;
+}
+
+void VirtualTexture::RequestPage(int page) {
+  int layer, level, x, y;
+  GetPageCoords(page, &layer, &level, &x, &y);
+  std::vector<int> missing;
+  for (int i = n_sparse_levels_ - 1; i >= level; --i) {
+    int shift = i - level;
+    for (int j = 0; j < 9; ++j) {
+      int neighbor =
+          GetPage(layer, i, (x >> shift) + j % 3 - 1, (y >> shift) + j / 3 - 1);
+      auto& state = pages_[neighbor];
+      state.last_request = frame_;
+      if (state.state == ABSENT &&
+          n_loading_ + (int)missing.size() < MAX_LOADING_PAGES) {
+        state.state = LOADING;
+        missing.push_back(neighbor);
+      }
+    }
+  }
+  if (missing.empty())
+    return;
+  n_loading_ += missing.size();
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    requests_.insert(requests_.end(), missing.begin(), missing.end());
+  }
+  requests_ready_.notify_all();
+}
+
+void VirtualTexture::CommitLoadedPages() {
+  std::vector<LoadedPage> loaded;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    loaded.swap(loaded_);
+  }
+  for (auto& page : loaded) {
+    if (page.page < 0) {
+      for (size_t i = 0; i < page.levels.size(); ++i) {
+        int level = n_sparse_levels_ + i, level_size = size_ >> level;
+        tail_tickets_[page.layer] = queue_->AddTexture(
+            texture_, level, 0, 0, page.layer, level_size, level_size,
+            std::move(page.levels[i]), FORMAT);
+      }
+      continue;
+    }
+    n_loading_--;
+    auto& state = pages_[page.page];
+    if (n_resident_ >= max_pages_ && !ReleasePage()) {
+      state.state = ABSENT;
+      continue;
+    }
+    int layer, level, x, y;
+    GetPageCoords(page.page, &layer, &level, &x, &y);
+    CommitRegion(texture_, level, x * page_width_, y * page_height_, layer,
+                 page_width_, page_height_, 1, true);
+    state.state = UPLOADING;
+    state.ticket = queue_->AddTexture(
+        texture_, level, x * page_width_, y * page_height_, layer,
+        page_width_, page_height_, std::move(page.levels[0]), FORMAT);
+    n_resident_++;
+  }
+}
+
+bool VirtualTexture::ReleasePage() {
+  // The pages under a requested one are requested at the same time, so the
+  // oldest pages are never under newer ones, and the finest go first
+  int oldest = -1;
+  for (size_t i = 0; i < pages_.size(); ++i) {
+    auto& page = pages_[i];
+    if (page.state == RESIDENT && page.last_request < frame_ - KEEP_FRAMES &&
+        (oldest < 0 || page.last_request < pages_[oldest].last_request ||
+         (page.last_request == pages_[oldest].last_request &&
+          (int)(i % layer_pages_) < (int)(oldest % layer_pages_))))
+      oldest = i;
+  }
+  if (oldest < 0)
+    return false;
+  int layer, level, x, y;
+  GetPageCoords(oldest, &layer, &level, &x, &y);
+  CommitRegion(texture_, level, x * page_width_, y * page_height_, layer,
+               page_width_, page_height_, 1, false);
+  pages_[oldest].state = ABSENT;
+  n_resident_--;
+  table_changed_ = true;
+  return true;
+}
+
+void VirtualTexture::UpdatePageTable() {
+  for (auto& page : pages_) {
+    if (page.state == UPLOADING && queue_->IsDone(page.ticket)) {
+      page.state = RESIDENT;
+      table_changed_ = true;
+    }
+  }
+  if (!table_changed_)
+    return;
+  table_changed_ = false;
+
+  // A page can be sampled if it and its neighbors are resident
+  auto is_usable = [&](int layer, int level, int x, int y) {
+    for (int j = 0; j < 9; ++j) {
+      int page = GetPage(layer, level, x + j % 3 - 1, y + j / 3 - 1);
+      if (pages_[page].state != RESIDENT)
+        return false;
+    }
+    return true;
+  };
+  std::vector<unsigned char> table(pages_x_ * pages_y_ * n_layers_);
+  for (int layer = 0; layer < n_layers_; ++layer) {
+    for (int y = 0; y < pages_y_; ++y) {
+      for (int x = 0; x < pages_x_; ++x) {
+        int level = n_sparse_levels_;
+        while (level > 0 && is_usable(layer, level - 1, x >> (level - 1),
+                                      y >> (level - 1)))
+          level--;
+        table[(layer * pages_y_ + y) * pages_x_ + x] = level;
+      }
+    }
+  }
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  glTextureSubImage3D(page_table_, 0, 0, 0, 0, pages_x_, pages_y_, n_layers_,
+                      GL_RED_INTEGER, GL_UNSIGNED_BYTE, table.data());
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+}
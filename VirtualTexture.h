@@ -0,0 +1,247 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef VIRTUALTEXTURE_H
+#define VIRTUALTEXTURE_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ShaderProgram.h"
+#include "UploadQueue.h"
+
+/**
+ * Diffuse maps streamed by pages into a sparse array texture
+ * (ARB_sparse_texture), so their memory is bounded by the pages in view
+ * rather than by the files
+ *
+ * Each layer is a BC1 KTX2 file made by `make textures`. Only the mip tail of
+ * each layer, the levels smaller than a page, stays committed; the pages of
+ * the other levels are committed when a frame samples them. The geometry
+ * pass records the page each of its feedback pixels wants, one pixel of
+ * each FEEDBACK_STRIDE x FEEDBACK_STRIDE block in turn, as a bit per page of
+ * a persistently mapped storage buffer. Update() reads those bits a few
+ * frames later without waiting for the gpu, worker threads read the missing
+ * pages from the files, and the pages they load are committed and copied
+ * through an UploadQueue. Once the budget of pages is full, the pages no
+ * feedback asked for the longest are released for them.
+ *
+ * The shaders never sample a page that isn't resident: the page table, a
+ * texel per page of the first level, holds the finest level resident over
+ * that page and its neighbors, with every coarser level under it, and the
+ * samples are clamped to it (see shaders/geompass_fs.glsl).
+ */
+class VirtualTexture {
+public:
+  /**
+   * Pixel spacing of the feedback of the geometry pass
+   */
+  static const int FEEDBACK_STRIDE = 4;
+
+  /**
+   * Default constructor
+   */
+  VirtualTexture();
+
+  /**
+   * Destructor, stops the workers
+   */
+  ~VirtualTexture();
+
+  /**
+   * Obtains the defines of the geometry pass that samples the texture
+   */
+  static ShaderProgram::Defines GetDefines();
+
+  /**
+   * Checks the support of sparse BC1 array textures with pages that split
+   * layers of size x size texels, and starts the workers; max_pages bounds
+   * the pages committed besides the mip tails
+   * Throws runtime_error if sparse textures aren't supported
+   */
+  void Init(int size, int max_pages);
+
+  /**
+   * Opens the KTX2 files of PNG files (see GetKtx2Path), "" for none, as
+   * layers; repeated files share a layer
+   * Returns the layer of each file, -1 for none and for the files without a
+   * valid KTX2 file, which are reported on stderr
+   * Must be called once, after Init() and before Upload(); only reads the
+   * files, so it may run on a loading thread
+   */
+  std::vector<int> Open(const std::vector<std::string>& paths);
+
+  /**
+   * Creates the sparse texture and the page table and starts loading the
+   * mip tails, copied through the queue; does nothing without layers
+   */
+  void Upload(UploadQueue* queue);
+
+  /**
+   * Checks if the mip tails are on the gpu, so every texel can be sampled
+   */
+  bool IsReady();
+
+  /**
+   * Reads the feedback of an earlier frame, requests its missing pages,
+   * commits the loaded ones and updates the page table
+   * Must be called once per frame, before the geometry pass
+   */
+  void Update();
+
+  /**
+   * Binds the texture and the page table to a texture unit and the next one,
+   * binds the feedback buffer of the frame and sets the uniforms of the
+   * geometry pass (see GetDefines)
+   */
+  void Bind(ShaderProgram* shader, int unit);
+
+  /**
+   * Obtains the pages committed besides the mip tails
+   */
+  int GetResidentPages();
+
+  /**
+   * Checks if pages or mip tails are still loading or uploading, so the
+   * next frames can sample finer levels than the last one
+   */
+  bool IsStreaming();
+
+private:
+  // Residency of a page
+  enum PageState { ABSENT, LOADING, UPLOADING, RESIDENT };
+
+  // Page of a level of a layer, by index (see GetPage)
+  struct Page {
+    PageState state;
+    int last_request;  // frame
+    uint64_t ticket;   // of the upload
+  };
+
+  // Page read by a worker; the mip tail of the layer without page
+  struct LoadedPage {
+    int page;  // -1 for the tail
+    int layer;
+    std::vector<std::vector<unsigned char>> levels;
+  };
+
+  /**
+   * Obtains the index of a page of a sparse level, by its position in pages,
+   * which wraps around
+   */
+  int GetPage(int layer, int level, int x, int y);
+
+  /**
+   * Splits the index of a page into its layer, level and position in pages
+   */
+  void GetPageCoords(int page, int* layer, int* level, int* x, int* y);
+
+  /**
+   * Reads a page, or the mip tail of a layer, from its file; runs on the
+   * workers
+   */
+  LoadedPage LoadPage(int page, int layer);
+
+  /**
+   * Loads the requested pages on a worker thread until the texture stops
+   */
+  void RunWorker();
+
+  /**
+   * Fences the feedback of the last frame, and collects the pages asked for
+   * by the oldest one the gpu finished
+   */
+  void ReadFeedback(std::vector<int>* requested);
+
+  /**
+   * Marks a page and the ones under it at the coarser levels as requested,
+   * with their neighbors, which its bilinear footprint may reach, and
+   * queues the ones that aren't loaded, the coarsest first
+   */
+  void RequestPage(int page);
+
+  /**
+   * Commits the pages loaded by the workers and queues their copies,
+   * releasing the least recently requested pages over the budget
+   */
+  void CommitLoadedPages();
+
+  /**
+   * Releases the least recently requested page not asked in the last
+   * frames; returns false if there is none
+   */
+  bool ReleasePage();
+
+  /**
+   * Marks the pages whose copies are done as resident, and writes the page
+   * table if any changed
+   */
+  void UpdatePageTable();
+
+  int size_;
+  int max_pages_;
+  int page_width_;   // texels
+  int page_height_;
+  int n_levels_;
+  int n_sparse_levels_;
+  int n_layers_;
+  int pages_x_;      // of the first level
+  int pages_y_;
+  int layer_pages_;  // of the sparse levels of a layer
+  std::vector<std::string> files_;            // of each layer
+  std::vector<std::vector<uint64_t>> offsets_;  // of each level of the files
+  std::vector<int> level_pages_;  // index of the first page of each level
+  unsigned int texture_;
+  unsigned int page_table_;
+  UploadQueue* queue_;
+  std::vector<Page> pages_;
+  std::vector<uint64_t> tail_tickets_;  // of each layer, 0 while loading
+  int n_resident_;
+  int n_loading_;
+  bool table_changed_;
+  int frame_;
+
+  // Feedback, a slot of the buffer per frame in flight
+  unsigned int feedback_buffer_;
+  uint32_t* feedback_;
+  size_t slot_size_;  // bytes
+  std::vector<void*> fences_;  // of each slot
+  int slot_;
+  bool writing_;  // if the frame writes its slot
+
+  // Pages to load, and pages loaded, shared with the workers
+  std::vector<std::thread> workers_;
+  std::mutex mutex_;
+  std::condition_variable requests_ready_;
+  std::deque<int> requests_;  // pages, -1 - layer for tails
+  std::vector<LoadedPage> loaded_;
+  bool stopping_;
+};
+
+#endif
@@ -0,0 +1,128 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <string>
+
+#include "GLCheck.h"
+#include "GLState.h"
+#include "GpuMemory.h"
+#include "VolumetricFog.h"
+
+namespace {
+
+// Threads per side of the work groups of the shaders
+const int GROUP_SIZE = 4;
+const int COLUMN_GROUP_SIZE = 8;
+
+// Format of the volumes
+const int FORMAT = GL_RGBA16F;
+
+// Distances of the first and the last depth slices
+const float NEAR = 1.0f;
+const float FAR = 100.0f;
+
+}  // namespace
+
+VolumetricFog::VolumetricFog()
+    : grid_(0), scattering_(0), integrated_(0), sampler_(0),
+      allocated_bytes_(0) {}
+
+VolumetricFog::~VolumetricFog() {
+  if (scattering_) {
+    unsigned int textures[] = {scattering_, integrated_};
+    GLState::DeleteTextures(2, textures);
+  }
+  if (sampler_)
+    glDeleteSamplers(1, &sampler_);
+  GpuMemory::Free(GpuMemory::RENDER_TARGETS, allocated_bytes_);
+}
+
+void VolumetricFog::Init(const glm::ivec3& grid,
+                         const std::string& lighting_code) {
+  grid_ = grid;
+  unsigned int textures[2];
+  glCreateTextures(GL_TEXTURE_3D, 2, textures);
+  for (auto texture : textures)
+    glTextureStorage3D(texture, 1, FORMAT, grid.x, grid.y, grid.z);
+  scattering_ = textures[0];
+  integrated_ = textures[1];
+  allocated_bytes_ =
+      2L * grid.x * grid.y * grid.z * GpuMemory::GetFormatSize(FORMAT);
+  GpuMemory::Allocate(GpuMemory::RENDER_TARGETS, allocated_bytes_);
+
+  // The pixels past the last slice keep its fog
+  glCreateSamplers(1, &sampler_);
+  glSamplerParameteri(sampler_, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glSamplerParameteri(sampler_, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glSamplerParameteri(sampler_, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glSamplerParameteri(sampler_, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glSamplerParameteri(sampler_, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+
+  auto header = ShaderProgram::GenerateDefines(
+      {{"GROUP_SIZE", std::to_string(GROUP_SIZE)}, {"INJECT", ""}});
+  inject_shader_.LoadComputeShader("shaders/fog_cs.glsl",
+                                   header + lighting_code);
+  inject_shader_.LinkShader();
+  header = ShaderProgram::GenerateDefines(
+      {{"GROUP_SIZE", std::to_string(COLUMN_GROUP_SIZE)}, {"INTEGRATE", ""}});
+  integrate_shader_.LoadComputeShader("shaders/fog_cs.glsl", header);
+  integrate_shader_.LinkShader();
+}
+
+void VolumetricFog::Compute(const glm::mat4& projection, float density,
+                            LightClusters* clusters) {
+  inject_shader_.Enable();
+  clusters->Bind(&inject_shader_);
+  SetUniforms(&inject_shader_);
+  inject_shader_.SetUniform("inv_projection", glm::inverse(projection));
+  inject_shader_.SetUniform("density", density);
+  glBindImageTexture(0, scattering_, 0, GL_TRUE, 0, GL_WRITE_ONLY, FORMAT);
+  inject_shader_.SetUniform("scattering_image", 0);
+  glDispatchCompute((grid_.x + GROUP_SIZE - 1) / GROUP_SIZE,
+                    (grid_.y + GROUP_SIZE - 1) / GROUP_SIZE,
+                    (grid_.z + GROUP_SIZE - 1) / GROUP_SIZE);
+  glMemoryBarrier(GL_SHADER_IMAGE_ACCESS_BARRIER_BIT);
+
+  integrate_shader_.Enable();
+  SetUniforms(&integrate_shader_);
+  integrate_shader_.SetUniform("inv_projection", glm::inverse(projection));
+  glBindImageTexture(0, scattering_, 0, GL_TRUE, 0, GL_READ_ONLY, FORMAT);
+  glBindImageTexture(1, integrated_, 0, GL_TRUE, 0, GL_WRITE_ONLY, FORMAT);
+  integrate_shader_.SetUniform("scattering_image", 0);
+  integrate_shader_.SetUniform("integrated_image", 1);
+  glDispatchCompute((grid_.x + COLUMN_GROUP_SIZE - 1) / COLUMN_GROUP_SIZE,
+                    (grid_.y + COLUMN_GROUP_SIZE - 1) / COLUMN_GROUP_SIZE, 1);
+  glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+}
+
+void VolumetricFog::Bind(ShaderProgram* shader, int unit) {
+  GLState::BindTexture(unit, integrated_);
+  GLState::BindSamplers(unit, 1, &sampler_);
+  SetUniforms(shader);
+}
+
+void VolumetricFog::SetUniforms(ShaderProgram* shader) {
+  shader->SetUniform("fog_grid", grid_);
+  shader->SetUniform("fog_depth_range", glm::vec2(NEAR, FAR));
+}
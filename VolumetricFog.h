@@ -0,0 +1,98 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef VOLUMETRICFOG_H
+#define VOLUMETRICFOG_H
+
+#include <string>
+
+#include <glm/glm.hpp>
+
+#include "LightClusters.h"
+#include "ShaderProgram.h"
+
+/**
+ * Light scattered by a uniform fog, in a froxel volume of the view frustum
+ *
+ * The volume splits the frustum like the light clusters, in screen tiles and
+ * exponential depth slices, at its own resolution. A first compute pass
+ * injects into each froxel the light scattered toward the eye at its center,
+ * from the ambient light and from the lights of its cluster, so the spot
+ * lights with shadows draw their cones through the fog. A second pass then
+ * integrates each column from the eye, storing in every froxel the light
+ * scattered up to its far side and the transmittance (see
+ * shaders/fog_cs.glsl). The lighting pass applies the froxel of each pixel,
+ * filtered (see shaders/fog.glsl). The cost only depends on the resolution of
+ * the volume.
+ */
+class VolumetricFog {
+public:
+  /**
+   * Default constructor
+   */
+  VolumetricFog();
+
+  /**
+   * Destructor
+   */
+  ~VolumetricFog();
+
+  /**
+   * Creates the volumes, of a number of froxels in x, y and depth, and the
+   * shaders; the injection reads the lights with the code of the G-buffer
+   * (see GBufferLayout) and the shading defines
+   * Throws runtime_error if a shader doesn't compile
+   */
+  void Init(const glm::ivec3& grid, const std::string& lighting_code);
+
+  /**
+   * Computes the fog of a density (extinction per world unit) for the
+   * projection, with the lights of the clusters; the lights must be bound
+   */
+  void Compute(const glm::mat4& projection, float density,
+               LightClusters* clusters);
+
+  /**
+   * Binds the integrated volume to a texture unit and sets the uniforms of
+   * a shader that applies it
+   */
+  void Bind(ShaderProgram* shader, int unit);
+
+private:
+  /**
+   * Sets the grid uniforms of a shader
+   */
+  void SetUniforms(ShaderProgram* shader);
+
+  ShaderProgram inject_shader_;
+  ShaderProgram integrate_shader_;
+  glm::ivec3 grid_;
+  unsigned int scattering_;  // in-scattered light and extinction
+  unsigned int integrated_;  // light scattered up to each froxel, and
+                             // transmittance
+  unsigned int sampler_;
+  long allocated_bytes_;
+};
+
+#endif
@@ -0,0 +1,125 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+#include "WorldPartition.h"
+
+namespace {
+
+// Share of the radius past it that a resident cell stays loaded
+const float UNLOAD_MARGIN = 0.25f;
+
+}  // namespace
+
+WorldPartition::WorldPartition() : cell_size_(1), max_resident_(0) {}
+
+void WorldPartition::Init(const std::vector<glm::vec3>& positions,
+                          float cell_size, int max_resident) {
+  cell_size_ = cell_size;
+  max_resident_ = max_resident;
+  for (int i = 0; i < (int)positions.size(); ++i) {
+    glm::ivec2 coords(std::floor(positions[i].x / cell_size),
+                      std::floor(positions[i].z / cell_size));
+    auto inserted = cell_indices_.insert({GetKey(coords), cells_.size()});
+    if (inserted.second)
+      cells_.push_back({coords, {}, false});
+    cells_[inserted.first->second].items.push_back(i);
+  }
+}
+
+void WorldPartition::Update(const glm::vec3& point, float radius,
+                            int max_loads) {
+  loads_.clear();
+  unloads_.clear();
+
+  // The resident cells past the margin unload, the others stay, farthest
+  // first
+  std::vector<std::pair<float, int>> kept;
+  for (int cell : resident_) {
+    float distance = GetDistance(cells_[cell], point);
+    if (distance > radius * (1 + UNLOAD_MARGIN))
+      unloads_.push_back(cell);
+    else
+      kept.push_back({distance, cell});
+  }
+  std::sort(kept.begin(), kept.end(),
+            [](const std::pair<float, int>& a, const std::pair<float, int>& b) {
+              return a.first > b.first;
+            });
+
+  // The cells within the radius that aren't resident, nearest first
+  std::vector<std::pair<float, int>> wanted;
+  int reach = std::ceil(radius / cell_size_);
+  glm::ivec2 center(std::floor(point.x / cell_size_),
+                    std::floor(point.z / cell_size_));
+  for (int x = center.x - reach; x <= center.x + reach; ++x) {
+    for (int z = center.y - reach; z <= center.y + reach; ++z) {
+      auto found = cell_indices_.find(GetKey(glm::ivec2(x, z)));
+      if (found == cell_indices_.end() || cells_[found->second].resident)
+        continue;
+      float distance = GetDistance(cells_[found->second], point);
+      if (distance <= radius)
+        wanted.push_back({distance, found->second});
+    }
+  }
+  std::sort(wanted.begin(), wanted.end());
+  if ((int)wanted.size() > max_loads)
+    wanted.resize(max_loads);
+
+  // Over the budget, a kept cell farther than the farthest wanted one makes
+  // room for it, else that wanted cell waits
+  size_t n_kept = kept.size(), n_evicted = 0;
+  while (!wanted.empty() &&
+         (int)(n_kept - n_evicted + wanted.size()) > max_resident_) {
+    if (n_evicted < n_kept && kept[n_evicted].first > wanted.back().first)
+      unloads_.push_back(kept[n_evicted++].second);
+    else
+      wanted.pop_back();
+  }
+
+  for (int cell : unloads_)
+    cells_[cell].resident = false;
+  resident_.clear();
+  for (size_t i = n_evicted; i < n_kept; ++i)
+    resident_.push_back(kept[i].second);
+  for (auto& cell : wanted) {
+    cells_[cell.second].resident = true;
+    loads_.push_back(cell.second);
+    resident_.push_back(cell.second);
+  }
+}
+
+float WorldPartition::GetDistance(const Cell& cell,
+                                  const glm::vec3& point) const {
+  glm::vec2 low = glm::vec2(cell.coords) * cell_size_;
+  glm::vec2 p(point.x, point.z);
+  return glm::length(p - glm::clamp(p, low, low + cell_size_));
+}
+
+long long WorldPartition::GetKey(const glm::ivec2& coords) {
+  return (long long)coords.x << 32 | (unsigned int)coords.y;
+}
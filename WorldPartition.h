@@ -0,0 +1,111 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef WORLDPARTITION_H
+#define WORLDPARTITION_H
+
+#include <unordered_map>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+/**
+ * Square cells of the ground plane that the items of a world fall in, with
+ * the cells near a point resident and the others not
+ *
+ * The items are only indices to the positions given: the partition decides
+ * which cells to load and unload, and the caller does it. Update() only
+ * touches the cpu, so it may run on a worker while the caller draws the
+ * cells resident so far. A cell loads once it's within the radius and
+ * unloads once it's past it by a margin, so a point moving along a border
+ * doesn't load the same cell over and over; past the budget, the farthest
+ * cells stay unloaded.
+ */
+class WorldPartition {
+public:
+  /**
+   * Default constructor
+   */
+  WorldPartition();
+
+  /**
+   * Puts each item in the cell of its position, with cells of a size in x
+   * and z, and at most a budget of them resident
+   */
+  void Init(const std::vector<glm::vec3>& positions, float cell_size,
+            int max_resident);
+
+  /**
+   * Picks the cells to load, at most max_loads of the nearest not resident,
+   * and to unload, for the residency around a point within a radius; the
+   * cells picked become resident or not right away
+   */
+  void Update(const glm::vec3& point, float radius, int max_loads);
+
+  /**
+   * Obtains the cells Update() picked to load and to unload
+   */
+  const std::vector<int>& GetLoads() const { return loads_; }
+  const std::vector<int>& GetUnloads() const { return unloads_; }
+
+  /**
+   * Obtains the items of a cell
+   */
+  const std::vector<int>& GetItems(int cell) const {
+    return cells_[cell].items;
+  }
+
+  /**
+   * Obtains the number of cells with items
+   */
+  int GetCellCount() const { return cells_.size(); }
+
+  /**
+   * Obtains the number of resident cells
+   */
+  int GetResidentCount() const { return resident_.size(); }
+
+private:
+  struct Cell {
+    glm::ivec2 coords;
+    std::vector<int> items;
+    bool resident;
+  };
+
+  // Distance from a point to the square of a cell in x and z, 0 inside
+  float GetDistance(const Cell& cell, const glm::vec3& point) const;
+
+  // Key of the cell at the coordinates
+  static long long GetKey(const glm::ivec2& coords);
+
+  std::vector<Cell> cells_;  // with items, in no order
+  std::unordered_map<long long, int> cell_indices_;  // by key
+  std::vector<int> resident_;
+  float cell_size_;
+  int max_resident_;
+  std::vector<int> loads_;
+  std::vector<int> unloads_;
+};
+
+#endif
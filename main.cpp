@@ -22,67 +22,956 @@
  * SOFTWARE.
  */
 
+#include <algorithm>
+#include <chrono>
 #include <cmath>
 #include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <future>
+#include <random>
+#include <thread>
+#include <utility>
 #include <vector>
 #include <iostream>
 
 #include <glm/gtx/transform.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
 #include <glm/glm.hpp>
-#include <GL/glew.h>
+#include "GLCheck.h"
 #include <GLFW/glfw3.h>
-#include <lodepng.h>
-#include <tiny_obj_loader.h>
 
 #include "ShaderProgram.h"
 #include "UniformBuffer.h"
+#include "MeshArena.h"
 #include "VertexArray.h"
 #include "FrameBuffer.h"
+#include "GBufferLayout.h"
+#include "GBufferDump.h"
+#include "LightClusters.h"
+#include "LightSwarm.h"
+#include "VertexSkinning.h"
+#include "LightTransform.h"
+#include "LightTree.h"
+#include "FastLighting.h"
+#include "NormalEncoding.h"
+#include "RenderGraph.h"
+#include "RenderTargetPool.h"
+#include "ShaderPermutations.h"
+#include "BlockLayout.h"
+#include "BufferBindings.h"
+#include "JobSystem.h"
+#include "ThreadAffinity.h"
+#include "FramePipeline.h"
+#include "FrameTimes.h"
+#include "FrameAllocator.h"
+#include "CameraPath.h"
+#include "CommandList.h"
+#include "GLDevice.h"
+#include "FrameCapture.h"
+#include "RemoteControl.h"
+#include "DynamicResolution.h"
+#include "GpuTimer.h"
+#include "PipelineStats.h"
+#include "MeshBatch.h"
+#include "MeshCache.h"
+#include "MeshOptimizer.h"
+#include "OcclusionQueries.h"
+#include "Impostors.h"
+#include "UploadQueue.h"
+#include "PacketQueue.h"
+#include "ObjLoader.h"
+#include "DepthPyramid.h"
+#include "Bloom.h"
+#include "AmbientOcclusion.h"
+#include "ScreenReflections.h"
+#include "VolumetricFog.h"
+#include "GroundLightCache.h"
+#include "ShadingRateImage.h"
+#include "ShadowAtlas.h"
+#include "ShadowBvh.h"
+#include "SunShadows.h"
+#include "Frustum.h"
+#include "ObjectPicking.h"
+#include "TextureArray.h"
+#include "VirtualTexture.h"
+#include "SceneDescription.h"
+#include "TransformHierarchy.h"
+#include "WorldPartition.h"
+#include "FileWatcher.h"
+#include "GLDebug.h"
+#include "GLState.h"
+#include "GpuMemory.h"
+#include "CpuProfiler.h"
+#include "Telemetry.h"
+#include "StatsPage.h"
+#include "PerformanceHud.h"
+#include "QualityGovernor.h"
 
-// Materials
-enum MaterialID { BEAR_MATERIAL, GROUND_MATERIAL };
+// Materials, the ones of the scene description first and then the ones of
+// the bear file
+enum MaterialID { GROUND_MATERIAL };
 
-// Scene configuration constants
-const int I_OFFSET = 15;
-const int J_OFFSET = 15;
-const int N_LIGHTS_I = 10;
-const int N_LIGHTS_J = 10;
-const int N_LIGHTS = N_LIGHTS_I * N_LIGHTS_J;
+// Size of the layers of the diffuse maps, which the images are resampled to
+const int DIFFUSE_MAP_SIZE = 1024;
 
-// Window size
+// Texture unit of the diffuse maps in the geometry pass, followed by the
+// page table of the virtual maps
+const int DIFFUSE_MAPS_UNIT = 0;
+
+// Texture unit of the light read by the material pass of --light-prepass
+const int PREPASS_LIGHT_UNIT = 1;
+
+// Pages of the virtual diffuse maps committed at most besides their mip
+// tails, 64 KB each with the usual page size
+const int VIRTUAL_TEXTURE_PAGES = 256;
+
+// Model matrices of the ground and of the first bear in the models buffer
+const int GROUND_MODEL = 0;
+const int FIRST_BEAR_MODEL = 1;
+
+// Levels of detail of the bear, each with about half the triangles of the
+// previous one
+const int N_BEAR_LODS = 4;
+
+// Consecutive bears in each box of the occlusion queries
+const int BEARS_PER_BOX = 16;
+
+// Projected radius in pixels below which a bear moves to its next level of
+// detail; each further level starts at 1/sqrt(2) of the previous radius, so
+// the triangles per covered pixel stay about the same
+const float FULL_DETAIL_RADIUS = 160.0f;
+
+// Bytes of the meshes loaded in the background copied to the gpu per frame
+const size_t UPLOAD_BYTES_PER_FRAME = 4 << 20;
+
+// Spacing of the grid of the default scene (--spacing=<distance>)
+float grid_spacing = 15.0f;
+
+// Grid of lights of the default scene, one bear under each light
+// (--lights=<i>x<j>)
+int n_lights_i = 10;
+int n_lights_j = 10;
+
+// Grid of bears of the default scene with the same spacing, the one of the
+// lights if 0 (--bears=<i>x<j>)
+int n_bears_i = 0;
+int n_bears_j = 0;
+
+// Size of the square cells of the world partition, which only keeps the
+// bears of the cells near the camera in the batch, and culls the lights
+// farther than the cells; no partition if 0 (--world-partition=<size>)
+float world_cell_size = 0;
+
+// Distance from the camera the cells load within (--stream-radius=<distance>)
+// and most cells resident at once (--cell-budget=<cells>)
+float stream_radius = 150.0f;
+int cell_budget = 64;
+
+// Most cells loaded per frame, so a jump of the camera spreads the cost
+const int MAX_CELL_LOADS_PER_FRAME = 4;
+
+// Height and half size of the ground of the default scene
+const float GROUND_HEIGHT = -0.1f;
+const float GROUND_HALF_SIZE = 100.0f;
+
+// Color of the pixels without geometry, as in shaders/lighting.glsl
+const glm::vec3 BACKGROUND_COLOR(0.1f, 0.1f, 0.1f);
+
+// Stencil bit of the G-buffer pixels covered by geometry; the light volumes
+// count in the other bits
+const int GEOMETRY_STENCIL_BIT = 0x80;
+
+// Projection configuration
+const float FOVY = 60.0f;
+const float Z_NEAR = 1.5f;
+const float Z_FAR = 300.0f;
+
+// Window size (--window=<width>x<height>)
 int window_w = 1280;
 int window_h = 720;
 
+// G-buffer attachments and packing (--gbuffer=<layout>)
+GBufferLayout gbuffer_layout;
+
+// If true, the 32 bits float attachments use 16 bits floats (--half-float)
+bool half_float = false;
+
+// If true, the G-buffer precision is printed at startup (--gbuffer-report)
+bool gbuffer_report = false;
+
+// If true, the gpu memory allocated is printed after the first frame and at
+// exit (--memory-report)
+bool memory_report = false;
+
+// If true, the uploads of every buffer are printed with the fps
+// (--upload-stats)
+bool upload_stats = false;
+
+// If true, the gpu time of every pass is printed with the fps (--gpu-times)
+bool gpu_times = false;
+
+// If true, the heap allocations of the render thread per frame and the use of
+// the frame allocator are printed with the fps (--allocation-stats)
+bool allocation_stats = false;
+
+// If true, the vertices, primitives and fragments of every pass, and the
+// overdraw of the geometry pass, are printed with the fps (--pipeline-stats)
+bool pipeline_stats_report = false;
+
+// If true, the percentiles of the frame times are printed with the fps, and
+// every frame is written to the CSV file if not empty
+// (--frame-times[=<file>])
+bool frame_times_report = false;
+std::string frame_times_path;
+
+// Period in milliseconds of the samples of the gpu clock, power and
+// temperature and of the cpu power, written with the frame times and the
+// benchmark results; none if 0 (--telemetry[=<ms>])
+int telemetry_period = 0;
+const int DEFAULT_TELEMETRY_PERIOD = 100;
+
+// Memory mapped file where the stats of every frame are published for the
+// tools of other processes, none if empty (--stats-page=<file>)
+std::string stats_page_path;
+
+// File where the inputs of the lighting pass of the first complete frame are
+// written, for tools/lightbench to replay them, none if empty; the
+// application exits once it's written (--dump-gbuffer=<file>)
+std::string gbuffer_dump_path;
+bool gbuffer_dumped = false;
+
+// If true, the shaders are rebuilt when their files change (--hot-reload)
+bool hot_reload = false;
+
+// File of the lighting pass permutations built at startup and written with
+// the ones used at exit (--shader-warm-up=<file>)
+std::string shader_warm_up;
+
+// Directory where the imported meshes are kept once optimized, none if empty
+// (--mesh-cache=<dir>)
+std::string mesh_cache;
+
+// If true, the lighting pass shows the view-space normals (key N), or a
+// heatmap of the lights it evaluates per pixel (key L), instead of the
+// lighting; their permutations are built in the background the first time
+bool debug_normals = false;
+bool debug_light_count = false;
+
+// If true, the overlay of the performance statistics is drawn (key F1)
+bool hud_visible = false;
+
+// If true, the rotation of the lights is stopped (key P, --paused)
+bool paused = false;
+
+// If true, a frame is only rendered when something may have changed since
+// the presented one, and the loop otherwise blocks on the window events
+// (--on-demand)
+bool on_demand = false;
+
+// Frames still rendered on demand after the last change, for the effects
+// that show a few frames later (the virtual texture feedback, the frames in
+// flight)
+int settle_frames = 0;
+const int ON_DEMAND_SETTLE_FRAMES = 4;
+
+// Seconds between the checks of the shader files while idling on demand
+const double HOT_RELOAD_POLL_SECONDS = 0.1;
+
+// If true, the light transform shader is loaded from the SPIR-V built by
+// `make spirv` (--spirv)
+bool spirv = false;
+
+// If true, the spot lights are moved to view space and culled on the cpu,
+// with SSE2, and the visible ones uploaded instead of running the transform
+// shader (--cpu-light-culling)
+bool cpu_light_culling = false;
+
+// If true, the context is a 4.5 core profile instead of a compatibility one
+// (--core-profile)
+bool core_profile = false;
+
+// If true, the diffuse maps are streamed by pages into a sparse texture as
+// the frames sample them (--virtual-textures)
+bool virtual_textures = false;
+
+// If true, each diffuse map is a texture of its own size that the shaders
+// read through its bindless handle (--bindless-textures)
+bool bindless_maps = false;
+
+// Scene description file loaded instead of the default scene, if not empty
+// (--scene=<file>)
+std::string scene_path;
+
+// File where the scene is written in the binary form before exiting, if not
+// empty (--write-scene=<file>)
+std::string write_scene_path;
+
+// How the lights are applied to the G-buffer (--lighting=<mode>)
+enum LightingMode {
+  LIGHTING_FULLSCREEN,
+  LIGHTING_TILED,
+  LIGHTING_CLUSTERED,
+  LIGHTING_VOLUMES,
+  LIGHTING_STOCHASTIC,
+  LIGHTING_LIGHTCUTS
+};
+LightingMode lighting_mode = LIGHTING_FULLSCREEN;
+
+// Spot lights sampled per pixel from the light tree by the stochastic
+// lighting (--light-samples=<n>)
+int light_samples = 4;
+
+// Fraction of the estimate of a pixel that the error of each node of its
+// cut of the light tree may reach (--light-cut-error=<fraction>)
+float light_cut_error = 0.02f;
+
+// If true, the light loops replace pow and the normalizations by cheaper
+// fits (--fast-lighting)
+bool fast_lighting = false;
+
+// If true, the lighting pass computes the reflection of each light in 16-bit
+// floats (--half-lighting); half_lighting_define is the definition of the
+// extension that provides them, empty if unsupported
+bool half_lighting = false;
+std::string half_lighting_define;
+
+// If true, the full-screen and the clustered lighting are compute dispatches
+// that store into the lit image, like the tiled lighting
+// (--compute-lighting)
+bool compute_lighting = false;
+
+// Size in pixels of the tiles of the tiled and the compute lighting
+const int TILE_SIZE = 16;
+
+// Clusters in x, y and depth of the clustered lighting
+const glm::ivec3 CLUSTER_GRID(16, 9, 24);
+
+// Extinction per world unit of the fog lit by the lights of the clusters, 0
+// disables it (--fog[=<density>], requires --lighting=clustered), and its
+// froxels in x, y and depth
+const float DEFAULT_FOG_DENSITY = 0.01f;
+float fog_density = 0.0f;
+const glm::ivec3 FOG_GRID(160, 90, 64);
+
+// Segments of the cones of the light volumes
+const int CONE_SEGMENTS = 16;
+
+// Distance where the lights of the default scene fade out
+// (--light-range=<distance>)
+float light_range = 20.0f;
+
+// Radius in pixels of the bounds of a spot light on the screen below which
+// it's shaded diffuse only, none if 0 (--light-lod[=<pixels>])
+const float DEFAULT_LIGHT_LOD_RADIUS = 16.0f;
+float light_lod_radius = 0.0f;
+
+// Point lights simulated on the gpu over the ground, none if 0
+// (--light-swarm=<count>)
+int light_swarm_size = 0;
+
+// Spot lights kept per cluster at most, the most significant ones, the
+// others folded into its ambient term; none if 0
+// (--cluster-light-budget=<lights>)
+const int MAX_CLUSTER_LIGHT_BUDGET = 64;
+int cluster_light_budget = 0;
+const int MAX_SWARM_LIGHTS = 1 << 20;
+
+// If true, the clusters find the point lights in a BVH rebuilt every frame
+// (--light-bvh, requires --light-swarm and --lighting=clustered)
+bool light_bvh = false;
+
+// Samples of the G-buffer, 0 disables the antialiasing (--msaa=<samples>)
+int msaa_samples = 0;
+
+// If true, the lighting accumulates into a float target that a tone mapping
+// pass scales by the exposure and maps to the backbuffer
+// (--hdr, --exposure=<scale>)
+bool hdr = false;
+float exposure = 1.0f;
+
+// If true, the ambient light is occluded by the geometry around each pixel,
+// computed at half resolution from the G-buffer (--ssao)
+bool ssao = false;
+
+// If true, the lit image is kept and reused while the G-buffer and the
+// lights stay the same, and shaded again only where lights were turned on or
+// off (--lighting-cache)
+bool lighting_cache = false;
+
+// If true, the ground takes the diffuse light of the spot lights from a
+// texture, shaded again only where and when they change (--ground-cache)
+bool ground_cache = false;
+
+// If true, the glossy surfaces reflect the lit image of the last frame,
+// traced at half resolution through the depth (--reflections)
+bool reflections = false;
+
+// Weight of the glow of the bright parts in the tone mapped color, 0 disables
+// it (--bloom[=<strength>], requires --hdr)
+const float DEFAULT_BLOOM_STRENGTH = 0.05f;
+const int BLOOM_LEVELS = 6;
+float bloom_strength = 0.0f;
+
+// Search steps along the edges of the FXAA pass that antialiases the lit
+// image, 0 disables it (--fxaa[=<low|high>])
+const int FXAA_LOW_STEPS = 5;
+const int FXAA_HIGH_STEPS = 12;
+int fxaa_steps = 0;
+
+// If true, the projection is jittered by a sub-pixel offset that changes
+// every frame and the lit image is blended with the reprojected history
+// of the last frames (--taa)
+bool taa = false;
+
+// Jitter offsets cycled through by the temporal antialiasing at full
+// resolution, and weight of the history in the blend
+const int TAA_SAMPLES = 8;
+const float TAA_HISTORY_WEIGHT = 0.9f;
+
+// Resolution of the G-buffer and the lighting relative to the window, which
+// the temporal antialiasing upscales (--render-scale=<scale>)
+float render_scale = 1.0f;
+
+// Distance between the eyes of the stereo rendering, side by side in the
+// window, or zero without it (--stereo[=<distance>])
+const float DEFAULT_EYE_DISTANCE = 0.3f;
+float eye_distance = 0;
+
+// If true, every camera of the scene is drawn at once, in tiles of the window
+// (--camera-wall)
+bool camera_wall = false;
+
+// Transforms from the view of the camera to the clip space of each view the
+// geometry pass draws in the same calls, the eyes of --stereo or the cameras
+// of --camera-wall, in tiles of the G-buffer from the bottom left; streamed
+// with their inverses to ViewsBlock. The G-buffer, the lights and the culling
+// stay in the view of the camera, so the views share them.
+std::vector<glm::mat4> view_to_clips;
+UniformBuffer views;
+
+// If true, the full-screen lighting shades the planar tiles of the G-buffer
+// at a coarse rate with a shading rate image
+// (--shading-rate[=<2x2|4x4>])
+bool shading_rate = false;
+ShadingRateImage::CoarseRate coarse_shading_rate = ShadingRateImage::RATE_2X2;
+
+// Shadow maps of the spot lights rendered per frame at most, the others are
+// cached; 0 disables the shadows (--spot-shadows[=<budget>])
+const int DEFAULT_SHADOW_BUDGET = 8;
+const int SHADOW_ATLAS_SIZE = 4096;
+int shadow_budget = 0;
+
+// If true, the spot lights are shadowed by a ray per pixel toward them
+// through a hierarchy of the bears instead of maps (--ray-traced-shadows)
+bool ray_traced_shadows = false;
+
+// Frames between two renders of each far cascade of the shadows of the sun,
+// the nearest one is rendered every frame; 0 disables the sun
+// (--sun[=<period>])
+const int DEFAULT_SUN_PERIOD = 4;
+const int SUN_CASCADES = 4;
+const int SUN_SHADOW_SIZE = 2048;
+const float SUN_SHADOW_DISTANCE = 200.0f;
+const glm::vec3 SUN_DIRECTION = glm::vec3(0.4f, 1.0f, 0.3f);
+const glm::vec3 SUN_DIFFUSE = glm::vec3(0.5f, 0.47f, 0.4f);
+const float SUN_SPECULAR = 0.4f;
+int sun_period = 0;
+
+// Deferred decals scattered over the ground, blended into the normals and the
+// albedo of the G-buffer before the lighting (--decals[=<count>])
+const int DEFAULT_DECALS = 256;
+const glm::vec3 DECAL_HALF_SIZE(2.5f, 1.0f, 2.5f);
+int n_decals = 0;
+
+// Transparent spheres floating over the ground, shaded forward after the
+// lighting with the lights of the clusters (--transparent[=<count>])
+const int DEFAULT_TRANSPARENT = 64;
+const float TRANSPARENT_RADIUS = 1.5f;
+int n_transparent = 0;
+
+// If true, the transparent spheres are drawn instanced from a uniform block,
+// in batches of as many as one holds on the device, instead of one draw each
+// (--instanced-transparent)
+bool instanced_transparent = false;
+int transparent_batch = 0;  // spheres per batch, see LoadShaders()
+
+// If true, the transparent spheres are blended in any order, weighted by
+// their depth, into targets of a fraction of the size of the light buffer,
+// which are then composited over it (--weighted-transparency)
+bool weighted_transparency = false;
+const float WEIGHTED_TRANSPARENCY_SCALE = 0.5f;
+
+// Rings and segments of the sphere of the transparent objects
+const int SPHERE_RINGS = 12;
+const int SPHERE_SEGMENTS = 24;
+
+// If true, the geometry pass only stores the triangle of each pixel in a
+// visibility buffer, and a resolve pass writes the G-buffer from the meshes
+// once per pixel (--visibility-buffer)
+bool visibility_buffer = false;
+
+// If true, the lighting pass only accumulates the light of each pixel, and a
+// second geometry pass applies the materials to it, so the G-buffer is thin
+// (--light-prepass)
+bool light_prepass = false;
+
+// If true, the geometry is drawn again after the geometry pass to count its
+// fragments and the lanes of their 2x2 quads, shown as a heatmap over the
+// output; key O switches between the two (--overdraw)
+bool overdraw = false;
+bool show_quad_overdraw = false;
+
+// If true, the geometry pass also writes the model and the material of each
+// pixel to a target of the G-buffer, and the right button picks the object
+// under the cursor from it a few frames later (--picking)
+bool picking = false;
+ObjectPicking object_picking;
+
+// If true, the depth of the visible instances is drawn before the geometry
+// pass, which then only shades the fragments that passed (--depth-prepass)
+bool depth_prepass = false;
+
+// If true, the instances are sorted front to back before the early culling,
+// so the early depth test rejects more of the geometry pass without a
+// pre-pass (--sort-instances)
+bool sort_instances = false;
+
+// If true, the models buffer stores each instance as its translation, scale
+// and rotation quaternion, and the shaders rebuild its matrix from them
+// (--compact-models)
+bool compact_models = false;
+
+// If true, the geometry pass fetches the vertices from the storage buffer of
+// their batch by gl_VertexID instead of through the attributes of its vertex
+// array (--vertex-pulling)
+bool vertex_pulling = false;
+
+// Poses the bears take in turn, skinned each frame on the gpu by the
+// pre-pass of VertexSkinning before every pass reads them, none if 0
+// (--skinning[=<poses>])
+int skinning_poses = 0;
+const int DEFAULT_SKINNING_POSES = 8;
+
+// Model of --compact-models, as CompactModel of shaders/models.glsl
+struct CompactModel {
+  glm::vec4 position_scale;
+  glm::vec4 rotation;
+};
+
+typedef BlockLayout<glm::vec4, glm::vec4> CompactModelLayout;
+CHECK_BLOCK_MEMBER(CompactModel, CompactModelLayout, 0, position_scale);
+CHECK_BLOCK_MEMBER(CompactModel, CompactModelLayout, 1, rotation);
+CHECK_BLOCK_STRIDE(CompactModel, CompactModelLayout, Std430Stride);
+
+// If true, the early pass culls the boxes of bears hidden by the last frame
+// from occlusion queries instead of the depth pyramid, without a late pass
+// (--occlusion-queries)
+bool occlusion_queries = false;
+
+// Distance from the eye beyond which the bears are drawn as impostors baked
+// once they load, none if 0 (--impostors=<distance>)
+float impostor_distance = 0;
+
+// If true, the full-screen lighting renders into the G-buffer and reads it
+// back with framebuffer fetch, so a tiled gpu keeps the G-buffer in tile
+// memory from the geometry pass to the lighting (--framebuffer-fetch)
+bool framebuffer_fetch = false;
+
+// Resolution of the full-screen lighting relative to the G-buffer; below one
+// it's upsampled guided by the G-buffer (--lighting-scale=<scale>)
+float lighting_scale = 1.0f;
+
+// Gpu time in milliseconds of the passes that the internal resolution is
+// scaled to meet, none if 0 (--dynamic-resolution=<ms>)
+float target_gpu_time = 0.0f;
+
+// Lowest scale of the internal resolution; above one half the frame buffers
+// keep their capacity, so scaling never reallocates them
+const float MIN_RESOLUTION_SCALE = 0.6f;
+
+// If true, the shadow budget, the optional passes and the floor of the
+// resolution are lowered in turn to meet the gpu time of
+// --dynamic-resolution, and raised back in reverse (--quality-governor)
+bool quality_governor = false;
+
+// Floors of the resolution scale that the last knob of --quality-governor
+// steps through
+const float GOVERNED_MIN_SCALES[] = {1.0f, 0.8f, MIN_RESOLUTION_SCALE};
+
+// If true, the queued uploads are copied by a loader thread on a shared
+// context instead of a segment per frame (--upload-thread)
+bool upload_thread = false;
+
+// If true, a render thread owns the context and runs the frames, while the
+// main thread polls the window events and queues them to it in packets
+// (--render-thread)
+bool render_thread = false;
+
+// If true, the thread of the context is pinned to a core of its own and
+// raised in priority, and the workers are pinned to the other cores of its
+// NUMA node, or to their every hardware thread with smt
+// (--pin-threads[=smt])
+bool pin_threads = false;
+bool pin_smt_threads = false;
+const int RENDER_THREAD_NICE = -5;
+
+// Window event the main thread queues to the render thread
+struct WindowEvent {
+  enum Type { KEY, BUTTON, MOTION, FRAMEBUFFER_SIZE, REFRESH } type;
+  int key, action;  // or the button, or the framebuffer width and height
+  double x, y;      // of the cursor
+};
+
+// Packets the main thread may queue ahead of the render thread, and how
+// long it waits for events before retrying a packet the full queue refused
+const int WINDOW_EVENT_PACKETS = 16;
+const double WINDOW_EVENT_RETRY_SECONDS = 0.001;
+
+// Events of the render thread: the ones the main thread polled since the
+// last packet it queued, the queue, and the packet replayed each frame, kept
+// for its capacity
+std::vector<WindowEvent> pending_events;
+PacketQueue<std::vector<WindowEvent>, WINDOW_EVENT_PACKETS> window_events;
+std::vector<WindowEvent> replayed_events;
+
+// The framebuffer size and the keys held as the render thread replayed them
+int replayed_framebuffer_w = 0, replayed_framebuffer_h = 0;
+bool replayed_keys[GLFW_KEY_LAST + 1] = {};
+
+// Frames the cpu prepares ahead of the gpu, which is also the number of slots
+// of the streaming buffers and of segments of the upload queue
+// (--frames-in-flight=<n>)
+int frames_in_flight = 2;
+
+// Windows opened: the first one and the others, which share its gl objects
+// and each show a camera of the scene at their own size (--windows=<n>)
+int n_windows = 1;
+
+// How the swaps wait for the vertical blank (--vsync=<on|off|adaptive>); the
+// driver's default if not given
+enum PresentMode { PRESENT_DEFAULT, PRESENT_VSYNC, PRESENT_IMMEDIATE,
+                   PRESENT_ADAPTIVE };
+PresentMode present_mode = PRESENT_DEFAULT;
+
+// Frames per second the loop is limited to, none if 0 (--max-fps=<fps>)
+float max_fps = 0.0f;
+
+// Frames rendered and measured by the benchmark, which runs with a hidden
+// window along a path through the cameras of the scene and exits after
+// writing the results, none if 0 (--benchmark=<frames>)
+int benchmark_frames = 0;
+
+// File the timeline of the cpu zones of every thread and of the gpu passes is
+// written to at exit, as a Chrome trace, none if empty (--trace=<file>)
+std::string trace_path;
+
+// Directory every presented frame is written to, as PNG files, without the
+// hud, none if empty (--capture=<directory>)
+std::string capture_directory;
+
+// File or url the presented frames are streamed to as video by an ffmpeg
+// process, without the hud, none if empty (--stream=<output>)
+std::string stream_output;
+
+// File the poses of the camera are written to at exit, with their times,
+// none if empty (--record-camera=<file>)
+std::string record_camera_path;
+
+// File of the poses the camera follows instead of the presets, and the
+// benchmark along with them, none if empty (--replay-camera=<file>)
+std::string replay_camera_path;
+
+// Tcp port of the server of the live stats and of the remote commands, see
+// RemoteControl, none if 0 (--remote=<port>)
+int remote_port = 0;
+
+// Frame rate of the stream when neither --frame-time nor --max-fps give one
+const float DEFAULT_STREAM_FRAME_RATE = 60.0f;
+
+// File the benchmark results are written to, as JSON
+// (--benchmark-output=<file>)
+std::string benchmark_path = "benchmark.json";
+
+// Frames rendered after the scene finished loading and before the benchmark
+// measures, so the shaders and the caches are warm
+const int BENCHMARK_WARMUP_FRAMES = 60;
+
+// Seconds the simulation advances per frame in the benchmark, unless given
+const double BENCHMARK_FRAME_TIME = 1.0 / 60.0;
+
+// Frames whose times are kept for the percentiles, a few seconds worth; the
+// benchmark keeps all of its frames
+const int FRAME_TIMES_KEPT = 1024;
+
+// Seed of the random colors and rotations, so every run has the same scene
+const unsigned int RANDOM_SEED = 1;
+
+// Time before a frame deadline when the limiter stops sleeping and spins, as
+// the sleeps of the os overshoot by about that much
+const double LIMITER_SPIN_SECONDS = 0.002;
+
+// Seconds the simulation advances by per frame instead of the elapsed ones,
+// so the runs are reproducible, none if 0 (--frame-time=<seconds>)
+double frame_time = 0.0;
+
+// Seconds of a step of the simulation, and steps run at most per frame; the
+// time of slower frames is dropped instead of falling further behind
+const double SIMULATION_STEP = 1.0 / 120.0;
+const int MAX_SIMULATION_STEPS = 12;
+
+// Degrees per second of the rotation of the lights
+const double LIGHTS_ROTATION_SPEED = 10.0;
+
 // Global Helpers
+// Creates the resources of the passes; the gl backend is the only one
+GLDevice gl_device;
+RenderDevice *device = &gl_device;
 ShaderProgram geompass_shader;
-ShaderProgram lightpass_shader;
+ShaderProgram depth_prepass_shader;
+ShaderProgram overdraw_shader;  // counts of --overdraw
+ShaderProgram overdraw_view_shader;  // heatmap of --overdraw
+ShaderProgram visibility_shader;
+ShaderProgram visibility_resolve_shader;
+ShaderProgram materialpass_shader;  // of the light pre-pass
+ShaderProgram shadow_shader;  // of the maps of the spot lights
+ShaderProgram decal_shader;
+ShaderProgram forward_shader;  // of the transparent objects
+ShaderProgram oit_composite_shader;  // with --weighted-transparency
+ShaderProgram screen_quad_shader;  // vertex stage of the full-screen passes
+ShaderPermutations lightpass_shaders;
+ShaderProgram edges_shader;
+ShaderProgram lightpass_compute_shader;  // tiled or --compute-lighting
+LightClusters light_clusters;
+LightTree light_tree;  // with --lighting=stochastic|lightcuts
+LightSwarm light_swarm;  // with --light-swarm
+VertexSkinning vertex_skinning;  // with --skinning
+bool skin_posed = false;  // the skinned vertices moved in this frame
+unsigned int light_seed = 0;  // of the samples of the frame
+ShaderProgram lightvolume_shader;
+ShaderProgram stencil_shader;
+ShaderProgram upsample_shader;
+ShaderProgram fxaa_shader;
+ShaderProgram tonemap_shader;
+ShaderProgram taa_shader;
+ShaderProgram reflections_shader;
+FrameBuffer taa_history;  // resolved image of the last frame
+bool taa_history_valid = false;
+unsigned int linear_sampler;  // of the post-processing passes
+FrameBuffer light_buffer;
+FrameBuffer lighting_cache_buffer;  // lit image kept by --lighting-cache
+FrameBuffer oit_buffer;  // of --weighted-transparency
 UniformBuffer materials;
+UniformBuffer diffuse_handles;  // with --bindless-textures
 UniformBuffer lights;
+LightTransform light_transform;
 FrameBuffer framebuffer;
-VertexArray screen_quad;
-UniformBuffer bear_matrices;
-VertexArray bear_mesh;
-UniformBuffer ground_matrices;
-VertexArray ground_mesh;
+FrameBuffer visibility_framebuffer;  // with --visibility-buffer
+VertexArray screen_triangle;  // attribute-less, see lightpass_vs
+MeshArena shapes;  // light volume cone and transparent sphere
+int cone_mesh;
+int sphere_mesh;
+UniformBuffer camera;
+UniformBuffer models;
+TransformHierarchy transforms;  // of the models, in the same order
+std::vector<CompactModel> compact_transforms;  // with --compact-models
+JobSystem jobs;  // cpu work of the frame that makes no gl calls
+ThreadAffinity thread_affinity;  // with --pin-threads
+FramePipeline frame_pipeline;
+FrameTimes frame_times;  // for --frame-times and --benchmark
+Telemetry telemetry;     // for --telemetry
+StatsPage stats_page;    // for --stats-page
+StatsPage::Stats page_stats;  // published every frame to stats_page
+DynamicResolution dynamic_resolution;  // of the G-buffer and the lighting
+QualityGovernor quality;               // for --quality-governor
+FrameCapture frame_capture;  // with --capture or --stream
+RemoteControl remote;  // with --remote
+GpuTimer gpu_timer;  // of the early culling and the passes, see TimesPasses
+PerformanceHud hud;
+PipelineStats pipeline_stats;  // of the passes, for --pipeline-stats
+JobSystem::Job transforms_update;  // of the current frame, see UpdateMatrices
+std::vector<TransformHierarchy::Range> changed_models;  // by the update
+MeshBatch scene;  // the ground, loaded before the first frame
+MeshBatch bear_batch;  // filled on a worker thread, see LoadBears()
+ShadowBvh shadow_bvh;  // of the bears, with --ray-traced-shadows
+MeshBatch decal_batch;  // boxes of the decals, with --decals
+std::future<void> bear_loading;
+UploadQueue uploads;
+
+// Cells of the bears with --world-partition, updated on a worker, and the
+// instances of the bear draw in each resident cell
+WorldPartition world_partition;
+JobSystem::Job partition_update;  // of the current frame, see Render
+std::vector<std::vector<int>> cell_instances;
+int bear_draw = -1;  // the draw of the bears, with --world-partition
+GLFWwindow *loader_window = nullptr;  // context of the --upload-thread
+
+// Window after the first one, drawn in the first context, whose objects its
+// context shares (--windows)
+struct SecondaryWindow {
+  GLFWwindow *handle;
+  int camera;                // of the scene description
+  FrameBuffer output;        // its backbuffer, in the first context
+  unsigned int framebuffer;  // in its own context, reads the output
+  unsigned int texture;      // attached to the framebuffer
+};
+std::vector<SecondaryWindow> secondary_windows;
+DepthPyramid depth_pyramid;
+OcclusionQueries bear_boxes;  // with --occlusion-queries
+Impostors bear_impostors;  // with --impostors
+ShadingRateImage shading_rates;  // of the lighting, with --shading-rate
+ShadowAtlas shadow_atlas;  // with --spot-shadows
+int shadowed_batches = 0;  // ready when the maps were last updated
+std::vector<int> shadow_updates;  // lights whose maps the frame renders
+SunShadows sun_shadows;  // with --sun
+std::vector<int> sun_updates;  // cascades the frame renders
+UniformBuffer sun;  // SunBlock, with --sun
+Bloom bloom;  // with --bloom
+AmbientOcclusion ambient_occlusion;  // with --ssao
+ScreenReflections screen_reflections;  // with --reflections
+VolumetricFog volumetric_fog;  // with --fog
+GroundLightCache ground_light_cache;  // with --ground-cache
+SceneDescription scene_description;  // instances, lights, cameras
+
+// Transparent objects, with --transparent
+struct TransparentObject {
+  glm::vec3 position;
+  glm::vec4 color;  // opacity in alpha
+};
+std::vector<TransparentObject> transparent_objects;
+// Sphere of a batch of --instanced-transparent, as TransparentInstance of
+// shaders/forward_vs.glsl
+struct TransparentInstance {
+  glm::vec4 center_radius;  // in view space
+  glm::vec4 color;
+};
+typedef BlockLayout<glm::vec4, glm::vec4> TransparentInstanceLayout;
+CHECK_BLOCK_STRIDE(TransparentInstance, TransparentInstanceLayout,
+                   Std140Stride);
+UniformBuffer transparent_instances;  // of the visible spheres, in order
+// Draws of the transparent objects, one list per slice recorded by the jobs
+std::vector<std::unique_ptr<CommandList>> transparent_commands;
+TextureArray diffuse_maps;  // decoded with the bear batch
+VirtualTexture virtual_maps;  // opened instead with --virtual-textures
+RenderTargetPool render_targets;
+RenderGraph render_graph;
+FileWatcher shader_watcher;
+
+// Programs loaded by LoadShaders(), besides the lighting permutations
+std::vector<ShaderProgram *> loaded_programs;
+
+// Passes disabled from the command line
+std::vector<std::string> disabled_passes;
 
 // Global matrices
 glm::mat4 view;
 glm::mat4 projection;
 
-// Lights rotation
+// Projection without the jitter of the temporal antialiasing, the
+// view-projection of the last frame with it, and the frames jittered
+glm::mat4 unjittered_projection;
+glm::mat4 last_view_projection;
+int taa_frame = 0;
+glm::vec2 taa_jitter;  // in G-buffer pixels
+
+// Lights rotation, interpolated between the last two simulation steps
 glm::mat4 rotation;
 
-// Random colors
-glm::vec3 random_colors[N_LIGHTS];
+// State of the simulation after a step; it only changes in steps of
+// SIMULATION_STEP seconds, whatever the frame rate
+struct SimulationState {
+  double lights_angle;  // radians, not wrapped
+};
+SimulationState previous_state = {0.0};
+SimulationState current_state = {0.0};
+double simulation_lag = 0.0;  // seconds elapsed since the current step
+JobSystem::Job simulation_update;  // of the current frame, see Idle()
+
+// Meshes of the ground in the scene batch and of the bear in its batch, from
+// full detail to the coarsest
+int ground_mesh;
+int decal_mesh;
+std::vector<int> bear_lods;
+std::vector<ObjMaterial> bear_materials;  // loaded with the bear batch
+std::vector<int> bear_diffuse_maps;       // layer of each bear material
 
-// Camera config
+// Camera of the scene description in use (key Space)
 int camera_config = 0;
-const int N_CAMERA_CONFIGS = 3;
+
+// Free-fly camera, which takes over from the current one when dragged with
+// the left button or moved with the keys W, A, S and D until Space; its
+// direction, in radians, and the cursor of the drag
+bool fly_camera = false;
+float fly_yaw = 0.0f;
+float fly_pitch = 0.0f;
+bool fly_dragging = false;
+double drag_x = 0.0;
+double drag_y = 0.0;
+
+// Scene units per second the free-fly camera moves, 5 times more with Shift,
+// and radians it turns per pixel dragged
+const float FLY_SPEED = 10.0f;
+const float FLY_SHIFT_FACTOR = 5.0f;
+const float FLY_RADIANS_PER_PIXEL = 0.003f;
+
+// Poses recorded with --record-camera or replayed with --replay-camera, and
+// the seconds of the recording or the replay, which advance as the
+// simulation does
+CameraPath camera_path;
+double camera_time = 0.0;
+
+// Seconds simulated by the light swarm, which advance as the simulation does
+double swarm_time = 0.0;
+
+// Seconds of the poses of --skinning, which advance as the simulation does,
+// and the ones of the skinned vertices
+double skinning_time = 0.0;
+double skinned_time = -1.0;
+
+// Frame of the benchmark being measured, -1 while warming up, and the time
+// it started at
+int benchmark_frame = -1;
+std::chrono::steady_clock::time_point benchmark_begin;
+
+// Arguments of the command line, written with the benchmark results
+std::vector<std::string> command_line;
+
+// Configuration file of each argument after ExpandArguments(), empty for the
+// ones given on the command line
+std::vector<std::string> argument_files;
+
+// Depth of the --config=<file> inside configuration files, which also stops
+// a file that includes itself
+const int MAX_CONFIG_DEPTH = 8;
+bool camera_dirty = true;  // the view or the projection changed
+
+// Inputs of the lit image of --lighting-cache: the version of the G-buffer,
+// raised by whatever may change it or the passes that the lighting reads
+// other than the camera, and the state of the lights
+struct LightingKey {
+  unsigned int gbuffer_version;
+  glm::mat4 view_projection;
+  glm::mat4 rotation;
+  double swarm_time;
+  int n_active_lights;
+};
+unsigned int gbuffer_version = 0;
+LightingKey cached_lighting;  // of the lit image in lighting_cache_buffer
+bool lighting_cached = false;
+glm::mat4 ground_cache_rotation;  // of the lights in the ground cache
+int ground_cache_lights = 0;  // active lights in the ground cache
 glm::vec3 eye;
 glm::vec3 center;
 glm::vec3 up;
 
+// Start of the program and of the startup phase being timed, and the
+// milliseconds of the phases done, printed with the first frame
+std::chrono::steady_clock::time_point startup_begin =
+    std::chrono::steady_clock::now();
+std::chrono::steady_clock::time_point phase_begin = startup_begin;
+std::vector<std::pair<const char *, double>> startup_phases;
+
 // Verifies the condition, if it fails, shows the error message and
 // exits the program
 #define Assert(condition, message) Assertf(condition, message, 0)
@@ -96,13 +985,101 @@ glm::vec3 up;
     }                                                                          \
   }
 
+// Milliseconds elapsed since a time point
+double MillisecondsSince(std::chrono::steady_clock::time_point begin) {
+  using namespace std::chrono;
+  return duration<double, std::milli>(steady_clock::now() - begin).count();
+}
+
+// Ends the startup phase timed since the end of the previous one
+void EndStartupPhase(const char *name) {
+  startup_phases.push_back({name, MillisecondsSince(phase_begin)});
+  phase_begin = std::chrono::steady_clock::now();
+}
+
+// Prints the time of every startup phase and the total until now
+void PrintStartupPhases() {
+  printf("startup:");
+  for (auto &phase : startup_phases)
+    printf(" %s %.1f ms,", phase.first, phase.second);
+  printf(" total %.1f ms\n", MillisecondsSince(startup_begin));
+}
+
+// Returns true if the lighting pass is a compute dispatch that stores into the
+// lit image: the tiled lighting, or the others with --compute-lighting
+bool UsesComputeLighting() {
+  return lighting_mode == LIGHTING_TILED || compute_lighting;
+}
+
+// Returns true if the lighting pass renders into the light buffer, which
+// shares the depth and the stencil of the G-buffer; only the compute
+// lighting, the multisampled G-buffer, the scaled lighting and the
+// framebuffer fetch render elsewhere
+bool UsesLightBuffer() {
+  return !UsesComputeLighting() && !msaa_samples && lighting_scale == 1.0f &&
+         !framebuffer_fetch;
+}
+
+// Obtains the size of the G-buffer, the window scaled by the render scale and
+// the dynamic resolution
+void GetRenderSize(int *width, int *height) {
+  float scale = render_scale * dynamic_resolution.GetScale();
+  *width = std::max(1, (int)(window_w * scale));
+  *height = std::max(1, (int)(window_h * scale));
+}
+
 // Creates the framebuffer used for deferred shading
 void LoadFramebuffer() {
-  // Creates the position, normal and material textures
-  framebuffer.Init(window_w, window_h);
-  framebuffer.AddColorTexture(GL_RGB32F, GL_RGB, GL_FLOAT);
-  framebuffer.AddColorTexture(GL_RGB32F, GL_RGB, GL_FLOAT);
-  framebuffer.AddColorTexture(GL_R8, GL_RED, GL_UNSIGNED_BYTE);
+  // Creates the textures described by the layout; the depth is a texture so
+  // the lighting pass can rebuild the position from it, and the light buffer
+  // also needs the stencil of the pixels with geometry
+  auto depth_mode = UsesLightBuffer() ? FrameBuffer::DEPTH_STENCIL_TEXTURE
+                        : FrameBuffer::DEPTH_TEXTURE;
+  int width, height;
+  GetRenderSize(&width, &height);
+  device->CreateRenderTarget(&framebuffer, "gbuffer", width, height,
+                             depth_mode, msaa_samples);
+  for (auto &attachment : gbuffer_layout.GetAttachments())
+    framebuffer.AddColorTexture(attachment.internal_format,
+                                attachment.base_format, attachment.type);
+
+  // Only the material is needed to tell the background apart and only the
+  // depth needs a clear value; nothing is needed after the lighting pass
+  int n_attachments = gbuffer_layout.GetAttachments().size();
+  for (int i = 0; i < n_attachments; ++i) {
+    bool material = i == gbuffer_layout.GetMaterialAttachment();
+    framebuffer.SetLoadAction(i, material ? FrameBuffer::ACTION_CLEAR
+                                          : FrameBuffer::ACTION_DONT_CARE);
+    framebuffer.SetStoreAction(i, FrameBuffer::ACTION_DONT_CARE);
+  }
+  // With the framebuffer fetch the lit color follows, covering every pixel,
+  // and it's the only attachment stored
+  if (framebuffer_fetch) {
+    if (hdr)
+      framebuffer.AddColorTexture(GL_R11F_G11F_B10F, GL_RGB,
+                                  GL_UNSIGNED_INT_10F_11F_11F_REV);
+    else
+      framebuffer.AddColorTexture(GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE);
+    framebuffer.SetLoadAction(n_attachments, FrameBuffer::ACTION_DONT_CARE);
+  }
+  // The identifiers follow the layout, cleared to the background; they're
+  // only copied from, so the units of the lighting don't move
+  if (picking) {
+    framebuffer.AddColorTexture(GL_RG32UI, GL_RG_INTEGER, GL_UNSIGNED_INT);
+    framebuffer.SetSampled(n_attachments, false);
+    framebuffer.SetLoadAction(n_attachments, FrameBuffer::ACTION_CLEAR);
+    framebuffer.SetStoreAction(n_attachments, FrameBuffer::ACTION_DONT_CARE);
+    object_picking.Init();
+  }
+  // The visibility buffer clears the depth it shares instead
+  framebuffer.SetLoadAction(FrameBuffer::DEPTH_ATTACHMENT,
+                            visibility_buffer ? FrameBuffer::ACTION_PRESERVE
+                                              : FrameBuffer::ACTION_CLEAR);
+  framebuffer.SetStoreAction(FrameBuffer::DEPTH_ATTACHMENT,
+                             FrameBuffer::ACTION_DONT_CARE);
+  printf("G-buffer: %s (%d bytes per pixel, %d samples)\n",
+         gbuffer_layout.GetDescription().c_str(),
+         gbuffer_layout.GetBytesPerPixel(), std::max(msaa_samples, 1));
   try {
     framebuffer.Verify();
   } catch (std::exception &e) {
@@ -110,382 +1087,4305 @@ void LoadFramebuffer() {
   }
 }
 
-// Loads the geometry pass and lighting pass shaders
-void LoadShaders() {
+// Creates the visibility buffer, which writes the depth of the G-buffer; its
+// identifiers are only read by the resolve pass
+void LoadVisibilityBuffer() {
+  device->CreateRenderTarget(&visibility_framebuffer, "visibility",
+                             framebuffer.GetWidth(), framebuffer.GetHeight(),
+                             FrameBuffer::DEPTH_NONE);
+  visibility_framebuffer.AddColorTexture(GL_RG32UI, GL_RG_INTEGER,
+                                         GL_UNSIGNED_INT);
+  visibility_framebuffer.ShareDepth(&framebuffer);
+  visibility_framebuffer.SetLoadAction(0, FrameBuffer::ACTION_DONT_CARE);
+  visibility_framebuffer.SetStoreAction(0, FrameBuffer::ACTION_DONT_CARE);
+  visibility_framebuffer.SetLoadAction(FrameBuffer::DEPTH_ATTACHMENT,
+                                       FrameBuffer::ACTION_CLEAR);
   try {
-    geompass_shader.LoadVertexShader("shaders/geompass_vs.glsl");
-    geompass_shader.LoadFragmentShader("shaders/geompass_fs.glsl");
-    geompass_shader.LinkShader();
-    lightpass_shader.LoadVertexShader("shaders/lightpass_vs.glsl");
-    lightpass_shader.LoadFragmentShader("shaders/lightpass_fs.glsl");
-    lightpass_shader.LinkShader();
+    visibility_framebuffer.Verify();
   } catch (std::exception &e) {
     Assertf(false, "%s", e.what());
   }
 }
 
-// Creates an random number between 0 an 1
-double Random() { return (double)rand() / RAND_MAX; }
-
-// Creates the random colors
-void CreateRandomColors() {
-  for (int i = 0; i < N_LIGHTS; ++i)
-    random_colors[i] = glm::vec3(Random(), Random(), Random());
+// Creates the sampler of the post-processing passes, whose taps between
+// texels are filtered
+void CreateLinearSampler() {
+  glCreateSamplers(1, &linear_sampler);
+  glSamplerParameteri(linear_sampler, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glSamplerParameteri(linear_sampler, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glSamplerParameteri(linear_sampler, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glSamplerParameteri(linear_sampler, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 }
 
-// Loads the materials
-void CreateMaterialsBuffer() {
-  // Buffer configuration
-  // struct Material {
-  //     vec3 diffuse;
-  //     vec3 ambient;
-  //     vec3 specular;
-  //     float shininess;
-  // };
-  //
-  // layout (std140) uniform MaterialsBlock {
-  //     Material materials[8];
-  // };
+// Creates the framebuffer of the resolved image kept for the next frame by
+// the temporal antialiasing
+void LoadTaaHistory() {
+  device->CreateRenderTarget(&taa_history, "taa history", window_w, window_h,
+                             FrameBuffer::DEPTH_NONE);
+  taa_history.AddColorTexture(GL_RGBA16F, GL_RGBA, GL_HALF_FLOAT);
+}
 
-  materials.Init();
+// Obtains the format of the lit image, which the HDR lighting keeps in
+// floats at the same 4 bytes per pixel as RGBA8
+int GetLitFormat() { return hdr ? GL_R11F_G11F_B10F : GL_RGBA8; }
 
-  // BEAR_MATERIAL
-  materials.Add({0.70, 0.70, 0.70});
-  materials.Add({0.50, 0.50, 0.50});
-  materials.Add({0.50, 0.50, 0.50});
-  materials.Add(16.0f);
-  materials.FinishChunk();
+// Obtains the size of the targets of --weighted-transparency for a size of
+// the light buffer
+glm::ivec2 GetOitSize(int width, int height) {
+  return glm::max(glm::ivec2(glm::vec2(width, height) *
+                             WEIGHTED_TRANSPARENCY_SCALE),
+                  glm::ivec2(1));
+}
 
-  // GROUND_MATERIAL
-  materials.Add({0.50, 0.50, 0.50});
-  materials.Add({0.50, 0.50, 0.50});
-  materials.Add({0.20, 0.20, 0.20});
-  materials.Add(16.0f);
-  materials.FinishChunk();
+// Creates the targets of --weighted-transparency, cleared to no color and no
+// coverage by the first pass of the frame and dropped after the composite
+void LoadOitBuffer() {
+  auto size = GetOitSize(framebuffer.GetWidth(), framebuffer.GetHeight());
+  device->CreateRenderTarget(&oit_buffer, "weighted transparency", size.x,
+                             size.y, FrameBuffer::DEPTH_NONE);
+  oit_buffer.AddColorTexture(GL_RGBA16F, GL_RGBA, GL_HALF_FLOAT);
+  oit_buffer.AddColorTexture(GL_R16F, GL_RED, GL_HALF_FLOAT);
+  oit_buffer.SetClearColor(0, 0, 0, 0);
+  for (int i = 0; i < 2; ++i) {
+    oit_buffer.SetLoadAction(i, FrameBuffer::ACTION_CLEAR);
+    oit_buffer.SetStoreAction(i, FrameBuffer::ACTION_DONT_CARE);
+  }
+  try {
+    oit_buffer.Verify();
+  } catch (std::exception &e) {
+    Assertf(false, "%s", e.what());
+  }
+}
 
-  materials.SendToDevice();
+// Creates the framebuffer where the lighting pass is rendered, which stencil
+// tests the pixels with geometry and depth tests the light volumes against
+// the G-buffer; the background is only cleared
+void LoadLightBuffer() {
+  device->CreateRenderTarget(&light_buffer, "lightbuffer",
+                             framebuffer.GetWidth(), framebuffer.GetHeight(),
+                             FrameBuffer::DEPTH_NONE);
+  if (hdr)
+    light_buffer.AddColorTexture(GL_R11F_G11F_B10F, GL_RGB,
+                                 GL_UNSIGNED_INT_10F_11F_11F_REV);
+  else
+    light_buffer.AddColorTexture(GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE);
+  light_buffer.ShareDepth(&framebuffer);
+  light_buffer.SetClearColor(BACKGROUND_COLOR.r, BACKGROUND_COLOR.g,
+                             BACKGROUND_COLOR.b);
+  light_buffer.SetLoadAction(0, FrameBuffer::ACTION_CLEAR);
+  light_buffer.SetStoreAction(0, FrameBuffer::ACTION_DONT_CARE);
+  try {
+    light_buffer.Verify();
+  } catch (std::exception &e) {
+    Assertf(false, "%s", e.what());
+  }
+  if (lighting_cache) {
+    device->CreateRenderTarget(&lighting_cache_buffer, "lighting cache",
+                               framebuffer.GetWidth(), framebuffer.GetHeight(),
+                               FrameBuffer::DEPTH_NONE);
+    if (hdr)
+      lighting_cache_buffer.AddColorTexture(GL_R11F_G11F_B10F, GL_RGB,
+                                            GL_UNSIGNED_INT_10F_11F_11F_REV);
+    else
+      lighting_cache_buffer.AddColorTexture(GL_RGBA8, GL_RGBA,
+                                            GL_UNSIGNED_BYTE);
+  }
 }
 
-// Compute the light translation given the i, j indices
-glm::mat4 ComputeTranslation(int i, int j) {
-  auto x = (i - (N_LIGHTS_I - 1) / 2.0) * I_OFFSET;
-  auto z = (j - (N_LIGHTS_J - 1) / 2.0) * J_OFFSET;
-  return glm::translate(glm::vec3(x, 0, z));
+// Prints the error of the G-buffer values compared to exact fp32 values
+void PrintGBufferPrecision() {
+  auto ratio = (float)window_w / (float)window_h;
+  auto proj = glm::perspective(glm::radians(FOVY), ratio, Z_NEAR, Z_FAR);
+  auto report = gbuffer_layout.ComputePrecision(proj, Z_NEAR, Z_FAR);
+  printf("G-buffer precision (up to the far plane at %.0f):\n", Z_FAR);
+  printf("  position error: mean %.6f max %.6f (%.5f%% of the distance)\n",
+         report.mean_position_error, report.max_position_error,
+         report.max_relative_position_error * 100);
+  printf("  normal error: mean %.5f max %.5f degrees\n",
+         report.mean_normal_error, report.max_normal_error);
 }
 
-// Loads the screen quad
-void LoadScreenQuad() {
-  unsigned int indices[] = {0, 1, 2, 3};
-  float vertices[] = {
-      -1, -1, 0, -1, 1, 0, 1, 1, 0, 1, -1, 0,
-  };
-  float textcoords[] = {0, 0, 0, 1, 1, 1, 1, 0};
-  screen_quad.Init();
-  screen_quad.SetElementArray(indices, 4);
-  screen_quad.AddArray(0, vertices, 12, 3);
-  screen_quad.AddArray(1, textcoords, 8, 2);
+// Obtains the definitions of the full-screen lighting pass for the lighting
+// mode
+ShaderProgram::Defines GetLightpassDefines(bool per_sample) {
+  ShaderProgram::Defines defines;
+  if (lighting_mode == LIGHTING_CLUSTERED)
+    defines["CLUSTERED"] = "";
+  if (cluster_light_budget)
+    defines["CLUSTER_LIGHT_BUDGET"] = std::to_string(cluster_light_budget);
+  if (lighting_mode == LIGHTING_VOLUMES)
+    defines["SPOT_VOLUMES"] = "";
+  if (lighting_mode == LIGHTING_STOCHASTIC ||
+      lighting_mode == LIGHTING_LIGHTCUTS)
+    defines["LIGHT_TREE"] = "";
+  if (lighting_mode == LIGHTING_LIGHTCUTS)
+    defines["LIGHT_CUTS"] = "";
+  if (per_sample)
+    defines["PER_SAMPLE"] = "";
+  if (lighting_scale < 1.0f)
+    defines["SCALED"] = "";
+  if (ssao)
+    defines["AMBIENT_OCCLUSION"] = "";
+  if (shadow_budget)
+    defines["SPOT_SHADOWS"] = "";
+  if (ray_traced_shadows)
+    defines["RAY_TRACED_SHADOWS"] = "";
+  if (fast_lighting)
+    defines["FAST_LIGHTING"] = "";
+  if (!half_lighting_define.empty())
+    defines[half_lighting_define] = "";
+  if (light_prepass)
+    defines["LIGHT_PREPASS"] = "";
+  if (sun_period)
+    defines["SUN_LIGHT"] = "";
+  if (fog_density > 0)
+    defines["FOG"] = "";
+  if (ground_cache) {
+    defines["GROUND_CACHE"] = "";
+    defines["GROUND_MATERIAL"] = std::to_string(GROUND_MATERIAL);
+  }
+  return defines;
 }
 
-// Loads the ground quad
-void LoadGround() {
-  unsigned int indices[] = {0, 1, 2, 3};
-  float h = -0.1;
-  float v = 100;
-  float vertices[] = {-v, h, v, -v, h, -v, v, h, -v, v, h, v};
-  float normals[] = {0, 1, 0, 0, 1, 0, 0, 1, 0, 0, 1, 0};
-  ground_mesh.Init();
-  ground_mesh.SetElementArray(indices, 4);
-  ground_mesh.AddArray(0, vertices, 12, 3);
-  ground_mesh.AddArray(1, normals, 12, 3);
+// Obtains the definitions of the forward and light volume shading
+ShaderProgram::Defines GetShadingDefines() {
+  ShaderProgram::Defines defines;
+  if (shadow_budget)
+    defines["SPOT_SHADOWS"] = "";
+  if (ray_traced_shadows)
+    defines["RAY_TRACED_SHADOWS"] = "";
+  if (fast_lighting)
+    defines["FAST_LIGHTING"] = "";
+  if (sun_period)
+    defines["SUN_LIGHT"] = "";
+  if (cluster_light_budget)
+    defines["CLUSTER_LIGHT_BUDGET"] = std::to_string(cluster_light_budget);
+  return defines;
 }
 
-// Loads a single mesh into the gpu
-void LoadMesh(VertexArray *vao, tinyobj::mesh_t *mesh) {
-  vao->Init();
-  vao->SetElementArray(mesh->indices.data(), mesh->indices.size());
-  vao->AddArray(0, mesh->positions.data(), mesh->positions.size(), 3);
-  vao->AddArray(1, mesh->normals.data(), mesh->normals.size(), 3);
+// Obtains the define of the debug view of the lighting pass, empty without
+// one
+std::string GetDebugDefine() {
+  if (debug_normals)
+    return "DEBUG_NORMALS";
+  if (debug_light_count)
+    return "DEBUG_LIGHT_COUNT";
+  return "";
 }
 
-// Loads the bear mesh
-void LoadBearMesh() {
-  auto inputfile = "data/bear-obj.obj";
-  std::vector<tinyobj::shape_t> shapes;
-  std::vector<tinyobj::material_t> materials;
+// Obtains the permutation of the full-screen lighting pass for the lighting
+// mode, built on the first use; the debug view keeps the shaded one until
+// its own is built
+ShaderProgram *GetLightpassShader(bool per_sample) {
+  auto defines = GetLightpassDefines(per_sample);
+  auto debug_define = GetDebugDefine();
+  if (debug_define.empty())
+    return lightpass_shaders.Get(defines);
+  auto debug_defines = defines;
+  debug_defines[debug_define] = "";
+  return lightpass_shaders.GetReady(debug_defines, defines);
+}
 
-  std::string err;
-  bool ret = tinyobj::LoadObj(shapes, materials, err, inputfile, "data/");
-  Assertf(err.empty() && ret, "tinyobj error: %s", err.c_str());
+// Obtains the number of views of the geometry pass
+int GetViewCount() {
+  if (eye_distance > 0)
+    return 2;
+  if (camera_wall)
+    return scene_description.GetCameraCount();
+  return 1;
+}
 
-  LoadMesh(&bear_mesh, &shapes[0].mesh);
+// Obtains the columns and rows of the tiles of the views, as square as they
+// fit
+glm::ivec2 GetViewGrid() {
+  int n_views = GetViewCount();
+  int columns = (int)std::ceil(std::sqrt((float)n_views));
+  return glm::ivec2(columns, (n_views + columns - 1) / columns);
 }
 
-// Updates the lights buffer
-void UpdateLightsBuffer() {
-  // Buffer configuration
-  // struct Light {
-  //     vec4 position;
-  //     vec3 diffuse;
-  //     vec3 specular;
-  //     bool is_spot;
-  //     vec3 spot_direction;
-  //     float spot_cutoff;
-  //     float spot_exponent;
-  // };
-  //
-  // layout (std140) uniform LightsBlock {
-  //     vec3 global_ambient;
-  //     int n_lights;
-  //     Light lights[100];
-  // };
+// Obtains the definitions of the shaders that tell the views apart: their
+// number and the grid of their tiles, with several of them
+std::string GetViewsCode() {
+  if (GetViewCount() == 1)
+    return "";
+  auto grid = GetViewGrid();
+  return ShaderProgram::GenerateDefines(
+      {{"VIEWS", std::to_string(GetViewCount())},
+       {"VIEW_COLUMNS", std::to_string(grid.x)},
+       {"VIEW_ROWS", std::to_string(grid.y)}});
+}
 
-  if (!lights.GetId())
-    lights.Init();
-  else
-    lights.Clear();
+// Obtains the definitions of the shaders that read the models, for their
+// layout in the models buffer and the skinning of their vertices
+std::string GetModelsCode() {
+  ShaderProgram::Defines defines;
+  if (compact_models)
+    defines["COMPACT_MODELS"] = "";
+  if (skinning_poses)
+    defines["SKINNING"] = "";
+  return ShaderProgram::GenerateDefines(defines);
+}
 
-  lights.Add({0.2, 0.2, 0.2});
-  lights.Add(N_LIGHTS);
-  lights.FinishChunk();
+// Obtains the point the views are culled from, with the distance to it of
+// the farthest view in w: the camera in stereo and the center of the cameras
+// of the wall
+glm::vec4 GetCullingEye() {
+  if (!camera_wall)
+    return glm::vec4(eye, eye_distance / 2);
+  auto cameras = scene_description.GetCameras();
+  int n_cameras = scene_description.GetCameraCount();
+  glm::vec3 center(0);
+  for (int i = 0; i < n_cameras; ++i)
+    center += cameras[i].eye / (float)n_cameras;
+  float radius = 0;
+  for (int i = 0; i < n_cameras; ++i)
+    radius = std::max(radius, glm::distance(center, cameras[i].eye));
+  return glm::vec4(center, radius);
+}
 
-  for (int i = 0; i < N_LIGHTS_I; ++i) {
-    for (int j = 0; j < N_LIGHTS_J; ++j) {
-      auto position = glm::vec4(0.0, 10, 0.0, 1.0);
-      auto diffuse = random_colors[i + N_LIGHTS_I * j];
-      auto specular = glm::vec3(0.5, 0.5, 0.5);
-      auto is_spot = true;
-      auto spot_direction = glm::vec3(0.0, -1.0, 0.0);
-      auto spot_cutoff = glm::radians(45.0f);
-      auto spot_exponent = 16.0f;
+// Registers the binding points of the blocks of the main programs
+void RegisterBlockBindings() {
+  ShaderProgram::RegisterBlockBinding("CameraBlock", buffer_bindings::CAMERA);
+  ShaderProgram::RegisterBlockBinding("ViewsBlock", buffer_bindings::VIEWS);
+  ShaderProgram::RegisterBlockBinding("ModelsBlock", buffer_bindings::MODELS);
+  ShaderProgram::RegisterBlockBinding("DrawsBlock", buffer_bindings::DRAWS);
+  ShaderProgram::RegisterBlockBinding("InstancesBlock",
+                                      buffer_bindings::INSTANCES);
+  ShaderProgram::RegisterBlockBinding("MaterialsBlock",
+                                      buffer_bindings::MATERIALS);
+  ShaderProgram::RegisterBlockBinding("LightsBlock", buffer_bindings::LIGHTS);
+  ShaderProgram::RegisterBlockBinding("SpotLightsBlock",
+                                      buffer_bindings::SPOT_LIGHTS);
+  ShaderProgram::RegisterBlockBinding("SunBlock", buffer_bindings::SUN);
+  ShaderProgram::RegisterBlockBinding("TransparentBlock",
+                                      buffer_bindings::TRANSPARENT_INSTANCES);
+  ShaderProgram::RegisterBlockBinding("DiffuseHandlesBlock",
+                                      buffer_bindings::DIFFUSE_HANDLES);
+  ShaderProgram::RegisterBlockBinding("PulledVerticesBlock",
+                                      buffer_bindings::PULLED_VERTICES);
+  // The skinning is created after these programs link, which read its
+  // blocks
+  ShaderProgram::RegisterBlockBinding("SkinnedVerticesBlock",
+                                      buffer_bindings::SKINNED_VERTICES);
+  ShaderProgram::RegisterBlockBinding("SkinOffsetsBlock",
+                                      buffer_bindings::SKIN_OFFSETS);
+  ShaderProgram::RegisterBlockBinding("ShadowMeshNodesBlock",
+                                      buffer_bindings::SHADOW_MESH_NODES);
+  ShaderProgram::RegisterBlockBinding("ShadowTrianglesBlock",
+                                      buffer_bindings::SHADOW_TRIANGLES);
+  ShaderProgram::RegisterBlockBinding("ShadowNodesBlock",
+                                      buffer_bindings::SHADOW_NODES);
+  ShaderProgram::RegisterBlockBinding("ShadowInstancesBlock",
+                                      buffer_bindings::SHADOW_INSTANCES);
+}
 
-      auto model = rotation * ComputeTranslation(i, j);
-      auto modelview = view * model;
-      auto normalmatrix = glm::transpose(glm::inverse(modelview));
-      auto spot_dir_ws = glm::vec4(spot_direction, 1);
-      auto spot_dir_vs = glm::normalize(glm::vec3(normalmatrix * spot_dir_ws));
+// Obtains the defines of the programs that sample the diffuse maps
+std::string GetDiffuseMapsDefines() {
+  if (!bindless_maps)
+    return "";
+  return ShaderProgram::GenerateDefines({{"BINDLESS_MAPS", ""}});
+}
 
-      lights.Add(modelview * position);
-      lights.Add(diffuse);
-      lights.Add(specular);
-      lights.Add(is_spot);
-      lights.Add(spot_dir_vs);
-      lights.Add(spot_cutoff);
-      lights.Add(spot_exponent);
-      lights.FinishChunk();
+// Loads the geometry pass and lighting pass shaders; every program is
+// submitted before waiting for any, so the driver can build them in parallel
+void LoadShaders() {
+  try {
+    RegisterBlockBindings();
+    ShaderProgram::EnableParallelCompile();
+    std::vector<ShaderProgram *> programs = {&geompass_shader};
+    std::string picking_code;
+    if (picking) {
+      int location = gbuffer_layout.GetAttachments().size();
+      picking_code = ShaderProgram::GenerateDefines(
+          {{"PICKING", ""}, {"PICK_LOCATION", std::to_string(location)}});
+    }
+    auto models_code = GetModelsCode();
+    std::string pulling_code;
+    if (vertex_pulling)
+      pulling_code = ShaderProgram::GenerateDefines({{"VERTEX_PULLING", ""}});
+    auto geompass_code = picking_code + GetDiffuseMapsDefines() +
+                         gbuffer_layout.GenerateGeometryPassCode();
+    if (virtual_textures)
+      geompass_code =
+          ShaderProgram::GenerateDefines(VirtualTexture::GetDefines()) +
+          geompass_code;
+    device->CreateGraphicsPipeline(
+        &geompass_shader, "shaders/geompass_vs.glsl",
+        GetViewsCode() + models_code + picking_code + pulling_code,
+        "shaders/geompass_fs.glsl", geompass_code);
+    if (visibility_buffer) {
+      device->CreateGraphicsPipeline(&visibility_shader,
+                                     "shaders/visibility_vs.glsl", models_code,
+                                     "shaders/visibility_fs.glsl");
+      programs.push_back(&visibility_shader);
+    }
+    if (light_prepass) {
+      device->CreateGraphicsPipeline(
+          &materialpass_shader, "shaders/geompass_vs.glsl",
+          GetViewsCode() + models_code, "shaders/materialpass_fs.glsl",
+          GetDiffuseMapsDefines());
+      programs.push_back(&materialpass_shader);
+    }
+    if (depth_prepass) {
+      device->CreateGraphicsPipeline(&depth_prepass_shader,
+                                     "shaders/depth_vs.glsl",
+                                     GetViewsCode() + models_code);
+      programs.push_back(&depth_prepass_shader);
+    }
+    if (overdraw) {
+      device->CreateGraphicsPipeline(
+          &overdraw_shader, "shaders/depth_vs.glsl",
+          GetViewsCode() + models_code, "shaders/overdraw_fs.glsl");
+      programs.push_back(&overdraw_shader);
+      device->CreateScreenPipeline(&overdraw_view_shader, &screen_quad_shader,
+                                   "shaders/overdraw_view_fs.glsl");
+      programs.push_back(&overdraw_view_shader);
     }
+    if (shadow_budget || sun_period) {
+      device->CreateGraphicsPipeline(&shadow_shader, "shaders/shadow_vs.glsl",
+                                     models_code);
+      programs.push_back(&shadow_shader);
+    }
+    if (n_decals) {
+      device->CreateGraphicsPipeline(&decal_shader, "shaders/decal_vs.glsl",
+                                     models_code, "shaders/decal_fs.glsl",
+                                     gbuffer_layout.GenerateDecalPassCode());
+      programs.push_back(&decal_shader);
+    }
+    if (impostor_distance) {
+      bear_impostors.Init(gbuffer_layout.GenerateGeometryPassCode(),
+                          GetDiffuseMapsDefines(), models_code);
+      for (auto program : bear_impostors.GetPrograms())
+        programs.push_back(program);
+    }
+    // The full-screen passes share one vertex program through pipelines
+    device->CreateVertexStage(&screen_quad_shader, "shaders/lightpass_vs.glsl");
+    programs.push_back(&screen_quad_shader);
+    if (visibility_buffer) {
+      device->CreateScreenPipeline(
+          &visibility_resolve_shader, &screen_quad_shader,
+          "shaders/visibility_resolve_fs.glsl", models_code + geompass_code);
+      programs.push_back(&visibility_resolve_shader);
+    }
+    auto gbuffer_code = GetViewsCode() +
+                        gbuffer_layout.GenerateLightingPassCode(msaa_samples);
+    auto lightpass_code =
+        framebuffer_fetch
+            ? GetViewsCode() + gbuffer_layout.GenerateFetchLightingPassCode()
+            : gbuffer_code;
+    lightpass_shaders.Init(&screen_quad_shader, "shaders/lightpass_fs.glsl",
+                           lightpass_code);
+    lightpass_shaders.Prepare(GetLightpassDefines(false));
+    if (msaa_samples) {
+      lightpass_shaders.Prepare(GetLightpassDefines(true));
+      device->CreateScreenPipeline(&edges_shader, &screen_quad_shader,
+                                   "shaders/edges_fs.glsl", gbuffer_code);
+      programs.push_back(&edges_shader);
+    }
+    if (lighting_scale < 1.0f) {
+      device->CreateScreenPipeline(&upsample_shader, &screen_quad_shader,
+                                   "shaders/upsample_fs.glsl", gbuffer_code);
+      programs.push_back(&upsample_shader);
+    }
+    if (shading_rate)
+      shading_rates.Init(gbuffer_code, coarse_shading_rate);
+    if (taa) {
+      device->CreateScreenPipeline(&taa_shader, &screen_quad_shader,
+                                   "shaders/taa_fs.glsl");
+      programs.push_back(&taa_shader);
+    }
+    if (ssao)
+      ambient_occlusion.Init(gbuffer_code);
+    if (reflections) {
+      screen_reflections.Init(gbuffer_code);
+      device->CreateScreenPipeline(&reflections_shader, &screen_quad_shader,
+                                   "shaders/reflections_fs.glsl", gbuffer_code);
+      programs.push_back(&reflections_shader);
+    }
+    if (bloom_strength > 0)
+      bloom.Init(BLOOM_LEVELS);
+    if (hdr) {
+      device->CreateScreenPipeline(&tonemap_shader, &screen_quad_shader,
+                                   "shaders/tonemap_fs.glsl");
+      programs.push_back(&tonemap_shader);
+    }
+    if (fxaa_steps) {
+      device->CreateScreenPipeline(
+          &fxaa_shader, &screen_quad_shader, "shaders/fxaa_fs.glsl",
+          ShaderProgram::GenerateDefines(
+              {{"FXAA_STEPS", std::to_string(fxaa_steps)}}));
+      programs.push_back(&fxaa_shader);
+    }
+    if (UsesComputeLighting()) {
+      ShaderProgram::Defines compute_defines = {
+          {"TILE_SIZE", std::to_string(TILE_SIZE)},
+          {"LIT_FORMAT", hdr ? "r11f_g11f_b10f" : "rgba8"}};
+      if (lighting_mode == LIGHTING_CLUSTERED)
+        compute_defines["CLUSTERED"] = "";
+      if (cluster_light_budget)
+        compute_defines["CLUSTER_LIGHT_BUDGET"] =
+            std::to_string(cluster_light_budget);
+      if (lighting_mode == LIGHTING_FULLSCREEN)
+        compute_defines["ALL_LIGHTS"] = "";
+      if (ssao)
+        compute_defines["AMBIENT_OCCLUSION"] = "";
+      if (shadow_budget)
+        compute_defines["SPOT_SHADOWS"] = "";
+      if (ray_traced_shadows)
+        compute_defines["RAY_TRACED_SHADOWS"] = "";
+      if (fast_lighting)
+        compute_defines["FAST_LIGHTING"] = "";
+      if (!half_lighting_define.empty())
+        compute_defines[half_lighting_define] = "";
+      if (sun_period)
+        compute_defines["SUN_LIGHT"] = "";
+      if (ShaderProgram::IsSubgroupSupported())
+        compute_defines["SUBGROUPS"] = "";
+      device->CreateComputePipeline(
+          &lightpass_compute_shader, "shaders/lightpass_cs.glsl",
+          ShaderProgram::GenerateDefines(compute_defines) + gbuffer_code);
+      programs.push_back(&lightpass_compute_shader);
+    }
+    if (n_transparent) {
+      auto forward_code =
+          ShaderProgram::GenerateDefines(GetShadingDefines()) + gbuffer_code;
+      std::string batch_code;
+      if (instanced_transparent) {
+        transparent_batch =
+            UniformBuffer::GetMaxArrayElements(sizeof(TransparentInstance));
+        batch_code = ShaderProgram::GenerateDefines(
+            {{"TRANSPARENT_BATCH", std::to_string(transparent_batch)}});
+      }
+      if (weighted_transparency)
+        forward_code =
+            ShaderProgram::GenerateDefines({{"WEIGHTED_OIT", ""}}) +
+            forward_code;
+      device->CreateGraphicsPipeline(&forward_shader, "shaders/forward_vs.glsl",
+                                     batch_code, "shaders/forward_fs.glsl",
+                                     forward_code);
+      programs.push_back(&forward_shader);
+      if (weighted_transparency) {
+        device->CreateScreenPipeline(&oit_composite_shader,
+                                     &screen_quad_shader,
+                                     "shaders/oit_composite_fs.glsl");
+        programs.push_back(&oit_composite_shader);
+      }
+    }
+    if (lighting_mode == LIGHTING_VOLUMES) {
+      auto volume_defines = GetShadingDefines();
+      if (!GLEW_EXT_depth_bounds_test)
+        volume_defines["DEPTH_BOUNDS"] = "";
+      auto volume_code =
+          ShaderProgram::GenerateDefines(volume_defines) + gbuffer_code;
+      device->CreateGraphicsPipeline(
+          &lightvolume_shader, "shaders/lightvolume_vs.glsl", gbuffer_code,
+          "shaders/lightvolume_fs.glsl", volume_code);
+      device->CreateGraphicsPipeline(&stencil_shader,
+                                     "shaders/lightvolume_vs.glsl",
+                                     gbuffer_code, "shaders/stencil_fs.glsl");
+      programs.push_back(&lightvolume_shader);
+      programs.push_back(&stencil_shader);
+    }
+
+    // The assignment shader links while the others are still building; the
+    // transparent objects read the clusters in every lighting mode
+    if (lighting_mode == LIGHTING_CLUSTERED || n_transparent)
+      light_clusters.Init(CLUSTER_GRID, light_bvh ? light_swarm_size : 0,
+                          cluster_light_budget);
+    // The fog reads the lights of the clusters as the forward shading
+    if (fog_density > 0)
+      volumetric_fog.Init(
+          FOG_GRID,
+          ShaderProgram::GenerateDefines(GetShadingDefines()) + gbuffer_code);
+    for (auto program : programs)
+      program->FinishLink();
+    loaded_programs = programs;
+    GetLightpassShader(false);
+    if (msaa_samples)
+      GetLightpassShader(true);
+  } catch (std::exception &e) {
+    Assertf(false, "%s", e.what());
   }
+}
 
-  lights.SendToDevice();
+// Creates an random number between 0 an 1, the same sequence in every run
+double Random() {
+  static std::mt19937 engine(RANDOM_SEED);
+  return (double)engine() / engine.max();
 }
 
-// Creates the bear instances matrices
-void UpdateBearMatrices() {
-  // Buffer configuration:
-  // struct Matrices {
-  //     mat4 mvp;
-  //     mat4 modelview;
-  //     mat4 normalmatrix;
-  // };
-  //
-  // layout (std140) uniform MatricesBlock {
-  //     Matrices matrices[100];
-  // };
+// Compute the translation of the i, j indices of a grid centered at the
+// origin, the light grid by default
+glm::mat4 ComputeTranslation(int i, int j, int n_i = n_lights_i,
+                             int n_j = n_lights_j) {
+  auto x = (i - (n_i - 1) / 2.0) * grid_spacing;
+  auto z = (j - (n_j - 1) / 2.0) * grid_spacing;
+  return glm::translate(glm::vec3(x, 0, z));
+}
 
-  if (!bear_matrices.GetId())
-    bear_matrices.Init();
-  else
-    bear_matrices.Clear();
+// Describes the grid of bears under random colored spot lights of the
+// command line options
+void CreateDefaultScene() {
+  int n_lights = n_lights_i * n_lights_j;
+  std::vector<glm::vec3> random_colors(n_lights);
+  for (int i = 0; i < n_lights; ++i)
+    random_colors[i] = glm::vec3(Random(), Random(), Random());
+
+  scene_description.SetAmbient(glm::vec3(0.2f));
+  scene_description.SetGround(GROUND_HEIGHT, GROUND_HALF_SIZE);
+  // GROUND_MATERIAL
+  scene_description.AddMaterial(
+      {{0.5f, 0.5f, 0.5f}, {0.5f, 0.5f, 0.5f}, {0.2f, 0.2f, 0.2f}, 16.0f});
+  scene_description.AddCamera({glm::vec3(0.0, 5.0, 0.0),
+                               glm::vec3(1.0, 5.0, -1.0),
+                               glm::vec3(0.0, 1.0, 0.0)});
+  scene_description.AddCamera({glm::vec3(-20.0, 20.0, -20.0),
+                               glm::vec3(0.0, 0.0, 0.0),
+                               glm::vec3(0.0, 1.0, 0.0)});
+  scene_description.AddCamera({glm::vec3(0.0, 100.0, 0.0),
+                               glm::vec3(0.0, 0.0, 0.0),
+                               glm::vec3(0.0, 0.0, 1.0)});
+
+  // A bear under each light takes its rotation from the light color
+  int bears_i = n_bears_i ? n_bears_i : n_lights_i;
+  int bears_j = n_bears_j ? n_bears_j : n_lights_j;
+  bool under_lights = bears_i == n_lights_i && bears_j == n_lights_j;
+  for (int k = 0; k < bears_i * bears_j; ++k) {
+    int i = k / bears_j, j = k % bears_j;
+    float theta = (under_lights ? random_colors[i + j * n_lights_i].x
+                                : Random()) * 2.0 * M_PI;
+    auto rotation = glm::rotate(theta, glm::vec3(0, 1, 0));
+    scene_description.AddInstance(
+        ComputeTranslation(i, j, bears_i, bears_j) * rotation);
+  }
+
+  auto spot_cutoff = glm::radians(45.0f);
+  auto spot_exponent = 16.0f;
+  auto cone = glm::packHalf2x16(glm::vec2(spot_cutoff, spot_exponent));
+  for (int i = 0; i < n_lights_i; ++i) {
+    for (int j = 0; j < n_lights_j; ++j) {
+      auto position = ComputeTranslation(i, j) * glm::vec4(0.0, 10, 0.0, 1.0);
+      auto diffuse = random_colors[i * n_lights_j + j];
+      auto specular = 0.5f;
+      scene_description.AddLight({glm::vec3(position), light_range, diffuse,
+                                  specular, glm::vec3(0.0, -1.0, 0.0), cone});
+    }
+  }
+}
+
+// Loads the scene description file, or creates the default scene, and
+// writes it if asked to
+void LoadScene() {
+  try {
+    if (scene_path.empty())
+      CreateDefaultScene();
+    else
+      scene_description.Load(scene_path);
+    if (!write_scene_path.empty()) {
+      scene_description.Write(write_scene_path);
+      exit(0);
+    }
+  } catch (std::exception &e) {
+    Assertf(false, "%s", e.what());
+  }
+  // The materials buffer is sized at runtime, only the G-buffer limits them
+  Assertf(scene_description.GetMaterialCount() <=
+              gbuffer_layout.GetMaterialCapacity(),
+          "too many materials in the scene for the G-buffer: %d",
+          scene_description.GetMaterialCount());
+  Assertf(!camera_wall ||
+              scene_description.GetCameraCount() <= MeshBatch::MAX_VIEWS,
+          "too many cameras in the scene for --camera-wall: %d",
+          scene_description.GetCameraCount());
+}
+
+// Appends materials, with the layers of their diffuse maps (-1 if none),
+// to the materials buffer and uploads it again
+void AddMaterials(const std::vector<ObjMaterial> &obj_materials,
+                  const std::vector<int> &layers) {
+  for (size_t i = 0; i < obj_materials.size(); ++i) {
+    auto &material = obj_materials[i];
+    auto &kd = material.diffuse, &ka = material.ambient;
+    auto &ks = material.specular;
+    materials.Add({kd[0], kd[1], kd[2]});
+    materials.Add(layers[i]);
+    materials.Add({ka[0], ka[1], ka[2]});
+    materials.Add({ks[0], ks[1], ks[2]});
+    materials.Add(material.shininess);
+    materials.FinishChunk();
+  }
+  materials.SendToDevice();
+}
+
+// Loads the materials
+void CreateMaterialsBuffer() {
+  // Buffer configuration
+  // struct Material {
+  //     vec3 diffuse;
+  //     int diffuse_map;
+  //     vec3 ambient;
+  //     vec3 specular;
+  //     float shininess;
+  // };
+  //
+  // layout (std430) readonly buffer MaterialsBlock {
+  //     Material materials[];
+  // };
+
+  // The materials of the scene have no diffuse maps
+  device->CreateBuffer(&materials, "materials", UniformBuffer::STORAGE,
+                       UniformBuffer::STATIC);
+  auto scene_materials = scene_description.GetMaterials();
+  int n_materials = scene_description.GetMaterialCount();
+  AddMaterials({scene_materials, scene_materials + n_materials},
+               std::vector<int>(n_materials, -1));
+}
+
+// Creates the empty vao of the full-screen triangle, whose vertices come
+// from gl_VertexID
+void LoadScreenTriangle() {
+  screen_triangle.Init();
+  screen_triangle.SetLabel("screen triangle");
+}
+
+// Loads the ground quad, as two triangles so it's drawn in the scene batch
+void LoadGround() {
+  unsigned int indices[] = {0, 1, 2, 0, 2, 3};
+  float h = scene_description.GetGroundHeight();
+  float v = scene_description.GetGroundHalfSize();
+  float vertices[] = {-v, h, v, -v, h, -v, v, h, -v, v, h, v};
+  float normals[] = {0, 1, 0, 0, 1, 0, 0, 1, 0, 0, 1, 0};
+  ground_mesh = scene.AddMesh(vertices, normals, 4, indices, 6);
+}
+
+// Loads the box of the decals, centered at the origin with the faces outwards
+void LoadDecalBox() {
+  std::vector<float> vertices, normals;
+  for (int i = 0; i < 8; ++i) {
+    glm::vec3 corner((i & 1) ? 1 : -1, (i & 2) ? 1 : -1, (i & 4) ? 1 : -1);
+    auto position = corner * DECAL_HALF_SIZE;
+    auto normal = glm::normalize(corner);
+    vertices.insert(vertices.end(), {position.x, position.y, position.z});
+    normals.insert(normals.end(), {normal.x, normal.y, normal.z});
+  }
+  unsigned int indices[] = {4, 6, 2, 4, 2, 0, 1, 3, 7, 1, 7, 5,
+                            1, 5, 4, 1, 4, 0, 2, 6, 7, 2, 7, 3,
+                            2, 3, 1, 2, 1, 0, 4, 5, 7, 4, 7, 6};
+  decal_mesh = decal_batch.AddMesh(vertices.data(), normals.data(), 8,
+                                   indices, 36);
+}
+
+// Reorders a mesh for the vertex cache, overdraw and vertex fetch and
+// simplifies it into up to n_lods - 1 more levels of detail that share its
+// vertices; returns the indices of every level
+std::vector<std::vector<unsigned int>> BuildLods(ObjMesh *mesh, int n_lods) {
+  OptimizeMesh(&mesh->positions, &mesh->normals, &mesh->indices,
+               &mesh->texcoords, &mesh->material_ids);
+  auto positions = mesh->positions.data();
+  int n_vertices = mesh->positions.size() / 3;
+  std::vector<std::vector<unsigned int>> lods = {mesh->indices};
+  while ((int)lods.size() < n_lods) {
+    auto &indices = lods.back();
+    auto simplified =
+        SimplifyMesh(positions, n_vertices, indices, indices.size() / 2);
+    // Stops once the simplification gets stuck
+    if (simplified.size() > indices.size() * 3 / 4)
+      break;
+    auto clusters = OptimizeVertexCache(&simplified, n_vertices);
+    OptimizeOverdraw(positions, &simplified, clusters);
+    lods.push_back(simplified);
+  }
+  return lods;
+}
+
+// Adds a mesh to a batch with its levels of detail, given by their indices
+// and index counts, and to the shadow hierarchy if there's one, with all of
+// its triangles; returns their ids
+std::vector<int> AddLods(
+    MeshBatch *batch, const float *positions, const float *normals,
+    const float *texcoords, const int *material_ids, int n_vertices,
+    const std::vector<std::pair<const unsigned int *, int>> &lods,
+    ShadowBvh *bvh) {
+  std::vector<int> ids = {batch->AddMesh(positions, normals, n_vertices,
+                                         lods[0].first, lods[0].second,
+                                         texcoords, material_ids)};
+  for (size_t i = 1; i < lods.size(); ++i)
+    ids.push_back(batch->AddLod(ids[0], lods[i].first, lods[i].second));
+  if (bvh)
+    bvh->SetMesh(positions, lods[0].first, lods[0].second);
+  return ids;
+}
+
+// Loads an OBJ file into a batch with up to n_lods levels of detail, from the
+// mesh cache once it has them, and obtains its materials and their diffuse
+// maps; every shape of the file is in the same mesh, with the materials as
+// offsets to the one of its draws, which the shadow hierarchy gets too
+// unless it's null
+std::vector<int> LoadMesh(MeshBatch *batch, const std::string &path,
+                          int n_lods, std::vector<ObjMaterial> *materials,
+                          std::vector<std::string> *textures,
+                          ShadowBvh *bvh) {
+  std::string cache_path;
+  uint64_t key = 0;
+  if (!mesh_cache.empty()) {
+    key = MeshCache::ComputeKey(path, "lods=" + std::to_string(n_lods));
+    cache_path = MeshCache::GetPath(mesh_cache, key);
+    MeshCache cache;
+    if (cache.Open(cache_path, key)) {
+      std::vector<std::pair<const unsigned int *, int>> lods;
+      for (int i = 0; i < cache.GetLodCount(); ++i)
+        lods.push_back({cache.GetIndices(i), cache.GetIndexCount(i)});
+      materials->assign(cache.GetMaterials(),
+                        cache.GetMaterials() + cache.GetMaterialCount());
+      *textures = cache.GetTextures();
+      return AddLods(batch, cache.GetPositions(), cache.GetNormals(),
+                     cache.GetTexcoords(), cache.GetMaterialIds(),
+                     cache.GetVertexCount(), lods, bvh);
+    }
+  }
+
+  auto mesh = LoadObjMesh(path);
+  auto lods = BuildLods(&mesh, n_lods);
+  if (!cache_path.empty())
+    MeshCache::Write(cache_path, key, mesh, lods);
+  std::vector<std::pair<const unsigned int *, int>> views;
+  for (auto &lod : lods)
+    views.push_back({lod.data(), (int)lod.size()});
+  *materials = mesh.materials;
+  *textures = mesh.textures;
+  return AddLods(batch, mesh.positions.data(), mesh.normals.data(),
+                 mesh.texcoords.data(), mesh.material_ids.data(),
+                 mesh.positions.size() / 3, views, bvh);
+}
+
+// Creates the cone of the light volumes: apex at the origin, base of radius 1
+// at z = -1, with the faces outwards
+void LoadConeMesh() {
+  std::vector<float> vertices = {0, 0, 0, 0, 0, -1};
+  std::vector<unsigned int> indices;
+  // The polygon circumscribes the circle so it covers the whole cone
+  float radius = 1 / std::cos(M_PI / CONE_SEGMENTS);
+  for (int i = 0; i < CONE_SEGMENTS; ++i) {
+    float angle = 2 * M_PI * i / CONE_SEGMENTS;
+    vertices.push_back(radius * std::cos(angle));
+    vertices.push_back(radius * std::sin(angle));
+    vertices.push_back(-1);
+    unsigned int current = 2 + i;
+    unsigned int next = 2 + (i + 1) % CONE_SEGMENTS;
+    indices.insert(indices.end(), {0, current, next, 1, next, current});
+  }
+  cone_mesh = shapes.AddMesh(vertices.data(), vertices.size() / 3,
+                             indices.data(), indices.size());
+}
+
+// Creates the unit sphere of the transparent objects, with the faces
+// outwards; the poles are repeated at every segment
+void LoadSphereMesh() {
+  std::vector<float> vertices;
+  std::vector<unsigned int> indices;
+  for (int i = 0; i <= SPHERE_RINGS; ++i) {
+    float theta = M_PI * i / SPHERE_RINGS;
+    for (int j = 0; j < SPHERE_SEGMENTS; ++j) {
+      float phi = 2 * M_PI * j / SPHERE_SEGMENTS;
+      vertices.push_back(std::sin(theta) * std::cos(phi));
+      vertices.push_back(std::cos(theta));
+      vertices.push_back(std::sin(theta) * std::sin(phi));
+    }
+  }
+  for (int i = 0; i < SPHERE_RINGS; ++i) {
+    for (int j = 0; j < SPHERE_SEGMENTS; ++j) {
+      unsigned int a = i * SPHERE_SEGMENTS + j;
+      unsigned int b = i * SPHERE_SEGMENTS + (j + 1) % SPHERE_SEGMENTS;
+      unsigned int c = a + SPHERE_SEGMENTS;
+      unsigned int d = b + SPHERE_SEGMENTS;
+      // The triangles that touch a pole have no area
+      if (i > 0)
+        indices.insert(indices.end(), {a, b, c});
+      if (i < SPHERE_RINGS - 1)
+        indices.insert(indices.end(), {b, d, c});
+    }
+  }
+  sphere_mesh = shapes.AddMesh(vertices.data(), vertices.size() / 3,
+                               indices.data(), indices.size());
+}
+
+// Loads the meshes of the full-screen passes, of the light volumes and of the
+// transparent objects
+void LoadShapes() {
+  LoadScreenTriangle();
+  shapes.Init(VertexLayout().Add<float>(0, 3));
+  if (lighting_mode == LIGHTING_VOLUMES)
+    LoadConeMesh();
+  if (n_transparent)
+    LoadSphereMesh();
+  shapes.Upload();
+}
+
+// Places the transparent objects at random over the ground, above the bears,
+// with random colors and opacities
+void CreateTransparentObjects() {
+  float h = scene_description.GetGroundHeight();
+  float v = scene_description.GetGroundHalfSize() - TRANSPARENT_RADIUS;
+  for (int i = 0; i < n_transparent; ++i) {
+    TransparentObject object;
+    object.position = glm::vec3((2 * Random() - 1) * v, h + 3 + 4 * Random(),
+                                (2 * Random() - 1) * v);
+    object.color = glm::vec4(Random(), Random(), Random(),
+                             0.25 + 0.35 * Random());
+    transparent_objects.push_back(object);
+  }
+}
+
+// Loads the bear mesh with its levels of detail and materials, and decodes
+// their diffuse maps
+// Runs on a worker thread and only touches the cpu side of the bear batch
+// and of the diffuse maps; throws runtime_error if the mesh can't be loaded
+// or has too many materials
+void LoadBears() {
+  std::vector<std::string> textures;
+  bear_lods = LoadMesh(&bear_batch, "data/bear-obj.obj", N_BEAR_LODS,
+                       &bear_materials, &textures,
+                       ray_traced_shadows ? &shadow_bvh : nullptr);
+  int first_material = scene_description.GetMaterialCount();
+  if (first_material + (int)bear_materials.size() >
+      gbuffer_layout.GetMaterialCapacity())
+    throw std::runtime_error("Too many materials in the bear mesh for the "
+                             "G-buffer");
+  if (virtual_textures) {
+    bear_diffuse_maps = virtual_maps.Open(textures);
+  } else {
+    if (bindless_maps)
+      diffuse_maps.UseBindless();
+    bear_diffuse_maps = diffuse_maps.Decode(textures, DIFFUSE_MAP_SIZE);
+  }
+  // The partition adds the bears of the cells it loads
+  if (world_cell_size > 0)
+    bear_draw = bear_batch.AddDraw(bear_lods, first_material);
+  else
+    bear_batch.AddDraw(bear_lods, first_material, FIRST_BEAR_MODEL,
+                       scene_description.GetInstanceCount());
+}
+
+// Creates the lights, in world space before the rotation
+void CreateLights() {
+  // Buffer configuration
+  // struct PointLight {
+  //     vec3 position;
+  //     float range;
+  //     vec3 diffuse;
+  //     float specular;
+  // };
+  //
+  // layout (std430) buffer LightsBlock {
+  //     vec3 global_ambient;
+  //     int n_point_lights;
+  //     PointLight point_lights[];
+  // };
+
+  // Every light of the scene is a spot light; the point lights of the swarm
+  // are only written by its shader, after the header
+  device->CreateBuffer(&lights, "lights", UniformBuffer::STORAGE,
+                       UniformBuffer::STATIC);
+  if (light_swarm_size) {
+    auto header = (unsigned char *)lights.Map(
+        LightSwarm::GetLightsOffset() +
+        light_swarm_size * sizeof(LightSwarm::PointLight));
+    auto ambient = scene_description.GetAmbient();
+    memcpy(header, &ambient, sizeof(ambient));
+    memcpy(header + sizeof(ambient), &light_swarm_size, sizeof(int));
+    lights.Unmap();
+  } else {
+    lights.Add(scene_description.GetAmbient());
+    lights.Add(0);
+    lights.FinishChunk();
+    lights.SendToDevice();
+  }
+
+  auto spots = scene_description.GetLights();
+  int n_lights = scene_description.GetLightCount();
+  try {
+    light_transform.Init({spots, spots + n_lights}, spirv, shadow_budget > 0);
+    light_transform.SetCpuCulling(cpu_light_culling);
+    if (shadow_budget)
+      shadow_atlas.Init(SHADOW_ATLAS_SIZE, {spots, spots + n_lights});
+    if (lighting_mode == LIGHTING_STOCHASTIC ||
+        lighting_mode == LIGHTING_LIGHTCUTS)
+      light_tree.Init({spots, spots + n_lights});
+    if (sun_period)
+      sun_shadows.Init(SUN_SHADOW_SIZE, SUN_CASCADES, sun_period,
+                       SUN_DIRECTION, SUN_DIFFUSE, SUN_SPECULAR);
+    // Up to the height of the lights of the default scene
+    float h = scene_description.GetGroundHeight();
+    float v = scene_description.GetGroundHalfSize();
+    if (light_swarm_size)
+      light_swarm.Init(light_swarm_size, glm::vec3(-v, h, -v),
+                       glm::vec3(v, h + 10, v));
+    // The lights past the resident cells have no bears to light
+    if (world_cell_size > 0)
+      light_transform.SetMaxDistance(stream_radius);
+    if (ground_cache)
+      ground_light_cache.Init(h, v);
+  } catch (std::exception &e) {
+    Assertf(false, "%s", e.what());
+  }
+}
+
+// Runs a simulation step of SIMULATION_STEP seconds
+void StepSimulation(SimulationState *state) {
+  double speed = glm::radians(LIGHTS_ROTATION_SPEED);
+  state->lights_angle += speed * SIMULATION_STEP;
+}
+
+// Runs the steps due after some more seconds, keeping the previous state for
+// the interpolation
+void AdvanceSimulation(double elapsed) {
+  PROFILE_ZONE("simulation");
+  double max_lag = MAX_SIMULATION_STEPS * SIMULATION_STEP;
+  simulation_lag = std::min(simulation_lag + elapsed, max_lag);
+  while (simulation_lag >= SIMULATION_STEP) {
+    previous_state = current_state;
+    StepSimulation(&current_state);
+    simulation_lag -= SIMULATION_STEP;
+  }
+}
+
+// Waits for the simulation of the frame and interpolates the state rendered
+// between its last two steps
+void InterpolateSimulation() {
+  PROFILE_ZONE("interpolate simulation");
+  try {
+    jobs.Wait(simulation_update);
+  } catch (std::exception &e) {
+    Assertf(false, "%s", e.what());
+  }
+  double alpha = simulation_lag / SIMULATION_STEP;
+  double angle = glm::mix(previous_state.lights_angle,
+                          current_state.lights_angle, alpha);
+  angle = std::fmod(angle, 2 * M_PI);
+  rotation = glm::rotate((float)angle, glm::vec3(0, 1, 0));
+}
+
+// Camera matrices, as CameraBlock of shaders/geompass_vs.glsl
+struct CameraMatrices {
+  glm::mat4 view;
+  glm::mat4 projection;
+  glm::mat4 view_projection;
+};
+
+typedef BlockLayout<glm::mat4, glm::mat4, glm::mat4> CameraMatricesLayout;
+CHECK_BLOCK_MEMBER(CameraMatrices, CameraMatricesLayout, 0, view);
+CHECK_BLOCK_MEMBER(CameraMatrices, CameraMatricesLayout, 1, projection);
+CHECK_BLOCK_MEMBER(CameraMatrices, CameraMatricesLayout, 2, view_projection);
+CHECK_BLOCK_STRIDE(CameraMatrices, CameraMatricesLayout, Std140Stride);
+
+// Obtains the compact model of a world transform, which only rotates,
+// translates and scales uniformly
+CompactModel GetCompactModel(const glm::mat4 &world) {
+  float scale = glm::length(glm::vec3(world[0]));
+  auto rotation = glm::quat_cast(glm::mat3(world) / scale);
+  return {glm::vec4(glm::vec3(world[3]), scale),
+          glm::vec4(rotation.x, rotation.y, rotation.z, rotation.w)};
+}
+
+// Rebuilds the compact models of the ranges of the transforms
+void CompactTransforms(const std::vector<TransformHierarchy::Range> &ranges) {
+  auto worlds = transforms.GetWorlds();
+  for (auto &range : ranges)
+    for (int i = range.first; i < range.first + range.second; ++i)
+      compact_transforms[i] = GetCompactModel(worlds[i]);
+}
+
+// Creates the transforms of the ground, the bears and the decals, and uploads
+// their model matrices
+void CreateInstances() {
+  // Buffer configuration (see shaders/models.glsl):
+  // layout (std430) buffer ModelsBlock {
+  //     mat4 models[]; // ground, then the bears, then the decals
+  // };
+
+  // GROUND_MODEL, then the bears of the scene description from
+  // FIRST_BEAR_MODEL on
+  transforms.AddNode(glm::mat4());
+  auto bears = scene_description.GetModels();
+  for (int i = 0; i < scene_description.GetInstanceCount(); ++i)
+    transforms.AddNode(bears[i]);
+  if (world_cell_size > 0) {
+    std::vector<glm::vec3> positions;
+    for (int i = 0; i < scene_description.GetInstanceCount(); ++i)
+      positions.push_back(glm::vec3(bears[i][3]));
+    world_partition.Init(positions, world_cell_size, cell_budget);
+    cell_instances.resize(world_partition.GetCellCount());
+  }
+
+  // The decals lie on the ground at random, turned around the vertical
+  float h = scene_description.GetGroundHeight();
+  float v = scene_description.GetGroundHalfSize() - DECAL_HALF_SIZE.x;
+  for (int i = 0; i < n_decals; ++i) {
+    auto position = glm::vec3((2 * Random() - 1) * v, h,
+                              (2 * Random() - 1) * v);
+    float angle = 2 * M_PI * Random();
+    transforms.AddNode(glm::translate(position) *
+                       glm::rotate(angle, glm::vec3(0, 1, 0)));
+  }
+  transforms.Update();
+
+  // Written once; the nodes that change later only update their ranges
+  device->CreateBuffer(&models, "models", UniformBuffer::STORAGE,
+                       UniformBuffer::DYNAMIC);
+  if (compact_models) {
+    compact_transforms.resize(transforms.GetSize());
+    CompactTransforms({{0, transforms.GetSize()}});
+    auto size = compact_transforms.size() * sizeof(CompactModel);
+    memcpy(models.Map(size), compact_transforms.data(), size);
+  } else {
+    auto size = transforms.GetSize() * sizeof(glm::mat4);
+    memcpy(models.Map(size), transforms.GetWorlds(), size);
+  }
+  models.Unmap();
+
+  // The bears shadow the spot lights once they load
+  if (ray_traced_shadows) {
+    try {
+      shadow_bvh.Init(transforms.GetWorlds(), FIRST_BEAR_MODEL,
+                      scene_description.GetInstanceCount(), GetModelsCode());
+    } catch (std::exception &e) {
+      Assertf(false, "%s", e.what());
+    }
+  }
+
+  // The bears are skinned once they load
+  if (skinning_poses) {
+    try {
+      vertex_skinning.Init(transforms.GetSize(), skinning_poses);
+    } catch (std::exception &e) {
+      Assertf(false, "%s", e.what());
+    }
+  }
+}
+
+// Uploads the model matrices of the transforms that changed since the last
+// frame, once their update job is done
+void UploadInstances() {
+  PROFILE_ZONE("upload instances");
+  try {
+    jobs.Wait(transforms_update);
+  } catch (std::exception &e) {
+    Assertf(false, "%s", e.what());
+  }
+  if (!changed_models.empty())
+    gbuffer_version++;
+  if (compact_models) {
+    for (auto &range : changed_models)
+      models.SendRange(range.first * sizeof(CompactModel),
+                       &compact_transforms[range.first],
+                       range.second * sizeof(CompactModel));
+    return;
+  }
+  auto worlds = transforms.GetWorlds();
+  for (auto &range : changed_models)
+    models.SendRange(range.first * sizeof(glm::mat4), worlds + range.first,
+                     range.second * sizeof(glm::mat4));
+}
+
+// Picks on a worker the cells of the bears to load and unload around the
+// camera of the last frame, once the bear batch is uploaded
+void StartPartitionUpdate() {
+  if (world_cell_size == 0 || bear_loading.valid() || bear_draw < 0)
+    return;
+  auto point = glm::vec3(GetCullingEye());
+  float radius = stream_radius + GetCullingEye().w;
+  partition_update = jobs.Submit([point, radius] {
+    PROFILE_ZONE("world partition");
+    world_partition.Update(point, radius, MAX_CELL_LOADS_PER_FRAME);
+  });
+}
+
+// Removes the bears of the cells the partition unloaded from the batch, and
+// adds the ones of the cells it loaded
+void ApplyWorldPartition() {
+  if (!partition_update)
+    return;
+  PROFILE_ZONE("apply world partition");
+  try {
+    jobs.Wait(partition_update);
+  } catch (std::exception &e) {
+    Assertf(false, "%s", e.what());
+  }
+  partition_update.reset();
+  for (int cell : world_partition.GetUnloads()) {
+    for (int instance : cell_instances[cell])
+      bear_batch.RemoveInstance(instance);
+    cell_instances[cell].clear();
+  }
+  for (int cell : world_partition.GetLoads()) {
+    for (int bear : world_partition.GetItems(cell))
+      cell_instances[cell].push_back(
+          bear_batch.AddInstance(bear_draw, FIRST_BEAR_MODEL + bear));
+  }
+  if (!world_partition.GetLoads().empty() ||
+      !world_partition.GetUnloads().empty())
+    gbuffer_version++;
+}
+
+// Loads the meshes and draws the ground and the bears in a single batch
+// Creates the ground draw, and starts loading the bears in the background
+void CreateDraws() {
+  LoadGround();
+  scene.AddDraw({ground_mesh}, GROUND_MATERIAL, GROUND_MODEL, 1);
+  try {
+    uploads.Init(UPLOAD_BYTES_PER_FRAME, frames_in_flight);
+    if (upload_thread) {
+      uploads.StartThread([](bool current) {
+        glfwMakeContextCurrent(current ? loader_window : nullptr);
+      });
+    }
+    // The culling reads the models in their layout
+    for (auto batch : {&scene, &bear_batch, &decal_batch})
+      batch->SetModelsCode(GetModelsCode());
+    // Every instance is drawn once per view
+    if (GetViewCount() > 1) {
+      float radius = GetCullingEye().w;
+      scene.SetViews(GetViewCount(), radius);
+      bear_batch.SetViews(GetViewCount(), radius);
+    }
+    scene.Upload();
+    if (n_decals) {
+      // The decals follow the bears in the models, and have no material
+      LoadDecalBox();
+      int first_decal_model =
+          FIRST_BEAR_MODEL + scene_description.GetInstanceCount();
+      decal_batch.AddDraw({decal_mesh}, 0, first_decal_model, n_decals);
+      decal_batch.Upload();
+    }
+    depth_pyramid.Init(msaa_samples);
+    if (occlusion_queries) {
+      bear_boxes.Init(FIRST_BEAR_MODEL, scene_description.GetInstanceCount(),
+                      BEARS_PER_BOX);
+      bear_batch.SetBoxVisibility(bear_boxes.GetBuffer(),
+                                  bear_boxes.GetFirstModel(),
+                                  bear_boxes.GetModelsPerBox(),
+                                  bear_boxes.GetBoxCount());
+    }
+  } catch (std::exception &e) {
+    Assertf(false, "%s", e.what());
+  }
+  bear_loading = std::async(std::launch::async, LoadBears);
+}
+
+// Sends the bindless handles of the diffuse maps, one at least so that the
+// buffer exists
+void SendDiffuseHandles() {
+  // layout (std430) readonly buffer DiffuseHandlesBlock {
+  //     uvec2 diffuse_handles[];
+  // };
+  device->CreateBuffer(&diffuse_handles, "diffuse handles",
+                       UniformBuffer::STORAGE, UniformBuffer::STATIC);
+  auto handles = diffuse_maps.GetHandles();
+  if (handles.empty())
+    handles.push_back(0);
+  for (auto handle : handles) {
+    diffuse_handles.Add((unsigned int)handle);
+    diffuse_handles.Add((unsigned int)(handle >> 32));
+  }
+  diffuse_handles.SendToDevice();
+}
+
+// Uploads the bear batch through the queue once its worker is done, and
+// copies the next part of the queued uploads
+void UpdateLoading() {
+  PROFILE_ZONE("update loading");
+  using namespace std::chrono;
+  if (bear_loading.valid() &&
+      bear_loading.wait_for(seconds(0)) == std::future_status::ready) {
+    try {
+      bear_loading.get();
+      printf("bears loaded in the background %.1f ms after the start\n",
+             MillisecondsSince(startup_begin));
+      AddMaterials(bear_materials, bear_diffuse_maps);
+      if (virtual_textures) {
+        virtual_maps.Upload(&uploads);
+      } else {
+        diffuse_maps.Upload(&uploads);
+        if (bindless_maps)
+          SendDiffuseHandles();
+      }
+      bear_batch.Upload(&uploads);
+      if (ray_traced_shadows)
+        shadow_bvh.Upload();
+    } catch (std::exception &e) {
+      Assertf(false, "%s", e.what());
+    }
+  }
+  if (virtual_textures)
+    virtual_maps.Update();
+  uploads.Update();
+}
+
+// Checks if the bears are loaded and their meshes and maps are on the gpu
+bool AreBearsReady() {
+  bool maps_ready =
+      virtual_textures ? virtual_maps.IsReady() : diffuse_maps.IsReady();
+  return !bear_loading.valid() && bear_batch.IsReady() && maps_ready;
+}
+
+// Obtains the batches that can be drawn; the others are still loading
+FrameVector<MeshBatch *> GetReadyBatches() {
+  FrameVector<MeshBatch *> batches = {&scene};
+  if (AreBearsReady())
+    batches.push_back(&bear_batch);
+  return batches;
+}
+
+// Checks if the frame of the loaded scene is complete: every batch drawn and
+// no texture streaming
+bool IsSceneComplete() {
+  if (bear_loading.valid() || !uploads.IsEmpty())
+    return false;
+  if (virtual_textures && virtual_maps.IsStreaming())
+    return false;
+  return GetReadyBatches().size() == 2;
+}
+
+// Obtains the transforms from the view of the camera to the clip spaces the
+// frame is culled for, one per view
+FrameVector<glm::mat4> GetCullingProjections() {
+  if (GetViewCount() == 1)
+    return {projection};
+  return FrameVector<glm::mat4>(view_to_clips.begin(), view_to_clips.end());
+}
+
+// Culls the instances of a pass against the frustum and the depth pyramid and
+// picks the level of detail of each bear from its projected size, on the gpu;
+// the ready batches by default
+void CullInstances(
+    MeshBatch::Pass pass,
+    const FrameVector<MeshBatch *> &batches = GetReadyBatches()) {
+  PROFILE_ZONE("cull instances");
+  float pixels_per_unit =
+      framebuffer.GetHeight() / (2 * std::tan(glm::radians(FOVY) / 2));
+  // The tiles of the pyramid of several views are different views, and the
+  // occlusion queries leave it unbuilt
+  bool no_pyramid = GetViewCount() > 1 || occlusion_queries;
+  auto pyramid = no_pyramid ? nullptr : &depth_pyramid;
+  auto view_projections = GetCullingProjections();
+  for (auto &view_projection : view_projections)
+    view_projection = view_projection * view;
+  auto culling_eye = glm::vec3(GetCullingEye());
+  // The early pass draws most of the frame, the nearest instances first
+  if (sort_instances && pass == MeshBatch::EARLY_PASS) {
+    PROFILE_ZONE("sort instances");
+    glm::vec3 direction(-view[0][2], -view[1][2], -view[2][2]);
+    for (auto batch : batches)
+      batch->SortInstances(eye, direction, transforms.GetWorlds());
+  }
+  ShaderProgram::BindStorageBuffer(buffer_bindings::MODELS, models.GetId());
+  for (auto batch : batches)
+    batch->Cull(pass, view_projections.data(), view_projections.size(),
+                culling_eye, FULL_DETAIL_RADIUS / pixels_per_unit, pyramid);
+}
+
+// Draws the culled instances of a pass of every batch
+void DrawBatches(MeshBatch::Pass pass) {
+  for (auto batch : GetReadyBatches())
+    batch->DrawAll(pass);
+}
+
+// Picks the shadow maps rendered in this frame and sends the shadows of the
+// lights, which are moved to view space with them; the maps are stale once
+// the models move or a batch is loaded
+void UpdateShadows() {
+  int n_batches = GetReadyBatches().size();
+  bool geometry_changed =
+      !changed_models.empty() || n_batches != shadowed_batches || skin_posed;
+  shadowed_batches = n_batches;
+  // Without the shadows pass the new tiles stay unshadowed
+  int budget = render_graph.IsPassEnabled("shadows") ? shadow_budget : 0;
+  float pixels_per_unit =
+      framebuffer.GetHeight() / (2 * std::tan(glm::radians(FOVY) / 2));
+  shadow_updates =
+      shadow_atlas.Update(rotation, projection * view, eye, pixels_per_unit,
+                          budget, geometry_changed);
+  light_transform.SetShadows(shadow_atlas.GetShadows(view));
+}
+
+// Streams the sun and its cascades in the view of the camera
+void SendSun() {
+  if (!sun.GetId()) {
+    device->CreateBuffer(&sun, "sun", UniformBuffer::UNIFORM,
+                         UniformBuffer::STREAM, frames_in_flight * n_windows);
+  } else
+    sun.Clear();
+  auto block = sun_shadows.GetBlock(view);
+  sun.AddArray(&block, 1);
+  sun.SendToDevice();
+}
+
+// Fits the cascades of the sun to the view and picks the ones rendered in
+// this frame, none without the cascades pass
+void UpdateSun() {
+  bool render = render_graph.IsPassEnabled("cascades");
+  sun_updates = sun_shadows.Update(view, projection, Z_NEAR,
+                                   SUN_SHADOW_DISTANCE, render);
+  SendSun();
+}
+
+// Moves the lights to view space and keeps the visible ones
+void UpdateLights() {
+  PROFILE_ZONE("update lights");
+  InterpolateSimulation();
+  auto ground = glm::transpose(glm::inverse(view)) *
+                glm::vec4(0, 1, 0, -scene_description.GetGroundHeight());
+  if (shadow_budget)
+    UpdateShadows();
+  if (ray_traced_shadows)
+    shadow_bvh.Refit(&models, view);
+  if (sun_period)
+    UpdateSun();
+  auto projections = GetCullingProjections();
+  if (light_lod_radius > 0) {
+    float pixels_per_unit =
+        framebuffer.GetHeight() / (2 * std::tan(glm::radians(FOVY) / 2));
+    light_transform.SetMinSpecularRadius(light_lod_radius / pixels_per_unit);
+  }
+  light_transform.Update(view * rotation, projections.data(),
+                         projections.size(), ground);
+  if (light_swarm_size)
+    light_swarm.Update(swarm_time, view, &lights);
+}
+
+// Checks the blocks of the geometry pass against the structures copied to them
+void CheckGeometryPassBlocks() {
+  try {
+    auto camera_block = geompass_shader.GetUniformBlockInfo("CameraBlock");
+    const char *members[] = {"view", "projection", "view_projection"};
+    for (int i = 0; i < 3; ++i)
+      ShaderProgram::CheckBlockMember(camera_block, members[i],
+                                      CameraMatricesLayout::Offset(i));
+    auto models_block = geompass_shader.GetStorageBlockInfo("ModelsBlock");
+    if (compact_models) {
+      const char *model_members[] = {"models[0].position_scale",
+                                     "models[0].rotation"};
+      for (int i = 0; i < 2; ++i)
+        ShaderProgram::CheckBlockMember(models_block, model_members[i],
+                                        CompactModelLayout::Offset(i),
+                                        sizeof(CompactModel));
+    } else {
+      ShaderProgram::CheckBlockMember(models_block, "models[0]", 0,
+                                      sizeof(glm::mat4));
+    }
+    auto draws_block = geompass_shader.GetStorageBlockInfo("DrawsBlock");
+    const char *draw_members[] = {"draws[0].dequantization",
+                                  "draws[0].material_id",
+                                  "draws[0].first_instance"};
+    for (int i = 0; i < 3; ++i)
+      ShaderProgram::CheckBlockMember(draws_block, draw_members[i],
+                                      DrawLayout::Offset(i),
+                                      sizeof(MeshBatch::Draw));
+  } catch (std::exception &e) {
+    Assertf(false, "%s", e.what());
+  }
+}
+
+// Streams the camera matrices of the current frame
+void UpdateCamera() {
+  // Buffer configuration:
+  // layout (std140) uniform CameraBlock {
+  //     mat4 view;
+  //     mat4 projection;
+  //     mat4 view_projection;
+  // };
+
+  if (!camera.GetId()) {
+    device->CreateBuffer(&camera, "camera", UniformBuffer::UNIFORM,
+                         UniformBuffer::STREAM, frames_in_flight * n_windows);
+  } else
+    camera.Clear();
+
+  CameraMatrices matrices = {view, projection, projection * view};
+  camera.AddArray(&matrices, 1);
+
+  camera.SendToDevice();
+}
+
+// Streams the transforms of the views from the view of the camera: the eyes
+// move along its x axis, and the cameras of the wall have their own views
+void UpdateViews() {
+  // Buffer configuration:
+  // layout (std140) uniform ViewsBlock {
+  //     mat4 view_to_clip[VIEWS];
+  //     mat4 clip_to_view[VIEWS];
+  // };
+
+  if (GetViewCount() == 1)
+    return;
+  view_to_clips.clear();
+  if (eye_distance > 0) {
+    for (float side : {1.0f, -1.0f}) {
+      auto offset = glm::vec3(side * eye_distance / 2, 0, 0);
+      view_to_clips.push_back(projection *
+                              glm::translate(glm::mat4(1), offset));
+    }
+  } else {
+    auto cameras = scene_description.GetCameras();
+    auto inv_view = glm::inverse(view);
+    for (int i = 0; i < GetViewCount(); ++i) {
+      auto &config = cameras[i];
+      view_to_clips.push_back(
+          projection * glm::lookAt(config.eye, config.center, config.up) *
+          inv_view);
+    }
+  }
+  FrameVector<glm::mat4> clip_to_views;
+  for (auto &view_to_clip : view_to_clips)
+    clip_to_views.push_back(glm::inverse(view_to_clip));
+
+  if (!views.GetId()) {
+    device->CreateBuffer(&views, "views", UniformBuffer::UNIFORM,
+                         UniformBuffer::STREAM, frames_in_flight * n_windows);
+  } else
+    views.Clear();
+  views.AddArray(view_to_clips.data(), view_to_clips.size());
+  views.AddArray(clip_to_views.data(), clip_to_views.size());
+  views.SendToDevice();
+}
+
+// Binds the transforms of the views, with several of them
+void BindViews() {
+  if (GetViewCount() > 1)
+    ShaderProgram::BindUniformBuffer(buffer_bindings::VIEWS, views.GetId(),
+                                     views.GetOffset(), views.GetSize());
+}
+
+// Moves the camera along the closed path through the cameras of the scene,
+// a lap over the frames of the benchmark
+void UpdateBenchmarkCamera() {
+  auto cameras = scene_description.GetCameras();
+  int n_cameras = scene_description.GetCameraCount();
+  double t = std::max(benchmark_frame, 0) * (double)n_cameras /
+             benchmark_frames;
+  int k = (int)t % n_cameras;
+  float alpha = t - std::floor(t);
+  auto &from = cameras[k], &to = cameras[(k + 1) % n_cameras];
+  eye = glm::mix(from.eye, to.eye, alpha);
+  center = glm::mix(from.center, to.center, alpha);
+  up = glm::normalize(glm::mix(from.up, to.up, alpha));
+}
+
+// Obtains the direction of the free-fly camera
+glm::vec3 GetFlyDirection() {
+  return glm::vec3(std::cos(fly_pitch) * std::sin(fly_yaw),
+                   std::sin(fly_pitch),
+                   -std::cos(fly_pitch) * std::cos(fly_yaw));
+}
+
+// Updates the camera configuration
+void UpdateCameraConfig() {
+  if (!replay_camera_path.empty()) {
+    // The benchmark flies the path at its frame time
+    double time = benchmark_frames > 0
+                      ? std::max(benchmark_frame, 0) * frame_time
+                      : camera_time;
+    auto pose = camera_path.Sample(time);
+    eye = pose.eye;
+    center = pose.center;
+    up = pose.up;
+    return;
+  }
+  if (benchmark_frames > 0) {
+    UpdateBenchmarkCamera();
+    return;
+  }
+  if (fly_camera) {
+    center = eye + GetFlyDirection();
+    up = glm::vec3(0, 1, 0);
+    return;
+  }
+  auto &config = scene_description.GetCameras()[camera_config];
+  eye = config.eye;
+  center = config.center;
+  up = config.up;
+}
+
+// Obtains the radical inverse of a number in a base, the Halton sequence
+float Halton(int index, int base) {
+  float fraction = 1.0f;
+  float result = 0.0f;
+  for (; index > 0; index /= base) {
+    fraction /= base;
+    result += fraction * (index % base);
+  }
+  return result;
+}
+
+// Obtains the sub-pixel jitter of a frame in G-buffer pixels, from the Halton
+// (2, 3) sequence so the samples of consecutive frames are spread over the
+// pixel; an upscaled pixel takes as many more samples as it has G-buffer
+// pixels less
+glm::vec2 GetTaaJitter(int frame) {
+  int samples = (int)std::ceil(TAA_SAMPLES / (render_scale * render_scale));
+  int index = frame % samples + 1;
+  return glm::vec2(Halton(index, 2), Halton(index, 3)) - 0.5f;
+}
+
+// Offsets a projection by a jitter in G-buffer pixels
+glm::mat4 JitterProjection(const glm::mat4 &projection, glm::vec2 jitter) {
+  auto jittered = projection;
+  jittered[2][0] += jitter.x * 2.0f / framebuffer.GetWidth();
+  jittered[2][1] += jitter.y * 2.0f / framebuffer.GetHeight();
+  return jittered;
+}
+
+// Updates the variables that depend on the view and projection; the camera is
+// only rebuilt when it changed, and streamed again then or every frame with
+// the jitter of the temporal antialiasing
+void UpdateMatrices() {
+  PROFILE_ZONE("update matrices");
+  last_view_projection = unjittered_projection * view;
+  if (camera_dirty) {
+    UpdateCameraConfig();
+    view = glm::lookAt(eye, center, up);
+    // Each view has a tile of the window
+    auto grid = glm::vec2(GetViewGrid());
+    auto ratio = (window_w / grid.x) / (window_h / grid.y);
+    unjittered_projection =
+        glm::perspective(glm::radians(FOVY), ratio, Z_NEAR, Z_FAR);
+    projection = unjittered_projection;
+  }
+  // The jitter changes the projection of every frame
+  if (taa) {
+    taa_jitter = GetTaaJitter(taa_frame++);
+    projection = JitterProjection(unjittered_projection, taa_jitter);
+  }
+  if (camera_dirty || taa) {
+    UpdateCamera();
+    UpdateViews();
+  }
+  camera_dirty = false;
+  if (!record_camera_path.empty())
+    camera_path.Add({(float)camera_time, eye, center, up});
+}
+
+// Starts propagating the transforms on a worker, while the frame copies the
+// queued uploads; UploadInstances() waits for them
+void StartTransformsUpdate() {
+  transforms_update =
+      jobs.Submit([] {
+        PROFILE_ZONE("transforms");
+        changed_models = transforms.Update();
+        if (compact_models)
+          CompactTransforms(changed_models);
+      });
+}
+
+// Loads the global opengl configuration
+void LoadGlobalConfiguration() {
+  glEnable(GL_DEPTH_TEST);
+  glEnable(GL_MULTISAMPLE);
+}
+
+// Binds the diffuse maps of the geometry pass
+void BindDiffuseMaps() {
+  if (virtual_textures)
+    virtual_maps.Bind(&geompass_shader, DIFFUSE_MAPS_UNIT);
+  else if (!bindless_maps)
+    diffuse_maps.Bind(DIFFUSE_MAPS_UNIT);
+  else if (diffuse_handles.GetId())
+    ShaderProgram::BindStorageBuffer(
+        buffer_bindings::DIFFUSE_HANDLES, diffuse_handles.GetId(),
+        diffuse_handles.GetOffset(), diffuse_handles.GetSize());
+}
+
+// Bakes the impostors of the bears from their full detail level, and culls
+// the distant ones to them from then on
+void BakeImpostors() {
+  PROFILE_ZONE("bake impostors");
+  GLDebug::PushGroup("bake impostors");
+  ShaderProgram::BindStorageBuffer(buffer_bindings::MATERIALS,
+                                   materials.GetId(), materials.GetOffset(),
+                                   materials.GetSize());
+  BindDiffuseMaps();
+  // The bears are the only draw of their batch
+  auto sphere = bear_batch.GetBoundingSphere(bear_lods[0]);
+  bear_impostors.Bake(&bear_batch, 0, 0, sphere);
+  bear_batch.SetImpostorAngle(sphere.w / impostor_distance);
+  GLDebug::PopGroup();
+}
+
+// Draws the impostors of the distant bears culled in a pass, with the
+// program of the geometry pass left disabled
+void DrawImpostors(MeshBatch::Pass pass) {
+  if (!bear_impostors.IsBaked())
+    return;
+  bear_impostors.Enable();
+  bear_batch.DrawImpostors(pass);
+}
+
+// Binds the camera and the instances transformed by the geometry shaders
+void BindInstances() {
+  ShaderProgram::BindUniformBuffer(buffer_bindings::CAMERA, camera.GetId(),
+                                   camera.GetOffset(), camera.GetSize());
+  BindViews();
+  ShaderProgram::BindStorageBuffer(buffer_bindings::MODELS, models.GetId());
+}
+
+// Splits the G-buffer between the viewports of the tiles of the views, which
+// the geometry shaders pick per instance, or joins them back
+void SetViewports(bool split) {
+  if (GetViewCount() == 1)
+    return;
+  int width = framebuffer.GetWidth(), height = framebuffer.GetHeight();
+  if (split) {
+    auto grid = GetViewGrid();
+    float w = (float)width / grid.x, h = (float)height / grid.y;
+    for (int v = 0; v < GetViewCount(); ++v)
+      glViewportIndexedf(v, v % grid.x * w, v / grid.x * h, w, h);
+  } else {
+    glViewport(0, 0, width, height);
+  }
+}
+
+// Rebuilds the depth pyramid for the late pass, but with several views,
+// whose culling has none
+void BuildDepthPyramid() {
+  if (GetViewCount() == 1)
+    depth_pyramid.Build(&framebuffer, projection * view);
+}
+
+// Renders the depth of both culling passes before the geometry pass
+void RenderDepthPrepass() {
+  PROFILE_ZONE("depth prepass");
+  glEnable(GL_DEPTH_TEST);
+  glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+  depth_prepass_shader.Enable();
+  BindInstances();
+  SetViewports(true);
+  DrawBatches(MeshBatch::EARLY_PASS);
+
+  // Same as in the geometry pass without pre-pass
+  BuildDepthPyramid();
+  CullInstances(MeshBatch::LATE_PASS);
+  depth_prepass_shader.Enable();
+  DrawBatches(MeshBatch::LATE_PASS);
+  SetViewports(false);
+  glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+}
+
+// Draws the instances culled for the geometry pass again, adding up their
+// fragments and the lanes of their quads without a depth test; the impostors
+// aren't counted
+void RenderOverdraw() {
+  PROFILE_ZONE("overdraw");
+  glDisable(GL_DEPTH_TEST);
+  glDisable(GL_STENCIL_TEST);
+  glEnable(GL_BLEND);
+  glBlendFunc(GL_ONE, GL_ONE);
+  overdraw_shader.Enable();
+  BindInstances();
+  DrawBatches(MeshBatch::EARLY_PASS);
+  // The occlusion queries leave the late pass of the next frame
+  if (!occlusion_queries)
+    DrawBatches(MeshBatch::LATE_PASS);
+  glDisable(GL_BLEND);
+}
+
+// Shows the heatmap of the overdraw over the output
+void ShowOverdraw() {
+  PROFILE_ZONE("overdraw view");
+  glDisable(GL_DEPTH_TEST);
+  glDisable(GL_STENCIL_TEST);
+  overdraw_view_shader.Enable();
+  // Fetched without filtering
+  GLState::BindTexture(0, render_graph.GetTexture("overdraw"));
+  int width, height;
+  render_graph.GetSize("overdraw", &width, &height);
+  overdraw_view_shader.SetUniform(
+      "counts_pixel_size",
+      glm::vec2((float)width / window_w, (float)height / window_h));
+  overdraw_view_shader.SetUniform("show_quads", show_quad_overdraw);
+  screen_triangle.DrawArrays(GL_TRIANGLES, 3);
+}
+
+// Renders the shadow maps of the spot lights picked for the frame, each
+// culled from its light
+void RenderShadows() {
+  PROFILE_ZONE("shadows");
+  shadow_atlas.BeginTiles();
+  for (int light : shadow_updates) {
+    auto &tile = shadow_atlas.GetTile(light);
+    float pixels_per_unit =
+        tile.size / (2 * std::tan(glm::radians(FOVY) / 2));
+    ShaderProgram::BindStorageBuffer(buffer_bindings::MODELS, models.GetId());
+    for (auto batch : GetReadyBatches())
+      batch->Cull(MeshBatch::SHADOW_PASS, tile.view_projection, tile.position,
+                  FULL_DETAIL_RADIUS / pixels_per_unit, nullptr);
+    shadow_atlas.BeginTile(light);
+    shadow_shader.Enable();
+    shadow_shader.SetUniform("light_view_projection", tile.view_projection);
+    BindInstances();
+    DrawBatches(MeshBatch::SHADOW_PASS);
+  }
+  shadow_atlas.EndTiles();
+}
+
+// Renders the cascades of the sun picked for the frame, each culled from its
+// box with the levels of detail of the camera
+void RenderSunShadows() {
+  PROFILE_ZONE("cascades");
+  float pixels_per_unit =
+      framebuffer.GetHeight() / (2 * std::tan(glm::radians(FOVY) / 2));
+  sun_shadows.BeginCascades();
+  for (int i : sun_updates) {
+    auto &cascade = sun_shadows.GetCascade(i);
+    ShaderProgram::BindStorageBuffer(buffer_bindings::MODELS, models.GetId());
+    for (auto batch : GetReadyBatches())
+      batch->Cull(MeshBatch::SHADOW_PASS, cascade.view_projection, eye,
+                  FULL_DETAIL_RADIUS / pixels_per_unit, nullptr);
+    sun_shadows.BeginCascade(i);
+    shadow_shader.Enable();
+    shadow_shader.SetUniform("light_view_projection", cascade.view_projection);
+    BindInstances();
+    DrawBatches(MeshBatch::SHADOW_PASS);
+  }
+  sun_shadows.EndCascades();
+}
+
+// Queries the boxes of the bears against the depth of the early pass, for the
+// culling of the next frame; the stencil is kept
+void QueryBearBoxes() {
+  if (!AreBearsReady())
+    return;
+  PROFILE_ZONE("occlusion queries");
+  glStencilMask(0);
+  bear_boxes.Query(transforms.GetWorlds(),
+                   bear_batch.GetBoundingSphere(bear_lods[0]),
+                   projection * view, eye);
+  glStencilMask(0xFF);
+}
+
+// Renders the geometry pass
+void RenderGeometry() {
+  PROFILE_ZONE("geometry");
+  glEnable(GL_DEPTH_TEST);
+  if (UsesLightBuffer()) {
+    glEnable(GL_STENCIL_TEST);
+    glStencilFunc(GL_ALWAYS, GEOMETRY_STENCIL_BIT, 0xFF);
+    glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
+  }
+  // With the pre-pass, the depth is final and only the nearest fragments,
+  // transformed the same way, are shaded
+  if (depth_prepass) {
+    glDepthFunc(GL_EQUAL);
+    glDepthMask(GL_FALSE);
+  }
+  geompass_shader.Enable();
+  BindInstances();
+  ShaderProgram::BindStorageBuffer(buffer_bindings::MATERIALS,
+                                   materials.GetId(), materials.GetOffset(),
+                                   materials.GetSize());
+  BindDiffuseMaps();
+  if (hud_visible)
+    hud.BeginPrimitives();
+  SetViewports(true);
+  DrawBatches(MeshBatch::EARLY_PASS);
+  DrawImpostors(MeshBatch::EARLY_PASS);
+
+  // The instances hidden by the last frame may be visible behind the early
+  // draws, which the pyramid is rebuilt from; building it takes the unit of
+  // the diffuse maps, and the impostors the program. The pre-pass has
+  // already culled the late pass. The occlusion queries find them for the
+  // next frame instead.
+  if (occlusion_queries) {
+    QueryBearBoxes();
+  } else {
+    if (!depth_prepass) {
+      BuildDepthPyramid();
+      CullInstances(MeshBatch::LATE_PASS);
+    }
+    geompass_shader.Enable();
+    BindDiffuseMaps();
+    DrawBatches(MeshBatch::LATE_PASS);
+    DrawImpostors(MeshBatch::LATE_PASS);
+  }
+  SetViewports(false);
+  if (hud_visible)
+    hud.EndPrimitives();
+
+  glDepthFunc(GL_LESS);
+  glDepthMask(GL_TRUE);
+  glDisable(GL_STENCIL_TEST);
+  if (picking) {
+    int attachment = gbuffer_layout.GetAttachments().size();
+    object_picking.Copy(framebuffer.GetTextures()[attachment],
+                        framebuffer.GetWidth(), framebuffer.GetHeight());
+  }
+}
+
+// Draws the culled instances of a pass of every batch into the visibility
+// buffer, tagged with the pass and the index of the batch
+void DrawVisibility(MeshBatch::Pass pass) {
+  auto batches = GetReadyBatches();
+  for (size_t i = 0; i < batches.size(); ++i) {
+    unsigned int tag = (pass == MeshBatch::LATE_PASS ? 1u << 31 : 0u) |
+                       (unsigned int)i << 30;
+    visibility_shader.SetUniform("visibility_tag", (int)tag);
+    batches[i]->DrawAll(pass);
+  }
+}
+
+// Renders the triangles of both culling passes into the visibility buffer,
+// culled the same way as the geometry pass
+void RenderVisibility() {
+  PROFILE_ZONE("visibility");
+  glEnable(GL_DEPTH_TEST);
+  if (UsesLightBuffer()) {
+    glEnable(GL_STENCIL_TEST);
+    glStencilFunc(GL_ALWAYS, GEOMETRY_STENCIL_BIT, 0xFF);
+    glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
+  }
+  visibility_shader.Enable();
+  BindInstances();
+  if (hud_visible)
+    hud.BeginPrimitives();
+  DrawVisibility(MeshBatch::EARLY_PASS);
+
+  depth_pyramid.Build(&framebuffer, projection * view);
+  CullInstances(MeshBatch::LATE_PASS);
+  visibility_shader.Enable();
+  DrawVisibility(MeshBatch::LATE_PASS);
+  if (hud_visible)
+    hud.EndPrimitives();
+  glDisable(GL_STENCIL_TEST);
+}
+
+// Writes the G-buffer from the triangles of the visibility buffer, with one
+// full-screen pass per batch that only keeps its own pixels
+void RenderVisibilityResolve() {
+  PROFILE_ZONE("resolve");
+  glDisable(GL_DEPTH_TEST);
+  visibility_resolve_shader.Enable();
+  BindInstances();
+  ShaderProgram::BindStorageBuffer(buffer_bindings::MATERIALS,
+                                   materials.GetId(), materials.GetOffset(),
+                                   materials.GetSize());
+  BindDiffuseMaps();
+  unsigned int textures[] = {render_graph.GetTexture("visibility"),
+                             framebuffer.GetDepthTexture()};
+  unsigned int samplers[] = {visibility_framebuffer.GetSampler(),
+                             framebuffer.GetSampler()};
+  GLState::BindTextures(1, 2, textures);
+  GLState::BindSamplers(1, 2, samplers);
+  auto size = glm::vec2(framebuffer.GetWidth(), framebuffer.GetHeight());
+  visibility_resolve_shader.SetUniform("gbuffer_size", size);
+  auto batches = GetReadyBatches();
+  for (size_t i = 0; i < batches.size(); ++i) {
+    bool short_indices = batches[i]->GetIndexType() == GL_UNSIGNED_SHORT;
+    batches[i]->BindVisibilityBuffers();
+    visibility_resolve_shader.SetUniform("batch_tag", (int)(i << 30));
+    visibility_resolve_shader.SetUniform("short_indices", (int)short_indices);
+    screen_triangle.DrawArrays(GL_TRIANGLES, 3);
+  }
+  glEnable(GL_DEPTH_TEST);
+}
+
+// Blends the decals into the normals and the albedo of the G-buffer, culled
+// against the pyramid of the geometry pass; the other channels are masked
+void RenderDecals() {
+  PROFILE_ZONE("decals");
+  CullInstances(MeshBatch::EARLY_PASS, {&decal_batch});
+  auto masks = gbuffer_layout.GetDecalMasks();
+  for (size_t i = 0; i < masks.size(); ++i) {
+    auto &mask = masks[i];
+    glColorMaski(i, mask.r, mask.g, mask.b, mask.a);
+    glEnablei(GL_BLEND, i);
+    glBlendFunci(i, GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+  }
+  if (picking)
+    glColorMaski(masks.size(), GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+  // The back faces behind the surface keep off the pixels in front of the
+  // boxes; the depth clamp keeps the ones past the far plane
+  glEnable(GL_DEPTH_TEST);
+  glDepthFunc(GL_GEQUAL);
+  glDepthMask(GL_FALSE);
+  glEnable(GL_DEPTH_CLAMP);
+  glEnable(GL_CULL_FACE);
+  glCullFace(GL_FRONT);
+  decal_shader.Enable();
+  BindInstances();
+  GLState::BindTexture(0, framebuffer.GetDepthTexture());
+  decal_shader.SetUniform("inv_projection", glm::inverse(projection));
+  auto size = glm::vec2(framebuffer.GetWidth(), framebuffer.GetHeight());
+  decal_shader.SetUniform("gbuffer_size", size);
+  decal_shader.SetUniform("decal_half_size", DECAL_HALF_SIZE);
+  decal_batch.DrawAll(MeshBatch::EARLY_PASS);
+
+  glCullFace(GL_BACK);
+  glDisable(GL_CULL_FACE);
+  glDisable(GL_DEPTH_CLAMP);
+  glDepthMask(GL_TRUE);
+  glDepthFunc(GL_LESS);
+  for (size_t i = 0; i < masks.size(); ++i)
+    glDisablei(GL_BLEND, i);
+  glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+}
+
+// Binds the G-buffer textures and the uniforms needed to read them
+void BindGBuffer(ShaderProgram *shader) {
+  // The samplers of the generated code have fixed units; the framebuffer
+  // fetch reads the attachments it renders into instead
+  if (!framebuffer_fetch)
+    framebuffer.BindTextures(0);
+  shader->SetUniform("inv_projection", glm::inverse(projection));
+  BindViews();
+  auto size = glm::vec2(framebuffer.GetWidth(), framebuffer.GetHeight());
+  shader->SetUniform("gbuffer_size", size);
+}
+
+// Binds the materials and the point and spot lights read by the lighting
+void BindLights() {
+  ShaderProgram::BindStorageBuffer(buffer_bindings::MATERIALS,
+                                   materials.GetId(), materials.GetOffset(),
+                                   materials.GetSize());
+  ShaderProgram::BindStorageBuffer(buffer_bindings::LIGHTS, lights.GetId(),
+                                   lights.GetOffset(), lights.GetSize());
+  ShaderProgram::BindStorageBuffer(buffer_bindings::SPOT_LIGHTS,
+                                   light_transform.GetBuffer());
+  // The atlas uses the unit after the ambient occlusion
+  if (shadow_budget) {
+    ShaderProgram::BindStorageBuffer(buffer_bindings::SPOT_SHADOWS,
+                                     light_transform.GetShadowBuffer());
+    shadow_atlas.Bind(gbuffer_layout.GetAttachments().size() + 2);
+  }
+  if (ray_traced_shadows)
+    shadow_bvh.Bind();
+  // The maps of the sun use the unit after the atlas
+  if (sun_period) {
+    ShaderProgram::BindUniformBuffer(buffer_bindings::SUN, sun.GetId(),
+                                     sun.GetOffset(), sun.GetSize());
+    sun_shadows.Bind(gbuffer_layout.GetAttachments().size() + 3);
+  }
+}
+
+// Obtains the G-buffer pixels per pixel of the scaled lighting
+glm::vec2 GetLitPixelSize() {
+  int width, height;
+  render_graph.GetSize("lit", &width, &height);
+  return glm::vec2((float)framebuffer.GetWidth() / width,
+                   (float)framebuffer.GetHeight() / height);
+}
+
+// Binds the ambient occlusion read by the lighting, if any, after the
+// G-buffer textures (GBUFFER_TEXTURES)
+void BindAmbientOcclusion(ShaderProgram *shader) {
+  if (!ssao)
+    return;
+  // Without the ssao pass the occlusion reads the G-buffer with no weight
+  auto texture = render_graph.GetTexture("occlusion");
+  bool computed = texture != render_graph.GetTexture("gbuffer");
+  int unit = gbuffer_layout.GetAttachments().size() + 1;
+  auto sampler = framebuffer.GetSampler();
+  GLState::BindTexture(unit, texture);
+  GLState::BindSamplers(unit, 1, &sampler);
+  shader->SetUniform("occlusion_weight", computed ? 1.0f : 0.0f);
+}
+
+// Shades the pixels with one of the lighting shaders
+void ShadePixels(ShaderProgram *shader) {
+  shader->Enable();
+  BindGBuffer(shader);
+  BindAmbientOcclusion(shader);
+  if (lighting_scale < 1.0f)
+    shader->SetUniform("lit_pixel_size", GetLitPixelSize());
+  if (lighting_mode == LIGHTING_CLUSTERED)
+    light_clusters.Bind(shader);
+  if (lighting_mode == LIGHTING_STOCHASTIC ||
+      lighting_mode == LIGHTING_LIGHTCUTS)
+    light_tree.Bind(shader, view * rotation, light_samples, light_seed);
+  if (lighting_mode == LIGHTING_LIGHTCUTS)
+    shader->SetUniform("light_cut_error", light_cut_error);
+  // The fog uses the unit after the maps of the sun
+  if (fog_density > 0)
+    volumetric_fog.Bind(shader, gbuffer_layout.GetAttachments().size() + 4);
+  // The ground cache uses the unit after the fog
+  if (ground_cache)
+    ground_light_cache.Bind(shader, gbuffer_layout.GetAttachments().size() + 5,
+                            view);
+  BindLights();
+  screen_triangle.DrawArrays(GL_TRIANGLES, 3);
+}
+
+// Shades only the pixels with geometry, the background keeps the clear color;
+// the planar tiles may be shaded at a coarse rate
+void ShadeGeometryPixels(ShaderProgram *shader) {
+  if (shading_rate) {
+    shading_rates.Build(&framebuffer, glm::inverse(projection));
+    shading_rates.Enable();
+  }
+  glEnable(GL_STENCIL_TEST);
+  glStencilFunc(GL_EQUAL, GEOMETRY_STENCIL_BIT, GEOMETRY_STENCIL_BIT);
+  glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
+  ShadePixels(shader);
+  glDisable(GL_STENCIL_TEST);
+  if (shading_rate)
+    shading_rates.Disable();
+}
+
+// Shades the lit image of the lighting pass, for the lights of this frame
+void ShadeLighting() {
+  if (lighting_mode == LIGHTING_CLUSTERED)
+    light_clusters.Update(projection, Z_NEAR, Z_FAR, framebuffer.GetWidth(),
+                          framebuffer.GetHeight(), &lights,
+                          light_transform.GetBuffer());
+  if (fog_density > 0) {
+    PROFILE_ZONE("fog");
+    BindLights();
+    volumetric_fog.Compute(projection, fog_density, &light_clusters);
+  }
+  // The fog covers the background too
+  if (!msaa_samples) {
+    if (UsesLightBuffer() && !light_prepass && fog_density == 0)
+      ShadeGeometryPixels(GetLightpassShader(false));
+    else
+      ShadePixels(GetLightpassShader(false));
+    return;
+  }
+
+  // Marks the pixels whose samples differ in the stencil buffer
+  glEnable(GL_STENCIL_TEST);
+  glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+  glStencilFunc(GL_ALWAYS, 1, 0xFF);
+  glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
+  edges_shader.Enable();
+  BindGBuffer(&edges_shader);
+  screen_triangle.DrawArrays(GL_TRIANGLES, 3);
+  glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+  glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
+
+  // Shades the first sample of the interior pixels and every sample of the
+  // edges
+  glStencilFunc(GL_EQUAL, 0, 0xFF);
+  ShadePixels(GetLightpassShader(false));
+  glStencilFunc(GL_EQUAL, 1, 0xFF);
+  ShadePixels(GetLightpassShader(true));
+  glDisable(GL_STENCIL_TEST);
+}
+
+// Compares the inputs of the lighting with the ones of the cached lit image,
+// and keeps them for the next frame; a new G-buffer, camera or lights are
+// shaded everywhere, a new count of active lights only within the screen
+// bounds of the lights turned on or off
+// Returns false if the cached image is still up to date, else the region to
+// shade again, in normalized device coordinates
+bool GetLightingRegion(glm::vec4 *region) {
+  if (bear_loading.valid() || !uploads.IsEmpty() || !shadow_updates.empty() ||
+      (virtual_textures && virtual_maps.IsStreaming()))
+    gbuffer_version++;
+  LightingKey key = {gbuffer_version, projection * view, rotation, swarm_time,
+                     light_transform.GetActiveCount()};
+  auto previous = cached_lighting;
+  bool cached = lighting_cached;
+  cached_lighting = key;
+  lighting_cached = true;
+  *region = glm::vec4(-1, -1, 1, 1);
+  if (!cached || key.gbuffer_version != previous.gbuffer_version ||
+      key.view_projection != previous.view_projection ||
+      key.rotation != previous.rotation ||
+      key.swarm_time != previous.swarm_time)
+    return true;
+  if (key.n_active_lights == previous.n_active_lights)
+    return false;
+  int first = std::min(key.n_active_lights, previous.n_active_lights);
+  int end = std::max(key.n_active_lights, previous.n_active_lights);
+  auto spots = scene_description.GetLights();
+  glm::vec4 changed(1, 1, -1, -1);
+  for (int i = first; i < end; ++i) {
+    auto position = glm::vec3(rotation * glm::vec4(spots[i].position, 1));
+    glm::vec4 rect;
+    if (!ProjectSphere(glm::vec4(position, spots[i].range),
+                       key.view_projection, &rect))
+      return true;
+    changed = glm::vec4(glm::min(glm::vec2(changed), glm::vec2(rect)),
+                        glm::max(glm::vec2(changed.z, changed.w),
+                                 glm::vec2(rect.z, rect.w)));
+  }
+  *region = glm::clamp(changed, -1.0f, 1.0f);
+  return true;
+}
+
+// Marks stale the tiles of the ground cache whose lights changed, all of
+// them once the lights turn, and shades the ones due in this frame; the
+// cached lit image is out of date after any of them
+void UpdateGroundCache() {
+  PROFILE_ZONE("ground cache");
+  int n_active = light_transform.GetActiveCount();
+  if (rotation != ground_cache_rotation) {
+    ground_light_cache.Invalidate();
+  } else if (n_active != ground_cache_lights) {
+    auto spots = scene_description.GetLights();
+    int first = std::min(n_active, ground_cache_lights);
+    int end = std::max(n_active, ground_cache_lights);
+    for (int i = first; i < end; ++i) {
+      auto position = glm::vec3(rotation * glm::vec4(spots[i].position, 1));
+      ground_light_cache.Invalidate(glm::vec4(position, spots[i].range));
+    }
+  }
+  ground_cache_rotation = rotation;
+  ground_cache_lights = n_active;
+  if (ground_light_cache.Update(eye, light_transform.GetWorldBuffer(),
+                                n_active, rotation) > 0)
+    gbuffer_version++;
+}
+
+// Writes the G-buffer of the frame with the code that reads it and the
+// materials and lights of the lighting pass, the first time the scene is
+// complete; the attachments aren't stored after the pass
+void DumpGBuffer() {
+  GBufferDump dump;
+  dump.width = framebuffer.GetWidth();
+  dump.height = framebuffer.GetHeight();
+  dump.projection = projection;
+  dump.z_near = Z_NEAR;
+  dump.z_far = Z_FAR;
+  dump.cluster_grid = CLUSTER_GRID;
+  dump.tile_size = TILE_SIZE;
+  dump.lighting_code = gbuffer_layout.GenerateLightingPassCode(0);
+
+  // The textures may be larger than the rendered size, and the rows of the
+  // narrow formats aren't padded
+  size_t pixels = (size_t)dump.width * dump.height;
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  auto &attachments = gbuffer_layout.GetAttachments();
+  for (size_t i = 0; i < attachments.size(); ++i) {
+    GBufferDump::Texture texture;
+    texture.internal_format = attachments[i].internal_format;
+    texture.base_format = attachments[i].base_format;
+    texture.type = attachments[i].type;
+    texture.bytes_per_pixel = attachments[i].bytes_per_pixel;
+    texture.pixels.resize(pixels * texture.bytes_per_pixel);
+    glGetTextureSubImage(framebuffer.GetTextures()[i], 0, 0, 0, 0,
+                         dump.width, dump.height, 1, texture.base_format,
+                         texture.type, texture.pixels.size(),
+                         texture.pixels.data());
+    dump.textures.push_back(std::move(texture));
+  }
+  dump.depth.resize(pixels);
+  glGetTextureSubImage(framebuffer.GetDepthTexture(), 0, 0, 0, 0, dump.width,
+                       dump.height, 1, GL_DEPTH_COMPONENT, GL_FLOAT,
+                       pixels * sizeof(float), dump.depth.data());
+  glPixelStorei(GL_PACK_ALIGNMENT, 4);
+
+  auto read_buffer = [](unsigned int buffer, size_t offset, size_t size) {
+    std::vector<unsigned char> bytes(size);
+    glGetNamedBufferSubData(buffer, offset, size, bytes.data());
+    return bytes;
+  };
+  dump.materials = read_buffer(materials.GetId(), materials.GetOffset(),
+                               materials.GetSize());
+  dump.lights =
+      read_buffer(lights.GetId(), lights.GetOffset(), lights.GetSize());
+  GLint64 spot_size = 0;
+  glGetNamedBufferParameteri64v(light_transform.GetBuffer(), GL_BUFFER_SIZE,
+                                &spot_size);
+  dump.spot_lights = read_buffer(light_transform.GetBuffer(), 0, spot_size);
+  try {
+    WriteGBufferDump(gbuffer_dump_path, dump);
+  } catch (std::exception &e) {
+    Assertf(false, "%s", e.what());
+  }
+  printf("G-buffer of %dx%d dumped to %s\n", dump.width, dump.height,
+         gbuffer_dump_path.c_str());
+  gbuffer_dumped = true;
+}
+
+// Renders the lighting pass
+void RenderLighting() {
+  PROFILE_ZONE("lighting");
+  glDisable(GL_DEPTH_TEST);
+  if (!gbuffer_dump_path.empty() && !gbuffer_dumped && IsSceneComplete())
+    DumpGBuffer();
+  if (ground_cache)
+    UpdateGroundCache();
+  // Other lights every frame, which the temporal antialiasing averages
+  light_seed++;
+  if (!lighting_cache) {
+    ShadeLighting();
+    return;
+  }
+
+  // The cached image replaces the cleared light buffer, and what changed is
+  // shaded over it
+  glm::vec4 region;
+  bool cache_hit = !GetLightingRegion(&region);
+  int width = light_buffer.GetWidth();
+  int height = light_buffer.GetHeight();
+  bool partial = region != glm::vec4(-1, -1, 1, 1);
+  if (cache_hit || partial)
+    glCopyImageSubData(lighting_cache_buffer.GetTextures()[0], GL_TEXTURE_2D,
+                       0, 0, 0, 0, light_buffer.GetTextures()[0],
+                       GL_TEXTURE_2D, 0, 0, 0, 0, width, height, 1);
+  if (cache_hit)
+    return;
+  if (partial) {
+    auto pixels = (region * 0.5f + 0.5f) *
+                  glm::vec4(width, height, width, height);
+    auto rect_min = glm::ivec2(glm::floor(glm::vec2(pixels)));
+    auto rect_max = glm::ivec2(glm::ceil(glm::vec2(pixels.z, pixels.w)));
+    glEnable(GL_SCISSOR_TEST);
+    glScissor(rect_min.x, rect_min.y, std::max(rect_max.x - rect_min.x, 0),
+              std::max(rect_max.y - rect_min.y, 0));
+  }
+  ShadeLighting();
+  if (partial)
+    glDisable(GL_SCISSOR_TEST);
+  glCopyImageSubData(light_buffer.GetTextures()[0], GL_TEXTURE_2D, 0, 0, 0, 0,
+                     lighting_cache_buffer.GetTextures()[0], GL_TEXTURE_2D, 0,
+                     0, 0, 0, width, height, 1);
+}
+
+// Renders the material pass of the light pre-pass: both culling passes of
+// the geometry pass are drawn again, and only their nearest fragments apply
+// their materials to the light of the lighting pass
+void RenderMaterials() {
+  PROFILE_ZONE("materials");
+  glEnable(GL_DEPTH_TEST);
+  glDepthFunc(GL_EQUAL);
+  glDepthMask(GL_FALSE);
+  materialpass_shader.Enable();
+  materialpass_shader.SetUniform("show_light", !GetDebugDefine().empty());
+  BindInstances();
+  BindLights();
+  BindDiffuseMaps();
+  auto texture = render_graph.GetTexture("prepasslight");
+  auto sampler = framebuffer.GetSampler();
+  GLState::BindTexture(PREPASS_LIGHT_UNIT, texture);
+  GLState::BindSamplers(PREPASS_LIGHT_UNIT, 1, &sampler);
+  SetViewports(true);
+  DrawBatches(MeshBatch::EARLY_PASS);
+  if (!occlusion_queries)
+    DrawBatches(MeshBatch::LATE_PASS);
+  SetViewports(false);
+  glDepthFunc(GL_LESS);
+  glDepthMask(GL_TRUE);
+  glDisable(GL_DEPTH_TEST);
+}
+
+// Upsamples the scaled lighting to the output, guided by the G-buffer
+void RenderUpsample() {
+  PROFILE_ZONE("upsample");
+  glDisable(GL_DEPTH_TEST);
+  upsample_shader.Enable();
+  BindGBuffer(&upsample_shader);
+  // The lit texture uses the unit after the G-buffer (GBUFFER_TEXTURES)
+  int lit_unit = gbuffer_layout.GetAttachments().size() + 1;
+  auto sampler = framebuffer.GetSampler();
+  GLState::BindTexture(lit_unit, render_graph.GetTexture("lit"));
+  GLState::BindSamplers(lit_unit, 1, &sampler);
+  upsample_shader.SetUniform("lit_pixel_size", GetLitPixelSize());
+  screen_triangle.DrawArrays(GL_TRIANGLES, 3);
+}
+
+// Antialiases the lit image into the backbuffer
+void RenderFxaa(const std::string &source) {
+  PROFILE_ZONE("fxaa");
+  glDisable(GL_DEPTH_TEST);
+  glDisable(GL_STENCIL_TEST);
+  fxaa_shader.Enable();
+  GLState::BindTexture(0, render_graph.GetTexture(source));
+  GLState::BindSamplers(0, 1, &linear_sampler);
+  int width, height;
+  render_graph.GetSize(source, &width, &height);
+  fxaa_shader.SetUniform("lit_size", glm::vec2(width, height));
+  fxaa_shader.SetUniform("output_size", glm::vec2(window_w, window_h));
+  screen_triangle.DrawArrays(GL_TRIANGLES, 3);
+}
+
+// Blends the lit image with the reprojected history, which it then replaces;
+// a lit image smaller than the window is upscaled by the blend
+void RenderTaa(const std::string &source) {
+  PROFILE_ZONE("taa");
+  glDisable(GL_DEPTH_TEST);
+  glDisable(GL_STENCIL_TEST);
+  taa_shader.Enable();
+  unsigned int textures[] = {render_graph.GetTexture(source),
+                             framebuffer.GetDepthTexture(),
+                             taa_history.GetTextures()[0]};
+  unsigned int samplers[] = {linear_sampler, framebuffer.GetSampler(),
+                             linear_sampler};
+  GLState::BindTextures(0, 3, textures);
+  GLState::BindSamplers(0, 3, samplers);
+  auto reprojection =
+      last_view_projection * glm::inverse(unjittered_projection * view);
+  taa_shader.SetUniform("reprojection", reprojection);
+  int lit_width, lit_height;
+  render_graph.GetSize(source, &lit_width, &lit_height);
+  taa_shader.SetUniform("lit_size", glm::vec2(lit_width, lit_height));
+  taa_shader.SetUniform("jitter", taa_jitter);
+  int width = taa_history.GetWidth();
+  int height = taa_history.GetHeight();
+  taa_shader.SetUniform("history_size", glm::vec2(width, height));
+  taa_shader.SetUniform("history_weight",
+                        taa_history_valid ? TAA_HISTORY_WEIGHT : 0.0f);
+  screen_triangle.DrawArrays(GL_TRIANGLES, 3);
+
+  // Same size and format as the history
+  glCopyImageSubData(render_graph.GetTexture("resolved"), GL_TEXTURE_2D, 0, 0,
+                     0, 0, taa_history.GetTextures()[0], GL_TEXTURE_2D, 0, 0,
+                     0, 0, width, height, 1);
+  taa_history_valid = true;
+}
+
+// Obtains the size of a resource of the render graph
+glm::ivec2 GetResourceSize(const std::string &name) {
+  int width, height;
+  render_graph.GetSize(name, &width, &height);
+  return glm::ivec2(width, height);
+}
+
+// Computes the ambient occlusion of the G-buffer
+void RenderAmbientOcclusion() {
+  PROFILE_ZONE("ssao");
+  ambient_occlusion.Compute(&framebuffer, projection,
+                            render_graph.GetTexture("occlusion"));
+}
+
+// Traces the reflections of the G-buffer
+void RenderReflections() {
+  PROFILE_ZONE("reflections");
+  BindLights();
+  screen_reflections.Trace(&framebuffer, view, projection,
+                           render_graph.GetTexture("reflections"));
+}
+
+// Adds the reflections to the light buffer, whose lit image is kept for the
+// reflections of the next frame first
+void ApplyReflections() {
+  PROFILE_ZONE("reflect");
+  screen_reflections.StoreLitImage(&light_buffer, projection * view);
+  // Without the reflections pass they read the G-buffer
+  auto texture = render_graph.GetTexture("reflections");
+  if (texture == render_graph.GetTexture("gbuffer"))
+    return;
+  glDisable(GL_DEPTH_TEST);
+  glDisable(GL_STENCIL_TEST);
+  glEnable(GL_BLEND);
+  glBlendFunc(GL_ONE, GL_ONE);
+  reflections_shader.Enable();
+  BindGBuffer(&reflections_shader);
+  BindLights();
+  int unit = gbuffer_layout.GetAttachments().size() + 1;
+  auto sampler = framebuffer.GetSampler();
+  GLState::BindTexture(unit, texture);
+  GLState::BindSamplers(unit, 1, &sampler);
+  screen_triangle.DrawArrays(GL_TRIANGLES, 3);
+  glDisable(GL_BLEND);
+}
+
+// Builds the glow of the HDR lit image
+void RenderBloom(const std::string &source) {
+  PROFILE_ZONE("bloom");
+  bloom.Build(render_graph.GetTexture(source), GetResourceSize(source),
+              render_graph.GetTexture("bloom"), GetResourceSize("bloom"));
+}
+
+// Maps the HDR lit image, with the glow if any, to the backbuffer or to the
+// input of the FXAA
+void RenderTonemap(const std::string &source) {
+  PROFILE_ZONE("tonemap");
+  glDisable(GL_DEPTH_TEST);
+  glDisable(GL_STENCIL_TEST);
+  tonemap_shader.Enable();
+  // Without the bloom pass, disabled or not, the glow reads the lit image
+  // with no weight
+  auto lit_texture = render_graph.GetTexture(source);
+  unsigned int bloom_texture = lit_texture;
+  float strength = 0.0f;
+  if (bloom_strength > 0) {
+    bloom_texture = render_graph.GetTexture("bloom");
+    // The levels add up the glow of every radius
+    if (bloom_texture != lit_texture)
+      strength = bloom_strength / bloom.GetLevels();
+  }
+  unsigned int textures[] = {lit_texture, bloom_texture};
+  unsigned int samplers[] = {linear_sampler, linear_sampler};
+  GLState::BindTextures(0, 2, textures);
+  GLState::BindSamplers(0, 2, samplers);
+  auto lit_size = GetResourceSize(source);
+  tonemap_shader.SetUniform("lit_size", glm::vec2(lit_size));
+  tonemap_shader.SetUniform("output_size", glm::vec2(window_w, window_h));
+  auto bloom_size = bloom_strength > 0 ? GetResourceSize("bloom") : lit_size;
+  tonemap_shader.SetUniform("bloom_size", glm::vec2(bloom_size));
+  tonemap_shader.SetUniform("bloom_strength", strength);
+  tonemap_shader.SetUniform("exposure", exposure);
+  screen_triangle.DrawArrays(GL_TRIANGLES, 3);
+}
+
+// Renders the lighting pass with a compute shader, culling the lights per tile
+// or per cluster, or applying all of them
+void RenderComputeLighting() {
+  PROFILE_ZONE("compute lighting");
+  if (lighting_mode == LIGHTING_CLUSTERED)
+    light_clusters.Update(projection, Z_NEAR, Z_FAR, framebuffer.GetWidth(),
+                          framebuffer.GetHeight(), &lights,
+                          light_transform.GetBuffer());
+  lightpass_compute_shader.Enable();
+  BindGBuffer(&lightpass_compute_shader);
+  BindAmbientOcclusion(&lightpass_compute_shader);
+  if (lighting_mode == LIGHTING_CLUSTERED)
+    light_clusters.Bind(&lightpass_compute_shader);
+  BindLights();
+
+  int width, height;
+  render_graph.GetSize("lit", &width, &height);
+  glBindImageTexture(0, render_graph.GetTexture("lit"), 0, GL_FALSE, 0,
+                     GL_WRITE_ONLY, GetLitFormat());
+  lightpass_compute_shader.SetUniform("lit_image", 0);
+  glDispatchCompute((width + TILE_SIZE - 1) / TILE_SIZE,
+                    (height + TILE_SIZE - 1) / TILE_SIZE, 1);
+  glMemoryBarrier(GL_FRAMEBUFFER_BARRIER_BIT);
+}
+
+// Obtains the view-space depths of the nearest and the farthest points of the
+// cone of a spot light in world space
+glm::vec2 GetLightDepths(const LightTransform::SpotLight &light) {
+  auto world_to_view = view * rotation;
+  auto position = glm::vec3(world_to_view * glm::vec4(light.position, 1));
+  auto direction = glm::mat3(world_to_view) * light.direction;
+  // The cone ends at a disk across the range, as in lightvolume_vs.glsl
+  float cos_angle = glm::unpackHalf2x16(light.cone).x;
+  float radius =
+      light.range * std::sqrt(1 - cos_angle * cos_angle) / cos_angle;
+  float base = position.z + direction.z * light.range;
+  float extent =
+      radius * std::sqrt(std::max(1 - direction.z * direction.z, 0.0f));
+  return glm::vec2(std::max(position.z, base + extent),
+                   std::min(position.z, base - extent));
+}
+
+// Obtains the window depth of a view-space depth, 0 in front of the near
+// plane and 1 past the far one
+float GetWindowDepth(float z) {
+  if (z >= -Z_NEAR)
+    return 0.0f;
+  auto clip = projection * glm::vec4(0, 0, z, 1);
+  return glm::clamp(clip.z / clip.w * 0.5f + 0.5f, 0.0f, 1.0f);
+}
+
+// Renders the lighting pass as the ambient term and the point lights on every
+// pixel plus one cone per spot light, whose contribution is only shaded on the
+// pixels inside the cone; the pixels out of the depths of the cone are
+// rejected before the stencil and the shading, by EXT_depth_bounds_test or
+// else by the shading
+void RenderVolumeLighting() {
+  PROFILE_ZONE("volume lighting");
+  glDisable(GL_DEPTH_TEST);
+  ShadeGeometryPixels(GetLightpassShader(false));
+
+  lightvolume_shader.Enable();
+  BindGBuffer(&lightvolume_shader);
+  BindLights();
+  lightvolume_shader.SetUniform("projection", projection);
+  stencil_shader.Enable();
+  stencil_shader.SetUniform("projection", projection);
+
+  // The depth clamp keeps the far side of the cones past the far plane; the
+  // cones only count in the stencil bits below the geometry bit
+  const int volume_bits = GEOMETRY_STENCIL_BIT - 1;
+  glEnable(GL_STENCIL_TEST);
+  glStencilMask(volume_bits);
+  glEnable(GL_DEPTH_CLAMP);
+  glDepthMask(GL_FALSE);
+  glBlendFunc(GL_ONE, GL_ONE);
+  // The lights are culled on the gpu, the cones of the culled ones collapse
+  // in the vertex shader
+  ShaderProgram::BindStorageBuffer(buffer_bindings::SPOT_LIGHT_SLOTS,
+                                   light_transform.GetSlotBuffer());
+  auto spots = scene_description.GetLights();
+  if (GLEW_EXT_depth_bounds_test)
+    glEnable(GL_DEPTH_BOUNDS_TEST_EXT);
+  for (int i = 0; i < light_transform.GetActiveCount(); ++i) {
+    auto depths = GetLightDepths(spots[i]);
+    if (GLEW_EXT_depth_bounds_test)
+      glDepthBoundsEXT(GetWindowDepth(depths.x), GetWindowDepth(depths.y));
+
+    // Marks the pixels whose surface is inside the cone: behind its back
+    // faces but not behind its front faces (works with the eye inside); the
+    // background is never marked
+    stencil_shader.Enable();
+    stencil_shader.SetUniform("light_index", i);
+    glEnable(GL_DEPTH_TEST);
+    glDisable(GL_CULL_FACE);
+    glDisable(GL_BLEND);
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    glStencilFunc(GL_EQUAL, GEOMETRY_STENCIL_BIT, GEOMETRY_STENCIL_BIT);
+    glStencilOpSeparate(GL_BACK, GL_KEEP, GL_INCR_WRAP, GL_KEEP);
+    glStencilOpSeparate(GL_FRONT, GL_KEEP, GL_DECR_WRAP, GL_KEEP);
+    shapes.Draw(cone_mesh, GL_TRIANGLES);
+
+    // Shades the marked pixels once through the back faces and clears them
+    lightvolume_shader.Enable();
+    lightvolume_shader.SetUniform("light_index", i);
+    if (!GLEW_EXT_depth_bounds_test)
+      lightvolume_shader.SetUniform("light_depths", depths);
+    glDisable(GL_DEPTH_TEST);
+    glEnable(GL_CULL_FACE);
+    glCullFace(GL_FRONT);
+    glEnable(GL_BLEND);
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    glStencilFunc(GL_NOTEQUAL, 0, volume_bits);
+    glStencilOp(GL_ZERO, GL_ZERO, GL_ZERO);
+    shapes.Draw(cone_mesh, GL_TRIANGLES);
+  }
+  if (GLEW_EXT_depth_bounds_test)
+    glDisable(GL_DEPTH_BOUNDS_TEST_EXT);
+  glDisable(GL_BLEND);
+  glCullFace(GL_BACK);
+  glDisable(GL_CULL_FACE);
+  glDepthMask(GL_TRUE);
+  glDisable(GL_DEPTH_CLAMP);
+  glStencilMask(0xFF);
+  glDisable(GL_STENCIL_TEST);
+}
+
+// Draws the visible transparent objects in their order, one draw each; the
+// jobs record consecutive slices of them, executed in their order
+void DrawTransparentCommands(
+    const FrameVector<std::pair<float, int>> &visible) {
+  forward_shader.SetUniform("sphere_radius", TRANSPARENT_RADIUS);
+  auto center_uniform = forward_shader.GetUniform("sphere_center");
+  auto color_uniform = forward_shader.GetUniform("surface_color");
+  int n_lists = jobs.GetWorkerCount() + 1;
+  int n_visible = visible.size();
+  while ((int)transparent_commands.size() < n_lists)
+    transparent_commands.push_back(device->CreateCommandList());
+  jobs.ParallelFor(n_lists, [&](int begin, int end) {
+    for (int i = begin; i < end; ++i) {
+      auto &commands = *transparent_commands[i];
+      commands.Reset();
+      int last = n_visible * (i + 1) / n_lists;
+      for (int j = n_visible * i / n_lists; j < last; ++j) {
+        auto &object = transparent_objects[visible[j].second];
+        auto center = glm::vec3(view * glm::vec4(object.position, 1));
+        commands.SetUniform(&forward_shader, center_uniform, center);
+        commands.SetUniform(&forward_shader, color_uniform, object.color);
+        commands.Draw(&shapes, sphere_mesh, GL_TRIANGLES);
+      }
+    }
+  }, 1);
+  for (int i = 0; i < n_lists; ++i)
+    transparent_commands[i]->Execute();
+}
+
+// Draws the visible transparent objects in their order, instanced in batches
+// of the uniform block ranges of transparent_instances
+void DrawTransparentBatches(const FrameVector<std::pair<float, int>> &visible) {
+  if (!transparent_instances.GetId()) {
+    device->CreateBuffer(&transparent_instances, "transparent instances",
+                         UniformBuffer::UNIFORM, UniformBuffer::STREAM,
+                         frames_in_flight * n_windows);
+  } else {
+    transparent_instances.Clear();
+  }
+  if (visible.empty())
+    return;
+  FrameVector<TransparentInstance> instances;
+  instances.reserve(visible.size());
+  for (auto &entry : visible) {
+    auto &object = transparent_objects[entry.second];
+    auto center = glm::vec3(view * glm::vec4(object.position, 1));
+    instances.push_back({glm::vec4(center, TRANSPARENT_RADIUS), object.color});
+  }
+  transparent_instances.AddArray(instances.data(), instances.size());
+  transparent_instances.SendToDevice();
+
+  // Every batch but the last is full, so each range starts aligned
+  int n = instances.size();
+  for (int first = 0; first < n; first += transparent_batch) {
+    int count = std::min(transparent_batch, n - first);
+    ShaderProgram::BindUniformBuffer(
+        buffer_bindings::TRANSPARENT_INSTANCES, transparent_instances.GetId(),
+        transparent_instances.GetOffset() +
+            first * sizeof(TransparentInstance),
+        count * sizeof(TransparentInstance));
+    shapes.DrawInstances(sphere_mesh, GL_TRIANGLES, count);
+  }
+}
+
+// Blends the visible transparent objects over the lighting from the farthest
+// to the nearest, depth tested against the G-buffer, or accumulates them in
+// any order into the targets of --weighted-transparency; the clusters are
+// only assigned here if the lighting pass doesn't
+void RenderTransparent() {
+  PROFILE_ZONE("transparent");
+  if (lighting_mode != LIGHTING_CLUSTERED ||
+      !render_graph.IsPassEnabled("lighting"))
+    light_clusters.Update(projection, Z_NEAR, Z_FAR, framebuffer.GetWidth(),
+                          framebuffer.GetHeight(), &lights,
+                          light_transform.GetBuffer());
+  glm::vec4 planes[6];
+  ExtractFrustumPlanes(projection * view, planes);
+  FrameVector<std::pair<float, int>> visible;
+  for (int i = 0; i < n_transparent; ++i) {
+    auto &position = transparent_objects[i].position;
+    bool inside = true;
+    for (auto &plane : planes)
+      inside = inside && glm::dot(glm::vec3(plane), position) + plane.w >=
+                             -TRANSPARENT_RADIUS;
+    if (inside)
+      visible.push_back({glm::distance(eye, position), i});
+  }
+  if (!weighted_transparency)
+    std::sort(visible.rbegin(), visible.rend());
+
+  forward_shader.Enable();
+  light_clusters.Bind(&forward_shader);
+  BindLights();
+  forward_shader.SetUniform("projection", projection);
+  glEnable(GL_CULL_FACE);
+  glEnable(GL_BLEND);
+  if (weighted_transparency) {
+    // The targets have no depth buffer, the shader tests the G-buffer's
+    BindGBuffer(&forward_shader);
+    forward_shader.SetUniform(
+        "oit_pixel_size",
+        glm::vec2((float)framebuffer.GetWidth() / oit_buffer.GetWidth(),
+                  (float)framebuffer.GetHeight() / oit_buffer.GetHeight()));
+    glDisable(GL_DEPTH_TEST);
+    glBlendFunci(0, GL_ONE, GL_ONE);
+    glBlendFunci(1, GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+  } else {
+    glEnable(GL_DEPTH_TEST);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+  }
+  glDepthMask(GL_FALSE);
+  if (instanced_transparent)
+    DrawTransparentBatches(visible);
+  else
+    DrawTransparentCommands(visible);
+  glDisable(GL_BLEND);
+  glDisable(GL_CULL_FACE);
+  glDepthMask(GL_TRUE);
+}
+
+// Blends the average color of the transparent objects accumulated by
+// --weighted-transparency over the light buffer, by their coverage
+void CompositeTransparent() {
+  PROFILE_ZONE("transparent composite");
+  // Without the transparent pass the targets hold nothing of this frame
+  if (!render_graph.IsPassEnabled("transparent"))
+    return;
+  glDisable(GL_DEPTH_TEST);
+  glDisable(GL_STENCIL_TEST);
+  glEnable(GL_BLEND);
+  glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+  oit_composite_shader.Enable();
+  auto &textures = oit_buffer.GetTextures();
+  unsigned int samplers[] = {linear_sampler, linear_sampler};
+  GLState::BindTextures(0, 2, textures.data());
+  GLState::BindSamplers(0, 2, samplers);
+  oit_composite_shader.SetUniform(
+      "oit_scale",
+      glm::vec2((float)oit_buffer.GetWidth() / light_buffer.GetWidth(),
+                (float)oit_buffer.GetHeight() / light_buffer.GetHeight()));
+  screen_triangle.DrawArrays(GL_TRIANGLES, 3);
+  glDisable(GL_BLEND);
+}
+
+// Checks if the passes are timed on the gpu
+bool TimesPasses() {
+  return gpu_times || hud_visible || benchmark_frames > 0 ||
+         !trace_path.empty() || remote_port || !stats_page_path.empty();
+}
+
+// Declares the passes of the frame
+void BuildRenderGraph() {
+  gbuffer_version++;
+  render_graph.Init(&render_targets);
+  if (TimesPasses())
+    render_graph.SetTimer(&gpu_timer);
+  if (pipeline_stats_report)
+    render_graph.SetPipelineStats(&pipeline_stats);
+  // The lit color of the framebuffer fetch is read after the G-buffer
+  render_graph.ImportFrameBuffer(
+      "gbuffer", &framebuffer,
+      framebuffer_fetch ? gbuffer_layout.GetAttachments().size() : 0);
+  if (visibility_buffer) {
+    render_graph.ImportFrameBuffer("visibility", &visibility_framebuffer);
+    render_graph.AddPass("visibility", {}, "visibility",
+                         RenderGraph::CLEAR_NONE, RenderVisibility);
+    render_graph.AddPass("resolve", {"visibility"}, "gbuffer",
+                         RenderGraph::CLEAR_NONE, RenderVisibilityResolve);
+  } else {
+    if (depth_prepass)
+      render_graph.AddPass("prepass", {}, "gbuffer", RenderGraph::CLEAR_NONE,
+                           RenderDepthPrepass);
+    render_graph.AddPass("geometry", {}, "gbuffer", RenderGraph::CLEAR_NONE,
+                         RenderGeometry);
+  }
+  if (n_decals)
+    render_graph.AddPass("decals", {}, "gbuffer", RenderGraph::CLEAR_NONE,
+                         RenderDecals);
+  std::vector<std::string> lighting_reads = {"gbuffer"};
+  if (ssao) {
+    // Half of the G-buffer at the largest dynamic resolution
+    render_graph.AddTransient("occlusion", GL_RG16F, 0.5f * render_scale);
+    render_graph.AddPass("ssao", {"gbuffer"}, "occlusion",
+                         RenderGraph::CLEAR_NONE, RenderAmbientOcclusion);
+    lighting_reads.push_back("occlusion");
+  }
+  if (reflections) {
+    // Half of the G-buffer at the largest dynamic resolution
+    render_graph.AddTransient("reflections", GL_RGBA16F, 0.5f * render_scale);
+    render_graph.AddPass("reflections", {"gbuffer"}, "reflections",
+                         RenderGraph::CLEAR_NONE, RenderReflections);
+  }
+  if (shadow_budget) {
+    render_graph.ImportFrameBuffer("shadowatlas",
+                                   shadow_atlas.GetFrameBuffer());
+    render_graph.AddPass("shadows", {}, "shadowatlas",
+                         RenderGraph::CLEAR_NONE, RenderShadows);
+    lighting_reads.push_back("shadowatlas");
+  }
+  if (sun_period) {
+    render_graph.ImportFrameBuffer("sunshadows",
+                                   sun_shadows.GetFrameBuffer());
+    render_graph.AddPass("cascades", {}, "sunshadows",
+                         RenderGraph::CLEAR_NONE, RenderSunShadows);
+    lighting_reads.push_back("sunshadows");
+  }
+  // Lit image presented or antialiased into the backbuffer, none if the
+  // lighting renders there
+  std::string lit;
+  if (UsesComputeLighting()) {
+    render_graph.AddTransient("lit", GetLitFormat(), render_scale);
+    render_graph.AddPass("lighting", lighting_reads, "lit",
+                         RenderGraph::CLEAR_NONE, RenderComputeLighting);
+    lit = "lit";
+  } else if (lighting_scale < 1.0f) {
+    render_graph.AddTransient("lit", GetLitFormat(), lighting_scale);
+    render_graph.AddPass("lighting", lighting_reads, "lit",
+                         RenderGraph::CLEAR_NONE, RenderLighting);
+    if (fxaa_steps || taa || hdr) {
+      render_graph.AddTransient("upsampled", GetLitFormat());
+      lit = "upsampled";
+    }
+    render_graph.AddPass("upsample", {"gbuffer", "lit"},
+                         lit.empty() ? RenderGraph::BACKBUFFER : lit,
+                         RenderGraph::CLEAR_NONE, RenderUpsample);
+  } else if (UsesLightBuffer()) {
+    auto render_lighting = lighting_mode == LIGHTING_VOLUMES
+                               ? RenderVolumeLighting
+                               : RenderLighting;
+    render_graph.ImportFrameBuffer("lightbuffer", &light_buffer);
+    if (light_prepass) {
+      // The material pass tests the depth of the G-buffer
+      render_graph.AddTransient("prepasslight", GL_RGBA16F, render_scale);
+      render_graph.AddPass("lighting", lighting_reads, "prepasslight",
+                           RenderGraph::CLEAR_NONE, render_lighting);
+      render_graph.AddPass("materials", {"prepasslight", "gbuffer"},
+                           "lightbuffer", RenderGraph::CLEAR_NONE,
+                           RenderMaterials);
+    } else {
+      render_graph.AddPass("lighting", lighting_reads, "lightbuffer",
+                           RenderGraph::CLEAR_NONE, render_lighting);
+    }
+    // Reads its own target first, so that disabling it bypasses nothing
+    if (reflections)
+      render_graph.AddPass("reflect", {"lightbuffer", "reflections", "gbuffer"},
+                           "lightbuffer", RenderGraph::CLEAR_NONE,
+                           ApplyReflections);
+    if (n_transparent && weighted_transparency) {
+      render_graph.ImportFrameBuffer("oit", &oit_buffer);
+      render_graph.AddPass("transparent", {"gbuffer"}, "oit",
+                           RenderGraph::CLEAR_NONE, RenderTransparent);
+      render_graph.AddPass("transparent composite", {"lightbuffer", "oit"},
+                           "lightbuffer", RenderGraph::CLEAR_NONE,
+                           CompositeTransparent);
+    } else if (n_transparent) {
+      render_graph.AddPass("transparent", {"gbuffer"}, "lightbuffer",
+                           RenderGraph::CLEAR_NONE, RenderTransparent);
+    }
+    lit = "lightbuffer";
+  } else if (framebuffer_fetch) {
+    render_graph.AddPass("lighting", lighting_reads, "gbuffer",
+                         RenderGraph::CLEAR_NONE, RenderLighting);
+    lit = "gbuffer";
+  } else {
+    auto lighting_clear =
+        msaa_samples ? RenderGraph::CLEAR_STENCIL : RenderGraph::CLEAR_NONE;
+    render_graph.AddPass("lighting", lighting_reads, RenderGraph::BACKBUFFER,
+                         lighting_clear, RenderLighting);
+  }
+  if (taa) {
+    render_graph.AddTransient("resolved", GL_RGBA16F);
+    render_graph.AddPass("taa", {lit, "gbuffer"}, "resolved",
+                         RenderGraph::CLEAR_NONE, [lit] { RenderTaa(lit); });
+    lit = "resolved";
+  }
+  if (hdr) {
+    if (fxaa_steps)
+      render_graph.AddTransient("tonemapped", GL_RGBA8);
+    std::vector<std::string> tonemap_reads = {lit};
+    if (bloom_strength > 0) {
+      // The chain starts at a quarter of the pixels of the output
+      render_graph.AddTransient("bloom", GL_R11F_G11F_B10F, 0.5f);
+      render_graph.AddPass("bloom", {lit}, "bloom", RenderGraph::CLEAR_NONE,
+                           [lit] { RenderBloom(lit); });
+      tonemap_reads.push_back("bloom");
+    }
+    auto target = fxaa_steps ? "tonemapped" : RenderGraph::BACKBUFFER;
+    render_graph.AddPass("tonemap", tonemap_reads, target,
+                         RenderGraph::CLEAR_NONE,
+                         [lit] { RenderTonemap(lit); });
+    lit = fxaa_steps ? "tonemapped" : "";
+  }
+  if (fxaa_steps)
+    render_graph.AddPass("fxaa", {lit}, RenderGraph::BACKBUFFER,
+                         RenderGraph::CLEAR_NONE, [lit] { RenderFxaa(lit); });
+  else if (!lit.empty())
+    render_graph.AddCopyPass("present", lit);
+  // Drawn over the output, after the G-buffer is written
+  if (overdraw) {
+    render_graph.AddTransient("overdraw", GL_RG32F, render_scale);
+    render_graph.AddPass("overdraw", {"gbuffer"}, "overdraw",
+                         RenderGraph::CLEAR_COLOR, RenderOverdraw);
+    render_graph.AddPass("overdraw view", {"overdraw"},
+                         RenderGraph::BACKBUFFER, RenderGraph::CLEAR_NONE,
+                         ShowOverdraw);
+  }
+  for (auto &pass : disabled_passes) {
+    Assertf(render_graph.HasPass(pass), "pass %s not found", pass.c_str());
+    render_graph.SetPassEnabled(pass, false);
+  }
+  render_graph.SetOutputSize(window_w, window_h);
+}
+
+// Rebuilds the shaders in the background when their files change; the new
+// programs are swapped in together, at the start of the frame after they are
+// all built, and a program that fails keeps the previous version
+// Returns true while the programs are rebuilt and once they're swapped in
+bool ReloadShaders() {
+  PROFILE_ZONE("reload shaders");
+  static std::vector<ShaderProgram *> reloading;
+  if (reloading.empty()) {
+    if (!shader_watcher.Poll())
+      return false;
+    auto programs = loaded_programs;
+    for (auto program : lightpass_shaders.GetPrograms())
+      programs.push_back(program);
+    for (auto program : programs) {
+      try {
+        program->Reload();
+        reloading.push_back(program);
+      } catch (std::exception &e) {
+        fprintf(stderr, "\n%s\n", e.what());
+      }
+    }
+  }
+  for (auto program : reloading)
+    if (!program->IsLinkDone())
+      return true;
+  for (auto program : reloading) {
+    try {
+      program->FinishLink();
+    } catch (std::exception &e) {
+      fprintf(stderr, "\n%s\n", e.what());
+    }
+  }
+  reloading.clear();
+  return true;
+}
+
+// Resizes the G-buffer and the light buffer to the window scaled by the
+// render scale and the dynamic resolution; the present or the temporal
+// antialiasing pass upscales the light buffer, and the history of the latter
+// is only lost when the window is resized
+void ResizeRenderTargets() {
+  int width, height;
+  GetRenderSize(&width, &height);
+  framebuffer.Resize(width, height);
+  if (visibility_buffer)
+    visibility_framebuffer.Resize(width, height);
+  if (UsesLightBuffer())
+    light_buffer.Resize(width, height);
+  if (lighting_cache)
+    lighting_cache_buffer.Resize(width, height);
+  if (weighted_transparency) {
+    auto size = GetOitSize(width, height);
+    oit_buffer.Resize(size.x, size.y);
+  }
+  gbuffer_version++;
+  if (taa && (taa_history.GetWidth() != window_w ||
+              taa_history.GetHeight() != window_h)) {
+    taa_history.Resize(window_w, window_h);
+    taa_history_valid = false;
+  }
+}
+
+// Obtains the framebuffer size of the window, as the render thread replayed
+// it if one runs
+void GetFramebufferSize(GLFWwindow *window, int *width, int *height) {
+  if (render_thread) {
+    *width = replayed_framebuffer_w;
+    *height = replayed_framebuffer_h;
+    return;
+  }
+  glfwGetFramebufferSize(window, width, height);
+}
+
+// Updates the window size (w, h)
+void Resize(GLFWwindow *window) {
+  int width, height;
+  GetFramebufferSize(window, &width, &height);
+  if (width == window_w && height == window_h) return;
+
+  window_w = width;
+  window_h = height;
+  camera_dirty = true;
+  glViewport(0, 0, width, height);
+  ResizeRenderTargets();
+  render_graph.SetOutputSize(width, height);
+}
 
-  for (int i = 0; i < N_LIGHTS_I; ++i) {
-    for (int j = 0; j < N_LIGHTS_J; ++j) {
-      float theta = random_colors[i + j * N_LIGHTS_I].x * 2.0 * M_PI;
-      auto rotation = glm::rotate(theta, glm::vec3(0, 1, 0));
-      auto model = ComputeTranslation(i, j) * rotation;
-      auto modelview = view * model;
-      auto normalmatrix = glm::transpose(glm::inverse(modelview));
-      auto mvp = projection * modelview;
-      bear_matrices.Add(mvp);
-      bear_matrices.Add(modelview);
-      bear_matrices.Add(normalmatrix);
-    }
+// Prints the objects picked whose copies the gpu finished
+void ReportPicks() {
+  ObjectPicking::Hit hit;
+  while (object_picking.Poll(&hit)) {
+    int n_bears = scene_description.GetInstanceCount();
+    if (hit.model < 0)
+      printf("\npicked nothing\n");
+    else if (hit.model == GROUND_MODEL)
+      printf("\npicked the ground\n");
+    else if (hit.model < FIRST_BEAR_MODEL + n_bears)
+      printf("\npicked bear %d, material %d\n", hit.model - FIRST_BEAR_MODEL,
+             hit.material);
+    else
+      printf("\npicked model %d, material %d\n", hit.model, hit.material);
   }
+}
 
-  bear_matrices.SendToDevice();
+// Skins the bears at the time of the frame once their batch is on the gpu,
+// and binds the vertices for every pass; like moving their models, a new pose
+// changes the G-buffer and the shadows
+void UpdateSkinning() {
+  if (!skinning_poses)
+    return;
+  PROFILE_ZONE("skinning");
+  if (!vertex_skinning.IsReady() && bear_batch.IsReady())
+    vertex_skinning.SetMesh(bear_batch.GetVertexBuffer(),
+                            bear_batch.GetVertexCount(), FIRST_BEAR_MODEL,
+                            scene_description.GetInstanceCount());
+  skin_posed = vertex_skinning.IsReady() && skinning_time != skinned_time;
+  if (skin_posed) {
+    vertex_skinning.Update(skinning_time);
+    skinned_time = skinning_time;
+    gbuffer_version++;
+  }
+  vertex_skinning.Bind();
 }
 
-// Creates a single ground instance
-void UpdateGroundMatrices() {
-  // Buffer configuration:
-  // struct Matrices {
-  //     mat4 mvp;
-  //     mat4 modelview;
-  //     mat4 normalmatrix;
-  // };
-  //
-  // layout (std140) uniform MatricesBlock {
-  //     Matrices matrices[100];
-  // };
+// Feeds the last gpu time to the quality governor, and reports the knob it
+// changed; the knobs change the lit image like the G-buffer does
+void UpdateQuality() {
+  if (!quality.Update(dynamic_resolution.GetGpuTime()))
+    return;
+  auto &change = quality.GetLastChange();
+  printf("\nquality: %s at level %d, %.1f ms\n", change.knob.c_str(),
+         change.level, change.gpu_ms);
+  gbuffer_version++;
+}
 
-  if (!ground_matrices.GetId())
-    ground_matrices.Init();
-  else
-    ground_matrices.Clear();
+// Display callback, renders the sphere
+void Render(GLFWwindow *window) {
+  PROFILE_ZONE("render");
+  render_targets.BeginFrame();
+  StartTransformsUpdate();
+  UpdateLoading();
+  StartPartitionUpdate();
+  if (picking)
+    ReportPicks();
+  if (impostor_distance && !bear_impostors.IsBaked() && AreBearsReady())
+    BakeImpostors();
+  // The input is sampled as late as possible, right before the culling and
+  // the geometry pass use the camera; the render thread replayed its packets
+  // before the free-fly camera moved
+  if (!render_thread)
+    glfwPollEvents();
+  frame_pipeline.SampleInput();
+  Resize(window);
+  if (quality_governor)
+    UpdateQuality();
+  if (target_gpu_time > 0 && dynamic_resolution.Update())
+    ResizeRenderTargets();
+  UpdateMatrices();
+  UploadInstances();
+  ApplyWorldPartition();
+  UpdateSkinning();
+  if (pipeline_stats_report)
+    pipeline_stats.BeginFrame();
+  if (TimesPasses()) {
+    gpu_timer.BeginFrame();
+    gpu_timer.Begin("culling");
+  }
+  GLDebug::PushGroup("culling");
+  if (occlusion_queries)
+    bear_boxes.Collect();
+  CullInstances(MeshBatch::EARLY_PASS);
+  GLDebug::PopGroup();
+  if (TimesPasses())
+    gpu_timer.End();
+  UpdateLights();
+  if (target_gpu_time > 0)
+    dynamic_resolution.BeginTiming();
+  render_graph.Execute();
+  if (target_gpu_time > 0)
+    dynamic_resolution.EndTiming();
+  if (!capture_directory.empty() || !stream_output.empty())
+    frame_capture.Capture(window_w, window_h);
+  if (hud_visible) {
+    GLDebug::PushGroup("hud");
+    hud.Draw(window_w, window_h);
+    GLDebug::PopGroup();
+  }
+}
 
-  auto model = glm::mat4();
-  auto modelview = view * model;
-  auto normalmatrix = glm::transpose(glm::inverse(modelview));
-  auto mvp = projection * modelview;
+// Renders the frame of a secondary window to its output from its camera; the
+// G-buffer and the render targets take the size of the window, within their
+// capacity, and the main view is restored for the next frame
+void RenderSecondaryWindow(SecondaryWindow *target) {
+  int width, height;
+  glfwGetFramebufferSize(target->handle, &width, &height);
+  // Nothing is seen of a minimized window
+  if (!width || !height)
+    return;
+  PROFILE_ZONE("secondary window");
+  GLDebug::PushGroup("secondary window");
+  int main_w = window_w, main_h = window_h;
+  auto main_eye = eye, main_center = center, main_up = up;
+  auto main_view = view, main_projection = projection;
+  auto &config = scene_description.GetCameras()[target->camera];
+  eye = config.eye;
+  center = config.center;
+  up = config.up;
+  view = glm::lookAt(eye, center, up);
+  window_w = width;
+  window_h = height;
+  auto grid = glm::vec2(GetViewGrid());
+  projection = glm::perspective(glm::radians(FOVY),
+                                (width / grid.x) / (height / grid.y), Z_NEAR,
+                                Z_FAR);
+  UpdateCamera();
+  UpdateViews();
+  ResizeRenderTargets();
+  target->output.Resize(width, height);
+  render_graph.SetOutputSize(width, height);
+  render_graph.SetOutputFrameBuffer(&target->output);
+  // The times and the statistics are the main window's
+  render_graph.SetTimer(nullptr);
+  render_graph.SetPipelineStats(nullptr);
 
-  ground_matrices.Add(mvp);
-  ground_matrices.Add(modelview);
-  ground_matrices.Add(normalmatrix);
+  CullInstances(MeshBatch::EARLY_PASS);
+  // The shadow maps of the frame are already drawn, for the main view
+  int budget = shadow_budget;
+  int period = sun_period;
+  shadow_budget = 0;
+  sun_period = 0;
+  UpdateLights();
+  shadow_budget = budget;
+  sun_period = period;
+  if (shadow_budget)
+    light_transform.SetShadows(shadow_atlas.GetShadows(view));
+  if (sun_period)
+    SendSun();
+  shadow_updates.clear();
+  sun_updates.clear();
+  render_graph.Execute();
 
-  ground_matrices.SendToDevice();
+  render_graph.SetOutputFrameBuffer(nullptr);
+  render_graph.SetTimer(TimesPasses() ? &gpu_timer : nullptr);
+  render_graph.SetPipelineStats(pipeline_stats_report ? &pipeline_stats
+                                                      : nullptr);
+  window_w = main_w;
+  window_h = main_h;
+  eye = main_eye;
+  center = main_center;
+  up = main_up;
+  view = main_view;
+  projection = main_projection;
+  ResizeRenderTargets();
+  render_graph.SetOutputSize(window_w, window_h);
+  // The camera and the views are streamed again for the main window
+  camera_dirty = true;
+  GLDebug::PopGroup();
 }
 
-// Updates the camera configuration
-void UpdateCameraConfig() {
-  switch (camera_config) {
-    case 0:
-      eye = glm::vec3(0.0, 5.0, 0.0);
-      center = glm::vec3(1.0, 5.0, -1.0);
-      up = glm::vec3(0.0, 1.0, 0.0);
-      break;
-    case 1:
-      eye = glm::vec3(-20.0, 20.0, -20.0);
-      center = glm::vec3(0.0, 0.0, 0.0);
-      up = glm::vec3(0.0, 1.0, 0.0);
-      break;
-    case 2:
-      eye = glm::vec3(0.0, 100.0, 0.0);
-      center = glm::vec3(0.0, 0.0, 0.0);
-      up = glm::vec3(0.0, 0.0, 1.0);
-      break;
-    default:
-      break;
+// Shows the outputs of the secondary windows from their own contexts, once
+// the first context is done drawing them, and makes it current again
+void PresentSecondaryWindows(GLFWwindow *window) {
+  if (secondary_windows.empty())
+    return;
+  PROFILE_ZONE("present secondary windows");
+  auto fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  glFlush();
+  for (auto &target : secondary_windows) {
+    glfwMakeContextCurrent(target.handle);
+    glWaitSync(fence, 0, GL_TIMEOUT_IGNORED);
+    // The texture changes when the output is reallocated
+    auto texture = target.output.GetTextures()[0];
+    if (texture != target.texture) {
+      glNamedFramebufferTexture(target.framebuffer, GL_COLOR_ATTACHMENT0,
+                                texture, 0);
+      target.texture = texture;
+    }
+    int width = target.output.GetWidth();
+    int height = target.output.GetHeight();
+    glBlitNamedFramebuffer(target.framebuffer, 0, 0, 0, width, height, 0, 0,
+                           width, height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    glfwSwapBuffers(target.handle);
   }
+  glfwMakeContextCurrent(window);
+  glDeleteSync(fence);
 }
 
-// Updates the variables that depend on the model, view and projection
-void UpdateMatrices() {
-  UpdateCameraConfig();
-  view = glm::lookAt(eye, center, up);
-  auto ratio = (float)window_w / (float)window_h;
-  projection = glm::perspective(glm::radians(60.0f), ratio, 1.5f, 300.0f);
-  UpdateBearMatrices();
-  UpdateGroundMatrices();
+// Destroys the secondary windows the user closed; closing the first one ends
+// the application
+void CloseSecondaryWindows(GLFWwindow *window) {
+  for (size_t i = 0; i < secondary_windows.size();) {
+    auto &target = secondary_windows[i];
+    if (!glfwWindowShouldClose(target.handle)) {
+      ++i;
+      continue;
+    }
+    glfwMakeContextCurrent(target.handle);
+    glDeleteFramebuffers(1, &target.framebuffer);
+    glfwMakeContextCurrent(window);
+    glfwDestroyWindow(target.handle);
+    secondary_windows.erase(secondary_windows.begin() + i);
+  }
 }
 
-// Loads the global opengl configuration
-void LoadGlobalConfiguration() {
-  glEnable(GL_DEPTH_TEST);
-  glfwWindowHint(GLFW_SAMPLES, 8);
-  glEnable(GL_MULTISAMPLE);
+// Buffers whose uploads are printed, by name
+std::vector<std::pair<const char *, UniformBuffer *>> GetUploadBuffers() {
+  return {{"camera", &camera},
+          {"models", &models},
+          {"materials", &materials},
+          {"lights", &lights}};
 }
 
-// Renders the geometry pass
-void RenderGeometry() {
-  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-  geompass_shader.Enable();
-  UpdateLightsBuffer();
-
-  geompass_shader.SetUniformBuffer("MatricesBlock", 2, ground_matrices.GetId());
-  geompass_shader.SetUniform("material_id", GROUND_MATERIAL);
-  ground_mesh.DrawElements(GL_QUADS);
-
-  geompass_shader.SetUniformBuffer("MatricesBlock", 2, bear_matrices.GetId());
-  geompass_shader.SetUniform("material_id", BEAR_MATERIAL);
-  bear_mesh.DrawInstances(GL_TRIANGLES, N_LIGHTS);
-
-  geompass_shader.Disable();
+// Prints the uploads per frame of every buffer since the last print
+void PrintUploadStats(int frames) {
+  for (auto &buffer : GetUploadBuffers()) {
+    auto &stats = buffer.second->GetStats();
+    printf("  %-10s %8.0f bytes %5.1f uploads %5.1f reallocations\n",
+           buffer.first, (double)stats.bytes / frames,
+           (double)stats.uploads / frames,
+           (double)stats.reallocations / frames);
+    buffer.second->ResetStats();
+  }
 }
 
-// Renders the lighting pass
-void RenderLighting() {
-  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-  lightpass_shader.Enable();
+// Prints the average gpu time per frame of every pass since the last print
+void PrintGpuTimes() {
+  for (auto &section : gpu_timer.GetSections())
+    printf("  %-10s %6.2f ms\n", section.name.c_str(),
+           section.milliseconds / std::max(section.frames, 1));
+  gpu_timer.ResetSections();
+}
 
-  auto &texts = framebuffer.GetTextures();
-  lightpass_shader.SetTexture2D("position_sampler", 0, texts[0]);
-  lightpass_shader.SetTexture2D("normal_sampler", 1, texts[1]);
-  lightpass_shader.SetTexture2D("material_sampler", 2, texts[2]);
+// Prints the statistics per frame of every pass since the last print; the
+// overdraw is the fragments shaded by the geometry pass per G-buffer pixel
+void PrintPipelineStats() {
+  for (auto &section : pipeline_stats.GetSections()) {
+    int frames = std::max(section.frames, 1);
+    printf("  %-10s %10.0f vertices %10.0f primitives %10.0f fragments",
+           section.name.c_str(), section.vertices / frames,
+           section.primitives / frames, section.fragments / frames);
+    if (section.name == "geometry")
+      printf("  %.2fx overdraw",
+             section.fragments / frames /
+                 ((double)framebuffer.GetWidth() * framebuffer.GetHeight()));
+    printf("\n");
+  }
+  pipeline_stats.ResetSections();
+}
 
-  lightpass_shader.SetUniformBuffer("MaterialsBlock", 0, materials.GetId());
-  lightpass_shader.SetUniformBuffer("LightsBlock", 1, lights.GetId());
+// Prints the percentiles of every series of frame times
+void PrintFrameTimes() {
+  for (int i = 0; i < FrameTimes::N_SERIES; ++i) {
+    auto series = (FrameTimes::Series)i;
+    auto percentiles = frame_times.GetPercentiles(series);
+    printf("  %-6s p50 %6.2f  p95 %6.2f  p99 %6.2f  max %6.2f ms\n",
+           FrameTimes::GetName(series), percentiles.p50, percentiles.p95,
+           percentiles.p99, percentiles.max);
+  }
+}
 
-  screen_quad.DrawElements(GL_QUADS);
+// Replaces the text of the overlay with the statistics of the frames since
+// the last update; the gpu times and the uploads start over unless they are
+// printed too, which then starts them over
+void UpdateHudText(int frames, int visible_lights, int folded_lights) {
+  std::vector<std::string> lines;
+  char line[64];
+  auto frame = frame_times.GetPercentiles(FrameTimes::FRAME_TIME);
+  snprintf(line, sizeof(line), "fps %d  frame %.2f ms  p99 %.2f ms", frames,
+           frame.p50, frame.p99);
+  lines.push_back(line);
+  snprintf(line, sizeof(line), "cpu %.2f ms  gpu %.2f ms",
+           frame_times.GetPercentiles(FrameTimes::CPU_TIME).p50,
+           frame_times.GetPercentiles(FrameTimes::GPU_TIME).p50);
+  lines.push_back(line);
+  for (auto &section : gpu_timer.GetSections()) {
+    snprintf(line, sizeof(line), "  %-12s %6.2f ms", section.name.c_str(),
+             section.milliseconds / std::max(section.frames, 1));
+    lines.push_back(line);
+  }
+  if (!gpu_times)
+    gpu_timer.ResetSections();
+  snprintf(line, sizeof(line), "draw calls %d",
+           GLState::TakeDrawCount() / frames);
+  lines.push_back(line);
+  snprintf(line, sizeof(line), "triangles %lld", hud.GetPrimitives());
+  lines.push_back(line);
+  snprintf(line, sizeof(line), "lights %d of %d visible", visible_lights,
+           scene_description.GetLightCount());
+  lines.push_back(line);
+  if (cluster_light_budget) {
+    snprintf(line, sizeof(line), "folded lights %d", folded_lights);
+    lines.push_back(line);
+  }
+  size_t bytes = 0;
+  for (auto &buffer : GetUploadBuffers()) {
+    bytes += buffer.second->GetStats().bytes;
+    if (!upload_stats)
+      buffer.second->ResetStats();
+  }
+  snprintf(line, sizeof(line), "uploads %.0f bytes", (double)bytes / frames);
+  lines.push_back(line);
+  hud.SetText(lines);
+}
 
-  lightpass_shader.Disable();
+// Publishes the statistics of the frames since the last update to the
+// remote clients; the gpu times start over unless they are shown or measured
+// otherwise
+void PublishRemoteStats(int frames, int visible_lights, int folded_lights,
+                        double latency) {
+  char value[160];
+  snprintf(value, sizeof(value),
+           "{\"fps\": %d, \"latency_ms\": %.2f, \"camera\": %d, "
+           "\"lights\": %d, \"active_lights\": %d, "
+           "\"visible_lights\": %d, ",
+           frames, latency, camera_config, scene_description.GetLightCount(),
+           light_transform.GetActiveCount(), visible_lights);
+  std::string stats = value;
+  if (cluster_light_budget) {
+    snprintf(value, sizeof(value), "\"folded_lights\": %d, ", folded_lights);
+    stats += value;
+  }
+  if (quality_governor) {
+    stats += "\"quality\": {";
+    for (int i = 0; i < quality.GetKnobCount(); ++i) {
+      snprintf(value, sizeof(value), "%s\"%s\": %d", i ? ", " : "",
+               quality.GetKnobName(i).c_str(), quality.GetLevel(i));
+      stats += value;
+    }
+    stats += "}, ";
+  }
+  stats += "\"gpu_ms\": {";
+  auto &sections = gpu_timer.GetSections();
+  for (size_t i = 0; i < sections.size(); ++i) {
+    snprintf(value, sizeof(value), "%s\"%s\": %.3f", i ? ", " : "",
+             sections[i].name.c_str(),
+             sections[i].milliseconds / std::max(sections[i].frames, 1));
+    stats += value;
+  }
+  remote.Publish(stats + "}}");
+  if (!gpu_times && !hud_visible && !benchmark_frames)
+    gpu_timer.ResetSections();
 }
 
-// Display callback, renders the sphere
-void Render() {
-  framebuffer.Bind();
-  RenderGeometry();
-  framebuffer.Unbind();
-  RenderLighting();
+// Keeps the counters and the gpu times of the last second for the stats
+// page; the gpu times start over unless they are shown or measured otherwise
+void UpdatePageCounters(int frames, int visible_lights) {
+  page_stats.fps = frames;
+  page_stats.visible_lights = visible_lights;
+  auto &sections = gpu_timer.GetSections();
+  page_stats.n_passes =
+      std::min((int)sections.size(), (int)StatsPage::MAX_PASSES);
+  for (int i = 0; i < page_stats.n_passes; ++i) {
+    auto &pass = page_stats.passes[i];
+    snprintf(pass.name, sizeof(pass.name), "%s", sections[i].name.c_str());
+    pass.milliseconds =
+        sections[i].milliseconds / std::max(sections[i].frames, 1);
+  }
+  if (!gpu_times && !hud_visible && !remote_port && !benchmark_frames)
+    gpu_timer.ResetSections();
 }
 
 // Measures the frames per second (and prints in the terminal)
 void ComputeFPS() {
+  PROFILE_ZONE("fps");
   static double last = glfwGetTime();
   static int frames = 0;
+  static double latency = 0;  // summed over the frames
+  static long long allocations = FrameAllocator::GetHeapAllocations();
+  latency += frame_pipeline.GetLatency();
   double curr = glfwGetTime();
   if (curr - last > 1.0) {
-    printf("fps: %d\r", frames);
+    int visible_lights = light_transform.ReadVisibleCount();
+    // Of the last assignment, not summed over the frames
+    int folded_lights = light_clusters.ReadFoldedCount();
+    if (!stats_page_path.empty())
+      UpdatePageCounters(frames, visible_lights);
+    if (remote_port)
+      PublishRemoteStats(frames, visible_lights, folded_lights,
+                         latency / std::max(frames, 1));
+    if (hud_visible)
+      UpdateHudText(std::max(frames, 1), visible_lights, folded_lights);
+    // The stats take several lines, so the fps can't be overwritten
+    printf("fps: %d (%d of %d lights visible", frames, visible_lights,
+           scene_description.GetLightCount());
+    if (virtual_textures)
+      printf(", %d texture pages", virtual_maps.GetResidentPages());
+    if (cluster_light_budget)
+      printf(", %d lights folded", folded_lights);
+    if (target_gpu_time > 0)
+      printf(", %.0f%% resolution at %.1f ms",
+             dynamic_resolution.GetScale() * 100,
+             dynamic_resolution.GetGpuTime());
+    if (allocation_stats) {
+      long long total = FrameAllocator::GetHeapAllocations();
+      printf(", %.1f allocations per frame, %zu of %zu frame bytes",
+             double(total - allocations) / std::max(frames, 1),
+             FrameAllocator::GetFrameBytes(), FrameAllocator::GetCapacity());
+      allocations = total;
+    }
+    printf(", %.1f ms latency)   %s", latency / std::max(frames, 1),
+           upload_stats || gpu_times || pipeline_stats_report ||
+                   frame_times_report
+               ? "\n"
+               : "\r");
+    if (upload_stats)
+      PrintUploadStats(std::max(frames, 1));
+    if (gpu_times)
+      PrintGpuTimes();
+    if (pipeline_stats_report)
+      PrintPipelineStats();
+    if (frame_times_report)
+      PrintFrameTimes();
     fflush(stdout);
     last += 1.0;
     frames = 0;
+    latency = 0;
   } else {
     frames++;
   }
 }
 
-// Updates the window size (w, h)
-void Resize(GLFWwindow *window) {
-  int width, height;
-  glfwGetFramebufferSize(window, &width, &height);
-  if (width == window_w && height == window_h) return;
-
-  window_w = width;
-  window_h = height;
-  glViewport(0, 0, width, height);
-  framebuffer.Resize(width, height);
-}
-
-// Called each frame
+// Called each frame, starts advancing the simulation on a worker by the
+// time elapsed since the previous frame
 void Idle() {
+  PROFILE_ZONE("idle");
   static double last = glfwGetTime();
   double curr = glfwGetTime();
-  float angle = glm::radians(10 * (curr - last));
+  double elapsed = frame_time > 0 ? frame_time : curr - last;
   last = curr;
-  rotation = glm::rotate(rotation, angle, glm::vec3(0, 1, 0));
+  if (paused)
+    elapsed = 0;
+  camera_time += elapsed;
+  swarm_time += elapsed;
+  skinning_time += elapsed;
+  if (!replay_camera_path.empty())
+    camera_dirty = true;
+  simulation_update = jobs.Submit([elapsed] { AdvanceSimulation(elapsed); });
+}
+
+// Prints the gpu memory of every category, and of the G-buffer at the size
+// it's allocated with
+void PrintMemoryReport() {
+  GpuMemory::PrintStats();
+  printf("  gbuffer         %8.1f MB at %dx%d, %d bytes per sample\n",
+         framebuffer.GetAllocatedBytes() / 1048576.0,
+         framebuffer.GetCapacityWidth(), framebuffer.GetCapacityHeight(),
+         gbuffer_layout.GetBytesPerPixel());
+}
+
+// Writes the poses of --record-camera
+void SaveCameraPath() {
+  if (record_camera_path.empty())
+    return;
+  try {
+    camera_path.Save(record_camera_path);
+    printf("\ncamera path of %.1f s written to %s\n",
+           camera_path.GetDuration(), record_camera_path.c_str());
+  } catch (std::exception &e) {
+    fprintf(stderr, "%s\n", e.what());
+  }
+}
+
+// Waits for the frames of --capture or --stream to be written
+void FinishCapture() {
+  if (capture_directory.empty() && stream_output.empty())
+    return;
+  frame_capture.Finish();
+  auto output = stream_output.empty() ? capture_directory : stream_output;
+  printf("\n%d frames written to %s, %d dropped, %d failed\n",
+         frame_capture.GetWrittenCount(), output.c_str(),
+         frame_capture.GetDroppedCount(), frame_capture.GetFailedCount());
+}
+
+// Writes the trace of --trace
+void WriteTrace() {
+  if (trace_path.empty())
+    return;
+  try {
+    CpuProfiler::Write(trace_path);
+    printf("\ntrace written to %s\n", trace_path.c_str());
+  } catch (std::exception &e) {
+    fprintf(stderr, "%s\n", e.what());
+  }
+}
+
+// Writes the lighting pass permutations of the session to the warm-up list
+void SaveShaderWarmUp() {
+  if (shader_warm_up.empty())
+    return;
+  try {
+    lightpass_shaders.SaveWarmUp(shader_warm_up);
+  } catch (std::exception &e) {
+    fprintf(stderr, "%s\n", e.what());
+  }
+}
+
+// Makes the next frames render, on demand too
+void InvalidateFrame() { settle_frames = ON_DEMAND_SETTLE_FRAMES; }
+
+// Frame buffer size callback
+void FramebufferSize(GLFWwindow *window, int width, int height) {
+  InvalidateFrame();
+}
+
+// Refresh callback, the window system lost the contents of the window
+void Refresh(GLFWwindow *window) { InvalidateFrame(); }
+
+// Returns true if the next frame can differ from the presented one: the
+// lights rotate, something changed a few frames ago at most, or data and
+// shaders are still loading
+bool NeedsFrame() {
+  if (!paused || settle_frames > 0)
+    return true;
+  if (bear_loading.valid() || !uploads.IsEmpty())
+    return true;
+  if (virtual_textures && virtual_maps.IsStreaming())
+    return true;
+  if (!GetDebugDefine().empty()) {
+    auto defines = GetLightpassDefines(false);
+    defines[GetDebugDefine()] = "";
+    if (lightpass_shaders.IsBuilding(defines))
+      return true;
+  }
+  return false;
+}
+
+// Applies the commands the remote clients sent since the last frame
+void ApplyRemoteCommands() {
+  RemoteControl::Command command;
+  while (remote.Poll(&command)) {
+    InvalidateFrame();
+    switch (command.type) {
+      case RemoteControl::Command::CAMERA:
+        if (command.value < 0 ||
+            command.value >= scene_description.GetCameraCount()) {
+          fprintf(stderr, "\nremote: camera %d not found\n", command.value);
+          break;
+        }
+        camera_config = command.value;
+        camera_dirty = true;
+        break;
+      case RemoteControl::Command::LIGHTS:
+        light_transform.SetActiveCount(command.value);
+        break;
+      case RemoteControl::Command::PASS:
+        if (!render_graph.HasPass(command.pass)) {
+          fprintf(stderr, "\nremote: pass %s not found\n", command.pass);
+          break;
+        }
+        render_graph.SetPassEnabled(command.pass, command.value);
+        gbuffer_version++;
+        break;
+    }
+  }
 }
 
 // Keyboard callback
 void Keyboard(GLFWwindow *window, int key, int scancode, int action, int mods) {
   if (action != GLFW_PRESS) return;
+  InvalidateFrame();
+  gbuffer_version++;
 
   switch (key) {
     case GLFW_KEY_Q:
+      render_targets.PrintStats();
+      SaveShaderWarmUp();
+      SaveCameraPath();
+      WriteTrace();
+      if (memory_report)
+        PrintMemoryReport();
       exit(0);
       break;
     case GLFW_KEY_SPACE:
-      camera_config = (camera_config + 1) % N_CAMERA_CONFIGS;
+      camera_config =
+          (camera_config + 1) % scene_description.GetCameraCount();
+      fly_camera = false;
+      camera_dirty = true;
+      break;
+    case GLFW_KEY_N:
+      debug_normals = !debug_normals;
+      debug_light_count = false;
+      break;
+    case GLFW_KEY_L:
+      debug_light_count = !debug_light_count;
+      debug_normals = false;
+      break;
+    case GLFW_KEY_O:
+      show_quad_overdraw = !show_quad_overdraw;
+      break;
+    case GLFW_KEY_P:
+      paused = !paused;
+      break;
+    case GLFW_KEY_F1:
+      // The passes are timed while the overlay is shown, and the draw calls
+      // counted while hidden are dropped
+      hud_visible = !hud_visible;
+      render_graph.SetTimer(TimesPasses() ? &gpu_timer : nullptr);
+      GLState::TakeDrawCount();
       break;
     default:
       break;
   }
 }
 
+// Checks if the camera follows the user, not a replay or the benchmark
+bool IsCameraInteractive() {
+  return replay_camera_path.empty() && benchmark_frames == 0;
+}
+
+// Makes the free-fly camera start from the current one
+void StartFlyCamera() {
+  if (fly_camera)
+    return;
+  auto direction = glm::normalize(center - eye);
+  fly_yaw = std::atan2(direction.x, -direction.z);
+  fly_pitch = std::asin(glm::clamp(direction.y, -1.0f, 1.0f));
+  fly_camera = true;
+}
+
+// Checks if a key is held, as the render thread replayed it if one runs
+bool IsKeyHeld(GLFWwindow *window, int key) {
+  if (render_thread)
+    return replayed_keys[key];
+  return glfwGetKey(window, key) == GLFW_PRESS;
+}
+
+// Moves the free-fly camera with the keys held since the last frame
+void UpdateFlyCamera(GLFWwindow *window) {
+  static double last = glfwGetTime();
+  double curr = glfwGetTime();
+  float elapsed = curr - last;
+  last = curr;
+  if (!IsCameraInteractive())
+    return;
+  glm::vec2 move(0.0f);  // right and forward
+  if (IsKeyHeld(window, GLFW_KEY_W))
+    move.y += 1;
+  if (IsKeyHeld(window, GLFW_KEY_S))
+    move.y -= 1;
+  if (IsKeyHeld(window, GLFW_KEY_D))
+    move.x += 1;
+  if (IsKeyHeld(window, GLFW_KEY_A))
+    move.x -= 1;
+  if (move == glm::vec2(0.0f))
+    return;
+  StartFlyCamera();
+  float speed = FLY_SPEED * elapsed;
+  if (IsKeyHeld(window, GLFW_KEY_LEFT_SHIFT))
+    speed *= FLY_SHIFT_FACTOR;
+  auto forward = GetFlyDirection();
+  auto right = glm::normalize(glm::cross(forward, glm::vec3(0, 1, 0)));
+  eye += (right * move.x + forward * move.y) * speed;
+  camera_dirty = true;
+  InvalidateFrame();
+}
+
+// Starts or ends dragging the free-fly camera from a cursor position, or
+// picks the pixel of the G-buffer under it
+void PressButton(int button, int action, double x, double y) {
+  if (picking && button == GLFW_MOUSE_BUTTON_RIGHT && action == GLFW_PRESS) {
+    // The cursor is from the top left of the window, the G-buffer is scaled
+    // from the bottom left
+    float scale_x = (float)framebuffer.GetWidth() / window_w;
+    float scale_y = (float)framebuffer.GetHeight() / window_h;
+    object_picking.Request(x * scale_x, (window_h - y) * scale_y);
+    return;
+  }
+  if (button != GLFW_MOUSE_BUTTON_LEFT)
+    return;
+  fly_dragging = action == GLFW_PRESS;
+  drag_x = x;
+  drag_y = y;
+}
+
 // Mouse Callback
 void Mouse(GLFWwindow *window, int button, int action, int mods) {
   double x, y;
   glfwGetCursorPos(window, &x, &y);
+  PressButton(button, action, x, y);
+}
+
+// Motion callback, turns the free-fly camera while dragging
+void Motion(GLFWwindow *window, double x, double y) {
+  if (!fly_dragging || !IsCameraInteractive())
+    return;
+  StartFlyCamera();
+  fly_yaw += (x - drag_x) * FLY_RADIANS_PER_PIXEL;
+  float max_pitch = glm::radians(89.0f);
+  fly_pitch = glm::clamp(
+      fly_pitch - (float)((y - drag_y) * FLY_RADIANS_PER_PIXEL), -max_pitch,
+      max_pitch);
+  drag_x = x;
+  drag_y = y;
+  camera_dirty = true;
+  InvalidateFrame();
+}
+
+// Keyboard callback of the main thread, queues presses and releases
+void QueueKey(GLFWwindow *window, int key, int scancode, int action,
+              int mods) {
+  if (action != GLFW_REPEAT && key >= 0)
+    pending_events.push_back({WindowEvent::KEY, key, action, 0, 0});
+}
+
+// Mouse callback of the main thread, queues the button with the cursor
+void QueueButton(GLFWwindow *window, int button, int action, int mods) {
+  double x, y;
+  glfwGetCursorPos(window, &x, &y);
+  pending_events.push_back({WindowEvent::BUTTON, button, action, x, y});
+}
+
+// Motion callback of the main thread
+void QueueMotion(GLFWwindow *window, double x, double y) {
+  pending_events.push_back({WindowEvent::MOTION, 0, 0, x, y});
+}
+
+// Frame buffer size callback of the main thread
+void QueueFramebufferSize(GLFWwindow *window, int width, int height) {
+  pending_events.push_back(
+      {WindowEvent::FRAMEBUFFER_SIZE, width, height, 0, 0});
+}
+
+// Refresh callback of the main thread
+void QueueRefresh(GLFWwindow *window) {
+  pending_events.push_back({WindowEvent::REFRESH, 0, 0, 0, 0});
+}
+
+// Replays on the render thread the events of the packets the main thread
+// queued, in order, through the callbacks of the single thread
+void ReplayWindowEvents(GLFWwindow *window) {
+  PROFILE_ZONE("replay events");
+  while (window_events.Pop(&replayed_events)) {
+    for (auto &event : replayed_events) {
+      switch (event.type) {
+        case WindowEvent::KEY:
+          replayed_keys[event.key] = event.action == GLFW_PRESS;
+          Keyboard(window, event.key, 0, event.action, 0);
+          break;
+        case WindowEvent::BUTTON:
+          PressButton(event.key, event.action, event.x, event.y);
+          break;
+        case WindowEvent::MOTION:
+          Motion(window, event.x, event.y);
+          break;
+        case WindowEvent::FRAMEBUFFER_SIZE:
+          replayed_framebuffer_w = event.key;
+          replayed_framebuffer_h = event.action;
+          FramebufferSize(window, event.key, event.action);
+          break;
+        case WindowEvent::REFRESH:
+          Refresh(window);
+          break;
+      }
+    }
+  }
+}
+
+// Appends the options of a configuration file, one per line with or without
+// the leading dashes, where # starts a comment, and the ones of the files it
+// includes in their place; their paths are relative to the file
+void ReadConfigFile(const std::string &path, int depth,
+                    std::vector<std::string> *arguments) {
+  Assertf(depth < MAX_CONFIG_DEPTH,
+          "--config=%s is nested more than %d files deep", path.c_str(),
+          MAX_CONFIG_DEPTH);
+  std::ifstream file(path);
+  Assertf(file.is_open(), "can't read the configuration %s", path.c_str());
+  auto slash = path.rfind('/');
+  auto directory =
+      slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+  std::string line;
+  while (std::getline(file, line)) {
+    line = line.substr(0, line.find('#'));
+    auto begin = line.find_first_not_of(" \t\r");
+    if (begin == std::string::npos)
+      continue;
+    auto end = line.find_last_not_of(" \t\r");
+    auto option = line.substr(begin, end - begin + 1);
+    if (option.compare(0, 2, "--"))
+      option = "--" + option;
+    if (option.compare(0, 9, "--config=") == 0) {
+      auto included = option.substr(9);
+      if (!included.empty() && included[0] != '/')
+        included = directory + included;
+      ReadConfigFile(included, depth + 1, arguments);
+      continue;
+    }
+    arguments->push_back(option);
+    argument_files.push_back(path);
+  }
+}
+
+// Replaces each --config=<file> of the command line by the options of the
+// file; the options after it override the ones of the file
+void ExpandArguments(int *argc, char ***argv) {
+  static std::vector<std::string> arguments;
+  static std::vector<char *> pointers;
+  arguments.assign(*argv, *argv + 1);
+  argument_files.assign(1, "");
+  for (int i = 1; i < *argc; ++i) {
+    std::string argument = (*argv)[i];
+    if (argument.compare(0, 9, "--config=") == 0) {
+      ReadConfigFile(argument.substr(9), 0, &arguments);
+    } else {
+      arguments.push_back(argument);
+      argument_files.push_back("");
+    }
+  }
+  pointers.clear();
+  for (auto &argument : arguments)
+    pointers.push_back(&argument[0]);
+  pointers.push_back(nullptr);
+  *argc = arguments.size();
+  *argv = pointers.data();
 }
 
-// Motion callback
-void Motion(GLFWwindow *window, double x, double y) {}
+// Reads the rendering options from the command line
+void ParseArguments(int argc, char *argv[]) {
+  command_line.assign(argv + 1, argv + argc);
+  bool gbuffer_given = false;
+  for (int i = 1; i < argc; ++i) {
+    auto arg = std::string(argv[i]);
+    if (arg == "--gbuffer=list") {
+      GBufferLayout::PrintPresets();
+      exit(0);
+    } else if (arg.compare(0, 10, "--gbuffer=") == 0) {
+      gbuffer_given = true;
+      try {
+        gbuffer_layout.Parse(argv[i] + 10);
+      } catch (std::exception &e) {
+        Assertf(false, "%s", e.what());
+      }
+    } else if (arg == "--half-float") {
+      half_float = true;
+    } else if (arg == "--gbuffer-report") {
+      gbuffer_report = true;
+    } else if (arg == "--memory-report") {
+      memory_report = true;
+    } else if (arg == "--upload-thread") {
+      upload_thread = true;
+    } else if (arg == "--overdraw") {
+      overdraw = true;
+    } else if (arg == "--picking") {
+      picking = true;
+    } else if (arg == "--render-thread") {
+      render_thread = true;
+    } else if (arg == "--pin-threads") {
+      pin_threads = true;
+    } else if (arg == "--pin-threads=smt") {
+      pin_threads = true;
+      pin_smt_threads = true;
+    } else if (arg == "--upload-stats") {
+      upload_stats = true;
+    } else if (arg == "--gpu-times") {
+      gpu_times = true;
+    } else if (arg == "--allocation-stats") {
+      allocation_stats = true;
+    } else if (arg == "--pipeline-stats") {
+      pipeline_stats_report = true;
+    } else if (sscanf(argv[i], "--benchmark=%d", &benchmark_frames) == 1) {
+      Assertf(benchmark_frames > 0, "invalid benchmark frames: %d",
+              benchmark_frames);
+    } else if (arg.compare(0, 19, "--benchmark-output=") == 0) {
+      benchmark_path = argv[i] + 19;
+    } else if (arg.compare(0, 8, "--trace=") == 0) {
+      trace_path = argv[i] + 8;
+    } else if (arg.compare(0, 10, "--capture=") == 0) {
+      capture_directory = argv[i] + 10;
+    } else if (arg.compare(0, 16, "--record-camera=") == 0) {
+      record_camera_path = argv[i] + 16;
+    } else if (arg.compare(0, 16, "--replay-camera=") == 0) {
+      replay_camera_path = argv[i] + 16;
+    } else if (sscanf(argv[i], "--remote=%d", &remote_port) == 1) {
+      Assertf(remote_port > 0 && remote_port < 65536,
+              "invalid remote port: %d", remote_port);
+    } else if (arg.compare(0, 9, "--stream=") == 0) {
+      stream_output = argv[i] + 9;
+    } else if (arg == "--frame-times") {
+      frame_times_report = true;
+    } else if (arg.compare(0, 14, "--frame-times=") == 0) {
+      frame_times_report = true;
+      frame_times_path = argv[i] + 14;
+    } else if (arg.compare(0, 13, "--stats-page=") == 0) {
+      stats_page_path = argv[i] + 13;
+    } else if (arg.compare(0, 15, "--dump-gbuffer=") == 0) {
+      gbuffer_dump_path = argv[i] + 15;
+    } else if (arg == "--telemetry") {
+      telemetry_period = DEFAULT_TELEMETRY_PERIOD;
+    } else if (sscanf(argv[i], "--telemetry=%d", &telemetry_period) == 1) {
+      Assertf(telemetry_period > 0, "invalid telemetry period: %d",
+              telemetry_period);
+    } else if (arg == "--core-profile") {
+      core_profile = true;
+    } else if (arg == "--on-demand") {
+      on_demand = true;
+    } else if (arg == "--paused") {
+      paused = true;
+    } else if (arg == "--bindless-textures") {
+      bindless_maps = true;
+    } else if (arg == "--virtual-textures") {
+      virtual_textures = true;
+    } else if (arg == "--spirv") {
+      spirv = true;
+    } else if (arg == "--cpu-light-culling") {
+      cpu_light_culling = true;
+    } else if (arg == "--hot-reload") {
+      hot_reload = true;
+      ShaderProgram::SetReadFromDisk(true);
+    } else if (arg.compare(0, 17, "--shader-warm-up=") == 0) {
+      shader_warm_up = argv[i] + 17;
+    } else if (arg.compare(0, 15, "--shader-cache=") == 0) {
+      ShaderProgram::SetBinaryCache(argv[i] + 15);
+    } else if (arg.compare(0, 13, "--mesh-cache=") == 0) {
+      mesh_cache = argv[i] + 13;
+    } else if (arg.compare(0, 8, "--scene=") == 0) {
+      scene_path = argv[i] + 8;
+    } else if (arg.compare(0, 14, "--write-scene=") == 0) {
+      write_scene_path = argv[i] + 14;
+    } else if (arg == "--fxaa" || arg == "--fxaa=low") {
+      fxaa_steps = FXAA_LOW_STEPS;
+    } else if (arg == "--fxaa=high") {
+      fxaa_steps = FXAA_HIGH_STEPS;
+    } else if (arg == "--shading-rate" || arg == "--shading-rate=2x2") {
+      shading_rate = true;
+      coarse_shading_rate = ShadingRateImage::RATE_2X2;
+    } else if (arg == "--shading-rate=4x4") {
+      shading_rate = true;
+      coarse_shading_rate = ShadingRateImage::RATE_4X4;
+    } else if (arg == "--hdr") {
+      hdr = true;
+    } else if (arg == "--ssao") {
+      ssao = true;
+    } else if (arg == "--reflections") {
+      reflections = true;
+    } else if (arg == "--fog") {
+      fog_density = DEFAULT_FOG_DENSITY;
+    } else if (sscanf(argv[i], "--fog=%f", &fog_density) == 1) {
+      Assertf(fog_density > 0, "invalid fog density: %f", fog_density);
+    } else if (arg == "--bloom") {
+      bloom_strength = DEFAULT_BLOOM_STRENGTH;
+    } else if (sscanf(argv[i], "--bloom=%f", &bloom_strength) == 1) {
+      Assertf(bloom_strength > 0 && bloom_strength <= 1,
+              "invalid bloom strength: %f", bloom_strength);
+    } else if (sscanf(argv[i], "--exposure=%f", &exposure) == 1) {
+      Assertf(exposure > 0, "invalid exposure: %f", exposure);
+    } else if (arg == "--taa") {
+      taa = true;
+    } else if (sscanf(argv[i], "--render-scale=%f", &render_scale) == 1) {
+      Assertf(render_scale >= 0.25f && render_scale <= 1,
+              "invalid render scale: %f", render_scale);
+    } else if (arg == "--spot-shadows") {
+      shadow_budget = DEFAULT_SHADOW_BUDGET;
+    } else if (sscanf(argv[i], "--spot-shadows=%d", &shadow_budget) == 1) {
+      Assertf(shadow_budget > 0, "invalid shadow budget: %d", shadow_budget);
+    } else if (arg == "--ray-traced-shadows") {
+      ray_traced_shadows = true;
+    } else if (arg == "--sun") {
+      sun_period = DEFAULT_SUN_PERIOD;
+    } else if (sscanf(argv[i], "--sun=%d", &sun_period) == 1) {
+      Assertf(sun_period > 0, "invalid sun period: %d", sun_period);
+    } else if (arg == "--decals") {
+      n_decals = DEFAULT_DECALS;
+    } else if (sscanf(argv[i], "--decals=%d", &n_decals) == 1) {
+      Assertf(n_decals > 0, "invalid decals: %d", n_decals);
+    } else if (arg == "--transparent") {
+      n_transparent = DEFAULT_TRANSPARENT;
+    } else if (sscanf(argv[i], "--transparent=%d", &n_transparent) == 1) {
+      Assertf(n_transparent > 0, "invalid transparent objects: %d",
+              n_transparent);
+    } else if (arg == "--instanced-transparent") {
+      instanced_transparent = true;
+    } else if (arg == "--weighted-transparency") {
+      weighted_transparency = true;
+    } else if (arg == "--visibility-buffer") {
+      visibility_buffer = true;
+    } else if (arg == "--light-prepass") {
+      light_prepass = true;
+    } else if (arg == "--depth-prepass") {
+      depth_prepass = true;
+    } else if (arg == "--sort-instances") {
+      sort_instances = true;
+    } else if (arg == "--compact-models") {
+      compact_models = true;
+    } else if (arg == "--vertex-pulling") {
+      vertex_pulling = true;
+    } else if (arg == "--skinning") {
+      skinning_poses = DEFAULT_SKINNING_POSES;
+    } else if (sscanf(argv[i], "--skinning=%d", &skinning_poses) == 1) {
+      Assertf(skinning_poses > 0, "invalid skinning poses: %d",
+              skinning_poses);
+    } else if (arg == "--occlusion-queries") {
+      occlusion_queries = true;
+    } else if (sscanf(argv[i], "--impostors=%f", &impostor_distance) == 1) {
+      Assertf(impostor_distance > 0, "invalid impostor distance: %f",
+              impostor_distance);
+    } else if (arg == "--framebuffer-fetch") {
+      framebuffer_fetch = true;
+    } else if (sscanf(argv[i], "--msaa=%d", &msaa_samples) == 1) {
+      Assertf(msaa_samples >= 0 && msaa_samples <= 32, "invalid samples: %d",
+              msaa_samples);
+      if (msaa_samples == 1)
+        msaa_samples = 0;
+    } else if (arg == "--vsync=on") {
+      present_mode = PRESENT_VSYNC;
+    } else if (arg == "--vsync=off") {
+      present_mode = PRESENT_IMMEDIATE;
+    } else if (arg == "--vsync=adaptive") {
+      present_mode = PRESENT_ADAPTIVE;
+    } else if (sscanf(argv[i], "--frame-time=%lf", &frame_time) == 1) {
+      Assertf(frame_time > 0, "invalid frame time: %f", frame_time);
+    } else if (sscanf(argv[i], "--max-fps=%f", &max_fps) == 1) {
+      Assertf(max_fps > 0, "invalid max fps: %f", max_fps);
+    } else if (arg == "--lighting=fullscreen") {
+      lighting_mode = LIGHTING_FULLSCREEN;
+    } else if (arg == "--lighting=tiled") {
+      lighting_mode = LIGHTING_TILED;
+    } else if (arg == "--lighting=clustered") {
+      lighting_mode = LIGHTING_CLUSTERED;
+    } else if (arg == "--compute-lighting") {
+      compute_lighting = true;
+    } else if (arg == "--lighting=volumes") {
+      lighting_mode = LIGHTING_VOLUMES;
+    } else if (arg == "--lighting=stochastic") {
+      lighting_mode = LIGHTING_STOCHASTIC;
+    } else if (arg == "--lighting=lightcuts") {
+      lighting_mode = LIGHTING_LIGHTCUTS;
+    } else if (sscanf(argv[i], "--light-samples=%d", &light_samples) == 1) {
+      Assertf(light_samples > 0, "invalid light samples: %d", light_samples);
+    } else if (sscanf(argv[i], "--light-cut-error=%f", &light_cut_error) ==
+               1) {
+      Assertf(light_cut_error > 0, "invalid light cut error: %f",
+              light_cut_error);
+    } else if (arg == "--fast-lighting") {
+      fast_lighting = true;
+    } else if (arg == "--half-lighting") {
+      half_lighting = true;
+    } else if (arg == "--stereo") {
+      eye_distance = DEFAULT_EYE_DISTANCE;
+    } else if (sscanf(argv[i], "--stereo=%f", &eye_distance) == 1) {
+      Assertf(eye_distance > 0, "invalid eye distance: %f", eye_distance);
+    } else if (arg == "--camera-wall") {
+      camera_wall = true;
+    } else if (sscanf(argv[i], "--lights=%dx%d", &n_lights_i, &n_lights_j) ==
+               2) {
+      Assertf(n_lights_i > 0 && n_lights_j > 0, "invalid lights: %s",
+              argv[i] + 9);
+    } else if (sscanf(argv[i], "--bears=%dx%d", &n_bears_i, &n_bears_j) ==
+               2) {
+      Assertf(n_bears_i > 0 && n_bears_j > 0, "invalid bears: %s",
+              argv[i] + 8);
+    } else if (sscanf(argv[i], "--spacing=%f", &grid_spacing) == 1) {
+      Assertf(grid_spacing > 0, "invalid spacing: %f", grid_spacing);
+    } else if (sscanf(argv[i], "--world-partition=%f", &world_cell_size) ==
+               1) {
+      Assertf(world_cell_size > 0, "invalid world partition: %f",
+              world_cell_size);
+    } else if (sscanf(argv[i], "--stream-radius=%f", &stream_radius) == 1) {
+      Assertf(stream_radius > 0, "invalid stream radius: %f", stream_radius);
+    } else if (sscanf(argv[i], "--cell-budget=%d", &cell_budget) == 1) {
+      Assertf(cell_budget > 0, "invalid cell budget: %d", cell_budget);
+    } else if (sscanf(argv[i], "--window=%dx%d", &window_w, &window_h) == 2) {
+      Assertf(window_w > 0 && window_h > 0, "invalid window size: %s",
+              argv[i] + 9);
+    } else if (sscanf(argv[i], "--light-range=%f", &light_range) == 1) {
+      Assertf(light_range > 0, "invalid light range: %f", light_range);
+    } else if (arg == "--light-lod") {
+      light_lod_radius = DEFAULT_LIGHT_LOD_RADIUS;
+    } else if (sscanf(argv[i], "--light-lod=%f", &light_lod_radius) == 1) {
+      Assertf(light_lod_radius > 0, "invalid light lod radius: %f",
+              light_lod_radius);
+    } else if (sscanf(argv[i], "--light-swarm=%d", &light_swarm_size) == 1) {
+      Assertf(light_swarm_size > 0 && light_swarm_size <= MAX_SWARM_LIGHTS,
+              "invalid light swarm size: %d", light_swarm_size);
+    } else if (arg == "--lighting-cache") {
+      lighting_cache = true;
+    } else if (arg == "--ground-cache") {
+      ground_cache = true;
+    } else if (arg == "--light-bvh") {
+      light_bvh = true;
+    } else if (sscanf(argv[i], "--cluster-light-budget=%d",
+                      &cluster_light_budget) == 1) {
+      Assertf(cluster_light_budget >= 1 &&
+                  cluster_light_budget <= MAX_CLUSTER_LIGHT_BUDGET,
+              "invalid cluster light budget: %d", cluster_light_budget);
+    } else if (sscanf(argv[i], "--frames-in-flight=%d", &frames_in_flight) ==
+               1) {
+      Assertf(frames_in_flight >= 1 && frames_in_flight <= 4,
+              "invalid frames in flight: %d", frames_in_flight);
+    } else if (sscanf(argv[i], "--windows=%d", &n_windows) == 1) {
+      Assertf(n_windows >= 1, "invalid windows: %d", n_windows);
+    } else if (sscanf(argv[i], "--dynamic-resolution=%f", &target_gpu_time) ==
+               1) {
+      Assertf(target_gpu_time > 0, "invalid gpu time: %f", target_gpu_time);
+    } else if (arg == "--quality-governor") {
+      quality_governor = true;
+    } else if (sscanf(argv[i], "--lighting-scale=%f", &lighting_scale) == 1) {
+      Assertf(lighting_scale > 0 && lighting_scale <= 1,
+              "invalid lighting scale: %f", lighting_scale);
+    } else if (arg.compare(0, 15, "--disable-pass=") == 0) {
+      disabled_passes.push_back(argv[i] + 15);
+    } else if (arg == "--normal-report") {
+      PrintNormalEncodingReport();
+      exit(0);
+    } else if (arg.compare(0, 13, "--fullscreen=") == 0) {
+      // Read by GetGLFWMonitor()
+    } else if (!argument_files[i].empty()) {
+      // A misspelled option of a file would run another configuration
+      Assertf(false, "unknown option %s in %s", argv[i],
+              argument_files[i].c_str());
+    } else {
+      fprintf(stderr, "unknown option %s ignored\n", argv[i]);
+    }
+  }
+  Assert(lighting_mode != LIGHTING_TILED || !msaa_samples,
+         "--msaa doesn't work with --lighting=tiled");
+  Assert(lighting_mode != LIGHTING_VOLUMES || !msaa_samples,
+         "--msaa doesn't work with --lighting=volumes");
+  Assert(!compute_lighting || lighting_mode == LIGHTING_FULLSCREEN ||
+             lighting_mode == LIGHTING_CLUSTERED,
+         "--compute-lighting only works with --lighting=fullscreen|clustered");
+  Assert((lighting_mode != LIGHTING_STOCHASTIC &&
+          lighting_mode != LIGHTING_LIGHTCUTS) ||
+             !shadow_budget,
+         "--spot-shadows doesn't work with --lighting=stochastic|lightcuts");
+  Assert(!compute_lighting || !msaa_samples,
+         "--msaa doesn't work with --compute-lighting");
+  bool scaled = lighting_scale < 1.0f;
+  Assert(!scaled || !compute_lighting,
+         "--lighting-scale doesn't work with --compute-lighting");
+  Assert(!scaled || lighting_mode == LIGHTING_FULLSCREEN ||
+             lighting_mode == LIGHTING_CLUSTERED,
+         "--lighting-scale only works with --lighting=fullscreen|clustered");
+  Assert(!scaled || !msaa_samples, "--msaa doesn't work with --lighting-scale");
+  Assert(!fxaa_steps || !msaa_samples, "--msaa doesn't work with --fxaa");
+  Assert(!taa || !msaa_samples, "--msaa doesn't work with --taa");
+  Assert(!hdr || !msaa_samples, "--msaa doesn't work with --hdr");
+  Assert(exposure == 1.0f || hdr, "--exposure requires --hdr");
+  Assert(!bloom_strength || hdr, "--bloom requires --hdr");
+  Assert(render_scale == 1.0f || taa, "--render-scale requires --taa");
+  Assert(!shadow_budget || !spirv, "--spot-shadows doesn't work with --spirv");
+  // The hierarchy is of the meshes at rest
+  Assert(!ray_traced_shadows ||
+             (!shadow_budget && !spirv && !skinning_poses &&
+              lighting_mode != LIGHTING_STOCHASTIC &&
+              lighting_mode != LIGHTING_LIGHTCUTS),
+         "--ray-traced-shadows doesn't work with --spot-shadows, --spirv, "
+         "--skinning or --lighting=stochastic|lightcuts");
+  Assert(!sun_period || !spirv, "--sun doesn't work with --spirv");
+  Assert(!n_decals || !msaa_samples, "--msaa doesn't work with --decals");
+  Assert(!visibility_buffer || !msaa_samples,
+         "--msaa doesn't work with --visibility-buffer");
+  Assert(!visibility_buffer || !depth_prepass,
+         "--depth-prepass doesn't work with --visibility-buffer");
+  Assert(!occlusion_queries || !depth_prepass,
+         "--occlusion-queries doesn't work with --depth-prepass");
+  Assert(!occlusion_queries || !visibility_buffer,
+         "--occlusion-queries doesn't work with --visibility-buffer");
+  Assert(!occlusion_queries || (!eye_distance && !camera_wall),
+         "--occlusion-queries doesn't work with --stereo or --camera-wall");
+  Assert(!impostor_distance || !depth_prepass,
+         "--impostors doesn't work with --depth-prepass");
+  Assert(!impostor_distance || !visibility_buffer,
+         "--impostors doesn't work with --visibility-buffer");
+  Assert(!impostor_distance || !virtual_textures,
+         "--impostors doesn't work with --virtual-textures");
+  Assert(!impostor_distance || (!eye_distance && !camera_wall),
+         "--impostors doesn't work with --stereo or --camera-wall");
+  // The views would be counted over each other
+  Assert(!overdraw || (!eye_distance && !camera_wall),
+         "--overdraw doesn't work with --stereo or --camera-wall");
+  Assert(!visibility_buffer || !virtual_textures,
+         "--virtual-textures doesn't work with --visibility-buffer");
+  Assert(!bindless_maps || !virtual_textures,
+         "--bindless-textures doesn't work with --virtual-textures");
+  Assert(!framebuffer_fetch || gbuffer_layout.StoresPosition(),
+         "--framebuffer-fetch needs a --gbuffer layout with the position");
+  Assert(!instanced_transparent || n_transparent,
+         "--instanced-transparent needs --transparent");
+  Assert(!weighted_transparency || n_transparent,
+         "--weighted-transparency needs --transparent");
+  Assert(!framebuffer_fetch ||
+             (!UsesComputeLighting() && lighting_mode != LIGHTING_VOLUMES &&
+              !msaa_samples && lighting_scale == 1.0f),
+         "--framebuffer-fetch doesn't work with --msaa, --lighting=tiled, "
+         "--lighting=volumes, --compute-lighting or --lighting-scale");
+  Assert(!framebuffer_fetch || !ssao,
+         "--framebuffer-fetch doesn't work with --ssao");
+  Assert(!framebuffer_fetch || (!n_transparent && !shading_rate),
+         "--framebuffer-fetch doesn't work with --transparent or "
+         "--shading-rate");
+  Assert(!framebuffer_fetch || !target_gpu_time,
+         "--framebuffer-fetch doesn't work with --dynamic-resolution");
+  Assert(!light_prepass || (lighting_mode == LIGHTING_FULLSCREEN ||
+                            lighting_mode == LIGHTING_CLUSTERED),
+         "--light-prepass only works with --lighting=fullscreen|clustered");
+  Assert(!light_prepass || (UsesLightBuffer() && !visibility_buffer),
+         "--light-prepass doesn't work with --msaa, --compute-lighting, "
+         "--lighting-scale, --framebuffer-fetch or --visibility-buffer");
+  Assert(gbuffer_dump_path.empty() ||
+             (!msaa_samples && !framebuffer_fetch && !light_prepass &&
+              !eye_distance && !camera_wall),
+         "--dump-gbuffer doesn't work with --msaa, --framebuffer-fetch, "
+         "--light-prepass, --stereo or --camera-wall");
+  Assert(!light_prepass || (!ssao && !n_decals && !impostor_distance &&
+                            !virtual_textures),
+         "--light-prepass doesn't work with --ssao, --decals, --impostors or "
+         "--virtual-textures");
+  Assert(!light_prepass || (!shading_rate && !target_gpu_time),
+         "--light-prepass doesn't work with --shading-rate or "
+         "--dynamic-resolution");
+  // The other passes that write the G-buffer leave the identifiers out, and
+  // a multisampled target can't be copied from
+  Assert(!picking || (!visibility_buffer && !light_prepass &&
+                      !framebuffer_fetch),
+         "--picking doesn't work with --visibility-buffer, --light-prepass or "
+         "--framebuffer-fetch");
+  Assert(!picking || (!impostor_distance && !msaa_samples),
+         "--picking doesn't work with --impostors or --msaa");
+  // The resolve fetches the vertices of the meshes, not the skinned ones
+  Assert(!skinning_poses || !visibility_buffer,
+         "--skinning doesn't work with --visibility-buffer");
+  Assert(!n_transparent || UsesLightBuffer(),
+         "--transparent doesn't work with --msaa, --lighting=tiled, "
+         "--compute-lighting or --lighting-scale");
+  Assert(!fog_density || (lighting_mode == LIGHTING_CLUSTERED &&
+                           !compute_lighting),
+         "--fog only works with --lighting=clustered, without "
+         "--compute-lighting");
+  Assert(!fog_density || (!light_prepass && !framebuffer_fetch),
+         "--fog doesn't work with --light-prepass or --framebuffer-fetch");
+  Assert(!lighting_cache ||
+             (UsesLightBuffer() && !light_prepass && !taa &&
+              lighting_mode != LIGHTING_VOLUMES &&
+              lighting_mode != LIGHTING_STOCHASTIC),
+         "--lighting-cache only works with "
+         "--lighting=fullscreen|clustered|lightcuts, without --msaa, "
+         "--lighting-scale, --framebuffer-fetch, --light-prepass or --taa");
+  Assert(!ground_cache ||
+             ((lighting_mode == LIGHTING_FULLSCREEN ||
+               lighting_mode == LIGHTING_CLUSTERED) &&
+              !compute_lighting && !light_prepass),
+         "--ground-cache only works with --lighting=fullscreen|clustered, "
+         "without --compute-lighting or --light-prepass");
+  Assert(!ground_cache || (!shadow_budget && !ray_traced_shadows &&
+                           !sun_period && !light_swarm_size),
+         "--ground-cache doesn't work with --spot-shadows, "
+         "--ray-traced-shadows, --sun or --light-swarm");
+  Assert(!cluster_light_budget || lighting_mode == LIGHTING_CLUSTERED,
+         "--cluster-light-budget only works with --lighting=clustered");
+  Assert(!light_bvh ||
+             (light_swarm_size && lighting_mode == LIGHTING_CLUSTERED),
+         "--light-bvh only works with --light-swarm and --lighting=clustered");
+  Assert(!reflections || UsesLightBuffer(),
+         "--reflections doesn't work with --msaa, --lighting=tiled, "
+         "--compute-lighting or --lighting-scale");
+  Assert(!shading_rate || UsesLightBuffer(),
+         "--shading-rate doesn't work with --msaa, --lighting=tiled, "
+         "--compute-lighting or --lighting-scale");
+  Assert(render_scale == 1.0f || !scaled,
+         "--render-scale doesn't work with --lighting-scale");
+  Assert(!target_gpu_time || UsesLightBuffer(),
+         "--dynamic-resolution doesn't work with --msaa, --lighting=tiled, "
+         "--compute-lighting or --lighting-scale");
+  Assert(!quality_governor || target_gpu_time,
+         "--quality-governor needs --dynamic-resolution");
+  Assert(!benchmark_frames || !on_demand,
+         "--benchmark doesn't work with --on-demand");
+  Assert(capture_directory.empty() || stream_output.empty(),
+         "--capture doesn't work with --stream");
+  Assert(record_camera_path.empty() || replay_camera_path.empty(),
+         "--record-camera doesn't work with --replay-camera");
+  // The render thread waits for no event, and the secondary windows are
+  // created and destroyed on the thread that polls the events
+  Assert(!render_thread || !on_demand,
+         "--render-thread doesn't work with --on-demand");
+  Assert(!render_thread || n_windows == 1,
+         "--render-thread doesn't work with --windows");
+  // The history of the temporal antialiasing is of one view
+  Assert(n_windows == 1 || !taa, "--windows doesn't work with --taa");
+  Assert(n_windows == 1 || !reflections,
+         "--windows doesn't work with --reflections");
+  // The queries are of the main view
+  Assert(n_windows == 1 || !occlusion_queries,
+         "--windows doesn't work with --occlusion-queries");
+  if (!replay_camera_path.empty()) {
+    try {
+      camera_path.Load(replay_camera_path);
+    } catch (std::exception &e) {
+      Assertf(false, "%s", e.what());
+    }
+  }
+  // Only the geometry and the passes that shade pixel by pixel tell the
+  // views apart
+  bool several_views = eye_distance > 0 || camera_wall;
+  Assert(!camera_wall || !eye_distance,
+         "--stereo doesn't work with --camera-wall");
+  Assert(!several_views || lighting_mode == LIGHTING_FULLSCREEN ||
+             lighting_mode == LIGHTING_STOCHASTIC,
+         "--stereo and --camera-wall only work with "
+         "--lighting=fullscreen|stochastic");
+  Assert(!several_views || (!compute_lighting && !scaled && !taa && !ssao &&
+                            !n_decals && !n_transparent &&
+                            !visibility_buffer && !shading_rate &&
+                            !target_gpu_time),
+         "--stereo and --camera-wall don't work with --compute-lighting, "
+         "--lighting-scale, --taa, --ssao, --decals, --transparent, "
+         "--visibility-buffer, --shading-rate or --dynamic-resolution");
+  Assert(!several_views || !reflections,
+         "--stereo and --camera-wall don't work with --reflections");
+  // The benchmark isn't bound by the display, and its frames are the same in
+  // every run
+  if (benchmark_frames > 0 && present_mode == PRESENT_DEFAULT)
+    present_mode = PRESENT_IMMEDIATE;
+  if (benchmark_frames > 0 && frame_time == 0)
+    frame_time = BENCHMARK_FRAME_TIME;
+  // The lighting of the light pre-pass only reads the normal and the material
+  if (light_prepass && !gbuffer_given)
+    gbuffer_layout.Parse("thin");
+  if (half_float)
+    gbuffer_layout.UseHalfFloats();
+  if (half_float || gbuffer_report)
+    PrintGBufferPrecision();
+  if (fast_lighting) {
+    auto report = ComputeFastLightingError();
+    printf("Fast lighting error: mean %.5f max %.5f (exponent %.0f)\n",
+           report.mean_error, report.max_error, report.max_error_exponent);
+  }
+}
 
 // Obtais the monitor if the fullscreen flag is active
 GLFWmonitor *GetGLFWMonitor(int argc, char *argv[]) {
@@ -510,53 +5410,637 @@ GLFWmonitor *GetGLFWMonitor(int argc, char *argv[]) {
 GLFWwindow *InitGLFW(int argc, char *argv[]) {
   Assert(glfwInit(), "glfw init failed");
   auto monitor = GetGLFWMonitor(argc, argv);
+  // The benchmark renders to a hidden window, so it doesn't need a desktop
+  // to be seen
+  if (benchmark_frames > 0) {
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    monitor = nullptr;
+  }
+  // The antialiasing happens in the G-buffer; the window needs a stencil
+  // buffer for the edge mask
+  glfwWindowHint(GLFW_SAMPLES, 0);
+  glfwWindowHint(GLFW_STENCIL_BITS, 8);
+#if GL_CHECKS > 0
+  glfwWindowHint(GLFW_OPENGL_DEBUG_CONTEXT, GLFW_TRUE);
+#endif
+  if (core_profile) {
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+  }
   auto window = glfwCreateWindow(window_w, window_h, "OpenGL4 Application",
                                  monitor, nullptr);
   Assert(window, "glfw window couldn't be created");
   glfwMakeContextCurrent(window);
-  glfwSetKeyCallback(window, Keyboard);
-  glfwSetMouseButtonCallback(window, Mouse);
-  glfwSetCursorPosCallback(window, Motion);
+  if (render_thread) {
+    glfwSetKeyCallback(window, QueueKey);
+    glfwSetFramebufferSizeCallback(window, QueueFramebufferSize);
+    glfwSetWindowRefreshCallback(window, QueueRefresh);
+    glfwSetMouseButtonCallback(window, QueueButton);
+    glfwSetCursorPosCallback(window, QueueMotion);
+  } else {
+    glfwSetKeyCallback(window, Keyboard);
+    glfwSetFramebufferSizeCallback(window, FramebufferSize);
+    glfwSetWindowRefreshCallback(window, Refresh);
+    glfwSetMouseButtonCallback(window, Mouse);
+    glfwSetCursorPosCallback(window, Motion);
+  }
+  // The context of the loader thread shares the objects of the window's, in
+  // a window never shown
+  if (upload_thread) {
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    loader_window = glfwCreateWindow(1, 1, "loader", nullptr, window);
+    Assert(loader_window, "the loader context couldn't be created");
+  }
+  // The secondary windows share the objects of the first one too, and its
+  // input
+  glfwWindowHint(GLFW_VISIBLE, benchmark_frames > 0 ? GLFW_FALSE : GLFW_TRUE);
+  secondary_windows.reserve(n_windows - 1);
+  for (int i = 1; i < n_windows; ++i) {
+    auto title = "OpenGL4 Application " + std::to_string(i + 1);
+    auto handle = glfwCreateWindow(window_w, window_h, title.c_str(), nullptr,
+                                   window);
+    Assertf(handle, "glfw window %d couldn't be created", i + 1);
+    glfwSetKeyCallback(handle, Keyboard);
+    glfwSetFramebufferSizeCallback(handle, FramebufferSize);
+    glfwSetWindowRefreshCallback(handle, Refresh);
+    int camera = (camera_config + i) % scene_description.GetCameraCount();
+    secondary_windows.push_back({handle, camera, FrameBuffer(), 0, 0});
+  }
   return window;
 }
 
 // Initializes the GLEW
 void InitGLEW() {
+  // Without it GLEW looks the extensions up with glGetString, which core
+  // profiles reject
+  glewExperimental = GL_TRUE;
   auto glew_error = glewInit();
   Assertf(!glew_error, "GLEW error: %s", glewGetErrorString(glew_error));
+  // The geometry pass reads its draw data with gl_BaseInstanceARB
+  Assert(GLEW_ARB_shader_draw_parameters,
+         "ARB_shader_draw_parameters not supported");
+  // The vertex shaders pick the viewport of each view, and the compacted
+  // commands draw every instance once per view
+  Assert(GetViewCount() == 1 || (GLEW_ARB_shader_viewport_layer_array &&
+                                 GLEW_ARB_indirect_parameters),
+         "--stereo and --camera-wall require "
+         "ARB_shader_viewport_layer_array and ARB_indirect_parameters");
+  if (pipeline_stats_report && !PipelineStats::IsSupported()) {
+    fprintf(stderr, "pipeline statistics not supported, --pipeline-stats "
+                    "ignored\n");
+    pipeline_stats_report = false;
+  }
+  if (framebuffer_fetch && !GLEW_EXT_shader_framebuffer_fetch) {
+    fprintf(stderr, "framebuffer fetch not supported, --framebuffer-fetch "
+                    "ignored\n");
+    framebuffer_fetch = false;
+  }
+  if (bindless_maps && !GLEW_ARB_bindless_texture) {
+    fprintf(stderr, "bindless textures not supported, --bindless-textures "
+                    "ignored\n");
+    bindless_maps = false;
+  }
+  // NV_gpu_shader5 has the 16-bit types but no 16-bit overloads of the
+  // built-ins, whose 32-bit results don't narrow implicitly
+  if (half_lighting) {
+    if (GLEW_AMD_gpu_shader_half_float)
+      half_lighting_define = "HALF_PRECISION_AMD";
+    else
+      fprintf(stderr, "16-bit floats not supported, --half-lighting "
+                      "ignored\n");
+  }
+  if (shading_rate && !ShadingRateImage::IsSupported()) {
+    fprintf(stderr, "shading rate image not supported, --shading-rate "
+                    "ignored\n");
+    shading_rate = false;
+  }
+#if GL_CHECKS > 0
+  GLDebug::InstallCallback(GL_CHECKS >= 2);
+#endif
+}
+
+// Creates the outputs of the secondary windows in the first context and the
+// frame buffers that read them in their own contexts; their swaps don't wait,
+// the first window paces the frames
+void InitSecondaryWindows() {
+  auto window = glfwGetCurrentContext();
+  for (size_t i = 0; i < secondary_windows.size(); ++i) {
+    auto &target = secondary_windows[i];
+    int width, height;
+    glfwGetFramebufferSize(target.handle, &width, &height);
+    device->CreateRenderTarget(&target.output,
+                               "window " + std::to_string(i + 2),
+                               std::max(width, 1), std::max(height, 1),
+                               FrameBuffer::DEPTH_STENCIL_TEXTURE);
+    target.output.AddColorTexture(GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE);
+    glfwMakeContextCurrent(target.handle);
+    glfwSwapInterval(0);
+    glCreateFramebuffers(1, &target.framebuffer);
+    glNamedFramebufferReadBuffer(target.framebuffer, GL_COLOR_ATTACHMENT0);
+    glfwMakeContextCurrent(window);
+  }
+}
+
+// Checks the support of the virtual diffuse maps, whose block the geometry
+// pass binds at link time
+void InitVirtualTextures() {
+  try {
+    virtual_maps.Init(DIFFUSE_MAP_SIZE, VIRTUAL_TEXTURE_PAGES);
+  } catch (std::exception &e) {
+    Assertf(false, "%s", e.what());
+  }
 }
 
-// Initializes the application
+// Adds the knobs of --quality-governor in the order they're given up: the
+// shadow maps per frame, the optional passes that are enabled and last the
+// floor of the resolution, which starts at the full one
+void CreateQualityKnobs() {
+  quality.Init(target_gpu_time);
+  if (shadow_budget > 1) {
+    int budget = shadow_budget;
+    quality.AddKnob("shadow budget", 3, [budget](int level) {
+      shadow_budget = std::max(budget >> (2 * level), 1);
+    });
+  }
+  for (const char *pass : {"ssao", "reflections", "bloom"}) {
+    if (render_graph.IsPassEnabled(pass))
+      quality.AddKnob(pass, 2, [pass](int level) {
+        render_graph.SetPassEnabled(pass, level == 0);
+      });
+  }
+  quality.AddKnob("resolution", 3, [](int level) {
+    dynamic_resolution.SetMinScale(GOVERNED_MIN_SCALES[level]);
+  });
+  dynamic_resolution.SetMinScale(GOVERNED_MIN_SCALES[0]);
+}
+
+// Plans the cpus of the threads, and prints them
+void PlanThreads() {
+  if (!thread_affinity.Init(pin_smt_threads)) {
+    printf("warning: the threads aren't pinned, the process may only run "
+           "on one core\n");
+    return;
+  }
+  printf("threads: render on cpu %d, %zu workers on node %d\n",
+         thread_affinity.GetRenderCpu(),
+         thread_affinity.GetWorkerCpus().size(), thread_affinity.GetNode());
+}
+
+// Pins the calling thread, which owns the context, to its planned cpu and
+// raises its priority if permitted
+void PinRenderThread() {
+  int cpu = thread_affinity.GetRenderCpu();
+  if (cpu < 0)
+    return;
+  if (!ThreadAffinity::Pin(pthread_self(), cpu))
+    printf("warning: the render thread can't be pinned to cpu %d\n", cpu);
+  if (!ThreadAffinity::SetPriority(RENDER_THREAD_NICE))
+    printf("warning: the priority of the render thread can't be raised\n");
+}
+
+// Initializes the application, with only what the first frame needs
 void InitApplication() {
   LoadGlobalConfiguration();
+  if (pin_threads)
+    PlanThreads();
+  jobs.Init(0, thread_affinity.GetWorkerCpus());
+  frame_pipeline.Init(frames_in_flight);
+  InitSecondaryWindows();
+  try {
+    int n_samples = std::max(benchmark_frames, FRAME_TIMES_KEPT);
+    std::vector<std::string> columns;
+    if (telemetry_period) {
+      telemetry.Start(telemetry_period);
+      columns = {"gpu_clock_mhz", "gpu_power_w", "gpu_temperature_c",
+                 "cpu_power_w"};
+    }
+    frame_times.Init(frame_times_path, n_samples, columns);
+    if (!stats_page_path.empty())
+      stats_page.Open(stats_page_path);
+  } catch (std::exception &e) {
+    Assertf(false, "%s", e.what());
+  }
+  if (target_gpu_time > 0)
+    dynamic_resolution.Init(target_gpu_time, MIN_RESOLUTION_SCALE);
+  if (!capture_directory.empty())
+    frame_capture.Init(capture_directory);
+  if (remote_port) {
+    try {
+      remote.Start(remote_port);
+    } catch (std::exception &e) {
+      Assertf(false, "%s", e.what());
+    }
+  }
+  if (!stream_output.empty()) {
+    float frame_rate = max_fps > 0 ? max_fps : DEFAULT_STREAM_FRAME_RATE;
+    if (frame_time > 0)
+      frame_rate = 1.0 / frame_time;
+    try {
+      frame_capture.InitStream(stream_output, window_w, window_h, frame_rate);
+    } catch (std::exception &e) {
+      Assertf(false, "%s", e.what());
+    }
+  }
+  if (virtual_textures)
+    InitVirtualTextures();
   LoadFramebuffer();
+  if (visibility_buffer)
+    LoadVisibilityBuffer();
+  if (UsesLightBuffer())
+    LoadLightBuffer();
+  if (weighted_transparency)
+    LoadOitBuffer();
+  if (fxaa_steps || taa || hdr || weighted_transparency)
+    CreateLinearSampler();
+  if (taa)
+    LoadTaaHistory();
+  EndStartupPhase("framebuffers");
   LoadShaders();
+  CheckGeometryPassBlocks();
+  EndStartupPhase("shaders");
   CreateMaterialsBuffer();
-  CreateRandomColors();
-  LoadScreenQuad();
-  LoadGround();
-  LoadBearMesh();
+  CreateLights();
+  CreateInstances();
+  CreateTransparentObjects();
+  EndStartupPhase("buffers");
+  LoadShapes();
+  try {
+    hud.Init(&screen_quad_shader, &screen_triangle);
+  } catch (std::exception &e) {
+    Assertf(false, "%s", e.what());
+  }
+  CreateDraws();
+  BuildRenderGraph();
+  if (quality_governor)
+    CreateQualityKnobs();
+  EndStartupPhase("draws");
+  // The startup uploads don't count in the per-frame stats
+  for (auto &buffer : GetUploadBuffers())
+    buffer.second->ResetStats();
+}
+
+// Initializes what the first frame doesn't need once it's presented: the
+// warm-up permutations and the debug view start building in the background,
+// and the shader files start being watched
+void InitDeferred() {
+  try {
+    if (!shader_warm_up.empty())
+      lightpass_shaders.LoadWarmUp(shader_warm_up);
+    for (int per_sample = 0; per_sample <= (msaa_samples ? 1 : 0);
+         ++per_sample) {
+      for (auto debug_define : {"DEBUG_NORMALS", "DEBUG_LIGHT_COUNT"}) {
+        auto defines = GetLightpassDefines(per_sample);
+        defines[debug_define] = "";
+        lightpass_shaders.Prepare(defines);
+      }
+    }
+    if (hot_reload)
+      shader_watcher.Init("shaders");
+  } catch (std::exception &e) {
+    Assertf(false, "%s", e.what());
+  }
+}
+
+// Sets how the swaps wait for the vertical blank; the adaptive vsync only
+// tears the frames that miss it, and falls back to vsync without the
+// swap_control_tear extension
+void InitPresentMode() {
+  bool tear = glfwExtensionSupported("GLX_EXT_swap_control_tear") ||
+              glfwExtensionSupported("WGL_EXT_swap_control_tear");
+  switch (present_mode) {
+    case PRESENT_VSYNC:
+      glfwSwapInterval(1);
+      break;
+    case PRESENT_IMMEDIATE:
+      glfwSwapInterval(0);
+      break;
+    case PRESENT_ADAPTIVE:
+      if (!tear)
+        fprintf(stderr, "adaptive vsync not supported, using vsync\n");
+      glfwSwapInterval(tear ? -1 : 1);
+      break;
+    default:
+      break;
+  }
+}
+
+// Waits until the next frame of --max-fps is due; sleeps until shortly before
+// the deadline and spins the rest, so the frames start on time
+void LimitFrameRate() {
+  PROFILE_ZONE("limit frame rate");
+  using namespace std::chrono;
+  static steady_clock::time_point deadline = steady_clock::now();
+  if (max_fps <= 0)
+    return;
+  auto interval = duration_cast<steady_clock::duration>(
+      duration<double>(1.0 / max_fps));
+  auto spin = duration_cast<steady_clock::duration>(
+      duration<double>(LIMITER_SPIN_SECONDS));
+  deadline += interval;
+  auto now = steady_clock::now();
+  // A frame that ran late starts the next interval instead of catching up
+  if (deadline < now) {
+    deadline = now;
+    return;
+  }
+  if (deadline - now > spin)
+    std::this_thread::sleep_for(deadline - now - spin);
+  while (steady_clock::now() < deadline)
+    std::this_thread::yield();
+}
+
+// Records the times of the frame just swapped: since the previous swap, of
+// the cpu work given and of the gpu for the frame whose index came back;
+// they are also added to the graph of the overlay
+void RecordFrameTimes(double cpu_time) {
+  using namespace std::chrono;
+  static steady_clock::time_point last_swap;
+  static bool swapped = false;
+  double frame_time = swapped ? MillisecondsSince(last_swap) : 0;
+  last_swap = steady_clock::now();
+  swapped = true;
+  double gpu_time = frame_pipeline.GetGpuTime();
+  if (telemetry_period) {
+    auto reading = telemetry.GetReading();
+    float values[] = {reading.gpu_clock_mhz, reading.gpu_power_w,
+                      reading.gpu_temperature_c, reading.cpu_power_w};
+    frame_times.Add(frame_time, cpu_time, gpu_time, values);
+  } else {
+    frame_times.Add(frame_time, cpu_time, gpu_time);
+  }
+  if (hud_visible)
+    hud.AddFrame(frame_time, gpu_time);
+}
+
+// Publishes the stats of the frame just recorded to the stats page
+void PublishStatsPage() {
+  page_stats.frame++;
+  float *times[] = {page_stats.frame_ms, page_stats.cpu_ms,
+                    page_stats.gpu_ms};
+  for (int i = 0; i < FrameTimes::N_SERIES; ++i) {
+    auto percentiles = frame_times.GetPercentiles(FrameTimes::Series(i));
+    times[i][0] = percentiles.p50;
+    times[i][1] = percentiles.p95;
+    times[i][2] = percentiles.p99;
+    times[i][3] = percentiles.max;
+  }
+  page_stats.lights = scene_description.GetLightCount();
+  page_stats.active_lights = light_transform.GetActiveCount();
+  for (int i = 0; i < GpuMemory::N_CATEGORIES; ++i)
+    page_stats.gpu_bytes[i] = GpuMemory::GetBytes(GpuMemory::Category(i));
+  page_stats.gpu_peak_total_bytes = GpuMemory::GetPeakTotalBytes();
+  page_stats.heap_allocations = FrameAllocator::GetHeapAllocations();
+  stats_page.Publish(page_stats);
+}
+
+// Writes a string as a JSON literal
+void WriteJsonString(FILE *file, const std::string &s) {
+  fputc('"', file);
+  for (char c : s) {
+    if (c == '"' || c == '\\')
+      fputc('\\', file);
+    fputc(c, file);
+  }
+  fputc('"', file);
+}
+
+// Writes a number as a JSON value, null if negative for unknown
+void WriteJsonNumber(FILE *file, double value) {
+  if (value < 0)
+    fputs("null", file);
+  else
+    fprintf(file, "%.3f", value);
+}
+
+// Writes the telemetry of the benchmark: the mean readings, the lowest gpu
+// clock and the highest temperature, and the energy per frame
+void WriteBenchmarkTelemetry(FILE *file) {
+  auto summary = telemetry.GetSummary();
+  auto per_frame = [](double joules) {
+    return joules < 0 ? -1 : joules / benchmark_frames;
+  };
+  fputs("  \"telemetry\": {\"gpu_clock_mhz\": {\"mean\": ", file);
+  WriteJsonNumber(file, summary.mean.gpu_clock_mhz);
+  fputs(", \"min\": ", file);
+  WriteJsonNumber(file, summary.min_gpu_clock_mhz);
+  fputs("},\n    \"gpu_temperature_c\": {\"mean\": ", file);
+  WriteJsonNumber(file, summary.mean.gpu_temperature_c);
+  fputs(", \"max\": ", file);
+  WriteJsonNumber(file, summary.max_gpu_temperature_c);
+  fputs("},\n    \"gpu_power_w\": ", file);
+  WriteJsonNumber(file, summary.mean.gpu_power_w);
+  fputs(", \"cpu_power_w\": ", file);
+  WriteJsonNumber(file, summary.mean.cpu_power_w);
+  fputs(",\n    \"gpu_joules_per_frame\": ", file);
+  WriteJsonNumber(file, per_frame(summary.gpu_joules));
+  fputs(", \"cpu_joules_per_frame\": ", file);
+  WriteJsonNumber(file, per_frame(summary.cpu_joules));
+  fprintf(file, ",\n    \"samples\": %d},\n", summary.samples);
+}
+
+// Writes the results of the benchmark: the command line, the frame rate,
+// the error of the fast lighting, the telemetry, the percentiles of the frame
+// times and the average gpu time of the passes
+void WriteBenchmarkResults(double milliseconds) {
+  FILE *file = fopen(benchmark_path.c_str(), "w");
+  Assertf(file, "unable to write file: %s", benchmark_path.c_str());
+  fprintf(file, "{\n  \"arguments\": [");
+  for (size_t i = 0; i < command_line.size(); ++i) {
+    if (i)
+      fputs(", ", file);
+    WriteJsonString(file, command_line[i]);
+  }
+  fprintf(file, "],\n  \"frames\": %d,\n  \"seconds\": %.3f,\n",
+          benchmark_frames, milliseconds / 1000);
+  fprintf(file, "  \"fps\": %.2f,\n", benchmark_frames * 1000 / milliseconds);
+  // The accuracy the speed of the fast lighting is traded for, zero without
+  auto error = fast_lighting ? ComputeFastLightingError()
+                             : FastLightingReport{0, 0, 0};
+  fprintf(file, "  \"lighting_error\": {\"mean\": %.5f, \"max\": %.5f},\n",
+          error.mean_error, error.max_error);
+  if (telemetry_period)
+    WriteBenchmarkTelemetry(file);
+  for (int i = 0; i < FrameTimes::N_SERIES; ++i) {
+    auto series = (FrameTimes::Series)i;
+    auto percentiles = frame_times.GetPercentiles(series);
+    fprintf(file,
+            "  \"%s_ms\": {\"p50\": %.3f, \"p95\": %.3f, \"p99\": %.3f, "
+            "\"max\": %.3f},\n",
+            FrameTimes::GetName(series), percentiles.p50, percentiles.p95,
+            percentiles.p99, percentiles.max);
+  }
+  fprintf(file, "  \"passes_ms\": {");
+  auto &sections = gpu_timer.GetSections();
+  for (size_t i = 0; i < sections.size(); ++i) {
+    fprintf(file, "%s\n    ", i ? "," : "");
+    WriteJsonString(file, sections[i].name);
+    fprintf(file, ": %.3f",
+            sections[i].milliseconds / std::max(sections[i].frames, 1));
+  }
+  fprintf(file, "\n  }\n}\n");
+  fclose(file);
+  printf("\nbenchmark results written to %s\n", benchmark_path.c_str());
+}
+
+// Starts measuring once the scene is complete and warm, from a reset
+// simulation, moves the camera and ends the benchmark after its frames
+void UpdateBenchmark(GLFWwindow *window) {
+  static int warmup_frames = 0;
+  if (benchmark_frame < 0) {
+    if (!IsSceneComplete() || ++warmup_frames < BENCHMARK_WARMUP_FRAMES)
+      return;
+    // The simulation of the frame already ran, so the state may be reset
+    previous_state = current_state = SimulationState();
+    simulation_lag = 0;
+    frame_times.Reset();
+    gpu_timer.ResetSections();
+    telemetry.Reset();
+    benchmark_begin = std::chrono::steady_clock::now();
+    benchmark_frame = 0;
+  } else if (++benchmark_frame == benchmark_frames) {
+    WriteBenchmarkResults(MillisecondsSince(benchmark_begin));
+    glfwSetWindowShouldClose(window, GLFW_TRUE);
+  }
+  camera_dirty = true;
 }
 
 // Application main loop
 void MainLoop(GLFWwindow *window) {
+  if (pin_threads)
+    PinRenderThread();
+  bool first_frame = true;
   while (!glfwWindowShouldClose(window)) {
+    // Nothing is drawn or swapped while the presented image is up to date;
+    // the shader files are still watched
+    if (on_demand && !first_frame && !NeedsFrame()) {
+      if (!hot_reload) {
+        glfwWaitEvents();
+        continue;
+      }
+      glfwWaitEventsTimeout(HOT_RELOAD_POLL_SECONDS);
+      if (ReloadShaders()) {
+        InvalidateFrame();
+        gbuffer_version++;
+      }
+      continue;
+    }
+    if (settle_frames > 0)
+      settle_frames--;
+
+    // Nothing of the frame is written before the gpu is done with the one
+    // that frames_in_flight frames ago had its index
+    frame_pipeline.BeginFrame();
+    FrameAllocator::Reset();
+    LimitFrameRate();
+    auto cpu_begin = std::chrono::steady_clock::now();
+    if (remote_port)
+      ApplyRemoteCommands();
     Idle();
-    Resize(window);
-    UpdateMatrices();
-    Render();
+    if (render_thread)
+      ReplayWindowEvents(window);
+    UpdateFlyCamera(window);
+    if (hot_reload && !first_frame && ReloadShaders()) {
+      InvalidateFrame();
+      gbuffer_version++;
+    }
+    Render(window);
+    for (auto &target : secondary_windows)
+      RenderSecondaryWindow(&target);
     ComputeFPS();
-    glfwSwapBuffers(window);
-    glfwPollEvents();
+    double cpu_time = MillisecondsSince(cpu_begin);
+    {
+      PROFILE_ZONE("swap");
+      glfwSwapBuffers(window);
+    }
+    PresentSecondaryWindows(window);
+    CloseSecondaryWindows(window);
+    frame_pipeline.EndFrame();
+    if (frame_times_report || hud_visible || benchmark_frames > 0 ||
+        !stats_page_path.empty())
+      RecordFrameTimes(cpu_time);
+    if (!stats_page_path.empty())
+      PublishStatsPage();
+    if (benchmark_frames > 0)
+      UpdateBenchmark(window);
+    if (gbuffer_dumped)
+      glfwSetWindowShouldClose(window, GLFW_TRUE);
+    if (first_frame) {
+      EndStartupPhase("first frame");
+      PrintStartupPhases();
+      if (memory_report)
+        PrintMemoryReport();
+      InitDeferred();
+      first_frame = false;
+    }
   };
 }
 
+// Polls the window events on the main thread while the render thread runs
+// the frames, and queues them in packets; a packet the full queue refused
+// grows until it fits, so no event is lost
+void QueueWindowEvents(GLFWwindow *window) {
+  while (!glfwWindowShouldClose(window)) {
+    if (pending_events.empty())
+      glfwWaitEvents();
+    else
+      glfwWaitEventsTimeout(WINDOW_EVENT_RETRY_SECONDS);
+    if (!pending_events.empty() && window_events.Push(pending_events))
+      pending_events.clear();
+  }
+}
+
+// Runs the main loop on a render thread that owns the context until the
+// window closes, then gives the context back to the calling thread
+void RunRenderThread(GLFWwindow *window) {
+  glfwGetFramebufferSize(window, &replayed_framebuffer_w,
+                         &replayed_framebuffer_h);
+  glfwMakeContextCurrent(nullptr);
+  std::thread thread([window]() {
+    CpuProfiler::SetThreadName("render");
+    glfwMakeContextCurrent(window);
+    MainLoop(window);
+    glfwMakeContextCurrent(nullptr);
+    // Wakes the main thread if the benchmark closed the window
+    glfwPostEmptyEvent();
+  });
+  QueueWindowEvents(window);
+  thread.join();
+  glfwMakeContextCurrent(window);
+}
+
 // Initialization
 int main(int argc, char *argv[]) {
+  ExpandArguments(&argc, &argv);
+  ParseArguments(argc, argv);
+  if (!trace_path.empty()) {
+    CpuProfiler::Enable();
+    CpuProfiler::SetThreadName("main");
+  }
+  LoadScene();
+  EndStartupPhase("scene");
   auto window = InitGLFW(argc, argv);
+  EndStartupPhase("glfw");
   InitGLEW();
+  InitPresentMode();
+  EndStartupPhase("glew");
   InitApplication();
-  MainLoop(window);
+  if (render_thread)
+    RunRenderThread(window);
+  else
+    MainLoop(window);
+  remote.Stop();
+  telemetry.Stop();
+  SaveCameraPath();
+  FinishCapture();
+  SaveShaderWarmUp();
+  WriteTrace();
+  if (memory_report)
+    PrintMemoryReport();
+  uploads.StopThread();
+  if (loader_window)
+    glfwDestroyWindow(loader_window);
   glfwTerminate();
   return 0;
 }
@@ -0,0 +1,59 @@
+/*
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Ambient occlusion of the lighting passes, at half the resolution of the
+// G-buffer with the distance to the eye of each texel (see AmbientOcclusion).
+// It has no #version line: the lighting shaders #include it after the
+// G-buffer code, and it uses the first free unit after the G-buffer
+// (GBUFFER_TEXTURES).
+
+layout(binding = GBUFFER_TEXTURES) uniform sampler2D occlusion_texture;
+
+// Weight of the occlusion, zero when its pass is disabled
+uniform float occlusion_weight;
+
+// Difference of distance, relative to the one of the pixel, at which a texel
+// stops weighting
+const float OCCLUSION_DEPTH_TOLERANCE = 0.05;
+
+// Obtains the visibility of the ambient light at a G-buffer pixel at a
+// distance from the eye: the four nearest texels weighted by how close their
+// distance is, so the occlusion of a surface doesn't bleed on the one behind
+float read_occlusion(ivec2 coord, float distance) {
+    ivec2 last = max(ivec2(gbuffer_size) / 2, ivec2(1)) - 1;
+    ivec2 base = max(coord - 1, ivec2(0)) / 2;
+    float sum = 0;
+    float weight_sum = 0;
+    for (int i = 0; i < 4; ++i) {
+        ivec2 texel = min(base + ivec2(i & 1, i >> 1), last);
+        vec2 value = texelFetch(occlusion_texture, texel, 0).rg;
+        // The small floor keeps pixels whose texels all differ
+        float weight = max(1 - abs(value.g - distance) /
+                                   (OCCLUSION_DEPTH_TOLERANCE * distance),
+                           0) + 1e-3;
+        sum += value.r * weight;
+        weight_sum += weight;
+    }
+    return mix(1.0, sum / weight_sum, occlusion_weight);
+}
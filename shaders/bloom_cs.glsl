@@ -0,0 +1,108 @@
+/*
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#version 450
+
+// Writes a level of the bloom chain, one texel per thread (see Bloom). With
+// DOWNSAMPLE the texel takes 13 bilinear taps of the larger previous level:
+// four 2x2 boxes around the center and four further boxes at the corners,
+// blended so each weights the same as the center one. KARIS does the same
+// from the lit image, with every box weighted by the inverse of its luma.
+// With UPSAMPLE the texel adds a 3x3 tent filter of the smaller next level
+// to its own value. GROUP_SIZE is defined by the application.
+
+layout (local_size_x = GROUP_SIZE, local_size_y = GROUP_SIZE) in;
+
+// Level read, with a linear sampler, and its size inside its texture
+uniform sampler2D source_texture;
+uniform vec2 source_size;
+
+// Level written
+#ifdef UPSAMPLE
+layout (r11f_g11f_b10f) uniform image2D target_image;
+#else
+layout (r11f_g11f_b10f) uniform writeonly image2D target_image;
+#endif
+uniform vec2 target_size;
+
+// Texel size and last texel center of the source
+vec2 texel;
+vec2 max_uv;
+
+vec3 tap(vec2 uv, vec2 offset) {
+    return textureLod(source_texture, min(uv + offset * texel, max_uv), 0).rgb;
+}
+
+// Weight of a box of four taps
+float box_weight(vec3 sum) {
+#ifdef KARIS
+    return 1.0 / (1.0 + dot(sum * 0.25, vec3(0.299, 0.587, 0.114)));
+#else
+    return 1.0;
+#endif
+}
+
+void main() {
+    ivec2 coord = ivec2(gl_GlobalInvocationID.xy);
+    if (any(greaterThanEqual(coord, ivec2(target_size))))
+        return;
+    texel = 1.0 / vec2(textureSize(source_texture, 0));
+    max_uv = (source_size - 0.5) * texel;
+    vec2 uv = (vec2(coord) + 0.5) / target_size * source_size * texel;
+
+#ifdef UPSAMPLE
+    vec3 sum = 4.0 * tap(uv, vec2(0, 0));
+    sum += 2.0 * (tap(uv, vec2(-1, 0)) + tap(uv, vec2(1, 0)) +
+                  tap(uv, vec2(0, -1)) + tap(uv, vec2(0, 1)));
+    sum += tap(uv, vec2(-1, -1)) + tap(uv, vec2(1, -1)) +
+           tap(uv, vec2(-1, 1)) + tap(uv, vec2(1, 1));
+    vec3 color = imageLoad(target_image, coord).rgb + sum / 16.0;
+#else
+    vec3 a = tap(uv, vec2(-2, 2));
+    vec3 b = tap(uv, vec2(0, 2));
+    vec3 c = tap(uv, vec2(2, 2));
+    vec3 d = tap(uv, vec2(-1, 1));
+    vec3 e = tap(uv, vec2(1, 1));
+    vec3 f = tap(uv, vec2(-2, 0));
+    vec3 g = tap(uv, vec2(0, 0));
+    vec3 h = tap(uv, vec2(2, 0));
+    vec3 i = tap(uv, vec2(-1, -1));
+    vec3 j = tap(uv, vec2(1, -1));
+    vec3 k = tap(uv, vec2(-2, -2));
+    vec3 l = tap(uv, vec2(0, -2));
+    vec3 m = tap(uv, vec2(2, -2));
+    vec3 boxes[5] = vec3[](d + e + i + j, a + b + f + g, b + c + g + h,
+                           f + g + k + l, g + h + l + m);
+    const float weights[5] = float[](0.5, 0.125, 0.125, 0.125, 0.125);
+    vec3 color = vec3(0);
+    float total = 0.0;
+    for (int n = 0; n < 5; ++n) {
+        float weight = weights[n] * box_weight(boxes[n]);
+        color += weight * boxes[n] * 0.25;
+        total += weight;
+    }
+    color /= total;
+#endif
+    imageStore(target_image, coord, vec4(color, 1));
+}
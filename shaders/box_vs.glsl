@@ -0,0 +1,45 @@
+/*
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#version 450
+
+// Bounding box of an occlusion query (see OcclusionQueries), a triangle
+// strip of 14 vertices made from gl_VertexID with no attributes, linked
+// without a fragment stage
+
+uniform mat4 view_projection;
+
+// Corners of the box in world space
+uniform vec3 box_min;
+uniform vec3 box_max;
+
+// Corner of each vertex, x in bit 0, y in bit 1 and z in bit 2; every face is
+// two triangles split along a diagonal
+const int CORNERS[14] = int[](0, 1, 2, 3, 7, 1, 5, 0, 4, 2, 6, 7, 4, 5);
+
+void main() {
+    int corner = CORNERS[gl_VertexID];
+    vec3 weights = vec3(corner & 1, (corner >> 1) & 1, (corner >> 2) & 1);
+    gl_Position = view_projection * vec4(mix(box_min, box_max, weights), 1);
+}
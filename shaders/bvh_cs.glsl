@@ -0,0 +1,260 @@
+/*
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#version 450
+
+// Builds the light BVH of light_bvh.glsl from the point lights of
+// lighting.glsl, as a linear BVH, one light per thread in each of these
+// stages, defined by LightBvh with the most lights, MAX_LIGHTS:
+// - BOUNDS reduces the positions of the lights to their bounds
+// - MORTON gives each light the Morton code of its position in the bounds
+// - HISTOGRAM, SCAN and SCATTER are one pass of a radix sort of the codes,
+//   RADIX_BITS at a time from the low ones: each group counts the digits of
+//   its lights, the prefix sums of the counts (see scan.glsl), digit-major,
+//   give each group where its lights of a digit go, and each light goes
+//   there after the ones of its group with the same digit, so the sort is
+//   stable
+// - NODES makes the internal node of each sorted light but the last, which
+//   covers the range of codes that share the longest prefix with it, split
+//   where that prefix grows, and the leaf of each light
+// - REFIT walks up from each leaf; the second thread to reach a node has
+//   both children and bounds it, the first one stops
+
+#define BVH_BUILD
+
+#include "lighting.glsl"
+#include "light_bvh.glsl"
+
+layout (local_size_x = GROUP_SIZE) in;
+
+#ifdef SCAN
+#include "scan.glsl"
+#endif
+
+// Bounds of the positions of the lights, as in bvh_order()
+layout (std430) buffer BvhBoundsBlock {
+    uint bvh_bounds_min[3];
+    uint bvh_bounds_max[3];
+};
+
+// Parent of every node, and how many threads reached it during the refit
+layout (std430) buffer BvhParentsBlock {
+    uvec2 bvh_parents[];
+};
+
+// Morton codes and lights, read and written by each pass of the sort
+layout (std430) readonly buffer SortInputBlock {
+    uvec2 sort_input[];
+};
+
+layout (std430) writeonly buffer SortOutputBlock {
+    uvec2 sort_output[];
+};
+
+// Lights of each digit in each group, then where they go
+layout (std430) buffer SortHistogramBlock {
+    uint sort_histogram[];
+};
+
+// Position of the digit in the codes
+uniform int radix_shift;
+
+// Groups of the histogram and scatter dispatches
+uniform int n_sort_groups;
+
+const uint RADIX = 1u << RADIX_BITS;
+
+// Maps a float to a uint of the same order, so atomics can compare them
+uint bvh_order(float f) {
+    uint u = floatBitsToUint(f);
+    return (u & 0x80000000u) != 0u ? ~u : u | 0x80000000u;
+}
+
+float bvh_unorder(uint u) {
+    return uintBitsToFloat((u & 0x80000000u) != 0u ? u & 0x7FFFFFFFu : ~u);
+}
+
+// Spreads the 10 low bits of a value to every third bit
+uint expand_bits(uint v) {
+    v = (v * 0x00010001u) & 0xFF0000FFu;
+    v = (v * 0x00000101u) & 0x0F00F00Fu;
+    v = (v * 0x00000011u) & 0xC30C30C3u;
+    v = (v * 0x00000005u) & 0x49249249u;
+    return v;
+}
+
+// Length of the common prefix of the codes of two sorted lights, and of
+// their indices for equal codes; -1 if j isn't a light
+int common_prefix(int i, int j, int n) {
+    if (j < 0 || j >= n)
+        return -1;
+    uint a = sort_input[i].x;
+    uint b = sort_input[j].x;
+    if (a == b)
+        return 32 + 31 - findMSB(uint(i ^ j));
+    return 31 - findMSB(a ^ b);
+}
+
+#ifdef HISTOGRAM
+shared uint digit_counts[RADIX];
+#endif
+#ifdef SCATTER
+shared uint group_digits[GROUP_SIZE];
+#endif
+
+void main() {
+    int n = min(n_point_lights, MAX_LIGHTS);
+#ifdef SCAN
+    int i = scan_element();
+    bool counted = i < int(RADIX) * n_sort_groups;
+    uint offset = scan_exclusive(counted ? sort_histogram[i] : 0u);
+    if (counted)
+        sort_histogram[i] = offset;
+#else
+    int i = int(gl_GlobalInvocationID.x);
+#endif
+
+#ifdef BOUNDS
+    if (i >= n)
+        return;
+    vec3 position = point_lights[i].position;
+    for (int c = 0; c < 3; ++c) {
+        atomicMin(bvh_bounds_min[c], bvh_order(position[c]));
+        atomicMax(bvh_bounds_max[c], bvh_order(position[c]));
+    }
+#endif
+
+#ifdef MORTON
+    if (i >= n)
+        return;
+    vec3 bounds_min = vec3(bvh_unorder(bvh_bounds_min[0]),
+                           bvh_unorder(bvh_bounds_min[1]),
+                           bvh_unorder(bvh_bounds_min[2]));
+    vec3 bounds_max = vec3(bvh_unorder(bvh_bounds_max[0]),
+                           bvh_unorder(bvh_bounds_max[1]),
+                           bvh_unorder(bvh_bounds_max[2]));
+    vec3 extent = max(bounds_max - bounds_min, vec3(1e-6));
+    vec3 p = clamp((point_lights[i].position - bounds_min) / extent, 0, 1);
+    uvec3 cell = uvec3(min(p * 1024, vec3(1023)));
+    uint code = expand_bits(cell.x) << 2 | expand_bits(cell.y) << 1 |
+                expand_bits(cell.z);
+    sort_output[i] = uvec2(code, uint(i));
+#endif
+
+#ifdef HISTOGRAM
+    uint group = gl_WorkGroupID.x;
+    uint n_groups = gl_NumWorkGroups.x;
+    for (uint d = gl_LocalInvocationIndex; d < RADIX; d += GROUP_SIZE)
+        digit_counts[d] = 0u;
+    barrier();
+    if (i < n) {
+        uint digit = (sort_input[i].x >> radix_shift) & (RADIX - 1u);
+        atomicAdd(digit_counts[digit], 1u);
+    }
+    barrier();
+    for (uint d = gl_LocalInvocationIndex; d < RADIX; d += GROUP_SIZE)
+        sort_histogram[d * n_groups + group] = digit_counts[d];
+#endif
+
+#ifdef SCATTER
+    uint group = gl_WorkGroupID.x;
+    uint n_groups = gl_NumWorkGroups.x;
+    uvec2 element = i < n ? sort_input[i] : uvec2(0u);
+    uint digit = (element.x >> radix_shift) & (RADIX - 1u);
+    // Past the lights, out of the digits, so no light counts them
+    group_digits[gl_LocalInvocationIndex] = i < n ? digit : RADIX;
+    barrier();
+    if (i >= n)
+        return;
+    uint rank = 0u;
+    for (uint t = 0u; t < gl_LocalInvocationIndex; ++t)
+        rank += uint(group_digits[t] == digit);
+    sort_output[sort_histogram[digit * n_groups + group] + rank] = element;
+#endif
+
+#ifdef NODES
+    if (i >= n)
+        return;
+    // The leaf of the light
+    PointLight L = point_lights[sort_input[i].y];
+    int leaf = n - 1 + i;
+    bvh_nodes[leaf] = BvhNode(L.position - L.range, int(sort_input[i].y),
+                              L.position + L.range, -1);
+    if (i == 0)
+        bvh_parents[0] = uvec2(0u);  // the root, no node's child
+    if (i == n - 1)
+        return;
+
+    // Direction of the range of the node, and its other end
+    int direction = common_prefix(i, i + 1, n) > common_prefix(i, i - 1, n)
+                  ? 1 : -1;
+    int min_prefix = common_prefix(i, i - direction, n);
+    int max_length = 2;
+    while (common_prefix(i, i + max_length * direction, n) > min_prefix)
+        max_length *= 2;
+    int range_length = 0;
+    for (int step = max_length / 2; step >= 1; step /= 2) {
+        int end = i + (range_length + step) * direction;
+        if (common_prefix(i, end, n) > min_prefix)
+            range_length += step;
+    }
+    int j = i + range_length * direction;
+
+    // Last light of the range that shares more than the prefix of the node
+    // with its first one, on the side of i
+    int node_prefix = common_prefix(i, j, n);
+    int split = 0;
+    for (int step = (range_length + 1) / 2;; step = (step + 1) / 2) {
+        if (split + step <= range_length &&
+            common_prefix(i, i + (split + step) * direction, n) > node_prefix)
+            split += step;
+        if (step == 1)
+            break;
+    }
+    int gamma = i + split * direction + min(direction, 0);
+    int left = min(i, j) == gamma ? n - 1 + gamma : gamma;
+    int right = max(i, j) == gamma + 1 ? n - 1 + gamma + 1 : gamma + 1;
+    bvh_nodes[i].left = left;
+    bvh_nodes[i].right = right;
+    bvh_parents[left] = uvec2(i, 0u);
+    bvh_parents[right] = uvec2(i, 0u);
+#endif
+
+#ifdef REFIT
+    if (i >= n)
+        return;
+    int node = n - 1 + i;
+    while (node > 0) {
+        int parent = int(bvh_parents[node].x);
+        memoryBarrierBuffer();
+        if (atomicAdd(bvh_parents[parent].y, 1u) == 0u)
+            return;
+        BvhNode left = bvh_nodes[bvh_nodes[parent].left];
+        BvhNode right = bvh_nodes[bvh_nodes[parent].right];
+        bvh_nodes[parent].bounds_min = min(left.bounds_min, right.bounds_min);
+        bvh_nodes[parent].bounds_max = max(left.bounds_max, right.bounds_max);
+        node = parent;
+    }
+#endif
+}
@@ -0,0 +1,89 @@
+/*
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Light clusters (see LightClusters). It has no #version line: the shaders
+// that read the clusters #include it after lighting.glsl.
+
+// Offset in cluster_lights, number of point lights and number of spot lights
+// of each cluster; the spot light indices follow the point light indices
+layout (std430) buffer ClusterRangesBlock {
+    uvec4 cluster_ranges[];
+};
+
+// Light indices of every cluster, after the number of used indices
+layout (std430) buffer ClusterLightsBlock {
+    uint cluster_n_indices;
+    uint cluster_lights[];
+};
+
+#ifdef CLUSTER_LIGHT_BUDGET
+// Light of the spot lights left out of each cluster by the budget that
+// reaches its center, after the number of lights left out in the frame
+layout (std430) buffer ClusterAmbientBlock {
+    uint cluster_n_folded;
+    vec4 cluster_ambient[];
+};
+#endif
+
+// Number of clusters in x, y and depth
+uniform ivec3 cluster_grid;
+
+// Size in pixels covered by the grid
+uniform vec2 cluster_screen_size;
+
+// Distances of the first and the last depth slices
+uniform vec2 cluster_depth_range;
+
+// Obtains the distance from the eye where a depth slice starts
+float cluster_slice_distance(int slice) {
+    float near = cluster_depth_range.x;
+    float far = cluster_depth_range.y;
+    return near * pow(far / near, float(slice) / cluster_grid.z);
+}
+
+// Obtains the cluster of a pixel at a distance from the eye
+int find_cluster(vec2 pixel, float eye_distance) {
+    float near = cluster_depth_range.x;
+    float far = cluster_depth_range.y;
+    ivec2 cell = ivec2(pixel / cluster_screen_size * vec2(cluster_grid.xy));
+    cell = clamp(cell, ivec2(0), cluster_grid.xy - 1);
+    float slice = log(eye_distance / near) / log(far / near) * cluster_grid.z;
+    int z = clamp(int(slice), 0, cluster_grid.z - 1);
+    return cell.x + cluster_grid.x * (cell.y + cluster_grid.y * z);
+}
+
+#ifdef CLUSTER_LIGHT_BUDGET
+// Average over every normal of the cosine term of a light
+const float AVERAGE_COSINE = 0.25;
+
+// Reflects the light of the spot lights left out of a cluster, as ambient
+Shading shade_cluster_ambient(int cluster, Material M) {
+    vec3 light = cluster_ambient[cluster].rgb * AVERAGE_COSINE;
+#ifdef LIGHT_PREPASS
+    return vec4(light, 0);
+#else
+    return M.diffuse * light;
+#endif
+}
+#endif
@@ -0,0 +1,211 @@
+/*
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#version 450
+
+// Assigns the lights to the clusters, one cluster per thread. The light
+// structures come from lighting.glsl and the cluster buffers from
+// clusters.glsl. With LIGHT_BVH the point lights are found by walking their
+// tree (see light_bvh.glsl) instead of testing every one of them. With
+// CLUSTER_LIGHT_BUDGET a cluster keeps that many spot lights at most, the
+// most significant ones, and the light of the others at its center becomes
+// its ambient term.
+
+#include "lighting.glsl"
+#include "clusters.glsl"
+#ifdef LIGHT_BVH
+#include "light_bvh.glsl"
+#endif
+
+layout (local_size_x = GROUP_SIZE) in;
+
+uniform mat4 inv_projection;
+
+// Number of indices that fit in cluster_lights
+uniform int cluster_capacity;
+
+// Obtains the view-space point of a screen position at a distance from the eye
+vec3 cluster_corner(vec2 ndc, float eye_distance) {
+    vec4 ray = inv_projection * vec4(ndc, 1, 1);
+    vec3 point = ray.xyz / ray.w;
+    return point * (eye_distance / -point.z);
+}
+
+#ifdef LIGHT_BVH
+// Walks the tree for the point lights that touch a sphere, writes the first
+// limit of their indices from an offset of cluster_lights and returns how
+// many there are
+uint find_point_lights(vec3 center, float radius, uint offset, uint limit) {
+    int n = n_point_lights;
+    if (n == 0)
+        return 0u;
+    uint count = 0u;
+    int stack[BVH_STACK_SIZE];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        int node = stack[--top];
+        if (bvh_is_leaf(node, n)) {
+            int light = bvh_nodes[node].left;
+            if (sphere_touches_point_light(point_lights[light], center,
+                                           radius)) {
+                if (count < limit)
+                    cluster_lights[offset + count] = uint(light);
+                ++count;
+            }
+            continue;
+        }
+        BvhNode N = bvh_nodes[node];
+        if (!bvh_node_touches(N, center, radius) || top + 2 > BVH_STACK_SIZE)
+            continue;
+        stack[top++] = N.left;
+        stack[top++] = N.right;
+    }
+    return count;
+}
+#endif
+
+#ifdef CLUSTER_LIGHT_BUDGET
+// Estimates how much a spot light can add to a sphere: its intensity, as in
+// LightTree, attenuated at the nearest point
+float spot_light_significance(SpotLight L, vec3 center, float radius) {
+    float intensity = dot(L.diffuse, vec3(0.2126, 0.7152, 0.0722)) + L.specular;
+    float d = max(distance(center, L.position) - radius, 0);
+    return intensity * compute_attenuation(L.range, d);
+}
+
+// Obtains the diffuse light of a spot light that reaches a point, before
+// the cosine term
+vec3 fold_spot_light(SpotLight L, vec3 position) {
+    vec3 light_dir;
+    float attenuation = compute_light_dir(L.position, L.range, position,
+                                          light_dir);
+    return L.diffuse * attenuation * compute_spot(L, light_dir);
+}
+#endif
+
+void main() {
+    int cluster = int(gl_GlobalInvocationID.x);
+    int n_clusters = cluster_grid.x * cluster_grid.y * cluster_grid.z;
+    if (cluster >= n_clusters)
+        return;
+    ivec3 id = ivec3(cluster % cluster_grid.x,
+                     (cluster / cluster_grid.x) % cluster_grid.y,
+                     cluster / (cluster_grid.x * cluster_grid.y));
+
+    // Bounding sphere of the cluster
+    float near = cluster_slice_distance(id.z);
+    float far = cluster_slice_distance(id.z + 1);
+    vec3 corners[8];
+    for (int i = 0; i < 4; ++i) {
+        vec2 cell = vec2(id.xy + ivec2(i & 1, i >> 1));
+        vec2 ndc = cell / vec2(cluster_grid.xy) * 2 - 1;
+        corners[i] = cluster_corner(ndc, near);
+        corners[i + 4] = cluster_corner(ndc, far);
+    }
+    vec3 center = vec3(0, 0, 0);
+    for (int i = 0; i < 8; ++i)
+        center += corners[i] / 8;
+    float radius = 0;
+    for (int i = 0; i < 8; ++i)
+        radius = max(radius, distance(center, corners[i]));
+
+    // Counts the lights to reserve their indices, then writes them
+#ifdef LIGHT_BVH
+    uint n_points = find_point_lights(center, radius, 0u, 0u);
+#else
+    uint n_points = 0u;
+    for (int i = 0; i < n_point_lights; ++i) {
+        PointLight L = point_lights[i];
+        n_points += uint(sphere_touches_point_light(L, center, radius));
+    }
+#endif
+#ifdef CLUSTER_LIGHT_BUDGET
+    // Keeps the spot lights sorted by significance; each one pushed out of
+    // the budget is folded into the ambient term
+    uint kept[CLUSTER_LIGHT_BUDGET];
+    float weights[CLUSTER_LIGHT_BUDGET];
+    uint n_spots = 0u;
+    uint n_folded = 0u;
+    vec3 folded = vec3(0);
+    for (int i = 0; i < n_spot_lights; ++i) {
+        SpotLight L = spot_lights[i];
+        if (!sphere_touches_spot_light(L, center, radius))
+            continue;
+        float weight = spot_light_significance(L, center, radius);
+        uint slot = n_spots;
+        if (n_spots == CLUSTER_LIGHT_BUDGET) {
+            ++n_folded;
+            if (weight <= weights[n_spots - 1]) {
+                folded += fold_spot_light(L, center);
+                continue;
+            }
+            folded += fold_spot_light(spot_lights[kept[--slot]], center);
+        } else {
+            ++n_spots;
+        }
+        for (; slot > 0u && weights[slot - 1] < weight; --slot) {
+            kept[slot] = kept[slot - 1];
+            weights[slot] = weights[slot - 1];
+        }
+        kept[slot] = uint(i);
+        weights[slot] = weight;
+    }
+    cluster_ambient[cluster] = vec4(folded, 0);
+    if (n_folded > 0u)
+        atomicAdd(cluster_n_folded, n_folded);
+#else
+    uint n_spots = 0u;
+    for (int i = 0; i < n_spot_lights; ++i) {
+        SpotLight L = spot_lights[i];
+        n_spots += uint(sphere_touches_spot_light(L, center, radius));
+    }
+#endif
+    uint offset = atomicAdd(cluster_n_indices, n_points + n_spots);
+    uint capacity = uint(cluster_capacity);
+    uint count = offset < capacity ? min(n_points + n_spots, capacity - offset)
+                                   : 0u;
+    n_points = min(n_points, count);
+    n_spots = count - n_points;
+#ifdef LIGHT_BVH
+    uint written = min(find_point_lights(center, radius, offset, n_points),
+                       n_points);
+#else
+    uint written = 0u;
+    for (int i = 0; i < n_point_lights && written < n_points; ++i) {
+        if (sphere_touches_point_light(point_lights[i], center, radius))
+            cluster_lights[offset + written++] = uint(i);
+    }
+#endif
+#ifdef CLUSTER_LIGHT_BUDGET
+    for (uint i = 0u; i < n_spots; ++i)
+        cluster_lights[offset + written++] = kept[i];
+#else
+    for (int i = 0; i < n_spot_lights && written < count; ++i) {
+        if (sphere_touches_spot_light(spot_lights[i], center, radius))
+            cluster_lights[offset + written++] = uint(i);
+    }
+#endif
+    cluster_ranges[cluster] = uvec4(offset, n_points, n_spots, 0u);
+}
@@ -0,0 +1,76 @@
+/*
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+#version 450
+
+// Compacts the indirect commands that the culling gave instances into the
+// commands of its pass, one command per thread, and counts them for
+// glMultiDrawElementsIndirectCount (see MeshBatch). The slots come from the
+// prefix sums of scan.glsl, so the commands keep their order from frame to
+// frame; the base instance of each command still finds its draw.
+
+layout (local_size_x = GROUP_SIZE) in;
+
+#include "scan.glsl"
+
+// Indirect commands of the draws, as in cull_cs.glsl
+struct Command {
+    uint count;
+    uint instance_count;
+    uint first_index;
+    int base_vertex;
+    uint base_instance;
+};
+
+layout (std430) readonly buffer CommandsBlock {
+    Command commands[];
+};
+
+layout (std430) writeonly buffer CompactCommandsBlock {
+    Command compact_commands[];
+};
+
+// Commands kept by each pass, written by the last tile
+layout (std430) buffer DrawCountsBlock {
+    uint draw_counts[];
+};
+
+uniform int n_commands;
+uniform int pass;
+
+// Times each instance is drawn, once per eye in stereo (see
+// MeshBatch::SetViews)
+uniform int views;
+
+void main() {
+    int i = scan_element();
+    bool keep = i < n_commands && commands[i].instance_count != 0;
+    uint slot = scan_exclusive(keep ? 1u : 0u);
+    if (gl_LocalInvocationIndex == 0 && scan_is_last_tile())
+        draw_counts[pass] = scan_inclusive();
+    if (!keep)
+        return;
+    Command command = commands[i];
+    command.instance_count *= uint(views);
+    compact_commands[slot] = command;
+}
@@ -0,0 +1,331 @@
+/*
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#version 450
+
+// Culls the instances of the scene batch against the view frustum and the
+// depth pyramid, one instance per thread, and appends the visible ones to the
+// commands of the meshlets of their level of detail that are in the frustum
+// and face the eye (see MeshBatch)
+//
+// The early pass tests every instance against the pyramid of the previous
+// frame and records which ones it draws; the late pass tests the others
+// against the pyramid of what the early pass drew, to draw the disoccluded
+// ones. Only the late pass tests the meshlets against the pyramid: the early
+// one draws the instances whole, since the late one doesn't revisit them.
+// The shadow pass tests every instance against the frustum of a light, with
+// no pyramid, and leaves the record of the early pass. With occlusion queries
+// the early pass also hides the instances of the boxes that failed theirs.
+// The distant instances of the early and the late passes may be impostors,
+// appended to a list of their own instead of the commands of any level.
+// With SUBGROUPS each subgroup appends its impostors with a single atomic.
+
+#ifdef SUBGROUPS
+#extension GL_KHR_shader_subgroup_ballot : require
+#endif
+
+layout (local_size_x = GROUP_SIZE) in;
+
+#include "models.glsl"
+
+// Draws of the batch, one per level of detail, as in geompass_vs.glsl
+struct Draw {
+    vec4 dequantization;
+    int material_id;
+    int first_instance;
+};
+
+layout (std430) readonly buffer DrawsBlock {
+    Draw draws[];
+};
+
+// Index in models of each instance drawn, written here
+layout (std430) writeonly buffer InstancesBlock {
+    int instances[];
+};
+
+// Indirect commands of the draws, which count the instances appended
+struct Command {
+    uint count;
+    uint instance_count;
+    uint first_index;
+    int base_vertex;
+    uint base_instance;
+};
+
+layout (std430) buffer CommandsBlock {
+    Command commands[];
+};
+
+// Bounding sphere in model space and levels of detail of each draw added
+struct CullDraw {
+    vec4 sphere;
+    int first_lod;
+    int n_lods;
+};
+
+layout (std430) readonly buffer CullDrawsBlock {
+    CullDraw cull_draws[];
+};
+
+// Commands of each level of detail, one per meshlet
+struct CullLod {
+    int first_command;
+    int n_commands;
+};
+
+layout (std430) readonly buffer CullLodsBlock {
+    CullLod cull_lods[];
+};
+
+// Bounding sphere and normal cone, axis and cutoff, in model space of the
+// meshlet of each command
+struct CullMeshlet {
+    vec4 sphere;
+    vec4 cone;
+};
+
+layout (std430) readonly buffer CullMeshletsBlock {
+    CullMeshlet cull_meshlets[];
+};
+
+// Draw added and model matrix of each instance to cull
+struct Candidate {
+    int draw;
+    int model;
+};
+
+layout (std430) readonly buffer CandidatesBlock {
+    Candidate candidates[];
+};
+
+// Whether the early pass drew each candidate, written by it and read by the
+// late pass
+layout (std430) buffer DrawnBlock {
+    int drawn[];
+};
+
+// Whether the occlusion query of each box of box_models consecutive models
+// from first_box on found it visible, in the early pass with
+// --occlusion-queries (see OcclusionQueries)
+layout (std430) readonly buffer BoxVisibilityBlock {
+    uint box_visibility[];
+};
+
+uniform int n_boxes;
+uniform int first_box;
+uniform int box_models;
+
+// Draw of the impostors of the early and the late passes, which counts the
+// instances appended, as glDrawArraysIndirect, and the index in models of
+// each impostor of this pass
+struct ImpostorCommand {
+    uint count;
+    uint instance_count;
+    uint first;
+    uint base_instance;
+};
+
+layout (std430) buffer ImpostorCommandsBlock {
+    ImpostorCommand impostor_commands[];
+};
+
+layout (std430) writeonly buffer ImpostorInstancesBlock {
+    int impostor_instances[];
+};
+
+// Angular size below which an instance is an impostor, 0 for none (see
+// MeshBatch::SetImpostorAngle)
+uniform float impostor_angle;
+
+uniform int n_candidates;
+
+// Normalized frustum planes in world space, facing inwards, six for each
+// view the instances are drawn from (MAX_VIEWS is MeshBatch::MAX_VIEWS)
+uniform vec4 frustum_planes[6 * MAX_VIEWS];
+uniform int n_frustums;
+
+// Camera position in world space, and the distance to it of the eyes the
+// instances are drawn from (see MeshBatch::SetViews)
+uniform vec3 eye;
+uniform float eye_radius;
+
+// Sphere radius over distance below which the next level of detail is used
+uniform float lod_angle;
+
+// Farthest depths of the pyramid levels and the view projection they were
+// rendered with, no levels until there is a pyramid (see DepthPyramid)
+uniform sampler2D depth_pyramid;
+uniform mat4 pyramid_view_projection;
+uniform vec2 pyramid_size;
+uniform int pyramid_levels;
+
+uniform bool late_pass;
+uniform bool shadow_pass;
+
+// Checks if a sphere in world space is inside the frustum of a view
+bool IsInFrustum(int frustum, vec3 center, float radius) {
+    for (int p = 6 * frustum; p < 6 * frustum + 6; ++p) {
+        if (dot(frustum_planes[p].xyz, center) + frustum_planes[p].w < -radius)
+            return false;
+    }
+    return true;
+}
+
+// Checks if a sphere in world space is inside the frustum of any view
+bool IsInFrustum(vec3 center, float radius) {
+    for (int f = 0; f < n_frustums; ++f) {
+        if (IsInFrustum(f, center, radius))
+            return true;
+    }
+    return false;
+}
+
+// Checks if every face inside a sphere in world space, whose normals are in
+// a cone, faces away from every eye; moving the eye is moving the sphere, so
+// the eyes around it grow the sphere
+bool IsBackfacing(vec3 center, float radius, vec3 axis, float cutoff) {
+    vec3 view = center - eye;
+    return dot(view, axis) >= cutoff * length(view) + radius + eye_radius;
+}
+
+// Checks if the box of the model of an instance failed its occlusion query;
+// the models of no box are never hidden by them
+bool IsBoxHidden(int model) {
+    int box = (model - first_box) / box_models;
+    if (model < first_box || box >= n_boxes)
+        return false;
+    return box_visibility[box] == 0;
+}
+
+// Checks if a sphere in world space is behind the depths of the pyramid
+bool IsOccluded(vec3 center, float radius) {
+    if (pyramid_levels == 0)
+        return false;
+
+    // The bounds of the projected corners of the box around the sphere
+    // contain its projection, and the nearest corner is nearer than it
+    vec3 ndc_min = vec3(1);
+    vec3 ndc_max = vec3(-1);
+    for (int c = 0; c < 8; ++c) {
+        vec3 corner = center + radius * vec3((c & 1) != 0 ? 1 : -1,
+                                             (c & 2) != 0 ? 1 : -1,
+                                             (c & 4) != 0 ? 1 : -1);
+        vec4 clip = pyramid_view_projection * vec4(corner, 1);
+        // Crosses the plane of the eye
+        if (clip.w <= 0)
+            return false;
+        vec3 ndc = clip.xyz / clip.w;
+        ndc_min = min(ndc_min, ndc);
+        ndc_max = max(ndc_max, ndc);
+    }
+    vec2 pixel_min = clamp(ndc_min.xy * 0.5 + 0.5, 0, 1) * pyramid_size;
+    vec2 pixel_max = clamp(ndc_max.xy * 0.5 + 0.5, 0, 1) * pyramid_size;
+    float depth = ndc_min.z * 0.5 + 0.5;
+
+    // At this level the rectangle covers at most 2x2 texels
+    vec2 extent = max(pixel_max - pixel_min, vec2(1));
+    int level = int(ceil(log2(max(extent.x, extent.y))));
+    level = min(level, pyramid_levels - 1);
+    ivec2 last_texel = textureSize(depth_pyramid, level) - 1;
+    ivec2 texel_min = min(ivec2(pixel_min) >> level, last_texel);
+    ivec2 texel_max = min(ivec2(pixel_max) >> level, last_texel);
+    float farthest = max(
+        max(texelFetch(depth_pyramid, texel_min, level).r,
+            texelFetch(depth_pyramid, ivec2(texel_max.x, texel_min.y),
+                       level).r),
+        max(texelFetch(depth_pyramid, ivec2(texel_min.x, texel_max.y),
+                       level).r,
+            texelFetch(depth_pyramid, texel_max, level).r));
+    return depth > farthest;
+}
+
+void main() {
+    int i = int(gl_GlobalInvocationID.x);
+    if (i >= n_candidates)
+        return;
+    if (late_pass && drawn[i] != 0)
+        return;
+    Candidate candidate = candidates[i];
+    CullDraw cull_draw = cull_draws[candidate.draw];
+
+    // The models keep the sizes, so only the center moves
+    mat4 model = model_matrix(candidate.model);
+    vec3 center = vec3(model * vec4(cull_draw.sphere.xyz, 1));
+    float radius = cull_draw.sphere.w;
+    bool visible = IsInFrustum(center, radius) &&
+                   !IsOccluded(center, radius) &&
+                   !IsBoxHidden(candidate.model);
+    if (!late_pass && !shadow_pass)
+        drawn[i] = int(visible);
+    if (!visible)
+        return;
+
+    // Each level has about half the triangles of the previous one, so it
+    // starts at 1/sqrt(2) of its angular size, from the nearest eye
+    float angle = radius / max(distance(eye, center) - eye_radius, 1e-6);
+    bool impostor = angle < impostor_angle;
+#ifdef SUBGROUPS
+    uvec4 ballot = subgroupBallot(impostor);
+    uint count = subgroupBallotBitCount(ballot);
+    uint first = 0u;
+    if (count > 0u && subgroupElect())
+        first = atomicAdd(impostor_commands[late_pass ? 1 : 0].instance_count,
+                          count);
+    if (impostor) {
+        uint slot = subgroupBroadcastFirst(first) +
+                    subgroupBallotExclusiveBitCount(ballot);
+        impostor_instances[slot] = candidate.model;
+        return;
+    }
+#else
+    if (impostor) {
+        uint slot = atomicAdd(
+            impostor_commands[late_pass ? 1 : 0].instance_count, 1);
+        impostor_instances[slot] = candidate.model;
+        return;
+    }
+#endif
+    int lod = 0;
+    if (angle < lod_angle)
+        lod = 1 + int(2 * log2(lod_angle / angle));
+    CullLod cull_lod = cull_lods[cull_draw.first_lod +
+                                 min(lod, cull_draw.n_lods - 1)];
+
+    for (int m = 0; m < cull_lod.n_commands; ++m) {
+        int command = cull_lod.first_command + m;
+        CullMeshlet meshlet = cull_meshlets[command];
+        vec3 meshlet_center = vec3(model * vec4(meshlet.sphere.xyz, 1));
+        vec3 axis = mat3(model) * meshlet.cone.xyz;
+        float meshlet_radius = meshlet.sphere.w;
+        if (!IsInFrustum(meshlet_center, meshlet_radius) ||
+            IsBackfacing(meshlet_center, meshlet_radius, axis, meshlet.cone.w))
+            continue;
+        if (late_pass && IsOccluded(meshlet_center, meshlet_radius))
+            continue;
+
+        uint slot = atomicAdd(commands[command].instance_count, 1);
+        instances[draws[command].first_instance + int(slot)] = candidate.model;
+    }
+}
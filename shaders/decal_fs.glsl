@@ -0,0 +1,93 @@
+/*
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#version 450
+
+// Deferred decal: projects a splat along the y axis of its box onto the
+// surfaces of the G-buffer inside it, and blends its normal and albedo over
+// theirs. The back faces of the box are drawn with the G-buffer depth tested
+// but not written, so each pixel is shaded once even with the eye inside.
+
+// Depth of the G-buffer, read-only while it's attached
+layout(binding = 0) uniform sampler2D depth_texture;
+
+uniform mat4 inv_projection;
+uniform vec2 gbuffer_size;
+
+// Half of the extent of the box along each axis
+uniform vec3 decal_half_size;
+
+flat in mat4 view_to_decal;
+
+// The G-buffer outputs and write_decal() are generated from the layout
+// (see GBufferLayout)
+
+// Colors of the inside of the splat and of its rim
+const vec3 INSIDE_ALBEDO = vec3(0.08, 0.06, 0.05);
+const vec3 RIM_ALBEDO = vec3(0.35, 0.27, 0.2);
+
+// Radius and width of the rim, relative to the radius of the splat, and
+// slope of its bump
+const float RIM_RADIUS = 0.7;
+const float RIM_WIDTH = 0.12;
+const float BUMP_SLOPE = 0.6;
+
+// Rebuilds the view-space position from the depth buffer
+vec3 reconstruct_position(vec2 uv, float depth) {
+    vec4 ndc = vec4(vec3(uv, depth) * 2 - 1, 1);
+    vec4 position = inv_projection * ndc;
+    return position.xyz / position.w;
+}
+
+void main() {
+    float depth = texelFetch(depth_texture, ivec2(gl_FragCoord.xy), 0).r;
+    vec3 position = reconstruct_position(gl_FragCoord.xy / gbuffer_size,
+                                         depth);
+    // The normals being blended can't be read back, the surface is
+    // rebuilt from the depth instead, before any fragment is discarded
+    vec3 normal = normalize(cross(dFdx(position), dFdy(position)));
+    vec3 local = (view_to_decal * vec4(position, 1)).xyz / decal_half_size;
+    if (any(greaterThan(abs(local), vec3(1))))
+        discard;
+
+    // The splat fades out on the surfaces that don't face its axis and
+    // towards the ends of the box
+    mat3 decal_to_view = transpose(mat3(view_to_decal));
+    vec3 axis = decal_to_view[1];
+    float facing = smoothstep(0.5, 0.8, dot(normal, axis));
+    float r = length(local.xz);
+    float opacity = (1 - smoothstep(0.75, 1.0, r)) *
+                    (1 - smoothstep(0.6, 1.0, abs(local.y))) * facing;
+    if (opacity <= 0)
+        discard;
+
+    // Raised rim, a gaussian of the radius whose gradient tilts the normal
+    float offset = (r - RIM_RADIUS) / RIM_WIDTH;
+    float rim = exp(-offset * offset);
+    float slope = -2 * offset / RIM_WIDTH * rim * BUMP_SLOPE;
+    vec2 gradient = r > 0 ? slope * local.xz / r : vec2(0);
+    vec3 bumped = normalize(normal - gradient.x * decal_to_view[0] -
+                            gradient.y * decal_to_view[2]);
+    write_decal(bumped, mix(INSIDE_ALBEDO, RIM_ALBEDO, rim), opacity);
+}
@@ -0,0 +1,48 @@
+/*
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#version 450
+#extension GL_ARB_shader_draw_parameters : require
+
+// Box of a deferred decal, drawn after the geometry pass into the G-buffer
+// (see decal_fs)
+
+#include "geometry.glsl"
+
+// Position quantized to the bounds of the box
+layout(location = 0) in vec4 position;
+
+// View space to the space of the box, where it's centered at the origin
+flat out mat4 view_to_decal;
+
+void main() {
+    mat4 model = instance_model();
+    gl_Position = view_projection * transform_position(model, position);
+    // The decals only rotate and translate, so the inverse of the modelview
+    // is its transposed rotation
+    mat4 model_view = view * model;
+    mat3 rotation = transpose(mat3(model_view));
+    view_to_decal = mat4(rotation);
+    view_to_decal[3] = vec4(-rotation * model_view[3].xyz, 1);
+}
@@ -0,0 +1,60 @@
+/*
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Diffuse maps of the materials, picked by the layer of a material. It has no
+// #version line: the fragment shaders #include it after theirs, which also
+// enable ARB_bindless_texture with BINDLESS_MAPS. The maps are
+// the layers of one array texture (see TextureArray), or with BINDLESS_MAPS
+// textures of their own sizes, read through the bindless handle of each
+// layer, so they are never bound either. The handle may differ between the
+// fragments of a draw, which draws several materials, so the derivatives are
+// taken before the handle is read. A negative layer, no map, reads nothing.
+
+#ifdef BINDLESS_MAPS
+// Handle of the texture of each layer, a single layer array
+layout (std430) readonly buffer DiffuseHandlesBlock {
+    uvec2 diffuse_handles[];
+};
+
+vec4 sample_diffuse_map_grad(int layer, vec2 uv, vec2 dx, vec2 dy) {
+    if (layer < 0)
+        return vec4(1);
+    return textureGrad(sampler2DArray(diffuse_handles[layer]), vec3(uv, 0),
+                       dx, dy);
+}
+
+vec4 sample_diffuse_map(int layer, vec2 uv) {
+    return sample_diffuse_map_grad(layer, uv, dFdx(uv), dFdy(uv));
+}
+#else
+layout(binding = 0) uniform sampler2DArray diffuse_maps;
+
+vec4 sample_diffuse_map(int layer, vec2 uv) {
+    return texture(diffuse_maps, vec3(uv, max(layer, 0)));
+}
+
+vec4 sample_diffuse_map_grad(int layer, vec2 uv, vec2 dx, vec2 dy) {
+    return textureGrad(diffuse_maps, vec3(uv, max(layer, 0)), dx, dy);
+}
+#endif
@@ -0,0 +1,55 @@
+/*
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#version 450
+
+// Keeps the pixels whose samples belong to different surfaces, so a stencil
+// mask can restrict the per-sample shading to the geometric edges. The
+// G-buffer samplers and read_gbuffer() are generated from the layout.
+
+// Minimum cosine between the normals of the same surface
+const float NORMAL_THRESHOLD = 0.95;
+
+// Maximum depth difference of the same surface, relative to the distance
+const float DEPTH_THRESHOLD = 0.01;
+
+void main() {
+    ivec2 coord = ivec2(gl_FragCoord.xy);
+    vec3 position0, normal0;
+    int material0;
+    bool valid0 = read_gbuffer(coord, 0, position0, normal0, material0);
+    for (int i = 1; i < GBUFFER_SAMPLES; ++i) {
+        vec3 position, normal;
+        int material;
+        bool valid = read_gbuffer(coord, i, position, normal, material);
+        if (valid != valid0)
+            return;
+        if (!valid)
+            continue;
+        if (material != material0 || dot(normal, normal0) < NORMAL_THRESHOLD ||
+            abs(position.z - position0.z) > DEPTH_THRESHOLD * -position0.z)
+            return;
+    }
+    discard;
+}
@@ -0,0 +1,74 @@
+/*
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Volumetric fog, in froxels of the view frustum split in screen tiles and
+// exponential depth slices (see VolumetricFog). It has no #version line: the
+// fog shaders and, with FOG, the lighting pass #include it after the G-buffer
+// code. The lighting pass reads the integrated volume with the unit after the
+// sun cascades (GBUFFER_TEXTURES + 3).
+
+// Number of froxels in x, y and depth
+uniform ivec3 fog_grid;
+
+// Distances of the first and the last depth slices
+uniform vec2 fog_depth_range;
+
+// Obtains the distance from the eye where a depth slice starts, or a part of
+// it
+float fog_slice_distance(float slice) {
+    float near = fog_depth_range.x;
+    float far = fog_depth_range.y;
+    return near * pow(far / near, slice / fog_grid.z);
+}
+
+// Obtains the depth slice, with its fraction, at a distance from the eye
+float fog_slice(float distance) {
+    float near = fog_depth_range.x;
+    float far = fog_depth_range.y;
+    return log(distance / near) / log(far / near) * fog_grid.z;
+}
+
+// Obtains the view-space direction through a point of the screen, from 0 to
+// 1, scaled to a unit distance from the eye
+vec3 fog_ray(vec2 uv) {
+    vec4 far_point = inv_projection * vec4(uv * 2 - 1, 1, 1);
+    return far_point.xyz / -far_point.z;
+}
+
+#ifdef FOG
+layout(binding = GBUFFER_TEXTURES + 3) uniform sampler3D fog_volume;
+
+// Attenuates the color of a G-buffer pixel by the fog in front of it and adds
+// the light the fog scatters toward the eye; each froxel holds the fog up to
+// its far side, so the distance is read half a slice before
+vec3 apply_fog(vec3 color, ivec2 coord) {
+    vec2 uv = (vec2(coord) + 0.5) / gbuffer_size;
+    float depth = texelFetch(gbuffer_depth, coord, 0).r;
+    vec4 position = inv_projection * (vec4(uv, depth, 1) * 2 - 1);
+    float distance = -position.z / position.w;
+    vec3 uvw = vec3(uv, (fog_slice(distance) - 0.5) / fog_grid.z);
+    vec4 fog = textureLod(fog_volume, uvw, 0);
+    return color * fog.a + fog.rgb;
+}
+#endif
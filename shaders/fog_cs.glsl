@@ -0,0 +1,141 @@
+/*
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#version 450
+
+// Volumetric fog (see VolumetricFog). With INJECT each thread takes a froxel
+// and stores the light scattered toward the eye at its center, per world
+// unit, and the extinction of the fog: the ambient light and the lights of
+// the cluster of the center, shadowed with SPOT_SHADOWS, weighted by a phase
+// function that favours the light going on toward the eye. With INTEGRATE
+// each thread takes a column of froxels and marches it from the eye,
+// storing in each the light scattered up to its far side, as seen through
+// the fog in front, and the transmittance. GROUP_SIZE is defined by the
+// application.
+
+#ifdef INJECT
+
+#include "lighting.glsl"
+#include "spot_shading.glsl"
+#include "clusters.glsl"
+#include "fog.glsl"
+
+layout (local_size_x = GROUP_SIZE, local_size_y = GROUP_SIZE,
+        local_size_z = GROUP_SIZE) in;
+
+layout (rgba16f) uniform writeonly image3D scattering_image;
+
+// Extinction per world unit, all of it scattered
+uniform float density;
+
+// Asymmetry of the scattering, forward when positive
+const float ANISOTROPY = 0.3;
+
+// Obtains the Henyey-Greenstein phase function of the cosine between the
+// light and the direction to the eye, times 4 pi so an isotropic fog
+// scatters the light as it comes
+float phase(float cos_theta) {
+    float g2 = ANISOTROPY * ANISOTROPY;
+    return (1 - g2) / pow(1 + g2 - 2 * ANISOTROPY * cos_theta, 1.5);
+}
+
+void main() {
+    ivec3 froxel = ivec3(gl_GlobalInvocationID);
+    if (any(greaterThanEqual(froxel, fog_grid)))
+        return;
+    vec2 uv = (vec2(froxel.xy) + 0.5) / vec2(fog_grid.xy);
+    float distance = fog_slice_distance(froxel.z + 0.5);
+    vec3 position = fog_ray(uv) * distance;
+    // The light goes on toward the eye when it goes away from the light
+    vec3 view_dir = normalize(position);
+
+    vec3 light = global_ambient;
+    int cluster = find_cluster(uv * cluster_screen_size, distance);
+    uvec4 range = cluster_ranges[cluster];
+    uint first_spot = range.x + range.y;
+    for (uint i = range.x; i < first_spot; ++i) {
+        PointLight L = point_lights[cluster_lights[i]];
+        vec3 light_dir;
+        float attenuation = compute_light_dir(L.position, L.range, position,
+                                              light_dir);
+        light += L.diffuse * attenuation * phase(dot(light_dir, view_dir));
+    }
+    for (uint i = first_spot; i < first_spot + range.z; ++i) {
+        uint index = cluster_lights[i];
+        SpotLight L = spot_lights[index];
+        vec3 light_dir;
+        float attenuation = compute_light_dir(L.position, L.range, position,
+                                              light_dir) *
+                            compute_spot(L, light_dir);
+        if (attenuation == 0)
+            continue;
+#ifdef SPOT_SHADOWS
+        attenuation *= compute_spot_shadow(index, position);
+#endif
+        light += L.diffuse * attenuation * phase(dot(light_dir, view_dir));
+    }
+#ifdef CLUSTER_LIGHT_BUDGET
+    // The lights left out scatter evenly
+    light += cluster_ambient[cluster].rgb;
+#endif
+    imageStore(scattering_image, froxel, vec4(density * light, density));
+}
+
+#endif
+
+#ifdef INTEGRATE
+
+uniform mat4 inv_projection;
+
+#include "fog.glsl"
+
+layout (local_size_x = GROUP_SIZE, local_size_y = GROUP_SIZE) in;
+
+layout (rgba16f) uniform readonly image3D scattering_image;
+layout (rgba16f) uniform writeonly image3D integrated_image;
+
+void main() {
+    ivec2 column = ivec2(gl_GlobalInvocationID.xy);
+    if (any(greaterThanEqual(column, fog_grid.xy)))
+        return;
+    // Length of the ray per unit of distance from the eye
+    float stretch = length(fog_ray((vec2(column) + 0.5) / vec2(fog_grid.xy)));
+    vec3 light = vec3(0);
+    float transmittance = 1;
+    float start = 0;
+    for (int z = 0; z < fog_grid.z; ++z) {
+        vec4 froxel = imageLoad(scattering_image, ivec3(column, z));
+        float end = fog_slice_distance(z + 1);
+        float slice_transmittance = exp(-froxel.a * (end - start) * stretch);
+        // The light scattered in the slice is also attenuated in it
+        light += transmittance * froxel.rgb * (1 - slice_transmittance) /
+                 max(froxel.a, 1e-6);
+        transmittance *= slice_transmittance;
+        imageStore(integrated_image, ivec3(column, z),
+                   vec4(light, transmittance));
+        start = end;
+    }
+}
+
+#endif
@@ -0,0 +1,109 @@
+/*
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#version 450
+
+// Forward+ shading of the transparent surfaces, blended over the lighting
+// after it: each fragment applies the lights of its cluster (see
+// clusters.glsl) with the shading functions of lighting.glsl. The G-buffer
+// code is only included for GBUFFER_TEXTURES, the unit of the shadow atlas
+// with SPOT_SHADOWS (see spot_shading.glsl) and of the maps of the sun with
+// SUN_LIGHT (see sun_shading.glsl). With WEIGHTED_OIT the surfaces aren't
+// sorted: each fragment adds its premultiplied color, weighted by its depth,
+// and its opacity to the targets of a reduced resolution, which
+// oit_composite_fs.glsl then blends over the lighting.
+
+#include "lighting.glsl"
+#ifdef RAY_TRACED_SHADOWS
+#include "shadow_bvh.glsl"
+#endif
+#include "spot_shading.glsl"
+#ifdef SUN_LIGHT
+#include "sun_shading.glsl"
+#endif
+#include "clusters.glsl"
+
+in vec3 frag_position;
+in vec3 frag_normal;
+flat in vec4 frag_color;  // of the surface, with its opacity in alpha
+
+#ifdef WEIGHTED_OIT
+// Weighted colors with the sum of the weights in alpha, added, and the
+// coverage of the fragments in red, blended as 1 - prod(1 - opacity)
+layout(location = 0) out vec4 accumulation;
+layout(location = 1) out vec4 coverage;
+
+// G-buffer pixels per pixel of the targets, which have no depth buffer, so
+// the fragments are tested against the depth of the G-buffer here
+uniform vec2 oit_pixel_size;
+
+// Weight of a fragment at a distance from the eye, so the nearer surfaces
+// dominate the average color (McGuire and Bavoil, equation 9)
+float oit_weight(float distance, float opacity) {
+    return opacity * clamp(0.03 / (1e-5 + pow(distance / 200, 4)), 1e-2, 3e3);
+}
+#else
+out vec4 color;
+#endif
+
+void main() {
+    vec2 pixel = gl_FragCoord.xy;
+#ifdef WEIGHTED_OIT
+    pixel *= oit_pixel_size;
+    if (gl_FragCoord.z > texelFetch(gbuffer_depth, ivec2(pixel), 0).r)
+        discard;
+#endif
+    Material M;
+    M.diffuse = frag_color.rgb;
+    M.diffuse_map = -1;
+    M.ambient = frag_color.rgb;
+    M.specular = vec3(1);
+    M.shininess = 64;
+    vec3 normal = normalize(frag_normal);
+
+    vec3 acc_color = compute_ambient(M);
+    int cluster = find_cluster(pixel, -frag_position.z);
+    uvec4 range = cluster_ranges[cluster];
+    uint first_spot = range.x + range.y;
+    for (uint i = range.x; i < first_spot; ++i) {
+        PointLight L = point_lights[cluster_lights[i]];
+        acc_color += compute_point_shading(L, M, normal, frag_position);
+    }
+    for (uint i = first_spot; i < first_spot + range.z; ++i)
+        acc_color += shade_spot_light(cluster_lights[i], M, normal,
+                                      frag_position);
+#ifdef CLUSTER_LIGHT_BUDGET
+    acc_color += shade_cluster_ambient(cluster, M);
+#endif
+#ifdef SUN_LIGHT
+    acc_color += shade_sun(M, normal, frag_position);
+#endif
+#ifdef WEIGHTED_OIT
+    float weight = oit_weight(-frag_position.z, frag_color.a);
+    accumulation = vec4(acc_color * weight, weight);
+    coverage = vec4(frag_color.a, 0, 0, frag_color.a);
+#else
+    color = vec4(acc_color, frag_color.a);
+#endif
+}
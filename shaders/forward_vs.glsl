@@ -0,0 +1,71 @@
+/*
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#version 450
+
+// Transparent sphere of the forward pass (see forward_fs); with
+// TRANSPARENT_BATCH, each instance is one sphere of a batch of up to that
+// many, as large as a uniform block of the device holds
+
+// Unit sphere centered at the origin
+layout(location = 0) in vec3 position;
+
+uniform mat4 projection;
+
+#ifdef TRANSPARENT_BATCH
+// Spheres of the batch, in view space, and their colors
+struct TransparentInstance {
+    vec4 center_radius;
+    vec4 color;
+};
+
+layout (std140) uniform TransparentBlock {
+    TransparentInstance transparent_instances[TRANSPARENT_BATCH];
+};
+#else
+// Sphere in view space, and its color with its opacity in alpha
+uniform vec3 sphere_center;
+uniform float sphere_radius;
+uniform vec4 surface_color;
+#endif
+
+out vec3 frag_position;
+out vec3 frag_normal;
+flat out vec4 frag_color;
+
+void main() {
+#ifdef TRANSPARENT_BATCH
+    TransparentInstance instance = transparent_instances[gl_InstanceID];
+    vec3 center = instance.center_radius.xyz;
+    float radius = instance.center_radius.w;
+    frag_color = instance.color;
+#else
+    vec3 center = sphere_center;
+    float radius = sphere_radius;
+    frag_color = surface_color;
+#endif
+    frag_position = center + radius * position;
+    frag_normal = position;
+    gl_Position = projection * vec4(frag_position, 1);
+}
@@ -0,0 +1,176 @@
+/*
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#version 450
+
+// Fast approximate antialiasing of the lit image, after the FXAA 3.11 quality
+// algorithm: the pixels whose luma contrasts with their neighbors are on an
+// edge, which is searched in both directions for its ends with bilinear taps
+// of FXAA_STEPS growing steps (defined by --fxaa). The pixel is then blended
+// across the edge by how near it is to an end, or by its contrast with the
+// 3x3 average on thin features. The lit image may be smaller than the
+// backbuffer (see --dynamic-resolution), the taps upscale it bilinearly.
+
+// Lit image, with a linear sampler
+layout(binding = 0) uniform sampler2D lit_texture;
+
+// Size of the lit image inside its texture, and of the backbuffer
+uniform vec2 lit_size;
+uniform vec2 output_size;
+
+// Contrast below which a pixel isn't on an edge, relative to its brightest
+// neighbor and absolute for the dark ones
+const float EDGE_THRESHOLD = 0.166;
+const float EDGE_THRESHOLD_MIN = 0.0833;
+
+// Amount of the blend of thin features
+const float SUBPIXEL_QUALITY = 0.75;
+
+// Texels of each step of the search along the edges
+#if FXAA_STEPS == 12
+const float STEPS[12] = float[](1.0, 1.0, 1.0, 1.0, 1.0, 1.5, 2.0, 2.0, 2.0,
+                                2.0, 4.0, 8.0);
+#else
+const float STEPS[5] = float[](1.0, 1.5, 2.0, 4.0, 12.0);
+#endif
+
+// Output color
+out vec3 color;
+
+// Texel size and last texel center of the lit image
+vec2 texel;
+vec2 max_uv;
+
+float luma(vec3 rgb) {
+    return dot(rgb, vec3(0.299, 0.587, 0.114));
+}
+
+float luma_at(vec2 uv) {
+    return luma(textureLod(lit_texture, min(uv, max_uv), 0).rgb);
+}
+
+void main() {
+    texel = 1.0 / vec2(textureSize(lit_texture, 0));
+    max_uv = (lit_size - 0.5) * texel;
+    vec2 uv = min(gl_FragCoord.xy * lit_size / output_size * texel, max_uv);
+    vec3 rgb = textureLod(lit_texture, uv, 0).rgb;
+    float luma_m = luma(rgb);
+    float luma_n = luma_at(uv + vec2(0, texel.y));
+    float luma_s = luma_at(uv - vec2(0, texel.y));
+    float luma_e = luma_at(uv + vec2(texel.x, 0));
+    float luma_w = luma_at(uv - vec2(texel.x, 0));
+    float range_max =
+        max(luma_m, max(max(luma_n, luma_s), max(luma_e, luma_w)));
+    float range_min =
+        min(luma_m, min(min(luma_n, luma_s), min(luma_e, luma_w)));
+    float range = range_max - range_min;
+    if (range < max(EDGE_THRESHOLD_MIN, range_max * EDGE_THRESHOLD)) {
+        color = rgb;
+        return;
+    }
+
+    float luma_ne = luma_at(uv + texel);
+    float luma_sw = luma_at(uv - texel);
+    float luma_nw = luma_at(uv + vec2(-texel.x, texel.y));
+    float luma_se = luma_at(uv + vec2(texel.x, -texel.y));
+    float luma_ns = luma_n + luma_s;
+    float luma_we = luma_w + luma_e;
+    float corners_w = luma_nw + luma_sw;
+    float corners_e = luma_ne + luma_se;
+    float corners_n = luma_nw + luma_ne;
+    float corners_s = luma_sw + luma_se;
+
+    // The edge is horizontal if the luma varies more vertically
+    float gradient_h = abs(corners_w - 2.0 * luma_w) +
+                       2.0 * abs(luma_ns - 2.0 * luma_m) +
+                       abs(corners_e - 2.0 * luma_e);
+    float gradient_v = abs(corners_s - 2.0 * luma_s) +
+                       2.0 * abs(luma_we - 2.0 * luma_m) +
+                       abs(corners_n - 2.0 * luma_n);
+    bool horizontal = gradient_h >= gradient_v;
+
+    // The edge lies between the pixel and its most different neighbor across
+    float luma_neg = horizontal ? luma_s : luma_w;
+    float luma_pos = horizontal ? luma_n : luma_e;
+    float gradient_neg = abs(luma_neg - luma_m);
+    float gradient_pos = abs(luma_pos - luma_m);
+    bool neg = gradient_neg >= gradient_pos;
+    float step_across = horizontal ? texel.y : texel.x;
+    if (neg)
+        step_across = -step_across;
+    float luma_edge = 0.5 * ((neg ? luma_neg : luma_pos) + luma_m);
+    float gradient_end = 0.25 * max(gradient_neg, gradient_pos);
+    vec2 edge_uv = uv;
+    vec2 step_along = vec2(0, texel.y);
+    if (horizontal) {
+        edge_uv.y += 0.5 * step_across;
+        step_along = vec2(texel.x, 0);
+    } else {
+        edge_uv.x += 0.5 * step_across;
+    }
+
+    // The edge ends where the luma along it moves away from the one at the
+    // pixel by a quarter of the gradient
+    vec2 uv_neg = edge_uv - step_along * STEPS[0];
+    vec2 uv_pos = edge_uv + step_along * STEPS[0];
+    float end_neg = luma_at(uv_neg) - luma_edge;
+    float end_pos = luma_at(uv_pos) - luma_edge;
+    bool done_neg = abs(end_neg) >= gradient_end;
+    bool done_pos = abs(end_pos) >= gradient_end;
+    for (int i = 1; i < FXAA_STEPS && !(done_neg && done_pos); ++i) {
+        if (!done_neg) {
+            uv_neg -= step_along * STEPS[i];
+            end_neg = luma_at(uv_neg) - luma_edge;
+            done_neg = abs(end_neg) >= gradient_end;
+        }
+        if (!done_pos) {
+            uv_pos += step_along * STEPS[i];
+            end_pos = luma_at(uv_pos) - luma_edge;
+            done_pos = abs(end_pos) >= gradient_end;
+        }
+    }
+
+    // Only the side of the edge the nearest end turns towards is blended
+    float distance_neg = horizontal ? uv.x - uv_neg.x : uv.y - uv_neg.y;
+    float distance_pos = horizontal ? uv_pos.x - uv.x : uv_pos.y - uv.y;
+    bool nearest_neg = distance_neg < distance_pos;
+    float end = nearest_neg ? end_neg : end_pos;
+    float offset = 0.0;
+    if ((end < 0.0) != (luma_m < luma_edge))
+        offset = 0.5 - min(distance_neg, distance_pos) /
+                           (distance_neg + distance_pos);
+
+    // Thin features have no ends, they're blended by their local contrast
+    float luma_average = (2.0 * (luma_ns + luma_we) + corners_w + corners_e) /
+                         12.0;
+    float subpixel = clamp(abs(luma_average - luma_m) / range, 0.0, 1.0);
+    subpixel = (3.0 - 2.0 * subpixel) * subpixel * subpixel;
+    offset = max(offset, subpixel * subpixel * SUBPIXEL_QUALITY);
+
+    if (horizontal)
+        uv.y += offset * step_across;
+    else
+        uv.x += offset * step_across;
+    color = textureLod(lit_texture, min(uv, max_uv), 0).rgb;
+}
@@ -0,0 +1,157 @@
+/*
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Buffers and transform of the instances drawn by the batches, shared by the
+// geometry pass and the depth pre-pass. It has no #version line: the vertex
+// shaders #include it after theirs and the draw parameters extension. Both
+// compute gl_Position with the same functions and declare it invariant, so
+// the geometry pass can test the depth of the pre-pass for equality.
+
+#ifdef VIEWS
+#extension GL_ARB_shader_viewport_layer_array : require
+#endif
+
+#include "models.glsl"
+
+// Position dequantization, material and first entry in instances of each
+// draw of the batch (see MeshBatch)
+struct Draw {
+    vec4 dequantization;
+    int material_id;
+    int first_instance;
+};
+
+layout (std430) buffer DrawsBlock {
+    Draw draws[];
+};
+
+// Index in models of each instance, grouped by draw
+layout (std430) buffer InstancesBlock {
+    int instances[];
+};
+
+// Camera matrices, uploaded every frame
+layout (std140) uniform CameraBlock {
+    mat4 view;
+    mat4 projection;
+    mat4 view_projection;
+};
+
+// Index in draws of the command being drawn, which is its base instance: the
+// culling compacts the commands with instances, so the draw id is only their
+// position in the call
+int draw_index() {
+    return gl_BaseInstanceARB;
+}
+
+#ifdef VIEWS
+// Transforms from the view of the camera to the clip space of each view the
+// geometry is drawn from, the eyes of --stereo or the cameras of
+// --camera-wall, and back, uploaded every frame
+layout (std140) uniform ViewsBlock {
+    mat4 view_to_clip[VIEWS];
+    mat4 clip_to_view[VIEWS];
+};
+
+// Each instance is drawn once per view, the view in the lowest instances
+// (see MeshBatch::SetViews)
+int instance_index() {
+    return gl_InstanceID / VIEWS;
+}
+#else
+int instance_index() {
+    return gl_InstanceID;
+}
+#endif
+
+// Index in models of the instance being drawn
+int instance_model_index() {
+    Draw draw = draws[draw_index()];
+    return instances[draw.first_instance + instance_index()];
+}
+
+// Model matrix of the instance being drawn
+mat4 instance_model() {
+    return model_matrix(instance_model_index());
+}
+
+#ifdef SKINNING
+// Vertices skinned by the pre-pass for each pose, as in skin_cs.glsl
+struct SkinnedVertex {
+    vec4 position;
+    vec4 normal;
+};
+
+layout (std430) readonly buffer SkinnedVerticesBlock {
+    SkinnedVertex skinned_vertices[];
+};
+
+// First skinned vertex of the pose of each model, -1 if it isn't skinned
+layout (std430) readonly buffer SkinOffsetsBlock {
+    int skin_offsets[];
+};
+#endif
+
+// Mesh position of the vertex drawn, from its attribute or, for a skinned
+// instance, from the vertices of its pose; gl_VertexID includes the base
+// vertex of the mesh in the arena, as the skinned vertices do
+vec4 vertex_position(vec4 position) {
+#ifdef SKINNING
+    int offset = skin_offsets[instance_model_index()];
+    if (offset >= 0)
+        return skinned_vertices[offset + gl_VertexID].position;
+#endif
+    return position;
+}
+
+// Mesh normal of the vertex drawn, as vertex_position()
+vec3 vertex_normal(vec3 normal) {
+#ifdef SKINNING
+    int offset = skin_offsets[instance_model_index()];
+    if (offset >= 0)
+        return skinned_vertices[offset + gl_VertexID].normal.xyz;
+#endif
+    return normal;
+}
+
+// Clip position of a world position; with several views, from the view of
+// the instance, into its viewport
+vec4 project_position(vec4 world_position) {
+#ifdef VIEWS
+    int v = gl_InstanceID % VIEWS;
+    gl_ViewportIndex = v;
+    return view_to_clip[v] * (view * world_position);
+#else
+    return view_projection * world_position;
+#endif
+}
+
+// World position of a vertex of the draw, from its position quantized to the
+// bounds of the mesh
+vec4 transform_position(mat4 model, vec4 position) {
+    vec4 dequantization = draws[draw_index()].dequantization;
+    vec3 mesh_position = vertex_position(position).xyz * dequantization.w +
+                         dequantization.xyz;
+    return model * vec4(mesh_position, 1.0);
+}
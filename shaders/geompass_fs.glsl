@@ -23,25 +23,105 @@
  */
 
 #version 450
+#ifdef BINDLESS_MAPS
+#extension GL_ARB_bindless_texture : require
+#endif
 
-// Vertex material
-uniform int material_id;
+// Materials information, as in lighting.glsl
+struct Material {
+    vec3 diffuse;
+    int diffuse_map;
+    vec3 ambient;
+    vec3 specular;
+    float shininess;
+};
+
+layout (std430) readonly buffer MaterialsBlock {
+    Material materials[];
+};
+
+#include "diffuse_maps.glsl"
+
+#ifdef VIRTUAL_TEXTURE
+// The maps are sparse and only partly resident (see VirtualTexture); the
+// early depth test keeps the hidden fragments out of the feedback
+layout(early_fragment_tests) in;
+
+// Finest resident level around each page of the first level of the maps
+uniform usampler2DArray page_levels;
+
+// Size of the pages in texels and number of levels split in pages
+uniform ivec2 page_size;
+uniform int n_sparse_levels;
+
+// Pixel of each FEEDBACK_STRIDE x FEEDBACK_STRIDE block that writes the
+// requests of this frame, negative for none
+uniform ivec2 feedback_pixel;
+
+// A bit for each page of the sparse levels of every layer, from the first
+// level of the first layer
+layout (std430) buffer PageRequestsBlock {
+    uint page_requests[];
+};
+
+// Samples a diffuse map at the finest level resident around the texel, and
+// requests the page of the level it would use in the feedback pixels
+vec3 sample_virtual_map(vec3 uvw, bool request) {
+    float lod = textureQueryLod(diffuse_maps, uvw.xy).x;
+    ivec2 pages = textureSize(diffuse_maps, 0).xy / page_size;
+    ivec2 page = min(ivec2(fract(uvw.xy) * pages), pages - 1);
+    uint min_level = texelFetch(page_levels, ivec3(page, uvw.z), 0).r;
+
+    ivec2 block_pixel = ivec2(gl_FragCoord.xy) % FEEDBACK_STRIDE;
+    int level = int(lod);
+    if (request && block_pixel == feedback_pixel && level < n_sparse_levels) {
+        int index = 0;
+        int layer_pages = 0;
+        for (int i = 0; i < n_sparse_levels; ++i) {
+            ivec2 level_pages = pages >> i;
+            ivec2 level_page = page >> i;
+            if (i == level)
+                index = layer_pages + level_page.y * level_pages.x +
+                        level_page.x;
+            layer_pages += level_pages.x * level_pages.y;
+        }
+        index += int(uvw.z) * layer_pages;
+        atomicOr(page_requests[index / 32], 1u << (index % 32));
+    }
+    return textureLod(diffuse_maps, uvw, max(lod, float(min_level))).rgb;
+}
+#endif
 
 // Input from vertex shader
 in vec3 frag_position;
 in vec3 frag_normal;
+in vec2 frag_textcoord;
+flat in int frag_material_id;
 
-// Geometry output
-layout(location = 0) out vec3 position;
-layout(location = 1) out vec3 normal;
-layout(location = 2) out vec3 material;
+#ifdef PICKING
+// Model and material of the fragment plus one, 0 being the background, after
+// the G-buffer outputs (see ObjectPicking)
+flat in int frag_model;
+layout(location = PICK_LOCATION) out uvec2 pick_id;
+#endif
 
-void main() {
-    position = frag_position;
-    normal = normalize(frag_normal);
+// The G-buffer outputs and write_gbuffer() are generated from the layout
+// (see GBufferLayout)
 
-    // If the material equals to 0, no geometry was rendered and the
-    // lightpass should render the background color
-    material.r = material_id + 1;
+void main() {
+    // Sampled outside of the branch, which isn't uniform, so the mipmap
+    // level has its derivatives
+    int layer = materials[frag_material_id].diffuse_map;
+    vec3 uvw = vec3(frag_textcoord, max(layer, 0));
+#ifdef VIRTUAL_TEXTURE
+    vec3 mapped = sample_virtual_map(uvw, layer >= 0);
+#else
+    vec3 mapped = sample_diffuse_map(layer, frag_textcoord).rgb;
+#endif
+    vec3 albedo = layer >= 0 ? mapped : vec3(1);
+    write_gbuffer(frag_position, normalize(frag_normal), frag_material_id,
+                  albedo);
+#ifdef PICKING
+    pick_id = uvec2(frag_model + 1, frag_material_id + 1);
+#endif
 }
-
@@ -23,31 +23,62 @@
  */
 
 #version 450
+#extension GL_ARB_shader_draw_parameters : require
 
-// Matrices information
-struct Matrices {
-    mat4 mvp;
-    mat4 modelview;
-    mat4 normalmatrix;
-};
+#include "geometry.glsl"
 
-layout (std140) uniform MatricesBlock {
-    Matrices matrices[100];
+#ifdef VERTEX_PULLING
+// Vertices of the meshes of the batch in the format of MeshBatch, fetched
+// without attributes: gl_VertexID already counts from the base vertex of the
+// draw in the arena
+layout (std430) readonly buffer PulledVerticesBlock {
+    uvec4 pulled_vertices[];
 };
-
-// Mesh input
+#else
+// Mesh input, the position quantized to the bounds of the mesh, with the
+// material of the vertex relative to the one of the draw in w
 layout(location = 0) in vec4 position;
 layout(location = 1) in vec4 normal;
+layout(location = 2) in vec2 texcoord;
+#endif
+
+// Same as in the depth pre-pass
+invariant gl_Position;
 
 // Vertex output
 out vec3 frag_position;
 out vec3 frag_normal;
 out vec2 frag_textcoord;
+flat out int frag_material_id;
+#ifdef PICKING
+flat out int frag_model;  // index in models, see ObjectPicking
+#endif
 
 void main() {
-    Matrices M = matrices[gl_InstanceID];
-    gl_Position = M.mvp * position;
-    frag_position = vec3(M.modelview * position);
-    frag_normal = normalize(vec3(M.normalmatrix * normal));
+#ifdef VERTEX_PULLING
+    // Decoded as the attributes would be: 4 snorm shorts, then
+    // GL_INT_2_10_10_10_REV and 2 halfs
+    uvec4 vertex = pulled_vertices[gl_VertexID];
+    vec4 position = vec4(unpackSnorm2x16(vertex.x), unpackSnorm2x16(vertex.y));
+    int packed_normal = int(vertex.z);
+    ivec3 quantized_normal = ivec3(bitfieldExtract(packed_normal, 0, 10),
+                                   bitfieldExtract(packed_normal, 10, 10),
+                                   bitfieldExtract(packed_normal, 20, 10));
+    vec4 normal = vec4(max(vec3(quantized_normal) / 511.0, vec3(-1)), 0);
+    vec2 texcoord = unpackHalf2x16(vertex.w);
+#endif
+    Draw draw = draws[draw_index()];
+    frag_material_id = draw.material_id + int(round(position.w * 32767.0));
+    mat4 model = instance_model();
+#ifdef PICKING
+    frag_model = instances[draw.first_instance + instance_index()];
+#endif
+    vec4 world_position = transform_position(model, position);
+    gl_Position = project_position(world_position);
+    frag_position = vec3(view * world_position);
+    frag_textcoord = texcoord;
+    // The instances are only rotated and translated, so the upper 3x3 of the
+    // modelview is already its own inverse transpose
+    frag_normal = normalize(mat3(view) * (mat3(model) *
+                                          vertex_normal(normal.xyz)));
 }
-
@@ -0,0 +1,42 @@
+/*
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Reads the diffuse light of the ground cached by GroundLightCache, at the
+// unit after the fog. It has no #version line: the lighting pass #includes
+// it after lighting.glsl.
+
+layout (binding = GBUFFER_TEXTURES + 4) uniform sampler2D ground_cache;
+
+// Transform from view space to world space
+uniform mat4 cache_view_to_world;
+
+// xz of the first corner of the ground, inverse of its size and height
+uniform vec4 cache_ground;
+
+// Obtains the cached light of a position of the ground in view space
+vec3 read_ground_light(vec3 position) {
+    vec3 world = vec3(cache_view_to_world * vec4(position, 1));
+    return texture(ground_cache, (world.xz - cache_ground.xy) *
+                   cache_ground.z).rgb;
+}
@@ -0,0 +1,113 @@
+/*
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#version 450
+
+// Diffuse light of the spot lights on the ground (see GroundLightCache).
+// Each work group takes a tile of the texture: its threads first keep the
+// active lights above the ground whose range reaches the tile, in shared
+// memory, then each shades a block of its texels with them, for an upward
+// normal and no material. GROUP_SIZE, TILE_SIZE, TILE_BUDGET and
+// MAX_TILE_LIGHTS are defined by the application.
+
+#include "lighting.glsl"
+
+layout (local_size_x = GROUP_SIZE, local_size_y = GROUP_SIZE) in;
+
+// Lights in world space, bound as buffer_bindings::WORLD_SPOT_LIGHTS
+layout (std430) readonly buffer WorldSpotLightsBlock {
+    SpotLight world_spot_lights[];
+};
+
+layout (rgba16f) uniform writeonly image2D cache_image;
+
+// Tile of each work group, in xy
+layout (location = 0) uniform vec4 cache_tiles[TILE_BUDGET];
+layout (location = TILE_BUDGET) uniform int n_cache_tiles;
+
+// xz of the first corner of the ground, world units per texel and height
+layout (location = TILE_BUDGET + 1) uniform vec4 ground;
+
+// Rotation of the lights from their world_spot_lights positions
+layout (location = TILE_BUDGET + 2) uniform mat4 light_rotation;
+
+// Lights kept, the first ones of world_spot_lights
+layout (location = TILE_BUDGET + 6) uniform int n_active_lights;
+
+const int GROUP_THREADS = GROUP_SIZE * GROUP_SIZE;
+const int BLOCK_SIZE = TILE_SIZE / GROUP_SIZE;
+
+shared SpotLight tile_lights[MAX_TILE_LIGHTS];
+shared uint n_tile_lights;
+
+void main() {
+    if (gl_WorkGroupID.x >= n_cache_tiles)
+        return;
+    ivec2 tile = ivec2(cache_tiles[gl_WorkGroupID.x].xy);
+    float texel_size = ground.z;
+    vec2 tile_min = ground.xy + vec2(tile * TILE_SIZE) * texel_size;
+    vec2 tile_max = tile_min + TILE_SIZE * texel_size;
+    if (gl_LocalInvocationIndex == 0)
+        n_tile_lights = 0;
+    barrier();
+
+    // Lights past MAX_TILE_LIGHTS are left out of the tile
+    for (int i = int(gl_LocalInvocationIndex); i < n_active_lights;
+         i += GROUP_THREADS) {
+        SpotLight L = world_spot_lights[i];
+        L.position = vec3(light_rotation * vec4(L.position, 1));
+        L.direction = mat3(light_rotation) * L.direction;
+        float height = L.position.y - ground.w;
+        vec2 outside = max(max(tile_min - L.position.xz,
+                               L.position.xz - tile_max), 0.0);
+        if (height <= 0 ||
+            dot(outside, outside) + height * height >= L.range * L.range)
+            continue;
+        uint slot = atomicAdd(n_tile_lights, 1u);
+        if (slot < uint(MAX_TILE_LIGHTS))
+            tile_lights[slot] = L;
+    }
+    barrier();
+
+    uint n_lights = min(n_tile_lights, uint(MAX_TILE_LIGHTS));
+    ivec2 first = tile * TILE_SIZE + ivec2(gl_LocalInvocationID.xy) *
+                  BLOCK_SIZE;
+    for (int y = 0; y < BLOCK_SIZE; ++y) {
+        for (int x = 0; x < BLOCK_SIZE; ++x) {
+            ivec2 texel = first + ivec2(x, y);
+            vec2 xz = ground.xy + (vec2(texel) + 0.5) * texel_size;
+            vec3 position = vec3(xz.x, ground.w, xz.y);
+            vec3 light = vec3(0);
+            for (uint i = 0; i < n_lights; ++i) {
+                SpotLight L = tile_lights[i];
+                vec3 light_dir;
+                float attenuation = compute_light_dir(L.position, L.range,
+                                                      position, light_dir);
+                light += L.diffuse * attenuation * compute_spot(L, light_dir) *
+                         max(light_dir.y, 0);
+            }
+            imageStore(cache_image, texel, vec4(light, 1));
+        }
+    }
+}
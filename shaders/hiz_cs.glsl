@@ -0,0 +1,77 @@
+/*
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#version 450
+
+// Writes a level of the depth pyramid, one texel per thread, with the
+// farthest depth of the texels it covers in the previous level, or of the
+// samples of its pixel in the depth buffer for the first one, or with
+// CLOSEST their nearest depth (see DepthPyramid)
+
+layout (local_size_x = GROUP_SIZE, local_size_y = GROUP_SIZE) in;
+
+layout (r32f) uniform writeonly image2D level_image;
+
+#if FROM_DEPTH
+#if MULTISAMPLED
+uniform sampler2DMS depth_texture;
+#else
+uniform sampler2D depth_texture;
+#endif
+#else
+layout (r32f) uniform readonly image2D previous_image;
+#endif
+
+#if CLOSEST
+#define REDUCE min
+const float NO_DEPTH = 1;
+#else
+#define REDUCE max
+const float NO_DEPTH = 0;
+#endif
+
+void main() {
+    ivec2 texel = ivec2(gl_GlobalInvocationID.xy);
+    ivec2 size = imageSize(level_image);
+    if (any(greaterThanEqual(texel, size)))
+        return;
+
+    float depth = NO_DEPTH;
+#if FROM_DEPTH
+    for (int s = 0; s < SAMPLES; ++s)
+        depth = REDUCE(depth, texelFetch(depth_texture, texel, s).r);
+#else
+    // With an odd size the last row and column of the previous level have
+    // no texel of their own, so the last texels also cover them
+    ivec2 previous_size = imageSize(previous_image);
+    ivec2 last = 2 * texel + 1 + ivec2(equal(texel, size - 1)) *
+                 (previous_size & 1);
+    last = min(last, previous_size - 1);
+    for (int y = 2 * texel.y; y <= last.y; ++y) {
+        for (int x = 2 * texel.x; x <= last.x; ++x)
+            depth = REDUCE(depth, imageLoad(previous_image, ivec2(x, y)).r);
+    }
+#endif
+    imageStore(level_image, texel, vec4(depth));
+}
@@ -0,0 +1,52 @@
+/*
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#version 450
+
+// Overlay of the performance statistics (see PerformanceHud), drawn with a
+// scissor around it: the texture holds the intensity of each pixel of the
+// text and the graph, scaled up by whole window pixels.
+
+// Intensities, with the first row at the top
+layout(binding = 0) uniform sampler2D hud_texture;
+
+// Window pixel of the top left corner of the overlay
+uniform ivec2 hud_origin;
+
+// Window pixels per overlay pixel
+uniform int hud_scale;
+
+// Color and opacity of the empty overlay pixels
+const vec4 BACKGROUND = vec4(0, 0, 0, 0.6);
+
+// Output color
+out vec4 color;
+
+void main() {
+    ivec2 coord = ivec2(gl_FragCoord.xy);
+    ivec2 texel = ivec2(coord.x - hud_origin.x, hud_origin.y - coord.y) /
+                  hud_scale;
+    float intensity = texelFetch(hud_texture, texel, 0).r;
+    color = mix(BACKGROUND, vec4(1), intensity);
+}
@@ -0,0 +1,57 @@
+/*
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Cells of the octahedral atlas of the impostors, shared by their baking and
+// drawing (see Impostors). It has no #version line, like geometry.glsl. The
+// atlas has IMPOSTOR_CELLS x IMPOSTOR_CELLS cells, each the orthographic view
+// of the mesh around its bounding sphere from a direction of the octahedral
+// mapping of the sphere of directions, in model space.
+
+// Direction from the center of the mesh towards the eye of a cell
+vec3 impostor_direction(ivec2 cell) {
+    vec2 e = (vec2(cell) + 0.5) / IMPOSTOR_CELLS * 2 - 1;
+    vec3 n = vec3(e, 1 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0);
+    n.xy += mix(vec2(t), vec2(-t), greaterThanEqual(n.xy, vec2(0)));
+    return normalize(n);
+}
+
+// Cell of the direction from the center of the mesh towards an eye
+ivec2 impostor_cell(vec3 direction) {
+    vec3 n = direction / (abs(direction.x) + abs(direction.y) +
+                          abs(direction.z));
+    bvec2 positive = greaterThanEqual(n.xy, vec2(0));
+    vec2 sign_not_zero = mix(vec2(-1), vec2(1), positive);
+    vec2 e = n.z >= 0 ? n.xy : (1 - abs(n.yx)) * sign_not_zero;
+    ivec2 cell = ivec2((e * 0.5 + 0.5) * IMPOSTOR_CELLS);
+    return clamp(cell, ivec2(0), ivec2(IMPOSTOR_CELLS - 1));
+}
+
+// Right, up and towards the eye axes of the view of a cell
+mat3 impostor_axes(ivec2 cell) {
+    vec3 direction = impostor_direction(cell);
+    vec3 up = abs(direction.y) < 0.99 ? vec3(0, 1, 0) : vec3(1, 0, 0);
+    vec3 right = normalize(cross(up, direction));
+    return mat3(right, cross(direction, right), direction);
+}
@@ -0,0 +1,65 @@
+/*
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#version 450
+#ifdef BINDLESS_MAPS
+#extension GL_ARB_bindless_texture : require
+#endif
+
+// Writes the albedo, the normal and the depth, and the material of the mesh
+// to a cell of the impostor atlas (see Impostors)
+
+// Materials information, as in lighting.glsl
+struct Material {
+    vec3 diffuse;
+    int diffuse_map;
+    vec3 ambient;
+    vec3 specular;
+    float shininess;
+};
+
+layout (std430) readonly buffer MaterialsBlock {
+    Material materials[];
+};
+
+#include "diffuse_maps.glsl"
+
+// Input from vertex shader
+in vec3 frag_normal;
+in vec2 frag_textcoord;
+in float frag_depth;
+flat in int frag_material_id;
+
+// The atlas; 0 is reserved for the texels with no mesh
+layout(location = 0) out vec4 out_albedo;
+layout(location = 1) out vec4 out_surface;
+layout(location = 2) out uint out_material;
+
+void main() {
+    int layer = materials[frag_material_id].diffuse_map;
+    vec3 mapped = sample_diffuse_map(layer, frag_textcoord).rgb;
+    out_albedo = vec4(layer >= 0 ? mapped : vec3(1), 1);
+    out_surface = vec4(normalize(frag_normal), frag_depth);
+    out_material = uint(frag_material_id + 1);
+}
@@ -0,0 +1,61 @@
+/*
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#version 450
+#extension GL_ARB_shader_draw_parameters : require
+
+#include "geometry.glsl"
+#include "impostor.glsl"
+
+// Bakes a cell of the impostor atlas (see Impostors): the mesh of the draw,
+// through DrawsBlock like the geometry pass, orthographically projected
+// along the direction of the cell over its bounding sphere
+
+// Mesh input, as in geompass_vs.glsl
+layout(location = 0) in vec4 position;
+layout(location = 1) in vec4 normal;
+layout(location = 2) in vec2 texcoord;
+
+// Bounding sphere of the mesh in model space
+uniform vec4 sphere;
+uniform ivec2 cell;
+
+// Vertex output, the normal in model space and the depth towards the eye of
+// the cell in sphere radii
+out vec3 frag_normal;
+out vec2 frag_textcoord;
+out float frag_depth;
+flat out int frag_material_id;
+
+void main() {
+    Draw draw = draws[draw_index()];
+    frag_material_id = draw.material_id + int(round(position.w * 32767.0));
+    vec3 mesh_position = transform_position(mat4(1), position).xyz;
+    vec3 local = transpose(impostor_axes(cell)) *
+                 ((mesh_position - sphere.xyz) / sphere.w);
+    gl_Position = vec4(local.xy, -local.z, 1);
+    frag_depth = local.z;
+    frag_normal = normal.xyz;
+    frag_textcoord = texcoord;
+}
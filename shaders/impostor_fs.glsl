@@ -0,0 +1,74 @@
+/*
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#version 450
+
+#include "impostor.glsl"
+
+// Writes the G-buffer from the cell of an impostor (see Impostors): each
+// fragment reads the texel of the atlas under it and moves back from the
+// quad to the baked depth, so the impostors intersect the geometry and each
+// other like the meshes
+
+// The atlas, read with texelFetch
+layout(binding = 1) uniform sampler2D impostor_albedo;
+layout(binding = 2) uniform sampler2D impostor_surface;
+layout(binding = 3) uniform usampler2D impostor_material;
+
+// Bounding sphere of the mesh in model space
+uniform vec4 sphere;
+
+// Camera matrices, as in geometry.glsl
+layout (std140) uniform CameraBlock {
+    mat4 view;
+    mat4 projection;
+    mat4 view_projection;
+};
+
+// Input from vertex shader
+in vec2 frag_quad;
+flat in ivec2 frag_cell;
+flat in mat3 frag_model_view;
+flat in vec3 frag_center;
+
+// The G-buffer outputs and write_gbuffer() are generated from the layout
+// (see GBufferLayout)
+
+void main() {
+    ivec2 cell_texel = ivec2((frag_quad * 0.5 + 0.5) * IMPOSTOR_CELL_SIZE);
+    ivec2 texel = frag_cell * IMPOSTOR_CELL_SIZE +
+                  min(cell_texel, IMPOSTOR_CELL_SIZE - 1);
+    uint material = texelFetch(impostor_material, texel, 0).r;
+    if (material == 0)
+        discard;
+    vec4 surface = texelFetch(impostor_surface, texel, 0);
+    vec3 albedo = texelFetch(impostor_albedo, texel, 0).rgb;
+    mat3 axes = frag_model_view * impostor_axes(frag_cell);
+    vec3 position = frag_center +
+                    sphere.w * (axes * vec3(frag_quad, surface.w));
+    vec4 clip = projection * vec4(position, 1);
+    gl_FragDepth = clip.z / clip.w * 0.5 + 0.5;
+    write_gbuffer(position, normalize(frag_model_view * surface.xyz),
+                  int(material) - 1, albedo);
+}
@@ -0,0 +1,63 @@
+/*
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#version 450
+#extension GL_ARB_shader_draw_parameters : require
+
+#include "geometry.glsl"
+#include "impostor.glsl"
+
+// Impostor of a distant instance (see Impostors): a quad made from
+// gl_VertexID with no attributes, on the plane of its bounding sphere that
+// faces the eye of the cell nearest to the direction of the camera, a
+// triangle strip of 4 vertices
+
+// Index in models of each impostor, written by the culling
+layout (std430) readonly buffer ImpostorInstancesBlock {
+    int impostor_instances[];
+};
+
+// Bounding sphere of the mesh in model space
+uniform vec4 sphere;
+
+// Vertex output, the position on the quad in sphere radii, and the rotation
+// of the instance and the center of its sphere in view space
+out vec2 frag_quad;
+flat out ivec2 frag_cell;
+flat out mat3 frag_model_view;
+flat out vec3 frag_center;
+
+void main() {
+    // The instances are only rotated and translated
+    mat4 model = model_matrix(impostor_instances[gl_InstanceID]);
+    mat3 model_view = mat3(view) * mat3(model);
+    vec3 center = vec3(view * model * vec4(sphere.xyz, 1));
+    frag_cell = impostor_cell(transpose(model_view) * -center);
+    frag_model_view = model_view;
+    frag_center = center;
+    frag_quad = vec2(gl_VertexID & 1, gl_VertexID >> 1) * 2 - 1;
+    mat3 axes = model_view * impostor_axes(frag_cell);
+    vec3 position = center + sphere.w * (axes * vec3(frag_quad, 1));
+    gl_Position = projection * vec4(position, 1);
+}
@@ -0,0 +1,60 @@
+/*
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Bounding volume hierarchy of the point lights, rebuilt every frame on the
+// gpu (see LightBvh). It has no #version line: bvh_cs.glsl, which builds it,
+// and the shaders that query it #include it. The n - 1 internal nodes come
+// first, the root at 0, and leaf k of the lights sorted by their Morton codes
+// is node n - 1 + k; a single light is a leaf at the root. The bounds of a
+// leaf cover the sphere of its light.
+
+struct BvhNode {
+    vec3 bounds_min;
+    int left;  // the light of a leaf
+    vec3 bounds_max;
+    int right;  // -1 in a leaf
+};
+
+#ifdef BVH_BUILD
+layout (std430) coherent buffer BvhNodesBlock {
+#else
+layout (std430) readonly buffer BvhNodesBlock {
+#endif
+    BvhNode bvh_nodes[];
+};
+
+// Longest path from the root that the queries follow; Morton codes of 30
+// bits and the indices that split equal codes keep the trees shallower
+#define BVH_STACK_SIZE 64
+
+// Checks if a node of a tree of n lights is a leaf
+bool bvh_is_leaf(int node, int n) {
+    return node >= n - 1;
+}
+
+// Checks if a sphere touches the bounds of a node
+bool bvh_node_touches(BvhNode node, vec3 center, float radius) {
+    vec3 v = center - clamp(center, node.bounds_min, node.bounds_max);
+    return dot(v, v) <= radius * radius;
+}
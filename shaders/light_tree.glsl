@@ -0,0 +1,206 @@
+/*
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Stochastic sampling of the spot lights from a light tree (see LightTree),
+// or with LIGHT_CUTS their shading from a cut of the tree per pixel. It has
+// no #version line: the shaders #include it after lighting.glsl.
+
+// Bounds of the light positions, summed intensity and largest range of the
+// lights of each node; the children of the inner nodes, or -1 - the index in
+// tree_lights of the light of a leaf in left, and the index of the light
+// that stands for the node. The root is the first node.
+struct LightNode {
+    vec3 bounds_min;
+    float intensity;
+    vec3 bounds_max;
+    float range;
+    int left;
+    int right;
+    int representative;
+};
+
+layout (std430) readonly buffer LightNodesBlock {
+    LightNode light_nodes[];
+};
+
+// The spot lights in the space of the tree, in the order of the leaves
+layout (std430) readonly buffer TreeLightsBlock {
+    SpotLight tree_lights[];
+};
+
+// Transforms between the space of the tree and view space
+uniform mat4 tree_to_view;
+uniform mat4 view_to_tree;
+
+uniform int n_tree_nodes;
+
+// Walks through the tree per pixel, and seed of the frame
+uniform int light_samples;
+uniform int light_seed;
+
+#ifdef LIGHT_CUTS
+// Fraction of the estimate of a pixel up to which the error bound of each
+// node of its cut may go
+uniform float light_cut_error;
+
+// Most nodes of a cut, the ones left to refine are kept as they are
+#define MAX_CUT_SIZE 32
+#endif
+
+// Hashes an integer, as the PCG generator
+uint hash_pcg(uint v) {
+    uint state = v * 747796405u + 2891336453u;
+    uint word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+    return (word >> 22u) ^ word;
+}
+
+// Obtains a uniform number in [0, 1) and advances the state
+float next_random(inout uint state) {
+    state = hash_pcg(state);
+    return float(state >> 8) / 16777216.0;
+}
+
+// Upper bound of the light of a node at a position in the space of the tree:
+// its intensity, attenuated from the nearest point of its bounds as by the
+// largest range
+float light_node_importance(LightNode node, vec3 position) {
+    vec3 nearest = clamp(position, node.bounds_min, node.bounds_max);
+    return node.intensity *
+           compute_attenuation(node.range, distance(position, nearest));
+}
+
+// Picks a light for a position in the space of the tree, walking down from
+// the root to the child of more importance more often
+// Returns the index in tree_lights, or -1 if no light reaches the position,
+// and the probability of the pick
+int sample_light_tree(vec3 position, inout uint state, out float pdf) {
+    pdf = 1;
+    int node = 0;
+    if (light_node_importance(light_nodes[0], position) == 0)
+        return -1;
+    while (light_nodes[node].left >= 0) {
+        LightNode node_data = light_nodes[node];
+        float left = light_node_importance(light_nodes[node_data.left],
+                                           position);
+        float right = light_node_importance(light_nodes[node_data.right],
+                                            position);
+        // The bounds of the node may reach the position beyond its children
+        if (left + right == 0)
+            return -1;
+        float p_left = left / (left + right);
+        if (next_random(state) < p_left) {
+            node = node_data.left;
+            pdf *= p_left;
+        } else {
+            node = node_data.right;
+            pdf *= 1 - p_left;
+        }
+    }
+    return -1 - light_nodes[node].left;
+}
+
+// Estimates the shading of every spot light at a view-space position from
+// light_samples lights picked for the pixel
+vec3 shade_light_tree(Material M, vec3 normal, vec3 position, ivec2 pixel) {
+    if (n_tree_nodes == 0)
+        return vec3(0);
+    uint state = hash_pcg(uint(pixel.x) + (uint(pixel.y) << 16)) ^
+                 hash_pcg(uint(light_seed));
+    vec3 tree_position = vec3(view_to_tree * vec4(position, 1));
+    vec3 acc_color = vec3(0);
+    for (int i = 0; i < light_samples; ++i) {
+        float pdf;
+        int light = sample_light_tree(tree_position, state, pdf);
+        if (light < 0)
+            break;
+        SpotLight L = tree_lights[light];
+        L.position = vec3(tree_to_view * vec4(L.position, 1));
+        L.direction = mat3(tree_to_view) * L.direction;
+        acc_color += compute_spot_shading(L, M, normal, position) / pdf;
+    }
+    return acc_color / light_samples;
+}
+
+#ifdef LIGHT_CUTS
+// Intensity of a light, as in LightTree, the luminance plus the specular
+float light_intensity(vec3 diffuse, float specular) {
+    return dot(diffuse, vec3(0.2126, 0.7152, 0.0722)) + specular;
+}
+
+// Shades the representative light of a node as all the lights of the node,
+// the light itself in a leaf
+vec3 shade_light_node(LightNode node, Material M, vec3 normal,
+                      vec3 position) {
+    SpotLight L = tree_lights[node.representative];
+    L.position = vec3(tree_to_view * vec4(L.position, 1));
+    L.direction = mat3(tree_to_view) * L.direction;
+    float scale = node.intensity / light_intensity(L.diffuse, L.specular);
+    L.diffuse *= scale;
+    L.specular *= scale;
+    return compute_spot_shading(L, M, normal, position);
+}
+
+// Shades every spot light at a view-space position from a cut of the tree:
+// starting from the root, the node of the cut with the largest error bound
+// is replaced by its children while that bound is more than light_cut_error
+// of the estimate of the cut. A leaf is exact, so its bound is zero.
+vec3 shade_light_cut(Material M, vec3 normal, vec3 position) {
+    if (n_tree_nodes == 0)
+        return vec3(0);
+    vec3 tree_position = vec3(view_to_tree * vec4(position, 1));
+    int cut[MAX_CUT_SIZE];
+    float bounds[MAX_CUT_SIZE];
+    vec3 colors[MAX_CUT_SIZE];
+    cut[0] = 0;
+    bounds[0] = light_nodes[0].left >= 0
+              ? light_node_importance(light_nodes[0], tree_position) : 0;
+    colors[0] = shade_light_node(light_nodes[0], M, normal, position);
+    vec3 acc_color = colors[0];
+    int size = 1;
+    while (size < MAX_CUT_SIZE) {
+        int worst = 0;
+        for (int i = 1; i < size; ++i) {
+            if (bounds[i] > bounds[worst])
+                worst = i;
+        }
+        float estimate = light_intensity(acc_color, 0);
+        if (bounds[worst] == 0 || bounds[worst] <= light_cut_error * estimate)
+            break;
+        LightNode node = light_nodes[cut[worst]];
+        acc_color -= colors[worst];
+        int children[2] = int[2](node.left, node.right);
+        int slots[2] = int[2](worst, size++);
+        for (int c = 0; c < 2; ++c) {
+            LightNode child = light_nodes[children[c]];
+            int slot = slots[c];
+            cut[slot] = children[c];
+            bounds[slot] = child.left >= 0
+                         ? light_node_importance(child, tree_position) : 0;
+            colors[slot] = shade_light_node(child, M, normal, position);
+            acc_color += colors[slot];
+        }
+    }
+    return acc_color;
+}
+#endif
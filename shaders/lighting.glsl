@@ -0,0 +1,273 @@
+/*
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Lights, materials and shading functions shared by the lighting shaders.
+// It has no #version line: the shaders #include it after theirs.
+
+// Lights information, as compact records: the specular intensity is gray
+// and the cone of a spot light is its cutoff cosine and exponent, packed as
+// two halfs. Each kind of light has its own array, so every loop applies one
+// kind of light without branching on it.
+struct PointLight {
+    vec3 position;
+    float range;
+    vec3 diffuse;
+    float specular;
+};
+
+struct SpotLight {
+    vec3 position;
+    float range;
+    vec3 diffuse;
+    float specular;
+    vec3 direction;
+    uint cone;
+};
+
+// Shadow of a spot light: the transform from view space to the clip space
+// of its map and the offset and size of its tile in the atlas texture, of
+// size zero without a shadow (see ShadowAtlas)
+struct SpotShadow {
+    mat4 view_to_light;
+    vec4 tile;
+};
+
+layout (std430) buffer LightsBlock {
+    vec3 global_ambient;
+    int n_point_lights;
+    PointLight point_lights[];
+};
+
+// SPIR-V may have no block names to bind by, so its binding point is set
+// here, as buffer_bindings::SPOT_LIGHTS
+#ifdef GL_SPIRV
+layout (std430, binding = 4) buffer SpotLightsBlock {
+#else
+layout (std430) buffer SpotLightsBlock {
+#endif
+    int n_spot_lights;
+    SpotLight spot_lights[];
+};
+
+// Materials information, the diffuse map is a layer of the diffuse maps of
+// the geometry pass (-1 for none)
+struct Material {
+    vec3 diffuse;
+    int diffuse_map;
+    vec3 ambient;
+    vec3 specular;
+    float shininess;
+};
+
+layout (std430) readonly buffer MaterialsBlock {
+    Material materials[];
+};
+
+// Material of a G-buffer sample, tinted by the albedo of its diffuse map
+Material get_material(int material, vec3 albedo) {
+    Material M = materials[material];
+    M.diffuse *= albedo;
+    M.ambient *= albedo;
+    return M;
+}
+
+// Background color (also BACKGROUND_COLOR in main.cpp)
+const vec3 background = vec3(0.1, 0.1, 0.1);
+
+// x^n for x in [0, 1]; FAST_LIGHTING replaces the log2 and exp2 of pow by
+// a spherical gaussian fit with a single exp2 (also FastPow in
+// FastLighting.cpp)
+float fast_pow(float x, float n) {
+#ifdef FAST_LIGHTING
+    return x * exp2((n - 1) * 1.442695 * (x - 1));
+#else
+    return pow(x, n);
+#endif
+}
+
+vec3 compute_diffuse(vec3 diffuse, Material M, vec3 normal, vec3 light_dir) {
+    return M.diffuse * diffuse * max(dot(normal, light_dir), 0);
+}
+
+vec3 compute_specular(float specular, Material M, vec3 normal, vec3 light_dir,
+                      vec3 half_vector) {
+    if (dot(normal, light_dir) > 0) {
+        float shininess = M.shininess;
+        return M.specular * specular *
+               fast_pow(max(dot(normal, half_vector), 0), shininess);
+    } else {
+        return vec3(0, 0, 0);
+    }
+}
+
+float compute_spot(SpotLight L, vec3 light_dir) {
+    vec2 cone = unpackHalf2x16(L.cone);
+    float kspot = max(dot(-light_dir, L.direction), 0);
+    return kspot > cone.x ? fast_pow(kspot, cone.y) : 0;
+}
+
+// Smooth window that reaches zero at the range of the light
+float compute_attenuation(float range, float distance) {
+    float x = distance / range;
+    float window = clamp(1 - x * x * x * x, 0, 1);
+    return window * window;
+}
+
+// Attenuation of a light at the position and the direction to it; with
+// FAST_LIGHTING a single inverse square root gives the direction and the
+// window only needs the squared distance
+float compute_light_dir(vec3 light_position, float range, vec3 position,
+                        out vec3 light_dir) {
+#ifdef FAST_LIGHTING
+    vec3 v = light_position - position;
+    float d2 = dot(v, v);
+    float x2 = d2 / (range * range);
+    float window = clamp(1 - x2 * x2, 0, 1);
+    light_dir = v * inversesqrt(d2);
+    return window * window;
+#else
+    light_dir = normalize(light_position - position);
+    return compute_attenuation(range, distance(light_position, position));
+#endif
+}
+
+// Light reflected by the shading functions: the color, or with LIGHT_PREPASS
+// the diffuse light in rgb and the specular intensity in alpha, which the
+// material pass multiplies by the material (see materialpass_fs.glsl)
+#ifdef LIGHT_PREPASS
+#define Shading vec4
+#else
+#define Shading vec3
+#endif
+
+// Diffuse and specular terms of a light that comes from a direction; with
+// HALF_PRECISION the colors and the directions are 16-bit floats, while the
+// position, the distances and the pow stay in 32 bits, as their range and the
+// exponent of the shininess don't fit
+#if defined(HALF_PRECISION_AMD)
+#define HALF_PRECISION
+#endif
+
+Shading compute_reflection(vec3 diffuse, float specular, Material M,
+                           vec3 normal, vec3 position, vec3 light_dir) {
+    // The lights without specular, such as the small ones on the screen (see
+    // lights_cs.glsl), skip the half vector and the pow; every pixel shades a
+    // light the same way, so the lights of a tile branch uniformly
+    if (specular == 0) {
+        float n_dot_l = max(dot(normal, light_dir), 0);
+#ifdef LIGHT_PREPASS
+        return vec4(diffuse * n_dot_l, 0);
+#else
+        return M.diffuse * diffuse * n_dot_l;
+#endif
+    }
+#if defined(LIGHT_PREPASS)
+    float n_dot_l = dot(normal, light_dir);
+    if (n_dot_l <= 0)
+        return vec4(0, 0, 0, 0);
+    vec3 half_vector = normalize(light_dir + normalize(-position));
+    float n_dot_h = max(dot(normal, half_vector), 0);
+    return vec4(diffuse * n_dot_l,
+                specular * fast_pow(n_dot_h, M.shininess));
+#elif defined(HALF_PRECISION)
+    f16vec3 n = f16vec3(normal);
+    f16vec3 l = f16vec3(light_dir);
+    f16vec3 h = normalize(l + f16vec3(normalize(-position)));
+    float16_t n_dot_l = dot(n, l);
+    if (n_dot_l <= float16_t(0))
+        return vec3(0, 0, 0);
+    f16vec3 color = f16vec3(M.diffuse) * f16vec3(diffuse) * n_dot_l;
+    float16_t n_dot_h = max(dot(n, h), float16_t(0));
+    color += f16vec3(M.specular) *
+             float16_t(specular * fast_pow(float(n_dot_h), M.shininess));
+    return vec3(color);
+#else
+    vec3 eye_dir = normalize(-position);
+    vec3 half_vector = normalize(light_dir + eye_dir);
+    return compute_diffuse(diffuse, M, normal, light_dir) +
+           compute_specular(specular, M, normal, light_dir, half_vector);
+#endif
+}
+
+Shading compute_point_shading(PointLight L, Material M, vec3 normal,
+                              vec3 position) {
+    vec3 light_dir;
+    float attenuation = compute_light_dir(L.position, L.range, position,
+                                          light_dir);
+    if (attenuation == 0)
+        return Shading(0);
+    return attenuation * compute_reflection(L.diffuse, L.specular, M, normal,
+                                            position, light_dir);
+}
+
+Shading compute_spot_shading(SpotLight L, Material M, vec3 normal,
+                             vec3 position) {
+    vec3 light_dir;
+    float attenuation = compute_light_dir(L.position, L.range, position,
+                                          light_dir);
+    if (attenuation == 0)
+        return Shading(0);
+    float spot_intensity = compute_spot(L, light_dir);
+    return attenuation * spot_intensity *
+           compute_reflection(L.diffuse, L.specular, M, normal, position,
+                              light_dir);
+}
+
+vec3 compute_ambient(Material M) {
+    return M.ambient * global_ambient;
+}
+
+// Shininess from which a material reflects its surroundings, fully from
+// MIRROR_SHININESS (see ScreenReflections)
+const float GLOSSY_SHININESS = 8.0;
+const float MIRROR_SHININESS = 16.0;
+
+// Part of the light coming from the mirror direction that a material sends
+// to the eye: its specular color raised to white at grazing angles (Schlick),
+// none if it isn't glossy
+vec3 compute_reflectance(Material M, float n_dot_v) {
+    float gloss = clamp((M.shininess - GLOSSY_SHININESS) /
+                        (MIRROR_SHININESS - GLOSSY_SHININESS), 0, 1);
+    float fresnel = pow(1 - clamp(n_dot_v, 0, 1), 5);
+    return gloss * mix(M.specular, vec3(1), fresnel);
+}
+
+// Returns true if the sphere touches the light, up to its range
+bool sphere_touches_point_light(PointLight L, vec3 center, float radius) {
+    vec3 v = center - L.position;
+    return dot(v, v) <= (radius + L.range) * (radius + L.range);
+}
+
+// Returns true if the sphere touches the light cone, up to its range
+bool sphere_touches_spot_light(SpotLight L, vec3 center, float radius) {
+    vec3 v = center - L.position;
+    if (dot(v, v) > (radius + L.range) * (radius + L.range))
+        return false;
+    float axial = dot(v, L.direction);
+    float lateral = sqrt(max(dot(v, v) - axial * axial, 0));
+    float cos_angle = unpackHalf2x16(L.cone).x;
+    float sin_angle = sqrt(1 - cos_angle * cos_angle);
+    float gap = cos_angle * lateral - sin_angle * axial;
+    return gap <= radius && axial >= -radius;
+}
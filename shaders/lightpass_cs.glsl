@@ -0,0 +1,270 @@
+/*
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#version 450
+
+// Compute lighting: every work group shades a TILE_SIZE x TILE_SIZE tile and
+// stores it in the lit image. By default it's the tiled lighting, with only
+// the lights whose cone touches the depth range of the tile. With CLUSTERED
+// each pixel applies the lights of its cluster instead (see clusters.glsl),
+// and with ALL_LIGHTS every light, the point lights read a group at a time
+// into shared memory. The tiles with only background skip the shading.
+// The G-buffer samplers and read_gbuffer() are generated from the layout (see
+// GBufferLayout), the shading functions come from lighting.glsl and
+// TILE_SIZE and LIT_FORMAT are defined by the application. With
+// AMBIENT_OCCLUSION the ambient term is occluded (see ambient_occlusion.glsl),
+// and with SPOT_SHADOWS the spot lights are shadowed (see spot_shading.glsl).
+// With SUBGROUPS each subgroup reduces its distances and appends its lights
+// with one shared atomic instead of one per thread. With HALF_PRECISION_AMD
+// the reflection of each light is computed in 16-bit floats (see
+// lighting.glsl). With SUN_LIGHT the sun is also applied (see
+// sun_shading.glsl).
+
+#ifdef SUBGROUPS
+#extension GL_KHR_shader_subgroup_ballot : require
+#extension GL_KHR_shader_subgroup_arithmetic : require
+#endif
+#if defined(HALF_PRECISION_AMD)
+#extension GL_AMD_gpu_shader_half_float : require
+#endif
+
+#include "lighting.glsl"
+#ifdef RAY_TRACED_SHADOWS
+#include "shadow_bvh.glsl"
+#endif
+#include "spot_shading.glsl"
+#ifdef SUN_LIGHT
+#include "sun_shading.glsl"
+#endif
+#ifdef CLUSTERED
+#include "clusters.glsl"
+#endif
+#ifdef AMBIENT_OCCLUSION
+#include "ambient_occlusion.glsl"
+#endif
+
+layout (local_size_x = TILE_SIZE, local_size_y = TILE_SIZE) in;
+
+// Shaded image
+layout (LIT_FORMAT) uniform writeonly image2D lit_image;
+
+// Distance range of the tile, as the bits of positive floats so atomics can
+// compare them
+shared uint tile_min_distance;
+shared uint tile_max_distance;
+
+#if !defined(CLUSTERED) && !defined(ALL_LIGHTS)
+#define TILE_LISTS
+
+// Maximum number of lights of each kind per tile, the others are dropped
+#define MAX_TILE_LIGHTS 1024
+
+// Lights that touch the tile
+shared uint tile_n_point_lights;
+shared uint tile_point_lights[MAX_TILE_LIGHTS];
+shared uint tile_n_spot_lights;
+shared uint tile_spot_lights[MAX_TILE_LIGHTS];
+#endif
+
+#ifdef ALL_LIGHTS
+// Point lights read by the group, one per thread
+shared PointLight cached_point_lights[TILE_SIZE * TILE_SIZE];
+#endif
+
+// Obtains the view-space point of a pixel corner at a distance from the eye
+vec3 tile_corner(vec2 pixel, float eye_distance) {
+    vec2 ndc = pixel / gbuffer_size * 2 - 1;
+    vec4 ray = inv_projection * vec4(ndc, 1, 1);
+    vec3 point = ray.xyz / ray.w;
+    return point * (eye_distance / -point.z);
+}
+
+void main() {
+    ivec2 coord = ivec2(gl_GlobalInvocationID.xy);
+    if (gl_LocalInvocationIndex == 0) {
+        tile_min_distance = 0xFFFFFFFFu;
+        tile_max_distance = 0u;
+#ifdef TILE_LISTS
+        tile_n_point_lights = 0u;
+        tile_n_spot_lights = 0u;
+#endif
+    }
+    barrier();
+
+    vec3 position, normal;
+    int material;
+    bool inside = all(lessThan(coord, ivec2(gbuffer_size)));
+    bool valid = inside && read_gbuffer(coord, 0, position, normal, material);
+#ifdef SUBGROUPS
+    uint distance_bits = floatBitsToUint(-position.z);
+    uint min_bits = subgroupMin(valid ? distance_bits : 0xFFFFFFFFu);
+    uint max_bits = subgroupMax(valid ? distance_bits : 0u);
+    if (subgroupElect()) {
+        atomicMin(tile_min_distance, min_bits);
+        atomicMax(tile_max_distance, max_bits);
+    }
+#else
+    if (valid) {
+        atomicMin(tile_min_distance, floatBitsToUint(-position.z));
+        atomicMax(tile_max_distance, floatBitsToUint(-position.z));
+    }
+#endif
+    barrier();
+
+    // Same for the whole group, so its threads all leave
+    if (tile_max_distance == 0u) {
+        if (inside)
+            imageStore(lit_image, coord, vec4(background, 1));
+        return;
+    }
+
+#ifdef TILE_LISTS
+    // Bounding sphere of the tile frustum between its distances
+    {
+        float near = uintBitsToFloat(tile_min_distance);
+        float far = uintBitsToFloat(tile_max_distance);
+        vec2 origin = vec2(gl_WorkGroupID.xy * TILE_SIZE);
+        vec3 corners[8];
+        for (int i = 0; i < 4; ++i) {
+            vec2 pixel = origin + vec2(i & 1, i >> 1) * TILE_SIZE;
+            corners[i] = tile_corner(pixel, near);
+            corners[i + 4] = tile_corner(pixel, far);
+        }
+        vec3 center = vec3(0, 0, 0);
+        for (int i = 0; i < 8; ++i)
+            center += corners[i] / 8;
+        float radius = 0;
+        for (int i = 0; i < 8; ++i)
+            radius = max(radius, distance(center, corners[i]));
+
+        uint n_threads = gl_WorkGroupSize.x * gl_WorkGroupSize.y;
+        uint n = uint(n_point_lights);
+        for (uint i = gl_LocalInvocationIndex; i < n; i += n_threads) {
+            bool touches =
+                sphere_touches_point_light(point_lights[i], center, radius);
+#ifdef SUBGROUPS
+            uvec4 ballot = subgroupBallot(touches);
+            uint count = subgroupBallotBitCount(ballot);
+            uint first = 0u;
+            if (count > 0u && subgroupElect())
+                first = atomicAdd(tile_n_point_lights, count);
+            uint slot = subgroupBroadcastFirst(first) +
+                        subgroupBallotExclusiveBitCount(ballot);
+            if (!touches)
+                continue;
+#else
+            if (!touches)
+                continue;
+            uint slot = atomicAdd(tile_n_point_lights, 1u);
+#endif
+            if (slot < MAX_TILE_LIGHTS)
+                tile_point_lights[slot] = i;
+        }
+        n = uint(n_spot_lights);
+        for (uint i = gl_LocalInvocationIndex; i < n; i += n_threads) {
+            bool touches =
+                sphere_touches_spot_light(spot_lights[i], center, radius);
+#ifdef SUBGROUPS
+            uvec4 ballot = subgroupBallot(touches);
+            uint count = subgroupBallotBitCount(ballot);
+            uint first = 0u;
+            if (count > 0u && subgroupElect())
+                first = atomicAdd(tile_n_spot_lights, count);
+            uint slot = subgroupBroadcastFirst(first) +
+                        subgroupBallotExclusiveBitCount(ballot);
+            if (!touches)
+                continue;
+#else
+            if (!touches)
+                continue;
+            uint slot = atomicAdd(tile_n_spot_lights, 1u);
+#endif
+            if (slot < MAX_TILE_LIGHTS)
+                tile_spot_lights[slot] = i;
+        }
+    }
+    barrier();
+#endif
+
+    vec3 color = background;
+    Material M;
+    if (valid) {
+        M = get_material(material, read_albedo(coord, 0));
+        color = compute_ambient(M);
+#ifdef AMBIENT_OCCLUSION
+        color *= read_occlusion(coord, -position.z);
+#endif
+    }
+#if defined(ALL_LIGHTS)
+    // Every thread takes part in the reads, even the ones with no pixel
+    uint n_threads = gl_WorkGroupSize.x * gl_WorkGroupSize.y;
+    uint n = uint(n_point_lights);
+    for (uint first = 0u; first < n; first += n_threads) {
+        uint i = first + gl_LocalInvocationIndex;
+        if (i < n)
+            cached_point_lights[gl_LocalInvocationIndex] = point_lights[i];
+        barrier();
+        uint n_cached = min(n_threads, n - first);
+        for (uint j = 0u; valid && j < n_cached; ++j)
+            color += compute_point_shading(cached_point_lights[j], M, normal,
+                                           position);
+        barrier();
+    }
+    for (int i = 0; valid && i < n_spot_lights; ++i)
+        color += shade_spot_light(uint(i), M, normal, position);
+#elif defined(CLUSTERED)
+    if (valid) {
+        int cluster = find_cluster(vec2(coord) + 0.5, -position.z);
+        uvec4 range = cluster_ranges[cluster];
+        uint first_spot = range.x + range.y;
+        for (uint i = range.x; i < first_spot; ++i) {
+            PointLight L = point_lights[cluster_lights[i]];
+            color += compute_point_shading(L, M, normal, position);
+        }
+        for (uint i = first_spot; i < first_spot + range.z; ++i)
+            color += shade_spot_light(cluster_lights[i], M, normal, position);
+#ifdef CLUSTER_LIGHT_BUDGET
+        color += shade_cluster_ambient(cluster, M);
+#endif
+    }
+#else
+    if (valid) {
+        uint n = min(tile_n_point_lights, uint(MAX_TILE_LIGHTS));
+        for (uint i = 0u; i < n; ++i) {
+            PointLight L = point_lights[tile_point_lights[i]];
+            color += compute_point_shading(L, M, normal, position);
+        }
+        n = min(tile_n_spot_lights, uint(MAX_TILE_LIGHTS));
+        for (uint i = 0u; i < n; ++i)
+            color += shade_spot_light(tile_spot_lights[i], M, normal,
+                                      position);
+    }
+#endif
+#ifdef SUN_LIGHT
+    if (valid)
+        color += shade_sun(M, normal, position);
+#endif
+    if (inside)
+        imageStore(lit_image, coord, vec4(color, 1));
+}
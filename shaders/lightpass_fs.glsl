@@ -24,108 +24,200 @@
 
 #version 450
 
-// Geometry pass inputs
-uniform sampler2D position_sampler;
-uniform sampler2D normal_sampler;
-uniform sampler2D material_sampler;
-
-// Lights information
-struct Light {
-    vec4 position;
-    vec3 diffuse;
-    vec3 specular;
-    bool is_spot;
-    vec3 spot_direction;
-    float spot_cutoff;
-    float spot_exponent;
-};
-
-layout (std140) uniform LightsBlock {
-    vec3 global_ambient;
-    int n_lights;
-    Light lights[100];
-};
-
-// Materials information
-struct Material {
-    vec3 diffuse;
-    vec3 ambient;
-    vec3 specular;
-    float shininess;
-};
-
-layout (std140) uniform MaterialsBlock {
-    Material materials[8];
-};
-
-// Background color
-const vec3 background = vec3(0.1, 0.1, 0.1);
-
-// Screen texture coordinates
-in vec2 frag_textcoord;
-
-// Output color
+// The G-buffer samplers and read_gbuffer() are generated from the layout
+// (see GBufferLayout) and the shading functions come from lighting.glsl. With
+// CLUSTERED defined only the lights of the cluster are applied (see
+// clusters.glsl), and with SPOT_VOLUMES only the point lights, as the spot
+// lights are drawn as volumes. With SCALED the output is smaller than the
+// G-buffer and each pixel shades one G-buffer pixel (see upsample_fs.glsl).
+// With AMBIENT_OCCLUSION the ambient term is occluded (see
+// ambient_occlusion.glsl), and with SPOT_SHADOWS the spot lights are
+// shadowed (see spot_shading.glsl). With LIGHT_TREE the spot lights are
+// estimated from a few lights sampled per pixel, or with LIGHT_CUTS as well
+// shaded from a cut of the tree (see light_tree.glsl). With DEBUG_NORMALS
+// the view-space normals are shown instead of the lighting, and with
+// DEBUG_LIGHT_COUNT a heatmap of the number of lights evaluated per pixel.
+// With GBUFFER_FETCH the pass renders into the G-buffer, which it reads back
+// with framebuffer fetch, and the color goes after the G-buffer outputs.
+// With HALF_PRECISION_AMD the reflection of each light is computed in 16-bit
+// floats (see lighting.glsl). With LIGHT_PREPASS only the light reaching
+// each pixel is accumulated, without the colors of its material, which the
+// material pass applies (see materialpass_fs.glsl).
+// With SUN_LIGHT the sun is also applied (see sun_shading.glsl). With FOG
+// every pixel, the background too, is seen through the fog (see fog.glsl).
+// With GROUND_CACHE the ground takes its diffuse light from a texture
+// instead of the lights, and has no specular (see ground_cache.glsl).
+
+#if defined(HALF_PRECISION_AMD)
+#extension GL_AMD_gpu_shader_half_float : require
+#endif
+
+#include "lighting.glsl"
+#ifdef RAY_TRACED_SHADOWS
+#include "shadow_bvh.glsl"
+#endif
+#include "spot_shading.glsl"
+#ifdef SUN_LIGHT
+#include "sun_shading.glsl"
+#endif
+#ifdef CLUSTERED
+#include "clusters.glsl"
+#endif
+#ifdef LIGHT_TREE
+#include "light_tree.glsl"
+#endif
+#ifdef AMBIENT_OCCLUSION
+#include "ambient_occlusion.glsl"
+#endif
+#ifdef FOG
+#include "fog.glsl"
+#endif
+#ifdef GROUND_CACHE
+#include "ground_cache.glsl"
+#endif
+#ifdef DEBUG_LIGHT_COUNT
+#include "heatmap.glsl"
+#endif
+
+#ifdef SCALED
+// G-buffer pixels per output pixel
+uniform vec2 lit_pixel_size;
+#endif
+
+// Output color, or light with LIGHT_PREPASS
+#if defined(GBUFFER_FETCH)
+layout(location = GBUFFER_LIT_LOCATION) out vec3 color;
+#elif defined(LIGHT_PREPASS)
+out vec4 color;
+#else
 out vec3 color;
-
-vec3 compute_diffuse(Light L, Material M, vec3 normal, vec3 light_dir) {
-    vec3 diffuse = M.diffuse * L.diffuse;
-    return diffuse * max(dot(normal, light_dir), 0);
+#endif
+
+// Obtains the center of the G-buffer pixel shaded by this fragment
+vec2 gbuffer_pixel() {
+#ifdef SCALED
+    return floor(gl_FragCoord.xy * lit_pixel_size) + 0.5;
+#else
+    return gl_FragCoord.xy;
+#endif
 }
 
-vec3 compute_specular(Light L, Material M, vec3 normal, vec3 light_dir,
-                      vec3 half_vector) {
-    if (dot(normal, light_dir) > 0) {
-        vec3 specular = M.specular * L.specular;
-        float shininess = M.shininess;
-        return specular * pow(max(dot(normal, half_vector), 0), shininess);
-    } else {
-        return vec3(0, 0, 0);
-    }
+#ifdef DEBUG_LIGHT_COUNT
+// Lights of a pixel where the heatmap saturates to red
+const float HEATMAP_LIGHTS = 32;
+
+// Obtains the number of lights shade_sample() evaluates for a pixel at a
+// depth: those of its cluster, or every light but the spot lights drawn as
+// volumes or estimated from the tree, which count as their samples; the
+// nodes of a light cut aren't counted
+uint count_lights(float depth) {
+#ifdef CLUSTERED
+    uvec4 range = cluster_ranges[find_cluster(gbuffer_pixel(), depth)];
+    return range.y + range.z;
+#else
+    uint n = uint(n_point_lights);
+#if defined(LIGHT_TREE) && !defined(LIGHT_CUTS)
+    n += uint(light_samples);
+#elif !defined(LIGHT_TREE) && !defined(SPOT_VOLUMES)
+    n += uint(n_spot_lights);
+#endif
+    return n;
+#endif
 }
 
-float compute_spot(Light L, vec3 light_dir) {
-    if (L.is_spot) {
-        float kspot = max(dot(-light_dir, L.spot_direction), 0);
-        if (kspot > L.spot_cutoff) {
-            return pow(kspot, L.spot_exponent);
-        } else {
-            return 0;
-        }
-    } else {
-        return 1;
-    }
+// Colors a number of lights with the heatmap
+vec3 light_count_heatmap(uint n) {
+    return heatmap(float(n) / HEATMAP_LIGHTS);
 }
-
-vec3 compute_shading(Light L, Material M, vec3 normal, vec3 position) {
-    vec3 eye_dir = normalize(-position);
-    vec3 light_pos = L.position.xyz / L.position.w;
-    vec3 light_dir = normalize(light_pos - position);
-    vec3 half_vector = normalize(light_dir + eye_dir);
-    vec3 diffuse = compute_diffuse(L, M, normal, light_dir);
-    vec3 specular = compute_specular(L, M, normal, light_dir, half_vector);
-    float spot_intensity = compute_spot(L, light_dir);
-    return spot_intensity * (diffuse + specular);
-}
-
-vec3 compute_ambient(Material M) {
-    return M.ambient * global_ambient;
-}
-
-void main() {
-    int material = int(texture(material_sampler, frag_textcoord).x) - 1;
-    if (material == -1) {
-        color = background;
-        return;
-    }
-    vec3 position = texture(position_sampler, frag_textcoord).xyz;
-    vec3 normal = texture(normal_sampler, frag_textcoord).xyz;
+#endif
+
+// Shades one sample of the G-buffer; with LIGHT_PREPASS the background and
+// the ambient term are left to the material pass, as well as the albedo
+Shading shade_sample(ivec2 coord, int sample_index) {
+    vec3 position, normal;
+    int material;
+#ifdef LIGHT_PREPASS
+    if (!read_gbuffer(coord, sample_index, position, normal, material))
+        return Shading(0);
+#if defined(DEBUG_NORMALS)
+    return vec4(normal * 0.5 + 0.5, 0);
+#elif defined(DEBUG_LIGHT_COUNT)
+    return vec4(light_count_heatmap(count_lights(-position.z)), 0);
+#endif
     Material M = materials[material];
-    vec3 acc_color = vec3(0, 0, 0);
-    for (int i = 0; i < n_lights; ++i) {
-        Light L = lights[i];
-        acc_color += compute_shading(L, M, normal, position);
+#else
+    if (!read_gbuffer(coord, sample_index, position, normal, material))
+        return background;
+#if defined(DEBUG_NORMALS)
+    return normal * 0.5 + 0.5;
+#elif defined(DEBUG_LIGHT_COUNT)
+    return light_count_heatmap(count_lights(-position.z));
+#endif
+    Material M = get_material(material, read_albedo(coord, sample_index));
+#ifdef GROUND_CACHE
+    if (material == GROUND_MATERIAL) {
+        vec3 ambient = compute_ambient(M);
+#ifdef AMBIENT_OCCLUSION
+        ambient *= read_occlusion(coord, -position.z);
+#endif
+        return M.diffuse * read_ground_light(position) + ambient;
+    }
+#endif
+#endif
+    Shading acc_color = Shading(0);
+#if defined(CLUSTERED)
+    int cluster = find_cluster(gbuffer_pixel(), -position.z);
+    uvec4 range = cluster_ranges[cluster];
+    uint first_spot = range.x + range.y;
+    for (uint i = range.x; i < first_spot; ++i) {
+        PointLight L = point_lights[cluster_lights[i]];
+        acc_color += compute_point_shading(L, M, normal, position);
+    }
+    for (uint i = first_spot; i < first_spot + range.z; ++i)
+        acc_color += shade_spot_light(cluster_lights[i], M, normal, position);
+#ifdef CLUSTER_LIGHT_BUDGET
+    acc_color += shade_cluster_ambient(cluster, M);
+#endif
+#else
+    for (int i = 0; i < n_point_lights; ++i) {
+        PointLight L = point_lights[i];
+        acc_color += compute_point_shading(L, M, normal, position);
     }
+#if defined(LIGHT_CUTS)
+    acc_color += shade_light_cut(M, normal, position);
+#elif defined(LIGHT_TREE)
+    acc_color += shade_light_tree(M, normal, position, coord);
+#elif !defined(SPOT_VOLUMES)
+    for (int i = 0; i < n_spot_lights; ++i)
+        acc_color += shade_spot_light(uint(i), M, normal, position);
+#endif
+#endif
+#ifdef SUN_LIGHT
+    acc_color += shade_sun(M, normal, position);
+#endif
+#ifdef LIGHT_PREPASS
+    return acc_color;
+#else
     vec3 ambient = compute_ambient(M);
-    color = acc_color + ambient;
+#ifdef AMBIENT_OCCLUSION
+    ambient *= read_occlusion(coord, -position.z);
+#endif
+    return acc_color + ambient;
+#endif
 }
 
+void main() {
+    ivec2 coord = ivec2(gbuffer_pixel());
+#ifdef PER_SAMPLE
+    // Edge pixels average every sample, the others only shade the first one
+    Shading acc_color = Shading(0);
+    for (int i = 0; i < GBUFFER_SAMPLES; ++i)
+        acc_color += shade_sample(coord, i);
+    color = acc_color / GBUFFER_SAMPLES;
+#else
+    color = shade_sample(coord, 0);
+#endif
+#ifdef FOG
+    color = apply_fog(color, coord);
+#endif
+}
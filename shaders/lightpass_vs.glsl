@@ -24,13 +24,19 @@
 
 #version 450
 
-layout(location = 0) in vec4 position;
-layout(location = 1) in vec2 textcoord;
+// Redeclared, as the program is separable
+out gl_PerVertex {
+    vec4 gl_Position;
+};
 
 out vec2 frag_textcoord;
 
+// Full-screen triangle without vertex attributes, from gl_VertexID: a single
+// primitive covers the screen, so the pixel quads along the diagonal of two
+// triangles aren't shaded twice
 void main() {
-    gl_Position = position;
+    vec2 textcoord = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    gl_Position = vec4(textcoord * 2.0 - 1.0, 0.0, 1.0);
     frag_textcoord = textcoord;
 }
 
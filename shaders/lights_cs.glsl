@@ -0,0 +1,169 @@
+/*
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#version 450
+
+// Moves the spot lights to view space, one light per thread, and compacts the
+// visible ones into spot_lights, in their order (see LightTransform). The
+// light structures come from lighting.glsl. It's also compiled offline to SPIR-V (`make spirv`),
+// where the group size and the number of lights are specialization constants
+// instead of definitions of the header; the uniforms have explicit locations
+// for that build. With SPOT_SHADOWS the shadow of each visible light is
+// copied to the same slot of spot_shadows; the SPIR-V build has no shadows.
+// The slot of each active light, or -1, is written to spot_light_slots.
+// The slots are the prefix sums of the visible lights (see scan.glsl), and
+// the last tile writes their count.
+
+#ifdef GL_SPIRV
+#extension GL_GOOGLE_include_directive : require
+#endif
+
+#include "lighting.glsl"
+
+#ifdef GL_SPIRV
+layout (local_size_x_id = 0) in;
+layout (constant_id = 1) const int N_WORLD_SPOT_LIGHTS = 0;
+#else
+layout (local_size_x = GROUP_SIZE) in;
+#endif
+
+#include "scan.glsl"
+
+// Lights in world space, bound as buffer_bindings::WORLD_SPOT_LIGHTS
+#ifdef GL_SPIRV
+layout (std430, binding = 5) readonly buffer WorldSpotLightsBlock {
+#else
+layout (std430) readonly buffer WorldSpotLightsBlock {
+#endif
+    SpotLight world_spot_lights[];
+};
+
+// Slot in spot_lights of each active light of world_spot_lights, -1 if it
+// isn't visible, bound as buffer_bindings::SPOT_LIGHT_SLOTS
+#ifdef GL_SPIRV
+layout (std430, binding = 28) writeonly buffer SpotLightSlotsBlock {
+#else
+layout (std430) writeonly buffer SpotLightSlotsBlock {
+#endif
+    int spot_light_slots[];
+};
+
+#ifdef SPOT_SHADOWS
+// Shadow of every light, in the order of world_spot_lights, and of the
+// visible ones, in the order of spot_lights
+layout (std430) readonly buffer WorldSpotShadowsBlock {
+    SpotShadow world_spot_shadows[];
+};
+
+layout (std430) writeonly buffer SpotShadowsBlock {
+    SpotShadow spot_shadows[];
+};
+#endif
+
+// Rigid transform from world space to view space
+layout (location = 0) uniform mat4 world_to_view;
+
+// Ground plane, nothing is lit below it, in view space
+layout (location = 4) uniform vec4 ground_plane;
+
+// Normalized frustum planes in view space, facing inwards, six for each
+// view (LightTransform::MAX_FRUSTUMS)
+const int MAX_FRUSTUMS = 16;
+layout (location = 5) uniform vec4 frustum_planes[6 * MAX_FRUSTUMS];
+layout (location = 101) uniform int n_frustums;  // after the planes
+
+// Lights kept, the first ones of world_spot_lights
+layout (location = 102) uniform int n_active_lights;
+
+// Lights whose bounds are all farther from the eye are culled too, none if 0
+layout (location = 103) uniform float max_light_distance;
+
+// Lights whose bounds have a smaller radius at a unit distance from the eye
+// lose their specular, so the shading takes its diffuse path, none if 0
+layout (location = 104) uniform float min_specular_radius;
+
+// Checks if a sphere in view space is inside the frustum of any view
+bool is_visible(vec4 sphere) {
+    for (int f = 0; f < n_frustums; ++f) {
+        bool inside = true;
+        for (int p = 6 * f; p < 6 * f + 6; ++p) {
+            if (dot(frustum_planes[p].xyz, sphere.xyz) + frustum_planes[p].w <
+                -sphere.w)
+                inside = false;
+        }
+        if (inside)
+            return true;
+    }
+    return false;
+}
+
+// Bounds the part of a spot light cone within its range and above a plane
+vec4 bound_spot_light(SpotLight L, vec4 plane) {
+    // Highest direction of the cone, relative to the plane
+    float height = dot(plane.xyz, L.position) + plane.w;
+    float cos_angle = unpackHalf2x16(L.cone).x;
+    float sin_angle = sqrt(1 - cos_angle * cos_angle);
+    float cos_axis = dot(plane.xyz, L.direction);
+    float sin_axis = sqrt(max(1 - cos_axis * cos_axis, 0));
+    float rise = cos_axis > cos_angle
+               ? 1 : cos_axis * cos_angle + sin_axis * sin_angle;
+
+    // Every ray ends at the range or at the plane; the sphere bounds the
+    // spherical sector of that radius
+    float len = L.range;
+    if (height > 0 && rise < 0)
+        len = min(len, height / -rise);
+    if (cos_angle < sqrt(0.5))
+        return vec4(L.position, len);
+    float radius = len / (2 * cos_angle);
+    return vec4(L.position + L.direction * radius, radius);
+}
+
+void main() {
+    int i = scan_element();
+    bool visible = false;
+    SpotLight L;
+    if (i < N_WORLD_SPOT_LIGHTS && i < n_active_lights) {
+        spot_light_slots[i] = -1;
+        L = world_spot_lights[i];
+        L.position = vec3(world_to_view * vec4(L.position, 1));
+        L.direction = normalize(mat3(world_to_view) * L.direction);
+        vec4 bounds = bound_spot_light(L, ground_plane);
+        visible = is_visible(bounds) &&
+                  (max_light_distance == 0 ||
+                   length(bounds.xyz) - bounds.w <= max_light_distance);
+        if (bounds.w < min_specular_radius * length(bounds.xyz))
+            L.specular = 0;
+    }
+    int slot = int(scan_exclusive(visible ? 1u : 0u));
+    if (gl_LocalInvocationIndex == 0 && scan_is_last_tile())
+        n_spot_lights = int(scan_inclusive());
+    if (!visible)
+        return;
+    spot_lights[slot] = L;
+    spot_light_slots[i] = slot;
+#ifdef SPOT_SHADOWS
+    spot_shadows[slot] = world_spot_shadows[i];
+#endif
+}
@@ -0,0 +1,63 @@
+/*
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#version 450
+
+// Shades the G-buffer pixels covered by the volume of one spot light; the
+// contributions of the lights are blended additively. The G-buffer samplers
+// and read_gbuffer() are generated from the layout (see GBufferLayout) and
+// the shading functions come from lighting.glsl and spot_shading.glsl.
+
+#include "lighting.glsl"
+#ifdef RAY_TRACED_SHADOWS
+#include "shadow_bvh.glsl"
+#endif
+#include "spot_shading.glsl"
+
+// Slot of the light of the volume
+flat in int frag_light;
+
+#ifdef DEPTH_BOUNDS
+// View-space depths of the nearest and the farthest points of the cone; the
+// pixels outside are rejected before shading, as EXT_depth_bounds_test does
+// when available
+uniform vec2 light_depths;
+#endif
+
+// Output color
+out vec3 color;
+
+void main() {
+    vec3 position, normal;
+    int material;
+    ivec2 coord = ivec2(gl_FragCoord.xy);
+    if (!read_gbuffer(coord, 0, position, normal, material))
+        discard;
+#ifdef DEPTH_BOUNDS
+    if (position.z > light_depths.x || position.z < light_depths.y)
+        discard;
+#endif
+    Material M = get_material(material, read_albedo(coord, 0));
+    color = shade_spot_light(uint(frag_light), M, normal, position);
+}
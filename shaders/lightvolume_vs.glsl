@@ -0,0 +1,67 @@
+/*
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#version 450
+
+#include "lighting.glsl"
+
+// Cone with the apex at the origin, opening towards -z
+layout(location = 0) in vec4 position;
+
+uniform mat4 projection;
+
+// Slot in spot_lights of each active light, -1 if it isn't visible (see
+// LightTransform)
+layout (std430) readonly buffer SpotLightSlotsBlock {
+    int spot_light_slots[];
+};
+
+// Light of the volume among the active ones
+uniform int light_index;
+
+// Slot of the light of the volume, from lighting.glsl
+flat out int frag_light;
+
+// Places the cone on the light, in view space; the shaders compare the cosine
+// of the angle against the cutoff, and a cone as long as the range covers
+// every point within the range. The volumes of the culled lights collapse.
+mat4 volume_transform() {
+    if (frag_light < 0)
+        return mat4(0);
+    SpotLight L = spot_lights[frag_light];
+    // The cone opens towards -z; the basis keeps the winding of the faces
+    vec3 z = -L.direction;
+    vec3 up = abs(z.y) < 0.99 ? vec3(0, 1, 0) : vec3(1, 0, 0);
+    vec3 x = normalize(cross(up, z));
+    vec3 y = cross(z, x);
+    float cos_angle = unpackHalf2x16(L.cone).x;
+    float radius = L.range * sqrt(1 - cos_angle * cos_angle) / cos_angle;
+    return mat4(vec4(x * radius, 0), vec4(y * radius, 0),
+                vec4(z * L.range, 0), vec4(L.position, 1));
+}
+
+void main() {
+    frag_light = spot_light_slots[light_index];
+    gl_Position = projection * volume_transform() * position;
+}
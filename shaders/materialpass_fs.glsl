@@ -0,0 +1,62 @@
+/*
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#version 450
+#ifdef BINDLESS_MAPS
+#extension GL_ARB_bindless_texture : require
+#endif
+
+// Material pass of the light pre-pass: the geometry is drawn again over the
+// depth of the geometry pass, with its vertex shader, and each fragment
+// applies its material to the light accumulated in its pixel by the lighting
+// pass (see LIGHT_PREPASS in lightpass_fs.glsl), so the G-buffer doesn't
+// store the albedo or the colors of the material.
+
+#include "lighting.glsl"
+
+#include "diffuse_maps.glsl"
+
+// Diffuse light in rgb and specular intensity in alpha of each pixel
+layout(binding = 1) uniform sampler2D prepass_light;
+
+// If true, the light is output as it is, for the debug view of the normals
+uniform bool show_light;
+
+// Input from vertex shader, only the material is needed
+in vec2 frag_textcoord;
+flat in int frag_material_id;
+
+out vec3 color;
+
+void main() {
+    vec4 light = texelFetch(prepass_light, ivec2(gl_FragCoord.xy), 0);
+    if (show_light) {
+        color = light.rgb;
+        return;
+    }
+    int layer = materials[frag_material_id].diffuse_map;
+    vec3 mapped = sample_diffuse_map(layer, frag_textcoord).rgb;
+    Material M = get_material(frag_material_id, layer >= 0 ? mapped : vec3(1));
+    color = M.diffuse * light.rgb + M.specular * light.a + compute_ambient(M);
+}
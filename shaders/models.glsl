@@ -0,0 +1,67 @@
+/*
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Model transform of each instance, shared by the culling, the geometry
+// shaders and the resolve of the visibility buffer. It has no #version line:
+// the shaders #include it after theirs. The instances are only rotated,
+// translated and scaled uniformly; with COMPACT_MODELS each one is stored as
+// its translation and scale and its rotation quaternion, 32 bytes instead of
+// the 64 of its matrix, and the matrix is rebuilt where it's read.
+
+#ifdef COMPACT_MODELS
+struct CompactModel {
+    vec4 position_scale;
+    vec4 rotation;  // unit quaternion, with the real part in w
+};
+
+layout (std430) readonly buffer ModelsBlock {
+    CompactModel models[];
+};
+
+// Model matrix of an instance
+mat4 model_matrix(int model) {
+    CompactModel m = models[model];
+    vec4 q = m.rotation;
+    vec3 q2 = q.xyz * 2.0;
+    vec3 diagonal = vec3(1.0) - q2.yxx * q.yxx - q2.zzy * q.zzy;
+    vec3 products = q2 * q.yzx;  // 2xy, 2yz, 2zx
+    vec3 imaginary = q2 * q.w;   // 2xw, 2yw, 2zw
+    mat3 rotation = mat3(
+        diagonal.x, products.x + imaginary.z, products.z - imaginary.y,
+        products.x - imaginary.z, diagonal.y, products.y + imaginary.x,
+        products.z + imaginary.y, products.y - imaginary.x, diagonal.z);
+    rotation *= m.position_scale.w;
+    return mat4(vec4(rotation[0], 0.0), vec4(rotation[1], 0.0),
+                vec4(rotation[2], 0.0), vec4(m.position_scale.xyz, 1.0));
+}
+#else
+layout (std430) readonly buffer ModelsBlock {
+    mat4 models[];
+};
+
+// Model matrix of an instance
+mat4 model_matrix(int model) {
+    return models[model];
+}
+#endif
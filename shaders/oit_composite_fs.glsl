@@ -0,0 +1,49 @@
+/*
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#version 450
+
+// Composite of the weighted blended transparency (see forward_fs.glsl): the
+// sums of the weighted colors and of the weights, accumulated at a lower
+// resolution, are filtered bilinearly to the pixel and give the average color
+// of its transparent surfaces, blended over the lighting by their coverage.
+
+layout(binding = 0) uniform sampler2D accumulation_texture;
+layout(binding = 1) uniform sampler2D coverage_texture;
+
+// Pixels of the targets per pixel of the light buffer; the targets may be
+// allocated larger than the part rendered
+uniform vec2 oit_scale;
+
+// Average color and coverage of the transparent surfaces
+out vec4 color;
+
+void main() {
+    vec2 coord = gl_FragCoord.xy * oit_scale / textureSize(coverage_texture, 0);
+    float alpha = texture(coverage_texture, coord).r;
+    if (alpha <= 0)
+        discard;
+    vec4 accumulation = texture(accumulation_texture, coord);
+    color = vec4(accumulation.rgb / max(accumulation.a, 1e-5), alpha);
+}
@@ -0,0 +1,60 @@
+/*
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#version 450
+
+// Overdraw of the geometry pass (--overdraw), drawn after it without a depth
+// test with the vertex stage of the depth pre-pass: every fragment adds one
+// to red, and the first live fragment of each 2x2 quad adds to green the 4
+// lanes the quad shades, helper invocations included, so the small
+// triangles that only cover part of their quads show their real cost. Both
+// are summed by additive blending and shown by overdraw_view_fs.glsl.
+
+out vec2 counts;
+
+void main() {
+    // Liveness of the other lanes of the quad, from the fine derivatives of
+    // the one of each lane; the helper lanes run this too, without output
+    float live = gl_HelperInvocation ? 0 : 1;
+    ivec2 lane = ivec2(gl_FragCoord.xy) & 1;
+    float dx = dFdxFine(live);
+    float row_mate = lane.x == 0 ? live + dx : live - dx;
+    float dy = dFdyFine(live);
+    float column_mate = lane.y == 0 ? live + dy : live - dy;
+    float diagonal_dy = dFdyFine(row_mate);
+    float diagonal = lane.y == 0 ? row_mate + diagonal_dy
+                                 : row_mate - diagonal_dy;
+
+    // Lanes by their index, x + 2y, in the quad
+    int index = lane.x + 2 * lane.y;
+    float lanes[4];
+    lanes[index] = live;
+    lanes[index ^ 1] = row_mate;
+    lanes[index ^ 2] = column_mate;
+    lanes[index ^ 3] = diagonal;
+    int first = 0;
+    while (first < 3 && lanes[first] < 0.5)
+        ++first;
+    counts = vec2(1, first == index ? 4 : 0);
+}
@@ -0,0 +1,58 @@
+/*
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#version 450
+
+// Heatmap of the overdraw counted by overdraw_fs.glsl, over the output: the
+// fragments rasterized at each pixel or, with show_quads, the lanes shaded
+// per pixel of its quad.
+
+#include "heatmap.glsl"
+
+// Fragments in red and quad lanes in green, fetched without filtering
+layout(binding = 0) uniform sampler2D counts_texture;
+
+// Counted pixels per output pixel
+uniform vec2 counts_pixel_size;
+
+uniform bool show_quads;
+
+// Count where the heatmap saturates to red
+const float HEATMAP_OVERDRAW = 8;
+
+out vec3 color;
+
+void main() {
+    ivec2 coord = ivec2(gl_FragCoord.xy * counts_pixel_size);
+    float count = texelFetch(counts_texture, coord, 0).r;
+    if (show_quads) {
+        ivec2 quad = coord & ~1;
+        count = 0;
+        for (int i = 0; i < 4; ++i)
+            count += texelFetch(counts_texture, quad + ivec2(i & 1, i >> 1),
+                                0).g;
+        count /= 4;
+    }
+    color = heatmap(count / HEATMAP_OVERDRAW);
+}
@@ -0,0 +1,71 @@
+/*
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#version 450
+
+// Adds the screen space reflections to the lit image, with additive blending:
+// each glossy pixel takes the four nearest texels of the reflections at half
+// the resolution, weighted by how close their distance to the eye is, as the
+// ambient occlusion (see ambient_occlusion.glsl), times its reflectance (see
+// ScreenReflections). The G-buffer samplers and read_gbuffer() are generated
+// from the layout (see GBufferLayout), and the reflections use the first free
+// unit after the G-buffer (GBUFFER_TEXTURES).
+
+#include "lighting.glsl"
+
+layout(binding = GBUFFER_TEXTURES) uniform sampler2D reflection_texture;
+
+// Difference of distance, relative to the one of the pixel, at which a texel
+// stops weighting
+const float REFLECTION_DEPTH_TOLERANCE = 0.05;
+
+out vec4 color;
+
+void main() {
+    ivec2 coord = ivec2(gl_FragCoord.xy);
+    vec3 position, normal;
+    int material;
+    if (!read_gbuffer(coord, 0, position, normal, material))
+        discard;
+    vec3 reflectance = compute_reflectance(materials[material],
+                                           dot(normal, normalize(-position)));
+    if (reflectance == vec3(0))
+        discard;
+    float distance = -position.z;
+    ivec2 last = max(ivec2(gbuffer_size) / 2, ivec2(1)) - 1;
+    ivec2 base = max(coord - 1, ivec2(0)) / 2;
+    vec3 sum = vec3(0);
+    float weight_sum = 0;
+    for (int i = 0; i < 4; ++i) {
+        ivec2 texel = min(base + ivec2(i & 1, i >> 1), last);
+        vec4 value = texelFetch(reflection_texture, texel, 0);
+        // The small floor keeps pixels whose texels all differ
+        float weight = max(1 - abs(value.a - distance) /
+                                   (REFLECTION_DEPTH_TOLERANCE * distance),
+                           0) + 1e-3;
+        sum += value.rgb * weight;
+        weight_sum += weight;
+    }
+    color = vec4(reflectance * sum / weight_sum, 0);
+}
@@ -0,0 +1,114 @@
+/*
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Exclusive prefix sums over the threads of a compute dispatch in a single
+// pass, with decoupled look-back: each work group scans its tile of elements
+// in shared memory and publishes the sum of the tile, then adds the sums
+// published by the tiles before it, walking back until one that already
+// knows its inclusive prefix. The tiles are numbered in the order the groups
+// start, not by gl_WorkGroupID, so every tile a group waits for is already
+// running. Summing flags of 0 and 1 compacts a stream: each kept element gets
+// its dense slot, in the order of the elements, and the last tile knows how
+// many were kept. It has no #version line: compute shaders #include it after
+// the size of their groups, and StreamCompaction resets and binds the tiles
+// before their dispatches. Every thread of a group calls scan_element() and
+// scan_exclusive() once, so none may return before them.
+
+// Next tile to claim, and the status of each tile: a flag in the two high
+// bits, SCAN_AGGREGATE or SCAN_PREFIX, and its sum or inclusive prefix in the
+// others, 0 until the tile publishes anything
+#ifdef GL_SPIRV
+layout (std430, binding = 31) coherent buffer ScanTilesBlock {
+#else
+layout (std430) coherent buffer ScanTilesBlock {
+#endif
+    uint scan_next_tile;
+    uint scan_tiles[];
+};
+
+const uint SCAN_AGGREGATE = 1u << 30;
+const uint SCAN_PREFIX = 2u << 30;
+const uint SCAN_VALUE = SCAN_AGGREGATE - 1u;
+
+shared uint scan_tile;
+shared uint scan_prefix;
+shared uint scan_sums[gl_WorkGroupSize.x];
+
+// Claims the next tile for the group, returns the element of the thread
+int scan_element() {
+    if (gl_LocalInvocationIndex == 0)
+        scan_tile = atomicAdd(scan_next_tile, 1u);
+    barrier();
+    return int(scan_tile * gl_WorkGroupSize.x + gl_LocalInvocationIndex);
+}
+
+// Sums the values of the elements before the one of the thread
+uint scan_exclusive(uint value) {
+    uint i = gl_LocalInvocationIndex;
+    scan_sums[i] = value;
+    barrier();
+    for (uint offset = 1u; offset < gl_WorkGroupSize.x; offset *= 2u) {
+        uint sum = scan_sums[i];
+        if (i >= offset)
+            sum += scan_sums[i - offset];
+        barrier();
+        scan_sums[i] = sum;
+        barrier();
+    }
+
+    // The last thread has the sum of the tile and looks back for the prefix
+    if (i == gl_WorkGroupSize.x - 1u) {
+        uint aggregate = scan_sums[i];
+        uint prefix = 0u;
+        if (scan_tile > 0u) {
+            atomicExchange(scan_tiles[scan_tile], SCAN_AGGREGATE | aggregate);
+            int previous = int(scan_tile) - 1;
+            while (previous >= 0) {
+                uint status = atomicOr(scan_tiles[previous], 0u);
+                if (status == 0u)
+                    continue;  // not published yet
+                prefix += status & SCAN_VALUE;
+                if ((status & SCAN_PREFIX) != 0u)
+                    break;
+                --previous;
+            }
+        }
+        atomicExchange(scan_tiles[scan_tile],
+                       SCAN_PREFIX | (prefix + aggregate));
+        scan_prefix = prefix;
+    }
+    barrier();
+    return scan_prefix + scan_sums[i] - value;
+}
+
+// Sums the values of the tile and of the ones before it, after
+// scan_exclusive(); the last tile has the sum of every element
+uint scan_inclusive() {
+    return scan_prefix + scan_sums[gl_WorkGroupSize.x - 1u];
+}
+
+// Checks if the group has the last tile of the dispatch
+bool scan_is_last_tile() {
+    return scan_tile == gl_NumWorkGroups.x - 1u;
+}
@@ -0,0 +1,92 @@
+/*
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#version 450
+
+// Classifies the tiles of the shading rate image, one work group per tile
+// and one thread per pixel (see ShadingRateImage): a tile is shaded at the
+// coarse rate if every pixel has geometry, a normal close to the one of the
+// first pixel and a position on its plane, at the background rate if no
+// pixel has geometry, and at full rate otherwise. The G-buffer samplers and
+// read_gbuffer() are generated from the layout (see GBufferLayout), and
+// TILE_WIDTH, TILE_HEIGHT and the palette entries are defined by the
+// application.
+
+layout (local_size_x = TILE_WIDTH, local_size_y = TILE_HEIGHT) in;
+
+// Palette entry of each tile
+layout (r8ui) uniform writeonly uimage2D rate_image;
+
+// Cosine below which a normal differs from the one of the tile
+const float NORMAL_COSINE = 0.995;
+
+// Distance from the plane of the tile, relative to the distance to the eye,
+// above which a pixel is off the plane
+const float PLANE_TOLERANCE = 0.002;
+
+// First pixel of the tile, which the other pixels are compared to
+shared bool tile_geometry;
+shared vec3 tile_position;
+shared vec3 tile_normal;
+
+// Set if a pixel differs from the first one
+shared bool tile_full_rate;
+
+void main() {
+    ivec2 coord = ivec2(gl_GlobalInvocationID.xy);
+    vec3 position, normal;
+    int material;
+    bool inside = all(lessThan(coord, ivec2(gbuffer_size)));
+    bool geometry = inside && read_gbuffer(coord, 0, position, normal,
+                                           material);
+    if (gl_LocalInvocationIndex == 0) {
+        tile_geometry = geometry;
+        tile_position = position;
+        tile_normal = normal;
+        tile_full_rate = false;
+    }
+    barrier();
+
+    if (inside) {
+        bool differs = geometry != tile_geometry;
+        if (geometry && tile_geometry) {
+            float distance = abs(dot(position - tile_position, tile_normal));
+            differs = dot(normal, tile_normal) < NORMAL_COSINE ||
+                      distance > PLANE_TOLERANCE * -tile_position.z;
+        }
+        // Every thread that finds a difference writes the same value
+        if (differs)
+            tile_full_rate = true;
+    }
+    barrier();
+
+    if (gl_LocalInvocationIndex == 0) {
+        uint rate = COARSE_RATE;
+        if (tile_full_rate)
+            rate = FULL_RATE;
+        else if (!tile_geometry)
+            rate = BACKGROUND_RATE;
+        imageStore(rate_image, ivec2(gl_WorkGroupID.xy), uvec4(rate));
+    }
+}
@@ -0,0 +1,156 @@
+/*
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Two-level bounding volume hierarchy of the shadow rays of the spot lights
+// (see ShadowBvh). It has no #version line: shadow_bvh_cs.glsl, which
+// refits it, and the lighting shaders #include it. The nodes of both levels
+// are leaves when their right is negative. The mesh level has its root at 0
+// and up to a few triangles per leaf, in mesh space. The instance level has
+// the n - 1 internal nodes first, the root at 0, and the leaf of each
+// instance after them, in view space, with the transform from view space to
+// the mesh of the instance.
+
+struct ShadowNode {
+    vec3 bounds_min;
+    int left;  // the first triangle or the instance of a leaf
+    vec3 bounds_max;
+    int right;  // minus the triangles or -1 in a leaf
+};
+
+layout (std430) readonly buffer ShadowMeshNodesBlock {
+    ShadowNode shadow_mesh_nodes[];
+};
+
+// Corners of the triangles of the mesh leaves, 3 per triangle, in w = 1
+layout (std430) readonly buffer ShadowTrianglesBlock {
+    vec4 shadow_triangles[];
+};
+
+#ifdef SHADOW_BVH_REFIT
+layout (std430) coherent buffer ShadowNodesBlock {
+#else
+layout (std430) readonly buffer ShadowNodesBlock {
+#endif
+    ShadowNode shadow_nodes[];
+};
+
+#ifdef SHADOW_BVH_REFIT
+layout (std430) writeonly buffer ShadowInstancesBlock {
+#else
+layout (std430) readonly buffer ShadowInstancesBlock {
+#endif
+    mat4 shadow_instances[];  // view space to mesh space
+};
+
+#ifndef SHADOW_BVH_REFIT
+// Nodes left to visit at most; both levels are split at the medians, so
+// their depths are about the logarithms of their leaves
+#define SHADOW_STACK_SIZE 32
+
+// Checks if the segment from origin to origin + direction crosses the bounds
+// of a node, with the inverse of direction
+bool shadow_segment_crosses(ShadowNode node, vec3 origin,
+                            vec3 inv_direction) {
+    vec3 t0 = (node.bounds_min - origin) * inv_direction;
+    vec3 t1 = (node.bounds_max - origin) * inv_direction;
+    vec3 near = min(t0, t1);
+    vec3 far = max(t0, t1);
+    float enter = max(max(near.x, near.y), max(near.z, 0.0));
+    float leave = min(min(far.x, far.y), min(far.z, 1.0));
+    return enter <= leave;
+}
+
+// Checks if the segment from origin to origin + direction crosses a triangle
+// of the mesh level, on either face
+bool shadow_segment_hits(int triangle, vec3 origin, vec3 direction) {
+    vec3 a = shadow_triangles[3 * triangle].xyz;
+    vec3 e1 = shadow_triangles[3 * triangle + 1].xyz - a;
+    vec3 e2 = shadow_triangles[3 * triangle + 2].xyz - a;
+    vec3 p = cross(direction, e2);
+    float det = dot(e1, p);
+    if (det == 0.0)
+        return false;
+    vec3 s = (origin - a) / det;
+    float u = dot(s, p);
+    vec3 q = cross(s, e1);
+    float v = dot(direction, q);
+    float t = dot(e2, q);
+    return u >= 0 && v >= 0 && u + v <= 1 && t > 0 && t < 1;
+}
+
+// Checks if the segment from origin to origin + direction, in mesh space,
+// crosses the mesh
+bool shadow_mesh_occludes(vec3 origin, vec3 direction) {
+    vec3 inv_direction = 1.0 / direction;
+    int stack[SHADOW_STACK_SIZE];
+    int size = 0;
+    int node = 0;
+    while (true) {
+        ShadowNode N = shadow_mesh_nodes[node];
+        if (shadow_segment_crosses(N, origin, inv_direction)) {
+            if (N.right >= 0) {
+                if (size < SHADOW_STACK_SIZE)
+                    stack[size++] = N.right;
+                node = N.left;
+                continue;
+            }
+            for (int i = N.left; i < N.left - N.right; ++i)
+                if (shadow_segment_hits(i, origin, direction))
+                    return true;
+        }
+        if (size == 0)
+            return false;
+        node = stack[--size];
+    }
+}
+
+// Checks if the segment from origin to target, in view space, crosses an
+// instance; it stops at the first one that does
+bool shadow_segment_occluded(vec3 origin, vec3 target) {
+    vec3 direction = target - origin;
+    vec3 inv_direction = 1.0 / direction;
+    int stack[SHADOW_STACK_SIZE];
+    int size = 0;
+    int node = 0;
+    while (true) {
+        ShadowNode N = shadow_nodes[node];
+        if (shadow_segment_crosses(N, origin, inv_direction)) {
+            if (N.right >= 0) {
+                if (size < SHADOW_STACK_SIZE)
+                    stack[size++] = N.right;
+                node = N.left;
+                continue;
+            }
+            // The segment keeps its ends in mesh space, so t still ends at 1
+            mat4 view_to_mesh = shadow_instances[N.left];
+            if (shadow_mesh_occludes(vec3(view_to_mesh * vec4(origin, 1)),
+                                     mat3(view_to_mesh) * direction))
+                return true;
+        }
+        if (size == 0)
+            return false;
+        node = stack[--size];
+    }
+}
+#endif
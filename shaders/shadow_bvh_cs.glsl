@@ -0,0 +1,87 @@
+/*
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#version 450
+
+// Refits the instance level of shadow_bvh.glsl to the model matrices of
+// models.glsl in view space, one instance per thread: each thread bounds
+// the root of the mesh level moved by its instance in its leaf, keeps the
+// inverse of that transform, and walks up from the leaf; the second thread
+// to reach a node has both children and bounds it, the first one stops.
+
+#define SHADOW_BVH_REFIT
+
+#include "models.glsl"
+#include "shadow_bvh.glsl"
+
+layout (local_size_x = GROUP_SIZE) in;
+
+// Parent of each node of the instance level, -1 at the root
+layout (std430) readonly buffer ShadowParentsBlock {
+    int shadow_parents[];
+};
+
+// Children of each node refitted so far, cleared before the dispatch
+layout (std430) buffer ShadowRefitsBlock {
+    uint shadow_refits[];
+};
+
+// Rigid transform from world space to view space
+uniform mat4 world_to_view;
+
+// Model of the first instance in models, and the instances
+uniform int first_model;
+uniform int n_instances;
+
+void main() {
+    int i = int(gl_GlobalInvocationID.x);
+    if (i >= n_instances)
+        return;
+    int node = n_instances - 1 + i;
+    int instance = shadow_nodes[node].left;
+    mat4 mesh_to_view = world_to_view * model_matrix(first_model + instance);
+    ShadowNode root = shadow_mesh_nodes[0];
+    vec3 center = vec3(mesh_to_view *
+                       vec4((root.bounds_min + root.bounds_max) * 0.5, 1));
+    vec3 half_size = (root.bounds_max - root.bounds_min) * 0.5;
+    vec3 extent = abs(mesh_to_view[0].xyz) * half_size.x +
+                  abs(mesh_to_view[1].xyz) * half_size.y +
+                  abs(mesh_to_view[2].xyz) * half_size.z;
+    shadow_nodes[node].bounds_min = center - extent;
+    shadow_nodes[node].bounds_max = center + extent;
+    shadow_instances[instance] = inverse(mesh_to_view);
+    while (node > 0) {
+        int parent = shadow_parents[node];
+        memoryBarrierBuffer();
+        if (atomicAdd(shadow_refits[parent], 1u) == 0u)
+            return;
+        ShadowNode left = shadow_nodes[shadow_nodes[parent].left];
+        ShadowNode right = shadow_nodes[shadow_nodes[parent].right];
+        shadow_nodes[parent].bounds_min = min(left.bounds_min,
+                                              right.bounds_min);
+        shadow_nodes[parent].bounds_max = max(left.bounds_max,
+                                              right.bounds_max);
+        node = parent;
+    }
+}
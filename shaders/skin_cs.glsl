@@ -0,0 +1,84 @@
+/*
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#version 450
+
+// Skinning pre-pass (see VertexSkinning), one vertex of one pose per thread:
+// the vertices of the batch, in the format of its arena, are blended
+// between the two bones of their pose by a weight that grows with their
+// height, and written with their normals to the skinned vertices, which the
+// vertex shaders of every pass read instead of their attributes (see
+// SKINNING in geometry.glsl).
+
+layout (local_size_x = GROUP_SIZE) in;
+
+// Vertices of the batch: the position as 4 snorm shorts, quantized to the
+// bounds of the mesh with the material offset in w, the normal as
+// GL_INT_2_10_10_10_REV and the texture coordinates as 2 halfs
+layout (std430) readonly buffer SkinSourceBlock {
+    uvec4 source_vertices[];
+};
+
+// Root and upper bone of each pose, in the quantized space of the meshes
+layout (std430) readonly buffer SkinBonesBlock {
+    mat4 bones[];
+};
+
+// Skinned position, still quantized and with the material offset in w, and
+// normal of each vertex of each pose
+struct SkinnedVertex {
+    vec4 position;
+    vec4 normal;
+};
+
+layout (std430) writeonly buffer SkinnedVerticesBlock {
+    SkinnedVertex skinned_vertices[];
+};
+
+uniform int n_vertices;
+uniform int n_poses;
+
+// Heights where the weight of the upper bone starts and ends growing
+uniform vec2 bone_heights;
+
+void main() {
+    int i = int(gl_GlobalInvocationID.x);
+    if (i >= n_vertices * n_poses)
+        return;
+    int pose = i / n_vertices;
+    uvec4 vertex = source_vertices[i - pose * n_vertices];
+    vec4 position = vec4(unpackSnorm2x16(vertex.x),
+                         unpackSnorm2x16(vertex.y));
+    int packed_normal = int(vertex.z);
+    ivec3 quantized_normal = ivec3(bitfieldExtract(packed_normal, 0, 10),
+                                   bitfieldExtract(packed_normal, 10, 10),
+                                   bitfieldExtract(packed_normal, 20, 10));
+    vec3 normal = max(vec3(quantized_normal) / 511.0, vec3(-1));
+
+    float weight = smoothstep(bone_heights.x, bone_heights.y, position.y);
+    mat4 skin = bones[2 * pose] * (1.0 - weight) + bones[2 * pose + 1] * weight;
+    vec3 skinned_position = vec3(skin * vec4(position.xyz, 1.0));
+    skinned_vertices[i].position = vec4(skinned_position, position.w);
+    skinned_vertices[i].normal = vec4(normalize(mat3(skin) * normal), 0.0);
+}
@@ -0,0 +1,88 @@
+/*
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Shading of the spot lights for the lighting passes. It has no #version
+// line: the shaders #include it after lighting.glsl. With SPOT_SHADOWS the
+// lights are shadowed by their maps in the atlas (see ShadowAtlas), which
+// uses the unit after the ambient occlusion (GBUFFER_TEXTURES + 1). With
+// RAY_TRACED_SHADOWS they're shadowed by a ray toward each of them instead,
+// through the hierarchy of shadow_bvh.glsl, which the shaders #include
+// before this file.
+
+#ifdef RAY_TRACED_SHADOWS
+// Offset of the origins of the shadow rays along the normal, relative to
+// their distance to the eye, so the surfaces don't shadow themselves
+const float SHADOW_RAY_BIAS = 0.002;
+#endif
+
+#ifdef SPOT_SHADOWS
+// Shadow of each light of spot_lights, in the same order
+layout (std430) readonly buffer SpotShadowsBlock {
+    SpotShadow spot_shadows[];
+};
+
+layout (binding = GBUFFER_TEXTURES + 1) uniform sampler2DShadow shadow_atlas;
+
+// Obtains the fraction of a spot light that reaches a view-space position,
+// from four comparison taps half a texel around it, each filtered over 2x2
+// texels, kept inside the tile
+float compute_spot_shadow(uint light, vec3 position) {
+    SpotShadow S = spot_shadows[light];
+    if (S.tile.z == 0)
+        return 1;
+    vec4 clip = S.view_to_light * vec4(position, 1);
+    vec3 ndc = clip.xyz / clip.w;
+    vec2 texel = 1.0 / vec2(textureSize(shadow_atlas, 0));
+    vec2 uv = S.tile.xy + (ndc.xy * 0.5 + 0.5) * S.tile.z;
+    vec2 uv_min = S.tile.xy + 1.5 * texel;
+    vec2 uv_max = S.tile.xy + S.tile.z - 1.5 * texel;
+    float depth = ndc.z * 0.5 + 0.5;
+    float lit = 0;
+    for (int i = 0; i < 4; ++i) {
+        vec2 offset = (vec2(i & 1, i >> 1) - 0.5) * texel;
+        vec2 tap = clamp(uv + offset, uv_min, uv_max);
+        lit += texture(shadow_atlas, vec3(tap, depth));
+    }
+    return lit * 0.25;
+}
+#endif
+
+// Shades the spot light of an index of spot_lights
+Shading shade_spot_light(uint light, Material M, vec3 normal,
+                         vec3 position) {
+    Shading shading = compute_spot_shading(spot_lights[light], M, normal,
+                                           position);
+#ifdef SPOT_SHADOWS
+    // Only the lit positions, inside the cone, read the map
+    if (shading != Shading(0))
+        shading *= compute_spot_shadow(light, position);
+#elif defined(RAY_TRACED_SHADOWS)
+    // Only the lit positions, inside the cone, trace a ray
+    vec3 origin = position + normal * (SHADOW_RAY_BIAS * length(position));
+    if (shading != Shading(0) &&
+        shadow_segment_occluded(origin, spot_lights[light].position))
+        shading = Shading(0);
+#endif
+    return shading;
+}
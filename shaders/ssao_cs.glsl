@@ -0,0 +1,157 @@
+/*
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#version 450
+
+// Ambient occlusion at half the resolution of the G-buffer, one texel per
+// thread (see AmbientOcclusion). With OCCLUSION each texel takes the first
+// pixel of its 2x2 block and marches DIRECTIONS directions, rotated per texel,
+// over a radius that covers RADIUS world units; every sample occludes by the
+// sine of its elevation over the tangent plane, less a bias, fading with its
+// distance (the HBAO+ estimator). With BLUR the texels are blurred along
+// one axis, weighted by how close their distance is to the one of the center.
+// Each texel stores the visibility, one without occlusion, and the distance
+// to the eye, zero for the background. The G-buffer samplers and
+// read_gbuffer() are generated from the layout (see GBufferLayout) and
+// GROUP_SIZE is defined by the application.
+
+layout (local_size_x = GROUP_SIZE, local_size_y = GROUP_SIZE) in;
+
+// Texels written, inside the image
+layout (rg16f) uniform writeonly image2D target_image;
+uniform vec2 occlusion_size;
+
+#ifdef OCCLUSION
+
+// G-buffer pixels covered vertically by a unit at a unit distance
+uniform float projection_scale;
+
+// Radius of the samples in world units, and its cap in G-buffer pixels so
+// surfaces close to the eye don't read a large part of the screen
+const float RADIUS = 2.0;
+const float MAX_RADIUS_PIXELS = 128.0;
+
+// Samples per texel
+const int DIRECTIONS = 4;
+const int STEPS = 4;
+
+// Sine under which the samples don't occlude, which hides the edges between
+// the triangles
+const float ANGLE_BIAS = 0.1;
+
+// Scale of the occlusion
+const float INTENSITY = 2.0;
+
+// Obtains a value between 0 and 1 for a pixel that changes a lot between
+// neighbours (interleaved gradient noise)
+float noise(vec2 pixel) {
+    return fract(52.9829189 * fract(dot(pixel, vec2(0.06711056, 0.00583715))));
+}
+
+void main() {
+    ivec2 coord = ivec2(gl_GlobalInvocationID.xy);
+    if (any(greaterThanEqual(coord, ivec2(occlusion_size))))
+        return;
+    ivec2 pixel = coord * 2;
+    vec3 position, normal;
+    int material;
+    if (!read_gbuffer(pixel, 0, position, normal, material)) {
+        imageStore(target_image, coord, vec4(1, 0, 0, 0));
+        return;
+    }
+    float distance = -position.z;
+    float radius = min(RADIUS * projection_scale / distance,
+                       MAX_RADIUS_PIXELS);
+    float angle = noise(vec2(coord)) * 6.2831853 / DIRECTIONS;
+    float jitter = noise(vec2(coord.yx) + 17.0);
+    float occlusion = 0;
+    for (int i = 0; i < DIRECTIONS; ++i) {
+        float direction_angle = angle + i * 6.2831853 / DIRECTIONS;
+        vec2 direction = vec2(cos(direction_angle), sin(direction_angle));
+        for (int j = 0; j < STEPS; ++j) {
+            // The first step leaves the pixel
+            float step_pixels = max(radius * (j + jitter) / STEPS, 1.0);
+            vec2 sample_pixel = vec2(pixel) + 0.5 + direction * step_pixels;
+            ivec2 sample_coord = ivec2(clamp(sample_pixel, vec2(0),
+                                             gbuffer_size - 1));
+            vec3 sample_position, sample_normal;
+            int sample_material;
+            if (!read_gbuffer(sample_coord, 0, sample_position, sample_normal,
+                              sample_material))
+                continue;
+            vec3 v = sample_position - position;
+            float distance2 = max(dot(v, v), 1e-6);
+            float falloff = max(1 - distance2 / (RADIUS * RADIUS), 0);
+            float elevation = dot(normal, v) * inversesqrt(distance2);
+            occlusion += max(elevation - ANGLE_BIAS, 0) * falloff;
+        }
+    }
+    float visibility = 1 - INTENSITY * occlusion / (DIRECTIONS * STEPS);
+    imageStore(target_image, coord,
+               vec4(clamp(visibility, 0, 1), distance, 0, 0));
+}
+
+#endif
+
+#ifdef BLUR
+
+// Texels read, and the axis of the blur
+layout (rg16f) uniform readonly image2D source_image;
+uniform ivec2 direction;
+
+// Texels on each side of the center and deviation of their gaussian weight
+const int BLUR_RADIUS = 3;
+const float BLUR_SIGMA = 2.0;
+
+// Difference of distance, relative to the one of the center, at which a texel
+// stops weighting
+const float DEPTH_TOLERANCE = 0.05;
+
+void main() {
+    ivec2 coord = ivec2(gl_GlobalInvocationID.xy);
+    if (any(greaterThanEqual(coord, ivec2(occlusion_size))))
+        return;
+    vec2 center = imageLoad(source_image, coord).rg;
+    if (center.g == 0) {
+        imageStore(target_image, coord, vec4(center, 0, 0));
+        return;
+    }
+    ivec2 last = ivec2(occlusion_size) - 1;
+    float sum = 0;
+    float weight_sum = 0;
+    for (int i = -BLUR_RADIUS; i <= BLUR_RADIUS; ++i) {
+        ivec2 texel = clamp(coord + i * direction, ivec2(0), last);
+        vec2 value = imageLoad(source_image, texel).rg;
+        float depth_weight = max(1 - abs(value.g - center.g) /
+                                         (DEPTH_TOLERANCE * center.g), 0);
+        float weight = exp(-i * i / (2 * BLUR_SIGMA * BLUR_SIGMA)) *
+                       depth_weight;
+        sum += value.r * weight;
+        weight_sum += weight;
+    }
+    // The center always weights one
+    imageStore(target_image, coord, vec4(sum / weight_sum, center.g, 0, 0));
+}
+
+#endif
@@ -0,0 +1,219 @@
+/*
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#version 450
+
+// Reflections of the glossy pixels at half the resolution of the G-buffer,
+// one texel per thread (see ScreenReflections). Each texel takes the first
+// pixel of its 2x2 block and marches the reflected ray in screen space, in
+// pixels and depth, through the pyramid of the closest depths: a ray that
+// stays in front of a texel up to where it leaves it skips it and climbs a
+// level, one that reaches its depth goes down a level, and at the first
+// level it hits the pixel, unless it passes more than a thickness behind it.
+// The hit reads the lit image of the last frame, reprojected, weighted by a
+// confidence that fades at the edges of the screen and at the end of the
+// ray, and the ambient light makes up the rest. The reflected light is then
+// blended with the reprojected reflections of the last frame, and each texel
+// stores it with its distance to the eye, zero for the background. The
+// G-buffer samplers and read_gbuffer() are generated from the layout (see
+// GBufferLayout) and GROUP_SIZE is defined by the application.
+
+#include "lighting.glsl"
+
+layout (local_size_x = GROUP_SIZE, local_size_y = GROUP_SIZE) in;
+
+// Texels written, inside the image
+layout (rgba16f) uniform writeonly image2D target_image;
+uniform vec2 reflection_size;
+
+uniform mat4 projection;
+
+// Closest depths of the G-buffer (see DepthPyramid)
+uniform sampler2D depth_pyramid;
+uniform int pyramid_levels;
+
+// Lit image and reflections of the last frame, and the transform from the
+// view space of this frame to the clip space of the last one; the weights
+// are zero until they exist
+layout(binding = GBUFFER_TEXTURES + 1) uniform sampler2D lit_texture;
+layout(binding = GBUFFER_TEXTURES + 2) uniform sampler2D history_texture;
+uniform mat4 reprojection;
+uniform float lit_weight;
+uniform float history_weight;
+
+// Frame counter, which moves the start of the rays
+uniform int frame;
+
+// Length of the rays in world units
+const float MAX_DISTANCE = 50.0;
+
+// Steps of the march through the pyramid
+const int MAX_STEPS = 48;
+
+// Distance behind a pixel, relative to its distance to the eye, up to which
+// a ray hits it
+const float THICKNESS = 0.05;
+
+// Part of the screen, from its edges, and of the ray, from its end, over
+// which the hits fade
+const float EDGE_FADE = 0.1;
+const float END_FADE = 0.2;
+
+// Difference of distance, relative to the one of the texel, at which the
+// history is rejected
+const float HISTORY_TOLERANCE = 0.05;
+
+// Obtains a value between 0 and 1 for a pixel that changes a lot between
+// neighbours (interleaved gradient noise)
+float noise(vec2 pixel) {
+    return fract(52.9829189 * fract(dot(pixel, vec2(0.06711056, 0.00583715))));
+}
+
+// Obtains the G-buffer pixel and the depth of a point in view space
+vec3 to_screen(vec3 view_position) {
+    vec4 clip = projection * vec4(view_position, 1);
+    vec3 ndc = clip.xyz / clip.w;
+    return vec3((ndc.xy * 0.5 + 0.5) * gbuffer_size, ndc.z * 0.5 + 0.5);
+}
+
+// Obtains the distance to the eye at a G-buffer pixel and depth
+float to_distance(vec2 pixel, float depth) {
+    vec4 ndc = vec4(pixel / gbuffer_size, depth, 1) * 2 - 1;
+    vec4 position = inv_projection * ndc;
+    return -position.z / position.w;
+}
+
+// Marches the ray from a screen point along a screen direction, up to the
+// parameter t_max, and returns the parameter of the hit, or -1
+float trace(vec3 origin, vec3 direction, float t, float t_max) {
+    // A ray that doesn't move along an axis never crosses its sides
+    bvec2 moves = greaterThan(abs(direction.xy), vec2(1e-6));
+    vec2 inv_direction = 1 / mix(vec2(1), direction.xy, moves);
+    vec2 side = step(0, direction.xy);
+    // A hundredth of a pixel past the sides of the cells
+    float nudge = 0.01 / max(abs(direction.x), abs(direction.y));
+    int level = 0;
+    for (int i = 0; i < MAX_STEPS && t < t_max; ++i) {
+        vec3 p = origin + direction * t;
+        float cell_size = exp2(level);
+        ivec2 last = textureSize(depth_pyramid, level) - 1;
+        ivec2 cell = min(ivec2(p.xy / cell_size), last);
+        float closest = texelFetch(depth_pyramid, cell, level).r;
+        vec2 t_sides = ((vec2(cell) + side) * cell_size - origin.xy) *
+                       inv_direction;
+        t_sides = mix(vec2(1e30), t_sides, moves);
+        // The last cells of a level with an odd size cover one more pixel
+        float t_exit = max(min(t_sides.x, t_sides.y), t);
+        if (max(p.z, origin.z + direction.z * t_exit) < closest) {
+            t = t_exit + nudge;
+            level = min(level + 1, pyramid_levels - 1);
+        } else if (level == 0) {
+            float ray_distance = to_distance(p.xy, p.z);
+            float pixel_distance = to_distance(vec2(cell) + 0.5, closest);
+            return ray_distance - pixel_distance <
+                   THICKNESS * pixel_distance ? t : -1;
+        } else {
+            // Down to the depth of the cell, which the ray reaches in it
+            if (direction.z > 0 && p.z < closest)
+                t = max(t, (closest - origin.z) / direction.z);
+            level--;
+        }
+    }
+    return -1;
+}
+
+void main() {
+    ivec2 coord = ivec2(gl_GlobalInvocationID.xy);
+    if (any(greaterThanEqual(coord, ivec2(reflection_size))))
+        return;
+    ivec2 pixel = coord * 2;
+    vec3 position, normal;
+    int material;
+    if (!read_gbuffer(pixel, 0, position, normal, material)) {
+        imageStore(target_image, coord, vec4(0));
+        return;
+    }
+    float distance = -position.z;
+    vec3 view_dir = normalize(position);
+    vec3 reflectance = compute_reflectance(materials[material],
+                                           -dot(normal, view_dir));
+    if (reflectance == vec3(0)) {
+        imageStore(target_image, coord, vec4(0, 0, 0, distance));
+        return;
+    }
+
+    // The end of the ray stays in front of the near plane
+    vec3 ray = reflect(view_dir, normal);
+    float near = projection[3][2] / (projection[2][2] - 1);
+    float ray_length = MAX_DISTANCE;
+    if (ray.z > 0)
+        ray_length = min(ray_length, 0.99 * (-near - position.z) / ray.z);
+    vec3 origin = to_screen(position);
+    vec3 direction = to_screen(position + ray * ray_length) - origin;
+
+    // Up to the edges of the screen, from past the pixel
+    float t_max = 1;
+    for (int i = 0; i < 2; ++i) {
+        if (direction[i] > 0)
+            t_max = min(t_max, (gbuffer_size[i] - origin[i]) / direction[i]);
+        else if (direction[i] < 0)
+            t_max = min(t_max, -origin[i] / direction[i]);
+    }
+    float pixels = max(abs(direction.x), abs(direction.y));
+    float t = (2 + noise(vec2(coord) + 5.588238 * (frame & 63))) /
+              max(pixels, 1e-6);
+    float hit = pixels > 1 ? trace(origin, direction, t, t_max) : -1;
+
+    vec3 reflected = vec3(0);
+    float confidence = 0;
+    vec3 hit_position, hit_normal;
+    int hit_material;
+    if (hit >= 0 &&
+        read_gbuffer(ivec2((origin + direction * hit).xy), 0, hit_position,
+                     hit_normal, hit_material) &&
+        dot(hit_normal, ray) < 0) {
+        vec4 clip = reprojection * vec4(hit_position, 1);
+        vec2 uv = clip.xy / clip.w * 0.5 + 0.5;
+        vec2 screen = (origin + direction * hit).xy / gbuffer_size;
+        vec2 edge = min(screen, 1 - screen);
+        if (clip.w > 0 && all(greaterThanEqual(uv, vec2(0))) &&
+            all(lessThanEqual(uv, vec2(1)))) {
+            reflected = textureLod(lit_texture, uv, 0).rgb;
+            confidence = clamp(min(edge.x, edge.y) / EDGE_FADE, 0, 1) *
+                         clamp((1 - hit) / END_FADE, 0, 1) * lit_weight;
+        }
+    }
+    vec3 light = mix(global_ambient, reflected, confidence);
+
+    // The history is the same surface if it has the same distance
+    vec4 clip = reprojection * vec4(position, 1);
+    vec2 uv = clip.xy / clip.w * 0.5 + 0.5;
+    if (clip.w > 0 && all(greaterThanEqual(uv, vec2(0))) &&
+        all(lessThanEqual(uv, vec2(1)))) {
+        vec4 history = textureLod(history_texture, uv, 0);
+        if (abs(history.a - clip.w) < HISTORY_TOLERANCE * clip.w)
+            light = mix(light, history.rgb, history_weight);
+    }
+    imageStore(target_image, coord, vec4(light, distance));
+}
@@ -0,0 +1,82 @@
+/*
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Shading of the sun, a directional light, for the lighting passes. It has
+// no #version line: the shaders #include it after lighting.glsl. The sun is
+// shadowed by the first of its cascaded maps that covers a position (see
+// SunShadows), in a depth texture at the unit after the shadow atlas of the
+// spot lights (GBUFFER_TEXTURES + 2).
+
+// Most cascades (also SunShadows::MAX_CASCADES)
+#define MAX_CASCADES 4
+
+// Sun and its maps, uploaded every frame: the direction towards it in view
+// space, the transform from view space to the clip space of each map and its
+// offset and size in the texture, of size zero without a map
+layout (std140) uniform SunBlock {
+    vec3 sun_direction;
+    float sun_specular;
+    vec3 sun_diffuse;
+    int n_cascades;
+    mat4 cascade_view_to_clip[MAX_CASCADES];
+    vec4 cascade_tiles[MAX_CASCADES];
+};
+
+layout (binding = GBUFFER_TEXTURES + 2) uniform sampler2DShadow sun_shadows;
+
+// Obtains the fraction of the sun that reaches a view-space position, from
+// four comparison taps half a texel around it, each filtered over 2x2
+// texels; the positions out of every map are lit
+float compute_sun_shadow(vec3 position) {
+    for (int i = 0; i < n_cascades; ++i) {
+        vec4 tile = cascade_tiles[i];
+        if (tile.z == 0)
+            continue;
+        vec2 texel = 1.0 / vec2(textureSize(sun_shadows, 0));
+        vec3 ndc = (cascade_view_to_clip[i] * vec4(position, 1)).xyz;
+        // The taps stay inside the tile
+        vec2 border = 1 - 3 * texel / tile.zw;
+        if (any(greaterThan(abs(ndc.xy), border)) || abs(ndc.z) > 1)
+            continue;
+        vec2 uv = tile.xy + (ndc.xy * 0.5 + 0.5) * tile.zw;
+        float depth = ndc.z * 0.5 + 0.5;
+        float lit = 0;
+        for (int j = 0; j < 4; ++j) {
+            vec2 offset = (vec2(j & 1, j >> 1) - 0.5) * texel;
+            lit += texture(sun_shadows, vec3(uv + offset, depth));
+        }
+        return lit * 0.25;
+    }
+    return 1;
+}
+
+// Shades the sun
+Shading shade_sun(Material M, vec3 normal, vec3 position) {
+    Shading shading = compute_reflection(sun_diffuse, sun_specular, M, normal,
+                                         position, sun_direction);
+    // Only the lit positions, facing the sun, read the maps
+    if (shading != Shading(0))
+        shading *= compute_sun_shadow(position);
+    return shading;
+}
@@ -0,0 +1,126 @@
+/*
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#version 450
+
+// Simulates the lights of the swarm, one light per thread (see LightSwarm):
+// each one turns around the vertical axis through the center of the box,
+// pulled back towards its middle height and bounced off its sides, and fades
+// in and out over its lifetime. The expired lights respawn at a random point
+// of the box with a new velocity and color. The view-space lights are
+// written over point_lights, from lighting.glsl, which the lighting reads.
+
+#include "lighting.glsl"
+
+layout (local_size_x = GROUP_SIZE) in;
+
+// State of a light, in world space
+struct SwarmLight {
+    vec3 position;
+    float lifetime;  // seconds left, the light respawns at zero
+    vec3 velocity;
+    float duration;  // seconds from its spawn to its end
+    vec3 color;
+    float padding;
+};
+
+layout (std430) buffer SwarmLightsBlock {
+    SwarmLight swarm_lights[];
+};
+
+uniform mat4 world_to_view;
+uniform float time_step;
+uniform int swarm_frame;
+uniform int n_swarm_lights;
+uniform vec3 box_min;
+uniform vec3 box_max;
+uniform float light_range;
+
+// Speed around the axis, in units per second, and the pull towards the
+// middle height, per second squared and unit of distance
+const float SWIRL_SPEED = 4.0;
+const float HEIGHT_PULL = 0.5;
+
+// Lifetimes of the lights, in seconds, and the time they take to fade
+const float MIN_DURATION = 2.0;
+const float MAX_DURATION = 8.0;
+const float FADE_TIME = 0.5;
+
+// Obtains a random number in [0, 1) from a state, which it advances (PCG)
+float random(inout uint state) {
+    state = state * 747796405u + 2891336453u;
+    uint word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+    return float((word >> 22u) ^ word) / 4294967296.0;
+}
+
+// Spawns a light at a random point of the box
+SwarmLight spawn(inout uint state) {
+    SwarmLight S;
+    vec3 t = vec3(random(state), random(state), random(state));
+    S.position = mix(box_min, box_max, t);
+    float angle = random(state) * 6.2831853;
+    S.velocity = vec3(cos(angle), random(state) - 0.5, sin(angle));
+    S.duration = mix(MIN_DURATION, MAX_DURATION, random(state));
+    S.lifetime = S.duration;
+    // Saturated colors, one channel at full intensity
+    vec3 color = vec3(random(state), random(state), random(state));
+    S.color = color / max(max(color.r, color.g), max(color.b, 1e-3));
+    S.padding = 0;
+    return S;
+}
+
+void main() {
+    int i = int(gl_GlobalInvocationID.x);
+    if (i >= n_swarm_lights)
+        return;
+    SwarmLight S = swarm_lights[i];
+    if (S.lifetime <= 0) {
+        uint state = uint(i) * 9781u + uint(swarm_frame) * 6271u;
+        S = spawn(state);
+    } else {
+        vec3 center = (box_min + box_max) * 0.5;
+        vec3 radial = vec3(S.position.x - center.x, 0, S.position.z - center.z);
+        vec3 tangent = normalize(vec3(-radial.z, 0, radial.x) + 1e-6);
+        vec3 target = tangent * SWIRL_SPEED;
+        target.y = (center.y - S.position.y) * HEIGHT_PULL;
+        S.velocity = mix(S.velocity, target, min(time_step, 1.0));
+        S.position += S.velocity * time_step;
+        bvec3 below = lessThan(S.position, box_min);
+        bvec3 above = greaterThan(S.position, box_max);
+        S.velocity = mix(S.velocity, -S.velocity, bvec3(ivec3(below) |
+                                                         ivec3(above)));
+        S.position = clamp(S.position, box_min, box_max);
+        S.lifetime -= time_step;
+    }
+    swarm_lights[i] = S;
+
+    float age = S.duration - S.lifetime;
+    float fade = clamp(min(age, S.lifetime) / FADE_TIME, 0, 1);
+    PointLight L;
+    L.position = vec3(world_to_view * vec4(S.position, 1));
+    L.range = light_range;
+    L.diffuse = S.color * fade;
+    L.specular = 0.5 * fade;
+    point_lights[i] = L;
+}
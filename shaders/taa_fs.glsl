@@ -0,0 +1,97 @@
+/*
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#version 450
+
+// Resolve of the temporal antialiasing: the lit image, rendered with a
+// sub-pixel jitter that changes every frame, is blended with the resolved
+// image of the last frame. The history is reprojected from the depth of the
+// nearest pixel around, with the camera motion only since the instances
+// don't move, and clamped to the colors around the pixel so the history of
+// what was hidden or has changed is rejected. The lit image may be smaller
+// than the output (see --render-scale and --dynamic-resolution): each output
+// pixel takes the lit sample nearest to its center, weighted by its
+// distance, so the jittered samples of the frames fill the output pixels.
+
+// Lit image, the G-buffer depth and the history, with linear samplers but
+// for the depth
+layout(binding = 0) uniform sampler2D lit_texture;
+layout(binding = 1) uniform sampler2D depth_texture;
+layout(binding = 2) uniform sampler2D history_texture;
+
+// From the normalized device coordinates of the frame, without the jitter,
+// to the clip coordinates of the last one
+uniform mat4 reprojection;
+
+// Size of the lit image inside its texture, and its jitter in lit pixels
+uniform vec2 lit_size;
+uniform vec2 jitter;
+
+// Size of the history inside its texture, the one of the output
+uniform vec2 history_size;
+
+// Weight of the history with a sample at the pixel center, 0 when there is
+// none
+uniform float history_weight;
+
+// Output color
+out vec3 color;
+
+void main() {
+    // Lit pixel whose sample is the nearest, and the distance from the sample
+    // to the center of the output pixel in output pixels
+    vec2 lit_per_pixel = lit_size / history_size;
+    vec2 center = gl_FragCoord.xy * lit_per_pixel;
+    ivec2 max_coord = ivec2(lit_size) - 1;
+    ivec2 coord = clamp(ivec2(floor(center - jitter)), ivec2(0), max_coord);
+    vec2 offset = (vec2(coord) + 0.5 + jitter - center) / lit_per_pixel;
+    float sample_weight = exp(-2.0 * dot(offset, offset));
+
+    vec3 current = texelFetch(lit_texture, coord, 0).rgb;
+    vec3 color_min = current;
+    vec3 color_max = current;
+    float depth = texelFetch(depth_texture, coord, 0).r;
+    for (int i = 0; i < 9; ++i) {
+        ivec2 tap = clamp(coord + ivec2(i % 3 - 1, i / 3 - 1), ivec2(0),
+                          max_coord);
+        vec3 tap_color = texelFetch(lit_texture, tap, 0).rgb;
+        color_min = min(color_min, tap_color);
+        color_max = max(color_max, tap_color);
+        depth = min(depth, texelFetch(depth_texture, tap, 0).r);
+    }
+
+    // The nearest depth keeps the edges of the foreground moving with it
+    vec2 ndc = gl_FragCoord.xy / history_size * 2.0 - 1.0;
+    vec4 last = reprojection * vec4(ndc, depth * 2.0 - 1.0, 1.0);
+    vec2 last_uv = (last.xy / last.w) * 0.5 + 0.5;
+    float current_weight = 1.0;
+    if (history_weight > 0.0 && all(greaterThanEqual(last_uv, vec2(0.0))) &&
+        all(lessThanEqual(last_uv, vec2(1.0))))
+        current_weight = (1.0 - history_weight) * sample_weight;
+    vec2 texel = 1.0 / vec2(textureSize(history_texture, 0));
+    vec2 history_uv = min(last_uv * history_size * texel,
+                          (history_size - 0.5) * texel);
+    vec3 history = textureLod(history_texture, history_uv, 0).rgb;
+    color = mix(clamp(history, color_min, color_max), current, current_weight);
+}
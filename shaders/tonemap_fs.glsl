@@ -0,0 +1,70 @@
+/*
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#version 450
+
+// Tone mapping of the HDR lit image into the backbuffer (see --hdr): the
+// color, blended with its glow (see Bloom) and scaled by the exposure, is
+// kept as is up to a shoulder and above it rolls off towards one instead of
+// clipping, per channel so the brightest lights go to white. The lit image
+// may be smaller than the backbuffer (see --dynamic-resolution), it's then
+// upscaled bilinearly.
+
+// Lit image and its glow, with linear samplers
+layout(binding = 0) uniform sampler2D lit_texture;
+layout(binding = 1) uniform sampler2D bloom_texture;
+
+// Size of the lit image inside its texture, and of the backbuffer
+uniform vec2 lit_size;
+uniform vec2 output_size;
+
+// Size of the glow inside its texture, and its weight
+uniform vec2 bloom_size;
+uniform float bloom_strength;
+
+// Scale of the lit color
+uniform float exposure;
+
+// Value where the roll-off starts
+const float SHOULDER = 0.6;
+
+// Output color
+out vec3 color;
+
+// Samples a texture, using its lower left rectangle of a size, at the pixel
+vec3 sample_scaled(sampler2D tex, vec2 size) {
+    vec2 texel = 1.0 / vec2(textureSize(tex, 0));
+    vec2 uv = min(gl_FragCoord.xy * size / output_size * texel,
+                  (size - 0.5) * texel);
+    return textureLod(tex, uv, 0).rgb;
+}
+
+void main() {
+    vec3 lit = sample_scaled(lit_texture, lit_size);
+    vec3 glow = sample_scaled(bloom_texture, bloom_size);
+    vec3 hdr = mix(lit, glow, bloom_strength) * exposure;
+    vec3 rolled = SHOULDER + (1.0 - SHOULDER) *
+                  (1.0 - exp(-(hdr - SHOULDER) / (1.0 - SHOULDER)));
+    color = mix(hdr, rolled, greaterThan(hdr, vec3(SHOULDER)));
+}
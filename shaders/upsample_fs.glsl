@@ -0,0 +1,91 @@
+/*
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#version 450
+
+// Upsamples the lighting shaded at a lower resolution with a bilateral
+// filter: the four nearest lit pixels are weighted bilinearly and by how
+// close their G-buffer depth and normal are to the ones of the pixel. The
+// G-buffer samplers and read_gbuffer() are generated from the layout (see
+// GBufferLayout) and the background color comes from lighting.glsl.
+
+#include "lighting.glsl"
+
+// Lighting shaded at the lower resolution, after the G-buffer units
+layout(binding = GBUFFER_TEXTURES) uniform sampler2D lit_texture;
+
+// G-buffer pixels per lit pixel
+uniform vec2 lit_pixel_size;
+
+// Relative depth difference where the weight of a lit pixel falls to 1/e
+const float DEPTH_SIGMA = 0.02;
+
+// Exponent of the normal similarity
+const float NORMAL_POWER = 8;
+
+// Output color
+out vec3 color;
+
+void main() {
+    ivec2 coord = ivec2(gl_FragCoord.xy);
+    vec3 position, normal;
+    int material;
+    if (!read_gbuffer(coord, 0, position, normal, material)) {
+        color = background;
+        return;
+    }
+
+    ivec2 lit_size = textureSize(lit_texture, 0);
+    vec2 lit_coord = gl_FragCoord.xy / lit_pixel_size - 0.5;
+    ivec2 base = ivec2(floor(lit_coord));
+    vec2 f = lit_coord - vec2(base);
+    vec3 acc_color = vec3(0, 0, 0);
+    float acc_weight = 0;
+    for (int i = 0; i < 4; ++i) {
+        ivec2 offset = ivec2(i & 1, i >> 1);
+        ivec2 tap = clamp(base + offset, ivec2(0), lit_size - 1);
+
+        // G-buffer pixel where the lit pixel was shaded (see lightpass_fs)
+        vec2 pixel = floor((vec2(tap) + 0.5) * lit_pixel_size);
+        vec3 tap_position, tap_normal;
+        int tap_material;
+        if (!read_gbuffer(ivec2(pixel), 0, tap_position, tap_normal,
+                          tap_material))
+            continue;
+        vec2 bilinear = mix(1 - f, f, vec2(offset));
+        float depth_diff = abs(tap_position.z - position.z) / -position.z;
+        float weight = bilinear.x * bilinear.y *
+                       exp(-depth_diff / DEPTH_SIGMA) *
+                       pow(max(dot(normal, tap_normal), 0), NORMAL_POWER);
+        acc_color += weight * texelFetch(lit_texture, tap, 0).rgb;
+        acc_weight += weight;
+    }
+
+    // Without a similar neighbor the nearest lit pixel is used
+    if (acc_weight > 1e-4)
+        color = acc_color / acc_weight;
+    else
+        color = texelFetch(lit_texture, clamp(ivec2(round(lit_coord)),
+                                              ivec2(0), lit_size - 1), 0).rgb;
+}
@@ -0,0 +1,202 @@
+/*
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#version 450
+#ifdef BINDLESS_MAPS
+#extension GL_ARB_bindless_texture : require
+#endif
+
+// Resolve of the visibility buffer into the G-buffer: each pixel of a batch
+// fetches the vertices of its triangle, rebuilds the perspective-correct
+// barycentrics of its center and their screen derivatives analytically, and
+// writes the interpolated attributes as the geometry pass would. The pixels
+// of the other batches and of the background are discarded. The G-buffer
+// outputs and write_gbuffer() are generated from the layout (see
+// GBufferLayout).
+
+// Materials information, as in lighting.glsl
+struct Material {
+    vec3 diffuse;
+    int diffuse_map;
+    vec3 ambient;
+    vec3 specular;
+    float shininess;
+};
+
+layout (std430) readonly buffer MaterialsBlock {
+    Material materials[];
+};
+
+// Camera matrices, as in geometry.glsl
+layout (std140) uniform CameraBlock {
+    mat4 view;
+    mat4 projection;
+    mat4 view_projection;
+};
+
+#include "models.glsl"
+
+// Draws and commands of the meshlets of the batch (see MeshBatch)
+struct Draw {
+    vec4 dequantization;
+    int material_id;
+    int first_instance;
+};
+
+layout (std430) readonly buffer DrawsBlock {
+    Draw draws[];
+};
+
+struct Command {
+    uint count;
+    uint instance_count;
+    uint first_index;
+    int base_vertex;
+    uint base_instance;
+};
+
+layout (std430) readonly buffer CommandsBlock {
+    Command commands[];
+};
+
+// Index in models of the instances drawn by the early and the late passes
+layout (std430) readonly buffer InstancesBlock {
+    int instances[];
+};
+
+layout (std430) readonly buffer LateInstancesBlock {
+    int late_instances[];
+};
+
+// Vertices of the meshes, as MeshBatch::Vertex: the position as snorm16 with
+// the material offset in w, the normal as signed 2_10_10_10 and the texture
+// coordinates as halfs
+layout (std430) readonly buffer VisibilityVerticesBlock {
+    uvec4 vertices[];
+};
+
+// Indices of the meshes, two per word if short_indices
+layout (std430) readonly buffer VisibilityIndicesBlock {
+    uint indices[];
+};
+
+uniform bool short_indices;
+
+#include "diffuse_maps.glsl"
+
+layout(binding = 1) uniform usampler2D visibility_texture;
+layout(binding = 2) uniform sampler2D depth_texture;
+
+// Bit of the batch resolved in the identifiers
+uniform int batch_tag;
+
+uniform vec2 gbuffer_size;
+
+// Obtains an index of the meshes
+uint fetch_index(uint i) {
+    if (!short_indices)
+        return indices[i];
+    return (indices[i >> 1] >> ((i & 1u) * 16u)) & 0xFFFFu;
+}
+
+float cross2(vec2 a, vec2 b) {
+    return a.x * b.y - a.y * b.x;
+}
+
+// Perspective-correct barycentrics of a point in normalized device
+// coordinates inside a triangle given in clip space
+vec3 compute_barycentrics(vec4 clip[3], vec2 ndc) {
+    vec2 p0 = clip[0].xy / clip[0].w;
+    vec2 p1 = clip[1].xy / clip[1].w;
+    vec2 p2 = clip[2].xy / clip[2].w;
+    vec3 screen = vec3(cross2(p1 - ndc, p2 - ndc), cross2(p2 - ndc, p0 - ndc),
+                       cross2(p0 - ndc, p1 - ndc)) /
+                  cross2(p1 - p0, p2 - p0);
+    vec3 perspective = screen / vec3(clip[0].w, clip[1].w, clip[2].w);
+    return perspective / (perspective.x + perspective.y + perspective.z);
+}
+
+void main() {
+    ivec2 coord = ivec2(gl_FragCoord.xy);
+    if (texelFetch(depth_texture, coord, 0).r == 1)
+        discard;
+    uvec2 id = texelFetch(visibility_texture, coord, 0).rg;
+    if ((id.y & (1u << 30)) != uint(batch_tag))
+        discard;
+    bool late = (id.y >> 31) != 0u;
+    int command = int((id.y >> 7) & 0x7FFFFFu);
+    uint triangle = id.y & 0x7Fu;
+    int model_index = late ? late_instances[id.x] : instances[id.x];
+    mat4 model = model_matrix(model_index);
+    Draw draw = draws[command];
+    Command C = commands[command];
+
+    vec3 positions[3];
+    vec3 normals[3];
+    vec2 texcoords[3];
+    vec4 clip[3];
+    int material_offset = 0;
+    for (int k = 0; k < 3; ++k) {
+        uint index = fetch_index(C.first_index + 3u * triangle + uint(k));
+        uvec4 vertex = vertices[int(index) + C.base_vertex];
+        vec4 position = vec4(unpackSnorm2x16(vertex.x),
+                             unpackSnorm2x16(vertex.y));
+        vec3 mesh_position = position.xyz * draw.dequantization.w +
+                             draw.dequantization.xyz;
+        vec4 world_position = model * vec4(mesh_position, 1);
+        clip[k] = view_projection * world_position;
+        positions[k] = vec3(view * world_position);
+        int packed_normal = int(vertex.z);
+        ivec3 normal = ivec3(bitfieldExtract(packed_normal, 0, 10),
+                             bitfieldExtract(packed_normal, 10, 10),
+                             bitfieldExtract(packed_normal, 20, 10));
+        normals[k] = max(vec3(normal) / 511.0, vec3(-1));
+        texcoords[k] = unpackHalf2x16(vertex.w);
+        // The provoking vertex gives the material, as in the geometry pass
+        if (k == 2)
+            material_offset = int(round(position.w * 32767.0));
+    }
+
+    // The derivatives of the texture coordinates come from the barycentrics
+    // of the next pixels, since the next pixels may belong to other triangles
+    vec2 pixel = 2 / gbuffer_size;
+    vec2 ndc = gl_FragCoord.xy * pixel - 1;
+    vec3 b = compute_barycentrics(clip, ndc);
+    vec3 b_dx = compute_barycentrics(clip, ndc + vec2(pixel.x, 0));
+    vec3 b_dy = compute_barycentrics(clip, ndc + vec2(0, pixel.y));
+    mat3x2 uv = mat3x2(texcoords[0], texcoords[1], texcoords[2]);
+    vec2 texcoord = uv * b;
+
+    vec3 position = mat3(positions[0], positions[1], positions[2]) * b;
+    vec3 mesh_normal = mat3(normals[0], normals[1], normals[2]) * b;
+    // The instances are only rotated and translated (see geompass_vs)
+    vec3 normal = normalize(mat3(view) * (mat3(model) * mesh_normal));
+    int material_id = draw.material_id + material_offset;
+    int layer = materials[material_id].diffuse_map;
+    vec3 albedo = vec3(1);
+    if (layer >= 0)
+        albedo = sample_diffuse_map_grad(layer, texcoord, uv * b_dx - texcoord,
+                                         uv * b_dy - texcoord).rgb;
+    write_gbuffer(position, normal, material_id, albedo);
+}
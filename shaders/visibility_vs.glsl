@@ -0,0 +1,52 @@
+/*
+ * The MIT License (MIT)
+ * 
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ * 
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#version 450
+#extension GL_ARB_shader_draw_parameters : require
+
+// Vertex stage of the visibility buffer (--visibility-buffer), which only
+// reads the position: the fragments store which triangle of which instance
+// they are (see visibility_fs), and the resolve pass fetches the rest.
+
+#include "geometry.glsl"
+
+// Position quantized to the bounds of the mesh
+layout(location = 0) in vec4 position;
+
+// Same as in the geometry pass
+invariant gl_Position;
+
+// Bits of the batch and the culling pass of the draws in the identifier
+uniform int visibility_tag;
+
+// Slot of the instance in InstancesBlock, and the tag with the command
+flat out uvec2 frag_visibility;
+
+void main() {
+    Draw draw = draws[draw_index()];
+    vec4 world_position = transform_position(instance_model(), position);
+    gl_Position = view_projection * world_position;
+    frag_visibility = uvec2(draw.first_instance + gl_InstanceID,
+                            uint(visibility_tag) | (uint(draw_index()) << 7));
+}
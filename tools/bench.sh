@@ -0,0 +1,129 @@
+#!/bin/sh
+# The MIT License (MIT)
+# 
+# Copyright (c) 2016 Gabriel de Quadros Ligneul
+# 
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+# 
+# The above copyright notice and this permission notice shall be included in all
+# copies or substantial portions of the Software.
+# 
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+
+# Runs the benchmark (see --benchmark in README.md) over sweeps of the light
+# count, the bear count, the resolution, the G-buffer layout, the antialiasing,
+# the temporal upscaling and the depth pre-pass, one at a time from the
+# default scene, and writes to stdout a CSV table with a row per run: the
+# sweep, the swept value, the frame rate, the percentiles of the frame and gpu
+# times, the largest error of the fast lighting (zero without it) and the
+# average gpu time of every pass, as name=ms separated by spaces since the
+# passes depend on the options.
+#
+# BENCH_FRAMES sets the frames of each run (300 by default) and BENCH_ARGS
+# options added to every run, e.g. BENCH_ARGS=--lighting=clustered.
+
+set -e
+
+app=${1:-./app}
+frames=${BENCH_FRAMES:-300}
+results=$(mktemp)
+trap 'rm -f "$results"' EXIT
+
+# Prints a number of the results, given the key of its line and of its field
+field() {
+  sed -n "s/.*\"$1\": {.*\"$2\": \([0-9.]*\).*/\1/p" "$results"
+}
+
+# Runs the benchmark with the options after the sweep name and value
+run() {
+  sweep=$1
+  value=$2
+  shift 2
+  "$app" --benchmark="$frames" --benchmark-output="$results" $BENCH_ARGS \
+    "$@" > /dev/null
+  fps=$(sed -n 's/.*"fps": \([0-9.]*\).*/\1/p' "$results")
+  passes=$(sed -n '/"passes_ms"/,/}/s/ *"\(.*\)": \([0-9][0-9.]*\).*/\1=\2/p' \
+    "$results" | tr '\n' ' ' | sed 's/ $//')
+  echo "$sweep,$value,$fps,$(field frame_ms p50),$(field frame_ms p99)," \
+    "$(field gpu_ms p50),$(field gpu_ms p99),$(field lighting_error max)," \
+    "$passes" | sed 's/, /,/g'
+}
+
+echo "sweep,value,fps,frame_p50_ms,frame_p99_ms,gpu_p50_ms,gpu_p99_ms," \
+  "lighting_error,passes" | sed 's/, /,/g'
+
+# 100 to 100k lights over the default 100 bears
+for lights in 10x10 32x32 100x100 316x316; do
+  run lights "$lights" --lights="$lights" --bears=10x10
+done
+
+# 100 to 100k bears under the default 100 lights
+for bears in 10x10 32x32 100x100 316x316; do
+  run bears "$bears" --bears="$bears"
+done
+
+# 720p to 4K
+for window in 1280x720 1920x1080 2560x1440 3840x2160; do
+  run resolution "$window" --window="$window"
+done
+
+for gbuffer in reference default compact packed packed-oct; do
+  run gbuffer "$gbuffer" --gbuffer="$gbuffer"
+done
+
+# Post-processing antialiasing at 1080p
+run antialiasing off --window=1920x1080
+for fxaa in low high; do
+  run antialiasing "fxaa-$fxaa" --window=1920x1080 --fxaa="$fxaa"
+done
+run antialiasing taa --window=1920x1080 --taa
+
+# Internal resolution upscaled by the temporal antialiasing at 4K
+for scale in 0.5 0.67 0.77 1; do
+  run upscaling "$scale" --window=3840x2160 --taa --render-scale="$scale"
+done
+
+# Over the bears, where the geometry pass shades the most hidden fragments
+run prepass off --bears=100x100
+run prepass on --bears=100x100 --depth-prepass
+
+# Half resolution ambient occlusion at 4K
+run ssao off --window=3840x2160
+run ssao on --window=3840x2160 --ssao
+
+# Full-screen triangle against compute dispatch of the same lighting
+for lighting in fullscreen clustered; do
+  run compute-lighting "$lighting-fragment" --lighting=$lighting
+  run compute-lighting "$lighting-compute" --lighting=$lighting \
+    --compute-lighting
+done
+
+# Clustered lists against the sampled and the cut light tree, 10k to 100k
+# lights
+for lights in 100x100 316x316; do
+  run many-lights "$lights-clustered" --lights="$lights" --lighting=clustered
+  run many-lights "$lights-stochastic" --lights="$lights" \
+    --lighting=stochastic --taa
+  run many-lights "$lights-lightcuts" --lights="$lights" --lighting=lightcuts
+done
+
+# Exact against fast lighting terms, where the light loops dominate
+for lights in 32x32 100x100; do
+  for lighting in fullscreen clustered; do
+    run fast-lighting "$lights-$lighting-exact" --lights="$lights" \
+      --lighting=$lighting
+    run fast-lighting "$lights-$lighting-fast" --lights="$lights" \
+      --lighting=$lighting --fast-lighting
+  done
+done
@@ -0,0 +1,73 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Compresses the diffuse maps to BC1 with every mipmap, writing a KTX2 file
+// next to each PNG one; the renderer loads them instead when they have the
+// size of its maps
+//
+// Usage: compress_textures --size=<texels> <file.png>...
+
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+
+#include <lodepng.h>
+
+#include "../TextureCompression.h"
+
+int main(int argc, char* argv[]) {
+  int size = 1024;
+  int failures = 0;
+  for (int i = 1; i < argc; ++i) {
+    if (sscanf(argv[i], "--size=%d", &size) == 1) {
+      if (size <= 0 || (size & (size - 1))) {
+        fprintf(stderr, "The size must be a power of two: %s\n", argv[i]);
+        return 1;
+      }
+      continue;
+    }
+    std::vector<unsigned char> image;
+    unsigned width, height;
+    unsigned error = lodepng::decode(image, width, height, argv[i]);
+    if (error) {
+      fprintf(stderr, "Unable to decode texture %s: %s\n", argv[i],
+              lodepng_error_text(error));
+      failures++;
+      continue;
+    }
+    auto levels = BuildMipmaps(ResampleImage(image, width, height, size), size);
+    for (size_t level = 0; level < levels.size(); ++level)
+      levels[level] = CompressBC1(levels[level], size >> level);
+    auto path = GetKtx2Path(argv[i]);
+    try {
+      WriteKtx2(path, size, levels);
+    } catch (std::exception& e) {
+      fprintf(stderr, "%s\n", e.what());
+      failures++;
+      continue;
+    }
+    printf("%s: %dx%d, %zu levels\n", path.c_str(), size, size, levels.size());
+  }
+  return failures ? 1 : 0;
+}
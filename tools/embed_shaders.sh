@@ -0,0 +1,51 @@
+#!/bin/sh
+# The MIT License (MIT)
+# 
+# Copyright (c) 2016 Gabriel de Quadros Ligneul
+# 
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+# 
+# The above copyright notice and this permission notice shall be included in all
+# copies or substantial portions of the Software.
+# 
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+
+# Writes to stdout the C++ source of the embedded_shaders table (see
+# EmbeddedShaders.h) with every .glsl file of the directory, keyed by its path
+# as the application opens it, e.g. "shaders/lighting.glsl".
+
+set -e
+
+dir=${1:-shaders}
+
+echo "// Generated by tools/embed_shaders.sh from $dir/, do not edit"
+echo
+echo '#include "EmbeddedShaders.h"'
+echo
+echo 'const EmbeddedShader embedded_shaders[] = {'
+n=0
+for file in "$dir"/*.glsl; do
+  if grep -q ')glsl"' "$file"; then
+    echo "$file: contains the raw string delimiter" >&2
+    exit 1
+  fi
+  # The source starts right after the delimiter to keep its line numbers
+  printf '    {"%s", R"glsl(' "$file"
+  cat "$file"
+  echo ')glsl"},'
+  n=$((n + 1))
+done
+echo '};'
+echo
+echo "const int n_embedded_shaders = $n;"
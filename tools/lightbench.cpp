@@ -0,0 +1,281 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Replays the lighting pass of a frame dumped by the application with
+// --dump-gbuffer=<file>, alone, in a hidden window: the G-buffer textures,
+// its code and the buffers of the materials and the lights are uploaded as
+// they were, and the pass of a lighting mode runs n times over them into a
+// target of the size of the G-buffer, with the gpu time per pass printed.
+// The geometry, the shadows and the other passes aren't in the dump, so a
+// change of lightpass_fs.glsl or lightpass_cs.glsl is measured without them.
+//
+// Usage: lightbench [--lighting=<fullscreen|tiled|clustered>] [--compute]
+//                   [--iterations=<n>] <dump>
+
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "../GLCheck.h"
+#include <GLFW/glfw3.h>
+
+#include "../BufferBindings.h"
+#include "../GBufferDump.h"
+#include "../GLState.h"
+#include "../LightClusters.h"
+#include "../ShaderProgram.h"
+#include "../UniformBuffer.h"
+#include "../VertexArray.h"
+
+namespace {
+
+// Passes before the timed ones, so the driver has compiled its state
+const int WARMUP_DIVISOR = 10;
+
+enum LightingMode { LIGHTING_FULLSCREEN, LIGHTING_TILED, LIGHTING_CLUSTERED };
+
+// Times n runs of a pass, and prints the gpu time per run and per pixel
+template <typename Pass>
+void Measure(const char* name, int n, int pixels, unsigned int query,
+             Pass pass) {
+  for (int i = 0; i < n / WARMUP_DIVISOR; ++i)
+    pass();
+  glFinish();
+  glBeginQuery(GL_TIME_ELAPSED, query);
+  for (int i = 0; i < n; ++i)
+    pass();
+  glEndQuery(GL_TIME_ELAPSED);
+  GLuint64 gpu_ns = 0;
+  glGetQueryObjectui64v(query, GL_QUERY_RESULT, &gpu_ns);
+  printf("%-24s %10d %12.4f %12.3f\n", name, n, gpu_ns / 1e6 / n,
+         (double)gpu_ns / n / pixels);
+}
+
+// Creates the hidden window whose context the passes go to
+GLFWwindow* InitContext() {
+  if (!glfwInit())
+    throw std::runtime_error("glfw couldn't be initialized");
+  glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
+  glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+  auto window = glfwCreateWindow(64, 64, "lightbench", nullptr, nullptr);
+  if (!window)
+    throw std::runtime_error("glfw window couldn't be created");
+  glfwMakeContextCurrent(window);
+  glfwSwapInterval(0);
+  // Without it GLEW looks the extensions up with glGetString, which core
+  // profiles reject
+  glewExperimental = GL_TRUE;
+  if (glewInit() != GLEW_OK)
+    throw std::runtime_error("GLEW couldn't be initialized");
+  return window;
+}
+
+// Creates an immutable buffer with the bytes of a dump
+unsigned int CreateBuffer(const std::vector<unsigned char>& bytes) {
+  unsigned int buffer;
+  glCreateBuffers(1, &buffer);
+  glNamedBufferStorage(buffer, bytes.size(), bytes.data(), 0);
+  return buffer;
+}
+
+// Uploads the dump and runs its lighting pass n times
+void RunBenchmark(const GBufferDump& dump, LightingMode mode, bool compute,
+                  int n) {
+  int width = dump.width;
+  int height = dump.height;
+
+  // The G-buffer in the units of the generated code: the attachments and
+  // then the depth
+  std::vector<unsigned int> textures(dump.textures.size() + 1);
+  glCreateTextures(GL_TEXTURE_2D, textures.size(), textures.data());
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+  for (size_t i = 0; i < dump.textures.size(); ++i) {
+    auto& texture = dump.textures[i];
+    glTextureStorage2D(textures[i], 1, texture.internal_format, width,
+                       height);
+    glTextureSubImage2D(textures[i], 0, 0, 0, width, height,
+                        texture.base_format, texture.type,
+                        texture.pixels.data());
+  }
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  glTextureStorage2D(textures.back(), 1, GL_DEPTH_COMPONENT32F, width, height);
+  glTextureSubImage2D(textures.back(), 0, 0, 0, width, height,
+                      GL_DEPTH_COMPONENT, GL_FLOAT, dump.depth.data());
+  unsigned int sampler;
+  glCreateSamplers(1, &sampler);
+  glSamplerParameteri(sampler, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glSamplerParameteri(sampler, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glSamplerParameteri(sampler, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glSamplerParameteri(sampler, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  std::vector<unsigned int> samplers(textures.size(), sampler);
+  GLState::BindTextures(0, textures.size(), textures.data());
+  GLState::BindSamplers(0, samplers.size(), samplers.data());
+
+  // The point lights are in a uniform buffer, as the clusters read them
+  auto materials = CreateBuffer(dump.materials);
+  auto spot_lights = CreateBuffer(dump.spot_lights);
+  UniformBuffer lights;
+  lights.Init(UniformBuffer::STORAGE, UniformBuffer::STATIC);
+  memcpy(lights.Map(dump.lights.size()), dump.lights.data(),
+         dump.lights.size());
+  lights.Unmap();
+  ShaderProgram::BindStorageBuffer(buffer_bindings::MATERIALS, materials);
+  ShaderProgram::BindStorageBuffer(buffer_bindings::LIGHTS, lights.GetId(),
+                                   lights.GetOffset(), lights.GetSize());
+  ShaderProgram::BindStorageBuffer(buffer_bindings::SPOT_LIGHTS, spot_lights);
+
+  // The blocks are bound when the programs link
+  ShaderProgram::RegisterBlockBinding("MaterialsBlock",
+                                      buffer_bindings::MATERIALS);
+  ShaderProgram::RegisterBlockBinding("LightsBlock", buffer_bindings::LIGHTS);
+  ShaderProgram::RegisterBlockBinding("SpotLightsBlock",
+                                      buffer_bindings::SPOT_LIGHTS);
+  LightClusters clusters;
+  if (mode == LIGHTING_CLUSTERED)
+    clusters.Init(dump.cluster_grid);
+
+  ShaderProgram::Defines defines;
+  if (mode == LIGHTING_CLUSTERED)
+    defines["CLUSTERED"] = "";
+  ShaderProgram program;
+  if (compute || mode == LIGHTING_TILED) {
+    defines["TILE_SIZE"] = std::to_string(dump.tile_size);
+    defines["LIT_FORMAT"] = "rgba16f";
+    if (mode == LIGHTING_FULLSCREEN)
+      defines["ALL_LIGHTS"] = "";
+    if (ShaderProgram::IsSubgroupSupported())
+      defines["SUBGROUPS"] = "";
+    program.LoadComputeShader(
+        "shaders/lightpass_cs.glsl",
+        ShaderProgram::GenerateDefines(defines) + dump.lighting_code);
+  } else {
+    program.LoadVertexShader("shaders/lightpass_vs.glsl");
+    program.LoadFragmentShader(
+        "shaders/lightpass_fs.glsl",
+        ShaderProgram::GenerateDefines(defines) + dump.lighting_code);
+  }
+  program.LinkShader();
+
+  unsigned int lit, framebuffer;
+  glCreateTextures(GL_TEXTURE_2D, 1, &lit);
+  glTextureStorage2D(lit, 1, GL_RGBA16F, width, height);
+  glCreateFramebuffers(1, &framebuffer);
+  glNamedFramebufferTexture(framebuffer, GL_COLOR_ATTACHMENT0, lit, 0);
+  glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+  glViewport(0, 0, width, height);
+  VertexArray screen_triangle;
+  screen_triangle.Init();
+
+  unsigned int query;
+  glGenQueries(1, &query);
+  printf("%-24s %10s %12s %12s\n", "pass", "runs", "gpu ms", "gpu ns/pixel");
+  int pixels = width * height;
+  if (mode == LIGHTING_CLUSTERED)
+    Measure("cluster assignment", n, pixels, query, [&] {
+      clusters.Update(dump.projection, dump.z_near, dump.z_far, width,
+                      height, &lights, spot_lights);
+    });
+  program.Enable();
+  program.SetUniform("inv_projection", glm::inverse(dump.projection));
+  program.SetUniform("gbuffer_size", glm::vec2(width, height));
+  if (mode == LIGHTING_CLUSTERED)
+    clusters.Bind(&program);
+  if (compute || mode == LIGHTING_TILED) {
+    glBindImageTexture(0, lit, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+    program.SetUniform("lit_image", 0);
+    int tile = dump.tile_size;
+    Measure("lighting compute", n, pixels, query, [&] {
+      glDispatchCompute((width + tile - 1) / tile, (height + tile - 1) / tile,
+                        1);
+    });
+  } else {
+    Measure("lighting fragment", n, pixels, query,
+            [&] { screen_triangle.DrawArrays(GL_TRIANGLES, 3); });
+  }
+
+  glDeleteQueries(1, &query);
+  glDeleteFramebuffers(1, &framebuffer);
+  glDeleteTextures(1, &lit);
+  glDeleteBuffers(1, &materials);
+  glDeleteBuffers(1, &spot_lights);
+  glDeleteSamplers(1, &sampler);
+  glDeleteTextures(textures.size(), textures.data());
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  int iterations = 1000;
+  LightingMode mode = LIGHTING_FULLSCREEN;
+  bool compute = false;
+  std::string path;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (sscanf(argv[i], "--iterations=%d", &iterations) == 1) {
+      if (iterations <= 0) {
+        fprintf(stderr, "invalid iterations: %s\n", argv[i]);
+        return 1;
+      }
+    } else if (arg == "--lighting=fullscreen") {
+      mode = LIGHTING_FULLSCREEN;
+    } else if (arg == "--lighting=tiled") {
+      mode = LIGHTING_TILED;
+    } else if (arg == "--lighting=clustered") {
+      mode = LIGHTING_CLUSTERED;
+    } else if (arg == "--compute") {
+      compute = true;
+    } else if (arg.compare(0, 2, "--") != 0 && path.empty()) {
+      path = arg;
+    } else {
+      fprintf(stderr, "invalid argument: %s\n", argv[i]);
+      return 1;
+    }
+  }
+  if (path.empty()) {
+    fprintf(stderr,
+            "usage: lightbench [--lighting=<fullscreen|tiled|clustered>] "
+            "[--compute] [--iterations=<n>] <dump>\n");
+    return 1;
+  }
+  try {
+    auto dump = ReadGBufferDump(path);
+    auto window = InitContext();
+    printf("%s, %dx%d G-buffer of %s\n", (const char*)glGetString(GL_RENDERER),
+           dump.width, dump.height, path.c_str());
+    RunBenchmark(dump, mode, compute, iterations);
+    glfwDestroyWindow(window);
+  } catch (std::exception& e) {
+    fprintf(stderr, "%s\n", e.what());
+    glfwTerminate();
+    return 1;
+  }
+  glfwTerminate();
+  return 0;
+}
@@ -0,0 +1,249 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Measures the cost per call of the hot paths of the gl wrappers in a hidden
+// window: the cpu time of the calls, the time glFinish() then takes to drain
+// what the driver queued, and the gpu time of the commands, each divided by
+// the calls. The calls are checked as in the renderer build (see GLCheck.h),
+// so build with -DNDEBUG to measure the release wrappers.
+//
+// Usage: microbench [--iterations=<n>] [<name prefix>...]
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "../GLCheck.h"
+#include <GLFW/glfw3.h>
+
+#include "../GLState.h"
+#include "../ShaderProgram.h"
+#include "../UniformBuffer.h"
+#include "../VertexArray.h"
+
+namespace {
+
+// Calls before the timed ones, so the driver has compiled its state
+const int WARMUP_DIVISOR = 10;
+
+// The names of the benchmarks to run, every one if empty
+std::vector<std::string> prefixes;
+
+// Checks if the benchmark of a name runs
+bool IsSelected(const char* name) {
+  if (prefixes.empty())
+    return true;
+  for (auto& prefix : prefixes)
+    if (strncmp(name, prefix.c_str(), prefix.size()) == 0)
+      return true;
+  return false;
+}
+
+// Times n calls of a body, and prints the times per call
+template <typename Body>
+void Measure(const char* name, int n, unsigned int query, Body body) {
+  if (!IsSelected(name))
+    return;
+  using namespace std::chrono;
+  for (int i = 0; i < n / WARMUP_DIVISOR; ++i)
+    body(i);
+  glFinish();
+  glBeginQuery(GL_TIME_ELAPSED, query);
+  auto begin = steady_clock::now();
+  for (int i = 0; i < n; ++i)
+    body(i);
+  auto submitted = steady_clock::now();
+  glEndQuery(GL_TIME_ELAPSED);
+  glFinish();
+  auto finished = steady_clock::now();
+  GLuint64 gpu_ns = 0;
+  glGetQueryObjectui64v(query, GL_QUERY_RESULT, &gpu_ns);
+  double cpu_ns = duration<double, std::nano>(submitted - begin).count();
+  double drain_ns = duration<double, std::nano>(finished - submitted).count();
+  printf("%-32s %10d %10.1f %10.1f %10.1f\n", name, n, cpu_ns / n,
+         drain_ns / n, (double)gpu_ns / n);
+}
+
+// Creates the hidden window whose context the calls go to
+GLFWwindow* InitContext() {
+  if (!glfwInit())
+    throw std::runtime_error("glfw couldn't be initialized");
+  glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 4);
+  glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 5);
+  glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+  auto window = glfwCreateWindow(64, 64, "microbench", nullptr, nullptr);
+  if (!window)
+    throw std::runtime_error("glfw window couldn't be created");
+  glfwMakeContextCurrent(window);
+  glfwSwapInterval(0);
+  // Without it GLEW looks the extensions up with glGetString, which core
+  // profiles reject
+  glewExperimental = GL_TRUE;
+  if (glewInit() != GLEW_OK)
+    throw std::runtime_error("GLEW couldn't be initialized");
+  return window;
+}
+
+// Runs the benchmarks of the shader uniforms and textures, the buffers and
+// the draws, n calls each
+void RunBenchmarks(int n) {
+  unsigned int query;
+  glGenQueries(1, &query);
+
+  // The occlusion box and the overlay need no vertex attribute, and have
+  // uniforms of every kind measured
+  ShaderProgram program;
+  program.LoadVertexShader("shaders/box_vs.glsl");
+  program.LoadFragmentShader("shaders/hud_fs.glsl");
+  program.LinkShader();
+  program.Enable();
+  ShaderProgram other;
+  other.LoadVertexShader("shaders/box_vs.glsl");
+  other.LinkShader();
+  auto view_projection = program.GetUniform("view_projection");
+  auto box_min = program.GetUniform("box_min");
+  auto hud_scale = program.GetUniform("hud_scale");
+  auto hud_texture = program.GetUniform("hud_texture");
+
+  unsigned int textures[2];
+  glCreateTextures(GL_TEXTURE_2D, 2, textures);
+  for (auto texture : textures)
+    glTextureStorage2D(texture, 1, GL_R8, 16, 16);
+
+  UniformBuffer dynamic, stream;
+  dynamic.Init(UniformBuffer::UNIFORM, UniformBuffer::DYNAMIC);
+  stream.Init(UniformBuffer::UNIFORM, UniformBuffer::STREAM);
+  const int MATRICES = 4;
+  for (int i = 0; i < MATRICES; ++i)
+    dynamic.Add(glm::mat4(1.0f));
+  dynamic.SendToDevice();
+
+  // The 14 vertices of the box strip, indexed
+  std::vector<unsigned int> indices;
+  for (unsigned int i = 0; i < 14; ++i)
+    indices.push_back(i);
+  VertexArray box;
+  box.Init();
+  box.SetElementArray(indices.data(), indices.size());
+
+  printf("%-32s %10s %10s %10s %10s\n", "benchmark", "calls", "cpu ns",
+         "drain ns", "gpu ns");
+  glm::mat4 matrix(1.0f);
+  Measure("SetUniform int", n, query,
+          [&](int i) { program.SetUniform(hud_scale, i); });
+  Measure("SetUniform vec3", n, query, [&](int i) {
+    program.SetUniform(box_min, glm::vec3((float)i));
+  });
+  Measure("SetUniform mat4", n, query, [&](int i) {
+    matrix[3][0] = i;
+    program.SetUniform(view_projection, matrix);
+  });
+  Measure("SetUniform by name", n, query,
+          [&](int i) { program.SetUniform("hud_scale", i); });
+  Measure("GetUniform", n, query,
+          [&](int) { program.GetUniform("view_projection"); });
+  Measure("SetTexture2D", n, query, [&](int i) {
+    program.SetTexture2D(hud_texture, 0, textures[i & 1]);
+  });
+  Measure("SetTexture2D same", n, query,
+          [&](int) { program.SetTexture2D(hud_texture, 0, textures[0]); });
+  Measure("BindUniformBuffer", n, query, [&](int) {
+    ShaderProgram::BindUniformBuffer(0, dynamic.GetId(), dynamic.GetOffset(),
+                                     dynamic.GetSize());
+  });
+  Measure("Enable", n, query, [&](int i) {
+    if (i & 1)
+      other.Enable();
+    else
+      program.Enable();
+  });
+  program.Enable();
+  Measure("UniformBuffer dynamic same", n, query, [&](int) {
+    dynamic.Clear();
+    for (int i = 0; i < MATRICES; ++i)
+      dynamic.Add(matrix);
+    dynamic.SendToDevice();
+  });
+  Measure("UniformBuffer dynamic changed", n, query, [&](int i) {
+    dynamic.Clear();
+    matrix[3][1] = i;
+    for (int j = 0; j < MATRICES; ++j)
+      dynamic.Add(matrix);
+    dynamic.SendToDevice();
+  });
+  Measure("UniformBuffer stream", n, query, [&](int i) {
+    stream.Clear();
+    matrix[3][2] = i;
+    for (int j = 0; j < MATRICES; ++j)
+      stream.Add(matrix);
+    stream.SendToDevice();
+  });
+  Measure("DrawArrays", n, query,
+          [&](int) { box.DrawArrays(GL_TRIANGLE_STRIP, 14); });
+  Measure("DrawInstances", n, query,
+          [&](int) { box.DrawInstances(GL_TRIANGLE_STRIP, 16); });
+  Measure("SetUniform + DrawInstances", n, query, [&](int i) {
+    matrix[3][0] = i;
+    program.SetUniform(view_projection, matrix);
+    box.DrawInstances(GL_TRIANGLE_STRIP, 16);
+  });
+
+  glDeleteTextures(2, textures);
+  glDeleteQueries(1, &query);
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  int iterations = 100000;
+  for (int i = 1; i < argc; ++i) {
+    if (sscanf(argv[i], "--iterations=%d", &iterations) == 1) {
+      if (iterations <= 0) {
+        fprintf(stderr, "invalid iterations: %s\n", argv[i]);
+        return 1;
+      }
+      continue;
+    }
+    prefixes.push_back(argv[i]);
+  }
+  try {
+    auto window = InitContext();
+    printf("%s, GL_CHECKS=%d\n", (const char*)glGetString(GL_RENDERER),
+           GL_CHECKS);
+    RunBenchmarks(iterations);
+    glfwDestroyWindow(window);
+  } catch (std::exception& e) {
+    fprintf(stderr, "%s\n", e.what());
+    glfwTerminate();
+    return 1;
+  }
+  glfwTerminate();
+  return 0;
+}
@@ -0,0 +1,245 @@
+/*
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Gabriel de Quadros Ligneul
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Measures the throughput of the std140 packing of the uniform buffers, in
+// MB/s, for arrays of lights and instance transforms of several sizes, both
+// element by element and as structure arrays, and of finding the ranges a
+// dynamic buffer uploads. It makes no gl call (see Std140Buffer.h), so it
+// runs on machines without a gpu.
+//
+// Usage: pack_bench [--record=<file> | --compare=<file>] [--tolerance=<x>]
+//
+// The best of several runs of every case is kept. --record writes them to a
+// baseline, and --compare prints them against one and exits with 1 when a
+// case is slower by more than the tolerance (0.1 by default, relative).
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "../Std140Buffer.h"
+
+namespace {
+
+// Runs of every case, whose best is kept
+const int RUNS = 5;
+
+// Minimum duration of a run, repeating the case as needed
+const double MIN_RUN_SECONDS = 0.1;
+
+// Elements of the arrays packed
+const int COUNTS[] = {256, 4096, 65536};
+
+// Block size of the changed ranges, the one UniformBuffer uses
+const size_t DIRTY_BLOCK_SIZE = 256;
+
+// Instances moved between two uploads, one in that many
+const int MOVED_INSTANCE_STRIDE = 100;
+
+// Layout of a light in the light blocks
+struct Light {
+  glm::vec4 position_radius;
+  glm::vec4 color;
+};
+
+// Keeps the packed bytes observable, so the packing isn't optimized away
+volatile unsigned char sink;
+
+// A case: its name, the elements packed and its throughput
+struct Case {
+  std::string name;
+  int count;
+  double mbps;
+};
+
+// Best throughput of a packing, in MB/s, given the bytes it packs
+template <typename Body> double Measure(size_t bytes, Body body) {
+  using namespace std::chrono;
+  double best = 0;
+  for (int run = 0; run < RUNS; ++run) {
+    int repetitions = 0;
+    auto begin = steady_clock::now();
+    double seconds = 0;
+    do {
+      body();
+      ++repetitions;
+      seconds = duration<double>(steady_clock::now() - begin).count();
+    } while (seconds < MIN_RUN_SECONDS);
+    best = std::max(best, bytes * repetitions / seconds / 1e6);
+  }
+  return best;
+}
+
+// Measures every case
+std::vector<Case> RunCases() {
+  std::vector<Case> cases;
+  Std140Buffer buffer, previous;
+  std::vector<Std140Buffer::Range> ranges;
+  for (int n : COUNTS) {
+    std::vector<Light> lights(n);
+    std::vector<glm::mat4> instances(n);
+    for (int i = 0; i < n; ++i) {
+      lights[i] = {glm::vec4(i, 0, -i, 1), glm::vec4(1, 0.5f, 0.25f, 0)};
+      instances[i] = glm::mat4(1.0f);
+      instances[i][3] = glm::vec4(i, 0, -i, 1);
+    }
+
+    cases.push_back({"lights_add", n, Measure(n * sizeof(Light), [&]() {
+      buffer.Clear();
+      for (auto& light : lights) {
+        buffer.Add(glm::vec3(light.position_radius));
+        buffer.Add(light.position_radius.w);
+        buffer.Add(glm::vec3(light.color));
+        buffer.FinishChunk();
+      }
+      sink = buffer.GetData()[buffer.GetSize() - 1];
+    })});
+    cases.push_back({"lights_array", n, Measure(n * sizeof(Light), [&]() {
+      buffer.Clear();
+      buffer.AddArray(lights.data(), n);
+      sink = buffer.GetData()[buffer.GetSize() - 1];
+    })});
+    cases.push_back(
+        {"instances_add", n, Measure(n * sizeof(glm::mat4), [&]() {
+          buffer.Clear();
+          for (auto& instance : instances)
+            buffer.Add(instance);
+          sink = buffer.GetData()[buffer.GetSize() - 1];
+        })});
+    cases.push_back(
+        {"instances_array", n, Measure(n * sizeof(glm::mat4), [&]() {
+          buffer.Clear();
+          buffer.AddArray(instances.data(), n);
+          sink = buffer.GetData()[buffer.GetSize() - 1];
+        })});
+
+    // A dynamic buffer of the instances, some of them moved since the last
+    // upload
+    previous.Clear();
+    previous.AddArray(instances.data(), n);
+    for (int i = 0; i < n; i += MOVED_INSTANCE_STRIDE)
+      instances[i][3].y += 1;
+    buffer.Clear();
+    buffer.AddArray(instances.data(), n);
+    cases.push_back(
+        {"instances_changed", n, Measure(n * sizeof(glm::mat4), [&]() {
+          buffer.GetChangedRanges(previous, DIRTY_BLOCK_SIZE, &ranges);
+          sink = (unsigned char)ranges.size();
+        })});
+  }
+  return cases;
+}
+
+// Key of a case in a baseline
+std::string GetKey(const Case& c) {
+  return c.name + " " + std::to_string(c.count);
+}
+
+// Writes the cases to a baseline, returning if it could
+bool Record(const std::vector<Case>& cases, const std::string& path) {
+  std::ofstream file(path);
+  for (auto& c : cases)
+    file << GetKey(c) << " " << c.mbps << "\n";
+  return (bool)file;
+}
+
+// Prints the cases against a baseline, returning if none got slower by more
+// than the tolerance
+bool Compare(const std::vector<Case>& cases, const std::string& path,
+             double tolerance) {
+  std::ifstream file(path);
+  if (!file) {
+    fprintf(stderr, "couldn't read %s\n", path.c_str());
+    return false;
+  }
+  std::map<std::string, double> baseline;
+  std::string name, line;
+  int count;
+  double mbps;
+  while (std::getline(file, line)) {
+    std::istringstream fields(line);
+    if (fields >> name >> count >> mbps)
+      baseline[name + " " + std::to_string(count)] = mbps;
+  }
+
+  bool passed = true;
+  printf("%-20s %8s %12s %12s %8s\n", "case", "count", "MB/s", "baseline",
+         "change");
+  for (auto& c : cases) {
+    auto it = baseline.find(GetKey(c));
+    if (it == baseline.end()) {
+      printf("%-20s %8d %12.1f %12s\n", c.name.c_str(), c.count, c.mbps, "-");
+      continue;
+    }
+    double change = c.mbps / it->second - 1;
+    bool slower = change < -tolerance;
+    printf("%-20s %8d %12.1f %12.1f %+7.1f%%%s\n", c.name.c_str(), c.count,
+           c.mbps, it->second, 100 * change, slower ? " SLOWER" : "");
+    passed = passed && !slower;
+  }
+  return passed;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  std::string record, compare;
+  double tolerance = 0.1;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg.compare(0, 9, "--record=") == 0) {
+      record = arg.substr(9);
+    } else if (arg.compare(0, 10, "--compare=") == 0) {
+      compare = arg.substr(10);
+    } else if (sscanf(argv[i], "--tolerance=%lf", &tolerance) != 1 ||
+               tolerance < 0) {
+      fprintf(stderr, "invalid argument: %s\n", argv[i]);
+      return 2;
+    }
+  }
+
+  auto cases = RunCases();
+  if (!record.empty()) {
+    if (!Record(cases, record)) {
+      fprintf(stderr, "couldn't write %s\n", record.c_str());
+      return 1;
+    }
+    fprintf(stderr, "baseline written to %s\n", record.c_str());
+    return 0;
+  }
+  if (!compare.empty())
+    return Compare(cases, compare, tolerance) ? 0 : 1;
+  printf("%-20s %8s %12s\n", "case", "count", "MB/s");
+  for (auto& c : cases)
+    printf("%-20s %8d %12.1f\n", c.name.c_str(), c.count, c.mbps);
+  return 0;
+}
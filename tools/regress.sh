@@ -0,0 +1,192 @@
+#!/bin/sh
+# The MIT License (MIT)
+# 
+# Copyright (c) 2016 Gabriel de Quadros Ligneul
+# 
+# Permission is hereby granted, free of charge, to any person obtaining a copy
+# of this software and associated documentation files (the "Software"), to deal
+# in the Software without restriction, including without limitation the rights
+# to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+# copies of the Software, and to permit persons to whom the Software is
+# furnished to do so, subject to the following conditions:
+# 
+# The above copyright notice and this permission notice shall be included in all
+# copies or substantial portions of the Software.
+# 
+# THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+# IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+# FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+# AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+# LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+# OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+# SOFTWARE.
+
+
+# Performance regression gate over the benchmark (see --benchmark in
+# README.md):
+#
+#   tools/regress.sh record <app> <baseline>
+#   tools/regress.sh compare <app> <baseline>
+#
+# Every configuration of the suite runs REGRESS_RUNS times (3 by default),
+# and each metric is kept as the mean and the standard deviation of the runs:
+# the frame rate, the 50th and 99th percentiles of the frame and gpu times
+# and the gpu time of every pass. record writes them to the baseline, made on
+# the machine the gate runs on. compare runs the suite again, prints a table
+# of every metric against the baseline and exits with 1 if one is worse by
+# more than both its tolerance and three times the noise of the runs.
+#
+# The tolerances are relative: 5% for the frame rate and the medians, 10% for
+# the 99th percentiles and the passes. REGRESS_TOLERANCES overrides them by
+# metric, e.g. REGRESS_TOLERANCES="fps=0.02 pass.lighting=0.2". BENCH_FRAMES
+# and BENCH_ARGS are the ones of bench.sh.
+
+set -e
+
+mode=$1
+app=$2
+baseline=$3
+if [ "$mode" != record ] && [ "$mode" != compare ] || [ -z "$baseline" ]; then
+  echo "usage: $0 record|compare <app> <baseline>" >&2
+  exit 2
+fi
+frames=${BENCH_FRAMES:-300}
+runs=${REGRESS_RUNS:-3}
+results=$(mktemp)
+samples=$(mktemp)
+measured=$(mktemp)
+trap 'rm -f "$results" "$samples" "$measured"' EXIT
+
+# Configurations of the suite, by name, and their options
+suite() {
+  echo "default"
+  echo "lights --lights=100x100"
+  echo "bears --bears=100x100"
+  echo "4k --window=3840x2160"
+}
+
+# Prints a number of the results, given the key of its line and of its field
+field() {
+  sed -n "s/.*\"$1\": {.*\"$2\": \([0-9.]*\).*/\1/p" "$results"
+}
+
+# Runs the benchmark of a configuration once, appending a line per metric
+# to the samples: the configuration, the metric and its value
+run() {
+  config=$1
+  shift
+  "$app" --benchmark="$frames" --benchmark-output="$results" $BENCH_ARGS \
+    "$@" < /dev/null > /dev/null
+  {
+    echo "fps $(sed -n 's/.*"fps": \([0-9.]*\).*/\1/p' "$results")"
+    echo "frame_p50_ms $(field frame_ms p50)"
+    echo "frame_p99_ms $(field frame_ms p99)"
+    echo "gpu_p50_ms $(field gpu_ms p50)"
+    echo "gpu_p99_ms $(field gpu_ms p99)"
+    sed -n '/"passes_ms"/,/}/s/ *"\(.*\)": \([0-9][0-9.]*\).*/pass.\1 \2/p' \
+      "$results"
+  } | sed "s/^/$config /" >> "$samples"
+}
+
+suite | while read -r config options; do
+  i=0
+  while [ "$i" -lt "$runs" ]; do
+    echo "$config: run $((i + 1)) of $runs" >&2
+    run "$config" $options
+    i=$((i + 1))
+  done
+done
+
+# Mean and sample standard deviation of every metric, in the order first seen
+awk '{
+  key = $1 " " $2
+  if (!(key in n)) order[++keys] = key
+  n[key]++
+  sum[key] += $3
+  squares[key] += $3 * $3
+} END {
+  for (i = 1; i <= keys; ++i) {
+    key = order[i]
+    mean = sum[key] / n[key]
+    var = n[key] > 1 ? (squares[key] - n[key] * mean * mean) / (n[key] - 1) : 0
+    printf "%s %.4f %.4f\n", key, mean, (var > 0 ? sqrt(var) : 0)
+  }
+}' "$samples" > "$measured"
+
+if [ "$mode" = record ]; then
+  cp "$measured" "$baseline"
+  echo "baseline written to $baseline" >&2
+  exit 0
+fi
+
+awk -v tolerances="$REGRESS_TOLERANCES" '
+BEGIN {
+  n = split(tolerances, pairs, " ")
+  for (i = 1; i <= n; ++i) {
+    split(pairs[i], pair, "=")
+    override[pair[1]] = pair[2]
+  }
+}
+
+# Relative tolerance of a metric
+function tolerance(metric) {
+  if (metric in override) return override[metric]
+  if (metric ~ /_p99_ms$/ || metric ~ /^pass\./) return 0.10
+  return 0.05
+}
+
+FNR == NR {
+  key = $1 " " $2
+  order[++keys] = key
+  base[key] = $3
+  base_sd[key] = $4
+  next
+}
+
+{
+  key = $1 " " $2
+  current[key] = $3
+  current_sd[key] = $4
+  if (!(key in base)) added[++n_added] = key
+}
+
+END {
+  printf "%-10s %-20s %10s %10s %8s\n", "config", "metric", "baseline", \
+         "current", "change"
+  failed = 0
+  for (i = 1; i <= keys; ++i) {
+    key = order[i]
+    split(key, parts, " ")
+    if (!(key in current)) {
+      printf "%-10s %-20s %10.3f %10s %8s  missing\n", parts[1], parts[2], \
+             base[key], "-", "-"
+      continue
+    }
+    # Positive when worse: a lower frame rate or a longer time
+    worse = current[key] - base[key]
+    if (parts[2] == "fps") worse = -worse
+    noise = 3 * sqrt(base_sd[key] ^ 2 + current_sd[key] ^ 2)
+    threshold = tolerance(parts[2]) * base[key]
+    if (noise > threshold) threshold = noise
+    status = ""
+    if (worse > threshold) {
+      status = "  REGRESSED"
+      failed++
+    } else if (-worse > threshold) {
+      status = "  improved"
+    }
+    change = base[key] ? 100 * (current[key] - base[key]) / base[key] : 0
+    printf "%-10s %-20s %10.3f %10.3f %+7.1f%%%s\n", parts[1], parts[2], \
+           base[key], current[key], change, status
+  }
+  for (i = 1; i <= n_added; ++i) {
+    split(added[i], parts, " ")
+    printf "%-10s %-20s %10s %10.3f %8s  new\n", parts[1], parts[2], "-", \
+           current[added[i]], "-"
+  }
+  if (failed) {
+    printf "%d metrics regressed\n", failed
+    exit 1
+  }
+  print "no regression"
+}' "$baseline" "$measured"